@@ -127,7 +127,7 @@ static void              I2Cx_Error(I2C_HandleTypeDef *i2c_handler, uint8_t Addr
 /* AUDIO IO functions */
 void            AUDIO_IO_Init(void);
 void            AUDIO_IO_DeInit(void);
-void            AUDIO_IO_Write(uint8_t Addr, uint16_t Reg, uint16_t Value);
+uint8_t         AUDIO_IO_Write(uint8_t Addr, uint16_t Reg, uint16_t Value);
 uint16_t        AUDIO_IO_Read(uint8_t Addr, uint16_t Reg);
 void            AUDIO_IO_Delay(uint32_t Delay);
 
@@ -575,9 +575,9 @@ void AUDIO_IO_DeInit(void)
   * @param  Addr: I2C address
   * @param  Reg: Reg address 
   * @param  Value: Data to be written
-  * @retval None
+  * @retval 0 if written, 1 after a bus error (the bus is re-initialized)
   */
-void AUDIO_IO_Write(uint8_t Addr, uint16_t Reg, uint16_t Value)
+uint8_t AUDIO_IO_Write(uint8_t Addr, uint16_t Reg, uint16_t Value)
 {
   uint16_t tmp = Value;
   
@@ -585,7 +585,7 @@ void AUDIO_IO_Write(uint8_t Addr, uint16_t Reg, uint16_t Value)
   
   Value |= ((uint16_t)(tmp << 8)& 0xFF00);
   
-  I2Cx_WriteMultiple(&hI2cAudioHandler, Addr, Reg, I2C_MEMADD_SIZE_16BIT,(uint8_t*)&Value, 2);
+  return (I2Cx_WriteMultiple(&hI2cAudioHandler, Addr, Reg, I2C_MEMADD_SIZE_16BIT,(uint8_t*)&Value, 2) == HAL_OK)? 0 : 1;
 }
 
 /**
@@ -876,16 +876,49 @@ HAL_StatusTypeDef USB_EP0StartXfer(USB_OTG_GlobalTypeDef *USBx , USB_OTG_EPTypeD
   */
 HAL_StatusTypeDef USB_WritePacket(USB_OTG_GlobalTypeDef *USBx, uint8_t *src, uint8_t ch_ep_num, uint16_t len, uint8_t dma)
 {
-  uint32_t count32b = 0U , i = 0U;
-  
+  uint32_t *pSrc;
+  uint32_t count32b, i;
+  uint32_t offset, word, next_word;
+
   if (dma == 0U)
   {
-    count32b =  (len + 3U) / 4U;
-    for (i = 0U; i < count32b; i++, src += 4U)
+    count32b = ((uint32_t)len + 3U) / 4U;
+    offset = (uint32_t)src & 3U;
+    pSrc = (uint32_t *)((uint32_t)src - offset);
+
+    if (offset == 0U)
     {
-      USBx_DFIFO(ch_ep_num) = *((__packed uint32_t *)src);
+      /* Aligned source: 4 words per iteration, then the remaining words */
+      for (i = count32b >> 2U; i > 0U; i--)
+      {
+        USBx_DFIFO(ch_ep_num) = pSrc[0];
+        USBx_DFIFO(ch_ep_num) = pSrc[1];
+        USBx_DFIFO(ch_ep_num) = pSrc[2];
+        USBx_DFIFO(ch_ep_num) = pSrc[3];
+        pSrc += 4U;
+      }
+      for (i = count32b & 3U; i > 0U; i--)
+      {
+        USBx_DFIFO(ch_ep_num) = *pSrc;
+        pSrc++;
+      }
+    }
+    else
+    {
+      /* Unaligned source: each FIFO word is merged from two aligned loads,
+         the head and the tail are taken from the first and the last loaded words */
+      offset <<= 3U;
+      word = *pSrc;
+      for (i = count32b; i > 0U; i--)
+      {
+        pSrc++;
+        next_word = *pSrc;
+        USBx_DFIFO(ch_ep_num) = (word >> offset) | (next_word << (32U - offset));
+        word = next_word;
+      }
     }
   }
+
   return HAL_OK;
 }
 
@@ -904,15 +937,55 @@ HAL_StatusTypeDef USB_WritePacket(USB_OTG_GlobalTypeDef *USBx, uint8_t *src, uin
   */
 void *USB_ReadPacket(USB_OTG_GlobalTypeDef *USBx, uint8_t *dest, uint16_t len)
 {
-  uint32_t i=0U;
-  uint32_t count32b = (len + 3U) / 4U;
-  
-  for ( i = 0U; i < count32b; i++, dest += 4U )
+  uint32_t *pDest;
+  uint32_t i;
+  uint32_t count32b = ((uint32_t)len + 3U) / 4U;
+  uint32_t offset, word, carry;
+
+  offset = (uint32_t)dest & 3U;
+  if (offset == 0U)
   {
-    *(__packed uint32_t *)dest = USBx_DFIFO(0U);
-    
+    /* Aligned destination: 4 words per iteration, then the remaining words */
+    pDest = (uint32_t *)dest;
+    for (i = count32b >> 2U; i > 0U; i--)
+    {
+      pDest[0] = USBx_DFIFO(0U);
+      pDest[1] = USBx_DFIFO(0U);
+      pDest[2] = USBx_DFIFO(0U);
+      pDest[3] = USBx_DFIFO(0U);
+      pDest += 4U;
+    }
+    for (i = count32b & 3U; i > 0U; i--)
+    {
+      *pDest = USBx_DFIFO(0U);
+      pDest++;
+    }
   }
-  return ((void *)dest);
+  else if (count32b != 0U)
+  {
+    /* Unaligned destination: the head is stored up to the next word boundary,
+       the middle with aligned stores and the tail with the bytes left */
+    word = USBx_DFIFO(0U);
+    for (i = 0U; i < (4U - offset); i++)
+    {
+      dest[i] = (uint8_t)(word >> (8U * i));
+    }
+    carry = word >> (8U * (4U - offset));
+    pDest = (uint32_t *)((uint32_t)dest - offset + 4U);
+    for (i = count32b - 1U; i > 0U; i--)
+    {
+      word = USBx_DFIFO(0U);
+      *pDest = carry | (word << (8U * offset));
+      carry = word >> (32U - (8U * offset));
+      pDest++;
+    }
+    for (i = 0U; i < offset; i++)
+    {
+      ((uint8_t *)pDest)[i] = (uint8_t)(carry >> (8U * i));
+    }
+  }
+
+  return ((void *)(dest + (4U * count32b)));
 }
 
 /**
@@ -98,7 +98,9 @@ typedef struct
   PCD_EPTypeDef           OUT_ep[16];  /*!< OUT endpoint parameters            */
   HAL_LockTypeDef         Lock;        /*!< PCD peripheral status              */
   __IO PCD_StateTypeDef   State;       /*!< PCD communication state            */
-  uint32_t                Setup[12];   /*!< Setup packet buffer                */
+  uint32_t                Setup[12] __ALIGNED(32U); /*!< Setup packet buffer, written by the OTG DMA.
+                                                            It owns its D-cache lines (32 bytes)    */
+  uint32_t                SetupPad[4]; /*!< Pads Setup to a whole number of D-cache lines */
   PCD_LPM_StateTypeDef    LPM_State;   /*!< LPM State                          */
   uint32_t                BESL;
 
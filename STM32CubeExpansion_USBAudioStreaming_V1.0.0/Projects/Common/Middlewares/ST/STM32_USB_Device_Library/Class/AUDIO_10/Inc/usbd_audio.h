@@ -72,6 +72,7 @@
 #define USBD_AUDIO_INPUT_TERMINAL_DESC_SIZE                          0x0C
 #define USBD_AUDIO_FEATURE_UNIT_DESC_SIZE(CH_NB,CTRSIZE)            (0x07+(((CH_NB)+1)*(CTRSIZE)))
 #define USBD_AUDIO_OUTPUT_TERMINAL_DESC_SIZE                         0x09
+#define USBD_AUDIO_MIXER_UNIT_DESC_SIZE(IN_PINS,CTRSIZE)             (0x0A + (IN_PINS) + (CTRSIZE))
 #define USBD_AUDIO_AC_CS_INTERFACE_DESC_SIZE(AS_CNT)                 (0x08 + (AS_CNT))
 #define USBD_AUDIO_AS_CS_INTERFACE_DESC_SIZE                         0x07
 #define USBD_USBD_AUDIO_FORMAT_TYPE_I_DESC_SIZE(NBFREQ)              (0x08 + (NBFREQ)*3)
@@ -123,7 +124,7 @@
 #define USBD_AUDIO_MAX_OUT_EP 5
 #define USBD_AUDIO_MAX_AS_INTERFACE 2
 #define USBD_AUDIO_EP_MAX_CONTROL 3
-#define USBD_AUDIO_CONFIG_CONTROL_UNIT_COUNT 0x02
+#define USBD_AUDIO_CONFIG_CONTROL_UNIT_COUNT 0x03 /* playback, recording and sidetone feature units */
 #define USBD_AUDIO_FEATURE_MAX_CONTROL 2  
 #define AUDIO_FEEDBACK_EP_PACKET_SIZE                 0x03
 /**
@@ -237,8 +238,8 @@ typedef struct
  /* Structure Define a feedback endpoint and it's callbacks */
  typedef struct 
  {
+   uint8_t feedback_data[AUDIO_FEEDBACK_EP_PACKET_SIZE]; /* buffer used to send feedback, kept first to be word aligned for OTG DMA */
    uint8_t  ep_num; /* endpoint number */
-   uint8_t feedback_data[AUDIO_FEEDBACK_EP_PACKET_SIZE]; /* buffer used to send feedback */
    uint32_t      (*GetFeedback)     (  uint32_t/* privatedata*/); /* return  count of played sample  since last ResetRate */
    uint32_t private_data;
  }  USBD_AUDIO_EP_SynchTypeDef;
@@ -270,6 +271,11 @@ typedef struct
   uint8_t as_interfaces_count;/* the count  of audio streaming interface */
   USBD_AUDIO_ControlTypeDef controls[USBD_AUDIO_CONFIG_CONTROL_UNIT_COUNT]; /* list of Unit control */
   USBD_AUDIO_AS_InterfaceTypeDef as_interfaces[USBD_AUDIO_AS_INTERFACE_COUNT];/* the list  of audio streaming interface */
+#if USBD_SUPPORT_AUDIO_VENDOR_REQUEST
+  /* vendor request to the audio control interface, without data stage. wIndex high byte is free for the application */
+  int8_t  (*VendorRequest)(uint8_t /*request*/, uint16_t /*value*/, uint16_t /*index*/, uint32_t /*privatedata*/);
+  uint32_t  vendor_private_data; /* used as the last arguement of VendorRequest */
+#endif /* USBD_SUPPORT_AUDIO_VENDOR_REQUEST */
 }USBD_AUDIO_FunctionDescriptionfTypeDef;
 
 /* Structure define audio interface */
@@ -34,6 +34,8 @@
 /* Includes ------------------------------------------------------------------*/
 #include "usbd_audio.h"
 #include "usbd_ctlreq.h"
+#include "usbd_core_ex.h"
+#include "audio_profiler.h"
 
 /** @addtogroup STM32_USB_DEVICE_LIBRARY
   * @{
@@ -67,7 +69,8 @@
   USBD_AUDIO_EpUsageTypeDef ep_type;
   uint8_t open; /* 0 closed , 1 open */
   uint16_t max_packet_length; /* the max packet length */
-  uint16_t tx_rx_soffn;
+  uint16_t tx_rx_soffn; /* frame number when the last transfer was armed */
+  uint32_t missed_frames; /* count of incomplete ISO transfers on this EP */
 }USBD_AUDIO_EPTypeDef;
 
 /* Structure define audio class data */
@@ -76,6 +79,7 @@ typedef struct
   USBD_AUDIO_FunctionDescriptionfTypeDef aud_function; /* description of audio function */
   USBD_AUDIO_EPTypeDef ep_in[USBD_AUDIO_MAX_IN_EP]; /*  list of IN EP */
   USBD_AUDIO_EPTypeDef ep_out[USBD_AUDIO_MAX_OUT_EP]; /*  list of OUT EP */ 
+  uint8_t in_armed_map; /* bit i set when IN EP i has a transfer pending */
 
   /* Strcture used for control handeling */
   struct
@@ -87,8 +91,8 @@ typedef struct
       USBD_AUDIO_EP_DataTypeDef* data_ep; /* related Data End point */
 #endif /* USBD_SUPPORT_AUDIO_MULTI_FREQUENCIES */
     } entity;
+    uint8_t* data;  /* buffer to receive request value or send response, USBD_AUDIO_ControlData */
     uint8_t request_target;
-    uint8_t data[USB_MAX_EP0_SIZE];  /* buffer to receive request value or send response */
     uint32_t len; /* used length of data buffer */
     uint16_t  wValue;/* wValue of request which is specific for each control*/
     uint8_t  req;/* the request type specific for each unit*/
@@ -109,6 +113,9 @@ typedef struct
 #define USBD_AUDIO_SOF_COUNT_FEEDBACK_BITS 7
 #define USBD_AUDIO_SOF_COUNT_FEEDBACK (1 << USBD_AUDIO_SOF_COUNT_FEEDBACK_BITS)
 #endif /*USBD_SUPPORT_AUDIO_OUT_FEEDBACK */
+/* OTG DMA writes the EP0 data stage in memory and the D-cache is maintained by 32 bytes lines */
+#define USBD_AUDIO_CACHE_LINE_SIZE 32U
+#define USBD_AUDIO_CONTROL_DATA_SIZE ((USB_MAX_EP0_SIZE + USBD_AUDIO_CACHE_LINE_SIZE - 1U)&~(USBD_AUDIO_CACHE_LINE_SIZE - 1U))
 /**
   * @}
   */ 
@@ -116,6 +123,8 @@ typedef struct
 /** @defgroup USBD_AUDIO_Private_Macros
   * @{
   */ 
+#define USBD_AUDIO_ARM_IN_EP(haudio, ep_idx)     ((haudio)->in_armed_map |= (uint8_t)(1U << (ep_idx)))
+#define USBD_AUDIO_DISARM_IN_EP(haudio, ep_idx)  ((haudio)->in_armed_map &= (uint8_t)~(1U << (ep_idx)))
 
                                          
 /**
@@ -166,6 +175,10 @@ static  unsigned get_usb_full_speed_rate(unsigned int rate, unsigned char * buf)
 #endif /*USBD_SUPPORT_AUDIO_OUT_FEEDBACK */
 
 static uint8_t  USBD_AUDIO_SetInterfaceAlternate(USBD_HandleTypeDef *pdev,uint8_t as_interface_num,uint8_t new_alt);
+#if USBD_SUPPORT_ISO_FAST_PATH
+static void  USBD_AUDIO_DataOutFastPath(USBD_HandleTypeDef *pdev, uint8_t epnum, void* private_data);
+static void  USBD_AUDIO_DataInFastPath(USBD_HandleTypeDef *pdev, uint8_t epnum, void* private_data);
+#endif /* USBD_SUPPORT_ISO_FAST_PATH */
 
 /**
   * @}
@@ -175,6 +188,10 @@ static uint8_t  USBD_AUDIO_SetInterfaceAlternate(USBD_HandleTypeDef *pdev,uint8_
   * @{
   */ 
 
+/* buffer of the control requests data stage. It is out of the malloc-ed handle, whose alignment is not
+   known, and owns its cache lines so that invalidating it never drops a write to another variable */
+static uint8_t USBD_AUDIO_ControlData[USBD_AUDIO_CONTROL_DATA_SIZE] __ALIGNED(USBD_AUDIO_CACHE_LINE_SIZE);
+
 USBD_ClassTypeDef  USBD_AUDIO = 
 {
   USBD_AUDIO_Init,
@@ -239,6 +256,7 @@ static uint8_t  USBD_AUDIO_Init (USBD_HandleTypeDef *pdev,
   else
   {
     memset(haudio, 0, sizeof(USBD_AUDIO_HandleTypeDef));
+    haudio->last_control.data = USBD_AUDIO_ControlData;
     aud_if_cbks = (USBD_AUDIO_InterfaceCallbacksfTypeDef *)pdev->pUserData;
     /* Initialize the Audio output Hardware layer */
     if (aud_if_cbks->Init(&haudio->aud_function,aud_if_cbks->private_data)!= USBD_OK)
@@ -274,14 +292,21 @@ static uint8_t  USBD_AUDIO_DeInit (USBD_HandleTypeDef *pdev,
       if(haudio->ep_in[i].open)
       {
         USBD_LL_CloseEP(pdev, i|0x80);
+#if USBD_SUPPORT_ISO_FAST_PATH
+        USBD_LL_UnRegisterIsoFastPath(pdev, i|0x80);
+#endif /* USBD_SUPPORT_ISO_FAST_PATH */
         haudio->ep_in[i].open = 0;
       }
     }
+    haudio->in_armed_map = 0;
     for(int i=1;i < USBD_AUDIO_MAX_OUT_EP; i++)
     {
       if(haudio->ep_out[i].open)
       {
         USBD_LL_CloseEP(pdev, i);
+#if USBD_SUPPORT_ISO_FAST_PATH
+        USBD_LL_UnRegisterIsoFastPath(pdev, i);
+#endif /* USBD_SUPPORT_ISO_FAST_PATH */
         haudio->ep_out[i].open = 0;
       }
     }
@@ -326,7 +351,14 @@ static uint8_t  USBD_AUDIO_SetInterfaceAlternate(USBD_HandleTypeDef *pdev,uint8_
       if(ep->open)
       {
         USBD_LL_CloseEP(pdev, ep->ep_description.data_ep->ep_num);
+#if USBD_SUPPORT_ISO_FAST_PATH
+        USBD_LL_UnRegisterIsoFastPath(pdev, ep->ep_description.data_ep->ep_num);
+#endif /* USBD_SUPPORT_ISO_FAST_PATH */
         ep->open=0;
+        if(ep->ep_description.data_ep->ep_num&0x80)
+        {
+          USBD_AUDIO_DISARM_IN_EP(haudio, ep->ep_description.data_ep->ep_num&0x0F);
+        }
       }
 #if USBD_SUPPORT_AUDIO_OUT_FEEDBACK  
       if(pas_interface->synch_enabled)
@@ -337,6 +369,7 @@ static uint8_t  USBD_AUDIO_SetInterfaceAlternate(USBD_HandleTypeDef *pdev,uint8_
           {
             USBD_LL_CloseEP(pdev, ep->ep_description.sync_ep->ep_num);
             ep->open = 0;
+            USBD_AUDIO_DISARM_IN_EP(haudio, ep->ep_description.sync_ep->ep_num&0x0F);
           }
       }
 #endif /*USBD_SUPPORT_AUDIO_OUT_FEEDBACK */
@@ -364,11 +397,20 @@ static uint8_t  USBD_AUDIO_SetInterfaceAlternate(USBD_HandleTypeDef *pdev,uint8_
      /* get usb working buffer */ 
     ep->ep_description.data_ep->buf= ep->ep_description.data_ep->GetBuffer(ep->ep_description.data_ep->private_data,
                                                                            &ep->ep_description.data_ep->length);        
+#if USBD_SUPPORT_ISO_FAST_PATH
+    /* data stage of the data ep is handled directly from the core */
+    USBD_LL_RegisterIsoFastPath(pdev, ep->ep_description.data_ep->ep_num,
+                                (ep->ep_description.data_ep->ep_num&0x80)? USBD_AUDIO_DataInFastPath:
+                                                                           USBD_AUDIO_DataOutFastPath,
+                                ep);
+#endif /* USBD_SUPPORT_ISO_FAST_PATH */
     
     if(ep->ep_description.data_ep->ep_num&0x80)  /* IN EP */
     {
       USBD_LL_FlushEP(pdev, ep->ep_description.data_ep->ep_num);
       ep->tx_rx_soffn = USB_SOF_NUMBER();
+      ep->missed_frames = 0;
+      USBD_AUDIO_ARM_IN_EP(haudio, ep->ep_description.data_ep->ep_num&0x0F);
       USBD_LL_Transmit(pdev, 
                         ep->ep_description.data_ep->ep_num,
                         ep->ep_description.data_ep->buf,
@@ -400,6 +442,8 @@ static uint8_t  USBD_AUDIO_SetInterfaceAlternate(USBD_HandleTypeDef *pdev,uint8_
             rate = sync_ep->GetFeedback(sync_ep->private_data);
             get_usb_full_speed_rate(rate,sync_ep->feedback_data);
             ep->tx_rx_soffn = USB_SOF_NUMBER();
+            ep->missed_frames = 0;
+            USBD_AUDIO_ARM_IN_EP(haudio, sync_ep->ep_num&0x0F);
             USBD_LL_Transmit(pdev, sync_ep->ep_num,
                              sync_ep->feedback_data, ep->max_packet_length);
       }
@@ -484,6 +528,21 @@ static uint8_t  USBD_AUDIO_Setup (USBD_HandleTypeDef *pdev,
     }
 #endif /*USBD_SUPPORT_AUDIO_MULTI_FREQUENCIES*/
     break;
+
+#if USBD_SUPPORT_AUDIO_VENDOR_REQUEST
+  case USB_REQ_TYPE_VENDOR :
+    /* only requests to the audio control interface without data stage, the core sends the status */
+    if(((req->bmRequest & USB_REQ_RECIPIENT_MASK) == USB_REQ_RECIPIENT_INTERFACE) && (LOBYTE(req->wIndex) == 0) &&
+       (req->wLength == 0) && (haudio->aud_function.VendorRequest) &&
+       (haudio->aud_function.VendorRequest(req->bRequest, req->wValue, req->wIndex,
+                                           haudio->aud_function.vendor_private_data) == 0))
+    {
+      break;
+    }
+    USBD_CtlError (pdev, req);
+    ret = USBD_FAIL;
+    break;
+#endif /* USBD_SUPPORT_AUDIO_VENDOR_REQUEST */
     
   case USB_REQ_TYPE_STANDARD:
     switch (req->bRequest)
@@ -494,9 +553,10 @@ static uint8_t  USBD_AUDIO_Setup (USBD_HandleTypeDef *pdev,
         pbuf = USBD_AUDIO_CfgDesc + 18;
         len = MIN(USBD_AUDIO_DESC_SIZ , req->wLength);
         
-        
+        /* send a copy from the control buffer, OTG DMA can't read the unaligned descriptor */
+        memcpy(haudio->last_control.data, pbuf, len);
         USBD_CtlSendData (pdev, 
-                          pbuf,
+                          haudio->last_control.data,
                           len);
       }
       break;
@@ -507,8 +567,10 @@ static uint8_t  USBD_AUDIO_Setup (USBD_HandleTypeDef *pdev,
         {
             if((uint8_t)(req->wIndex)==haudio->aud_function.as_interfaces[i].interface_num)
             {
+              /* send the alternate from the control buffer, OTG DMA can't read the unaligned interface field */
+              haudio->last_control.data[0] = haudio->aud_function.as_interfaces[i].alternate;
               USBD_CtlSendData (pdev,
-                        (uint8_t *)&(haudio->aud_function.as_interfaces[i].alternate),
+                        haudio->last_control.data,
                         1);
               return USBD_OK;
             }
@@ -583,6 +645,7 @@ static uint8_t  USBD_AUDIO_DataIn (USBD_HandleTypeDef *pdev,
 {
   USBD_AUDIO_EPTypeDef * ep;
 
+   AUDIO_PROFILER_ENTER(AUDIO_PROFILER_USB_DATA_IN);
    ep = &((USBD_AUDIO_HandleTypeDef*) pdev->pClassData)->ep_in[epnum&0x7F];
    if(ep->open)
    {
@@ -622,7 +685,7 @@ static uint8_t  USBD_AUDIO_DataIn (USBD_HandleTypeDef *pdev,
      /* Should not be reproduced */
      USBD_error_handler();
    }
-  
+  AUDIO_PROFILER_EXIT(AUDIO_PROFILER_USB_DATA_IN);
   return USBD_OK;
 }
 
@@ -658,7 +721,7 @@ static uint8_t  USBD_AUDIO_EP0_RxReady (USBD_HandleTypeDef *pdev)
           {
                   case USBD_AUDIO_CONTROL_FEATURE_UNIT_MUTE:
                     {
-                      /* @TODO treat multi channel case and error when req! of GetCur*/  
+                      /* @TODO treat error when req! of GetCur*/  
                       if(feature_control->SetMute)
                       {
                         feature_control->SetMute(LOBYTE(haudio->last_control.wValue),
@@ -676,7 +739,7 @@ static uint8_t  USBD_AUDIO_EP0_RxReady (USBD_HandleTypeDef *pdev)
                         case USBD_AUDIO_REQ_SET_CUR:
                               if(feature_control->SetCurVolume)
                               {
-                            	  tmpdata = (uint16_t*) &(haudio->last_control.data);
+                            	  tmpdata = (uint16_t*) haudio->last_control.data;
                                   feature_control->SetCurVolume(LOBYTE(haudio->last_control.wValue),
                                                                                *tmpdata,
                                                                                ctl->private_data);
@@ -782,6 +845,7 @@ static uint8_t  USBD_AUDIO_SOF (USBD_HandleTypeDef *pdev)
     USBD_AUDIO_HandleTypeDef   *haudio;
   
  
+  AUDIO_PROFILER_ENTER(AUDIO_PROFILER_USB_SOF);
   haudio = (USBD_AUDIO_HandleTypeDef*) pdev->pClassData; 
   
   for(int i=0;i<haudio->aud_function.as_interfaces_count;i++)
@@ -795,12 +859,14 @@ static uint8_t  USBD_AUDIO_SOF (USBD_HandleTypeDef *pdev)
         }
       }
   }
+  AUDIO_PROFILER_EXIT(AUDIO_PROFILER_USB_SOF);
   return USBD_OK;
 }
 
 /**
   * @brief  USBD_AUDIO_IsoINIncomplete
-  *         handle data ISO IN Incomplete event
+  *         handle data ISO IN Incomplete event. Only endpoints armed in
+  *         in_armed_map are checked, the frame number is read once.
   * @param  pdev: device instance
   * @param  epnum: endpoint index
   * @retval status
@@ -810,18 +876,29 @@ static uint8_t  USBD_AUDIO_IsoINIncomplete (USBD_HandleTypeDef *pdev, uint8_t ep
  USBD_AUDIO_EPTypeDef   *ep;
  USBD_AUDIO_HandleTypeDef   *haudio;
  uint16_t current_sof;
+ uint8_t armed_map;
+ 
   haudio = (USBD_AUDIO_HandleTypeDef*) pdev->pClassData;
- /* @TODO check if the feedback is responsible of event */
-  for(int i = 1; i<USBD_AUDIO_MAX_IN_EP; i++)
+  armed_map = haudio->in_armed_map;
+  if(armed_map == 0)
+  {
+    return USBD_OK;
+  }
+  current_sof = USB_SOF_NUMBER();
+  for(int i = 1; (armed_map >> i) != 0; i++)
   {
+    if(((armed_map >> i)&0x01) == 0)
+    {
+      continue;
+    }
     ep = &haudio->ep_in[i];
-    current_sof = USB_SOF_NUMBER();
-    if((ep->open) && IS_ISO_IN_INCOMPLETE_EP(i,current_sof, ep->tx_rx_soffn))
+    if(IS_ISO_IN_INCOMPLETE_EP(i,current_sof, ep->tx_rx_soffn))
     {
       epnum = i|0x80;
       USB_CLEAR_INCOMPLETE_IN_EP(epnum);
       USBD_LL_FlushEP(pdev, epnum);
-      ep->tx_rx_soffn = USB_SOF_NUMBER();
+      ep->missed_frames++;
+      ep->tx_rx_soffn = current_sof;
 #if USBD_SUPPORT_AUDIO_OUT_FEEDBACK  
      if(ep->ep_type==USBD_AUDIO_FEEDBACK_EP)
       {
@@ -844,10 +921,9 @@ static uint8_t  USBD_AUDIO_IsoINIncomplete (USBD_HandleTypeDef *pdev, uint8_t ep
      {
        USBD_error_handler();
      }
-    
     }
   }
-  return 0;
+  return USBD_OK;
 }
 /**
   * @brief  USBD_AUDIO_IsoOutIncomplete
@@ -878,6 +954,7 @@ static uint8_t  USBD_AUDIO_DataOut (USBD_HandleTypeDef *pdev,
   uint16_t packet_length;
 
 
+  AUDIO_PROFILER_ENTER(AUDIO_PROFILER_USB_DATA_OUT);
   ep=&((USBD_AUDIO_HandleTypeDef*) pdev->pClassData)->ep_out[epnum];
 
   if(ep->open)
@@ -900,10 +977,56 @@ static uint8_t  USBD_AUDIO_DataOut (USBD_HandleTypeDef *pdev,
       USBD_error_handler();
     }
     
-  
+    AUDIO_PROFILER_EXIT(AUDIO_PROFILER_USB_DATA_OUT);
     return USBD_OK;
 }
 
+#if USBD_SUPPORT_ISO_FAST_PATH
+/**
+  * @brief  USBD_AUDIO_DataOutFastPath
+  *         handle data OUT Stage of an opened data ep, called by the core
+  *         without class and ep lookup
+  * @param  pdev: device instance
+  * @param  epnum: endpoint index
+  * @param  private_data: USBD_AUDIO_EPTypeDef of the ep
+  * @retval None
+  */
+static void  USBD_AUDIO_DataOutFastPath(USBD_HandleTypeDef *pdev, uint8_t epnum, void* private_data)
+{
+  USBD_AUDIO_EP_DataTypeDef* data_ep = ((USBD_AUDIO_EPTypeDef*)private_data)->ep_description.data_ep;
+  uint8_t *pbuf;
+  uint16_t packet_length;
+  
+  AUDIO_PROFILER_ENTER(AUDIO_PROFILER_USB_DATA_OUT);
+  packet_length = USBD_LL_GetRxDataSize(pdev, epnum);
+  data_ep->DataReceived(packet_length, data_ep->private_data);
+  pbuf = data_ep->GetBuffer(data_ep->private_data, &packet_length);
+  USBD_LL_PrepareReceive(pdev, epnum, pbuf, packet_length);
+  AUDIO_PROFILER_EXIT(AUDIO_PROFILER_USB_DATA_OUT);
+}
+
+/**
+  * @brief  USBD_AUDIO_DataInFastPath
+  *         handle data IN Stage of an opened data ep, called by the core
+  *         without class and ep lookup
+  * @param  pdev: device instance
+  * @param  epnum: endpoint index
+  * @param  private_data: USBD_AUDIO_EPTypeDef of the ep
+  * @retval None
+  */
+static void  USBD_AUDIO_DataInFastPath(USBD_HandleTypeDef *pdev, uint8_t epnum, void* private_data)
+{
+  USBD_AUDIO_EPTypeDef* ep = (USBD_AUDIO_EPTypeDef*)private_data;
+  USBD_AUDIO_EP_DataTypeDef* data_ep = ep->ep_description.data_ep;
+  
+  AUDIO_PROFILER_ENTER(AUDIO_PROFILER_USB_DATA_IN);
+  data_ep->buf = data_ep->GetBuffer(data_ep->private_data, &data_ep->length);
+  ep->tx_rx_soffn = USB_SOF_NUMBER();
+  USBD_LL_Transmit(pdev, epnum|0x80, data_ep->buf, data_ep->length);
+  AUDIO_PROFILER_EXIT(AUDIO_PROFILER_USB_DATA_IN);
+}
+#endif /* USBD_SUPPORT_ISO_FAST_PATH */
+
 /**
   * @brief  AUDIO_REQ
   *         Handles the Control requests.
@@ -975,13 +1098,16 @@ static uint8_t AUDIO_REQ(USBD_HandleTypeDef *pdev, USBD_SetupReqTypedef *req)
           {
                   case USBD_AUDIO_CONTROL_FEATURE_UNIT_MUTE:
                     {
-                      /* @TODO treat multi channel case and error when req! of GetCur*/
+                      /* @TODO treat error when req! of GetCur*/
                       
                       haudio->last_control.data[0] = 0;
-                      if(feature_control->GetMute)
+                      if((feature_control->GetMute) &&
+                         (feature_control->GetMute(LOBYTE(req->wValue),
+                                                   &haudio->last_control.data[0], ctl->private_data) != 0))
                       {
-                        feature_control->GetMute(LOBYTE(req->wValue),
-                                                                &haudio->last_control.data[0], ctl->private_data);
+                        /* channel not supported */
+                        USBD_CtlError (pdev, req);
+                        return USBD_FAIL;
                       }
                       /* Send the current mute state */
                       USBD_CtlSendData (pdev, haudio->last_control.data,1);
@@ -994,15 +1120,18 @@ static uint8_t AUDIO_REQ(USBD_HandleTypeDef *pdev, USBD_SetupReqTypedef *req)
                         /* set request */
                         /* @TODO check the len uses cases and control req->wLength*/
                        
-                       tmpdata =  (uint16_t*) &(haudio->last_control.data);
+                       tmpdata =  (uint16_t*) haudio->last_control.data;
                         switch(req->bRequest)
                         {
                         case USBD_AUDIO_REQ_GET_CUR:
-                              tmpdata = 0;
-                              if(feature_control->GetCurVolume)
+                              *tmpdata = 0;
+                              if((feature_control->GetCurVolume) &&
+                                 (feature_control->GetCurVolume(LOBYTE(req->wValue),
+                                                                (uint16_t*)haudio->last_control.data, ctl->private_data) != 0))
                               {
-                                  feature_control->GetCurVolume(LOBYTE(req->wValue),
-                                                                (uint16_t*)haudio->last_control.data, ctl->private_data);
+                                /* channel not supported */
+                                USBD_CtlError (pdev, req);
+                                return USBD_FAIL;
                               }
                               break;
                           
@@ -1019,8 +1148,10 @@ static uint8_t AUDIO_REQ(USBD_HandleTypeDef *pdev, USBD_SetupReqTypedef *req)
                         default :
                                 USBD_error_handler();
                         }
-                         /* Send the current mute state */
-                                USBD_CtlSendData (pdev, (uint8_t*) tmpdata,2);
+                         /* Send the volume from the control buffer, OTG DMA can't read the unaligned unit fields */
+                                haudio->last_control.data[0] = LOBYTE(*tmpdata);
+                                haudio->last_control.data[1] = HIBYTE(*tmpdata);
+                                USBD_CtlSendData (pdev, haudio->last_control.data,2);
                          break;
                        }
                   
@@ -0,0 +1,115 @@
+/**
+  ******************************************************************************
+  * @file    usbd_core_ex.h
+  * @author  MCD Application Team 
+  * @brief   Header file for the usbd_core_ex.c file, declares the extensions
+  *          added to the USB device core.
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2019  STMicroelectronics.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by ST under Ultimate Liberty license
+  * SLA0044, the "License"; You may not use this file except in compliance with
+  * the License. You may obtain a copy of the License at:
+  *                             www.st.com/SLA0044
+  *
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __USBD_CORE_EX_H
+#define __USBD_CORE_EX_H
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include "usbd_core.h"
+
+/** @addtogroup STM32_USB_DEVICE_LIBRARY
+  * @{
+  */
+  
+/** @defgroup USBD_CORE_EX
+  * @brief This file is the Header file for usbd_core_ex.c
+  * @{
+  */ 
+
+/** @defgroup USBD_CORE_EX_Exported_Defines
+  * @{
+  */
+/* FIFO planner: size in words of a packet, minimal depth of a TX FIFO, fixed part of the RX FIFO
+  (5 * number of control endpoints + 8 for setup packets, 1 for status information, 1 for Global NAK)
+   and count of endpoints of a plan */
+#define USBD_FIFO_PACKET_WORD_SIZE(packet_size) ((uint16_t)(((packet_size) + 3U)/4U))
+#define USBD_FIFO_TX_EP_MIN_WORD_SIZE   16U
+#define USBD_FIFO_RX_FIXED_WORD_SIZE    (5U*1U + 8U + 1U + 1U)
+#define USBD_FIFO_MAX_EP                16U
+/**
+  * @}
+  */ 
+
+/** @defgroup USBD_CORE_EX_Exported_TypesDefinitions
+  * @{
+  */
+/* endpoints of a FIFO layout, packet sizes in bytes, 0 for an unused endpoint */
+typedef struct
+{
+  uint16_t fifo_word_size;               /* FIFO RAM of the core in words */
+  uint8_t  out_ep_count;                 /* OUT endpoints of the core, each one takes 2 words of RX FIFO */
+  uint8_t  stream_in_ep;                 /* IN endpoint given the remaining words, 0 to give them to RX FIFO */
+  uint16_t out_mps[USBD_FIFO_MAX_EP];    /* max packet size of the OUT endpoints, EP0 included */
+  uint16_t in_mps[USBD_FIFO_MAX_EP];     /* max packet size of the IN endpoints, EP0 included */
+  uint16_t out_iso;                      /* bit n set when OUT endpoint n is isochronous */
+  uint16_t in_iso;                       /* bit n set when IN endpoint n is isochronous */
+  uint16_t ep0_burst_size;               /* bytes EP0 sends in one shot, the configuration descriptor */
+} USBD_FifoRequestTypeDef;
+
+/* FIFO layout in words */
+typedef struct
+{
+  uint16_t rx_word_size;
+  uint16_t tx_word_size[USBD_FIFO_MAX_EP];
+  uint8_t  tx_fifo_count;                /* TX FIFOs to set, highest used IN endpoint + 1 */
+} USBD_FifoPlanTypeDef;
+
+#if USBD_SUPPORT_ISO_FAST_PATH
+/* Called from the OTG interrupt when a transfer completes on a registered endpoint.
+   It replaces the class DataIn/DataOut callback for this endpoint. */
+typedef void (*USBD_IsoFastPathCallbackTypeDef)(USBD_HandleTypeDef *pdev, uint8_t epnum, void* private_data);
+#endif /* USBD_SUPPORT_ISO_FAST_PATH */
+/**
+  * @}
+  */ 
+
+/** @defgroup USBD_CORE_EX_Exported_FunctionsPrototype
+  * @{
+  */ 
+#if USBD_SUPPORT_ISO_FAST_PATH
+USBD_StatusTypeDef USBD_LL_RegisterIsoFastPath(USBD_HandleTypeDef *pdev, uint8_t ep_addr,
+                                               USBD_IsoFastPathCallbackTypeDef callback, void* private_data);
+USBD_StatusTypeDef USBD_LL_UnRegisterIsoFastPath(USBD_HandleTypeDef *pdev, uint8_t ep_addr);
+#endif /* USBD_SUPPORT_ISO_FAST_PATH */
+USBD_StatusTypeDef USBD_LL_PlanFifo(const USBD_FifoRequestTypeDef *request, USBD_FifoPlanTypeDef *plan);
+/**
+  * @}
+  */ 
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __USBD_CORE_EX_H */
+
+/**
+  * @}
+  */ 
+
+/**
+* @}
+*/ 
+
+/************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
@@ -7,6 +7,8 @@
   *          modified functions : 
   *                                - USBD_LL_IsoINIncomplete:  calls class to handle ISOC incomplete IN event
   *                                - USBD_LL_IsoOUTIncomplete: calls class to handle ISOC incomplete OUT event
+  *                                - USBD_LL_DataOutStage/USBD_LL_DataInStage: calls registered ISOC fast path
+  *                                - USBD_LL_RegisterIsoFastPath/USBD_LL_UnRegisterIsoFastPath: new functions
   *                                
   ******************************************************************************
   * @attention
@@ -23,7 +25,7 @@
   */ 
 
 /* Includes ------------------------------------------------------------------*/
-#include "usbd_core.h"
+#include "usbd_core_ex.h"
 
 /** @addtogroup STM32_USBD_DEVICE_LIBRARY
 * @{
@@ -38,6 +40,13 @@
 /** @defgroup USBD_CORE_Private_TypesDefinitions
 * @{
 */ 
+#if USBD_SUPPORT_ISO_FAST_PATH
+typedef struct
+{
+  USBD_IsoFastPathCallbackTypeDef callback;
+  void* private_data;
+}USBD_IsoFastPathTypeDef;
+#endif /* USBD_SUPPORT_ISO_FAST_PATH */
 /**
 * @}
 */ 
@@ -46,6 +55,9 @@
 /** @defgroup USBD_CORE_Private_Defines
 * @{
 */ 
+#if USBD_SUPPORT_ISO_FAST_PATH
+#define USBD_ISO_FAST_PATH_EP_COUNT 16U
+#endif /* USBD_SUPPORT_ISO_FAST_PATH */
 
 /**
 * @}
@@ -73,6 +85,11 @@
 /** @defgroup USBD_CORE_Private_Variables
 * @{
 */ 
+#if USBD_SUPPORT_ISO_FAST_PATH
+/* one table per direction, indexed by endpoint number. only one core instance is used */
+static USBD_IsoFastPathTypeDef USBD_IsoFastPathIn[USBD_ISO_FAST_PATH_EP_COUNT];
+static USBD_IsoFastPathTypeDef USBD_IsoFastPathOut[USBD_ISO_FAST_PATH_EP_COUNT];
+#endif /* USBD_SUPPORT_ISO_FAST_PATH */
 
 /**
 * @}
@@ -297,6 +314,13 @@ USBD_StatusTypeDef USBD_LL_DataOutStage(USBD_HandleTypeDef *pdev , uint8_t epnum
 {
   USBD_EndpointTypeDef    *pep;
   
+#if USBD_SUPPORT_ISO_FAST_PATH
+  if(USBD_IsoFastPathOut[epnum&0x0F].callback != NULL)
+  {
+    USBD_IsoFastPathOut[epnum&0x0F].callback(pdev, epnum, USBD_IsoFastPathOut[epnum&0x0F].private_data);
+    return USBD_OK;
+  }
+#endif /* USBD_SUPPORT_ISO_FAST_PATH */
   if(epnum == 0) 
   {
     pep = &pdev->ep_out[0];
@@ -341,6 +365,13 @@ USBD_StatusTypeDef USBD_LL_DataInStage(USBD_HandleTypeDef *pdev ,uint8_t epnum,
 {
   USBD_EndpointTypeDef    *pep;
     
+#if USBD_SUPPORT_ISO_FAST_PATH
+  if(USBD_IsoFastPathIn[epnum&0x0F].callback != NULL)
+  {
+    USBD_IsoFastPathIn[epnum&0x0F].callback(pdev, epnum, USBD_IsoFastPathIn[epnum&0x0F].private_data);
+    return USBD_OK;
+  }
+#endif /* USBD_SUPPORT_ISO_FAST_PATH */
   if(epnum == 0) 
   {
     pep = &pdev->ep_in[0];
@@ -558,6 +589,148 @@ USBD_StatusTypeDef USBD_LL_DevDisconnected(USBD_HandleTypeDef  *pdev)
    
   return USBD_OK;
 }
+
+#if USBD_SUPPORT_ISO_FAST_PATH
+/**
+* @brief  USBD_LL_RegisterIsoFastPath 
+*         Bind a data endpoint to a callback called directly from the data stage,
+*         without going through control pipe checks and the class DataIn/DataOut.
+* @param  pdev: device instance
+* @param  ep_addr: endpoint address (bit 7 set for IN endpoints), must not be EP0
+* @param  callback: function called on each transfer complete event of the endpoint
+* @param  private_data: parameter passed to callback
+* @retval status
+*/
+USBD_StatusTypeDef USBD_LL_RegisterIsoFastPath(USBD_HandleTypeDef *pdev, uint8_t ep_addr,
+                                               USBD_IsoFastPathCallbackTypeDef callback, void* private_data)
+{
+  USBD_IsoFastPathTypeDef *fast_path;
+  
+  if(((ep_addr&0x0F) == 0)||(callback == NULL))
+  {
+    return USBD_FAIL;
+  }
+  fast_path = (ep_addr&0x80)?&USBD_IsoFastPathIn[ep_addr&0x0F]:&USBD_IsoFastPathOut[ep_addr&0x0F];
+  fast_path->private_data = private_data;
+  fast_path->callback = callback;
+  return USBD_OK;
+}
+
+/**
+* @brief  USBD_LL_UnRegisterIsoFastPath 
+*         Restore the default data stage handling of an endpoint
+* @param  pdev: device instance
+* @param  ep_addr: endpoint address
+* @retval status
+*/
+USBD_StatusTypeDef USBD_LL_UnRegisterIsoFastPath(USBD_HandleTypeDef *pdev, uint8_t ep_addr)
+{
+  USBD_IsoFastPathTypeDef *fast_path;
+  
+  fast_path = (ep_addr&0x80)?&USBD_IsoFastPathIn[ep_addr&0x0F]:&USBD_IsoFastPathOut[ep_addr&0x0F];
+  fast_path->callback = NULL;
+  fast_path->private_data = NULL;
+  return USBD_OK;
+}
+#endif /* USBD_SUPPORT_ISO_FAST_PATH */
+
+/**
+* @brief  USBD_LL_PlanFifo 
+*         Plans the layout of the OTG FIFO RAM. Each endpoint first gets one packet, then while words
+*         are left, the isochronous IN endpoints are double buffered, a second packet of each isochronous
+*         OUT endpoint is reserved in RX FIFO and EP0 gets its burst. The remaining words go to the
+*         streaming IN endpoint. Only computes the layout, the low level driver applies it
+* @param  request: FIFO size and endpoints
+* @param  plan: RX and TX FIFO sizes
+* @retval status USBD_FAIL when one packet per endpoint doesn't fit
+*/
+USBD_StatusTypeDef USBD_LL_PlanFifo(const USBD_FifoRequestTypeDef *request, USBD_FifoPlanTypeDef *plan)
+{
+  uint32_t used_size;
+  uint32_t free_size;
+  uint32_t extra_size;
+  uint16_t largest_out = 0;
+  uint8_t i;
+  
+  /* minimal layout : one packet per endpoint, the RX FIFO holds the largest OUT packet */
+  plan->tx_fifo_count = 1;
+  for(i = 0; i < USBD_FIFO_MAX_EP; i++)
+  {
+    largest_out = (request->out_mps[i] > largest_out)? request->out_mps[i] : largest_out;
+    plan->tx_word_size[i] = 0;
+    if(request->in_mps[i] != 0)
+    {
+      plan->tx_fifo_count = i + 1;
+    }
+  }
+  if(request->stream_in_ep >= plan->tx_fifo_count)
+  {
+    return USBD_FAIL;
+  }
+  plan->rx_word_size = USBD_FIFO_RX_FIXED_WORD_SIZE + USBD_FIFO_PACKET_WORD_SIZE(largest_out) + 1U +
+                       2U*request->out_ep_count;
+  used_size = plan->rx_word_size;
+  for(i = 0; i < plan->tx_fifo_count; i++)
+  {
+    plan->tx_word_size[i] = (USBD_FIFO_PACKET_WORD_SIZE(request->in_mps[i]) > USBD_FIFO_TX_EP_MIN_WORD_SIZE)?
+                            USBD_FIFO_PACKET_WORD_SIZE(request->in_mps[i]) : USBD_FIFO_TX_EP_MIN_WORD_SIZE;
+    used_size += plan->tx_word_size[i];
+  }
+  if(used_size > request->fifo_word_size)
+  {
+    return USBD_FAIL;
+  }
+  free_size = request->fifo_word_size - used_size;
+  
+  /* double buffering of the isochronous IN endpoints */
+  for(i = 0; i < plan->tx_fifo_count; i++)
+  {
+    if(request->in_iso & (1U << i))
+    {
+      extra_size = 2U*USBD_FIFO_PACKET_WORD_SIZE(request->in_mps[i]);
+      extra_size = (extra_size > plan->tx_word_size[i])? extra_size - plan->tx_word_size[i] : 0;
+      if(extra_size <= free_size)
+      {
+        plan->tx_word_size[i] += extra_size;
+        free_size -= extra_size;
+      }
+    }
+  }
+  
+  /* second packet of the isochronous OUT endpoints and its status word */
+  for(i = 0; i < USBD_FIFO_MAX_EP; i++)
+  {
+    if(request->out_iso & (1U << i))
+    {
+      extra_size = USBD_FIFO_PACKET_WORD_SIZE(request->out_mps[i]) + 1U;
+      if(extra_size <= free_size)
+      {
+        plan->rx_word_size += extra_size;
+        free_size -= extra_size;
+      }
+    }
+  }
+  
+  /* EP0 burst sent in one shot */
+  extra_size = USBD_FIFO_PACKET_WORD_SIZE(request->ep0_burst_size);
+  extra_size = (extra_size > plan->tx_word_size[0])? extra_size - plan->tx_word_size[0] : 0;
+  if(extra_size <= free_size)
+  {
+    plan->tx_word_size[0] += extra_size;
+    free_size -= extra_size;
+  }
+  
+  /* remaining words */
+  if(request->stream_in_ep != 0)
+  {
+    plan->tx_word_size[request->stream_in_ep] += free_size;
+  }
+  else
+  {
+    plan->rx_word_size += free_size;
+  }
+  return USBD_OK;
+}
 /**
 * @}
 */ 
@@ -0,0 +1,99 @@
+/**
+  ******************************************************************************
+  * @file    audio_beamformer_node.h
+  * @author  MCD Application Team
+  * @brief   header of audio_beamformer_node.c
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2019  STMicroelectronics.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by ST under Ultimate Liberty license
+  * SLA0044, the "License"; You may not use this file except in compliance with
+  * the License. You may obtain a copy of the License at:
+  *                             www.st.com/SLA0044
+  *
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __AUDIO_BEAMFORMER_NODE_H
+#define __AUDIO_BEAMFORMER_NODE_H
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdint.h>
+#include "usb_audio_user_cfg.h"
+#include "audio_graph.h"
+
+/* Exported constants --------------------------------------------------------*/
+#define AUDIO_BEAMFORMER_MAX_MICS             4U
+#define AUDIO_BEAMFORMER_MAX_BEAMS            2U
+/* fractional delays are third order Lagrange interpolators, taps are Q2.30 fixed point values */
+#define AUDIO_BEAMFORMER_TAPS                 4U
+#define AUDIO_BEAMFORMER_TAP_FRACTION_BITS    30U
+/* samples kept per microphone, power of 2. The largest delay plus the taps must fit, which bounds the
+   aperture of the array: 60 samples are 428 mm at 48 KHz, 107 mm at 192 KHz */
+#define AUDIO_BEAMFORMER_HISTORY              64U
+#define AUDIO_BEAMFORMER_SOUND_SPEED_MM_S     343000.0f
+/* steering angle range in degrees */
+#define AUDIO_BEAMFORMER_MAX_ANGLE            180
+
+/* Exported types ------------------------------------------------------------*/
+/* microphone position in the array plane. The front of the array is +y, angle 0, positive angles turn to +x */
+typedef struct
+{
+  float x_mm;
+  float y_mm;
+} AUDIO_BeamformerMic_t;
+
+/* delay and sum of a beam, each microphone is delayed by a history offset and a fractional delay filter */
+typedef struct
+{
+  uint8_t delay[AUDIO_BEAMFORMER_MAX_MICS];                             /* history offset of the first tap */
+  int32_t taps[AUDIO_BEAMFORMER_MAX_MICS][AUDIO_BEAMFORMER_TAPS];       /* scaled by 1 / microphones count */
+} AUDIO_BeamformerSteering_t;
+
+/* steering of all beams, the node designs a new set next to the one in use */
+typedef struct
+{
+  AUDIO_BeamformerSteering_t beams[AUDIO_BEAMFORMER_MAX_BEAMS];
+} AUDIO_BeamformerCoefficients_t;
+
+/* beamformer node, reduces a block of the array channels to a block of beams, in place */
+typedef struct
+{
+  AUDIO_ProcessingNode_t         processing;                            /* must be first field */
+  AUDIO_BeamformerMic_t          mics[AUDIO_BEAMFORMER_MAX_MICS];       /* in the order of the captured channels */
+  uint8_t                        mics_count;
+  uint8_t                        beams_count;                           /* output channels */
+  int16_t                        angles[AUDIO_BEAMFORMER_MAX_BEAMS];    /* steering of each beam in degrees */
+  AUDIO_BeamformerCoefficients_t coefficients[2];
+  uint8_t                        active;                                /* set of coefficients in use */
+  volatile uint8_t               requested;                             /* an angle changed, designed on next block */
+  int32_t                        history[AUDIO_BEAMFORMER_MAX_MICS][2 * AUDIO_BEAMFORMER_HISTORY]; /* Q1.31, mirrored */
+  uint16_t                       position;                              /* history index of the last sample */
+  uint32_t                       frequency;                             /* stream sampling rate, 0 before first block */
+  uint8_t                        format;                                /* AUDIO_GRAPH_FORMAT_xxx */
+} AUDIO_BeamformerNode_t;
+
+/* Exported functions ------------------------------------------------------- */
+#if USE_AUDIO_RECORDING_BEAMFORMER
+int8_t  AUDIO_BeamformerInit(AUDIO_BeamformerNode_t* beamformer, const AUDIO_BeamformerMic_t* mics, uint8_t mics_count,
+                             uint8_t beams_count);
+int8_t  AUDIO_BeamformerSetAngle(AUDIO_BeamformerNode_t* beamformer, uint16_t channel_number, int angle_deg);
+int8_t  AUDIO_BeamformerDesignSteering(const AUDIO_BeamformerMic_t* mics, uint8_t mics_count, int angle_deg,
+                                       uint32_t frequency, AUDIO_BeamformerSteering_t* steering);
+#endif /* USE_AUDIO_RECORDING_BEAMFORMER */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* __AUDIO_BEAMFORMER_NODE_H */
+
+/************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
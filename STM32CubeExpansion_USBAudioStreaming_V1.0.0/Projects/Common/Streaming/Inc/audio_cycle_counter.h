@@ -0,0 +1,106 @@
+/**
+  ******************************************************************************
+  * @file    audio_cycle_counter.h
+  * @author  MCD Application Team
+  * @brief   DWT cycle counter start and read, shared by the scheduler, the
+  *          profiler and the trace. Must be included after the device header.
+  *          Host builds (USE_AUDIO_HOST_CLOCK set to 1 by their usbd_conf.h)
+  *          count the nanoseconds of the monotonic clock instead.
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2019  STMicroelectronics.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by ST under Ultimate Liberty license
+  * SLA0044, the "License"; You may not use this file except in compliance with
+  * the License. You may obtain a copy of the License at:
+  *                             www.st.com/SLA0044
+  *
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __AUDIO_CYCLE_COUNTER_H
+#define __AUDIO_CYCLE_COUNTER_H
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+#if defined(USE_AUDIO_HOST_CLOCK) && USE_AUDIO_HOST_CLOCK
+/* Includes ------------------------------------------------------------------*/
+#include <time.h>
+
+/* Exported constants --------------------------------------------------------*/
+#define AUDIO_CYCLE_COUNTER_FREQ               1000000000U /* counts nanoseconds */
+
+/* Exported functions ------------------------------------------------------- */
+/**
+  * @brief  AUDIO_CycleCounterInit
+  *         The monotonic clock always runs.
+  * @param  None
+  * @retval 0
+  */
+static inline int8_t AUDIO_CycleCounterInit(void)
+{
+  return 0;
+}
+
+/**
+  * @brief  AUDIO_CycleCounterGet
+  *         Reads the monotonic clock, wrapping on 32 bits as the DWT counter.
+  * @param  None
+  * @retval count of nanoseconds
+  */
+static inline uint32_t AUDIO_CycleCounterGet(void)
+{
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint32_t)((uint64_t)now.tv_sec*1000000000U + (uint64_t)now.tv_nsec);
+}
+#else /* USE_AUDIO_HOST_CLOCK */
+/* Exported constants --------------------------------------------------------*/
+#define AUDIO_CYCLE_COUNTER_FREQ               SystemCoreClock
+
+/* Exported functions ------------------------------------------------------- */
+/**
+  * @brief  AUDIO_CycleCounterInit
+  *         Starts the DWT cycle counter, calling it again has no effect.
+  * @param  None
+  * @retval 0 if no error, -1 if the cycle counter is not implemented
+  */
+__STATIC_INLINE int8_t AUDIO_CycleCounterInit(void)
+{
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+#if (__CORTEX_M == 7U)
+  DWT->LAR = 0xC5ACCE55U; /* unlock DWT access */
+#endif /* (__CORTEX_M == 7U) */
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+  if((DWT->CTRL & DWT_CTRL_CYCCNTENA_Msk) == 0U)
+  {
+    return -1;
+  }
+  return 0;
+}
+
+/**
+  * @brief  AUDIO_CycleCounterGet
+  *         Reads the DWT cycle counter.
+  * @param  None
+  * @retval count of core cycles
+  */
+__STATIC_INLINE uint32_t AUDIO_CycleCounterGet(void)
+{
+  return DWT->CYCCNT;
+}
+#endif /* USE_AUDIO_HOST_CLOCK */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* __AUDIO_CYCLE_COUNTER_H */
+
+/************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
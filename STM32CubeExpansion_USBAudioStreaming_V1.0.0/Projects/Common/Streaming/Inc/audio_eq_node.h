@@ -0,0 +1,116 @@
+/**
+  ******************************************************************************
+  * @file    audio_eq_node.h
+  * @author  MCD Application Team
+  * @brief   header of audio_eq_node.c
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2019  STMicroelectronics.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by ST under Ultimate Liberty license
+  * SLA0044, the "License"; You may not use this file except in compliance with
+  * the License. You may obtain a copy of the License at:
+  *                             www.st.com/SLA0044
+  *
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __AUDIO_EQ_NODE_H
+#define __AUDIO_EQ_NODE_H
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdint.h>
+#include "usb_audio_user_cfg.h"
+#include "audio_graph.h"
+
+/* Exported constants --------------------------------------------------------*/
+#define AUDIO_EQ_MAX_BANDS                    10U  /* biquads per channel */
+#define AUDIO_EQ_MAX_CHANNELS                 2U
+/* coefficients are Q3.28 fixed point values, samples are processed in Q1.31 */
+#define AUDIO_EQ_COEF_FRACTION_BITS           28U
+#define AUDIO_EQ_MAX_GAIN_DB_256              (15 * 256)  /* band gain range is +/- 15 db */
+
+/* filter structures */
+#define AUDIO_EQ_DF1                          0x00 /* direct form 1, 32 bits state */
+#define AUDIO_EQ_DF2T                         0x01 /* transposed direct form 2, 64 bits state */
+
+/* band types */
+#define AUDIO_EQ_BAND_OFF                     0x00
+#define AUDIO_EQ_BAND_PEAK                    0x01
+#define AUDIO_EQ_BAND_LOW_SHELF               0x02
+#define AUDIO_EQ_BAND_HIGH_SHELF              0x03
+#define AUDIO_EQ_BAND_LOW_PASS                0x04
+#define AUDIO_EQ_BAND_HIGH_PASS               0x05
+
+/* Exported types ------------------------------------------------------------*/
+/* parametric band, coefficients are computed for the sampling rate of the stream */
+typedef struct
+{
+  uint8_t  type;            /* AUDIO_EQ_BAND_xxx */
+  uint32_t frequency;       /* center or cut-off frequency in Hz */
+  float    q;               /* quality factor, shelf slope for shelves */
+  int      gain_db_256;     /* peak and shelf gain in 1/256 db */
+} AUDIO_EqBand_t;
+
+/* biquad, y = b0.x + b1.x1 + b2.x2 + a1.y1 + a2.y2 (a1 and a2 are negated) */
+typedef struct
+{
+  int32_t b0, b1, b2, a1, a2;
+} AUDIO_EqBiquad_t;
+
+/* state of a biquad */
+typedef union
+{
+  struct
+  {
+    int32_t x1, x2, y1, y2;
+  } df1;
+  struct
+  {
+    int64_t d1, d2;
+  } df2t;
+} AUDIO_EqState_t;
+
+/* coefficients of all channels, the node runs one set while the controls fill the other one */
+typedef struct
+{
+  AUDIO_EqBiquad_t biquads[AUDIO_EQ_MAX_CHANNELS][AUDIO_EQ_MAX_BANDS];
+  uint8_t          stages_count[AUDIO_EQ_MAX_CHANNELS];
+} AUDIO_EqCoefficients_t;
+
+/* equalizer node, a cascade of biquads per channel processed in place */
+typedef struct
+{
+  AUDIO_ProcessingNode_t processing;                                    /* must be first field */
+  uint8_t                form;                                          /* AUDIO_EQ_DF1 or AUDIO_EQ_DF2T */
+  AUDIO_EqBand_t         bands[AUDIO_EQ_MAX_CHANNELS][AUDIO_EQ_MAX_BANDS];
+  AUDIO_EqCoefficients_t coefficients[2];
+  volatile uint8_t       active;                                        /* set of coefficients in use */
+  volatile uint8_t       pending;                                       /* other set is ready, swapped on next block */
+  AUDIO_EqState_t        state[AUDIO_EQ_MAX_CHANNELS][AUDIO_EQ_MAX_BANDS];
+  uint32_t               frequency;                                     /* stream sampling rate, 0 before first block */
+  uint8_t                channels_count;
+  uint8_t                format;                                        /* AUDIO_GRAPH_FORMAT_xxx */
+} AUDIO_EqNode_t;
+
+/* Exported functions ------------------------------------------------------- */
+#if USE_AUDIO_PLAYBACK_EQ
+int8_t  AUDIO_EqInit(AUDIO_EqNode_t* eq, uint8_t form);
+int8_t  AUDIO_EqSetBand(AUDIO_EqNode_t* eq, uint16_t channel_number, uint8_t band, const AUDIO_EqBand_t* params);
+int8_t  AUDIO_EqDesignBiquad(const AUDIO_EqBand_t* params, uint32_t frequency, AUDIO_EqBiquad_t* biquad);
+#endif /* USE_AUDIO_PLAYBACK_EQ */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* __AUDIO_EQ_NODE_H */
+
+/************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
@@ -0,0 +1,71 @@
+/**
+  ******************************************************************************
+  * @file    audio_gain_node.h
+  * @author  MCD Application Team
+  * @brief   header of audio_gain_node.c
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2019  STMicroelectronics.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by ST under Ultimate Liberty license
+  * SLA0044, the "License"; You may not use this file except in compliance with
+  * the License. You may obtain a copy of the License at:
+  *                             www.st.com/SLA0044
+  *
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __AUDIO_GAIN_NODE_H
+#define __AUDIO_GAIN_NODE_H
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdint.h>
+#include "usb_audio_user_cfg.h"
+#include "audio_graph.h"
+
+/* Exported constants --------------------------------------------------------*/
+#define AUDIO_GAIN_MAX_CHANNELS               8U
+/* gains are Q8.24 fixed point values */
+#define AUDIO_GAIN_FRACTION_BITS              24U
+#define AUDIO_GAIN_UNITY                      (1L << AUDIO_GAIN_FRACTION_BITS)
+/* volume range, lower volumes (as the USB -infinity 0x8000) are silence */
+#define AUDIO_GAIN_MIN_DB_256                 (-96 * 256)  /* -96 db */
+#define AUDIO_GAIN_MAX_DB_256                 (42 * 256)   /* +42 db, highest whole db gain below 128 */
+
+/* Exported types ------------------------------------------------------------*/
+/* gain node, volume and mute of the master channel (0) and of each channel (1 to AUDIO_GAIN_MAX_CHANNELS).
+   The gain of a channel is the sum of its volume and of the master volume, it moves linearly along each
+   block from its previous value to the requested one, so volume changes don't make zipper noise */
+typedef struct
+{
+  AUDIO_ProcessingNode_t processing;                               /* must be first field */
+  int                    volume_db_256[AUDIO_GAIN_MAX_CHANNELS + 1];
+  uint8_t                mute[AUDIO_GAIN_MAX_CHANNELS + 1];
+  volatile int32_t       target[AUDIO_GAIN_MAX_CHANNELS];          /* gain requested by the controls */
+  int32_t                gain[AUDIO_GAIN_MAX_CHANNELS];            /* gain at the end of the last block */
+  uint8_t                channels_count;
+  uint8_t                format;                                   /* AUDIO_GRAPH_FORMAT_xxx */
+} AUDIO_GainNode_t;
+
+/* Exported functions ------------------------------------------------------- */
+#if USE_AUDIO_SOFTWARE_VOLUME
+int8_t  AUDIO_GainInit(AUDIO_GainNode_t* gain);
+int8_t  AUDIO_GainSetVolume(uint16_t channel_number, int volume_db_256, uint32_t node_handle);
+int8_t  AUDIO_GainSetMute(uint16_t channel_number, uint8_t mute, uint32_t node_handle);
+int32_t AUDIO_GainFromDb256(int volume_db_256);
+#endif /* USE_AUDIO_SOFTWARE_VOLUME */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* __AUDIO_GAIN_NODE_H */
+
+/************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
@@ -0,0 +1,126 @@
+/**
+  ******************************************************************************
+  * @file    audio_graph.h
+  * @author  MCD Application Team
+  * @brief   header of audio_graph.c
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2019  STMicroelectronics.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by ST under Ultimate Liberty license
+  * SLA0044, the "License"; You may not use this file except in compliance with
+  * the License. You may obtain a copy of the License at:
+  *                             www.st.com/SLA0044
+  *
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __AUDIO_GRAPH_H
+#define __AUDIO_GRAPH_H
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdint.h>
+#include <string.h>
+#include "usb_audio_user_cfg.h"
+#include "audio_node.h"
+
+/* Exported constants --------------------------------------------------------*/
+#define AUDIO_GRAPH_MAX_NODES                 8U
+
+/* sample formats, the value is the sample size in bytes */
+#define AUDIO_GRAPH_FORMAT_S16                2U /* 16 bits */
+#define AUDIO_GRAPH_FORMAT_S24                3U /* 24 bits packed */
+#define AUDIO_GRAPH_FORMAT_S32                4U /* 32 bits, or 24 bits MSB aligned in 32 bits */
+
+/* processing node flags */
+#define AUDIO_PROCESSING_IN_PLACE             0x01 /* output is written over the input */
+
+/* graph states */
+#define AUDIO_GRAPH_NOT_PLANNED               0x00
+#define AUDIO_GRAPH_PLANNED                   0x01
+#define AUDIO_GRAPH_ERROR                     0x02 /* plan failed, blocks are left unprocessed */
+
+/* Exported types ------------------------------------------------------------*/
+/* type of the samples flowing between two nodes */
+typedef struct
+{
+  uint32_t frequency;
+  uint8_t  channels_count;
+  uint8_t  format;          /* AUDIO_GRAPH_FORMAT_xxx */
+} AUDIO_GraphPort_t;
+
+/* contiguous block of interleaved samples */
+typedef struct
+{
+  uint8_t*                 data;
+  uint16_t                 length;  /* in bytes */
+  uint16_t                 frames;  /* samples count per channel */
+  const AUDIO_GraphPort_t* port;
+} AUDIO_GraphSpan_t;
+
+/* standard interface of a processing stage, specific nodes embed it as first member */
+typedef struct AUDIO_ProcessingNode
+{
+  AUDIO_Node_t node;        /* node.type is AUDIO_PROCESSING */
+  uint8_t      flags;       /* AUDIO_PROCESSING_xxx */
+  uint16_t     latency_frames; /* delay added by the node (look-ahead), set by ProcessingConfigure, summed by the graph */
+  /* called when the graph is planned: checks in_port, sets out_port (initialized to in_port) and resets the node state */
+  int8_t  (*ProcessingConfigure)(const AUDIO_GraphPort_t* /*in_port*/, AUDIO_GraphPort_t* /*out_port*/, uint32_t /*node_handle*/);
+  /* processes one block, for in place nodes out->data is in->data. out->length and out->frames are set by the graph */
+  int8_t  (*ProcessingRun)(const AUDIO_GraphSpan_t* /*in*/, AUDIO_GraphSpan_t* /*out*/, uint32_t /*node_handle*/);
+} AUDIO_ProcessingNode_t;
+
+/* chain of processing nodes applied to each block of a session */
+typedef struct AUDIO_Graph
+{
+  AUDIO_ProcessingNode_t* nodes[AUDIO_GRAPH_MAX_NODES];
+  AUDIO_GraphPort_t       ports[AUDIO_GRAPH_MAX_NODES + 1]; /* ports[0] graph input, ports[i + 1] output of node i */
+  uint8_t                 node_count;
+  uint8_t                 state;          /* AUDIO_GRAPH_xxx */
+  uint8_t                 scratch_map;    /* bit i set when node i writes to scratch buffer, else to the block */
+  uint8_t*                scratch;        /* working buffer for out of place nodes, 4 bytes aligned */
+  uint16_t                scratch_size;
+  uint16_t                max_frames;     /* max frames count of a block, limited by the scratch size */
+  uint32_t                latency_frames; /* sum of the nodes latencies, for inspection. The host only knows the
+                                             compile time part, reported in the AS interface bDelay */
+} AUDIO_Graph_t;
+
+/* Exported macros -----------------------------------------------------------*/
+#if USE_AUDIO_PROCESSING_GRAPH
+/* AUDIO_SESSION_PROCESS is used by nodes to apply the session processing on a block before consuming it.
+   A block whose processing failed may be partially processed, it is replaced by silence */
+#define AUDIO_SESSION_PROCESS(session, port, data, length) \
+        do{ \
+          if(((session)->graph) && \
+             (AUDIO_GraphProcess((session)->graph, (port), (data), (length)) != 0)) \
+          { \
+            memset((data), 0, (length)); \
+          } \
+        }while(0)
+#else  /* USE_AUDIO_PROCESSING_GRAPH */
+#define AUDIO_SESSION_PROCESS(session, port, data, length)
+#endif /* USE_AUDIO_PROCESSING_GRAPH */
+#define AUDIO_GRAPH_FRAME_SIZE(port) ((uint16_t)((port)->channels_count * (port)->format))
+
+/* Exported functions ------------------------------------------------------- */
+#if USE_AUDIO_PROCESSING_GRAPH
+int8_t  AUDIO_GraphInit(AUDIO_Graph_t* graph, uint8_t* scratch, uint16_t scratch_size);
+int8_t  AUDIO_GraphAddNode(AUDIO_Graph_t* graph, AUDIO_ProcessingNode_t* node);
+int8_t  AUDIO_GraphPlan(AUDIO_Graph_t* graph, const AUDIO_GraphPort_t* port);
+int8_t  AUDIO_GraphProcess(AUDIO_Graph_t* graph, const AUDIO_GraphPort_t* port, uint8_t* data, uint16_t length);
+#endif /* USE_AUDIO_PROCESSING_GRAPH */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* __AUDIO_GRAPH_H */
+
+/************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
@@ -0,0 +1,88 @@
+/**
+  ******************************************************************************
+  * @file    audio_limiter_node.h
+  * @author  MCD Application Team
+  * @brief   header of audio_limiter_node.c
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2019  STMicroelectronics.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by ST under Ultimate Liberty license
+  * SLA0044, the "License"; You may not use this file except in compliance with
+  * the License. You may obtain a copy of the License at:
+  *                             www.st.com/SLA0044
+  *
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __AUDIO_LIMITER_NODE_H
+#define __AUDIO_LIMITER_NODE_H
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdint.h>
+#include "usb_audio_user_cfg.h"
+#include "audio_graph.h"
+
+/* Exported constants --------------------------------------------------------*/
+#define AUDIO_LIMITER_MAX_CHANNELS            2U
+#define AUDIO_LIMITER_MAX_LOOKAHEAD_US        2000U
+/* look-ahead delay of 2 ms at 192 KHz, the gain window is one frame longer */
+#define AUDIO_LIMITER_MAX_DELAY_FRAMES        384U
+#define AUDIO_LIMITER_MAX_WINDOW_FRAMES       (AUDIO_LIMITER_MAX_DELAY_FRAMES + 1U)
+/* gains are Q8.23 fixed point values, a window of gains sums in 32 bits */
+#define AUDIO_LIMITER_GAIN_FRACTION_BITS      23U
+#define AUDIO_LIMITER_GAIN_UNITY              (1L << AUDIO_LIMITER_GAIN_FRACTION_BITS)
+
+/* Exported types ------------------------------------------------------------*/
+typedef struct
+{
+  int      ceiling_db_256;  /* highest output peak in 1/256 db, 0 or lower */
+  uint16_t lookahead_us;    /* 0 to AUDIO_LIMITER_MAX_LOOKAHEAD_US, the gain reaches its value when the peak is played */
+  uint16_t release_ms;      /* time constant of the gain recovery */
+} AUDIO_LimiterParams_t;
+
+/* look-ahead peak limiter, channels share the gain so the stereo image doesn't move.
+   The required gain of each frame is held over the look-ahead window (running minimum) then averaged
+   over the same window, so the gain ramps down during the look-ahead and reaches the required gain
+   when the peak frame goes out of the delay line. Gain rises back with the release time constant */
+typedef struct
+{
+  AUDIO_ProcessingNode_t processing;                               /* must be first field */
+  AUDIO_LimiterParams_t  params;
+  int32_t                ceiling;                                  /* Q1.31, on the output format LSB */
+  uint32_t               release_coef;                             /* Q1.31 */
+  int32_t                gain;                                     /* applied gain */
+  uint32_t               sum;                                      /* sum of the averaged window */
+  uint32_t               frame_count;                              /* index of the last input frame */
+  uint16_t               window_frames;                            /* look-ahead delay + 1 */
+  uint16_t               window_pos;
+  uint16_t               delay_pos;
+  uint16_t               min_head;                                 /* running minimum queue, increasing gains */
+  uint16_t               min_count;
+  uint8_t                channels_count;
+  uint8_t                format;                                   /* AUDIO_GRAPH_FORMAT_xxx */
+  int32_t                average[AUDIO_LIMITER_MAX_WINDOW_FRAMES];
+  int32_t                min_gain[AUDIO_LIMITER_MAX_WINDOW_FRAMES];
+  uint32_t               min_frame[AUDIO_LIMITER_MAX_WINDOW_FRAMES];
+  int32_t                delay[AUDIO_LIMITER_MAX_DELAY_FRAMES][AUDIO_LIMITER_MAX_CHANNELS];
+} AUDIO_LimiterNode_t;
+
+/* Exported functions ------------------------------------------------------- */
+#if USE_AUDIO_PLAYBACK_LIMITER
+int8_t  AUDIO_LimiterInit(AUDIO_LimiterNode_t* limiter, const AUDIO_LimiterParams_t* params);
+#endif /* USE_AUDIO_PLAYBACK_LIMITER */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* __AUDIO_LIMITER_NODE_H */
+
+/************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
@@ -0,0 +1,99 @@
+/**
+  ******************************************************************************
+  * @file    audio_mixer_node.h
+  * @author  MCD Application Team
+  * @brief   header of audio_mixer_node.c
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2019  STMicroelectronics.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by ST under Ultimate Liberty license
+  * SLA0044, the "License"; You may not use this file except in compliance with
+  * the License. You may obtain a copy of the License at:
+  *                             www.st.com/SLA0044
+  *
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __AUDIO_MIXER_NODE_H
+#define __AUDIO_MIXER_NODE_H
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdint.h>
+#include "usb_audio_user_cfg.h"
+#include "audio_node.h"
+#include "audio_graph.h"
+
+/* Exported constants --------------------------------------------------------*/
+#define AUDIO_MIXER_MAX_INPUTS                4U
+#define AUDIO_MIXER_MAX_CHANNELS              2U
+/* gains are Q8.24 fixed point values */
+#define AUDIO_MIXER_GAIN_FRACTION_BITS        24U
+#define AUDIO_MIXER_GAIN_UNITY                (1L << AUDIO_MIXER_GAIN_FRACTION_BITS)
+#define AUDIO_MIXER_MIN_DB_256                (-96 * 256)  /* lower volumes are silence */
+#define AUDIO_MIXER_MAX_DB_256                (12 * 256)
+/* pan range, -AUDIO_MIXER_PAN_MAX is full left, AUDIO_MIXER_PAN_MAX full right */
+#define AUDIO_MIXER_PAN_MAX                   100
+
+/* input states */
+#define AUDIO_MIXER_INPUT_STOPPED             0x00 /* not mixed, waits for its start and threshold */
+#define AUDIO_MIXER_INPUT_RUNNING             0x01
+
+/* Exported types ------------------------------------------------------------*/
+/* stream mixed over the graph block. The input producer (a local source as the sidetone tap) fills the ring and
+   moves its wr_ptr, the mixer reads one block per graph block and moves the rd_ptr. The input starts with a fade
+   in when it is started and the ring holds threshold bytes, frames filled beyond the threshold before the start
+   are skipped. It stops with a fade out when it is stopped or when the ring underruns, then waits for the
+   threshold again. While running, a producer clocked apart from the playback is followed by reading one frame
+   more or less than the block when the averaged filling leaves the threshold, the block is interpolated */
+typedef struct
+{
+  AUDIO_CircularBuffer_t* buffer;                                  /* ring, size is a multiple of the frame size */
+  AUDIO_GraphPort_t       port;                                    /* 1 or 2 channels, rate and format of the graph */
+  uint16_t                threshold;                               /* ring filling in bytes to start the input */
+  volatile uint8_t        requested;                               /* input started by its producer */
+  uint8_t                 state;                                   /* AUDIO_MIXER_INPUT_xxx */
+  int                     volume_db_256;
+  int                     pan;
+  volatile int32_t        target[AUDIO_MIXER_MAX_CHANNELS];        /* left and right gains requested by the controls */
+  int32_t                 gain[AUDIO_MIXER_MAX_CHANNELS];          /* gains at the end of the last block */
+  int32_t                 average_fill;                            /* low pass ring filling in 1/16 frame */
+} AUDIO_MixerInput_t;
+
+/* mixer node, adds its inputs to the graph block */
+typedef struct
+{
+  AUDIO_ProcessingNode_t processing;                               /* must be first field */
+  AUDIO_MixerInput_t*    inputs[AUDIO_MIXER_MAX_INPUTS];
+  uint8_t                inputs_count;
+  uint8_t                channels_count;
+  uint8_t                format;                                   /* AUDIO_GRAPH_FORMAT_xxx */
+  uint32_t               frequency;
+} AUDIO_MixerNode_t;
+
+/* Exported functions ------------------------------------------------------- */
+#if USE_AUDIO_PLAYBACK_MIXER
+int8_t  AUDIO_MixerInit(AUDIO_MixerNode_t* mixer);
+int8_t  AUDIO_MixerInputInit(AUDIO_MixerInput_t* input, AUDIO_CircularBuffer_t* buffer,
+                             const AUDIO_GraphPort_t* port, uint16_t threshold);
+int8_t  AUDIO_MixerAddInput(AUDIO_MixerNode_t* mixer, AUDIO_MixerInput_t* input);
+int8_t  AUDIO_MixerStartInput(AUDIO_MixerInput_t* input);
+int8_t  AUDIO_MixerStopInput(AUDIO_MixerInput_t* input);
+int8_t  AUDIO_MixerSetInputVolume(AUDIO_MixerInput_t* input, int volume_db_256);
+int8_t  AUDIO_MixerSetInputPan(AUDIO_MixerInput_t* input, int pan);
+#endif /* USE_AUDIO_PLAYBACK_MIXER */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* __AUDIO_MIXER_NODE_H */
+
+/************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
@@ -61,6 +61,7 @@ typedef struct
   int                audio_volume_db_256;/* Volume scaled using USB audio class volume definition */
   uint8_t            audio_mute;
   uint8_t            resolution;        
+  uint16_t           block_us;          /* period in microseconds of the blocks exchanged with the audio device */
 }AUDIO_Description_t;
 
 /* List of node types*/
@@ -117,9 +118,22 @@ typedef struct    AUDIO_Session
   int8_t  (*SessionCallback) (AUDIO_SessionEvent_t /* event*/ ,
                               AUDIO_Node_t* /*node_handle*/,
                               struct    AUDIO_Session* /*session handle*/);/* callback will called by nodes when an event is reproduced like overrun or underrun*/
+  uint32_t events_mask; /* events handled by SessionCallback, built with AUDIO_SESSION_EVENT_MASK, others are not sent */
+  struct AUDIO_Graph* graph; /* processing applied by nodes on each block before consuming it, 0 if none */
 }AUDIO_Session_t;
 
 /* Exported macros -----------------------------------------------------------*/ 
+/* AUDIO_SESSION_EVENT_MASK gives the bit of an event in the session events_mask */
+#define AUDIO_SESSION_EVENT_MASK(event) (1UL << (event))
+/* AUDIO_SESSION_NOTIFY is used by nodes to send an event to their session, the callback is called only if
+ * the session handles this event */
+#define AUDIO_SESSION_NOTIFY(session, event, node) \
+        do{ \
+          if(((session)->events_mask & AUDIO_SESSION_EVENT_MASK(event)) != 0U) \
+          { \
+            (session)->SessionCallback((event), (AUDIO_Node_t*)(node), (session)); \
+          } \
+        }while(0)
 /*  AUDIO_BUFFER_FREE_SIZE computes the free size in the circular buffer */
 #define AUDIO_BUFFER_FREE_SIZE(buff)  (((buff)->wr_ptr>=(buff)->rd_ptr)?(buff)->rd_ptr +(buff)->size -(buff)->wr_ptr : \
                                                                           (buff)->rd_ptr -(buff)->wr_ptr)
@@ -151,6 +165,14 @@ typedef struct    AUDIO_Session
 #define AUDIO_USB_MAX_PACKET_SIZE_FROM_AUD_DESC(audio_desc) AUDIO_USB_MAX_PACKET_SIZE((audio_desc)->frequency, (audio_desc)->channels_count, (audio_desc)->resolution)
 #define AUDIO_MS_PACKET_SIZE_FROM_AUD_DESC(audio_desc) AUDIO_MS_PACKET_SIZE((audio_desc)->frequency, (audio_desc)->channels_count, (audio_desc)->resolution)
 #define AUDIO_MS_MAX_PACKET_SIZE_FROM_AUD_DESC(audio_desc) AUDIO_MS_PACKET_SIZE((audio_desc)->frequency + 999, (audio_desc)->channels_count, (audio_desc)->resolution)
+/* AUDIO_BLOCK_SAMPLES_COUNT computes the samples count of a block of block_us microseconds (floor of the fractional count),
+ * AUDIO_BLOCK_SAMPLES_FRAC its fractional part in millionths of sample. For example 44.1KHZ/1000us block is 44 samples + 100000 */
+#define AUDIO_BLOCK_SAMPLES_COUNT(freq,block_us) (((uint32_t)(freq)*(uint32_t)(block_us))/1000000U)
+#define AUDIO_BLOCK_SAMPLES_FRAC(freq,block_us)  (((uint32_t)(freq)*(uint32_t)(block_us))%1000000U)
+/* AUDIO_BLOCK_SIZE computes the nominal size of a block, AUDIO_BLOCK_MAX_SIZE the size of a block carrying the fractional sample */
+#define AUDIO_BLOCK_SIZE(freq,channel_count,res_byte,block_us) (AUDIO_BLOCK_SAMPLES_COUNT(freq,block_us)* (channel_count) * (res_byte))
+#define AUDIO_BLOCK_MAX_SIZE(freq,channel_count,res_byte,block_us) ((AUDIO_BLOCK_SAMPLES_COUNT(freq,block_us) + 1)* (channel_count) * (res_byte))
+#define AUDIO_BLOCK_SIZE_FROM_AUD_DESC(audio_desc) AUDIO_BLOCK_SIZE((audio_desc)->frequency, (audio_desc)->channels_count, (audio_desc)->resolution, (audio_desc)->block_us)
    /* AUDIO_SAMPLE_LENGTH computes 1 sample length. It uses AUDIO_Description_t as argument */
 #define AUDIO_SAMPLE_LENGTH(audio_desc) ( (audio_desc)->channels_count*(audio_desc)->resolution)
 
@@ -0,0 +1,89 @@
+/**
+  ******************************************************************************
+  * @file    audio_profiler.h
+  * @author  MCD Application Team
+  * @brief   header of audio_profiler.c
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2019  STMicroelectronics.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by ST under Ultimate Liberty license
+  * SLA0044, the "License"; You may not use this file except in compliance with
+  * the License. You may obtain a copy of the License at:
+  *                             www.st.com/SLA0044
+  *
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __AUDIO_PROFILER_H
+#define __AUDIO_PROFILER_H
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdint.h>
+#include "usb_audio_user_cfg.h"
+
+#if USE_AUDIO_PROFILER
+/* Exported constants --------------------------------------------------------*/
+#define AUDIO_PROFILER_MAX_DEPTH               8U  /* max count of nested probes */
+#define AUDIO_PROFILER_HISTOGRAM_BINS          16U
+#define AUDIO_PROFILER_HISTOGRAM_FIRST_BIT     6U  /* bin 0 : less than 128 cycles, bin i : [2^(i+6), 2^(i+7)[ cycles */
+
+/* Exported types ------------------------------------------------------------*/
+/* measured code sections */
+typedef enum
+{
+  AUDIO_PROFILER_USB_DATA_OUT = 0,
+  AUDIO_PROFILER_USB_DATA_IN,
+  AUDIO_PROFILER_USB_SOF,
+  AUDIO_PROFILER_AUDIO_OUT_HALF_TRANSFER,
+  AUDIO_PROFILER_AUDIO_OUT_TRANSFER_COMPLETE,
+  AUDIO_PROFILER_AUDIO_IN_HALF_TRANSFER,
+  AUDIO_PROFILER_AUDIO_IN_TRANSFER_COMPLETE,
+  AUDIO_PROFILER_PLAYBACK_SESSION_CALLBACK,
+  AUDIO_PROFILER_RECORDING_SESSION_CALLBACK,
+  AUDIO_PROFILER_DEFERRED_TASK,
+  AUDIO_PROFILER_PROBE_COUNT
+} AUDIO_ProfilerProbe_t;
+
+/* statistics of one probe, times are in cycles and exclude the nested probes */
+typedef struct
+{
+  uint32_t count;                       /* count of executions */
+  uint32_t min_cycles;
+  uint32_t max_cycles;
+  uint64_t total_cycles;                /* used to compute the mean */
+  uint32_t histogram[AUDIO_PROFILER_HISTOGRAM_BINS]; /* log2 distribution of the durations */
+  uint32_t nested_count;                /* count of executions which preempted another probe */
+  uint8_t  max_depth;                   /* max nesting depth, 1 when never nested */
+} AUDIO_ProfilerStats_t;
+
+/* Exported macros -----------------------------------------------------------*/
+#define AUDIO_PROFILER_ENTER(probe)            AUDIO_ProfilerEnter()
+#define AUDIO_PROFILER_EXIT(probe)             AUDIO_ProfilerExit(probe)
+
+/* Exported functions ------------------------------------------------------- */
+int8_t   AUDIO_ProfilerInit(void);
+void     AUDIO_ProfilerReset(void);
+void     AUDIO_ProfilerEnter(void);
+void     AUDIO_ProfilerExit(AUDIO_ProfilerProbe_t probe);
+const AUDIO_ProfilerStats_t* AUDIO_ProfilerGetStats(AUDIO_ProfilerProbe_t probe);
+uint32_t AUDIO_ProfilerGetMeanCycles(AUDIO_ProfilerProbe_t probe);
+#else  /* USE_AUDIO_PROFILER */
+#define AUDIO_PROFILER_ENTER(probe)
+#define AUDIO_PROFILER_EXIT(probe)
+#endif /* USE_AUDIO_PROFILER */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* __AUDIO_PROFILER_H */
+
+/************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
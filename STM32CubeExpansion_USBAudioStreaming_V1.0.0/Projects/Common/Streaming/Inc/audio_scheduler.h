@@ -0,0 +1,77 @@
+/**
+  ******************************************************************************
+  * @file    audio_scheduler.h
+  * @author  MCD Application Team
+  * @brief   header of audio_scheduler.c
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2019  STMicroelectronics.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by ST under Ultimate Liberty license
+  * SLA0044, the "License"; You may not use this file except in compliance with
+  * the License. You may obtain a copy of the License at:
+  *                             www.st.com/SLA0044
+  *
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __AUDIO_SCHEDULER_H
+#define __AUDIO_SCHEDULER_H
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdint.h>
+#include "usb_audio_user_cfg.h"
+
+/* Exported constants --------------------------------------------------------*/
+/* the scheduler runs the deferred processing tasks and the speaker codec task, the codec I2C transfers of the
+   volume and mute control requests never run in the USB interrupt whatever USE_AUDIO_DEFERRED_PROCESSING */
+#if USE_AUDIO_DEFERRED_PROCESSING || (USE_USB_AUDIO_PLAYBACK && !USE_AUDIO_TIMER_VOLUME_CTRL)
+#define USE_AUDIO_SCHEDULER              1
+#else /* USE_AUDIO_DEFERRED_PROCESSING || (USE_USB_AUDIO_PLAYBACK && !USE_AUDIO_TIMER_VOLUME_CTRL) */
+#define USE_AUDIO_SCHEDULER              0
+#endif /* USE_AUDIO_DEFERRED_PROCESSING || (USE_USB_AUDIO_PLAYBACK && !USE_AUDIO_TIMER_VOLUME_CTRL) */
+
+#if USE_AUDIO_SCHEDULER
+#define AUDIO_SCHEDULER_MAX_TASKS        8U /* tasks run in registration order, first registered has the highest priority */
+
+/* Exported types ------------------------------------------------------------*/
+/* work function of a task, called from the PendSV handler */
+typedef void (*AUDIO_SchedulerTaskRun_t)(uint32_t /*private_data*/);
+
+/* deferred task: ISRs post it, the scheduler runs it at the lowest interrupt priority */
+typedef struct
+{
+  AUDIO_SchedulerTaskRun_t Run;      /* work function */
+  uint32_t private_data;             /* argument of Run */
+  uint32_t deadline_cycles;          /* max allowed time between post and end of execution */
+  uint32_t post_time;                /* cycle counter value when the task was posted */
+  uint32_t run_count;                /* count of executions */
+  uint32_t deadline_miss_count;      /* count of executions ended after the deadline */
+  uint32_t lost_count;               /* count of posts received while the task was still pending */
+  uint32_t max_latency_cycles;       /* worst time between post and end of execution */
+  uint8_t  id;                       /* index in scheduler table, also the priority */
+} AUDIO_SchedulerTask_t;
+
+/* Exported functions ------------------------------------------------------- */
+int8_t  AUDIO_SchedulerInit(void);
+int8_t  AUDIO_SchedulerRegisterTask(AUDIO_SchedulerTask_t* task, AUDIO_SchedulerTaskRun_t run,
+                                    uint32_t private_data, uint32_t deadline_us);
+void    AUDIO_SchedulerSetDeadline(AUDIO_SchedulerTask_t* task, uint32_t deadline_us);
+void    AUDIO_SchedulerPost(AUDIO_SchedulerTask_t* task);
+void    AUDIO_SchedulerRun(void);
+#endif /* USE_AUDIO_SCHEDULER */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* __AUDIO_SCHEDULER_H */
+
+/************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
@@ -28,6 +28,7 @@
 /* Includes ------------------------------------------------------------------*/
 #include "audio_node.h"
 #include "audio_usb_nodes.h"
+#include "audio_mixer_node.h"
 
 /* Exported types ------------------------------------------------------------*/
 #if USE_AUDIO_USB_INTERRUPT
@@ -56,11 +57,19 @@ AUDIO_USBSession_t;
  int8_t  AUDIO_PlaybackSessionInit(USBD_AUDIO_AS_InterfaceTypeDef* as_desc,
                                     USBD_AUDIO_ControlTypeDef* controls_desc,
                                     uint8_t* control_count, uint32_t session_handle);
+ int8_t  AUDIO_PlaybackSessionSetBlockPeriod(uint16_t block_us);
+#if USE_AUDIO_PLAYBACK_MIXER
+ int8_t  AUDIO_PlaybackSessionAddMixerInput(AUDIO_MixerInput_t* input);
+#endif /* USE_AUDIO_PLAYBACK_MIXER */
 #endif /* USE_USB_AUDIO_PLAYBACK*/
 #if  USE_USB_AUDIO_RECORDING
  int8_t  AUDIO_RecordingSessionInit(USBD_AUDIO_AS_InterfaceTypeDef* as_desc,
                                      USBD_AUDIO_ControlTypeDef* controls_desc,
                                      uint8_t* control_count, uint32_t session_handle);
+ int8_t  AUDIO_RecordingSessionSetBlockPeriod(uint16_t block_us);
+#if USE_AUDIO_RECORDING_BEAMFORMER
+ int8_t  AUDIO_RecordingSessionSetBeamAngle(uint16_t channel_number, int angle_deg);
+#endif /* USE_AUDIO_RECORDING_BEAMFORMER */
 #ifdef  USE_AUDIO_RECORDING_USB_IMPLICIT_SYNCHRO 
  int8_t  USB_AudioRecordingSynchronizationGetSamplesCountToAddInNextPckt(struct AUDIO_Session* session_handle);
 #endif /* USE_AUDIO_RECORDING_USB_IMPLICIT_SYNCHRO */
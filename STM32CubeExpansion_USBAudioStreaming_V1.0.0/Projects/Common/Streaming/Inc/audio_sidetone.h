@@ -0,0 +1,64 @@
+/**
+  ******************************************************************************
+  * @file    audio_sidetone.h
+  * @author  MCD Application Team
+  * @brief   header of audio_sidetone.c
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2019  STMicroelectronics.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by ST under Ultimate Liberty license
+  * SLA0044, the "License"; You may not use this file except in compliance with
+  * the License. You may obtain a copy of the License at:
+  *                             www.st.com/SLA0044
+  *
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __AUDIO_SIDETONE_H
+#define __AUDIO_SIDETONE_H
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include "usbd_audio.h"
+#include "audio_graph.h"
+#include "audio_mixer_node.h"
+
+/* Exported constants --------------------------------------------------------*/
+/* monitor level range of the sidetone feature unit */
+#define VOLUME_SIDETONE_RES_DB_256      256     /* 1 db */
+#define VOLUME_SIDETONE_MAX_DB_256      0       /* 0 db */
+#define VOLUME_SIDETONE_MIN_DB_256      -15360  /* -60 db */
+
+/* Exported types ------------------------------------------------------------*/
+/* microphone tap, processing node of the recording graph copying each captured block to the sidetone ring */
+typedef struct
+{
+  AUDIO_ProcessingNode_t processing;                               /* must be first field */
+  AUDIO_MixerInput_t*    input;                                    /* input of the playback mixer fed by the tap */
+  uint8_t                format;                                   /* captured samples AUDIO_GRAPH_FORMAT_xxx */
+  uint8_t                skipped_size;                             /* bytes of the captured channels not monitored */
+  uint8_t                enabled;                                  /* captured blocks match the mixer input */
+  uint8_t                faded;                                    /* ring overflowed, next written block fades in */
+} AUDIO_SidetoneTapNode_t;
+
+/* Exported functions ------------------------------------------------------- */
+#if USE_AUDIO_SIDETONE
+int8_t  AUDIO_SidetoneInit(USBD_AUDIO_ControlTypeDef* control);
+AUDIO_MixerInput_t*     AUDIO_SidetoneGetMixerInput(void);
+AUDIO_ProcessingNode_t* AUDIO_SidetoneGetTapNode(void);
+#endif /* USE_AUDIO_SIDETONE */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* __AUDIO_SIDETONE_H */
+
+/************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
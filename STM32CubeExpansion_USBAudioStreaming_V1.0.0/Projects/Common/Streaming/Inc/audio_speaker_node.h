@@ -67,12 +67,10 @@ typedef struct
 {
   AUDIO_Node_t              node;            /* the structure of generic node*/
   AUDIO_CircularBuffer_t*   buf;             /* the audio data buffer*/
-  uint16_t               packet_length;   /* packet maximal length */
-#if USB_AUDIO_CONFIG_PLAY_USE_FREQ_44_1_K
-  uint16_t               packet_length_max_44_1; /* packet maximal length for frequency 44_1 */
-  uint8_t                injection_44_count;     /* used as count to inject 9 packets (44 samples) then 1 packet(45 samples)*/
-  uint8_t                injection_45_pos;     /* used as position of  45 samples packet*/
-#endif /* USB_AUDIO_CONFIG_PLAY_USE_FREQ_44_1_K*/
+  uint16_t               packet_length;   /* nominal length of a block read from the buffer */
+  uint16_t               packet_length_max; /* length of a block carrying one more sample */
+  uint32_t               block_frac;      /* fractional samples count of a block, in millionths of sample (44.1KHZ/1ms: 100000) */
+  uint32_t               block_frac_sum;  /* accumulated fractional samples, a block carries one more sample when it reaches 1 */
   int8_t                (*SpeakerDeInit)  (uint32_t /*node_handle*/);
   int8_t                (*SpeakerStart)   (AUDIO_CircularBuffer_t* /*buffer*/, uint32_t /*node handle*/);
   int8_t                (*SpeakerStop)    ( uint32_t /*node handle*/);
@@ -0,0 +1,113 @@
+/**
+  ******************************************************************************
+  * @file    audio_trace.h
+  * @author  MCD Application Team
+  * @brief   header of audio_trace.c
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2019  STMicroelectronics.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by ST under Ultimate Liberty license
+  * SLA0044, the "License"; You may not use this file except in compliance with
+  * the License. You may obtain a copy of the License at:
+  *                             www.st.com/SLA0044
+  *
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __AUDIO_TRACE_H
+#define __AUDIO_TRACE_H
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdint.h>
+#include "usb_audio_user_cfg.h"
+#include "audio_node.h"
+
+#if USE_AUDIO_TRACE
+/* Exported constants --------------------------------------------------------*/
+/* the ring layout is decoded by Utilities/AudioTrace/audio_trace_decode.c, update it when changing one of these */
+#define AUDIO_TRACE_MAGIC               0x43525441U /* "ATRC" */
+#define AUDIO_TRACE_VERSION             1U
+#define AUDIO_TRACE_RING_SIZE           512U        /* count of records, must be a power of 2 */
+
+/* Exported types ------------------------------------------------------------*/
+/* trace events */
+typedef enum
+{
+  AUDIO_TRACE_USB_RX_BUFFER = 0,   /* USB input node gives a buffer for the next OUT packet, length: max packet length */
+  AUDIO_TRACE_USB_PACKET_RECEIVED, /* USB input node writes a packet to the buffer, length: packet length */
+  AUDIO_TRACE_USB_PACKET_SENT,     /* USB output node reads a packet from the buffer, length: packet length */
+  AUDIO_TRACE_SPEAKER_INJECTION,   /* speaker reads next data to inject, length: read length */
+  AUDIO_TRACE_MIC_FILL,            /* microphone writes captured samples to the buffer, length: written length */
+  AUDIO_TRACE_SESSION_EVENT,       /* session receives an event, arg: AUDIO_SessionEvent_t */
+  AUDIO_TRACE_ALTERNATE_SETTING,   /* session receives the streaming interface alternate setting, arg: alternate */
+  AUDIO_TRACE_SPEAKER_FIRST_DATA,  /* speaker reads data after injecting silence, length and arg: low and high half words of the silence size */
+  AUDIO_TRACE_FEEDBACK_LOCKED      /* playback feedback is measured from the played samples, length and arg: low and high half words of the frequency */
+} AUDIO_TraceEvent_t;
+
+/* trace emitters */
+typedef enum
+{
+  AUDIO_TRACE_NODE_USB_INPUT = 0,
+  AUDIO_TRACE_NODE_USB_OUTPUT,
+  AUDIO_TRACE_NODE_SPEAKER,
+  AUDIO_TRACE_NODE_MIC,
+  AUDIO_TRACE_NODE_PLAYBACK_SESSION,
+  AUDIO_TRACE_NODE_RECORDING_SESSION
+} AUDIO_TraceNode_t;
+
+/* one event, 16 bytes */
+typedef struct
+{
+  uint32_t time;     /* DWT cycle counter */
+  uint8_t  event;    /* AUDIO_TraceEvent_t */
+  uint8_t  node;     /* AUDIO_TraceNode_t */
+  uint16_t length;   /* packet length */
+  uint16_t rd_ptr;   /* circular buffer state after the event */
+  uint16_t wr_ptr;
+  uint16_t size;
+  uint16_t arg;      /* event specific */
+} AUDIO_TraceRecord_t;
+
+/* trace ring, found in a memory dump thanks to the magic value */
+typedef struct
+{
+  uint32_t magic;
+  uint16_t version;
+  uint16_t record_size;
+  uint32_t record_count;   /* ring capacity */
+  uint32_t time_frequency; /* cycle counter frequency in Hz */
+  volatile uint32_t head;  /* count of emitted records, record i is at index i modulo record_count */
+  AUDIO_TraceRecord_t records[AUDIO_TRACE_RING_SIZE];
+} AUDIO_TraceRing_t;
+
+/* Exported variables --------------------------------------------------------*/
+extern AUDIO_TraceRing_t AUDIO_TraceRing;
+
+/* Exported macros -----------------------------------------------------------*/
+#define AUDIO_TRACE(event, node, buf, length, arg)  AUDIO_TraceEmit((event), (node), (buf), (length), (arg))
+/* AUDIO_TRACE_VALUE traces a 32 bits value split in length and arg */
+#define AUDIO_TRACE_VALUE(event, node, buf, value)  AUDIO_TraceEmit((event), (node), (buf), (uint16_t)(value), (uint16_t)((uint32_t)(value)>>16))
+
+/* Exported functions ------------------------------------------------------- */
+int8_t  AUDIO_TraceInit(void);
+void    AUDIO_TraceEmit(uint8_t event, uint8_t node, AUDIO_CircularBuffer_t* buf, uint16_t length, uint16_t arg);
+#else  /* USE_AUDIO_TRACE */
+#define AUDIO_TRACE(event, node, buf, length, arg)
+#define AUDIO_TRACE_VALUE(event, node, buf, value)
+#endif /* USE_AUDIO_TRACE */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* __AUDIO_TRACE_H */
+
+/************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
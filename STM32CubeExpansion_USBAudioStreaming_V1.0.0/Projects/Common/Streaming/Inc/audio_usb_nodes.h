@@ -29,8 +29,18 @@
 #include  "usbd_audio.h"
 #include  "audio_node.h"
 /* Exported constants --------------------------------------------------------*/
-#define AUDIO_MAX_SUPPORTED_CHANNEL_COUNT 2    /* we support stereo audio channels */
+#define AUDIO_MAX_SUPPORTED_CHANNEL_COUNT 4    /* stereo streams and the 4 channels microphone array */
+/* feature unit controls of each logical channel, declared only when the session gain node applies them,
+   the codec and microphone volumes are master controls */
+#if USE_AUDIO_SOFTWARE_VOLUME
+#define AUDIO_USB_CF_CHANNEL_CONTROLS     (USBD_AUDIO_CONTROL_FEATURE_UNIT_MUTE|USBD_AUDIO_CONTROL_FEATURE_UNIT_VOLUME)
+#define AUDIO_USB_CF_CHANNEL_COUNT        AUDIO_MAX_SUPPORTED_CHANNEL_COUNT
+#else /* USE_AUDIO_SOFTWARE_VOLUME */
+#define AUDIO_USB_CF_CHANNEL_CONTROLS     0x00
+#define AUDIO_USB_CF_CHANNEL_COUNT        0
+#endif /* USE_AUDIO_SOFTWARE_VOLUME */
 #define AUDIO_IO_BEGIN_OF_STREAM          0x01 /* Begin of stream sent to session when first packet is received */
+#define AUDIO_IO_DMA_BUFFER_USED          0x02 /* last packet was received in the word aligned buffer of the OTG DMA and must be copied to the circular buffer */
 #define AUDIO_IO_RESTART_REQUIRED         0x40 /* Restart of USB node is required , after frequency changes for examples */
 #define AUDIO_IO_THRESHOLD_REACHED        0x08 /* this flag is set when  main circular audio  buffer fill threshold is reached.Then consumer node starts  reading from the buffer, this is to avoid overrun and underrun in the begin of streaming*/ 
 
@@ -92,6 +102,12 @@ typedef struct
   uint8_t unit_id;                              /* UNIT ID for usb audio function description and control*/
   USBD_AUDIO_FeatureControlCallbacksTypeDef usb_control_callbacks;      /* list of callbacks */
   AUDIO_USBFeatureUnitCommands_t control_cbks;                            /* */
+  uint8_t channel_count;                        /* logical channels with controls, channels of the unit cluster */
+#if AUDIO_USB_CF_CHANNEL_COUNT
+  /* controls of logical channels 1 to channel_count, master channel 0 is kept in audio_description */
+  int     channel_volume_db_256[AUDIO_USB_CF_CHANNEL_COUNT];
+  uint8_t channel_mute[AUDIO_USB_CF_CHANNEL_COUNT];
+#endif /* AUDIO_USB_CF_CHANNEL_COUNT */
   int8_t  (*CFInit)    (USBD_AUDIO_ControlTypeDef* /*control*/  ,
                         AUDIO_USBFeatureUnitDefaults_t* /*audio_defaults*/,
                         uint8_t /*unit_id*/,  
@@ -27,6 +27,10 @@
 
 /* Exported constants --------------------------------------------------------*/
  extern USBD_AUDIO_InterfaceCallbacksfTypeDef audio_class_interface;
+#if USBD_SUPPORT_AUDIO_VENDOR_REQUEST
+/* vendor requests to the audio control interface (bmRequestType 0x41, wIndex low byte 0, wLength 0) */
+#define USB_AUDIO_VENDOR_REQ_SET_BEAM_ANGLE    0x01 /* wValue: signed angle in degrees, wIndex high byte: 0 for all beams, else beam number */
+#endif /* USBD_SUPPORT_AUDIO_VENDOR_REQUEST */
 /* Exported types ------------------------------------------------------------*/
 #if USE_AUDIO_USB_INTERRUPT
 typedef enum 
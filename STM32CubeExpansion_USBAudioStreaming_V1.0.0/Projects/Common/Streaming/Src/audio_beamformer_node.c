@@ -0,0 +1,334 @@
+/**
+  ******************************************************************************
+  * @file    audio_beamformer_node.c
+  * @author  MCD Application Team
+  * @brief   delay and sum beamformer processing node.
+  *          Each beam delays the microphones so that a plane wave coming from
+  *          its steering angle is aligned on all of them, then averages them.
+  *          The delays are split in a history offset and a third order
+  *          Lagrange fractional delay filter. Samples are processed in Q1.31
+  *          with 64 bits accumulation (SMLAL on Cortex-M4/M7), the history is
+  *          mirrored so the taps read it without wrapping. New steering is
+  *          written to a second set of coefficients which the node swaps at
+  *          the next block boundary.
+  *          The node outputs fewer channels than it reads, it runs in place as
+  *          a frame is read before its beams are written.
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2019  STMicroelectronics.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by ST under Ultimate Liberty license
+  * SLA0044, the "License"; You may not use this file except in compliance with
+  * the License. You may obtain a copy of the License at:
+  *                             www.st.com/SLA0044
+  *
+  ******************************************************************************
+  */
+/* Includes ------------------------------------------------------------------*/
+#include <string.h>
+#include <math.h>
+#include "audio_beamformer_node.h"
+
+#if USE_AUDIO_RECORDING_BEAMFORMER
+#if !USE_AUDIO_PROCESSING_GRAPH
+#error "USE_AUDIO_RECORDING_BEAMFORMER requires USE_AUDIO_PROCESSING_GRAPH"
+#endif /* !USE_AUDIO_PROCESSING_GRAPH */
+
+/* Private defines -----------------------------------------------------------*/
+#define AUDIO_BEAMFORMER_PI             3.14159265358979323846
+/* added before the shift of the accumulators */
+#define AUDIO_BEAMFORMER_ROUNDING       ((int64_t)1 << (AUDIO_BEAMFORMER_TAP_FRACTION_BITS - 1U))
+
+/* Private macros ------------------------------------------------------------*/
+#define AUDIO_BEAMFORMER_SATURATE(value) (((value) > INT32_MAX)? INT32_MAX : (((value) < INT32_MIN)? INT32_MIN : (int32_t)(value)))
+
+/* Private function prototypes -----------------------------------------------*/
+static int8_t  AUDIO_BeamformerConfigure(const AUDIO_GraphPort_t* in_port, AUDIO_GraphPort_t* out_port, uint32_t node_handle);
+static int8_t  AUDIO_BeamformerRun(const AUDIO_GraphSpan_t* in, AUDIO_GraphSpan_t* out, uint32_t node_handle);
+static int8_t  AUDIO_BeamformerDesign(AUDIO_BeamformerNode_t* beamformer, uint32_t frequency,
+                                      AUDIO_BeamformerCoefficients_t* coefficients);
+static int32_t AUDIO_BeamformerSum(const AUDIO_BeamformerNode_t* beamformer, const AUDIO_BeamformerSteering_t* steering);
+
+/* Exported functions --------------------------------------------------------*/
+/**
+  * @brief  AUDIO_BeamformerInit
+  *         Initializes the beamformer node with all beams steered to the front. The node is then added to a graph
+  *         whose input has one channel per microphone.
+  * @param  beamformer(IN):  beamformer node
+  * @param  mics(IN):        microphone positions, in the order of the captured channels
+  * @param  mics_count(IN):  1 to AUDIO_BEAMFORMER_MAX_MICS
+  * @param  beams_count(IN): output channels, 1 to AUDIO_BEAMFORMER_MAX_BEAMS
+  * @retval 0 if no error
+  */
+int8_t  AUDIO_BeamformerInit(AUDIO_BeamformerNode_t* beamformer, const AUDIO_BeamformerMic_t* mics, uint8_t mics_count,
+                             uint8_t beams_count)
+{
+  if((mics_count == 0) || (mics_count > AUDIO_BEAMFORMER_MAX_MICS) ||
+     (beams_count == 0) || (beams_count > AUDIO_BEAMFORMER_MAX_BEAMS))
+  {
+    return -1;
+  }
+  memset(beamformer, 0, sizeof(AUDIO_BeamformerNode_t));
+  memcpy(beamformer->mics, mics, mics_count * sizeof(AUDIO_BeamformerMic_t));
+  beamformer->mics_count = mics_count;
+  beamformer->beams_count = beams_count;
+  beamformer->processing.flags = AUDIO_PROCESSING_IN_PLACE;
+  /* the beam is aligned on the last microphone reached by the wave, delayed by one frame */
+  beamformer->processing.latency_frames = 1;
+  beamformer->processing.ProcessingConfigure = AUDIO_BeamformerConfigure;
+  beamformer->processing.ProcessingRun = AUDIO_BeamformerRun;
+  return 0;
+}
+
+/**
+  * @brief  AUDIO_BeamformerSetAngle
+  *         Steers a beam. Only records the angle, so it may be called from the USB interrupt : the node designs
+  *         the new coefficients at the start of the next block.
+  * @param  beamformer(IN):     beamformer node
+  * @param  channel_number(IN): 0 for all beams, else beam number
+  * @param  angle_deg(IN):      direction of the source, -AUDIO_BEAMFORMER_MAX_ANGLE to AUDIO_BEAMFORMER_MAX_ANGLE
+  * @retval 0 if no error
+  */
+int8_t  AUDIO_BeamformerSetAngle(AUDIO_BeamformerNode_t* beamformer, uint16_t channel_number, int angle_deg)
+{
+  if((channel_number > beamformer->beams_count) ||
+     (angle_deg > AUDIO_BEAMFORMER_MAX_ANGLE) || (angle_deg < -AUDIO_BEAMFORMER_MAX_ANGLE))
+  {
+    return -1;
+  }
+  for(int b = 0; b < beamformer->beams_count; b++)
+  {
+    if((channel_number == 0) || (channel_number == b + 1))
+    {
+      beamformer->angles[b] = (int16_t)angle_deg;
+    }
+  }
+  beamformer->requested = 1;
+  return 0;
+}
+
+/**
+  * @brief  AUDIO_BeamformerDesignSteering
+  *         Computes the delays of a beam. The microphone nearest to the source is delayed the most, the last one
+  *         reached by the wave by one frame, so the interpolators always have a sample on each side.
+  * @param  mics(IN):        microphone positions
+  * @param  mics_count(IN):  count of microphones
+  * @param  angle_deg(IN):   direction of the source
+  * @param  frequency(IN):   sampling rate in Hz
+  * @param  steering(OUT):   delays and taps
+  * @retval 0 if no error, -1 if the array is too large for the history at this sampling rate
+  */
+int8_t  AUDIO_BeamformerDesignSteering(const AUDIO_BeamformerMic_t* mics, uint8_t mics_count, int angle_deg,
+                                       uint32_t frequency, AUDIO_BeamformerSteering_t* steering)
+{
+  double angle, projection[AUDIO_BEAMFORMER_MAX_MICS], farthest, delay, fraction, tap;
+  int base;
+
+  if((mics_count == 0) || (mics_count > AUDIO_BEAMFORMER_MAX_MICS) || (frequency == 0))
+  {
+    return -1;
+  }
+  /* distance of each microphone toward the source */
+  angle = angle_deg * AUDIO_BEAMFORMER_PI / 180.0;
+  farthest = 1e9;
+  for(int m = 0; m < mics_count; m++)
+  {
+    projection[m] = mics[m].x_mm * sin(angle) + mics[m].y_mm * cos(angle);
+    if(projection[m] < farthest)
+    {
+      farthest = projection[m];
+    }
+  }
+  memset(steering, 0, sizeof(AUDIO_BeamformerSteering_t));
+  for(int m = 0; m < mics_count; m++)
+  {
+    /* the wave reaches this microphone earlier than the farthest one, it waits for it */
+    delay = 1.0 + (projection[m] - farthest) * frequency / AUDIO_BEAMFORMER_SOUND_SPEED_MM_S;
+    base = (int)floor(delay) - 1;
+    fraction = delay - floor(delay) + 1.0;
+    if(base + AUDIO_BEAMFORMER_TAPS > AUDIO_BEAMFORMER_HISTORY)
+    {
+      return -1;
+    }
+    steering->delay[m] = (uint8_t)base;
+    /* Lagrange interpolation of the sample at fraction, 1 to 2, between taps 0 to 3 */
+    for(int k = 0; k < (int)AUDIO_BEAMFORMER_TAPS; k++)
+    {
+      tap = 1.0 / mics_count;
+      for(int j = 0; j < (int)AUDIO_BEAMFORMER_TAPS; j++)
+      {
+        if(j != k)
+        {
+          tap *= (fraction - j) / (k - j);
+        }
+      }
+      tap *= (double)(1UL << AUDIO_BEAMFORMER_TAP_FRACTION_BITS);
+      steering->taps[m][k] = (int32_t)(tap + ((tap >= 0.0)? 0.5 : -0.5));
+    }
+  }
+  return 0;
+}
+
+/* Private functions ---------------------------------------------------------*/
+/**
+  * @brief  AUDIO_BeamformerDesign
+  *         Computes the steering of all beams for the stream sampling rate.
+  * @param  beamformer(IN):    beamformer node
+  * @param  frequency(IN):     sampling rate in Hz
+  * @param  coefficients(OUT): set of coefficients, not in use by the node
+  * @retval 0 if no error
+  */
+static int8_t  AUDIO_BeamformerDesign(AUDIO_BeamformerNode_t* beamformer, uint32_t frequency,
+                                      AUDIO_BeamformerCoefficients_t* coefficients)
+{
+  for(int b = 0; b < beamformer->beams_count; b++)
+  {
+    if(AUDIO_BeamformerDesignSteering(beamformer->mics, beamformer->mics_count, beamformer->angles[b], frequency,
+                                      &coefficients->beams[b]) != 0)
+    {
+      return -1;
+    }
+  }
+  return 0;
+}
+
+/**
+  * @brief  AUDIO_BeamformerConfigure
+  *         Checks that the blocks have a channel per microphone, designs the beams for the stream sampling rate
+  *         and clears the history.
+  * @param  in_port(IN):      format of the captured blocks
+  * @param  out_port(OUT):    one channel per beam
+  * @param  node_handle(IN):  beamformer node
+  * @retval 0 if no error
+  */
+static int8_t  AUDIO_BeamformerConfigure(const AUDIO_GraphPort_t* in_port, AUDIO_GraphPort_t* out_port, uint32_t node_handle)
+{
+  AUDIO_BeamformerNode_t* beamformer;
+
+  beamformer = (AUDIO_BeamformerNode_t*)node_handle;
+  if((in_port->channels_count != beamformer->mics_count) ||
+     ((in_port->format != AUDIO_GRAPH_FORMAT_S16) && (in_port->format != AUDIO_GRAPH_FORMAT_S24) &&
+      (in_port->format != AUDIO_GRAPH_FORMAT_S32)))
+  {
+    return -1;
+  }
+  beamformer->requested = 0;
+  if(AUDIO_BeamformerDesign(beamformer, in_port->frequency, &beamformer->coefficients[!beamformer->active]) != 0)
+  {
+    return -1;
+  }
+  beamformer->active = !beamformer->active;
+  beamformer->frequency = in_port->frequency;
+  beamformer->format = in_port->format;
+  memset(beamformer->history, 0, sizeof(beamformer->history));
+  beamformer->position = 0;
+  out_port->channels_count = beamformer->beams_count;
+  return 0;
+}
+
+/**
+  * @brief  AUDIO_BeamformerSum
+  *         Delays and sums the microphones for the last frame of the history.
+  * @param  beamformer(IN):  beamformer node
+  * @param  steering(IN):    steering of the beam
+  * @retval beam sample, Q1.31
+  */
+static int32_t AUDIO_BeamformerSum(const AUDIO_BeamformerNode_t* beamformer, const AUDIO_BeamformerSteering_t* steering)
+{
+  const int32_t* sample;
+  const int32_t* tap;
+  int64_t acc = AUDIO_BEAMFORMER_ROUNDING;
+
+  for(int m = 0; m < beamformer->mics_count; m++)
+  {
+    /* the mirror keeps the AUDIO_BEAMFORMER_HISTORY last samples contiguous, newest last */
+    sample = &beamformer->history[m][beamformer->position + AUDIO_BEAMFORMER_HISTORY - steering->delay[m]];
+    tap = steering->taps[m];
+    acc += (int64_t)tap[0] * sample[0] + (int64_t)tap[1] * sample[-1] +
+           (int64_t)tap[2] * sample[-2] + (int64_t)tap[3] * sample[-3];
+  }
+  acc >>= AUDIO_BEAMFORMER_TAP_FRACTION_BITS;
+  return AUDIO_BEAMFORMER_SATURATE(acc);
+}
+
+/**
+  * @brief  AUDIO_BeamformerRun
+  *         Replaces each frame of the microphones by a frame of the beams, designs the new steering first if an
+  *         angle changed. The previous steering is kept if the new one doesn't fit the history.
+  * @param  in(IN):           block of the microphones
+  * @param  out(IN):          same data as in, one channel per beam
+  * @param  node_handle(IN):  beamformer node
+  * @retval 0 if no error
+  */
+static int8_t  AUDIO_BeamformerRun(const AUDIO_GraphSpan_t* in, AUDIO_GraphSpan_t* out, uint32_t node_handle)
+{
+  AUDIO_BeamformerNode_t* beamformer;
+  AUDIO_BeamformerCoefficients_t* coefficients;
+  uint8_t *src, *dst;
+  uint16_t position;
+  int32_t value;
+
+  beamformer = (AUDIO_BeamformerNode_t*)node_handle;
+  if(beamformer->requested)
+  {
+    /* cleared first, an angle set during the design is taken by the next block */
+    beamformer->requested = 0;
+    if(AUDIO_BeamformerDesign(beamformer, beamformer->frequency, &beamformer->coefficients[!beamformer->active]) == 0)
+    {
+      beamformer->active = !beamformer->active;
+    }
+  }
+  coefficients = &beamformer->coefficients[beamformer->active];
+  src = in->data;
+  dst = out->data;
+  position = beamformer->position;
+  for(uint16_t f = 0; f < in->frames; f++)
+  {
+    /* the whole frame is read before its beams are written over it */
+    position = (position + 1) & (AUDIO_BEAMFORMER_HISTORY - 1);
+    for(int m = 0; m < beamformer->mics_count; m++)
+    {
+      switch(beamformer->format)
+      {
+      case AUDIO_GRAPH_FORMAT_S16:
+        value = (int32_t)((uint32_t)*(int16_t*)src << 16);
+        break;
+      case AUDIO_GRAPH_FORMAT_S24:
+        /* packed little endian sample, processed MSB aligned */
+        value = (int32_t)(((uint32_t)src[0] << 8) | ((uint32_t)src[1] << 16) | ((uint32_t)src[2] << 24));
+        break;
+      default:
+        value = *(int32_t*)src;
+        break;
+      }
+      src += beamformer->format;
+      beamformer->history[m][position] = value;
+      beamformer->history[m][position + AUDIO_BEAMFORMER_HISTORY] = value;
+    }
+    beamformer->position = position;
+    for(int b = 0; b < beamformer->beams_count; b++)
+    {
+      value = AUDIO_BeamformerSum(beamformer, &coefficients->beams[b]);
+      switch(beamformer->format)
+      {
+      case AUDIO_GRAPH_FORMAT_S16:
+        *(int16_t*)dst = (int16_t)(value >> 16);
+        break;
+      case AUDIO_GRAPH_FORMAT_S24:
+        dst[0] = (uint8_t)(value >> 8);
+        dst[1] = (uint8_t)(value >> 16);
+        dst[2] = (uint8_t)(value >> 24);
+        break;
+      default:
+        *(int32_t*)dst = value;
+        break;
+      }
+      dst += beamformer->format;
+    }
+  }
+  return 0;
+}
+#endif /* USE_AUDIO_RECORDING_BEAMFORMER */
+/************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
@@ -95,30 +95,24 @@ static uint16_t AUDIO_SpeakerUpdateBuffer(void)
     {
      
       /* inform session that a packet is played */
-      current_speaker->node.session_handle->SessionCallback(AUDIO_PACKET_PLAYED, (AUDIO_Node_t*)current_speaker, 
-                                                            current_speaker->node.session_handle);
+      AUDIO_SESSION_NOTIFY(current_speaker->node.session_handle, AUDIO_PACKET_PLAYED, current_speaker);
       /* prepare next size to inject */
       read_length = current_speaker->packet_length;
-#if USB_AUDIO_CONFIG_PLAY_USE_FREQ_44_1_K
-      if(current_speaker->node.audio_description->frequency == USB_AUDIO_CONFIG_FREQ_44_1_K)
+      if(current_speaker->block_frac)
       {
-        if(current_speaker->injection_44_count < 9)
+        /* one more sample each time the fractional samples sum up to one */
+        current_speaker->block_frac_sum += current_speaker->block_frac;
+        if(current_speaker->block_frac_sum >= 1000000U)
         {
-          current_speaker->injection_44_count++;  
-        }
-        else
-        {
-           current_speaker->injection_44_count = 0;
-           read_length = current_speaker->packet_length_max_44_1;
+          current_speaker->block_frac_sum -= 1000000U;
+          read_length = current_speaker->packet_length_max;
         }
       }
-#endif /* USB_AUDIO_CONFIG_PLAY_USE_FREQ_44_1_K*/
       wr_distance = AUDIO_BUFFER_FILLED_SIZE(current_speaker->buf);
       if(wr_distance < read_length)
       {
         /** inform session that an underrun is happened */
-        current_speaker->node.session_handle->SessionCallback(AUDIO_UNDERRUN, (AUDIO_Node_t*)current_speaker, 
-                                                  current_speaker->node.session_handle);
+        AUDIO_SESSION_NOTIFY(current_speaker->node.session_handle, AUDIO_UNDERRUN, current_speaker);
         read_length = 0;
       }
       else
@@ -218,13 +212,11 @@ static int8_t  AUDIO_SpeakerChangeFrequency( uint32_t node_handle)
   */
 static void  AUDIO_SpeakerInitInjectionsParams( AUDIO_SpeakerNode_t* speaker)
 {
+  /* the dummy speaker reads the buffer each ms */
   speaker->packet_length = AUDIO_MS_PACKET_SIZE_FROM_AUD_DESC(speaker->node.audio_description);
-#if USB_AUDIO_CONFIG_PLAY_USE_FREQ_44_1_K
-  if(speaker->node.audio_description->frequency == USB_AUDIO_CONFIG_FREQ_44_1_K)
-  {
-    speaker->packet_length_max_44_1 = speaker->packet_length + AUDIO_SAMPLE_LENGTH(speaker->node.audio_description);
-  }
-#endif /* USB_AUDIO_CONFIG_PLAY_USE_FREQ_44_1_K*/
+  speaker->packet_length_max = speaker->packet_length + AUDIO_SAMPLE_LENGTH(speaker->node.audio_description);
+  speaker->block_frac = AUDIO_BLOCK_SAMPLES_FRAC(speaker->node.audio_description->frequency, 1000U);
+  speaker->block_frac_sum = 0;
  }
  /**
   * @brief  AUDIO_SpeakerMute
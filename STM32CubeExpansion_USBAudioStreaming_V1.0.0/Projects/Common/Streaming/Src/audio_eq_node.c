@@ -0,0 +1,453 @@
+/**
+  ******************************************************************************
+  * @file    audio_eq_node.c
+  * @author  MCD Application Team
+  * @brief   parametric equalizer processing node.
+  *          Each channel runs a cascade of up to AUDIO_EQ_MAX_BANDS biquads,
+  *          in place on the block, in direct form 1 or transposed direct
+  *          form 2. Samples are processed in Q1.31 with 64 bits accumulation
+  *          (SMLAL on Cortex-M4/M7). Bands are designed for the stream sampling
+  *          rate, the new coefficients are written to a second set which the
+  *          node swaps at the next block boundary, so a change never applies
+  *          to part of a block.
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2019  STMicroelectronics.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by ST under Ultimate Liberty license
+  * SLA0044, the "License"; You may not use this file except in compliance with
+  * the License. You may obtain a copy of the License at:
+  *                             www.st.com/SLA0044
+  *
+  ******************************************************************************
+  */
+/* Includes ------------------------------------------------------------------*/
+#include <string.h>
+#include <math.h>
+#include "audio_eq_node.h"
+
+#if USE_AUDIO_PLAYBACK_EQ
+#if !USE_AUDIO_PROCESSING_GRAPH
+#error "USE_AUDIO_PLAYBACK_EQ requires USE_AUDIO_PROCESSING_GRAPH"
+#endif /* !USE_AUDIO_PROCESSING_GRAPH */
+
+/* Private defines -----------------------------------------------------------*/
+#define AUDIO_EQ_PI                     3.14159265358979323846
+#define AUDIO_EQ_COEF_MAX               ((double)(1UL << (31U - AUDIO_EQ_COEF_FRACTION_BITS)))
+/* added before the shift of the accumulators, a truncation would bias the output by the filter DC gain */
+#define AUDIO_EQ_ROUNDING               ((int64_t)1 << (AUDIO_EQ_COEF_FRACTION_BITS - 1U))
+
+/* Private macros ------------------------------------------------------------*/
+#define AUDIO_EQ_SATURATE(value)        (((value) > INT32_MAX)? INT32_MAX : (((value) < INT32_MIN)? INT32_MIN : (int32_t)(value)))
+
+/* Private types -------------------------------------------------------------*/
+typedef int32_t (*AUDIO_EqCascade_t)(int32_t x, const AUDIO_EqBiquad_t* biquad, AUDIO_EqState_t* state, uint8_t count);
+
+/* Private function prototypes -----------------------------------------------*/
+static int8_t  AUDIO_EqConfigure(const AUDIO_GraphPort_t* in_port, AUDIO_GraphPort_t* out_port, uint32_t node_handle);
+static int8_t  AUDIO_EqRun(const AUDIO_GraphSpan_t* in, AUDIO_GraphSpan_t* out, uint32_t node_handle);
+static void    AUDIO_EqDesign(AUDIO_EqNode_t* eq, AUDIO_EqCoefficients_t* coefficients);
+static void    AUDIO_EqExtendCascade(AUDIO_EqNode_t* eq, int channel, uint8_t previous_count, uint8_t count);
+static int32_t AUDIO_EqCascadeDf1(int32_t x, const AUDIO_EqBiquad_t* biquad, AUDIO_EqState_t* state, uint8_t count);
+static int32_t AUDIO_EqCascadeDf2t(int32_t x, const AUDIO_EqBiquad_t* biquad, AUDIO_EqState_t* state, uint8_t count);
+
+/* Exported functions --------------------------------------------------------*/
+/**
+  * @brief  AUDIO_EqInit
+  *         Initializes the equalizer node with all bands off. The node is then added to a graph.
+  * @param  eq(IN):   equalizer node
+  * @param  form(IN): AUDIO_EQ_DF1, recommended when bands change while streaming, or AUDIO_EQ_DF2T
+  * @retval 0 if no error
+  */
+int8_t  AUDIO_EqInit(AUDIO_EqNode_t* eq, uint8_t form)
+{
+  if((form != AUDIO_EQ_DF1) && (form != AUDIO_EQ_DF2T))
+  {
+    return -1;
+  }
+  memset(eq, 0, sizeof(AUDIO_EqNode_t));
+  eq->form = form;
+  eq->processing.flags = AUDIO_PROCESSING_IN_PLACE;
+  eq->processing.ProcessingConfigure = AUDIO_EqConfigure;
+  eq->processing.ProcessingRun = AUDIO_EqRun;
+  return 0;
+}
+
+/**
+  * @brief  AUDIO_EqSetBand
+  *         Sets a band, the new coefficients apply from the next block. Must not be called from an
+  *         interrupt of higher priority than the graph processing.
+  * @param  eq(IN):             equalizer node
+  * @param  channel_number(IN): 0 for all channels, else channel number
+  * @param  band(IN):           band index, bands are run in index order
+  * @param  params(IN):         band parameters, type AUDIO_EQ_BAND_OFF removes the band
+  * @retval 0 if no error
+  */
+int8_t  AUDIO_EqSetBand(AUDIO_EqNode_t* eq, uint16_t channel_number, uint8_t band, const AUDIO_EqBand_t* params)
+{
+  AUDIO_EqBiquad_t biquad;
+
+  if((channel_number > AUDIO_EQ_MAX_CHANNELS) || (band >= AUDIO_EQ_MAX_BANDS))
+  {
+    return -1;
+  }
+  /* checks the parameters at the highest supported rate */
+  if((params->type != AUDIO_EQ_BAND_OFF) &&
+     (AUDIO_EqDesignBiquad(params, (eq->frequency)? eq->frequency : 2 * params->frequency + 1, &biquad) != 0))
+  {
+    return -1;
+  }
+  for(uint32_t c = 0; c < AUDIO_EQ_MAX_CHANNELS; c++)
+  {
+    if((channel_number == 0) || (channel_number == c + 1))
+    {
+      eq->bands[c][band] = *params;
+    }
+  }
+  if(eq->frequency)
+  {
+    /* the set in use is not modified, the node swaps the sets when the new one is complete */
+    eq->pending = 0;
+    AUDIO_EqDesign(eq, &eq->coefficients[!eq->active]);
+    eq->pending = 1;
+  }
+  return 0;
+}
+
+/**
+  * @brief  AUDIO_EqDesignBiquad
+  *         Computes the coefficients of a band (Audio EQ Cookbook, R. Bristow-Johnson).
+  * @param  params(IN):    band parameters
+  * @param  frequency(IN): sampling rate in Hz
+  * @param  biquad(OUT):   coefficients
+  * @retval 0 if no error, -1 if the band is invalid at this sampling rate
+  */
+int8_t  AUDIO_EqDesignBiquad(const AUDIO_EqBand_t* params, uint32_t frequency, AUDIO_EqBiquad_t* biquad)
+{
+  double w0, cos_w0, alpha, a, sqrt_a, c[6];
+
+  if((params->frequency == 0) || (2 * params->frequency >= frequency) || !(params->q > 0.0f) ||
+     (params->gain_db_256 > AUDIO_EQ_MAX_GAIN_DB_256) || (params->gain_db_256 < -AUDIO_EQ_MAX_GAIN_DB_256))
+  {
+    return -1;
+  }
+  w0     = 2.0 * AUDIO_EQ_PI * params->frequency / frequency;
+  cos_w0 = cos(w0);
+  alpha  = sin(w0) / (2.0 * params->q);
+  a      = pow(10.0, params->gain_db_256 / (40.0 * 256.0));
+  sqrt_a = sqrt(a);
+
+  /* c[0..2] b0, b1, b2 and c[3..5] a0, a1, a2 */
+  switch(params->type)
+  {
+  case AUDIO_EQ_BAND_PEAK:
+    c[0] = 1.0 + alpha * a;
+    c[1] = -2.0 * cos_w0;
+    c[2] = 1.0 - alpha * a;
+    c[3] = 1.0 + alpha / a;
+    c[4] = -2.0 * cos_w0;
+    c[5] = 1.0 - alpha / a;
+    break;
+  case AUDIO_EQ_BAND_LOW_SHELF:
+    c[0] = a * ((a + 1.0) - (a - 1.0) * cos_w0 + 2.0 * sqrt_a * alpha);
+    c[1] = 2.0 * a * ((a - 1.0) - (a + 1.0) * cos_w0);
+    c[2] = a * ((a + 1.0) - (a - 1.0) * cos_w0 - 2.0 * sqrt_a * alpha);
+    c[3] = (a + 1.0) + (a - 1.0) * cos_w0 + 2.0 * sqrt_a * alpha;
+    c[4] = -2.0 * ((a - 1.0) + (a + 1.0) * cos_w0);
+    c[5] = (a + 1.0) + (a - 1.0) * cos_w0 - 2.0 * sqrt_a * alpha;
+    break;
+  case AUDIO_EQ_BAND_HIGH_SHELF:
+    c[0] = a * ((a + 1.0) + (a - 1.0) * cos_w0 + 2.0 * sqrt_a * alpha);
+    c[1] = -2.0 * a * ((a - 1.0) + (a + 1.0) * cos_w0);
+    c[2] = a * ((a + 1.0) + (a - 1.0) * cos_w0 - 2.0 * sqrt_a * alpha);
+    c[3] = (a + 1.0) - (a - 1.0) * cos_w0 + 2.0 * sqrt_a * alpha;
+    c[4] = 2.0 * ((a - 1.0) - (a + 1.0) * cos_w0);
+    c[5] = (a + 1.0) - (a - 1.0) * cos_w0 - 2.0 * sqrt_a * alpha;
+    break;
+  case AUDIO_EQ_BAND_LOW_PASS:
+    c[0] = (1.0 - cos_w0) / 2.0;
+    c[1] = 1.0 - cos_w0;
+    c[2] = (1.0 - cos_w0) / 2.0;
+    c[3] = 1.0 + alpha;
+    c[4] = -2.0 * cos_w0;
+    c[5] = 1.0 - alpha;
+    break;
+  case AUDIO_EQ_BAND_HIGH_PASS:
+    c[0] = (1.0 + cos_w0) / 2.0;
+    c[1] = -(1.0 + cos_w0);
+    c[2] = (1.0 + cos_w0) / 2.0;
+    c[3] = 1.0 + alpha;
+    c[4] = -2.0 * cos_w0;
+    c[5] = 1.0 - alpha;
+    break;
+  default:
+    return -1;
+  }
+
+  /* normalize by a0, negate a1 and a2 */
+  c[4] = -c[4];
+  c[5] = -c[5];
+  for(int i = 0; i < 6; i++)
+  {
+    if(i == 3)
+    {
+      continue;
+    }
+    c[i] /= c[3];
+    if((c[i] >= AUDIO_EQ_COEF_MAX) || (c[i] <= -AUDIO_EQ_COEF_MAX))
+    {
+      return -1;
+    }
+    c[i] = c[i] * (double)(1UL << AUDIO_EQ_COEF_FRACTION_BITS);
+    c[i] += (c[i] >= 0.0)? 0.5 : -0.5;
+  }
+  biquad->b0 = (int32_t)c[0];
+  biquad->b1 = (int32_t)c[1];
+  biquad->b2 = (int32_t)c[2];
+  biquad->a1 = (int32_t)c[4];
+  biquad->a2 = (int32_t)c[5];
+  return 0;
+}
+
+/* Private functions ---------------------------------------------------------*/
+/**
+  * @brief  AUDIO_EqDesign
+  *         Computes the coefficients of all bands for the stream sampling rate. Each band keeps its stage, so
+  *         its filter state follows it, the bands which are off or invalid at this rate get identity
+  *         coefficients. The cascade stops after the last active band.
+  * @param  eq(IN):            equalizer node
+  * @param  coefficients(OUT): set of coefficients, not in use by the node
+  * @retval None
+  */
+static void  AUDIO_EqDesign(AUDIO_EqNode_t* eq, AUDIO_EqCoefficients_t* coefficients)
+{
+  AUDIO_EqBiquad_t* biquad;
+  uint8_t count;
+
+  for(uint32_t c = 0; c < AUDIO_EQ_MAX_CHANNELS; c++)
+  {
+    count = 0;
+    for(uint32_t b = 0; b < AUDIO_EQ_MAX_BANDS; b++)
+    {
+      biquad = &coefficients->biquads[c][b];
+      if((eq->bands[c][b].type != AUDIO_EQ_BAND_OFF) &&
+         (AUDIO_EqDesignBiquad(&eq->bands[c][b], eq->frequency, biquad) == 0))
+      {
+        count = b + 1;
+      }
+      else
+      {
+        /* y = x, the state keeps the input history so the band can come back without a step */
+        biquad->b0 = (int32_t)(1UL << AUDIO_EQ_COEF_FRACTION_BITS);
+        biquad->b1 = biquad->b2 = biquad->a1 = biquad->a2 = 0;
+      }
+    }
+    coefficients->stages_count[c] = count;
+  }
+}
+
+/**
+  * @brief  AUDIO_EqConfigure
+  *         Designs the bands for the stream sampling rate and clears the filters state.
+  * @param  in_port(IN):      format of the blocks
+  * @param  out_port(IN):     same as in_port
+  * @param  node_handle(IN):  equalizer node
+  * @retval 0 if no error
+  */
+static int8_t  AUDIO_EqConfigure(const AUDIO_GraphPort_t* in_port, AUDIO_GraphPort_t* out_port, uint32_t node_handle)
+{
+  AUDIO_EqNode_t* eq;
+
+  (void)out_port;
+  eq = (AUDIO_EqNode_t*)node_handle;
+  if((in_port->channels_count == 0) || (in_port->channels_count > AUDIO_EQ_MAX_CHANNELS) ||
+     ((in_port->format != AUDIO_GRAPH_FORMAT_S16) && (in_port->format != AUDIO_GRAPH_FORMAT_S24) &&
+      (in_port->format != AUDIO_GRAPH_FORMAT_S32)))
+  {
+    return -1;
+  }
+  eq->channels_count = in_port->channels_count;
+  eq->format = in_port->format;
+  eq->frequency = in_port->frequency;
+  eq->pending = 0;
+  AUDIO_EqDesign(eq, &eq->coefficients[!eq->active]);
+  eq->active = !eq->active;
+  memset(eq->state, 0, sizeof(eq->state));
+  return 0;
+}
+
+/**
+  * @brief  AUDIO_EqCascadeDf1
+  *         Runs a sample through a cascade of biquads in direct form 1.
+  * @param  x(IN):       input sample, Q1.31
+  * @param  biquad(IN):  first biquad
+  * @param  state(IN):   state of the first biquad
+  * @param  count(IN):   count of biquads
+  * @retval output sample, Q1.31
+  */
+static int32_t AUDIO_EqCascadeDf1(int32_t x, const AUDIO_EqBiquad_t* biquad, AUDIO_EqState_t* state, uint8_t count)
+{
+  int64_t acc;
+  int32_t y;
+
+  for(; count > 0; count--, biquad++, state++)
+  {
+    acc = (int64_t)biquad->b0 * x + (int64_t)biquad->b1 * state->df1.x1 + (int64_t)biquad->b2 * state->df1.x2 +
+          (int64_t)biquad->a1 * state->df1.y1 + (int64_t)biquad->a2 * state->df1.y2 + AUDIO_EQ_ROUNDING;
+    acc >>= AUDIO_EQ_COEF_FRACTION_BITS;
+    y = AUDIO_EQ_SATURATE(acc);
+    state->df1.x2 = state->df1.x1;
+    state->df1.x1 = x;
+    state->df1.y2 = state->df1.y1;
+    state->df1.y1 = y;
+    x = y;
+  }
+  return x;
+}
+
+/**
+  * @brief  AUDIO_EqCascadeDf2t
+  *         Runs a sample through a cascade of biquads in transposed direct form 2, the state keeps the
+  *         full precision products.
+  * @param  x(IN):       input sample, Q1.31
+  * @param  biquad(IN):  first biquad
+  * @param  state(IN):   state of the first biquad
+  * @param  count(IN):   count of biquads
+  * @retval output sample, Q1.31
+  */
+static int32_t AUDIO_EqCascadeDf2t(int32_t x, const AUDIO_EqBiquad_t* biquad, AUDIO_EqState_t* state, uint8_t count)
+{
+  int64_t acc;
+  int32_t y;
+
+  for(; count > 0; count--, biquad++, state++)
+  {
+    acc = ((int64_t)biquad->b0 * x + state->df2t.d1 + AUDIO_EQ_ROUNDING) >> AUDIO_EQ_COEF_FRACTION_BITS;
+    y = AUDIO_EQ_SATURATE(acc);
+    state->df2t.d1 = (int64_t)biquad->b1 * x + (int64_t)biquad->a1 * y + state->df2t.d2;
+    state->df2t.d2 = (int64_t)biquad->b2 * x + (int64_t)biquad->a2 * y;
+    x = y;
+  }
+  return x;
+}
+
+/**
+  * @brief  AUDIO_EqExtendCascade
+  *         Sets the state of the stages added at the end of a cascade. They didn't run, their input is the
+  *         output of the last stage which ran, as if they had been identity stages.
+  * @param  eq(IN):             equalizer node
+  * @param  channel(IN):        channel index
+  * @param  previous_count(IN): stages count of the set in use
+  * @param  count(IN):          stages count of the new set
+  * @retval None
+  */
+static void  AUDIO_EqExtendCascade(AUDIO_EqNode_t* eq, int channel, uint8_t previous_count, uint8_t count)
+{
+  AUDIO_EqState_t* state = eq->state[channel];
+
+  for(int k = previous_count; k < count; k++)
+  {
+    memset(&state[k], 0, sizeof(AUDIO_EqState_t));
+    if((eq->form == AUDIO_EQ_DF1) && (previous_count > 0))
+    {
+      state[k].df1.x1 = state[k].df1.y1 = state[previous_count - 1].df1.y1;
+      state[k].df1.x2 = state[k].df1.y2 = state[previous_count - 1].df1.y2;
+    }
+  }
+}
+
+/**
+  * @brief  AUDIO_EqRun
+  *         Filters a block, swaps to the new coefficients first if bands changed.
+  * @param  in(IN):           block
+  * @param  out(IN):          same as in, in place node
+  * @param  node_handle(IN):  equalizer node
+  * @retval 0 if no error
+  */
+static int8_t  AUDIO_EqRun(const AUDIO_GraphSpan_t* in, AUDIO_GraphSpan_t* out, uint32_t node_handle)
+{
+  AUDIO_EqNode_t* eq;
+  AUDIO_EqCoefficients_t* coefficients;
+  AUDIO_EqCascade_t cascade;
+  uint8_t channels, bypass = 1;
+  uint16_t frames;
+
+  (void)out;
+  eq = (AUDIO_EqNode_t*)node_handle;
+  if(eq->pending)
+  {
+    for(uint32_t c = 0; c < AUDIO_EQ_MAX_CHANNELS; c++)
+    {
+      AUDIO_EqExtendCascade(eq, c, eq->coefficients[eq->active].stages_count[c],
+                            eq->coefficients[!eq->active].stages_count[c]);
+    }
+    eq->active = !eq->active;
+    eq->pending = 0;
+  }
+  coefficients = &eq->coefficients[eq->active];
+  channels = eq->channels_count;
+  frames = in->frames;
+  for(int c = 0; c < channels; c++)
+  {
+    bypass &= (coefficients->stages_count[c] == 0);
+  }
+  if(bypass)
+  {
+    return 0;
+  }
+  cascade = (eq->form == AUDIO_EQ_DF2T)? AUDIO_EqCascadeDf2t : AUDIO_EqCascadeDf1;
+
+  switch(eq->format)
+  {
+  case AUDIO_GRAPH_FORMAT_S16:
+    {
+      int16_t* sample = (int16_t*)in->data;
+      for(uint16_t f = 0; f < frames; f++)
+      {
+        for(int c = 0; c < channels; c++)
+        {
+          *sample = (int16_t)(cascade((int32_t)((uint32_t)*sample << 16), coefficients->biquads[c],
+                                      eq->state[c], coefficients->stages_count[c]) >> 16);
+          sample++;
+        }
+      }
+    }
+    break;
+  case AUDIO_GRAPH_FORMAT_S24:
+    {
+      uint8_t* sample = in->data;
+      for(uint16_t f = 0; f < frames; f++)
+      {
+        for(int c = 0; c < channels; c++)
+        {
+          /* packed little endian sample, processed MSB aligned */
+          int32_t value = (int32_t)(((uint32_t)sample[0] << 8) | ((uint32_t)sample[1] << 16) | ((uint32_t)sample[2] << 24));
+          value = cascade(value, coefficients->biquads[c], eq->state[c], coefficients->stages_count[c]);
+          sample[0] = (uint8_t)(value >> 8);
+          sample[1] = (uint8_t)(value >> 16);
+          sample[2] = (uint8_t)(value >> 24);
+          sample += 3;
+        }
+      }
+    }
+    break;
+  default: /* AUDIO_GRAPH_FORMAT_S32 */
+    {
+      int32_t* sample = (int32_t*)in->data;
+      for(uint16_t f = 0; f < frames; f++)
+      {
+        for(int c = 0; c < channels; c++)
+        {
+          *sample = cascade(*sample, coefficients->biquads[c], eq->state[c], coefficients->stages_count[c]);
+          sample++;
+        }
+      }
+    }
+    break;
+  }
+  return 0;
+}
+#endif /* USE_AUDIO_PLAYBACK_EQ */
+/************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
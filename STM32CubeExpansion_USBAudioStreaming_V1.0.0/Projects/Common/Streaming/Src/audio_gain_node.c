@@ -0,0 +1,310 @@
+/**
+  ******************************************************************************
+  * @file    audio_gain_node.c
+  * @author  MCD Application Team
+  * @brief   software volume and mute processing node.
+  *          The feature unit volume (1/256 db steps) is converted to a Q8.24
+  *          gain with two tables, whole db and fraction of db, so each step is
+  *          exact and no I2C transfer is needed. The gain is applied in place,
+  *          on each block, and ramps linearly from the previous gain to the
+  *          requested one over the block. Mute ramps the gain down to 0.
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2019  STMicroelectronics.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by ST under Ultimate Liberty license
+  * SLA0044, the "License"; You may not use this file except in compliance with
+  * the License. You may obtain a copy of the License at:
+  *                             www.st.com/SLA0044
+  *
+  ******************************************************************************
+  */
+/* Includes ------------------------------------------------------------------*/
+#include <string.h>
+#include "audio_gain_node.h"
+
+#if USE_AUDIO_SOFTWARE_VOLUME
+#if !USE_AUDIO_PROCESSING_GRAPH
+#error "USE_AUDIO_SOFTWARE_VOLUME requires USE_AUDIO_PROCESSING_GRAPH"
+#endif /* !USE_AUDIO_PROCESSING_GRAPH */
+
+/* Private macros ------------------------------------------------------------*/
+#define AUDIO_GAIN_APPLY(sample, gain)  ((int64_t)(sample) * (gain) >> AUDIO_GAIN_FRACTION_BITS)
+#define AUDIO_GAIN_SATURATE(value, bits) (((value) > ((1LL << ((bits) - 1)) - 1))? (int32_t)((1LL << ((bits) - 1)) - 1) :\
+                                         (((value) < -(1LL << ((bits) - 1)))? (int32_t)-(1LL << ((bits) - 1)) : (int32_t)(value)))
+
+/* Private variables ---------------------------------------------------------*/
+/* 10^(db/20) in Q8.24, db from AUDIO_GAIN_MIN_DB_256/256 to AUDIO_GAIN_MAX_DB_256/256 */
+static const int32_t AUDIO_GainDbTable[] =
+{
+  266, 298, 335, 376, 421, 473, 531,
+  595, 668, 749, 841, 943, 1059, 1188,
+  1333, 1495, 1678, 1882, 2112, 2370, 2659,
+  2983, 3347, 3756, 4214, 4728, 5305, 5953,
+  6679, 7494, 8409, 9435, 10586, 11877, 13327,
+  14953, 16777, 18824, 21121, 23698, 26590, 29835,
+  33475, 37560, 42142, 47285, 53054, 59528, 66791,
+  74941, 84085, 94345, 105857, 118774, 133266, 149527,
+  167772, 188243, 211213, 236984, 265901, 298346, 334749,
+  375595, 421425, 472846, 530542, 595278, 667913, 749411,
+  840853, 943452, 1058571, 1187736, 1332662, 1495271, 1677722,
+  1882435, 2112126, 2369845, 2659010, 2983458, 3347495, 3755951,
+  4214246, 4728462, 5305422, 5952781, 6679130, 7494107, 8408526,
+  9434522, 10585708, 11877359, 13326616, 14952709, 16777216, 18824346,
+  21121264, 23698447, 26590095, 29834578, 33474947, 37559508, 42142461,
+  47284619, 53054215, 59527809, 66791300, 74941071, 84085265, 94345219,
+  105857077, 118773593, 133266164, 149527095, 167772160, 188243460, 211212636,
+  236984475, 265900954, 298345778, 334749468, 375595081, 421424612, 472846192,
+  530542154, 595278087, 667912999, 749410711, 840852648, 943452188, 1058570766,
+  1187735934, 1332661637, 1495270950, 1677721600, 1882434596, 2112126356
+};
+/* 10^(f/5120) in Q2.30, f = 16 * i for the high table and f = i for the low table */
+static const uint32_t AUDIO_GainFractionHighTable[16] =
+{
+  1073741824, 1081495882, 1089305935, 1097172389, 1105095651, 1113076131, 1121114243, 1129210402,
+  1137365027, 1145578541, 1153851370, 1162183941, 1170576685, 1179030039, 1187544438, 1196120324
+};
+static const uint32_t AUDIO_GainFractionLowTable[16] =
+{
+  1073741824, 1074224820, 1074708033, 1075191463, 1075675111, 1076158976, 1076643059, 1077127360,
+  1077611878, 1078096615, 1078581570, 1079066742, 1079552133, 1080037743, 1080523570, 1081009617
+};
+
+/* Private function prototypes -----------------------------------------------*/
+static int8_t  AUDIO_GainConfigure(const AUDIO_GraphPort_t* in_port, AUDIO_GraphPort_t* out_port, uint32_t node_handle);
+static int8_t  AUDIO_GainRun(const AUDIO_GraphSpan_t* in, AUDIO_GraphSpan_t* out, uint32_t node_handle);
+static void    AUDIO_GainUpdateTargets(AUDIO_GainNode_t* gain);
+
+/* Exported functions --------------------------------------------------------*/
+/**
+  * @brief  AUDIO_GainInit
+  *         Initializes the gain node, all channels at 0 db and not muted. The node is then added to a graph.
+  * @param  gain(IN): gain node
+  * @retval 0 if no error
+  */
+int8_t  AUDIO_GainInit(AUDIO_GainNode_t* gain)
+{
+  memset(gain, 0, sizeof(AUDIO_GainNode_t));
+  gain->processing.flags = AUDIO_PROCESSING_IN_PLACE;
+  gain->processing.ProcessingConfigure = AUDIO_GainConfigure;
+  gain->processing.ProcessingRun = AUDIO_GainRun;
+  AUDIO_GainUpdateTargets(gain);
+  return 0;
+}
+
+/**
+  * @brief  AUDIO_GainSetVolume
+  *         Sets the volume of a channel, the new gain is reached at the end of the next block.
+  *         Prototype of the feature unit SetCurrentVolume command.
+  * @param  channel_number(IN): 0 for master channel, else channel number
+  * @param  volume_db_256(IN):  volume in 1/256 db
+  * @param  node_handle(IN):    gain node
+  * @retval 0 if no error
+  */
+int8_t  AUDIO_GainSetVolume(uint16_t channel_number, int volume_db_256, uint32_t node_handle)
+{
+  AUDIO_GainNode_t* gain;
+
+  gain = (AUDIO_GainNode_t*)node_handle;
+  if(channel_number > AUDIO_GAIN_MAX_CHANNELS)
+  {
+    return -1;
+  }
+  gain->volume_db_256[channel_number] = volume_db_256;
+  AUDIO_GainUpdateTargets(gain);
+  return 0;
+}
+
+/**
+  * @brief  AUDIO_GainSetMute
+  *         Mutes or unmutes a channel, the gain ramps down to 0 or up to the volume over the next block.
+  *         Prototype of the feature unit SetMute command.
+  * @param  channel_number(IN): 0 for master channel, else channel number
+  * @param  mute(IN):           1 to mute
+  * @param  node_handle(IN):    gain node
+  * @retval 0 if no error
+  */
+int8_t  AUDIO_GainSetMute(uint16_t channel_number, uint8_t mute, uint32_t node_handle)
+{
+  AUDIO_GainNode_t* gain;
+
+  gain = (AUDIO_GainNode_t*)node_handle;
+  if(channel_number > AUDIO_GAIN_MAX_CHANNELS)
+  {
+    return -1;
+  }
+  gain->mute[channel_number] = mute;
+  AUDIO_GainUpdateTargets(gain);
+  return 0;
+}
+
+/**
+  * @brief  AUDIO_GainFromDb256
+  *         Converts a volume to a linear gain.
+  * @param  volume_db_256(IN): volume in 1/256 db, saturated to AUDIO_GAIN_MAX_DB_256
+  * @retval gain in Q8.24, 0 below AUDIO_GAIN_MIN_DB_256
+  */
+int32_t AUDIO_GainFromDb256(int volume_db_256)
+{
+  uint32_t index;
+  uint64_t value;
+
+  if(volume_db_256 < AUDIO_GAIN_MIN_DB_256)
+  {
+    return 0;
+  }
+  if(volume_db_256 > AUDIO_GAIN_MAX_DB_256)
+  {
+    volume_db_256 = AUDIO_GAIN_MAX_DB_256;
+  }
+  /* whole db from the first table, fraction of db (8 bits) from the two next ones */
+  index = (uint32_t)(volume_db_256 - AUDIO_GAIN_MIN_DB_256);
+  value = ((uint64_t)AUDIO_GainDbTable[index >> 8] * AUDIO_GainFractionHighTable[(index >> 4) & 0x0F]) >> 30;
+  value = (value * AUDIO_GainFractionLowTable[index & 0x0F]) >> 30;
+  return (int32_t)value;
+}
+
+/* Private functions ---------------------------------------------------------*/
+/**
+  * @brief  AUDIO_GainUpdateTargets
+  *         Computes the gain of each channel from the master and channel controls.
+  * @param  gain(IN): gain node
+  * @retval None
+  */
+static void  AUDIO_GainUpdateTargets(AUDIO_GainNode_t* gain)
+{
+  for(uint32_t i = 0; i < AUDIO_GAIN_MAX_CHANNELS; i++)
+  {
+    if(gain->mute[0] || gain->mute[i + 1])
+    {
+      gain->target[i] = 0;
+    }
+    else
+    {
+      gain->target[i] = AUDIO_GainFromDb256(gain->volume_db_256[0] + gain->volume_db_256[i + 1]);
+    }
+  }
+}
+
+/**
+  * @brief  AUDIO_GainConfigure
+  *         Checks the block format. The stream fades in from silence over its first block.
+  * @param  in_port(IN):      format of the blocks
+  * @param  out_port(IN):     same as in_port
+  * @param  node_handle(IN):  gain node
+  * @retval 0 if no error
+  */
+static int8_t  AUDIO_GainConfigure(const AUDIO_GraphPort_t* in_port, AUDIO_GraphPort_t* out_port, uint32_t node_handle)
+{
+  AUDIO_GainNode_t* gain;
+
+  (void)out_port;
+  gain = (AUDIO_GainNode_t*)node_handle;
+  if((in_port->channels_count == 0) || (in_port->channels_count > AUDIO_GAIN_MAX_CHANNELS) ||
+     ((in_port->format != AUDIO_GRAPH_FORMAT_S16) && (in_port->format != AUDIO_GRAPH_FORMAT_S24) &&
+      (in_port->format != AUDIO_GRAPH_FORMAT_S32)))
+  {
+    return -1;
+  }
+  gain->channels_count = in_port->channels_count;
+  gain->format = in_port->format;
+  memset(gain->gain, 0, sizeof(gain->gain));
+  return 0;
+}
+
+/**
+  * @brief  AUDIO_GainRun
+  *         Applies the gain to a block, the gain of each channel moves by a constant step from a frame
+  *         to the next one and reaches the requested gain on the last frame.
+  * @param  in(IN):           block
+  * @param  out(IN):          same as in, in place node
+  * @param  node_handle(IN):  gain node
+  * @retval 0 if no error
+  */
+static int8_t  AUDIO_GainRun(const AUDIO_GraphSpan_t* in, AUDIO_GraphSpan_t* out, uint32_t node_handle)
+{
+  AUDIO_GainNode_t* gain;
+  int32_t current[AUDIO_GAIN_MAX_CHANNELS], step[AUDIO_GAIN_MAX_CHANNELS];
+  uint8_t channels, unity = 1;
+  uint16_t frames;
+
+  (void)out;
+  gain = (AUDIO_GainNode_t*)node_handle;
+  channels = gain->channels_count;
+  frames = in->frames;
+  if(frames == 0)
+  {
+    return 0;
+  }
+  for(int c = 0; c < channels; c++)
+  {
+    int32_t target = gain->target[c];
+
+    /* the last frame gets the target gain */
+    step[c] = (target - gain->gain[c]) / (int32_t)frames;
+    current[c] = target - step[c] * (int32_t)(frames - 1);
+    gain->gain[c] = target;
+    unity &= ((step[c] == 0) && (target == AUDIO_GAIN_UNITY));
+  }
+  if(unity)
+  {
+    /* 0 db, block is unchanged */
+    return 0;
+  }
+
+  switch(gain->format)
+  {
+  case AUDIO_GRAPH_FORMAT_S16:
+    {
+      int16_t* sample = (int16_t*)in->data;
+      for(uint16_t f = 0; f < frames; f++)
+      {
+        for(int c = 0; c < channels; c++)
+        {
+          int64_t value = AUDIO_GAIN_APPLY(*sample, current[c]);
+          *sample++ = (int16_t)AUDIO_GAIN_SATURATE(value, 16);
+          current[c] += step[c];
+        }
+      }
+    }
+    break;
+  case AUDIO_GRAPH_FORMAT_S24:
+    {
+      uint8_t* sample = in->data;
+      for(uint16_t f = 0; f < frames; f++)
+      {
+        for(int c = 0; c < channels; c++)
+        {
+          /* packed little endian sample, sign extended from the MSB */
+          int32_t in_value = (int32_t)(((uint32_t)sample[0] << 8) | ((uint32_t)sample[1] << 16) | ((uint32_t)sample[2] << 24)) >> 8;
+          int32_t value = AUDIO_GAIN_SATURATE(AUDIO_GAIN_APPLY(in_value, current[c]), 24);
+          sample[0] = (uint8_t)value;
+          sample[1] = (uint8_t)(value >> 8);
+          sample[2] = (uint8_t)(value >> 16);
+          sample += 3;
+          current[c] += step[c];
+        }
+      }
+    }
+    break;
+  default: /* AUDIO_GRAPH_FORMAT_S32 */
+    {
+      int32_t* sample = (int32_t*)in->data;
+      for(uint16_t f = 0; f < frames; f++)
+      {
+        for(int c = 0; c < channels; c++)
+        {
+          int64_t value = AUDIO_GAIN_APPLY(*sample, current[c]);
+          *sample++ = AUDIO_GAIN_SATURATE(value, 32);
+          current[c] += step[c];
+        }
+      }
+    }
+    break;
+  }
+  return 0;
+}
+#endif /* USE_AUDIO_SOFTWARE_VOLUME */
+/************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
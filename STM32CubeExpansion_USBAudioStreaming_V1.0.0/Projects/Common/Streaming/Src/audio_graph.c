@@ -0,0 +1,219 @@
+/**
+  ******************************************************************************
+  * @file    audio_graph.c
+  * @author  MCD Application Team
+  * @brief   processing graph of a session.
+  *          A graph is a chain of processing nodes (AUDIO_PROCESSING type) run
+  *          once per block, on the contiguous span of the circular buffer which
+  *          is about to be consumed (injected to the codec or sent to the host).
+  *          Buffers are planned when the block format changes: in place nodes
+  *          work on the current buffer, out of place nodes alternate between
+  *          the block and one scratch buffer, so no copy is done between nodes.
+  *          The graph output must have the rate and sample format of its
+  *          input, a node may reduce the channels count (beamformer), the
+  *          output then fills the beginning of the block.
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2019  STMicroelectronics.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by ST under Ultimate Liberty license
+  * SLA0044, the "License"; You may not use this file except in compliance with
+  * the License. You may obtain a copy of the License at:
+  *                             www.st.com/SLA0044
+  *
+  ******************************************************************************
+  */
+/* Includes ------------------------------------------------------------------*/
+#include <string.h>
+#include "audio_graph.h"
+
+#if USE_AUDIO_PROCESSING_GRAPH
+/* Private macros ------------------------------------------------------------*/
+#define AUDIO_GRAPH_SAME_PORT(port1, port2) (((port1)->frequency == (port2)->frequency)&&\
+                                             ((port1)->channels_count == (port2)->channels_count)&&\
+                                             ((port1)->format == (port2)->format))
+
+/* Exported functions --------------------------------------------------------*/
+/**
+  * @brief  AUDIO_GraphInit
+  *         Initializes an empty graph.
+  * @param  graph(IN):         graph to initialize
+  * @param  scratch(IN):       working buffer of out of place nodes, 4 bytes aligned
+  * @param  scratch_size(IN):  size in bytes, must hold a block in the largest intermediate format
+  * @retval 0 if no error
+  */
+int8_t  AUDIO_GraphInit(AUDIO_Graph_t* graph, uint8_t* scratch, uint16_t scratch_size)
+{
+  memset(graph, 0, sizeof(AUDIO_Graph_t));
+  graph->scratch = scratch;
+  graph->scratch_size = scratch_size;
+  graph->state = AUDIO_GRAPH_NOT_PLANNED;
+  return 0;
+}
+
+/**
+  * @brief  AUDIO_GraphAddNode
+  *         Appends a processing node to the graph. Nodes must be added before the session starts.
+  * @param  graph(IN): initialized graph
+  * @param  node(IN):  processing node, callbacks must be set
+  * @retval 0 if no error
+  */
+int8_t  AUDIO_GraphAddNode(AUDIO_Graph_t* graph, AUDIO_ProcessingNode_t* node)
+{
+  if((graph->node_count == AUDIO_GRAPH_MAX_NODES) || (node->ProcessingRun == 0))
+  {
+    return -1;
+  }
+  node->node.type = AUDIO_PROCESSING;
+  graph->nodes[graph->node_count++] = node;
+  graph->state = AUDIO_GRAPH_NOT_PLANNED;
+  return 0;
+}
+
+/**
+  * @brief  AUDIO_GraphPlan
+  *         Configures the nodes for the input format and selects the output buffer of each node.
+  * @param  graph(IN): graph
+  * @param  port(IN):  format of the processed blocks
+  * @retval 0 if no error, else the graph is set in error state and blocks are not processed
+  */
+int8_t  AUDIO_GraphPlan(AUDIO_Graph_t* graph, const AUDIO_GraphPort_t* port)
+{
+  AUDIO_ProcessingNode_t* node;
+  uint16_t block_frame_size, frame_size, max_frames;
+  uint8_t in_scratch = 0, out_scratch;
+
+  graph->ports[0] = *port;
+  graph->scratch_map = 0;
+  graph->max_frames = 0xFFFF;
+  graph->latency_frames = 0;
+  graph->state = AUDIO_GRAPH_ERROR;
+  block_frame_size = AUDIO_GRAPH_FRAME_SIZE(port);
+  if(block_frame_size == 0)
+  {
+    return -1;
+  }
+
+  for(int i = 0; i < graph->node_count; i++)
+  {
+    node = graph->nodes[i];
+    graph->ports[i + 1] = graph->ports[i];
+    if((node->ProcessingConfigure) &&
+       (node->ProcessingConfigure(&graph->ports[i], &graph->ports[i + 1], (uint32_t)node) != 0))
+    {
+      return -1;
+    }
+    graph->latency_frames += node->latency_frames;
+    /* nodes don't resample, block keeps the same frames count along the graph */
+    if(graph->ports[i + 1].frequency != graph->ports[i].frequency)
+    {
+      return -1;
+    }
+    frame_size = AUDIO_GRAPH_FRAME_SIZE(&graph->ports[i + 1]);
+    if(node->flags & AUDIO_PROCESSING_IN_PLACE)
+    {
+      if(frame_size > AUDIO_GRAPH_FRAME_SIZE(&graph->ports[i]))
+      {
+        return -1;
+      }
+      out_scratch = in_scratch;
+    }
+    else
+    {
+      out_scratch = !in_scratch;
+    }
+    if(out_scratch)
+    {
+      graph->scratch_map |= (1U << i);
+      max_frames = (frame_size == 0)? 0xFFFF : graph->scratch_size / frame_size;
+      if(max_frames < graph->max_frames)
+      {
+        graph->max_frames = max_frames;
+      }
+    }
+    else if(frame_size > block_frame_size)
+    {
+      /* doesn't fit in the block */
+      return -1;
+    }
+    in_scratch = out_scratch;
+  }
+  if((graph->ports[graph->node_count].frequency != port->frequency) ||
+     (graph->ports[graph->node_count].format != port->format) ||
+     (graph->ports[graph->node_count].channels_count > port->channels_count))
+  {
+    return -1;
+  }
+  graph->state = AUDIO_GRAPH_PLANNED;
+  return 0;
+}
+
+/**
+  * @brief  AUDIO_GraphProcess
+  *         Runs the graph nodes on a block, the result replaces the block content. Its size is the block
+  *         frames count times the frame size of the last node port.
+  *         The graph is planned again if the block format changes.
+  * @param  graph(IN):  graph
+  * @param  port(IN):   format of the block
+  * @param  data(IN):   block of interleaved samples
+  * @param  length(IN): block size in bytes
+  * @retval 0 if no error. In case of error, the nodes which ran before the failing one may have modified
+  *         the block, the caller replaces it by silence
+  */
+int8_t  AUDIO_GraphProcess(AUDIO_Graph_t* graph, const AUDIO_GraphPort_t* port, uint8_t* data, uint16_t length)
+{
+  AUDIO_GraphSpan_t in, out;
+  AUDIO_ProcessingNode_t* node;
+
+  if(graph->node_count == 0)
+  {
+    return 0;
+  }
+  if((graph->state == AUDIO_GRAPH_NOT_PLANNED) || !AUDIO_GRAPH_SAME_PORT(&graph->ports[0], port))
+  {
+    AUDIO_GraphPlan(graph, port);
+  }
+  if(graph->state != AUDIO_GRAPH_PLANNED)
+  {
+    return -1;
+  }
+
+  in.data   = data;
+  in.port   = &graph->ports[0];
+  in.frames = length / AUDIO_GRAPH_FRAME_SIZE(in.port);
+  in.length = length;
+  if(in.frames > graph->max_frames)
+  {
+    return -1;
+  }
+  for(int i = 0; i < graph->node_count; i++)
+  {
+    node = graph->nodes[i];
+    out.port   = &graph->ports[i + 1];
+    out.frames = in.frames;
+    out.length = in.frames * AUDIO_GRAPH_FRAME_SIZE(out.port);
+    if(node->flags & AUDIO_PROCESSING_IN_PLACE)
+    {
+      out.data = in.data;
+    }
+    else
+    {
+      out.data = (graph->scratch_map & (1U << i))? graph->scratch : data;
+    }
+    if(node->ProcessingRun(&in, &out, (uint32_t)node) != 0)
+    {
+      return -1;
+    }
+    in = out;
+  }
+  if(in.data != data)
+  {
+    /* odd count of out of place nodes */
+    memcpy(data, in.data, in.length);
+  }
+  return 0;
+}
+#endif /* USE_AUDIO_PROCESSING_GRAPH */
+/************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
@@ -0,0 +1,307 @@
+/**
+  ******************************************************************************
+  * @file    audio_limiter_node.c
+  * @author  MCD Application Team
+  * @brief   look-ahead peak limiter processing node.
+  *          The node delays the block by the look-ahead time, computes for each
+  *          input frame the gain which brings its peak to the ceiling and
+  *          smooths the gains so the delayed frame is played with a gain lower
+  *          or equal to the one it requires. The output never exceeds the
+  *          ceiling. The delay is the node latency, the configured look-ahead
+  *          is reported to the host in the playback AS interface bDelay.
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2019  STMicroelectronics.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by ST under Ultimate Liberty license
+  * SLA0044, the "License"; You may not use this file except in compliance with
+  * the License. You may obtain a copy of the License at:
+  *                             www.st.com/SLA0044
+  *
+  ******************************************************************************
+  */
+/* Includes ------------------------------------------------------------------*/
+#include <string.h>
+#include <math.h>
+#include "audio_limiter_node.h"
+
+#if USE_AUDIO_PLAYBACK_LIMITER
+#if !USE_AUDIO_PROCESSING_GRAPH
+#error "USE_AUDIO_PLAYBACK_LIMITER requires USE_AUDIO_PROCESSING_GRAPH"
+#endif /* !USE_AUDIO_PROCESSING_GRAPH */
+
+/* Private function prototypes -----------------------------------------------*/
+static int8_t  AUDIO_LimiterConfigure(const AUDIO_GraphPort_t* in_port, AUDIO_GraphPort_t* out_port, uint32_t node_handle);
+static int8_t  AUDIO_LimiterRun(const AUDIO_GraphSpan_t* in, AUDIO_GraphSpan_t* out, uint32_t node_handle);
+static void    AUDIO_LimiterFrame(AUDIO_LimiterNode_t* limiter, int32_t* frame);
+
+/* Exported functions --------------------------------------------------------*/
+/**
+  * @brief  AUDIO_LimiterInit
+  *         Initializes the limiter node. The node is then added to a graph, at its end so it limits the
+  *         peaks of the previous nodes.
+  * @param  limiter(IN): limiter node
+  * @param  params(IN):  ceiling, look-ahead and release time
+  * @retval 0 if no error
+  */
+int8_t  AUDIO_LimiterInit(AUDIO_LimiterNode_t* limiter, const AUDIO_LimiterParams_t* params)
+{
+  if((params->ceiling_db_256 > 0) || (params->lookahead_us > AUDIO_LIMITER_MAX_LOOKAHEAD_US))
+  {
+    return -1;
+  }
+  memset(limiter, 0, sizeof(AUDIO_LimiterNode_t));
+  limiter->params = *params;
+  limiter->processing.flags = AUDIO_PROCESSING_IN_PLACE;
+  limiter->processing.ProcessingConfigure = AUDIO_LimiterConfigure;
+  limiter->processing.ProcessingRun = AUDIO_LimiterRun;
+  return 0;
+}
+
+/* Private functions ---------------------------------------------------------*/
+/**
+  * @brief  AUDIO_LimiterConfigure
+  *         Sizes the look-ahead for the stream sampling rate and resets the node to unity gain and
+  *         silent delay line.
+  * @param  in_port(IN):      format of the blocks
+  * @param  out_port(IN):     same as in_port
+  * @param  node_handle(IN):  limiter node
+  * @retval 0 if no error
+  */
+static int8_t  AUDIO_LimiterConfigure(const AUDIO_GraphPort_t* in_port, AUDIO_GraphPort_t* out_port, uint32_t node_handle)
+{
+  AUDIO_LimiterNode_t* limiter;
+  uint32_t delay_frames, release_frames;
+  double ceiling;
+
+  (void)out_port;
+  limiter = (AUDIO_LimiterNode_t*)node_handle;
+  if((in_port->channels_count == 0) || (in_port->channels_count > AUDIO_LIMITER_MAX_CHANNELS) ||
+     ((in_port->format != AUDIO_GRAPH_FORMAT_S16) && (in_port->format != AUDIO_GRAPH_FORMAT_S24) &&
+      (in_port->format != AUDIO_GRAPH_FORMAT_S32)))
+  {
+    return -1;
+  }
+  delay_frames = ((uint32_t)limiter->params.lookahead_us * in_port->frequency + 500000) / 1000000;
+  if(delay_frames > AUDIO_LIMITER_MAX_DELAY_FRAMES)
+  {
+    return -1;
+  }
+  limiter->channels_count = in_port->channels_count;
+  limiter->format = in_port->format;
+  limiter->window_frames = delay_frames + 1;
+  limiter->processing.latency_frames = delay_frames;
+
+  /* ceiling is rounded down to the output LSB, so the conversion to the output format doesn't exceed it */
+  ceiling = pow(10.0, limiter->params.ceiling_db_256 / (20.0 * 256.0)) * 2147483647.0;
+  limiter->ceiling = (int32_t)ceiling;
+  if(limiter->format == AUDIO_GRAPH_FORMAT_S16)
+  {
+    limiter->ceiling &= (int32_t)0xFFFF0000;
+  }
+  else if(limiter->format == AUDIO_GRAPH_FORMAT_S24)
+  {
+    limiter->ceiling &= (int32_t)0xFFFFFF00;
+  }
+
+  release_frames = (uint32_t)limiter->params.release_ms * in_port->frequency / 1000;
+  limiter->release_coef = (release_frames > 1)? 0x80000000U / release_frames : 0x7FFFFFFFU;
+
+  limiter->gain = AUDIO_LIMITER_GAIN_UNITY;
+  limiter->sum = (uint32_t)AUDIO_LIMITER_GAIN_UNITY * limiter->window_frames;
+  for(int i = 0; i < limiter->window_frames; i++)
+  {
+    limiter->average[i] = AUDIO_LIMITER_GAIN_UNITY;
+  }
+  limiter->frame_count = 0;
+  limiter->window_pos = 0;
+  limiter->delay_pos = 0;
+  limiter->min_head = 0;
+  limiter->min_count = 0;
+  memset(limiter->delay, 0, sizeof(limiter->delay));
+  return 0;
+}
+
+/**
+  * @brief  AUDIO_LimiterFrame
+  *         Limits a frame, the frame is replaced by the delayed frame.
+  * @param  limiter(IN):  limiter node
+  * @param  frame(IN):    Q1.31 samples of the frame
+  * @retval None
+  */
+static void  AUDIO_LimiterFrame(AUDIO_LimiterNode_t* limiter, int32_t* frame)
+{
+  uint32_t peak = 0, magnitude;
+  int32_t required, min_gain, average;
+  uint16_t window, tail;
+  int64_t product;
+
+  /* gain which brings the frame peak to the ceiling */
+  for(int c = 0; c < limiter->channels_count; c++)
+  {
+    magnitude = (frame[c] < 0)? (0U - (uint32_t)frame[c]) : (uint32_t)frame[c];
+    if(magnitude > peak)
+    {
+      peak = magnitude;
+    }
+  }
+  required = AUDIO_LIMITER_GAIN_UNITY;
+  if(peak > (uint32_t)limiter->ceiling)
+  {
+    /* FPU division, the gain is rounded down */
+    required = (int32_t)((float)limiter->ceiling / (float)peak * (float)AUDIO_LIMITER_GAIN_UNITY) - 1;
+    if(required < 0)
+    {
+      required = 0;
+    }
+  }
+
+  /* running minimum over the window : queue of increasing gains, oldest first */
+  window = limiter->window_frames;
+  limiter->frame_count++;
+  if(limiter->min_count && (limiter->frame_count - limiter->min_frame[limiter->min_head] >= window))
+  {
+    limiter->min_head = (limiter->min_head + 1 == window)? 0 : limiter->min_head + 1;
+    limiter->min_count--;
+  }
+  while(limiter->min_count)
+  {
+    tail = (limiter->min_head + limiter->min_count - 1) % window;
+    if(limiter->min_gain[tail] < required)
+    {
+      break;
+    }
+    limiter->min_count--;
+  }
+  tail = (limiter->min_head + limiter->min_count) % window;
+  limiter->min_gain[tail] = required;
+  limiter->min_frame[tail] = limiter->frame_count;
+  limiter->min_count++;
+  min_gain = limiter->min_gain[limiter->min_head];
+
+  /* moving average over the window, rounded down */
+  limiter->sum += min_gain - limiter->average[limiter->window_pos];
+  limiter->average[limiter->window_pos] = min_gain;
+  limiter->window_pos = (limiter->window_pos + 1 == window)? 0 : limiter->window_pos + 1;
+  average = (int32_t)(limiter->sum / window);
+
+  /* instant attack, the average already ramps over the look-ahead, first order release */
+  if(average <= limiter->gain)
+  {
+    limiter->gain = average;
+  }
+  else
+  {
+    limiter->gain += (int32_t)(((int64_t)(average - limiter->gain) * limiter->release_coef) >> 31) + 1;
+    if(limiter->gain > average)
+    {
+      limiter->gain = average;
+    }
+  }
+
+  /* delayed frame out, new frame in */
+  for(int c = 0; c < limiter->channels_count; c++)
+  {
+    int32_t sample = frame[c];
+    if(window > 1)
+    {
+      frame[c] = limiter->delay[limiter->delay_pos][c];
+      limiter->delay[limiter->delay_pos][c] = sample;
+    }
+    if(limiter->gain != AUDIO_LIMITER_GAIN_UNITY)
+    {
+      /* rounded toward zero */
+      product = (int64_t)frame[c] * limiter->gain;
+      frame[c] = (int32_t)((product < 0)? -((-product) >> AUDIO_LIMITER_GAIN_FRACTION_BITS) :
+                                          (product >> AUDIO_LIMITER_GAIN_FRACTION_BITS));
+    }
+    if(frame[c] > limiter->ceiling)
+    {
+      frame[c] = limiter->ceiling;
+    }
+    else if(frame[c] < -limiter->ceiling)
+    {
+      frame[c] = -limiter->ceiling;
+    }
+  }
+  if(window > 1)
+  {
+    limiter->delay_pos = (limiter->delay_pos + 2 == window)? 0 : limiter->delay_pos + 1;
+  }
+}
+
+/**
+  * @brief  AUDIO_LimiterRun
+  *         Limits a block.
+  * @param  in(IN):           block
+  * @param  out(IN):          same as in, in place node
+  * @param  node_handle(IN):  limiter node
+  * @retval 0 if no error
+  */
+static int8_t  AUDIO_LimiterRun(const AUDIO_GraphSpan_t* in, AUDIO_GraphSpan_t* out, uint32_t node_handle)
+{
+  AUDIO_LimiterNode_t* limiter;
+  int32_t frame[AUDIO_LIMITER_MAX_CHANNELS];
+  uint8_t channels;
+  uint16_t frames;
+
+  (void)out;
+  limiter = (AUDIO_LimiterNode_t*)node_handle;
+  channels = limiter->channels_count;
+  frames = in->frames;
+
+  switch(limiter->format)
+  {
+  case AUDIO_GRAPH_FORMAT_S16:
+    {
+      int16_t* sample = (int16_t*)in->data;
+      for(uint16_t f = 0; f < frames; f++, sample += channels)
+      {
+        for(int c = 0; c < channels; c++)
+        {
+          frame[c] = (int32_t)((uint32_t)sample[c] << 16);
+        }
+        AUDIO_LimiterFrame(limiter, frame);
+        for(int c = 0; c < channels; c++)
+        {
+          sample[c] = (int16_t)(frame[c] >> 16);
+        }
+      }
+    }
+    break;
+  case AUDIO_GRAPH_FORMAT_S24:
+    {
+      uint8_t* sample = in->data;
+      for(uint16_t f = 0; f < frames; f++, sample += 3 * channels)
+      {
+        for(int c = 0; c < channels; c++)
+        {
+          frame[c] = (int32_t)(((uint32_t)sample[3 * c] << 8) | ((uint32_t)sample[3 * c + 1] << 16) |
+                               ((uint32_t)sample[3 * c + 2] << 24));
+        }
+        AUDIO_LimiterFrame(limiter, frame);
+        for(int c = 0; c < channels; c++)
+        {
+          sample[3 * c]     = (uint8_t)(frame[c] >> 8);
+          sample[3 * c + 1] = (uint8_t)(frame[c] >> 16);
+          sample[3 * c + 2] = (uint8_t)(frame[c] >> 24);
+        }
+      }
+    }
+    break;
+  default: /* AUDIO_GRAPH_FORMAT_S32 */
+    {
+      int32_t* sample = (int32_t*)in->data;
+      for(uint16_t f = 0; f < frames; f++, sample += channels)
+      {
+        AUDIO_LimiterFrame(limiter, sample);
+      }
+    }
+    break;
+  }
+  return 0;
+}
+#endif /* USE_AUDIO_PLAYBACK_LIMITER */
+/************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
@@ -0,0 +1,505 @@
+/**
+  ******************************************************************************
+  * @file    audio_mixer_node.c
+  * @author  MCD Application Team
+  * @brief   mixer processing node.
+  *          Adds to the graph block the streams of several inputs, each input
+  *          has its own ring, read pointer, volume and pan. The gains move
+  *          linearly along the block, so inputs starting, stopping or running
+  *          out of samples fade in and out instead of clicking. Inputs clocked
+  *          apart from the playback are kept around their threshold by reading
+  *          one frame more or less than the block, interpolated over the block.
+  *          The inputs are filled by sources of the device (the sidetone tap),
+  *          the class has a single playback streaming interface.
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2019  STMicroelectronics.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by ST under Ultimate Liberty license
+  * SLA0044, the "License"; You may not use this file except in compliance with
+  * the License. You may obtain a copy of the License at:
+  *                             www.st.com/SLA0044
+  *
+  ******************************************************************************
+  */
+/* Includes ------------------------------------------------------------------*/
+#include <string.h>
+#include <math.h>
+#include "audio_mixer_node.h"
+#if defined(__ARM_FEATURE_DSP) && (__ARM_FEATURE_DSP == 1)
+#include "cmsis_compiler.h"
+#endif /* __ARM_FEATURE_DSP */
+
+#if USE_AUDIO_PLAYBACK_MIXER
+#if !USE_AUDIO_PROCESSING_GRAPH
+#error "USE_AUDIO_PLAYBACK_MIXER requires USE_AUDIO_PROCESSING_GRAPH"
+#endif /* !USE_AUDIO_PROCESSING_GRAPH */
+
+/* Private defines -----------------------------------------------------------*/
+#define AUDIO_MIXER_PI                  3.14159265358979323846
+/* drift compensation : the ring filling is averaged over about 8 blocks, in 1/16 frame. Blocks shorter than
+   AUDIO_MIXER_DRIFT_MIN_FRAMES are not stretched, one frame would change their pitch too much */
+#define AUDIO_MIXER_FILL_FRACTION_BITS  4U
+#define AUDIO_MIXER_FILL_AVERAGE_SHIFT  3U
+#define AUDIO_MIXER_DRIFT_MIN_FRAMES    16U
+/* interpolation position in 1/65536 frame */
+#define AUDIO_MIXER_POSITION_BITS       16U
+
+/* Private macros ------------------------------------------------------------*/
+#define AUDIO_MIXER_SATURATE(value)     (((value) > INT32_MAX)? INT32_MAX : (((value) < INT32_MIN)? INT32_MIN : (int32_t)(value)))
+#define AUDIO_MIXER_IS_FORMAT(format)   (((format) == AUDIO_GRAPH_FORMAT_S16) || ((format) == AUDIO_GRAPH_FORMAT_S24) || \
+                                         ((format) == AUDIO_GRAPH_FORMAT_S32))
+/* saturating add of Q1.31 samples, a single QADD instruction on cores with the DSP extension */
+#if defined(__ARM_FEATURE_DSP) && (__ARM_FEATURE_DSP == 1)
+#define AUDIO_MIXER_ADD(a, b)           __QADD((a), (b))
+#else /* __ARM_FEATURE_DSP */
+#define AUDIO_MIXER_ADD(a, b)           AUDIO_MIXER_SATURATE((int64_t)(a) + (b))
+#endif /* __ARM_FEATURE_DSP */
+
+/* Private function prototypes -----------------------------------------------*/
+static int8_t  AUDIO_MixerConfigure(const AUDIO_GraphPort_t* in_port, AUDIO_GraphPort_t* out_port, uint32_t node_handle);
+static int8_t  AUDIO_MixerRun(const AUDIO_GraphSpan_t* in, AUDIO_GraphSpan_t* out, uint32_t node_handle);
+static void    AUDIO_MixerUpdateInput(AUDIO_MixerInput_t* input);
+static void    AUDIO_MixerReadFrame(const AUDIO_MixerInput_t* input, uint16_t* rd_ptr, int32_t* sample);
+static void    AUDIO_MixerAddFrames(AUDIO_MixerNode_t* mixer, AUDIO_MixerInput_t* input, uint8_t* data,
+                                    uint16_t frames, uint16_t in_frames, const int32_t* end_gain);
+
+/* Exported functions --------------------------------------------------------*/
+/**
+  * @brief  AUDIO_MixerInit
+  *         Initializes the mixer node without inputs. The node is then added to a graph.
+  * @param  mixer(IN): mixer node
+  * @retval 0 if no error
+  */
+int8_t  AUDIO_MixerInit(AUDIO_MixerNode_t* mixer)
+{
+  memset(mixer, 0, sizeof(AUDIO_MixerNode_t));
+  mixer->processing.flags = AUDIO_PROCESSING_IN_PLACE;
+  mixer->processing.ProcessingConfigure = AUDIO_MixerConfigure;
+  mixer->processing.ProcessingRun = AUDIO_MixerRun;
+  return 0;
+}
+
+/**
+  * @brief  AUDIO_MixerInputInit
+  *         Initializes a stopped input at 0 db, centered.
+  * @param  input(IN):     input
+  * @param  buffer(IN):    ring filled by the input producer
+  * @param  port(IN):      format of the ring samples, 1 or 2 channels
+  * @param  threshold(IN): ring filling in bytes to start mixing, absorbs the producer jitter
+  * @retval 0 if no error
+  */
+int8_t  AUDIO_MixerInputInit(AUDIO_MixerInput_t* input, AUDIO_CircularBuffer_t* buffer,
+                             const AUDIO_GraphPort_t* port, uint16_t threshold)
+{
+  if((port->channels_count == 0) || (port->channels_count > AUDIO_MIXER_MAX_CHANNELS) ||
+     !AUDIO_MIXER_IS_FORMAT(port->format) || (buffer->size % AUDIO_GRAPH_FRAME_SIZE(port) != 0) ||
+     (threshold > buffer->size))
+  {
+    return -1;
+  }
+  memset(input, 0, sizeof(AUDIO_MixerInput_t));
+  input->buffer = buffer;
+  input->port = *port;
+  input->threshold = threshold;
+  input->state = AUDIO_MIXER_INPUT_STOPPED;
+  AUDIO_MixerUpdateInput(input);
+  return 0;
+}
+
+/**
+  * @brief  AUDIO_MixerAddInput
+  *         Adds an input to the mixer, inputs must be added before the session starts.
+  * @param  mixer(IN): mixer node
+  * @param  input(IN): initialized input
+  * @retval 0 if no error
+  */
+int8_t  AUDIO_MixerAddInput(AUDIO_MixerNode_t* mixer, AUDIO_MixerInput_t* input)
+{
+  if(mixer->inputs_count == AUDIO_MIXER_MAX_INPUTS)
+  {
+    return -1;
+  }
+  mixer->inputs[mixer->inputs_count++] = input;
+  return 0;
+}
+
+/**
+  * @brief  AUDIO_MixerStartInput
+  *         Called by the producer when its stream starts, the input is mixed when the ring reaches the threshold.
+  * @param  input(IN): input
+  * @retval 0 if no error
+  */
+int8_t  AUDIO_MixerStartInput(AUDIO_MixerInput_t* input)
+{
+  input->requested = 1;
+  return 0;
+}
+
+/**
+  * @brief  AUDIO_MixerStopInput
+  *         Called by the producer when its stream stops, the input fades out on the next block. The producer
+  *         may reset the ring once the input state is AUDIO_MIXER_INPUT_STOPPED.
+  * @param  input(IN): input
+  * @retval 0 if no error
+  */
+int8_t  AUDIO_MixerStopInput(AUDIO_MixerInput_t* input)
+{
+  input->requested = 0;
+  return 0;
+}
+
+/**
+  * @brief  AUDIO_MixerSetInputVolume
+  *         Sets the volume of an input, the gain ramps to its new value over the next block.
+  * @param  input(IN):         input
+  * @param  volume_db_256(IN): volume in 1/256 db, up to AUDIO_MIXER_MAX_DB_256
+  * @retval 0 if no error
+  */
+int8_t  AUDIO_MixerSetInputVolume(AUDIO_MixerInput_t* input, int volume_db_256)
+{
+  if(volume_db_256 > AUDIO_MIXER_MAX_DB_256)
+  {
+    return -1;
+  }
+  input->volume_db_256 = volume_db_256;
+  AUDIO_MixerUpdateInput(input);
+  return 0;
+}
+
+/**
+  * @brief  AUDIO_MixerSetInputPan
+  *         Sets the pan of a mono input (constant power) or the balance of a stereo input.
+  * @param  input(IN): input
+  * @param  pan(IN):   -AUDIO_MIXER_PAN_MAX (left) to AUDIO_MIXER_PAN_MAX (right), 0 centered
+  * @retval 0 if no error
+  */
+int8_t  AUDIO_MixerSetInputPan(AUDIO_MixerInput_t* input, int pan)
+{
+  if((pan < -AUDIO_MIXER_PAN_MAX) || (pan > AUDIO_MIXER_PAN_MAX))
+  {
+    return -1;
+  }
+  input->pan = pan;
+  AUDIO_MixerUpdateInput(input);
+  return 0;
+}
+
+/* Private functions ---------------------------------------------------------*/
+/**
+  * @brief  AUDIO_MixerUpdateInput
+  *         Computes the left and right gains of an input from its volume and pan.
+  * @param  input(IN): input
+  * @retval None
+  */
+static void  AUDIO_MixerUpdateInput(AUDIO_MixerInput_t* input)
+{
+  double gain, left, right;
+
+  gain = (input->volume_db_256 < AUDIO_MIXER_MIN_DB_256)? 0.0 :
+         pow(10.0, input->volume_db_256 / (20.0 * 256.0)) * AUDIO_MIXER_GAIN_UNITY;
+  if(input->port.channels_count == 1)
+  {
+    /* constant power pan, -3 db on both sides when centered */
+    left  = cos((input->pan + AUDIO_MIXER_PAN_MAX) * AUDIO_MIXER_PI / (4.0 * AUDIO_MIXER_PAN_MAX));
+    right = sin((input->pan + AUDIO_MIXER_PAN_MAX) * AUDIO_MIXER_PI / (4.0 * AUDIO_MIXER_PAN_MAX));
+  }
+  else
+  {
+    /* balance, the side opposite to the pan is attenuated */
+    left  = (input->pan > 0)? (double)(AUDIO_MIXER_PAN_MAX - input->pan) / AUDIO_MIXER_PAN_MAX : 1.0;
+    right = (input->pan < 0)? (double)(AUDIO_MIXER_PAN_MAX + input->pan) / AUDIO_MIXER_PAN_MAX : 1.0;
+  }
+  input->target[0] = (int32_t)(gain * left);
+  input->target[1] = (int32_t)(gain * right);
+}
+
+/**
+  * @brief  AUDIO_MixerConfigure
+  *         Stores the graph format, inputs of another rate or format are not mixed.
+  * @param  in_port(IN):      format of the blocks
+  * @param  out_port(IN):     same as in_port
+  * @param  node_handle(IN):  mixer node
+  * @retval 0 if no error
+  */
+static int8_t  AUDIO_MixerConfigure(const AUDIO_GraphPort_t* in_port, AUDIO_GraphPort_t* out_port, uint32_t node_handle)
+{
+  AUDIO_MixerNode_t* mixer;
+
+  (void)out_port;
+  mixer = (AUDIO_MixerNode_t*)node_handle;
+  if((in_port->channels_count == 0) || (in_port->channels_count > AUDIO_MIXER_MAX_CHANNELS) ||
+     !AUDIO_MIXER_IS_FORMAT(in_port->format))
+  {
+    return -1;
+  }
+  mixer->channels_count = in_port->channels_count;
+  mixer->format = in_port->format;
+  mixer->frequency = in_port->frequency;
+  return 0;
+}
+
+/**
+  * @brief  AUDIO_MixerReadFrame
+  *         Reads a frame from an input ring as Q1.31 left and right samples, a mono frame is copied to both.
+  * @param  input(IN):     input
+  * @param  rd_ptr(IN/OUT): ring offset of the frame, moved to the next frame
+  * @param  sample(OUT):   left and right samples
+  * @retval None
+  */
+static void  AUDIO_MixerReadFrame(const AUDIO_MixerInput_t* input, uint16_t* rd_ptr, int32_t* sample)
+{
+  const AUDIO_CircularBuffer_t* buffer = input->buffer;
+  const uint8_t* ring = buffer->data;
+  uint16_t ptr = *rd_ptr;
+  uint8_t format = input->port.format;
+
+  for(int c = 0; c < input->port.channels_count; c++)
+  {
+    switch(format)
+    {
+    case AUDIO_GRAPH_FORMAT_S16:
+      sample[c] = (int32_t)((uint32_t)*(const int16_t*)(ring + ptr) << 16);
+      break;
+    case AUDIO_GRAPH_FORMAT_S24:
+      sample[c] = (int32_t)(((uint32_t)ring[ptr] << 8) | ((uint32_t)ring[ptr + 1] << 16) |
+                            ((uint32_t)ring[ptr + 2] << 24));
+      break;
+    default:
+      sample[c] = *(const int32_t*)(ring + ptr);
+      break;
+    }
+    ptr += format;
+    if(ptr >= buffer->size)
+    {
+      ptr = 0;
+    }
+  }
+  if(input->port.channels_count == 1)
+  {
+    sample[1] = sample[0];
+  }
+  *rd_ptr = ptr;
+}
+
+/**
+  * @brief  AUDIO_MixerAddFrames
+  *         Reads in_frames frames from an input ring and adds them to frames frames of the block, the gains move
+  *         linearly from their previous values to end_gain. When in_frames differs from frames the input is
+  *         linearly interpolated, its first and last frames fall on the first and last block frames.
+  * @param  mixer(IN):     mixer node
+  * @param  input(IN):     input, ring holds at least in_frames
+  * @param  data(IN):      block
+  * @param  frames(IN):    block frames count to mix
+  * @param  in_frames(IN): ring frames count to read, frames or one frame more or less
+  * @param  end_gain(IN):  left and right gains at the last frame
+  * @retval None
+  */
+static void  AUDIO_MixerAddFrames(AUDIO_MixerNode_t* mixer, AUDIO_MixerInput_t* input, uint8_t* data,
+                                  uint16_t frames, uint16_t in_frames, const int32_t* end_gain)
+{
+  uint16_t rd_ptr = input->buffer->rd_ptr;
+  uint8_t out_format = mixer->format, out_channels = mixer->channels_count;
+  int32_t gain[AUDIO_MIXER_MAX_CHANNELS], step[AUDIO_MIXER_MAX_CHANNELS];
+  int32_t current[AUDIO_MIXER_MAX_CHANNELS], next[AUDIO_MIXER_MAX_CHANNELS];
+  int32_t sample[AUDIO_MIXER_MAX_CHANNELS], mixed[AUDIO_MIXER_MAX_CHANNELS];
+  uint32_t position = 0, position_step, fraction;
+  uint16_t read;
+  int32_t value;
+
+  for(uint32_t c = 0; c < AUDIO_MIXER_MAX_CHANNELS; c++)
+  {
+    gain[c] = input->gain[c];
+    step[c] = (end_gain[c] - gain[c]) / (int32_t)frames;
+  }
+  position_step = (frames > 1)? ((uint32_t)(in_frames - 1) << AUDIO_MIXER_POSITION_BITS) / (frames - 1U) : 0;
+
+  /* current and next are the ring frames read - 2 and read - 1 */
+  AUDIO_MixerReadFrame(input, &rd_ptr, current);
+  if(in_frames > 1)
+  {
+    AUDIO_MixerReadFrame(input, &rd_ptr, next);
+  }
+  else
+  {
+    next[0] = current[0];
+    next[1] = current[1];
+  }
+  read = 2;
+
+  for(uint16_t f = 0; f < frames; f++)
+  {
+    if(f == frames - 1)
+    {
+      /* division remainders */
+      gain[0] = end_gain[0];
+      gain[1] = end_gain[1];
+      position = (uint32_t)(in_frames - 1) << AUDIO_MIXER_POSITION_BITS;
+    }
+    else
+    {
+      gain[0] += step[0];
+      gain[1] += step[1];
+    }
+
+    /* input frame at position, Q1.31 */
+    while((position >> AUDIO_MIXER_POSITION_BITS) + 2U > read)
+    {
+      current[0] = next[0];
+      current[1] = next[1];
+      if(read < in_frames)
+      {
+        AUDIO_MixerReadFrame(input, &rd_ptr, next);
+      }
+      read++;
+    }
+    fraction = position & ((1UL << AUDIO_MIXER_POSITION_BITS) - 1U);
+    position += position_step;
+    for(uint32_t c = 0; c < AUDIO_MIXER_MAX_CHANNELS; c++)
+    {
+      sample[c] = current[c];
+      if(fraction)
+      {
+        sample[c] += (int32_t)((((int64_t)next[c] - current[c]) * fraction) >> AUDIO_MIXER_POSITION_BITS);
+      }
+    }
+    mixed[0] = (int32_t)(((int64_t)sample[0] * gain[0]) >> AUDIO_MIXER_GAIN_FRACTION_BITS);
+    mixed[1] = (int32_t)(((int64_t)sample[1] * gain[1]) >> AUDIO_MIXER_GAIN_FRACTION_BITS);
+    if(out_channels == 1)
+    {
+      mixed[0] = (int32_t)(((int64_t)mixed[0] + mixed[1]) >> 1);
+    }
+
+    /* saturating add to the block frame, samples are MSB aligned so the add saturates at the format limits */
+    for(int c = 0; c < out_channels; c++)
+    {
+      switch(out_format)
+      {
+      case AUDIO_GRAPH_FORMAT_S16:
+        value = AUDIO_MIXER_ADD((int32_t)((uint32_t)*(int16_t*)data << 16), mixed[c]);
+        *(int16_t*)data = (int16_t)(value >> 16);
+        break;
+      case AUDIO_GRAPH_FORMAT_S24:
+        value = (int32_t)(((uint32_t)data[0] << 8) | ((uint32_t)data[1] << 16) | ((uint32_t)data[2] << 24));
+        value = AUDIO_MIXER_ADD(value, mixed[c]);
+        data[0] = (uint8_t)(value >> 8);
+        data[1] = (uint8_t)(value >> 16);
+        data[2] = (uint8_t)(value >> 24);
+        break;
+      default:
+        *(int32_t*)data = AUDIO_MIXER_ADD(*(int32_t*)data, mixed[c]);
+        break;
+      }
+      data += out_format;
+    }
+  }
+  input->gain[0] = gain[0];
+  input->gain[1] = gain[1];
+  input->buffer->rd_ptr = rd_ptr;
+}
+
+/**
+  * @brief  AUDIO_MixerRun
+  *         Adds the running inputs to the block, starts the inputs which reached their threshold and fades
+  *         out the stopped or underrun inputs. A running input whose averaged filling drifts away from its
+  *         threshold by more than half the threshold, and at least a block, is read one frame more or less.
+  * @param  in(IN):           block
+  * @param  out(IN):          same as in, in place node
+  * @param  node_handle(IN):  mixer node
+  * @retval 0 if no error
+  */
+static int8_t  AUDIO_MixerRun(const AUDIO_GraphSpan_t* in, AUDIO_GraphSpan_t* out, uint32_t node_handle)
+{
+  AUDIO_MixerNode_t* mixer;
+  AUDIO_MixerInput_t* input;
+  int32_t end_gain[AUDIO_MIXER_MAX_CHANNELS];
+  uint32_t skip;
+  int32_t margin, threshold;
+  uint16_t frames, in_frames, available, filled;
+  uint8_t stop;
+
+  (void)out;
+  mixer = (AUDIO_MixerNode_t*)node_handle;
+  for(int i = 0; i < mixer->inputs_count; i++)
+  {
+    input = mixer->inputs[i];
+    filled = AUDIO_BUFFER_FILLED_SIZE(input->buffer);
+    available = filled / AUDIO_GRAPH_FRAME_SIZE(&input->port);
+    frames = in->frames;
+    stop = !input->requested || (input->port.frequency != mixer->frequency) ||
+           (input->port.format != mixer->format);
+
+    if(input->state == AUDIO_MIXER_INPUT_STOPPED)
+    {
+      if(stop || (filled < input->threshold) || (available < frames))
+      {
+        continue;
+      }
+      /* starts with about the threshold and at least a block in the ring, the older frames would only add latency */
+      skip = available - frames;
+      if(skip > (uint32_t)(filled - input->threshold) / AUDIO_GRAPH_FRAME_SIZE(&input->port))
+      {
+        skip = (uint32_t)(filled - input->threshold) / AUDIO_GRAPH_FRAME_SIZE(&input->port);
+      }
+      if(skip)
+      {
+        available -= skip;
+        skip = skip * AUDIO_GRAPH_FRAME_SIZE(&input->port) + input->buffer->rd_ptr;
+        input->buffer->rd_ptr = (skip >= input->buffer->size)? skip - input->buffer->size : skip;
+      }
+      input->state = AUDIO_MIXER_INPUT_RUNNING;
+      input->gain[0] = input->gain[1] = 0;
+      input->average_fill = (int32_t)available << AUDIO_MIXER_FILL_FRACTION_BITS;
+    }
+
+    in_frames = frames;
+    if(available < frames)
+    {
+      /* underrun, fades out on the remaining frames then waits for the threshold */
+      frames = in_frames = available;
+      stop = 1;
+    }
+    else if(!stop && (frames >= AUDIO_MIXER_DRIFT_MIN_FRAMES))
+    {
+      /* the producer clock drifts from the playback one, keeps the filling around the threshold. The correction
+         is accounted at once in the average so a single step is taken per drifted frame */
+      input->average_fill += (((int32_t)available << AUDIO_MIXER_FILL_FRACTION_BITS) - input->average_fill) >>
+                             AUDIO_MIXER_FILL_AVERAGE_SHIFT;
+      threshold = (int32_t)(input->threshold / AUDIO_GRAPH_FRAME_SIZE(&input->port));
+      margin = (threshold / 2 > frames)? threshold / 2 : frames;
+      if((input->average_fill > ((threshold + margin) << AUDIO_MIXER_FILL_FRACTION_BITS)) && (available > frames))
+      {
+        in_frames = frames + 1;
+        input->average_fill -= 1L << AUDIO_MIXER_FILL_FRACTION_BITS;
+      }
+      else if(input->average_fill < ((threshold - margin) << AUDIO_MIXER_FILL_FRACTION_BITS))
+      {
+        in_frames = frames - 1;
+        input->average_fill += 1L << AUDIO_MIXER_FILL_FRACTION_BITS;
+      }
+    }
+    if(stop)
+    {
+      end_gain[0] = end_gain[1] = 0;
+    }
+    else
+    {
+      end_gain[0] = input->target[0];
+      end_gain[1] = input->target[1];
+    }
+    if(frames)
+    {
+      AUDIO_MixerAddFrames(mixer, input, in->data, frames, in_frames, end_gain);
+    }
+    if(stop)
+    {
+      input->gain[0] = input->gain[1] = 0;
+      input->state = AUDIO_MIXER_INPUT_STOPPED;
+    }
+  }
+  return 0;
+}
+#endif /* USE_AUDIO_PLAYBACK_MIXER */
+/************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
@@ -0,0 +1,203 @@
+/**
+  ******************************************************************************
+  * @file    audio_profiler.c
+  * @author  MCD Application Team
+  * @brief   cycle profiler of the streaming hot paths.
+  *          Each probe measures with the DWT cycle counter (the monotonic clock of
+  *          host builds, in nanoseconds) the time spent between
+  *          AUDIO_PROFILER_ENTER and AUDIO_PROFILER_EXIT. When a probe preempts
+  *          another one, its duration is removed from the preempted probe time.
+  *          Statistics are read with the debugger or AUDIO_ProfilerGetStats.
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2019  STMicroelectronics.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by ST under Ultimate Liberty license
+  * SLA0044, the "License"; You may not use this file except in compliance with
+  * the License. You may obtain a copy of the License at:
+  *                             www.st.com/SLA0044
+  *
+  ******************************************************************************
+  */
+/* Includes ------------------------------------------------------------------*/
+#include "usbd_audio.h"
+#include "usb_audio.h"
+#include "audio_profiler.h"
+#include "audio_cycle_counter.h"
+
+#if USE_AUDIO_PROFILER
+/* Private typedef -----------------------------------------------------------*/
+/* running probe */
+typedef struct
+{
+  uint32_t start_time;    /* cycle counter value at probe entry */
+  uint32_t nested_cycles; /* time spent in probes which preempted this one */
+} AUDIO_ProfilerFrame_t;
+
+/* Private variables ---------------------------------------------------------*/
+static AUDIO_ProfilerStats_t AUDIO_ProfilerStats[AUDIO_PROFILER_PROBE_COUNT];
+static AUDIO_ProfilerFrame_t AUDIO_ProfilerStack[AUDIO_PROFILER_MAX_DEPTH];
+static volatile uint8_t AUDIO_ProfilerDepth = 0;
+static uint32_t AUDIO_ProfilerOverflowCount = 0; /* probes not measured because max depth is reached */
+
+/* Exported functions --------------------------------------------------------*/
+/**
+  * @brief  AUDIO_ProfilerInit
+  *         Starts the DWT cycle counter and resets statistics.
+  * @param  None
+  * @retval 0 if no error
+  */
+int8_t  AUDIO_ProfilerInit(void)
+{
+  if(AUDIO_CycleCounterInit() != 0)
+  {
+    return -1;
+  }
+  AUDIO_ProfilerDepth = 0;
+  AUDIO_ProfilerReset();
+  return 0;
+}
+
+/**
+  * @brief  AUDIO_ProfilerReset
+  *         Clears statistics of all probes.
+  * @param  None
+  * @retval None
+  */
+void  AUDIO_ProfilerReset(void)
+{
+  uint32_t primask;
+
+  primask = __get_PRIMASK();
+  __disable_irq();
+  memset(AUDIO_ProfilerStats, 0, sizeof(AUDIO_ProfilerStats));
+  for(int i = 0; i < AUDIO_PROFILER_PROBE_COUNT; i++)
+  {
+    AUDIO_ProfilerStats[i].min_cycles = 0xFFFFFFFFU;
+  }
+  AUDIO_ProfilerOverflowCount = 0;
+  __set_PRIMASK(primask);
+}
+
+/**
+  * @brief  AUDIO_ProfilerEnter
+  *         Starts a measure. Must be followed by AUDIO_ProfilerExit in the same context.
+  * @param  None
+  * @retval None
+  */
+void  AUDIO_ProfilerEnter(void)
+{
+  uint32_t primask;
+  AUDIO_ProfilerFrame_t* frame;
+
+  primask = __get_PRIMASK();
+  __disable_irq();
+  if(AUDIO_ProfilerDepth < AUDIO_PROFILER_MAX_DEPTH)
+  {
+    frame = &AUDIO_ProfilerStack[AUDIO_ProfilerDepth];
+    frame->nested_cycles = 0;
+    frame->start_time = AUDIO_CycleCounterGet();
+  }
+  else
+  {
+    AUDIO_ProfilerOverflowCount++;
+  }
+  AUDIO_ProfilerDepth++;
+  __set_PRIMASK(primask);
+}
+
+/**
+  * @brief  AUDIO_ProfilerExit
+  *         Ends the measure started by the last AUDIO_ProfilerEnter and updates the probe statistics.
+  * @param  probe(IN): measured section
+  * @retval None
+  */
+void  AUDIO_ProfilerExit(AUDIO_ProfilerProbe_t probe)
+{
+  uint32_t primask, elapsed, cycles, bin;
+  AUDIO_ProfilerFrame_t* frame;
+  AUDIO_ProfilerStats_t* stats;
+
+  primask = __get_PRIMASK();
+  __disable_irq();
+  if(AUDIO_ProfilerDepth == 0)
+  {
+    /* unbalanced exit, ignored */
+    __set_PRIMASK(primask);
+    return;
+  }
+  AUDIO_ProfilerDepth--;
+  if(AUDIO_ProfilerDepth < AUDIO_PROFILER_MAX_DEPTH)
+  {
+    frame = &AUDIO_ProfilerStack[AUDIO_ProfilerDepth];
+    elapsed = AUDIO_CycleCounterGet() - frame->start_time;
+    cycles = elapsed - frame->nested_cycles;
+    if(AUDIO_ProfilerDepth > 0)
+    {
+      /* the preempted probe must not count this time */
+      AUDIO_ProfilerStack[AUDIO_ProfilerDepth - 1].nested_cycles += elapsed;
+    }
+
+    stats = &AUDIO_ProfilerStats[probe];
+    stats->count++;
+    stats->total_cycles += cycles;
+    if(cycles < stats->min_cycles)
+    {
+      stats->min_cycles = cycles;
+    }
+    if(cycles > stats->max_cycles)
+    {
+      stats->max_cycles = cycles;
+    }
+    bin = 31U - __CLZ(cycles | 1U);
+    bin = (bin > AUDIO_PROFILER_HISTOGRAM_FIRST_BIT)? bin - AUDIO_PROFILER_HISTOGRAM_FIRST_BIT : 0;
+    if(bin >= AUDIO_PROFILER_HISTOGRAM_BINS)
+    {
+      bin = AUDIO_PROFILER_HISTOGRAM_BINS - 1;
+    }
+    stats->histogram[bin]++;
+    if(AUDIO_ProfilerDepth > 0)
+    {
+      stats->nested_count++;
+    }
+    if(AUDIO_ProfilerDepth + 1 > stats->max_depth)
+    {
+      stats->max_depth = AUDIO_ProfilerDepth + 1;
+    }
+  }
+  __set_PRIMASK(primask);
+}
+
+/**
+  * @brief  AUDIO_ProfilerGetStats
+  *         Returns statistics of a probe.
+  * @param  probe(IN): measured section
+  * @retval statistics, may change while read if the probe runs
+  */
+const AUDIO_ProfilerStats_t*  AUDIO_ProfilerGetStats(AUDIO_ProfilerProbe_t probe)
+{
+  return &AUDIO_ProfilerStats[probe];
+}
+
+/**
+  * @brief  AUDIO_ProfilerGetMeanCycles
+  *         Computes the mean duration of a probe.
+  * @param  probe(IN): measured section
+  * @retval mean count of cycles, 0 if the probe never ran
+  */
+uint32_t  AUDIO_ProfilerGetMeanCycles(AUDIO_ProfilerProbe_t probe)
+{
+  uint32_t primask, count;
+  uint64_t total;
+
+  primask = __get_PRIMASK();
+  __disable_irq();
+  count = AUDIO_ProfilerStats[probe].count;
+  total = AUDIO_ProfilerStats[probe].total_cycles;
+  __set_PRIMASK(primask);
+  return (count == 0)? 0 : (uint32_t)(total / count);
+}
+#endif /* USE_AUDIO_PROFILER */
+/************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
@@ -0,0 +1,182 @@
+/**
+  ******************************************************************************
+  * @file    audio_scheduler.c
+  * @author  MCD Application Team
+  * @brief   deferred processing scheduler.
+  *          Audio DMA and USB interrupt handlers only post tasks, the work (format
+  *          conversion, synchronization computation ...) runs in the PendSV handler
+  *          which has the lowest priority, so it doesn't delay the USB interrupt.
+  *          Each task has a deadline, checked with the DWT cycle counter.
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2019  STMicroelectronics.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by ST under Ultimate Liberty license
+  * SLA0044, the "License"; You may not use this file except in compliance with
+  * the License. You may obtain a copy of the License at:
+  *                             www.st.com/SLA0044
+  *
+  ******************************************************************************
+  */
+/* Includes ------------------------------------------------------------------*/
+#include "usbd_audio.h"
+#include "usb_audio.h"
+#include "audio_scheduler.h"
+#include "audio_cycle_counter.h"
+#include "audio_profiler.h"
+
+#if USE_AUDIO_SCHEDULER
+/* Private defines -----------------------------------------------------------*/
+#define AUDIO_SCHEDULER_PENDSV_PRIORITY   ((1UL << __NVIC_PRIO_BITS) - 1UL) /* lowest priority */
+/* Private macros ------------------------------------------------------------*/
+#define AUDIO_SCHEDULER_US_TO_CYCLES(us)  ((us)*(AUDIO_CYCLE_COUNTER_FREQ/1000000U))
+/* Private variables ---------------------------------------------------------*/
+static AUDIO_SchedulerTask_t* AUDIO_SchedulerTasks[AUDIO_SCHEDULER_MAX_TASKS];
+static uint8_t AUDIO_SchedulerTaskCount = 0;
+static volatile uint32_t AUDIO_SchedulerPendingMap = 0; /* bit i set when task i is posted */
+
+/* Exported functions --------------------------------------------------------*/
+/**
+  * @brief  AUDIO_SchedulerInit
+  *         Initializes the scheduler: starts the DWT cycle counter and sets PendSV
+  *         to the lowest priority.
+  * @param  None
+  * @retval 0 if no error
+  */
+int8_t  AUDIO_SchedulerInit(void)
+{
+  AUDIO_SchedulerTaskCount = 0;
+  AUDIO_SchedulerPendingMap = 0;
+
+  if(AUDIO_CycleCounterInit() != 0)
+  {
+    return -1;
+  }
+  NVIC_SetPriority(PendSV_IRQn, AUDIO_SCHEDULER_PENDSV_PRIORITY);
+  return 0;
+}
+
+/**
+  * @brief  AUDIO_SchedulerRegisterTask
+  *         Adds a task to the scheduler, a task already registered is only updated.
+  *         Must not be called while the task may be posted.
+  * @param  task(IN):         task to register, must stay allocated
+  * @param  run(IN):          work function
+  * @param  private_data(IN): argument of run
+  * @param  deadline_us(IN):  max allowed time in us between post and end of execution
+  * @retval 0 if no error
+  */
+int8_t  AUDIO_SchedulerRegisterTask(AUDIO_SchedulerTask_t* task, AUDIO_SchedulerTaskRun_t run,
+                                    uint32_t private_data, uint32_t deadline_us)
+{
+  uint8_t i;
+
+  for(i = 0; i < AUDIO_SchedulerTaskCount; i++)
+  {
+    if(AUDIO_SchedulerTasks[i] == task)
+    {
+      break;
+    }
+  }
+  if(i == AUDIO_SCHEDULER_MAX_TASKS)
+  {
+    return -1;
+  }
+  if(i == AUDIO_SchedulerTaskCount)
+  {
+    AUDIO_SchedulerTasks[i] = task;
+    AUDIO_SchedulerTaskCount++;
+  }
+  task->id = i;
+  task->Run = run;
+  task->private_data = private_data;
+  task->deadline_cycles = AUDIO_SCHEDULER_US_TO_CYCLES(deadline_us);
+  task->run_count = 0;
+  task->deadline_miss_count = 0;
+  task->lost_count = 0;
+  task->max_latency_cycles = 0;
+  return 0;
+}
+
+/**
+  * @brief  AUDIO_SchedulerSetDeadline
+  *         Changes the deadline of a registered task, e.g. when the block period of its node changes.
+  *         Its statistics are kept.
+  * @param  task(IN):         registered task
+  * @param  deadline_us(IN):  max allowed time in us between post and end of execution
+  * @retval None
+  */
+void  AUDIO_SchedulerSetDeadline(AUDIO_SchedulerTask_t* task, uint32_t deadline_us)
+{
+  task->deadline_cycles = AUDIO_SCHEDULER_US_TO_CYCLES(deadline_us);
+}
+
+/**
+  * @brief  AUDIO_SchedulerPost
+  *         Marks the task as pending and triggers PendSV. Called from interrupt handlers.
+  *         A task posted again before its execution runs once, the extra post is counted as lost.
+  * @param  task(IN): registered task
+  * @retval None
+  */
+void  AUDIO_SchedulerPost(AUDIO_SchedulerTask_t* task)
+{
+  uint32_t primask;
+
+  primask = __get_PRIMASK();
+  __disable_irq();
+  if(AUDIO_SchedulerPendingMap & (1U << task->id))
+  {
+    task->lost_count++;
+  }
+  else
+  {
+    task->post_time = AUDIO_CycleCounterGet();
+    AUDIO_SchedulerPendingMap |= (1U << task->id);
+  }
+  __set_PRIMASK(primask);
+  SCB->ICSR = SCB_ICSR_PENDSVSET_Msk;
+}
+
+/**
+  * @brief  AUDIO_SchedulerRun
+  *         Runs pending tasks by priority order, until none is pending. Called from PendSV handler.
+  * @param  None
+  * @retval None
+  */
+void  AUDIO_SchedulerRun(void)
+{
+  AUDIO_SchedulerTask_t* task;
+  uint32_t primask, post_time, latency;
+  uint8_t id;
+
+  while(AUDIO_SchedulerPendingMap)
+  {
+    /* lowest set bit is the highest priority pending task */
+    id = (uint8_t)__CLZ(__RBIT(AUDIO_SchedulerPendingMap));
+    task = AUDIO_SchedulerTasks[id];
+    primask = __get_PRIMASK();
+    __disable_irq();
+    AUDIO_SchedulerPendingMap &= ~(1U << id);
+    post_time = task->post_time;
+    __set_PRIMASK(primask);
+
+    AUDIO_PROFILER_ENTER(AUDIO_PROFILER_DEFERRED_TASK);
+    task->Run(task->private_data);
+    AUDIO_PROFILER_EXIT(AUDIO_PROFILER_DEFERRED_TASK);
+
+    latency = AUDIO_CycleCounterGet() - post_time;
+    task->run_count++;
+    if(latency > task->max_latency_cycles)
+    {
+      task->max_latency_cycles = latency;
+    }
+    if(latency > task->deadline_cycles)
+    {
+      task->deadline_miss_count++;
+    }
+  }
+}
+#endif /* USE_AUDIO_SCHEDULER */
+/************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
@@ -0,0 +1,334 @@
+/**
+  ******************************************************************************
+  * @file    audio_sidetone.c
+  * @author  MCD Application Team
+  * @brief   microphone monitoring inside the device.
+  *          A tap node of the recording graph copies each captured block to a
+  *          small ring, an input of the playback mixer reads the ring, so the
+  *          microphone reaches the speaker within a couple of blocks instead of
+  *          going through the host. The monitor level and mute are the controls
+  *          of a dedicated feature unit, the speaker output terminal is fed by a
+  *          mixer unit of the played stream and of this feature unit.
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2019  STMicroelectronics.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by ST under Ultimate Liberty license
+  * SLA0044, the "License"; You may not use this file except in compliance with
+  * the License. You may obtain a copy of the License at:
+  *                             www.st.com/SLA0044
+  *
+  ******************************************************************************
+  */
+/* Includes ------------------------------------------------------------------*/
+#include <string.h>
+#include "usb_audio.h"
+#include "audio_usb_nodes.h"
+#include "audio_sidetone.h"
+
+#if USE_AUDIO_SIDETONE
+#if !USE_USB_AUDIO_PLAYBACK || !USE_USB_AUDIO_RECORDING || !USE_AUDIO_PLAYBACK_MIXER
+#error "USE_AUDIO_SIDETONE requires USE_USB_AUDIO_PLAYBACK, USE_USB_AUDIO_RECORDING and USE_AUDIO_PLAYBACK_MIXER"
+#endif /* !USE_USB_AUDIO_PLAYBACK || !USE_USB_AUDIO_RECORDING || !USE_AUDIO_PLAYBACK_MIXER */
+
+/* Private defines -----------------------------------------------------------*/
+/* ring samples are in the speaker graph format */
+#define SIDETONE_FORMAT        ((USB_AUDIO_CONFIG_PLAY_RES_BIT == 24)? AUDIO_GRAPH_FORMAT_S32 : AUDIO_GRAPH_FORMAT_S16)
+#define SIDETONE_SAMPLE_SIZE   ((USB_AUDIO_CONFIG_PLAY_RES_BIT == 24)? 4 : 2)
+/* the first two channels of a microphone array are monitored */
+#define SIDETONE_CHANNEL_COUNT ((USB_AUDIO_CONFIG_RECORD_CHANNEL_COUNT > 2)? 2 : USB_AUDIO_CONFIG_RECORD_CHANNEL_COUNT)
+#define SIDETONE_MIC_BLOCK_MAX_SIZE   AUDIO_BLOCK_MAX_SIZE(USB_AUDIO_CONFIG_PLAY_FREQ_MAX, SIDETONE_CHANNEL_COUNT,\
+                                                           SIDETONE_SAMPLE_SIZE, USB_AUDIO_CONFIG_RECORD_BLOCK_US_MAX)
+#define SIDETONE_PLAY_BLOCK_MAX_SIZE  AUDIO_BLOCK_MAX_SIZE(USB_AUDIO_CONFIG_PLAY_FREQ_MAX, SIDETONE_CHANNEL_COUNT,\
+                                                           SIDETONE_SAMPLE_SIZE, USB_AUDIO_CONFIG_PLAY_BLOCK_US_MAX)
+/* mixing starts with a captured block and a played block in the ring, the ring holds twice this latency */
+#define SIDETONE_THRESHOLD     (SIDETONE_MIC_BLOCK_MAX_SIZE + SIDETONE_PLAY_BLOCK_MAX_SIZE)
+#define SIDETONE_RING_SIZE     (2 * SIDETONE_THRESHOLD)
+/* fades on ring overflow are Q16 linear ramps */
+#define SIDETONE_FADE_UNITY    (1L << 16)
+
+/* Private function prototypes -----------------------------------------------*/
+static int8_t  AUDIO_SidetoneTapConfigure(const AUDIO_GraphPort_t* in_port, AUDIO_GraphPort_t* out_port, uint32_t node_handle);
+static int8_t  AUDIO_SidetoneTapRun(const AUDIO_GraphSpan_t* in, AUDIO_GraphSpan_t* out, uint32_t node_handle);
+static void    AUDIO_SidetoneFadeOut(AUDIO_SidetoneTapNode_t* tap, uint16_t frames);
+static int8_t  AUDIO_SidetoneSetMute(uint16_t channel_number, uint8_t mute, uint32_t private_data);
+static int8_t  AUDIO_SidetoneSetVolume(uint16_t channel_number, int volume_db_256, uint32_t private_data);
+
+/* Private variables ---------------------------------------------------------*/
+static uint32_t SidetoneRingData[SIDETONE_RING_SIZE / 4 + 1];
+static AUDIO_CircularBuffer_t SidetoneRing;
+static AUDIO_MixerInput_t SidetoneInput;
+static AUDIO_SidetoneTapNode_t SidetoneTapNode;
+static AUDIO_Description_t SidetoneAudioDescription;
+static AUDIO_USB_CF_NodeTypeDef SidetoneFeatureUnitNode;
+
+/* Exported functions --------------------------------------------------------*/
+/**
+  * @brief  AUDIO_SidetoneInit
+  *         Initializes the sidetone ring, mixer input, tap node and feature unit. Called by the playback session
+  *         initialization, which adds the mixer input to its graph, before the recording session initialization,
+  *         which adds the tap node to its graph.
+  * @param  control(OUT): USB Audio Class control of the sidetone feature unit
+  * @retval 0 if no error
+  */
+int8_t  AUDIO_SidetoneInit(USBD_AUDIO_ControlTypeDef* control)
+{
+  AUDIO_GraphPort_t port;
+  AUDIO_USBFeatureUnitDefaults_t controller_defaults;
+  AUDIO_USBFeatureUnitCommands_t commands;
+
+  SidetoneRing.data = (uint8_t*)SidetoneRingData;
+  SidetoneRing.size = SIDETONE_RING_SIZE;
+  SidetoneRing.rd_ptr = 0;
+  SidetoneRing.wr_ptr = 0;
+  port.frequency = USB_AUDIO_CONFIG_PLAY_DEF_FREQ;
+  port.channels_count = SIDETONE_CHANNEL_COUNT;
+  port.format = SIDETONE_FORMAT;
+  if(AUDIO_MixerInputInit(&SidetoneInput, &SidetoneRing, &port, SIDETONE_THRESHOLD) != 0)
+  {
+    return -1;
+  }
+  AUDIO_MixerStartInput(&SidetoneInput);
+
+  memset(&SidetoneTapNode, 0, sizeof(AUDIO_SidetoneTapNode_t));
+  SidetoneTapNode.input = &SidetoneInput;
+  SidetoneTapNode.processing.flags = AUDIO_PROCESSING_IN_PLACE;
+  SidetoneTapNode.processing.ProcessingConfigure = AUDIO_SidetoneTapConfigure;
+  SidetoneTapNode.processing.ProcessingRun = AUDIO_SidetoneTapRun;
+
+  /* monitor level, the feature unit applies its controls at once to the mixer input */
+  memset(&SidetoneAudioDescription, 0, sizeof(AUDIO_Description_t));
+  SidetoneAudioDescription.audio_volume_db_256 = USB_AUDIO_CONFIG_SIDETONE_DEF_DB_256;
+  SidetoneAudioDescription.audio_mute = USB_AUDIO_CONFIG_SIDETONE_DEF_MUTE;
+  controller_defaults.audio_description = &SidetoneAudioDescription;
+  controller_defaults.max_volume = VOLUME_SIDETONE_MAX_DB_256;
+  controller_defaults.min_volume = VOLUME_SIDETONE_MIN_DB_256;
+  controller_defaults.res_volume = VOLUME_SIDETONE_RES_DB_256;
+  USB_AudioStreamingFeatureUnitInit(control, &controller_defaults, USB_AUDIO_CONFIG_SIDETONE_UNIT_FEATURE_ID,
+                                    (uint32_t)&SidetoneFeatureUnitNode);
+  commands.SetMute = AUDIO_SidetoneSetMute;
+  commands.SetCurrentVolume = AUDIO_SidetoneSetVolume;
+  commands.private_data = (uint32_t)&SidetoneInput;
+  SidetoneFeatureUnitNode.CFStart(&commands, (uint32_t)&SidetoneFeatureUnitNode);
+  /* the feature unit start replays the volume only */
+  AUDIO_SidetoneSetMute(0, SidetoneAudioDescription.audio_mute, (uint32_t)&SidetoneInput);
+  return 0;
+}
+
+/**
+  * @brief  AUDIO_SidetoneGetMixerInput
+  *         Returns the input to add to the playback mixer.
+  * @param  None
+  * @retval sidetone mixer input
+  */
+AUDIO_MixerInput_t*  AUDIO_SidetoneGetMixerInput(void)
+{
+  return &SidetoneInput;
+}
+
+/**
+  * @brief  AUDIO_SidetoneGetTapNode
+  *         Returns the tap node to add to the recording graph.
+  * @param  None
+  * @retval sidetone tap node
+  */
+AUDIO_ProcessingNode_t*  AUDIO_SidetoneGetTapNode(void)
+{
+  return &SidetoneTapNode.processing;
+}
+
+/* Private functions ---------------------------------------------------------*/
+/**
+  * @brief  AUDIO_SidetoneSetMute
+  *         Mutes or unmutes the monitored microphone.
+  * @param  channel_number(IN): only master channel 0 is controlled
+  * @param  mute(IN):           1 to mute
+  * @param  private_data(IN):   sidetone mixer input
+  * @retval 0 if no error
+  */
+static int8_t  AUDIO_SidetoneSetMute(uint16_t channel_number, uint8_t mute, uint32_t private_data)
+{
+  if(channel_number != 0)
+  {
+    return 0;
+  }
+  return AUDIO_MixerSetInputVolume((AUDIO_MixerInput_t*)private_data,
+                                   (mute)? AUDIO_MIXER_MIN_DB_256 - 1 : SidetoneAudioDescription.audio_volume_db_256);
+}
+
+/**
+  * @brief  AUDIO_SidetoneSetVolume
+  *         Sets the monitor level.
+  * @param  channel_number(IN): only master channel 0 is controlled
+  * @param  volume_db_256(IN):  level in 1/256 db
+  * @param  private_data(IN):   sidetone mixer input
+  * @retval 0 if no error
+  */
+static int8_t  AUDIO_SidetoneSetVolume(uint16_t channel_number, int volume_db_256, uint32_t private_data)
+{
+  if((channel_number != 0) || SidetoneAudioDescription.audio_mute)
+  {
+    return 0;
+  }
+  return AUDIO_MixerSetInputVolume((AUDIO_MixerInput_t*)private_data, volume_db_256);
+}
+
+/**
+  * @brief  AUDIO_SidetoneTapConfigure
+  *         Checks that the captured blocks can feed the mixer input. A mismatch disables the tap, it doesn't
+  *         stop the recording graph.
+  * @param  in_port(IN):      format of the captured blocks
+  * @param  out_port(IN):     same as in_port
+  * @param  node_handle(IN):  tap node
+  * @retval 0
+  */
+static int8_t  AUDIO_SidetoneTapConfigure(const AUDIO_GraphPort_t* in_port, AUDIO_GraphPort_t* out_port, uint32_t node_handle)
+{
+  AUDIO_SidetoneTapNode_t* tap;
+
+  tap = (AUDIO_SidetoneTapNode_t*)node_handle;
+  tap->format = in_port->format;
+  tap->enabled = (in_port->channels_count >= tap->input->port.channels_count) &&
+                 ((in_port->format == AUDIO_GRAPH_FORMAT_S16) || (in_port->format == AUDIO_GRAPH_FORMAT_S24) ||
+                  (in_port->format == AUDIO_GRAPH_FORMAT_S32));
+  tap->skipped_size = (in_port->channels_count - tap->input->port.channels_count) * in_port->format;
+  /* the mixer doesn't mix the input while the microphone and speaker rates differ */
+  tap->input->port.frequency = in_port->frequency;
+  return 0;
+}
+
+/**
+  * @brief  AUDIO_SidetoneFadeOut
+  *         Fades out in place the last frames written to the ring. Called when the ring is full, the mixer reads
+  *         these frames last so they can't be under reading.
+  * @param  tap(IN):     tap node
+  * @param  frames(IN):  frames count of the fade, bounded by the ring filling
+  * @retval None
+  */
+static void  AUDIO_SidetoneFadeOut(AUDIO_SidetoneTapNode_t* tap, uint16_t frames)
+{
+  AUDIO_CircularBuffer_t* ring = tap->input->buffer;
+  uint16_t frame_size = AUDIO_GRAPH_FRAME_SIZE(&tap->input->port);
+  uint16_t ptr;
+  int32_t gain, step;
+
+  if(frames > AUDIO_BUFFER_FILLED_SIZE(ring) / frame_size)
+  {
+    frames = AUDIO_BUFFER_FILLED_SIZE(ring) / frame_size;
+  }
+  if(frames == 0)
+  {
+    return;
+  }
+  ptr = (ring->wr_ptr >= frames * frame_size)? ring->wr_ptr - frames * frame_size :
+                                                ring->wr_ptr + ring->size - frames * frame_size;
+  step = SIDETONE_FADE_UNITY / frames;
+  gain = SIDETONE_FADE_UNITY;
+  for(uint16_t i = 0; i < frames; i++)
+  {
+    gain = (i == frames - 1)? 0 : gain - step;
+    for(uint8_t c = 0; c < tap->input->port.channels_count; c++)
+    {
+      if(tap->input->port.format == AUDIO_GRAPH_FORMAT_S16)
+      {
+        *(int16_t*)(ring->data + ptr) = (int16_t)((*(int16_t*)(ring->data + ptr) * gain) >> 16);
+      }
+      else
+      {
+        *(int32_t*)(ring->data + ptr) = (int32_t)(((int64_t)*(int32_t*)(ring->data + ptr) * gain) >> 16);
+      }
+      ptr += tap->input->port.format;
+      if(ptr >= ring->size)
+      {
+        ptr = 0;
+      }
+    }
+  }
+}
+
+/**
+  * @brief  AUDIO_SidetoneTapRun
+  *         Copies the monitored channels of a captured block to the ring in the speaker format. When the ring
+  *         is full (the speaker is late or isn't running) the last written block is faded out and the captured
+  *         blocks are dropped, the first block written once the ring has room again is faded in.
+  * @param  in(IN):           captured block, left unchanged
+  * @param  out(IN):          same as in, in place node
+  * @param  node_handle(IN):  tap node
+  * @retval 0 if no error
+  */
+static int8_t  AUDIO_SidetoneTapRun(const AUDIO_GraphSpan_t* in, AUDIO_GraphSpan_t* out, uint32_t node_handle)
+{
+  AUDIO_SidetoneTapNode_t* tap;
+  AUDIO_CircularBuffer_t* ring;
+  uint8_t* sample;
+  uint16_t wr_ptr;
+  int32_t value, gain, step;
+
+  tap = (AUDIO_SidetoneTapNode_t*)node_handle;
+  ring = tap->input->buffer;
+  if(!tap->enabled || (in->frames == 0))
+  {
+    return 0;
+  }
+  if(AUDIO_BUFFER_FREE_SIZE(ring) <= in->frames * AUDIO_GRAPH_FRAME_SIZE(&tap->input->port))
+  {
+    if(!tap->faded)
+    {
+      AUDIO_SidetoneFadeOut(tap, in->frames);
+      tap->faded = 1;
+    }
+    return 0;
+  }
+  gain = (tap->faded)? 0 : SIDETONE_FADE_UNITY;
+  step = (tap->faded)? SIDETONE_FADE_UNITY / in->frames : 0;
+  sample = in->data;
+  wr_ptr = ring->wr_ptr;
+  for(uint16_t i = 0; i < in->frames; i++)
+  {
+    if(tap->faded)
+    {
+      gain = (i == in->frames - 1)? SIDETONE_FADE_UNITY : gain + step;
+    }
+    for(uint8_t c = 0; c < tap->input->port.channels_count; c++)
+    {
+      switch(tap->format)
+      {
+      case AUDIO_GRAPH_FORMAT_S16:
+        value = (int32_t)((uint32_t)*(int16_t*)sample << 16);
+        break;
+      case AUDIO_GRAPH_FORMAT_S24:
+        value = (int32_t)(((uint32_t)sample[0] << 8) | ((uint32_t)sample[1] << 16) | ((uint32_t)sample[2] << 24));
+        break;
+      default:
+        value = *(int32_t*)sample;
+        break;
+      }
+      if(gain != SIDETONE_FADE_UNITY)
+      {
+        value = (int32_t)(((int64_t)value * gain) >> 16);
+      }
+      sample += tap->format;
+      if(tap->input->port.format == AUDIO_GRAPH_FORMAT_S16)
+      {
+        *(int16_t*)(ring->data + wr_ptr) = (int16_t)(value >> 16);
+      }
+      else
+      {
+        *(int32_t*)(ring->data + wr_ptr) = value;
+      }
+      wr_ptr += tap->input->port.format;
+      if(wr_ptr >= ring->size)
+      {
+        wr_ptr = 0;
+      }
+    }
+    sample += tap->skipped_size;
+  }
+  ring->wr_ptr = wr_ptr;
+  tap->faded = 0;
+  return 0;
+}
+#endif /* USE_AUDIO_SIDETONE */
+/************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
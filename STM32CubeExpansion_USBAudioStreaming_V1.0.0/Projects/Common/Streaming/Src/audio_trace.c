@@ -0,0 +1,103 @@
+/**
+  ******************************************************************************
+  * @file    audio_trace.c
+  * @author  MCD Application Team
+  * @brief   binary trace of the streaming nodes and sessions.
+  *          Nodes and sessions emit fixed size records to a single ring at
+  *          constant cost, from any interrupt priority, without lock: the record
+  *          slot is reserved with an exclusive access on the ring head.
+  *          The ring is self described, it can be decoded from a RAM dump by
+  *          Utilities/AudioTrace/audio_trace_decode.c.
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2019  STMicroelectronics.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by ST under Ultimate Liberty license
+  * SLA0044, the "License"; You may not use this file except in compliance with
+  * the License. You may obtain a copy of the License at:
+  *                             www.st.com/SLA0044
+  *
+  ******************************************************************************
+  */
+/* Includes ------------------------------------------------------------------*/
+#include "usbd_audio.h"
+#include "usb_audio.h"
+#include "audio_trace.h"
+#include "audio_cycle_counter.h"
+
+#if USE_AUDIO_TRACE
+#if (AUDIO_TRACE_RING_SIZE & (AUDIO_TRACE_RING_SIZE - 1U)) != 0U
+#error "AUDIO_TRACE_RING_SIZE must be a power of 2"
+#endif /* (AUDIO_TRACE_RING_SIZE & (AUDIO_TRACE_RING_SIZE - 1U)) != 0U */
+
+/* Exported variables --------------------------------------------------------*/
+AUDIO_TraceRing_t AUDIO_TraceRing;
+
+/* Exported functions --------------------------------------------------------*/
+/**
+  * @brief  AUDIO_TraceInit
+  *         Starts the cycle counter used as time base and clears the ring.
+  * @param  None
+  * @retval 0 if no error
+  */
+int8_t  AUDIO_TraceInit(void)
+{
+  if(AUDIO_CycleCounterInit() != 0)
+  {
+    return -1;
+  }
+  memset(&AUDIO_TraceRing, 0, sizeof(AUDIO_TraceRing));
+  AUDIO_TraceRing.version = AUDIO_TRACE_VERSION;
+  AUDIO_TraceRing.record_size = sizeof(AUDIO_TraceRecord_t);
+  AUDIO_TraceRing.record_count = AUDIO_TRACE_RING_SIZE;
+  AUDIO_TraceRing.time_frequency = AUDIO_CYCLE_COUNTER_FREQ;
+  /* magic is written last, an incomplete header is never decoded */
+  AUDIO_TraceRing.magic = AUDIO_TRACE_MAGIC;
+  return 0;
+}
+
+/**
+  * @brief  AUDIO_TraceEmit
+  *         Writes a record to the ring, the oldest record is overwritten when the ring is full.
+  * @param  event(IN):  AUDIO_TraceEvent_t
+  * @param  node(IN):   AUDIO_TraceNode_t
+  * @param  buf(IN):    circular buffer of the emitter, may be 0
+  * @param  length(IN): packet length
+  * @param  arg(IN):    event specific
+  * @retval None
+  */
+void  AUDIO_TraceEmit(uint8_t event, uint8_t node, AUDIO_CircularBuffer_t* buf, uint16_t length, uint16_t arg)
+{
+  uint32_t index, time;
+  AUDIO_TraceRecord_t* record;
+
+  /* reserve the slot, an interrupt between load and store makes the store fail. The time is sampled with the
+     reservation, so records are in time order : an emitter which preempts this one takes a later slot and time */
+  do
+  {
+    index = __LDREXW(&AUDIO_TraceRing.head);
+    time = AUDIO_CycleCounterGet();
+  }
+  while(__STREXW(index + 1U, &AUDIO_TraceRing.head) != 0U);
+
+  record = &AUDIO_TraceRing.records[index & (AUDIO_TRACE_RING_SIZE - 1U)];
+  record->time   = time;
+  record->event  = event;
+  record->node   = node;
+  record->length = length;
+  record->arg    = arg;
+  if(buf)
+  {
+    record->rd_ptr = buf->rd_ptr;
+    record->wr_ptr = buf->wr_ptr;
+    record->size   = buf->size;
+  }
+  else
+  {
+    record->rd_ptr = record->wr_ptr = record->size = 0;
+  }
+}
+#endif /* USE_AUDIO_TRACE */
+/************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
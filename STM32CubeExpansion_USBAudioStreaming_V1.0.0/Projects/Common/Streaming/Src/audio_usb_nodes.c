@@ -20,6 +20,7 @@
 /* Includes ------------------------------------------------------------------*/
 #include "usb_audio.h"
 #include "audio_usb_nodes.h"
+#include "audio_trace.h"
 
 /* External variables --------------------------------------------------------*/
 /* Private macros ------------------------------------------------------------*/
@@ -35,19 +36,6 @@
 #endif /*(defined USE_AUDIO_USB_PLAY_MULTI_FREQUENCIES)||(defined USE_AUDIO_USB_RECORD_MULTI_FREQUENCIES) */
 #endif /* USE_USB_AUDIO_CLASS_10 */
 
-#define DEBUG_USB_NODES  0  /* set to 1  to debug USB input for playback */
-#if DEBUG_USB_NODES
-#define USB_INPUT_NODE_DEBUG_BUFFER_SIZE 1000
-/* Private typedef -----------------------------------------------------------*/
-typedef struct
-{
-  uint32_t time;
-  uint16_t write;
-  uint16_t read;
-  uint16_t error;
-} AUDIO_USBInputBufferDebugStats_t;
-#endif /* DEBUG_USB_NODES */
-
 /* Private function prototypes -----------------------------------------------*/
 static int8_t     USB_AudioStreamingInputOutputDeInit(uint32_t node_handle);
 static int8_t     USB_AudioStreamingInputOutputStart( AUDIO_CircularBuffer_t* buffer, uint16_t threshold ,uint32_t node_handle);
@@ -134,11 +122,22 @@ USB_AUDIO_CONFIG_FREQ_8_K,
 #endif /* USE_AUDIO_USB_PLAY_MULTI_FREQUENCIES*/
 #endif /* USE_USB_AUDIO_CLASS_10 */
 
-#if DEBUG_USB_NODES
-static AUDIO_USBInputBufferDebugStats_t stats_buffer [USB_INPUT_NODE_DEBUG_BUFFER_SIZE];
-static int stats_count=0;
-extern __IO uint32_t uwTick;
-#endif /* DEBUG_USB_NODES */
+#if USE_USB_AUDIO_DMA
+/* OTG DMA accesses whole words at word aligned addresses, packets which don't start on a word
+   boundary of the circular buffer go through these buffers. The D-cache is maintained by 32 bytes
+   lines, the buffers own their lines so that invalidating them never drops a neighbour variable.
+   A received packet is written in place only when it owns whole lines of the circular buffer : the
+   nodes keep reading and writing the samples around it while the transfer is pending */
+#define USB_DMA_CACHE_LINE_SIZE                 32U
+#define USB_DMA_OWNS_CACHE_LINES(addr, size)    (((((uint32_t)(addr))|((uint32_t)(size)))&(USB_DMA_CACHE_LINE_SIZE - 1U)) == 0U)
+#define USB_DMA_BUFFER_WORD_SIZE(packet_size)   ((((packet_size) + USB_DMA_CACHE_LINE_SIZE - 1U)&~(USB_DMA_CACHE_LINE_SIZE - 1U))/4U)
+#if USE_USB_AUDIO_PLAYBACK
+static uint32_t USB_InputDmaBuffer[USB_DMA_BUFFER_WORD_SIZE(USBD_AUDIO_CONFIG_PLAY_MAX_PACKET_SIZE)] __ALIGNED(USB_DMA_CACHE_LINE_SIZE);
+#endif /* USE_USB_AUDIO_PLAYBACK */
+#if USE_USB_AUDIO_RECORDING
+static uint32_t USB_OutputDmaBuffer[USB_DMA_BUFFER_WORD_SIZE(USBD_AUDIO_CONFIG_RECORD_MAX_PACKET_SIZE)] __ALIGNED(USB_DMA_CACHE_LINE_SIZE);
+#endif /* USE_USB_AUDIO_RECORDING */
+#endif /* USE_USB_AUDIO_DMA */
 
 /* Functions ---------------------------------------------------------*/
 #if USE_USB_AUDIO_PLAYBACK
@@ -372,12 +371,18 @@ static int8_t  USB_AudioStreamingInputDataReceived( uint16_t data_len, uint32_t
      }
      
      buf=input_node->buf;
+#if USE_USB_AUDIO_DMA
+     if(input_node->flags&AUDIO_IO_DMA_BUFFER_USED)
+     {
+       memcpy(buf->data+buf->wr_ptr, USB_InputDmaBuffer, data_len);
+       input_node->flags &= ~AUDIO_IO_DMA_BUFFER_USED;
+     }
+#endif /* USE_USB_AUDIO_DMA */
      buf->wr_ptr += data_len;/* increment buffer */
 
      if((input_node->flags&AUDIO_IO_BEGIN_OF_STREAM) == 0)
      { /* this is the first packet */
-       input_node->node.session_handle->SessionCallback(AUDIO_BEGIN_OF_STREAM,(AUDIO_Node_t*)input_node,
-                                                        input_node->node.session_handle);   /* send event to mother session */
+       AUDIO_SESSION_NOTIFY(input_node->node.session_handle, AUDIO_BEGIN_OF_STREAM, input_node);   /* send event to mother session */
        input_node->flags |= AUDIO_IO_BEGIN_OF_STREAM;
      }
      else
@@ -396,16 +401,15 @@ static int8_t  USB_AudioStreamingInputDataReceived( uint16_t data_len, uint32_t
       if(((input_node->flags&AUDIO_IO_THRESHOLD_REACHED) == 0)&&
           (buffer_data_count >= input_node->specific.input.threshold))
       {  
-         input_node->node.session_handle->SessionCallback(AUDIO_THRESHOLD_REACHED, (AUDIO_Node_t*)input_node,
-                                                         input_node->node.session_handle);   /* inform session that the buffer threshold is reached */
+         AUDIO_SESSION_NOTIFY(input_node->node.session_handle, AUDIO_THRESHOLD_REACHED, input_node);   /* inform session that the buffer threshold is reached */
           input_node->flags |= AUDIO_IO_THRESHOLD_REACHED ;
        }
        else
        {
-        input_node->node.session_handle->SessionCallback(AUDIO_PACKET_RECEIVED, (AUDIO_Node_t*)input_node,
-                                                         input_node->node.session_handle); /* inform session that a packet is received */
+        AUDIO_SESSION_NOTIFY(input_node->node.session_handle, AUDIO_PACKET_RECEIVED, input_node); /* inform session that a packet is received */
        }
      }
+     AUDIO_TRACE(AUDIO_TRACE_USB_PACKET_RECEIVED, AUDIO_TRACE_NODE_USB_INPUT, buf, data_len, 0);
     }
    else
    {
@@ -427,17 +431,7 @@ static uint8_t* USB_AudioStreamingInputGetBuffer(uint32_t node_handle, uint16_t*
   uint16_t buffer_free_size;
   
   input_node = (AUDIO_USBInputOutputNode_t *)node_handle;
-#if DEBUG_USB_NODES
-  stats_buffer[stats_count].read = input_node->buf->rd_ptr;
-  stats_buffer[stats_count].write = input_node->buf->wr_ptr;
-  stats_buffer[stats_count].time = uwTick;
-  
-  stats_count++;
-  if(stats_count == USB_INPUT_NODE_DEBUG_BUFFER_SIZE)
-  {
-    stats_count=0;
-  }
-#endif /*DEBUG_USB_NODES*/
+  AUDIO_TRACE(AUDIO_TRACE_USB_RX_BUFFER, AUDIO_TRACE_NODE_USB_INPUT, input_node->buf, input_node->max_packet_length, 0);
   *max_packet_length = input_node->max_packet_length;
   if( input_node->node.state == AUDIO_NODE_STARTED)
   {
@@ -446,8 +440,7 @@ static uint8_t* USB_AudioStreamingInputGetBuffer(uint32_t node_handle, uint16_t*
     
     if(buffer_free_size < input_node->max_packet_length)
     {
-      input_node->node.session_handle->SessionCallback(AUDIO_OVERRUN, (AUDIO_Node_t*)input_node,
-                                                       input_node->node.session_handle);
+      AUDIO_SESSION_NOTIFY(input_node->node.session_handle, AUDIO_OVERRUN, input_node);
     }
     
     if(input_node->flags&AUDIO_IO_RESTART_REQUIRED)
@@ -455,6 +448,14 @@ static uint8_t* USB_AudioStreamingInputGetBuffer(uint32_t node_handle, uint16_t*
      input_node->flags = 0;
      input_node->buf->rd_ptr = input_node->buf->wr_ptr = 0;
     }
+#if USE_USB_AUDIO_DMA
+    if(!USB_DMA_OWNS_CACHE_LINES(input_node->buf->data+input_node->buf->wr_ptr, input_node->max_packet_length))
+    {
+      /* receive in the line aligned buffer, the packet is copied by USB_AudioStreamingInputDataReceived */
+      input_node->flags |= AUDIO_IO_DMA_BUFFER_USED;
+      return (uint8_t*)USB_InputDmaBuffer;
+    }
+#endif /* USE_USB_AUDIO_DMA */
     return input_node->buf->data+input_node->buf->wr_ptr;
   }
   else
@@ -502,8 +503,7 @@ static uint8_t* USB_AudioStreamingOutputGetBuffer(uint32_t node_handle,uint16_t*
        return output_node->specific.output.alt_buff;
      }
 #if USE_AUDIO_RECORDING_USB_IMPLICIT_SYNCHRO 
-      output_node->node.session_handle->SessionCallback(AUDIO_PACKET_PLAYED, (AUDIO_Node_t*)output_node,
-                                                        output_node->node.session_handle);/* inform session that a packet is sent to the host */
+      AUDIO_SESSION_NOTIFY(output_node->node.session_handle, AUDIO_PACKET_PLAYED, output_node);/* inform session that a packet is sent to the host */
 #endif /* USE_AUDIO_RECORDING_USB_IMPLICIT_SYNCHRO */
 #if USB_AUDIO_CONFIG_RECORD_USE_FREQ_44_1_K
 /* specific treatment to the fractional frequencies , as the packet haven't the same size */
@@ -542,16 +542,14 @@ static uint8_t* USB_AudioStreamingOutputGetBuffer(uint32_t node_handle,uint16_t*
         /* buffer is not ready  */
         return output_node->specific.output.alt_buff;
       }
-       output_node->node.session_handle->SessionCallback(AUDIO_BEGIN_OF_STREAM, (AUDIO_Node_t*)output_node,
-                                                        output_node->node.session_handle);
+       AUDIO_SESSION_NOTIFY(output_node->node.session_handle, AUDIO_BEGIN_OF_STREAM, output_node);
        output_node->flags |= AUDIO_IO_BEGIN_OF_STREAM;
      }
        /* Check for underrun */
       buffer_data_count = AUDIO_BUFFER_FILLED_SIZE(buf);       
       if(buffer_data_count < *packet_length)
       {
-       output_node->node.session_handle->SessionCallback(AUDIO_UNDERRUN, (AUDIO_Node_t*)output_node,
-                                                        output_node->node.session_handle);
+       AUDIO_SESSION_NOTIFY(output_node->node.session_handle, AUDIO_UNDERRUN, output_node);
         return output_node->specific.output.alt_buff;
       }
       else
@@ -604,6 +602,15 @@ static uint8_t* USB_AudioStreamingOutputGetBuffer(uint32_t node_handle,uint16_t*
         {
           buf->rd_ptr = 0;
         }
+        AUDIO_TRACE(AUDIO_TRACE_USB_PACKET_SENT, AUDIO_TRACE_NODE_USB_OUTPUT, buf, *packet_length, 0);
+#if USE_USB_AUDIO_DMA
+        if(((uint32_t)packet_data&0x03U) != 0U)
+        {
+          /* OTG DMA can't read from this address, send a copy */
+          memcpy(USB_OutputDmaBuffer, packet_data, *packet_length);
+          packet_data = (uint8_t*)USB_OutputDmaBuffer;
+        }
+#endif /* USE_USB_AUDIO_DMA */
       }
      return (packet_data);
    }
@@ -719,8 +726,7 @@ static int8_t  USB_AudioStreamingInputOutputSetCurFrequency(uint32_t freq, uint8
  }
 #endif /* USE_AUDIO_USB_RECORD_MULTI_FREQUENCIES*/
   usb_io_node->packet_length = AUDIO_USB_PACKET_SIZE_FROM_AUD_DESC(aud);
-  usb_io_node->node.session_handle->SessionCallback(AUDIO_FREQUENCY_CHANGED,(AUDIO_Node_t*)usb_io_node,
-                                                        usb_io_node->node.session_handle);
+  AUDIO_SESSION_NOTIFY(usb_io_node->node.session_handle, AUDIO_FREQUENCY_CHANGED, usb_io_node);
  *usb_ep_restart_is_required = 1;
  }
  else
@@ -828,6 +834,11 @@ static int8_t  USB_AudioStreamingInputOutputGetState(uint32_t node_handle)
   VOLUME_DB_256_TO_USB(cf->usb_control_callbacks.MinVolume, audio_defaults->min_volume);
   cf->usb_control_callbacks.ResVolume = audio_defaults->res_volume;
   cf->node.audio_description=audio_defaults->audio_description;
+#if AUDIO_USB_CF_CHANNEL_COUNT
+  /* channel requests beyond the cluster of the unit are rejected, not only those beyond the arrays */
+  cf->channel_count = (audio_defaults->audio_description->channels_count < AUDIO_USB_CF_CHANNEL_COUNT)?
+                       audio_defaults->audio_description->channels_count : AUDIO_USB_CF_CHANNEL_COUNT;
+#endif /* AUDIO_USB_CF_CHANNEL_COUNT */
   
   /* fill structure used by USB Audio Class module */
   usb_control_feature->id = unit_id;
@@ -874,6 +885,20 @@ static int8_t USB_AudioStreamingFeatureUnitStart(AUDIO_USBFeatureUnitCommands_t*
                                       cf->node.audio_description->audio_volume_db_256,
                                       cf->control_cbks.private_data);
   }
+#if AUDIO_USB_CF_CHANNEL_COUNT
+  /* channel controls received while stopped */
+  for(int i = 0; i < cf->channel_count; i++)
+  {
+    if(cf->control_cbks.SetCurrentVolume)
+    {
+      cf->control_cbks.SetCurrentVolume(i + 1, cf->channel_volume_db_256[i], cf->control_cbks.private_data);
+    }
+    if(cf->control_cbks.SetMute)
+    {
+      cf->control_cbks.SetMute(i + 1, cf->channel_mute[i], cf->control_cbks.private_data);
+    }
+  }
+#endif /* AUDIO_USB_CF_CHANNEL_COUNT */
   return 0;
 }
 
@@ -896,14 +921,24 @@ static int8_t USB_AudioStreamingFeatureUnitStop( uint32_t node_handle)
 /**
   * @brief  USB_AudioStreamingFeatureUnitGetMute
   *         get mute value
-  * @param  channel: channel number , 0 for master channel (only this option is supported now)
+  * @param  channel: channel number , 0 for master channel, logical channels up to the channel count of the unit
   * @param  mute: returned mute value
   * @param  node_handle: the Feature node handle, node must be initialized
   * @retval  0 for no error
   */
 static int8_t USB_AudioStreamingFeatureUnitGetMute(uint16_t channel, uint8_t* mute, uint32_t node_handle)
 {
-  /**@TODO add channel management  */
+  if(channel > ((AUDIO_USB_CF_NodeTypeDef*)node_handle)->channel_count)
+  {
+    return -1;
+  }
+#if AUDIO_USB_CF_CHANNEL_COUNT
+  if(channel)
+  {
+    *mute = ((AUDIO_USB_CF_NodeTypeDef*)node_handle)->channel_mute[channel - 1];
+    return 0;
+  }
+#endif /* AUDIO_USB_CF_CHANNEL_COUNT */
   *mute = ((AUDIO_USB_CF_NodeTypeDef*)node_handle)->node.audio_description->audio_mute; 
   return 0; 
 }
@@ -911,7 +946,7 @@ static int8_t USB_AudioStreamingFeatureUnitGetMute(uint16_t channel, uint8_t* mu
 /**
   * @brief  USB_AudioStreamingFeatureUnitSetMute
   *         set mute value
-  * @param  channel: channel number , 0 for master channel(only this option is supported now)
+  * @param  channel: channel number , 0 for master channel, logical channels up to the channel count of the unit
   * @param  mute:  mute value
   * @param  node_handle: the Feature node handle, node must be initialized
   * @retval  0 for no error
@@ -921,9 +956,20 @@ static int8_t USB_AudioStreamingFeatureUnitSetMute(uint16_t channel, uint8_t mut
   AUDIO_USB_CF_NodeTypeDef * cf;
   
   cf = (AUDIO_USB_CF_NodeTypeDef*)node_handle;
-  /**@TODO add channel management  */
-  
-  cf->node.audio_description->audio_mute = mute;
+  if(channel > cf->channel_count)
+  {
+    return -1;
+  }
+#if AUDIO_USB_CF_CHANNEL_COUNT
+  if(channel)
+  {
+    cf->channel_mute[channel - 1] = mute;
+  }
+  else
+#endif /* AUDIO_USB_CF_CHANNEL_COUNT */
+  {
+    cf->node.audio_description->audio_mute = mute;
+  }
   if((cf->node.state == AUDIO_NODE_STARTED)&&(cf->control_cbks.SetMute))
   {
       cf->control_cbks.SetMute(channel, mute, cf->control_cbks.private_data);
@@ -934,14 +980,24 @@ static int8_t USB_AudioStreamingFeatureUnitSetMute(uint16_t channel, uint8_t mut
 /**
   * @brief  USB_AudioStreamingFeatureUnitGetCurVolume
   *         get current volume  value
-  * @param  channel:            channel number , 0 for master channel(only this option is supported now)
+  * @param  channel:            channel number , 0 for master channel, logical channels up to the channel count of the unit
   * @param  volume:             returned volume value
   * @param  node_handle:        the Feature node handle, node must be initialized
   * @retval  0 for no error
   */
 static int8_t USB_AudioStreamingFeatureUnitGetCurVolume(uint16_t channel, uint16_t* volume, uint32_t node_handle)
 {
-  /**@TODO add channel management  */
+  if(channel > ((AUDIO_USB_CF_NodeTypeDef*)node_handle)->channel_count)
+  {
+    return -1;
+  }
+#if AUDIO_USB_CF_CHANNEL_COUNT
+  if(channel)
+  {
+    VOLUME_DB_256_TO_USB(*volume, ((AUDIO_USB_CF_NodeTypeDef*)node_handle)->channel_volume_db_256[channel - 1]);
+    return 0;
+  }
+#endif /* AUDIO_USB_CF_CHANNEL_COUNT */
   VOLUME_DB_256_TO_USB(*volume, ((AUDIO_Node_t*)node_handle)->audio_description->audio_volume_db_256);
   return 0; 
 }
@@ -949,7 +1005,7 @@ static int8_t USB_AudioStreamingFeatureUnitGetCurVolume(uint16_t channel, uint16
 /**
   * @brief  USB_AudioStreamingFeatureUnitSetCurVolume
   *         set current volume  value
-  * @param  channel:            channel number , 0 for master channel(only this option is supported now)
+  * @param  channel:            channel number , 0 for master channel, logical channels up to the channel count of the unit
   * @param  volume:             volume value
   * @param  node_handle:        the Feature node handle, node must be initialized
   * @retval  0 for no error
@@ -957,16 +1013,25 @@ static int8_t USB_AudioStreamingFeatureUnitGetCurVolume(uint16_t channel, uint16
 static int8_t USB_AudioStreamingFeatureUnitSetCurVolume(uint16_t channel, uint16_t volume, uint32_t node_handle)
 {
   AUDIO_USB_CF_NodeTypeDef* cf;
+  int* volume_db_256;
   
   cf = (AUDIO_USB_CF_NodeTypeDef*)node_handle;
-  /**@TODO add channel management  */
+  if(channel > cf->channel_count)
+  {
+    return -1;
+  }
+  volume_db_256 = &cf->node.audio_description->audio_volume_db_256;
+#if AUDIO_USB_CF_CHANNEL_COUNT
+  if(channel)
+  {
+    volume_db_256 = &cf->channel_volume_db_256[channel - 1];
+  }
+#endif /* AUDIO_USB_CF_CHANNEL_COUNT */
   
-  VOLUME_USB_TO_DB_256(cf->node.audio_description->audio_volume_db_256, volume);
+  VOLUME_USB_TO_DB_256(*volume_db_256, volume);
   if((cf->node.state == AUDIO_NODE_STARTED)&&(cf->control_cbks.SetCurrentVolume))
   {
-    cf->control_cbks.SetCurrentVolume(channel, 
-                                      cf->node.audio_description->audio_volume_db_256,
-                                      cf->control_cbks.private_data);
+    cf->control_cbks.SetCurrentVolume(channel, *volume_db_256, cf->control_cbks.private_data);
   }
   return 0;
 }
@@ -990,6 +1055,8 @@ static int8_t  USB_AudioStreamingFeatureUnitGetStatus( uint32_t node_handle )
   * @brief  USB_AudioStreamingInitializeDataBuffer
   *         The circular buffer has the total size of buffer_size. this size is divided to two : the regular size and the margin.
   *         Margin is located at the tail of the circular buffer. Margin is used as some packet have regular size+/-1 sample. 
+  *         The regular size is a multiple of the packet size and of 4 bytes, so packets of regular size keep
+  *         starting on a word boundary after the pointers wrap.
   * @param  buf:  main circular buffer               
   * @param  buffer_size: whole buffer size when allocated                
   * @param  packet_size:USB Audio packet size 
@@ -1000,8 +1067,23 @@ static int8_t  USB_AudioStreamingFeatureUnitGetStatus( uint32_t node_handle )
                                        uint32_t buffer_size, 
                                        uint16_t packet_size, uint16_t margin)
  {
+    uint32_t step = packet_size;
+    
+    if((packet_size == 0)||(buffer_size <= margin))
+    {
+      Error_Handler();
+    }
+    /* smallest multiple of packet_size which is word aligned, 4 packets at most */
+    for(int i = 1; (i < 4)&&(step&0x03); i++)
+    {
+      step += packet_size;
+    }
+    if(step > buffer_size - margin)
+    {
+      step = packet_size;
+    }
     buf->size = ((int)((buffer_size - margin )
-                       / packet_size)) * packet_size; 
+                       / step)) * step; 
     buf->rd_ptr = buf->wr_ptr = 0;
  }
 /************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
@@ -22,10 +22,24 @@
 #include "usb_audio.h"
 #include "audio_speaker_node.h"
 #include "audio_sessions_usb.h"
+#include "audio_profiler.h"
+#include "audio_trace.h"
+#include "audio_graph.h"
+#include "audio_gain_node.h"
+#include "audio_eq_node.h"
+#include "audio_limiter_node.h"
+#include "audio_mixer_node.h"
+#include "audio_sidetone.h"
 
 #if USE_USB_AUDIO_PLAYBACK
 /* Private defines -----------------------------------------------------------*/
 #define AUDIO_USB_PLAYBACK_ALTERNATE 0x01
+/* the ring holds the block read by the speaker, the block being received and the threshold margin */
+#define PLAYBACK_RING_MIN_BLOCKS     3
+#if USB_AUDIO_CONFIG_PLAY_BUFFER_SIZE < (PLAYBACK_RING_MIN_BLOCKS * (((USB_AUDIO_CONFIG_PLAY_FREQ_MAX * USB_AUDIO_CONFIG_PLAY_BLOCK_US_MAX) / 1000000) + 1) *\
+                                         USB_AUDIO_CONFIG_PLAY_CHANNEL_COUNT * USB_AUDIO_CONFIG_PLAY_RES_BYTE)
+#error "USB_AUDIO_CONFIG_PLAY_BUFFER_SIZE must hold 3 blocks of USB_AUDIO_CONFIG_PLAY_BLOCK_US_MAX at the max frequency"
+#endif /* USB_AUDIO_CONFIG_PLAY_BUFFER_SIZE < 3 max blocks */
 
 /* Private typedef -----------------------------------------------------------*/
 /* External variables --------------------------------------------------------*/
@@ -60,6 +74,24 @@ static AUDIO_USBInputOutputNode_t PlaybackUSBInputNode;
 static AUDIO_Description_t PlaybackAudioDescription;
 static AUDIO_USB_CF_NodeTypeDef PlaybackFeatureUnitNode;
 static AUDIO_SpeakerNode_t PlaybackSpeakerOutputNode;
+#if USE_AUDIO_PROCESSING_GRAPH
+/* processing applied on each injected block, scratch holds a block of 32 bits samples */
+static AUDIO_Graph_t PlaybackGraph;
+static uint32_t PlaybackGraphScratch[AUDIO_BLOCK_MAX_SIZE(USB_AUDIO_CONFIG_PLAY_FREQ_MAX, USB_AUDIO_CONFIG_PLAY_CHANNEL_COUNT, 4, USB_AUDIO_CONFIG_PLAY_BLOCK_US_MAX)/4];
+#endif /* USE_AUDIO_PROCESSING_GRAPH */
+#if USE_AUDIO_PLAYBACK_MIXER
+static AUDIO_MixerNode_t PlaybackMixerNode;
+#endif /* USE_AUDIO_PLAYBACK_MIXER */
+#if USE_AUDIO_SOFTWARE_VOLUME
+static AUDIO_GainNode_t PlaybackGainNode;
+#endif /* USE_AUDIO_SOFTWARE_VOLUME */
+#if USE_AUDIO_PLAYBACK_EQ
+static AUDIO_EqNode_t PlaybackEqNode;
+static const AUDIO_EqBand_t PlaybackEqBands[] = USB_AUDIO_CONFIG_PLAY_EQ_BANDS;
+#endif /* USE_AUDIO_PLAYBACK_EQ */
+#if USE_AUDIO_PLAYBACK_LIMITER
+static AUDIO_LimiterNode_t PlaybackLimiterNode;
+#endif /* USE_AUDIO_PLAYBACK_LIMITER */
 #if USE_AUDIO_PLAYBACK_USB_FEEDBACK
 /* Playback synchronization : frequency estimation */
 static uint8_t PlaybackSynchroFirstSofReceived = 0;
@@ -94,6 +126,46 @@ static uint32_t PlaybackSynchroEstimatedCodecFrequency = 0;
    play_session->ExternalControl = USB_AudioPlaybackSessionExternalControl;
 #endif /*USE_AUDIO_USB_INTERRUPT*/
    play_session->session.SessionCallback = USB_AudioPlaybackSessionCallback;
+   play_session->session.events_mask = AUDIO_SESSION_EVENT_MASK(AUDIO_THRESHOLD_REACHED)|AUDIO_SESSION_EVENT_MASK(AUDIO_FREQUENCY_CHANGED)|
+                                       AUDIO_SESSION_EVENT_MASK(AUDIO_OVERRUN)|AUDIO_SESSION_EVENT_MASK(AUDIO_UNDERRUN);
+#if USE_AUDIO_PROCESSING_GRAPH
+   AUDIO_GraphInit(&PlaybackGraph, (uint8_t*)PlaybackGraphScratch, sizeof(PlaybackGraphScratch));
+   play_session->session.graph = &PlaybackGraph;
+#endif /* USE_AUDIO_PROCESSING_GRAPH */
+#if USE_AUDIO_PLAYBACK_MIXER
+   /* first node, the volume, equalizer and limiter apply to the mix */
+   AUDIO_MixerInit(&PlaybackMixerNode);
+   AUDIO_GraphAddNode(&PlaybackGraph, &PlaybackMixerNode.processing);
+#endif /* USE_AUDIO_PLAYBACK_MIXER */
+#if USE_AUDIO_SOFTWARE_VOLUME
+   AUDIO_GainInit(&PlaybackGainNode);
+   AUDIO_GraphAddNode(&PlaybackGraph, &PlaybackGainNode.processing);
+#endif /* USE_AUDIO_SOFTWARE_VOLUME */
+#if USE_AUDIO_PLAYBACK_EQ
+   /* after the volume, so lowering the volume leaves headroom for the boosted bands */
+   AUDIO_EqInit(&PlaybackEqNode, USB_AUDIO_CONFIG_PLAY_EQ_FORM);
+   for(int i = 0; i < sizeof(PlaybackEqBands)/sizeof(PlaybackEqBands[0]); i++)
+   {
+     if(AUDIO_EqSetBand(&PlaybackEqNode, 0, i, &PlaybackEqBands[i]) != 0)
+     {
+       Error_Handler();
+     }
+   }
+   AUDIO_GraphAddNode(&PlaybackGraph, &PlaybackEqNode.processing);
+#endif /* USE_AUDIO_PLAYBACK_EQ */
+#if USE_AUDIO_PLAYBACK_LIMITER
+   {
+     /* last node, limits the peaks of the whole chain */
+     AUDIO_LimiterParams_t limiter_params = {USB_AUDIO_CONFIG_PLAY_LIMITER_CEILING_DB_256,
+                                             USB_AUDIO_CONFIG_PLAY_LIMITER_LOOKAHEAD_US,
+                                             USB_AUDIO_CONFIG_PLAY_LIMITER_RELEASE_MS};
+     if(AUDIO_LimiterInit(&PlaybackLimiterNode, &limiter_params) != 0)
+     {
+       Error_Handler();
+     }
+     AUDIO_GraphAddNode(&PlaybackGraph, &PlaybackLimiterNode.processing);
+   }
+#endif /* USE_AUDIO_PLAYBACK_LIMITER */
    play_session->buffer.size = USB_AUDIO_CONFIG_PLAY_BUFFER_SIZE;
    play_session->buffer.data = malloc( USB_AUDIO_CONFIG_PLAY_BUFFER_SIZE); 
    if(! play_session->buffer.data)
@@ -108,6 +180,7 @@ static uint32_t PlaybackSynchroEstimatedCodecFrequency = 0;
   PlaybackAudioDescription.frequency = USB_AUDIO_CONFIG_PLAY_DEF_FREQ;
   PlaybackAudioDescription.audio_volume_db_256 = VOLUME_SPEAKER_DEFAULT_DB_256;
   PlaybackAudioDescription.audio_mute = 0;
+  PlaybackAudioDescription.block_us = USB_AUDIO_CONFIG_PLAY_BLOCK_US;
   *control_count = 0;
  
    /* create usb input node */
@@ -121,6 +194,12 @@ static uint32_t PlaybackSynchroEstimatedCodecFrequency = 0;
   controller_defaults.res_volume = VOLUME_SPEAKER_RES_DB_256;
   USB_AudioStreamingFeatureUnitInit( controls_desc,  &controller_defaults,  USB_AUDIO_CONFIG_PLAY_UNIT_FEATURE_ID, (uint32_t)&PlaybackFeatureUnitNode);
   (*control_count)++;
+#if USE_AUDIO_SIDETONE
+  /* the sidetone feature unit belongs to the speaker path, its ring is filled by the recording graph */
+  AUDIO_SidetoneInit(&controls_desc[*control_count]);
+  (*control_count)++;
+  AUDIO_MixerAddInput(&PlaybackMixerNode, AUDIO_SidetoneGetMixerInput());
+#endif /* USE_AUDIO_SIDETONE */
   PlaybackUSBInputNode.node.next = (AUDIO_Node_t*)&PlaybackFeatureUnitNode;
   AUDIO_SpeakerInit(&PlaybackAudioDescription, &play_session->session, (uint32_t)&PlaybackSpeakerOutputNode);
   PlaybackFeatureUnitNode.node.next = (AUDIO_Node_t*)&PlaybackSpeakerOutputNode;
@@ -145,12 +224,60 @@ static uint32_t PlaybackSynchroEstimatedCodecFrequency = 0;
   /* initialize working buffer */
   uint16_t buffer_margin = (PlaybackUSBInputNode.max_packet_length > PlaybackUSBInputNode.packet_length)?PlaybackUSBInputNode.max_packet_length:0;
   USB_AudioStreamingInitializeDataBuffer(&play_session->buffer, USB_AUDIO_CONFIG_PLAY_BUFFER_SIZE,
-                                  AUDIO_MS_PACKET_SIZE_FROM_AUD_DESC(&PlaybackAudioDescription) , buffer_margin);
+                                  AUDIO_BLOCK_SIZE_FROM_AUD_DESC(&PlaybackAudioDescription) , buffer_margin);
   play_session->session.state = AUDIO_SESSION_INITIALIZED;
 
   return 0;
 }
 
+/**
+  * @brief  AUDIO_PlaybackSessionSetBlockPeriod
+  *         Changes the period of the blocks injected to the speaker while the host doesn't stream (alternate
+  *         setting 0). Short blocks lower the latency, long blocks lower the interrupt rate. The speaker is
+  *         reconfigured on its next DMA transfer complete event, as for a frequency change.
+  * @param  block_us(IN): block period in microseconds, up to USB_AUDIO_CONFIG_PLAY_BLOCK_US_MAX
+  * @retval 0 if no error, -1 if the period is not supported or the session streams
+  */
+int8_t  AUDIO_PlaybackSessionSetBlockPeriod(uint16_t block_us)
+{
+  AUDIO_USBSession_t* play_session = (AUDIO_USBSession_t*)PlaybackUSBInputNode.node.session_handle;
+  uint16_t previous_block_us = PlaybackAudioDescription.block_us;
+  uint16_t buffer_margin;
+
+  if((play_session == 0) || ((play_session->session.state != AUDIO_SESSION_INITIALIZED) &&
+     (play_session->session.state != AUDIO_SESSION_STOPPED)) ||
+     (block_us == 0) || (block_us > USB_AUDIO_CONFIG_PLAY_BLOCK_US_MAX))
+  {
+    return -1;
+  }
+  PlaybackAudioDescription.block_us = block_us;
+  if(PlaybackSpeakerOutputNode.SpeakerChangeFrequency((uint32_t)&PlaybackSpeakerOutputNode) != 0)
+  {
+    PlaybackAudioDescription.block_us = previous_block_us;
+    return -1;
+  }
+  buffer_margin = (PlaybackUSBInputNode.max_packet_length > PlaybackUSBInputNode.packet_length)? PlaybackUSBInputNode.max_packet_length:0;
+  USB_AudioStreamingInitializeDataBuffer(&play_session->buffer, USB_AUDIO_CONFIG_PLAY_BUFFER_SIZE,
+                                  AUDIO_BLOCK_SIZE_FROM_AUD_DESC(&PlaybackAudioDescription) , buffer_margin);
+  return 0;
+}
+
+#if USE_AUDIO_PLAYBACK_MIXER
+/**
+  * @brief  AUDIO_PlaybackSessionAddMixerInput
+  *         Adds a stream to mix with the USB playback stream, must be called after the session initialization.
+  *         The producer of the stream, a source of the device, fills the input ring and starts or stops the
+  *         input with AUDIO_MixerStartInput and AUDIO_MixerStopInput. No second USB playback interface
+  *         feeds the mixer, the class handles one.
+  * @param  input(IN): input initialized by AUDIO_MixerInputInit
+  * @retval 0 if no error
+  */
+int8_t  AUDIO_PlaybackSessionAddMixerInput(AUDIO_MixerInput_t* input)
+{
+  return AUDIO_MixerAddInput(&PlaybackMixerNode, input);
+}
+#endif /* USE_AUDIO_PLAYBACK_MIXER */
+
 /* Private functions ---------------------------------------------------------*/
 
 /**
@@ -167,9 +294,17 @@ static int8_t  USB_AudioPlaybackSessionStart(AUDIO_USBSession_t*  play_session)
         AUDIO_USBFeatureUnitCommands_t commands;
     /* start input node */
     PlaybackUSBInputNode.IOStart(& play_session->buffer,   play_session->buffer.size/2,  (uint32_t)&PlaybackUSBInputNode);
+#if USE_AUDIO_SOFTWARE_VOLUME
+    /* volume and mute are applied to the samples, the feature unit only sends the volume on start */
+    commands.private_data = (uint32_t)&PlaybackGainNode;
+    commands.SetMute = AUDIO_GainSetMute;
+    commands.SetCurrentVolume = AUDIO_GainSetVolume;
+    AUDIO_GainSetMute(0, PlaybackAudioDescription.audio_mute, (uint32_t)&PlaybackGainNode);
+#else /* USE_AUDIO_SOFTWARE_VOLUME */
     commands.private_data = (uint32_t)&PlaybackSpeakerOutputNode;
     commands.SetMute = PlaybackSpeakerOutputNode.SpeakerMute;
     commands.SetCurrentVolume = PlaybackSpeakerOutputNode.SpeakerSetVolume;
+#endif /* USE_AUDIO_SOFTWARE_VOLUME */
     PlaybackFeatureUnitNode.CFStart(&commands,(uint32_t)&PlaybackFeatureUnitNode);
     play_session->session.state = AUDIO_SESSION_STARTED;
   }
@@ -284,6 +419,8 @@ static int8_t  USB_AudioPlaybackSessionCallback(AUDIO_SessionEvent_t  event,
 {
   AUDIO_USBSession_t * play_session = (AUDIO_USBSession_t *)session_handle;
   
+  AUDIO_PROFILER_ENTER(AUDIO_PROFILER_PLAYBACK_SESSION_CALLBACK);
+  AUDIO_TRACE(AUDIO_TRACE_SESSION_EVENT, AUDIO_TRACE_NODE_PLAYBACK_SESSION, &play_session->buffer, 0, event);
   switch(event)
   {
   case AUDIO_THRESHOLD_REACHED:  /*  the buffer fill threshold is reached, then playback starts the speaker to consume data */
@@ -295,9 +432,6 @@ static int8_t  USB_AudioPlaybackSessionCallback(AUDIO_SessionEvent_t  event,
 	  PlaybackSynchroFirstSofReceived =0;   /* restart synchronization*/
 #endif  /* USE_AUDIO_PLAYBACK_USB_FEEDBACK */
     }
-    break;
-  case AUDIO_PACKET_RECEIVED:
-    
     break;
   case AUDIO_FREQUENCY_CHANGED: 
     {
@@ -305,7 +439,7 @@ static int8_t  USB_AudioPlaybackSessionCallback(AUDIO_SessionEvent_t  event,
      PlaybackSpeakerOutputNode.SpeakerChangeFrequency((uint32_t)&PlaybackSpeakerOutputNode);
      uint16_t buffer_margin = (PlaybackUSBInputNode.max_packet_length > PlaybackUSBInputNode.packet_length)? PlaybackUSBInputNode.max_packet_length:0;
   USB_AudioStreamingInitializeDataBuffer(&play_session->buffer, USB_AUDIO_CONFIG_PLAY_BUFFER_SIZE,
-                                  AUDIO_MS_PACKET_SIZE_FROM_AUD_DESC(&PlaybackAudioDescription) , buffer_margin);
+                                  AUDIO_BLOCK_SIZE_FROM_AUD_DESC(&PlaybackAudioDescription) , buffer_margin);
 #if USE_AUDIO_PLAYBACK_USB_FEEDBACK
      PlaybackSynchroFirstSofReceived =0;
      PlaybackSynchroEstimatedCodecFrequency = 0;
@@ -330,6 +464,7 @@ static int8_t  USB_AudioPlaybackSessionCallback(AUDIO_SessionEvent_t  event,
   default :
    break;
   }
+  AUDIO_PROFILER_EXIT(AUDIO_PROFILER_PLAYBACK_SESSION_CALLBACK);
   return 0;
 }
 
@@ -346,6 +481,7 @@ static int8_t  USB_AudioPlaybackSetAudioStreamingInterfaceAlternateSetting( uint
   AUDIO_USBSession_t * play_session;
   
    play_session = (AUDIO_USBSession_t*)session_handle;
+  AUDIO_TRACE(AUDIO_TRACE_ALTERNATE_SETTING, AUDIO_TRACE_NODE_PLAYBACK_SESSION, &play_session->buffer, 0, alternate);
   if(alternate  ==  0)
   {
     if( play_session->alternate != 0)
@@ -446,6 +582,11 @@ static void  AUDIO_USB_Session_Sof_Received(uint32_t session_handle )
         total_received_sub_samples += read_samples_per_channel;
         if(++sof_counter == 1000)
         {
+          if(PlaybackSynchroEstimatedCodecFrequency == 0)
+          {
+            AUDIO_TRACE_VALUE(AUDIO_TRACE_FEEDBACK_LOCKED, AUDIO_TRACE_NODE_PLAYBACK_SESSION, &session->buffer,
+                              total_received_sub_samples>>1);
+          }
           PlaybackSynchroEstimatedCodecFrequency =((total_received_sub_samples)>>1); 
           sof_counter =0;
           total_received_sub_samples = 0;
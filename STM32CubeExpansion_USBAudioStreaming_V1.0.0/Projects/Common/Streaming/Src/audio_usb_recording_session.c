@@ -22,6 +22,13 @@
 #include "usb_audio.h"
 #include "audio_mic_node.h"
 #include "audio_sessions_usb.h"
+#include "audio_scheduler.h"
+#include "audio_profiler.h"
+#include "audio_trace.h"
+#include "audio_graph.h"
+#include "audio_gain_node.h"
+#include "audio_sidetone.h"
+#include "audio_beamformer_node.h"
 #if  USE_USB_AUDIO_RECORDING
 
 
@@ -29,6 +36,12 @@
 /* Private defines -----------------------------------------------------------*/
 #define AUDIO_USB_RECORDING_ALTERNATE           0x01
 #define DEFAULT_VOLUME_DB_256                   0
+/* the ring holds the block written by the microphone, the block being sent and the packets margin */
+#define RECORDING_RING_MIN_BLOCKS               3
+#if USB_AUDIO_CONFIG_RECORD_BUFFER_SIZE < (RECORDING_RING_MIN_BLOCKS * (((USB_AUDIO_CONFIG_RECORD_FREQ_MAX * USB_AUDIO_CONFIG_RECORD_BLOCK_US_MAX) / 1000000) + 1) *\
+                                           USB_AUDIO_CONFIG_RECORD_CHANNEL_COUNT * USB_AUDIO_CONFIG_RECORD_RES_BYTE)
+#error "USB_AUDIO_CONFIG_RECORD_BUFFER_SIZE must hold 3 blocks of USB_AUDIO_CONFIG_RECORD_BLOCK_US_MAX at the max frequency"
+#endif /* USB_AUDIO_CONFIG_RECORD_BUFFER_SIZE < 3 max blocks */
 #if USE_AUDIO_RECORDING_USB_IMPLICIT_SYNCHRO 
 #ifdef USE_USB_FS
 #define USB_SOF_COUNT_PER_SECOND 1000
@@ -36,6 +49,7 @@
 #ifdef USE_USB_HS
 #define USB_SOF_COUNT_PER_SECOND 8000
 #endif /* USE_USB_HS */
+#define AUDIO_SYNC_DEADLINE_US                  (1000000U/USB_SOF_COUNT_PER_SECOND) /* synchro must be computed before next SOF */
 #define AUDIO_SYNC_STARTED                      0x01 /* set to 1 when synchro parameters are ready to use */
 #define AUDIO_SYNC_NEEDED                       0x02 /* We need to add or remove some samples */
 #define AUDIO_SYNC_STABLE                       0x04 /* computed frequency has a good precision */
@@ -56,6 +70,8 @@ typedef struct
   uint32_t written_in_current_second; /* total of sample written to the main buffer(captured) in current seconde( incremented each ms)*/
   uint16_t sof_counter;         /* count of SOF packet reception */
   int      mic_usb_diff;        /* compute the difference between : total count of samples read from mic - total count of samples written to USB */
+  volatile int      mic_usb_delta;  /* samples read from mic - samples written to USB since last computation, posted by USB interrupt */
+  volatile uint16_t sof_pending;    /* count of SOF received since last computation, posted by USB interrupt */
   int8_t   write_count_without_read; /* compute time in ms from last USB call (write action ) */
   uint16_t packet_size;         /* packet size */
   int      sample_per_s_th;     /* threshold to detect that a small drift is observed */
@@ -84,6 +100,7 @@ static int8_t  USB_AudioRecordingSessionExternalControl( AUDIO_ControlCommand_t
 
 #if USE_AUDIO_RECORDING_USB_IMPLICIT_SYNCHRO 
 static void USB_AudioRecordingSofReceived(uint32_t session_handle );
+static void USB_AudioRecordingSynchroCompute(uint32_t session_handle);
 static void USB_AudioRecordingSynchroInit(AUDIO_CircularBuffer_t *buf, uint32_t packet_length);
 static void USB_AudioRecordingSynchroUpdate(int audio_buffer_filled_size );
 #endif /* USE_AUDIO_RECORDING_USB_IMPLICIT_SYNCHRO*/
@@ -93,8 +110,23 @@ static AUDIO_USBInputOutputNode_t RecordingUSBOutputNode;
 static AUDIO_Description_t RecordingAudioDescription;
 static AUDIO_USB_CF_NodeTypeDef RecordingFeatureUnitNode;
 static AUDIO_MicNode_t RecordingMicrophoneNode;
+#if USE_AUDIO_PROCESSING_GRAPH
+/* processing applied on each captured block, scratch holds a block of 32 bits samples */
+static AUDIO_Graph_t RecordingGraph;
+static uint32_t RecordingGraphScratch[AUDIO_BLOCK_MAX_SIZE(USB_AUDIO_CONFIG_RECORD_FREQ_MAX, USB_AUDIO_CONFIG_RECORD_CHANNEL_COUNT, 4, USB_AUDIO_CONFIG_RECORD_BLOCK_US_MAX)/4];
+#endif /* USE_AUDIO_PROCESSING_GRAPH */
+#if USE_AUDIO_SOFTWARE_VOLUME
+static AUDIO_GainNode_t RecordingGainNode;
+#endif /* USE_AUDIO_SOFTWARE_VOLUME */
+#if USE_AUDIO_RECORDING_BEAMFORMER
+static AUDIO_BeamformerNode_t RecordingBeamformerNode;
+static const AUDIO_BeamformerMic_t RecordingBeamformerMics[] = USB_AUDIO_CONFIG_RECORD_BEAM_MICS;
+#endif /* USE_AUDIO_RECORDING_BEAMFORMER */
 #if USE_AUDIO_RECORDING_USB_IMPLICIT_SYNCHRO 
 static  USB_AudioRecordingSynchronizationParams_t RecordingSynchronizationParams; /* synchro parameters*/
+#if USE_AUDIO_DEFERRED_PROCESSING
+static AUDIO_SchedulerTask_t RecordingSynchroTask;
+#endif /* USE_AUDIO_DEFERRED_PROCESSING */
 #endif /* USE_AUDIO_RECORDING_USB_IMPLICIT_SYNCHRO*/
 
 /* exported functions ---------------------------------------------------------*/
@@ -125,6 +157,35 @@ static  USB_AudioRecordingSynchronizationParams_t RecordingSynchronizationParams
    rec_session->ExternalControl = USB_AudioRecordingSessionExternalControl;
 #endif /*USE_AUDIO_USB_INTERRUPT*/
   rec_session->session.SessionCallback = USB_AudioRecordingSessionCallback;
+  rec_session->session.events_mask = AUDIO_SESSION_EVENT_MASK(AUDIO_FREQUENCY_CHANGED)|
+                                     AUDIO_SESSION_EVENT_MASK(AUDIO_OVERRUN)|AUDIO_SESSION_EVENT_MASK(AUDIO_UNDERRUN);
+#if USE_AUDIO_RECORDING_USB_IMPLICIT_SYNCHRO
+  rec_session->session.events_mask |= AUDIO_SESSION_EVENT_MASK(AUDIO_PACKET_RECEIVED)|AUDIO_SESSION_EVENT_MASK(AUDIO_PACKET_PLAYED)|
+                                      AUDIO_SESSION_EVENT_MASK(AUDIO_BEGIN_OF_STREAM);
+#endif /* USE_AUDIO_RECORDING_USB_IMPLICIT_SYNCHRO */
+#if USE_AUDIO_PROCESSING_GRAPH
+  AUDIO_GraphInit(&RecordingGraph, (uint8_t*)RecordingGraphScratch, sizeof(RecordingGraphScratch));
+  rec_session->session.graph = &RecordingGraph;
+#endif /* USE_AUDIO_PROCESSING_GRAPH */
+#if USE_AUDIO_RECORDING_BEAMFORMER
+  /* first node, the mic node captures the array and sends the beams */
+  if((AUDIO_BeamformerInit(&RecordingBeamformerNode, RecordingBeamformerMics,
+                           sizeof(RecordingBeamformerMics) / sizeof(AUDIO_BeamformerMic_t),
+                           USB_AUDIO_CONFIG_RECORD_CHANNEL_COUNT) != 0) ||
+     (AUDIO_BeamformerSetAngle(&RecordingBeamformerNode, 0, USB_AUDIO_CONFIG_RECORD_BEAM_DEF_ANGLE) != 0))
+  {
+    Error_Handler();
+  }
+  AUDIO_GraphAddNode(&RecordingGraph, &RecordingBeamformerNode.processing);
+#endif /* USE_AUDIO_RECORDING_BEAMFORMER */
+#if USE_AUDIO_SIDETONE
+  /* before the gain, the monitored microphone doesn't follow the recording volume */
+  AUDIO_GraphAddNode(&RecordingGraph, AUDIO_SidetoneGetTapNode());
+#endif /* USE_AUDIO_SIDETONE */
+#if USE_AUDIO_SOFTWARE_VOLUME
+  AUDIO_GainInit(&RecordingGainNode);
+  AUDIO_GraphAddNode(&RecordingGraph, &RecordingGainNode.processing);
+#endif /* USE_AUDIO_SOFTWARE_VOLUME */
   
   /*set audio used option*/
   RecordingAudioDescription.resolution = USB_AUDIO_CONFIG_RECORD_RES_BYTE;
@@ -134,6 +195,7 @@ static  USB_AudioRecordingSynchronizationParams_t RecordingSynchronizationParams
   RecordingAudioDescription.frequency = USB_AUDIO_CONFIG_RECORD_DEF_FREQ;
   RecordingAudioDescription.audio_mute = 0;
   RecordingAudioDescription.audio_volume_db_256 = DEFAULT_VOLUME_DB_256;
+  RecordingAudioDescription.block_us = USB_AUDIO_CONFIG_RECORD_BLOCK_US;
   *control_count = 0;
   
   /* create list of node */
@@ -170,7 +232,7 @@ static  USB_AudioRecordingSynchronizationParams_t RecordingSynchronizationParams
   }
   /* @TODO optimize the margin value */
   USB_AudioStreamingInitializeDataBuffer(&rec_session->buffer, USB_AUDIO_CONFIG_RECORD_BUFFER_SIZE,
-                                   AUDIO_MS_PACKET_SIZE_FROM_AUD_DESC(&RecordingAudioDescription) , AUDIO_MS_PACKET_SIZE_FROM_AUD_DESC(&RecordingAudioDescription));
+                                   AUDIO_BLOCK_SIZE_FROM_AUD_DESC(&RecordingAudioDescription) , AUDIO_MS_PACKET_SIZE_FROM_AUD_DESC(&RecordingAudioDescription));
   /* set USB AUDIO class callbacks */
   as_desc->interface_num = rec_session->interface_num;
   as_desc->alternate = 0;
@@ -183,6 +245,12 @@ static  USB_AudioRecordingSynchronizationParams_t RecordingSynchronizationParams
   as_desc->GetState = USB_AudioRecordingGetState;
 #if USE_AUDIO_RECORDING_USB_IMPLICIT_SYNCHRO
   as_desc->SofReceived = USB_AudioRecordingSofReceived;
+#if USE_AUDIO_DEFERRED_PROCESSING
+  if(AUDIO_SchedulerRegisterTask(&RecordingSynchroTask, USB_AudioRecordingSynchroCompute, session_handle, AUDIO_SYNC_DEADLINE_US) != 0)
+  {
+    Error_Handler();
+  }
+#endif /* USE_AUDIO_DEFERRED_PROCESSING */
 #else /* USE_AUDIO_RECORDING_USB_IMPLICIT_SYNCHRO */
   as_desc->SofReceived =  0;
 #endif /* USE_AUDIO_RECORDING_USB_IMPLICIT_SYNCHRO */
@@ -190,6 +258,50 @@ static  USB_AudioRecordingSynchronizationParams_t RecordingSynchronizationParams
   return 0;
 }
 
+/**
+  * @brief  AUDIO_RecordingSessionSetBlockPeriod
+  *         Changes the period of the blocks captured by the microphone while the host doesn't stream (alternate
+  *         setting 0). Short blocks lower the latency, long blocks lower the interrupt rate. The microphone is
+  *         reconfigured on its next DMA event, as for a frequency change.
+  * @param  block_us(IN): block period in microseconds, up to USB_AUDIO_CONFIG_RECORD_BLOCK_US_MAX
+  * @retval 0 if no error, -1 if the period is not supported by the microphone or the session streams
+  */
+int8_t  AUDIO_RecordingSessionSetBlockPeriod(uint16_t block_us)
+{
+  AUDIO_USBSession_t* rec_session = (AUDIO_USBSession_t*)RecordingMicrophoneNode.node.session_handle;
+  uint16_t previous_block_us = RecordingAudioDescription.block_us;
+
+  if((rec_session == 0) || ((rec_session->session.state != AUDIO_SESSION_INITIALIZED) &&
+     (rec_session->session.state != AUDIO_SESSION_STOPPED)) ||
+     (block_us == 0) || (block_us > USB_AUDIO_CONFIG_RECORD_BLOCK_US_MAX))
+  {
+    return -1;
+  }
+  RecordingAudioDescription.block_us = block_us;
+  if(RecordingMicrophoneNode.MicChangeFrequency((uint32_t)&RecordingMicrophoneNode) != 0)
+  {
+    RecordingAudioDescription.block_us = previous_block_us;
+    return -1;
+  }
+  USB_AudioStreamingInitializeDataBuffer(&rec_session->buffer, USB_AUDIO_CONFIG_RECORD_BUFFER_SIZE,
+                                   AUDIO_BLOCK_SIZE_FROM_AUD_DESC(&RecordingAudioDescription) , AUDIO_MS_PACKET_SIZE_FROM_AUD_DESC(&RecordingAudioDescription));
+  return 0;
+}
+
+#if USE_AUDIO_RECORDING_BEAMFORMER
+/**
+  * @brief  AUDIO_RecordingSessionSetBeamAngle
+  *         Steers the beams sent to the host, the new angle applies from the next captured block.
+  * @param  channel_number(IN): 0 for all beams, else beam number
+  * @param  angle_deg(IN):      direction of the source in degrees, 0 is the front of the array
+  * @retval 0 if no error
+  */
+int8_t  AUDIO_RecordingSessionSetBeamAngle(uint16_t channel_number, int angle_deg)
+{
+  return AUDIO_BeamformerSetAngle(&RecordingBeamformerNode, channel_number, angle_deg);
+}
+#endif /* USE_AUDIO_RECORDING_BEAMFORMER */
+
 /* Private functions ---------------------------------------------------------*/
 /**
   * @brief  USB_AudioRecordingSessionStart
@@ -204,9 +316,17 @@ static  int8_t  USB_AudioRecordingSessionStart( AUDIO_USBSession_t* rec_session)
   {
     AUDIO_USBFeatureUnitCommands_t commands;
     /* start feature control node */
+#if USE_AUDIO_SOFTWARE_VOLUME
+    /* volume and mute are applied to the captured samples, the feature unit only sends the volume on start */
+    commands.private_data = (uint32_t)&RecordingGainNode;
+    commands.SetCurrentVolume = AUDIO_GainSetVolume;
+    commands.SetMute = AUDIO_GainSetMute;
+    AUDIO_GainSetMute(0, RecordingAudioDescription.audio_mute, (uint32_t)&RecordingGainNode);
+#else /* USE_AUDIO_SOFTWARE_VOLUME */
     commands.private_data = (uint32_t)&RecordingMicrophoneNode;
     commands.SetCurrentVolume = RecordingMicrophoneNode.MicSetVolume;
     commands.SetMute = RecordingMicrophoneNode.MicMute;
+#endif /* USE_AUDIO_SOFTWARE_VOLUME */
     rec_session->buffer.rd_ptr = rec_session->buffer.wr_ptr = 0;
 #if USE_AUDIO_RECORDING_USB_IMPLICIT_SYNCHRO
     RecordingSynchronizationParams.status = 0;
@@ -292,6 +412,8 @@ static int8_t  USB_AudioRecordingSessionCallback(AUDIO_SessionEvent_t  event,
   
   rec_session = (AUDIO_USBSession_t*)session_handle;
   
+  AUDIO_PROFILER_ENTER(AUDIO_PROFILER_RECORDING_SESSION_CALLBACK);
+  AUDIO_TRACE(AUDIO_TRACE_SESSION_EVENT, AUDIO_TRACE_NODE_RECORDING_SESSION, &rec_session->buffer, 0, event);
   switch(event)
   {
      case AUDIO_FREQUENCY_CHANGED: 
@@ -302,7 +424,7 @@ static int8_t  USB_AudioRecordingSessionCallback(AUDIO_SessionEvent_t  event,
        USB_AudioRecordingSynchroInit(&rec_session->buffer, RecordingUSBOutputNode.packet_length);
 #endif /* USE_AUDIO_RECORDING_USB_IMPLICIT_SYNCHRO */
 USB_AudioStreamingInitializeDataBuffer(&rec_session->buffer, USB_AUDIO_CONFIG_RECORD_BUFFER_SIZE,
-                                AUDIO_MS_PACKET_SIZE_FROM_AUD_DESC(&RecordingAudioDescription) ,
+                                AUDIO_BLOCK_SIZE_FROM_AUD_DESC(&RecordingAudioDescription) ,
                                 AUDIO_MS_MAX_PACKET_SIZE_FROM_AUD_DESC(&RecordingAudioDescription));
        break;
     }
@@ -346,6 +468,7 @@ USB_AudioStreamingInitializeDataBuffer(&rec_session->buffer, USB_AUDIO_CONFIG_RE
   default : 
     break;
   }
+  AUDIO_PROFILER_EXIT(AUDIO_PROFILER_RECORDING_SESSION_CALLBACK);
   return 0;
 }
 
@@ -361,6 +484,7 @@ static int8_t  USB_AudioRecordingSetAudioStreamingInterfaceAlternateSetting( uin
   AUDIO_USBSession_t *rec_session;
   
   rec_session = (AUDIO_USBSession_t*)session_handle;
+  AUDIO_TRACE(AUDIO_TRACE_ALTERNATE_SETTING, AUDIO_TRACE_NODE_RECORDING_SESSION, &rec_session->buffer, 0, alternate);
   if(alternate  ==  0)
   {
     if(rec_session->alternate != 0)
@@ -403,7 +527,7 @@ static int8_t  USB_AudioRecordingGetState(uint32_t session_handle)
  static void  USB_AudioRecordingSofReceived(uint32_t session_handle )
  {
     AUDIO_USBSession_t *rec_session;
-    uint16_t read_bytes, audio_buffer_filled_size;
+    uint16_t read_bytes;
     
   rec_session = (AUDIO_USBSession_t*)session_handle;
   if(( rec_session->session.state == AUDIO_SESSION_STARTED)&&(  RecordingSynchronizationParams.status & AUDIO_SYNC_STARTED))
@@ -420,32 +544,14 @@ static int8_t  USB_AudioRecordingGetState(uint32_t session_handle)
         RecordingSynchronizationParams.written_in_current_second = 0;
       }
       
-      RecordingSynchronizationParams.mic_usb_diff += read_bytes;
-      if(RecordingSynchronizationParams.mic_estimated_freq)
-      {
-        audio_buffer_filled_size = AUDIO_BUFFER_FILLED_SIZE(&rec_session->buffer);
-        USB_AudioRecordingSynchroUpdate(audio_buffer_filled_size);
-      }
-      else
-      {
-        if(RecordingSynchronizationParams.mic_usb_diff >= RecordingSynchronizationParams.packet_size*2)
-        {
-          RecordingSynchronizationParams.samples = RecordingSynchronizationParams.sample_size;
-        }
-        else
-        {
-          if(RecordingSynchronizationParams.mic_usb_diff + 2*RecordingSynchronizationParams.packet_size <= 0)
-          {
-            RecordingSynchronizationParams.samples = -RecordingSynchronizationParams.sample_size;
-          }
-          else
-          if((RecordingSynchronizationParams.mic_usb_diff <= RecordingSynchronizationParams.packet_size)&&
-             (RecordingSynchronizationParams.mic_usb_diff + RecordingSynchronizationParams.packet_size >= 0))
-          {
-            RecordingSynchronizationParams.samples = 0;
-          }
-        }
-      }
+      /* only post the counters, the computation takes them under PRIMASK */
+      RecordingSynchronizationParams.mic_usb_delta += read_bytes;
+      RecordingSynchronizationParams.sof_pending++;
+#if USE_AUDIO_DEFERRED_PROCESSING
+      AUDIO_SchedulerPost(&RecordingSynchroTask);
+#else /* USE_AUDIO_DEFERRED_PROCESSING */
+      USB_AudioRecordingSynchroCompute(session_handle);
+#endif /* USE_AUDIO_DEFERRED_PROCESSING */
    }
     else
     {
@@ -456,6 +562,66 @@ static int8_t  USB_AudioRecordingGetState(uint32_t session_handle)
  }
 
 
+/**
+  * @brief  USB_AudioRecordingSynchroCompute
+  *         computes the count of samples to add or remove, from the counters updated on SOF.
+  *         Called from SOF interrupt handler or from the deferred processing scheduler : the counters
+  *         posted by the USB interrupt are taken under PRIMASK, then the step is accounted once for
+  *         each SOF received since the last call.
+  * @param  session_handle: session handle
+  * @retval None
+  */
+static void  USB_AudioRecordingSynchroCompute(uint32_t session_handle)
+{
+  AUDIO_USBSession_t *rec_session;
+  uint16_t audio_buffer_filled_size;
+  uint32_t primask;
+  int      delta;
+  uint16_t sof_count;
+  
+  rec_session = (AUDIO_USBSession_t*)session_handle;
+  primask = __get_PRIMASK();
+  __disable_irq();
+  delta = RecordingSynchronizationParams.mic_usb_delta;
+  sof_count = RecordingSynchronizationParams.sof_pending;
+  RecordingSynchronizationParams.mic_usb_delta = 0;
+  RecordingSynchronizationParams.sof_pending = 0;
+  __set_PRIMASK(primask);
+  if(rec_session->session.state != AUDIO_SESSION_STARTED)
+  {
+    return;
+  }
+  RecordingSynchronizationParams.mic_usb_diff += delta;
+  if(RecordingSynchronizationParams.mic_estimated_freq)
+  {
+    audio_buffer_filled_size = AUDIO_BUFFER_FILLED_SIZE(&rec_session->buffer);
+    while(sof_count--)
+    {
+      USB_AudioRecordingSynchroUpdate(audio_buffer_filled_size);
+    }
+  }
+  else
+  {
+    if(RecordingSynchronizationParams.mic_usb_diff >= RecordingSynchronizationParams.packet_size*2)
+    {
+      RecordingSynchronizationParams.samples = RecordingSynchronizationParams.sample_size;
+    }
+    else
+    {
+      if(RecordingSynchronizationParams.mic_usb_diff + 2*RecordingSynchronizationParams.packet_size <= 0)
+      {
+        RecordingSynchronizationParams.samples = -RecordingSynchronizationParams.sample_size;
+      }
+      else
+      if((RecordingSynchronizationParams.mic_usb_diff <= RecordingSynchronizationParams.packet_size)&&
+         (RecordingSynchronizationParams.mic_usb_diff + RecordingSynchronizationParams.packet_size >= 0))
+      {
+        RecordingSynchronizationParams.samples = 0;
+      }
+    }
+  }
+}
+
 /**
   * @brief  USB_AudioRecordingSynchroInit
   *         initializes the synchronization structure.
@@ -479,6 +645,8 @@ static void USB_AudioRecordingSynchroInit(AUDIO_CircularBuffer_t *buf, uint32_t
   RecordingSynchronizationParams.mic_estimated_freq = 0;
   RecordingSynchronizationParams.write_count_without_read = 0;
   RecordingSynchronizationParams.mic_usb_diff = 0;
+  RecordingSynchronizationParams.mic_usb_delta = 0;
+  RecordingSynchronizationParams.sof_pending = 0;
   RecordingSynchronizationParams.samples = 0;
   RecordingSynchronizationParams.sof_counter = 0;
   RecordingSynchronizationParams.written_in_current_second = 0;
@@ -488,7 +656,7 @@ static void USB_AudioRecordingSynchroInit(AUDIO_CircularBuffer_t *buf, uint32_t
 
 /**
   * @brief  USB_AudioRecordingSynchroUpdate
-  *         update synchronization parameters, when needed. This call is done within a SOF interrupt handler.
+  *         update synchronization parameters, when needed. This call is done by USB_AudioRecordingSynchroCompute.
   * @param  audio_buffer_filled_size: buffer filled size
   * @retval None
   */
@@ -627,7 +795,7 @@ int8_t  USB_AudioRecordingSynchronizationGetSamplesCountToAddInNextPckt(struct
 {
    if(RecordingSynchronizationParams.status&AUDIO_SYNC_STARTED)
    {
-     RecordingSynchronizationParams.mic_usb_diff -= bytes;
+     RecordingSynchronizationParams.mic_usb_delta -= bytes;
    }
    return 0;
 }
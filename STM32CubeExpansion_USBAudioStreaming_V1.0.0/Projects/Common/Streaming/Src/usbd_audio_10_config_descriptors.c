@@ -21,11 +21,24 @@
 #include "usbd_audio.h"
 #include "usb_audio.h"
 #include "audio_node.h"
+#include "audio_usb_nodes.h"
 
 /* private defines and macro ------------------------------------------------------------------*/
 #if USE_USB_AUDIO_PLAYBACK
+#if USE_AUDIO_SIDETONE
+/* feature unit of the monitored microphone and mixer unit of the played and monitored streams */
+#define SIDETONE_MIXER_CONTROLS_SIZE  ((((USB_AUDIO_CONFIG_PLAY_CHANNEL_COUNT + USB_AUDIO_CONFIG_RECORD_CHANNEL_COUNT) *\
+                                         USB_AUDIO_CONFIG_PLAY_CHANNEL_COUNT) + 7) / 8)
+#define SIDETONE_AC_UNITS_SIZE     ( USBD_AUDIO_FEATURE_UNIT_DESC_SIZE(USB_AUDIO_CONFIG_RECORD_CHANNEL_COUNT,1) +\
+                                     USBD_AUDIO_MIXER_UNIT_DESC_SIZE(2,SIDETONE_MIXER_CONTROLS_SIZE))
+#define PLAYBACK_OUTPUT_SOURCE_ID  USB_AUDIO_CONFIG_PLAY_UNIT_MIXER_ID
+#else /* USE_AUDIO_SIDETONE */
+#define SIDETONE_AC_UNITS_SIZE     0
+#define PLAYBACK_OUTPUT_SOURCE_ID  USB_AUDIO_CONFIG_PLAY_UNIT_FEATURE_ID
+#endif /* USE_AUDIO_SIDETONE */
 #define PLAYBACK_AC_INTERFACE_SIZE ( USBD_AUDIO_INPUT_TERMINAL_DESC_SIZE +\
-                                     USBD_AUDIO_FEATURE_UNIT_DESC_SIZE(2,1) /* Feature Unit */ + USBD_AUDIO_OUTPUT_TERMINAL_DESC_SIZE /* output terminal */)
+                                     USBD_AUDIO_FEATURE_UNIT_DESC_SIZE(2,1) /* Feature Unit */ + USBD_AUDIO_OUTPUT_TERMINAL_DESC_SIZE /* output terminal */ +\
+                                     SIDETONE_AC_UNITS_SIZE)
 #if USE_AUDIO_PLAYBACK_USB_FEEDBACK
 #define PLAYBACK_AS_SYNCH_EP_DESC_SIZE 0x09
 #else
@@ -40,6 +53,12 @@
                                        USBD_AUDIO_SPECIFIC_DATA_ENDPOINT_DESC_SIZE +\
                                        PLAYBACK_AS_SYNCH_EP_DESC_SIZE)
 #define PLAYBACK_AS_INTERFACE_COUNT 1
+/* bDelay of the playback stream in ms, one frame of buffering plus the look-ahead of the limiter, rounded up */
+#if USE_AUDIO_PLAYBACK_LIMITER
+#define PLAYBACK_AS_DELAY_MS        (1 + ((USB_AUDIO_CONFIG_PLAY_LIMITER_LOOKAHEAD_US + 999) / 1000))
+#else /* USE_AUDIO_PLAYBACK_LIMITER */
+#define PLAYBACK_AS_DELAY_MS        1
+#endif /* USE_AUDIO_PLAYBACK_LIMITER */
 #else /* USE_USB_AUDIO_PLAYBACK */
 #define PLAYBACK_AS_INTERFACES_SIZE 0
 #define PLAYBACK_AC_INTERFACE_SIZE 0
@@ -48,7 +67,7 @@
 
 #if  USE_USB_AUDIO_RECORDING
 #define RECORDING_AC_INTERFACE_SIZE (  USBD_AUDIO_INPUT_TERMINAL_DESC_SIZE +\
-                                     USBD_AUDIO_FEATURE_UNIT_DESC_SIZE(2,1) /* Feature Unit */ + USBD_AUDIO_OUTPUT_TERMINAL_DESC_SIZE /* output terminal */)
+                                     USBD_AUDIO_FEATURE_UNIT_DESC_SIZE(USB_AUDIO_CONFIG_RECORD_CHANNEL_COUNT,1) /* Feature Unit */ + USBD_AUDIO_OUTPUT_TERMINAL_DESC_SIZE /* output terminal */)
 
 
 #define RECORDING_AS_INTERFACES_SIZE ( USBD_AUDIO_STANDARD_INTERFACE_DESC_SIZE/*AS Zero bandwidth*/+\
@@ -147,12 +166,53 @@ __ALIGN_BEGIN static uint8_t USBD_AUDIO_ConfigDescriptor[CONFIG_DESCRIPTOR_SIZE
   USB_AUDIO_CONFIG_PLAY_UNIT_FEATURE_ID,        /* bUnitID */
   USB_AUDIO_CONFIG_PLAY_TERMINAL_INPUT_ID,      /* bSourceID: IT 02 */
   0x01,                                         /* bControlSize */
-  /* @TODO add volume  controle on L/R channel */
   USBD_AUDIO_CONTROL_FEATURE_UNIT_MUTE|USBD_AUDIO_CONTROL_FEATURE_UNIT_VOLUME,      /* bmaControls(0) */
-  0,                                            /* bmaControls(1) */
-  0,                                            /* bmaControls(2) */
+  AUDIO_USB_CF_CHANNEL_CONTROLS,                /* bmaControls(1) */
+  AUDIO_USB_CF_CHANNEL_CONTROLS,                /* bmaControls(2) */
   0x00,                                         /* iTerminal */
   /* 10 byte*/
+
+#if USE_AUDIO_SIDETONE
+  /* Sidetone : monitor level of the microphone */
+  /* Feature Unit Descriptor*/
+  USBD_AUDIO_FEATURE_UNIT_DESC_SIZE(USB_AUDIO_CONFIG_RECORD_CHANNEL_COUNT,1), /* bLength */
+  USBD_AUDIO_DESC_TYPE_CS_INTERFACE,            /* bDescriptorType */
+  USBD_AUDIO_CS_AC_SUBTYPE_FEATURE_UNIT,        /* bDescriptorSubtype */
+  USB_AUDIO_CONFIG_SIDETONE_UNIT_FEATURE_ID,    /* bUnitID */
+  USB_AUDIO_CONFIG_RECORD_TERMINAL_INPUT_ID,    /* bSourceID: microphone IT */
+  0x01,                                         /* bControlSize */
+  USBD_AUDIO_CONTROL_FEATURE_UNIT_MUTE|USBD_AUDIO_CONTROL_FEATURE_UNIT_VOLUME,      /* bmaControls(0) */
+  0x00,                                         /* bmaControls(1) */
+#if USB_AUDIO_CONFIG_RECORD_CHANNEL_COUNT > 1
+  0x00,                                         /* bmaControls(2) */
+#endif /* USB_AUDIO_CONFIG_RECORD_CHANNEL_COUNT > 1 */
+#if USB_AUDIO_CONFIG_RECORD_CHANNEL_COUNT > 2
+  0x00,                                         /* bmaControls(3) */
+  0x00,                                         /* bmaControls(4) */
+#endif /* USB_AUDIO_CONFIG_RECORD_CHANNEL_COUNT > 2 */
+  0x00,                                         /* iFeature */
+  /* 9, 10 or 12 byte*/
+
+  /* Sidetone : played stream and monitored microphone mixed to the speaker */
+  /* Mixer Unit Descriptor */
+  USBD_AUDIO_MIXER_UNIT_DESC_SIZE(2,SIDETONE_MIXER_CONTROLS_SIZE), /* bLength */
+  USBD_AUDIO_DESC_TYPE_CS_INTERFACE,            /* bDescriptorType */
+  USBD_AUDIO_CS_AC_SUBTYPE_MIXER_UNIT,          /* bDescriptorSubtype */
+  USB_AUDIO_CONFIG_PLAY_UNIT_MIXER_ID,          /* bUnitID */
+  0x02,                                         /* bNrInPins */
+  USB_AUDIO_CONFIG_PLAY_UNIT_FEATURE_ID,        /* baSourceID(1): play FU */
+  USB_AUDIO_CONFIG_SIDETONE_UNIT_FEATURE_ID,    /* baSourceID(2): sidetone FU */
+  USB_AUDIO_CONFIG_PLAY_CHANNEL_COUNT,          /* bNrChannels */
+  LOBYTE(USB_AUDIO_CONFIG_PLAY_CHANNEL_MAP),    /* wChannelConfig*/
+  HIBYTE(USB_AUDIO_CONFIG_PLAY_CHANNEL_MAP),
+  0x00,                                         /* iChannelNames */
+  0x00,                                         /* bmControls: fixed mixing, levels are set by the feature units */
+#if SIDETONE_MIXER_CONTROLS_SIZE > 1
+  0x00,
+#endif /* SIDETONE_MIXER_CONTROLS_SIZE > 1 */
+  0x00,                                         /* iMixer */
+  /* 13 or 14 byte*/
+#endif /* USE_AUDIO_SIDETONE */
   
   /*USB Play : Speaker Terminal */
   /* Output Terminal Descriptor */
@@ -163,7 +223,7 @@ __ALIGN_BEGIN static uint8_t USBD_AUDIO_ConfigDescriptor[CONFIG_DESCRIPTOR_SIZE
   LOBYTE(USBD_AUDIO_TERMINAL_O_SPEAKER),        /* wTerminalType  0x0301*/
   HIBYTE(USBD_AUDIO_TERMINAL_O_SPEAKER),
   0x00,                                         /* bAssocTerminal */
-  USB_AUDIO_CONFIG_PLAY_UNIT_FEATURE_ID,        /* bSourceID FU 06*/
+  PLAYBACK_OUTPUT_SOURCE_ID,                    /* bSourceID FU 06, or mixer unit with sidetone */
   0x00,                                         /* iTerminal */
   /* 09 byte*/
 #endif /*USE_USB_AUDIO_PLAYBACK*/
@@ -187,17 +247,23 @@ __ALIGN_BEGIN static uint8_t USBD_AUDIO_ConfigDescriptor[CONFIG_DESCRIPTOR_SIZE
   
   /* USB Record control feature */
   /* Feature Unit Descriptor*/
-  USBD_AUDIO_FEATURE_UNIT_DESC_SIZE(2,1),         /* bLength */
+  USBD_AUDIO_FEATURE_UNIT_DESC_SIZE(USB_AUDIO_CONFIG_RECORD_CHANNEL_COUNT,1), /* bLength */
   USBD_AUDIO_DESC_TYPE_CS_INTERFACE,              /* bDescriptorType */
   USBD_AUDIO_CS_AC_SUBTYPE_FEATURE_UNIT,                   /* bDescriptorSubtype */
   USB_AUDIO_CONFIG_RECORD_UNIT_FEATURE_ID,      /* bUnitID */
   USB_AUDIO_CONFIG_RECORD_TERMINAL_INPUT_ID,    /* bSourceID */
   0x01,                                         /* bControlSize */
   USBD_AUDIO_CONTROL_FEATURE_UNIT_MUTE|USBD_AUDIO_CONTROL_FEATURE_UNIT_VOLUME,      /* bmaControls(0) */
-  0x00,                                         /* bmaControls(1) */
-  0x00,                                         /* bmaControls(2) */
+  AUDIO_USB_CF_CHANNEL_CONTROLS,                /* bmaControls(1) */
+#if USB_AUDIO_CONFIG_RECORD_CHANNEL_COUNT > 1
+  AUDIO_USB_CF_CHANNEL_CONTROLS,                /* bmaControls(2) */
+#endif /* USB_AUDIO_CONFIG_RECORD_CHANNEL_COUNT > 1 */
+#if USB_AUDIO_CONFIG_RECORD_CHANNEL_COUNT > 2
+  AUDIO_USB_CF_CHANNEL_CONTROLS,                /* bmaControls(3) */
+  AUDIO_USB_CF_CHANNEL_CONTROLS,                /* bmaControls(4) */
+#endif /* USB_AUDIO_CONFIG_RECORD_CHANNEL_COUNT > 2 */
   0x00,                                         /* iTerminal */
-  /* 10 byte*/
+  /* 9, 10 or 12 byte*/
   
   /*USB IN: Record output*/
   /* Output Terminal Descriptor */
@@ -248,7 +314,7 @@ __ALIGN_BEGIN static uint8_t USBD_AUDIO_ConfigDescriptor[CONFIG_DESCRIPTOR_SIZE
   USBD_AUDIO_DESC_TYPE_CS_INTERFACE,              /* bDescriptorType */
   USBD_AUDIO_CS_SUBTYPE_AS_GENERAL,                      /* bDescriptorSubtype */
   USB_AUDIO_CONFIG_PLAY_TERMINAL_INPUT_ID,      /* bTerminalLink */
-  0x01,                                         /* bDelay */
+  PLAYBACK_AS_DELAY_MS,                         /* bDelay */
   LOBYTE(USBD_AUDIO_FORMAT_TYPE_PCM),                     /* wFormatTag USBD_AUDIO_FORMAT_TYPE_PCM  0x0001*/
   HIBYTE(USBD_AUDIO_FORMAT_TYPE_PCM),
   /* 07 byte*/
@@ -29,6 +29,9 @@ static int8_t  AUDIO_USB_Init(USBD_AUDIO_FunctionDescriptionfTypeDef* usb_audio_
 static int8_t  AUDIO_USB_DeInit(USBD_AUDIO_FunctionDescriptionfTypeDef* audio_function, uint32_t private_data);
 static int8_t  AUDIO_USB_GetState(uint32_t private_data);
 static int8_t  AUDIO_USB_GetConfigDesc (uint8_t ** pdata, uint16_t * psize, uint32_t private_data);
+#if USBD_SUPPORT_AUDIO_VENDOR_REQUEST
+static int8_t  AUDIO_USB_VendorRequest(uint8_t request, uint16_t value, uint16_t index, uint32_t private_data);
+#endif /* USBD_SUPPORT_AUDIO_VENDOR_REQUEST */
 /* exported  variable ---------------------------------------------------------*/
 
  USBD_AUDIO_InterfaceCallbacksfTypeDef audio_class_interface =
@@ -81,6 +84,10 @@ static int8_t  AUDIO_USB_Init(USBD_AUDIO_FunctionDescriptionfTypeDef* usb_audio_
 #if USE_AUDIO_USB_INTERRUPT
   usb_audio_class_function->interrupt_ep_num = USB_AUDIO_CONFIG_INTERRUPT_EP_IN;
 #endif /* USE_AUDIO_USB_INTERRUPT */
+#if USBD_SUPPORT_AUDIO_VENDOR_REQUEST
+  usb_audio_class_function->VendorRequest = AUDIO_USB_VendorRequest;
+  usb_audio_class_function->vendor_private_data = 0;
+#endif /* USBD_SUPPORT_AUDIO_VENDOR_REQUEST */
   return 0;
 }
 
@@ -133,6 +140,30 @@ static int8_t  AUDIO_USB_GetConfigDesc (uint8_t ** pdata, uint16_t * psize, uint
    *psize =  USB_AUDIO_GetConfigDescriptor(pdata);
     return 0;
 }
+
+#if USBD_SUPPORT_AUDIO_VENDOR_REQUEST
+/**
+  * @brief  AUDIO_USB_VendorRequest
+  *         Executes a vendor request of the host, see USB_AUDIO_VENDOR_REQ_xxx
+  * @param  request(IN):  bRequest
+  * @param  value(IN):    wValue
+  * @param  index(IN):    wIndex, the low byte is the audio control interface
+  * @param  private_data:  for future usage
+  * @retval status : 0 if no error, the request is stalled else
+  */
+static int8_t  AUDIO_USB_VendorRequest(uint8_t request, uint16_t value, uint16_t index, uint32_t private_data)
+{
+  switch(request)
+  {
+#if USE_AUDIO_RECORDING_BEAMFORMER
+  case USB_AUDIO_VENDOR_REQ_SET_BEAM_ANGLE:
+    return AUDIO_RecordingSessionSetBeamAngle(HIBYTE(index), (int16_t)value);
+#endif /* USE_AUDIO_RECORDING_BEAMFORMER */
+  default:
+    return -1;
+  }
+}
+#endif /* USBD_SUPPORT_AUDIO_VENDOR_REQUEST */
 #if USE_AUDIO_USB_INTERRUPT
 /**
   * @brief  USBD_AUDIO_ExecuteControl
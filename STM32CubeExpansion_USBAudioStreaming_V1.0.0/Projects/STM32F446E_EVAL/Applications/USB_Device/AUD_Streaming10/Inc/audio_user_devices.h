@@ -35,12 +35,13 @@
 #if USE_AUDIO_MEMS_MIC
 typedef struct
 {
-  uint16_t pdm_buff[PDM_BUF_SIZE(USB_AUDIO_CONFIG_RECORD_FREQ_MAX)];
+  uint16_t pdm_buff[PDM_BUF_SIZE(USB_AUDIO_CONFIG_RECORD_FREQ_MAX)*(USB_AUDIO_CONFIG_RECORD_BLOCK_US_MAX/1000)]; /* 2 blocks */
   uint8_t pdm_tmp_buff[PDM_BUF_SIZE(USB_AUDIO_CONFIG_RECORD_FREQ_MAX)];
   uint16_t writing_step;
   uint32_t pdm_packet_size;
+  uint8_t block_ms; /* block period, the PDM library converts 1 ms per call */
   uint8_t bos; /* begin of play */
-  uint8_t cmd; /* cmd to execute in interruption routine */
+  __IO uint8_t cmd; /* cmd to execute in interruption routine or in the switch task */
 #if USE_AUDIO_RECORDING_USB_IMPLICIT_SYNCHRO
   uint32_t dma_remaining; /* The number of remaining bytes in the current DMA Stream transfer*/
 #endif /* USE_AUDIO_RECORDING_USB_IMPLICIT_SYNCHRO*/
@@ -60,12 +61,18 @@ typedef struct
   uint8_t                double_buff;            /* when the padding is needed the double buffering are required. It means that the alt_buff will contain two packet*/
   uint8_t                offset ;                /* a binary flag. used to indicate if next packet is in the first half of alternate buffer or in the second half*/
   __IO uint8_t           cmd;                    /* this field contains commands to execute within next transfer complete call(or in next Volume change interrupt) */
-  uint16_t               dma_remaining;  /* used for synchronization, it helps to provide the counter of played samples */
+  __IO uint32_t          played_size;    /* size of the completed DMA transfers, in SAI data units */
+  uint32_t               read_position;  /* used for synchronization, played position at the last read count */
 } AUDIO_SpeakerSpecificParms_t;
 #endif /*USE_AUDIO_SPEAKER_DUMMY*/
 #endif /* USE_USB_AUDIO_PLAYBACK */
 /* Exported macros -----------------------------------------------------------*/
 /* Exported functions ------------------------------------------------------- */
+#if USE_USB_AUDIO_PLAYBACK && !USE_AUDIO_SPEAKER_DUMMY
+#if USE_AUDIO_SPEAKER_EARLY_CODEC_INIT
+int8_t  AUDIO_SpeakerCodecPowerUp(void);
+#endif /* USE_AUDIO_SPEAKER_EARLY_CODEC_INIT */
+#endif /* USE_USB_AUDIO_PLAYBACK && !USE_AUDIO_SPEAKER_DUMMY */
 #ifdef __cplusplus
 }
 #endif
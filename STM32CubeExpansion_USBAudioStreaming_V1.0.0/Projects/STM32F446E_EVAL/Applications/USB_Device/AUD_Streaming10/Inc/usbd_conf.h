@@ -41,6 +41,8 @@
 #if USE_AUDIO_PLAYBACK_USB_FEEDBACK
 #define USBD_SUPPORT_AUDIO_OUT_FEEDBACK 1
 #endif  /* USE_AUDIO_PLAYBACK_USB_FEEDBACK */
+/* audio data endpoints bypass the core data stage dispatching : 1 to enable, 0 to keep the core dispatching */
+#define USBD_SUPPORT_ISO_FAST_PATH 1
 #if USE_USB_AUDIO_CLASS_10
 #if (defined USE_AUDIO_USB_PLAY_MULTI_FREQUENCIES)||(defined USE_AUDIO_USB_RECORD_MULTI_FREQUENCIES)
 #define USBD_SUPPORT_AUDIO_MULTI_FREQUENCIES 1
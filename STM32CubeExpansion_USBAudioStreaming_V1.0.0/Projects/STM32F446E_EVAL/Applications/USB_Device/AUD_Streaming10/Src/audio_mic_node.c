@@ -22,6 +22,10 @@
 #include "usbd_audio.h"
 #include "audio_mic_node.h"
 #include "usb_audio.h"
+#include "audio_scheduler.h"
+#include "audio_profiler.h"
+#include "audio_trace.h"
+#include "audio_graph.h"
 
 /* Private defines -----------------------------------------------------------*/
 #define MEMS_VOLUME_MIC_RES_DB_256     256 /* 1 db 1 * 256 = 256*/ 
@@ -30,30 +34,24 @@
 #define MIC_CMD_STOP  1
 #define MIC_CMD_EXIT  2
 #define MIC_CMD_CHANGE_FREQUENCE  4
+#define MIC_CMD_SWITCHING         8 /* capture is stopped, the frequency switch task is pending */
+#define MIC_FILL_DEADLINE_US      USB_AUDIO_CONFIG_RECORD_BLOCK_US /* a DMA half buffer holds one block of samples, follows the block period */
+#define MIC_SWITCH_DEADLINE_US    2000U /* I2S and PDM library reconfiguration, the PLLI2S is relocked only when the frequency family changes */
 
- /* #define DEBUG_MIC_NODE 1 define if debug required*/
-#ifdef DEBUG_MIC_NODE
-#define MIC_DEBUG_BUFFER_SIZE 1000
-#endif /* DEBUG_MIC_NODE */
+#if USB_AUDIO_CONFIG_RECORD_BLOCK_US > USB_AUDIO_CONFIG_RECORD_BLOCK_US_MAX
+#error "USB_AUDIO_CONFIG_RECORD_BLOCK_US must not exceed USB_AUDIO_CONFIG_RECORD_BLOCK_US_MAX"
+#endif /* USB_AUDIO_CONFIG_RECORD_BLOCK_US > USB_AUDIO_CONFIG_RECORD_BLOCK_US_MAX */
+#if ((USB_AUDIO_CONFIG_RECORD_BLOCK_US % 1000) != 0) || ((USB_AUDIO_CONFIG_RECORD_BLOCK_US_MAX % 1000) != 0)
+#error "the PDM library converts 1 ms per call, the record block period must be a multiple of 1 ms"
+#endif /* ((USB_AUDIO_CONFIG_RECORD_BLOCK_US % 1000) != 0) || ((USB_AUDIO_CONFIG_RECORD_BLOCK_US_MAX % 1000) != 0) */
 
 /* Private macros -------------------------------------------------------------*/
+/* size of 1 ms of samples returned by the PDM library, always 16 bits */
+#define MIC_PDM_MS_PCM_SIZE(frequency, channels_count) (((frequency)/1000)*(channels_count)*2)
 #define VOLUME_DB_256_TO_PERCENT(volume_db_256) ((uint8_t)((((int)(volume_db_256) - MEMS_VOLUME_MIC_MIN_DB_256)*100)/\
                                                           (MEMS_VOLUME_MIC_MAX_DB_256 - MEMS_VOLUME_MIC_MIN_DB_256)))
 
-/* Private typedef -----------------------------------------------------------*/
-#ifdef DEBUG_MIC_NODE
-typedef struct
-{
-  uint32_t time;
-  uint16_t write;
-  uint16_t read;
-} AUDIO_MicDebugStats;
-#endif /* DEBUG_MIC_NODE*/
-
 /* externals variables ---------------------------------------------------------*/
-#ifdef DEBUG_MIC_NODE
-extern __IO uint32_t uwTick;
-#endif /* DEBUG_MIC_NODE*/
 
 #if USE_AUDIO_RECORDING_USB_IMPLICIT_SYNCHRO 
 extern I2S_HandleTypeDef haudio_in_i2s;
@@ -73,17 +71,22 @@ static int8_t  AUDIO_MicStartReadCount( uint32_t node_handle);
 static uint16_t AUDIO_MicGetLastReadCount( uint32_t node_handle);
 #endif /* USE_AUDIO_RECORDING_USB_IMPLICIT_SYNCHRO*/
 static void AUDIO_MicFillDataToBuffer(uint32_t pdm_offset);
+static void AUDIO_MicSwitchFrequency(void);
+#if USE_AUDIO_DEFERRED_PROCESSING
+static void AUDIO_MicFillTaskRun(uint32_t private_data);
+static void AUDIO_MicSwitchTaskRun(uint32_t private_data);
+#endif /* USE_AUDIO_DEFERRED_PROCESSING */
 #if ((USB_AUDIO_CONFIG_RECORD_RES_BIT) != 16)
 static void AUDIO_DoPadding(uint8_t* src,  uint8_t *dest,  int size);
 #endif /* ((USB_AUDIO_CONFIG_RECORD_RES_BIT) != 16)  */
  
 /* Private variables ---------------------------------------------------------*/ 
 static AUDIO_MicNode_t *AUDIO_MicHandler = 0;
-#ifdef DEBUG_MIC_NODE
-static AUDIO_MicDebugStats mic_stats[MIC_DEBUG_BUFFER_SIZE];
-static  int AUDIO_MicStatsCount = 0;
-static  int AUDIO_MicStatsCounter = 0;
-#endif /* DEBUG_MIC_NODE*/
+#if USE_AUDIO_DEFERRED_PROCESSING
+static AUDIO_SchedulerTask_t AUDIO_MicFillTask;
+static AUDIO_SchedulerTask_t AUDIO_MicSwitchTask;
+static uint32_t AUDIO_MicFillOffset; /* offset of the DMA half buffer to convert */
+#endif /* USE_AUDIO_DEFERRED_PROCESSING */
 
 /* exported functions ---------------------------------------------------------*/
 /**
@@ -117,13 +120,21 @@ static  int AUDIO_MicStatsCounter = 0;
   mic->MicGetReadCount          = AUDIO_MicGetLastReadCount;
 #endif /* USE_AUDIO_RECORDING_USB_IMPLICIT_SYNCHRO*/
   mic->volume                           = VOLUME_DB_256_TO_PERCENT(audio_description->audio_volume_db_256);
-  mic->packet_length                    = AUDIO_MS_PACKET_SIZE_FROM_AUD_DESC(audio_description);
-  mic->specific.pdm_packet_size    = PDM_BUF_SIZE(audio_description->frequency);
+  mic->specific.block_ms                = (audio_description->block_us < 1000)? 1 : audio_description->block_us/1000;
+  mic->packet_length                    = mic->specific.block_ms * AUDIO_MS_PACKET_SIZE_FROM_AUD_DESC(audio_description);
+  mic->specific.pdm_packet_size    = PDM_BUF_SIZE(audio_description->frequency) * mic->specific.block_ms;
   BSP_AUDIO_IN_Init((audio_description->frequency/1000)*1000, /* PDM Lib doesn't support 44100 freq */
                     audio_description->resolution,
                     audio_description->channels_count);
 
   AUDIO_MicHandler = mic;
+#if USE_AUDIO_DEFERRED_PROCESSING
+  if((AUDIO_SchedulerRegisterTask(&AUDIO_MicFillTask, AUDIO_MicFillTaskRun, 0, MIC_FILL_DEADLINE_US) != 0)||
+     (AUDIO_SchedulerRegisterTask(&AUDIO_MicSwitchTask, AUDIO_MicSwitchTaskRun, 0, MIC_SWITCH_DEADLINE_US) != 0))
+  {
+    Error_Handler();
+  }
+#endif /* USE_AUDIO_DEFERRED_PROCESSING */
   BSP_AUDIO_IN_Record((uint16_t*)&mic->specific.pdm_buff[0], mic->specific.pdm_packet_size); /* x2 for double buffering */
   return 0;
 }
@@ -135,11 +146,18 @@ static  int AUDIO_MicStatsCounter = 0;
   */
 void BSP_AUDIO_IN_HalfTransfer_CallBack(void)
 {
+  AUDIO_PROFILER_ENTER(AUDIO_PROFILER_AUDIO_IN_HALF_TRANSFER);
   /* PDM to PCM data convert */
   if((AUDIO_MicHandler)&&(AUDIO_MicHandler->node.state==AUDIO_NODE_STARTED))
   {
+#if USE_AUDIO_DEFERRED_PROCESSING
+      AUDIO_MicFillOffset = 0;
+      AUDIO_SchedulerPost(&AUDIO_MicFillTask);
+#else /* USE_AUDIO_DEFERRED_PROCESSING */
       AUDIO_MicFillDataToBuffer(0);
+#endif /* USE_AUDIO_DEFERRED_PROCESSING */
   }
+  AUDIO_PROFILER_EXIT(AUDIO_PROFILER_AUDIO_IN_HALF_TRANSFER);
 }
 
 /**
@@ -150,11 +168,28 @@ void BSP_AUDIO_IN_HalfTransfer_CallBack(void)
   */
 void BSP_AUDIO_IN_TransferComplete_CallBack(void)
 {
+  AUDIO_PROFILER_ENTER(AUDIO_PROFILER_AUDIO_IN_TRANSFER_COMPLETE);
   /* PDM to PCM data convert */
   if(AUDIO_MicHandler)
   {
+#if USE_AUDIO_DEFERRED_PROCESSING
+    if(AUDIO_MicHandler->specific.cmd & MIC_CMD_CHANGE_FREQUENCE)
+    {
+      /* only stop the capture here, the I2S is reconfigured by the switch task out of the DMA interrupt */
+      BSP_AUDIO_IN_Stop();
+      AUDIO_MicHandler->specific.cmd = (AUDIO_MicHandler->specific.cmd & ~MIC_CMD_CHANGE_FREQUENCE) | MIC_CMD_SWITCHING;
+      AUDIO_SchedulerPost(&AUDIO_MicSwitchTask);
+    }
+    else
+    {
+      AUDIO_MicFillOffset = (AUDIO_MicHandler->specific.pdm_packet_size>>1);
+      AUDIO_SchedulerPost(&AUDIO_MicFillTask);
+    }
+#else /* USE_AUDIO_DEFERRED_PROCESSING */
       AUDIO_MicFillDataToBuffer((AUDIO_MicHandler->specific.pdm_packet_size>>1));
+#endif /* USE_AUDIO_DEFERRED_PROCESSING */
   }
+  AUDIO_PROFILER_EXIT(AUDIO_PROFILER_AUDIO_IN_TRANSFER_COMPLETE);
 }
 
 /* private functions ---------------------------------------------------------*/
@@ -176,6 +211,8 @@ static int8_t  AUDIO_MicDeInit(uint32_t node_handle)
     {
       AUDIO_MicStop(node_handle);
     }
+    /* a pending frequency switch is cancelled */
+    mic->specific.cmd = 0;
     BSP_AUDIO_IN_Stop();
     BSP_AUDIO_IN_DeInit();  
     mic->node.state = AUDIO_NODE_OFF;
@@ -225,9 +262,10 @@ static int8_t  AUDIO_MicStop( uint32_t node_handle)
 
 /**
   * @brief  AUDIO_MicChangeFrequency
-  *         change mic frequency 
+  *         change mic frequency. The frequency and block period are taken from the audio description,
+  *         the session also calls it when the block period changes
   * @param  node_handle: mic node handle must be initialized
-  * @retval  : 0 if no error
+  * @retval  : 0 if no error, -1 if the block period is not supported
   */
 static int8_t  AUDIO_MicChangeFrequency( uint32_t node_handle)
 {
@@ -235,6 +273,11 @@ static int8_t  AUDIO_MicChangeFrequency( uint32_t node_handle)
   AUDIO_MicNode_t* mic;
 
   mic = (AUDIO_MicNode_t*)node_handle;
+  if((mic->node.audio_description->block_us == 0) || ((mic->node.audio_description->block_us % 1000) != 0))
+  {
+    /* the PDM library converts 1 ms per call */
+    return -1;
+  }
   mic->specific.cmd|= MIC_CMD_CHANGE_FREQUENCE;
   
     return 0;
@@ -298,26 +341,20 @@ static int8_t  AUDIO_MicGetVolumeDefaultsValues( int* vol_max, int* vol_min, int
 static void AUDIO_MicFillDataToBuffer(uint32_t pdm_offset)
 {
   uint32_t buffer_filled_size ;
-#ifdef DEBUG_MIC_NODE
-  uint32_t counter;
-  mic_stats[AUDIO_MicStatsCount].time = uwTick;
-  counter = ++AUDIO_MicStatsCounter;
-#endif /*DEBUG_MIC_NODE*/
-
-  if(AUDIO_MicHandler->specific.cmd & MIC_CMD_CHANGE_FREQUENCE)
-  {  /* first stop the Microphone */
+  uint8_t ms;
+  if(AUDIO_MicHandler->specific.cmd & (MIC_CMD_CHANGE_FREQUENCE|MIC_CMD_SWITCHING))
+  {
+#if USE_AUDIO_DEFERRED_PROCESSING
+    /* the block of the previous frequency is dropped, the DMA transfer complete callback stops the capture */
+#else /* USE_AUDIO_DEFERRED_PROCESSING */
+     /* first stop the Microphone */
      BSP_AUDIO_IN_Stop();
-     BSP_AUDIO_IN_DeInit();
-     /* recalculate the packet length*/
-     AUDIO_MicHandler->packet_length = AUDIO_MS_PACKET_SIZE_FROM_AUD_DESC(AUDIO_MicHandler->node.audio_description);
-     AUDIO_MicHandler->specific.pdm_packet_size = PDM_BUF_SIZE(AUDIO_MicHandler->node.audio_description->frequency);
+     AUDIO_MicSwitchFrequency();
      /* Start the Microphone*/
-     BSP_AUDIO_IN_Init(AUDIO_MicHandler->node.audio_description->frequency,
-                    AUDIO_MicHandler->node.audio_description->resolution,
-                    AUDIO_MicHandler->node.audio_description->channels_count);
      BSP_AUDIO_IN_Record((uint16_t*)&AUDIO_MicHandler->specific.pdm_buff[0], AUDIO_MicHandler->specific.pdm_packet_size); /* x2 for double buffering */
      /* remove the change frequency command */
      AUDIO_MicHandler->specific.cmd &= ~MIC_CMD_CHANGE_FREQUENCE;
+#endif /* USE_AUDIO_DEFERRED_PROCESSING */
   }
   else
   {
@@ -327,42 +364,42 @@ static void AUDIO_MicFillDataToBuffer(uint32_t pdm_offset)
     buffer_filled_size = AUDIO_BUFFER_FREE_SIZE(AUDIO_MicHandler->buf);
     if(buffer_filled_size<=AUDIO_MicHandler->packet_length)
     {
-      AUDIO_MicHandler->node.session_handle->SessionCallback(AUDIO_OVERRUN, (AUDIO_Node_t*)AUDIO_MicHandler,
-                                                        AUDIO_MicHandler->node.session_handle);
+      AUDIO_SESSION_NOTIFY(AUDIO_MicHandler->node.session_handle, AUDIO_OVERRUN, AUDIO_MicHandler);
+    }
+    /* the PDM library converts 1 ms per call */
+    for(ms = 0; ms < AUDIO_MicHandler->specific.block_ms; ms++)
+    {
+      BSP_AUDIO_IN_PDMToPCM((uint16_t*)&AUDIO_MicHandler->specific.pdm_buff[pdm_offset + ms*(PDM_BUF_SIZE(AUDIO_MicHandler->node.audio_description->frequency)>>1)],
+                            (uint16_t*)(AUDIO_MicHandler->buf->data+AUDIO_MicHandler->buf->wr_ptr +
+                                        ms*MIC_PDM_MS_PCM_SIZE(AUDIO_MicHandler->node.audio_description->frequency, AUDIO_MicHandler->node.audio_description->channels_count)),
+                            AUDIO_MicHandler->specific.pdm_tmp_buff, PDM_BUF_SIZE(AUDIO_MicHandler->node.audio_description->frequency));
     }
-    BSP_AUDIO_IN_PDMToPCM((uint16_t*)&AUDIO_MicHandler->specific.pdm_buff[pdm_offset], 
-                        (uint16_t*)(AUDIO_MicHandler->buf->data+AUDIO_MicHandler->buf->wr_ptr), AUDIO_MicHandler->specific.pdm_tmp_buff, AUDIO_MicHandler->specific.pdm_packet_size);
   /* to change to support other resolution */
   /* check for overflow */
 #if ((USB_AUDIO_CONFIG_RECORD_RES_BIT) != 16)
     AUDIO_DoPadding(AUDIO_MicHandler->buf->data+AUDIO_MicHandler->buf->wr_ptr,
                           AUDIO_MicHandler->buf->data+AUDIO_MicHandler->buf->wr_ptr, AUDIO_MicHandler->packet_length);
-    AUDIO_MicHandler->buf->wr_ptr+=AUDIO_MicHandler->packet_length;
-#else  /* #if ((USB_AUDIO_CONFIG_RECORD_RES_BIT) == 16)*/
-    AUDIO_MicHandler->buf->wr_ptr += AUDIO_MicHandler->packet_length;
 #endif /* #if ((USB_AUDIO_CONFIG_RECORD_RES_BIT) != 16) */
+#if USE_AUDIO_PROCESSING_GRAPH
+    {
+      /* apply session processing on the captured block before sending it to the host */
+      AUDIO_GraphPort_t port;
+      port.frequency      = AUDIO_MicHandler->node.audio_description->frequency;
+      port.channels_count = AUDIO_MicHandler->node.audio_description->channels_count;
+      port.format         = AUDIO_MicHandler->node.audio_description->resolution;
+      AUDIO_SESSION_PROCESS(AUDIO_MicHandler->node.session_handle, &port,
+                            AUDIO_MicHandler->buf->data+AUDIO_MicHandler->buf->wr_ptr, AUDIO_MicHandler->packet_length);
+    }
+#endif /* USE_AUDIO_PROCESSING_GRAPH */
+    AUDIO_MicHandler->buf->wr_ptr += AUDIO_MicHandler->packet_length;
    #if USE_AUDIO_RECORDING_USB_IMPLICIT_SYNCHRO 
-  AUDIO_MicHandler->node.session_handle->SessionCallback(AUDIO_PACKET_RECEIVED, (AUDIO_Node_t*)AUDIO_MicHandler,
-                                                        AUDIO_MicHandler->node.session_handle);
+  AUDIO_SESSION_NOTIFY(AUDIO_MicHandler->node.session_handle, AUDIO_PACKET_RECEIVED, AUDIO_MicHandler);
 #endif /* USE_AUDIO_RECORDING_USB_IMPLICIT_SYNCHRO*/
     if(AUDIO_MicHandler->buf->wr_ptr == AUDIO_MicHandler->buf->size)
     {
       AUDIO_MicHandler->buf->wr_ptr = 0;
     }
-#ifdef DEBUG_MIC_NODE
-    if( counter !=AUDIO_MicStatsCounter)
-    {
-      Error_Handler();
-    }
-
-    mic_stats[AUDIO_MicStatsCount].read = AUDIO_MicHandler->buf->rd_ptr;
-    mic_stats[AUDIO_MicStatsCount].write = AUDIO_MicHandler->buf->wr_ptr;
-    
-    if(++AUDIO_MicStatsCount == MIC_DEBUG_BUFFER_SIZE)
-    {
-        AUDIO_MicStatsCount = 0;
-    }
-#endif /*DEBUG_MIC_NODE*/
+    AUDIO_TRACE(AUDIO_TRACE_MIC_FILL, AUDIO_TRACE_NODE_MIC, AUDIO_MicHandler->buf, AUDIO_MicHandler->packet_length, 0);
     }
   }
   
@@ -389,6 +426,72 @@ static void AUDIO_MicFillDataToBuffer(uint32_t pdm_offset)
  }
 #endif /* #if ((USB_AUDIO_CONFIG_RECORD_RES_BIT) != 16)*/
 
+/**
+  * @brief  AUDIO_MicSwitchFrequency
+  *         Sets the block, the I2S and the PDM library for the frequency and block period of the audio
+  *         description, the capture must be stopped. The I2S MSP and the volume timer are kept,
+  *         BSP_AUDIO_IN_Record restarts the capture.
+  * @param  None
+  * @retval None
+  */
+static void AUDIO_MicSwitchFrequency(void)
+{
+  /* recalculate the packet length*/
+  AUDIO_MicHandler->specific.block_ms = AUDIO_MicHandler->node.audio_description->block_us/1000;
+  AUDIO_MicHandler->packet_length = AUDIO_MicHandler->specific.block_ms * AUDIO_MS_PACKET_SIZE_FROM_AUD_DESC(AUDIO_MicHandler->node.audio_description);
+  AUDIO_MicHandler->specific.pdm_packet_size = PDM_BUF_SIZE(AUDIO_MicHandler->node.audio_description->frequency) * AUDIO_MicHandler->specific.block_ms;
+#if USE_AUDIO_DEFERRED_PROCESSING
+  AUDIO_SchedulerSetDeadline(&AUDIO_MicFillTask, AUDIO_MicHandler->node.audio_description->block_us);
+#endif /* USE_AUDIO_DEFERRED_PROCESSING */
+  BSP_AUDIO_IN_Init((AUDIO_MicHandler->node.audio_description->frequency/1000)*1000, /* PDM Lib doesn't support 44100 freq */
+                    AUDIO_MicHandler->node.audio_description->resolution,
+                    AUDIO_MicHandler->node.audio_description->channels_count);
+}
+
+#if USE_AUDIO_DEFERRED_PROCESSING
+/**
+  * @brief  AUDIO_MicFillTaskRun
+  *         scheduler task, converts the DMA half buffer posted by the DMA callbacks
+  * @param  private_data: not used
+  * @retval None
+  */
+static void AUDIO_MicFillTaskRun(uint32_t private_data)
+{
+  if(AUDIO_MicHandler)
+  {
+    AUDIO_MicFillDataToBuffer(AUDIO_MicFillOffset);
+  }
+}
+
+/**
+  * @brief  AUDIO_MicSwitchTaskRun
+  *         scheduler task, switches the frequency after the DMA transfer complete callback stopped the capture.
+  *         The capture restarts at the new frequency, blocks are sent to the session again once its DMA buffer
+  *         is half filled.
+  * @param  private_data: not used
+  * @retval None
+  */
+static void AUDIO_MicSwitchTaskRun(uint32_t private_data)
+{
+  uint32_t primask;
+
+  if((AUDIO_MicHandler == 0)||((AUDIO_MicHandler->specific.cmd & MIC_CMD_SWITCHING) == 0))
+  {
+    return;
+  }
+  AUDIO_MicSwitchFrequency();
+  /* the node may be deinitialized by a higher priority context meanwhile */
+  primask = __get_PRIMASK();
+  __disable_irq();
+  if(AUDIO_MicHandler->specific.cmd & MIC_CMD_SWITCHING)
+  {
+    BSP_AUDIO_IN_Record((uint16_t*)&AUDIO_MicHandler->specific.pdm_buff[0], AUDIO_MicHandler->specific.pdm_packet_size);
+    AUDIO_MicHandler->specific.cmd &= ~MIC_CMD_SWITCHING;
+  }
+  __set_PRIMASK(primask);
+}
+#endif /* USE_AUDIO_DEFERRED_PROCESSING */
+
 #if USE_AUDIO_RECORDING_USB_IMPLICIT_SYNCHRO
 /**
   * @brief  AUDIO_MicStartReadCount
@@ -20,6 +20,10 @@
 /* Includes ------------------------------------------------------------------*/
 #include "main.h"
 #include "usb_audio.h"
+#include "audio_scheduler.h"
+#include "audio_profiler.h"
+#include "audio_trace.h"
+#include "audio_speaker_node.h"
 /* Private typedef -----------------------------------------------------------*/
 /* Private define ------------------------------------------------------------*/
 /* Private macro -------------------------------------------------------------*/
@@ -54,6 +58,36 @@ int main(void)
   /* Configure the system clock to 168 MHz */
   SystemClock_Config();
   
+#if USE_AUDIO_SCHEDULER
+  /* Init the scheduler of the audio processing and codec control deferred from interrupts */
+  if(AUDIO_SchedulerInit() != 0)
+  {
+    Error_Handler();
+  }
+#endif /* USE_AUDIO_SCHEDULER */
+#if USE_AUDIO_PROFILER
+  /* Init the cycle profiler of the streaming callbacks */
+  if(AUDIO_ProfilerInit() != 0)
+  {
+    Error_Handler();
+  }
+#endif /* USE_AUDIO_PROFILER */
+#if USE_AUDIO_TRACE
+  /* Init the trace ring of the streaming nodes and sessions */
+  if(AUDIO_TraceInit() != 0)
+  {
+    Error_Handler();
+  }
+#endif /* USE_AUDIO_TRACE */
+#if USE_USB_AUDIO_PLAYBACK && USE_AUDIO_SPEAKER_EARLY_CODEC_INIT && !USE_AUDIO_SPEAKER_DUMMY
+  /* Power up the codec before the USB device is attached, the host doesn't wait for its
+     analog start-up when it selects the configuration */
+  if(AUDIO_SpeakerCodecPowerUp() != 0)
+  {
+    Error_Handler();
+  }
+#endif /* USE_USB_AUDIO_PLAYBACK && USE_AUDIO_SPEAKER_EARLY_CODEC_INIT && !USE_AUDIO_SPEAKER_DUMMY */
+  
   /* Init Device Library */
   USBD_Init(&USBD_Device, &AUDIO_Desc, 0);
 
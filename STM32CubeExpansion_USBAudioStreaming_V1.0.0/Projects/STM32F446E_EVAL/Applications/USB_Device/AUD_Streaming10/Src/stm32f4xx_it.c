@@ -21,6 +21,7 @@
 
 /* Includes ------------------------------------------------------------------*/
 #include "stm32f4xx_it.h"
+#include "audio_scheduler.h"
 
 /* Private typedef -----------------------------------------------------------*/
 /* Private define ------------------------------------------------------------*/
@@ -125,6 +126,9 @@ void DebugMon_Handler(void)
   */
 void PendSV_Handler(void)
 {
+#if USE_AUDIO_SCHEDULER
+  AUDIO_SchedulerRun();
+#endif /* USE_AUDIO_SCHEDULER */
 }
 
 /**
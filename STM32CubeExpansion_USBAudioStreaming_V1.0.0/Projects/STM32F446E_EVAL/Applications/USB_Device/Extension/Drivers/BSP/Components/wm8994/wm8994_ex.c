@@ -7,6 +7,11 @@
   *          modified functions : 
   *                                - wm8994_Init: 
   *                                - wm8994_Init_ext added  to support 24/16bit
+  *                                - CODEC_IO_Write skips the writes of an unchanged value
+  *                                  to the volume, mute, output and frequency registers
+  *                                - wm8994_HoldWrites/wm8994_FlushWrites coalesce the writes
+  *                                  of these registers, wm8994_UpdateBits modifies their bits
+  *                                  without I2C read
   *                                
   ******************************************************************************
   * @attention
@@ -53,6 +58,14 @@
 #if !defined (VERIFY_WRITTENDATA)  
 /*#define VERIFY_WRITTENDATA*/
 #endif /* VERIFY_WRITTENDATA */
+
+/* Registers written at run time (volume, mute, output mode and frequency), their last
+   written value is kept to skip the I2C write of an unchanged value */
+#define WM8994_SHADOW_REG_COUNT       16
+/* Software reset register, a write resets all the registers */
+#define WM8994_SW_RESET_ADDR          0x0000
+/* AIF1 DAC soft mute bit of the registers 0x420 and 0x422 */
+#define WM8994_AIF1_DAC_MUTE          0x0200
 /**
   * @}
   */ 
@@ -89,6 +102,30 @@ AUDIO_DrvTypeExtDef wm8994_drv=
 };
 static uint32_t outputEnabled = 0;
 static uint32_t inputEnabled = 0;
+static const uint16_t ShadowRegAddr[WM8994_SHADOW_REG_COUNT] =
+{
+  0x1C, 0x1D, 0x26, 0x27,       /* headphone and speaker volumes */
+  0x400, 0x401, 0x404, 0x405,   /* AIF1 ADC volumes */
+  0x420, 0x422,                 /* AIF1 DAC soft mutes */
+  0x05, 0x601, 0x602, 0x604, 0x605, /* DAC enables and mixer paths */
+  0x210                         /* AIF1 sample rate */
+};
+static uint16_t ShadowRegValue[WM8994_SHADOW_REG_COUNT];   /* value written to the codec */
+static uint16_t ShadowRegPending[WM8994_SHADOW_REG_COUNT]; /* value to write by wm8994_FlushWrites */
+/* AIF1 sample rate register (0x210) of each frequency, ratio=256, 48 KHz is set for a frequency missing in the table */
+static const uint32_t AIF1RateFreq[] =
+{
+  AUDIO_FREQUENCY_8K, AUDIO_FREQUENCY_11K, AUDIO_FREQUENCY_16K, AUDIO_FREQUENCY_22K,
+  AUDIO_FREQUENCY_32K, AUDIO_FREQUENCY_44K, AUDIO_FREQUENCY_48K, AUDIO_FREQUENCY_96K
+};
+static const uint16_t AIF1RateValue[] =
+{
+  0x0003, 0x0013, 0x0033, 0x0043,
+  0x0063, 0x0073, 0x0083, 0x00A3
+};
+static uint32_t ShadowRegValid = 0; /* bit i set when ShadowRegValue[i] is the register value */
+static uint32_t ShadowRegDirty = 0; /* bit i set when ShadowRegPending[i] is still to be written */
+static uint32_t ShadowWritesHeld = 0; /* set by wm8994_HoldWrites until wm8994_FlushWrites */
 /**
   * @}
   */ 
@@ -97,6 +134,10 @@ static uint32_t inputEnabled = 0;
   * @{
   */
 static uint8_t CODEC_IO_Write(uint8_t Addr, uint16_t Reg, uint16_t Value);
+static uint8_t CODEC_IO_Transfer(uint8_t Addr, uint32_t Index, uint16_t Reg, uint16_t Value);
+static uint32_t CODEC_IO_WritePending(uint8_t Addr);
+static uint32_t wm8994_FindShadowReg(uint16_t Reg);
+static uint16_t wm8994_GetAIF1Rate(uint32_t AudioFreq);
 
 /**
   * @}
@@ -398,53 +439,8 @@ uint32_t wm8994_Init(uint16_t DeviceAddr, uint16_t OutputInputDevice, uint8_t Vo
   }
   
   /*  Clock Configurations */
-  switch (AudioFreq)
-  {
-  case  AUDIO_FREQUENCY_8K:
-    /* AIF1 Sample Rate = 8 (KHz), ratio=256 */ 
-    counter += CODEC_IO_Write(DeviceAddr, 0x210, 0x0003);
-    break;
-    
-  case  AUDIO_FREQUENCY_16K:
-    /* AIF1 Sample Rate = 16 (KHz), ratio=256 */ 
-    counter += CODEC_IO_Write(DeviceAddr, 0x210, 0x0033);
-    break;
-
-  case  AUDIO_FREQUENCY_32K:
-    /* AIF1 Sample Rate = 32 (KHz), ratio=256 */ 
-    counter += CODEC_IO_Write(DeviceAddr, 0x210, 0x0063);
-    break;
-    
-  case  AUDIO_FREQUENCY_48K:
-    /* AIF1 Sample Rate = 48 (KHz), ratio=256 */ 
-    counter += CODEC_IO_Write(DeviceAddr, 0x210, 0x0083);
-    break;
-    
-  case  AUDIO_FREQUENCY_96K:
-    /* AIF1 Sample Rate = 96 (KHz), ratio=256 */ 
-    counter += CODEC_IO_Write(DeviceAddr, 0x210, 0x00A3);
-    break;
-    
-  case  AUDIO_FREQUENCY_11K:
-    /* AIF1 Sample Rate = 11.025 (KHz), ratio=256 */ 
-    counter += CODEC_IO_Write(DeviceAddr, 0x210, 0x0013);
-    break;
-    
-  case  AUDIO_FREQUENCY_22K:
-    /* AIF1 Sample Rate = 22.050 (KHz), ratio=256 */ 
-    counter += CODEC_IO_Write(DeviceAddr, 0x210, 0x0043);
-    break;
-    
-  case  AUDIO_FREQUENCY_44K:
-    /* AIF1 Sample Rate = 44.1 (KHz), ratio=256 */ 
-    counter += CODEC_IO_Write(DeviceAddr, 0x210, 0x0073);
-    break; 
-    
-  default:
-    /* AIF1 Sample Rate = 48 (KHz), ratio=256 */ 
-    counter += CODEC_IO_Write(DeviceAddr, 0x210, 0x0083);
-    break; 
-  }
+  /* AIF1 Sample Rate, ratio=256 */
+  counter += CODEC_IO_Write(DeviceAddr, 0x210, wm8994_GetAIF1Rate(AudioFreq));
 
   if(input_device == INPUT_DEVICE_DIGITAL_MIC1_MIC2)
   {
@@ -834,18 +830,18 @@ uint32_t wm8994_SetMute(uint16_t DeviceAddr, uint32_t Cmd)
     if(Cmd == AUDIO_MUTE_ON)
     {
       /* Soft Mute the AIF1 Timeslot 0 DAC1 path L&R */
-      counter += CODEC_IO_Write(DeviceAddr, 0x420, 0x0200);
+      counter += wm8994_UpdateBits(DeviceAddr, 0x420, WM8994_AIF1_DAC_MUTE, WM8994_AIF1_DAC_MUTE);
 
       /* Soft Mute the AIF1 Timeslot 1 DAC2 path L&R */
-      counter += CODEC_IO_Write(DeviceAddr, 0x422, 0x0200);
+      counter += wm8994_UpdateBits(DeviceAddr, 0x422, WM8994_AIF1_DAC_MUTE, WM8994_AIF1_DAC_MUTE);
     }
     else /* AUDIO_MUTE_OFF Disable the Mute */
     {
       /* Unmute the AIF1 Timeslot 0 DAC1 path L&R */
-      counter += CODEC_IO_Write(DeviceAddr, 0x420, 0x0000);
+      counter += wm8994_UpdateBits(DeviceAddr, 0x420, WM8994_AIF1_DAC_MUTE, 0x0000);
 
       /* Unmute the AIF1 Timeslot 1 DAC2 path L&R */
-      counter += CODEC_IO_Write(DeviceAddr, 0x422, 0x0000);
+      counter += wm8994_UpdateBits(DeviceAddr, 0x422, WM8994_AIF1_DAC_MUTE, 0x0000);
     }
   }
   return counter;
@@ -951,48 +947,8 @@ uint32_t wm8994_SetFrequency(uint16_t DeviceAddr, uint32_t AudioFreq)
   uint32_t counter = 0;
  
   /*  Clock Configurations */
-  switch (AudioFreq)
-  {
-  case  AUDIO_FREQUENCY_8K:
-    /* AIF1 Sample Rate = 8 (KHz), ratio=256 */ 
-    counter += CODEC_IO_Write(DeviceAddr, 0x210, 0x0003);
-    break;
-    
-  case  AUDIO_FREQUENCY_16K:
-    /* AIF1 Sample Rate = 16 (KHz), ratio=256 */ 
-    counter += CODEC_IO_Write(DeviceAddr, 0x210, 0x0033);
-    break;
-    
-  case  AUDIO_FREQUENCY_48K:
-    /* AIF1 Sample Rate = 48 (KHz), ratio=256 */ 
-    counter += CODEC_IO_Write(DeviceAddr, 0x210, 0x0083);
-    break;
-    
-  case  AUDIO_FREQUENCY_96K:
-    /* AIF1 Sample Rate = 96 (KHz), ratio=256 */ 
-    counter += CODEC_IO_Write(DeviceAddr, 0x210, 0x00A3);
-    break;
-    
-  case  AUDIO_FREQUENCY_11K:
-    /* AIF1 Sample Rate = 11.025 (KHz), ratio=256 */ 
-    counter += CODEC_IO_Write(DeviceAddr, 0x210, 0x0013);
-    break;
-    
-  case  AUDIO_FREQUENCY_22K:
-    /* AIF1 Sample Rate = 22.050 (KHz), ratio=256 */ 
-    counter += CODEC_IO_Write(DeviceAddr, 0x210, 0x0043);
-    break;
-    
-  case  AUDIO_FREQUENCY_44K:
-    /* AIF1 Sample Rate = 44.1 (KHz), ratio=256 */ 
-    counter += CODEC_IO_Write(DeviceAddr, 0x210, 0x0073);
-    break; 
-    
-  default:
-    /* AIF1 Sample Rate = 48 (KHz), ratio=256 */ 
-    counter += CODEC_IO_Write(DeviceAddr, 0x210, 0x0083);
-    break; 
-  }
+  /* AIF1 Sample Rate, ratio=256 */
+  counter += CODEC_IO_Write(DeviceAddr, 0x210, wm8994_GetAIF1Rate(AudioFreq));
   return counter;
 }
 
@@ -1014,26 +970,199 @@ uint32_t wm8994_Reset(uint16_t DeviceAddr)
 }
 
 /**
-  * @brief  Writes/Read a single data.
+  * @brief Holds the writes of the shadowed registers (volumes, mutes, output and
+  *         frequency) until wm8994_FlushWrites : only the last value written to
+  *         a register is transferred, a volume and a mute change cost one I2C
+  *         transfer by register. The writes of the other registers are not held.
+  * @retval None
+  */
+void wm8994_HoldWrites(void)
+{
+  ShadowWritesHeld = 1;
+}
+
+/**
+  * @brief Writes the registers changed since wm8994_HoldWrites, in the order of
+  *         the shadow table, and stops holding the writes.
+  * @param DeviceAddr: Device address on communication Bus.
+  * @retval 0 if correct communication, else wrong communication
+  */
+uint32_t wm8994_FlushWrites(uint16_t DeviceAddr)
+{
+  ShadowWritesHeld = 0;
+  return CODEC_IO_WritePending(DeviceAddr);
+}
+
+/**
+  * @brief Read-modify-write of register bits, the value of a shadowed register
+  *         is taken from the cache without I2C read.
+  * @param DeviceAddr: Device address on communication Bus.
+  * @param Reg: Reg address
+  * @param Mask: bits to modify
+  * @param Value: new value of the bits
+  * @retval 0 if correct communication, else wrong communication
+  */
+uint32_t wm8994_UpdateBits(uint16_t DeviceAddr, uint16_t Reg, uint16_t Mask, uint16_t Value)
+{
+  uint32_t index = wm8994_FindShadowReg(Reg);
+  uint16_t current;
+
+  if((index < WM8994_SHADOW_REG_COUNT) && (ShadowRegDirty & (1U << index)))
+  {
+    current = ShadowRegPending[index];
+  }
+  else if((index < WM8994_SHADOW_REG_COUNT) && (ShadowRegValid & (1U << index)))
+  {
+    current = ShadowRegValue[index];
+  }
+  else
+  {
+    current = AUDIO_IO_Read(DeviceAddr, Reg);
+  }
+  return CODEC_IO_Write(DeviceAddr, Reg, (current & ~Mask) | (Value & Mask));
+}
+
+/**
+  * @brief  Looks up the shadow cache entry of a register.
+  * @param  Reg: Reg address
+  * @retval index of the entry, WM8994_SHADOW_REG_COUNT if the register is not shadowed
+  */
+static uint32_t wm8994_FindShadowReg(uint16_t Reg)
+{
+  uint32_t index;
+
+  for(index = 0; index < WM8994_SHADOW_REG_COUNT; index++)
+  {
+    if(ShadowRegAddr[index] == Reg)
+    {
+      break;
+    }
+  }
+  return index;
+}
+
+/**
+  * @brief  Looks up the AIF1 sample rate register value of a frequency.
+  * @param  AudioFreq: Audio frequency
+  * @retval value of register 0x210
+  */
+static uint16_t wm8994_GetAIF1Rate(uint32_t AudioFreq)
+{
+  uint32_t index;
+  
+  for(index = 0; index < sizeof(AIF1RateFreq) / sizeof(AIF1RateFreq[0]); index++)
+  {
+    if(AIF1RateFreq[index] == AudioFreq)
+    {
+      return AIF1RateValue[index];
+    }
+  }
+  return 0x0083;
+}
+
+/**
+  * @brief  Writes a single data, the write is skipped if the register is known to hold the value
+  *         and held until wm8994_FlushWrites for a shadowed register while wm8994_HoldWrites is active.
   * @param  Addr: I2C address
   * @param  Reg: Reg address 
   * @param  Value: Data to be written
-  * @retval None
+  * @retval 0 if correct communication, else wrong communication
   */
 static uint8_t CODEC_IO_Write(uint8_t Addr, uint16_t Reg, uint16_t Value)
 {
-  uint32_t result = 0;
+  uint32_t index = wm8994_FindShadowReg(Reg);
   
- AUDIO_IO_Write(Addr, Reg, Value);
+  if(index < WM8994_SHADOW_REG_COUNT)
+  {
+    if((ShadowRegValid & (1U << index)) && (ShadowRegValue[index] == Value))
+    {
+      /* value unchanged, no I2C transfer, a pending write of another value is dropped */
+      ShadowRegDirty &= ~(1U << index);
+      return 0;
+    }
+    if(ShadowWritesHeld != 0)
+    {
+      /* written by wm8994_FlushWrites, the last value replaces the pending one */
+      ShadowRegPending[index] = Value;
+      ShadowRegDirty |= (1U << index);
+      return 0;
+    }
+    return CODEC_IO_Transfer(Addr, index, Reg, Value);
+  }
+  
+  /* the held writes go first to keep the order of the sequence */
+  if(CODEC_IO_WritePending(Addr) != 0)
+  {
+    return 1;
+  }
+  return CODEC_IO_Transfer(Addr, index, Reg, Value);
+}
+
+/**
+  * @brief  Writes a single data on the bus and updates the shadow cache : the entry of the register is
+  *         valid only if the bus reports the write done, its value is unknown after a bus error.
+  * @param  Addr: I2C address
+  * @param  Index: shadow cache entry of the register, WM8994_SHADOW_REG_COUNT if the register is not shadowed
+  * @param  Reg: Reg address 
+  * @param  Value: Data to be written
+  * @retval 0 if correct communication, else wrong communication
+  */
+static uint8_t CODEC_IO_Transfer(uint8_t Addr, uint32_t Index, uint16_t Reg, uint16_t Value)
+{
+  uint8_t result;
+  
+  result = AUDIO_IO_Write(Addr, Reg, Value);
   
 #ifdef VERIFY_WRITTENDATA
   /* Verify that the data has been correctly written */
-  result = (AUDIO_IO_Read(Addr, Reg) == Value)? 0:1;
+  if(result == 0)
+  {
+    result = (AUDIO_IO_Read(Addr, Reg) == Value)? 0:1;
+  }
 #endif /* VERIFY_WRITTENDATA */
   
+  if(Index < WM8994_SHADOW_REG_COUNT)
+  {
+    ShadowRegDirty &= ~(1U << Index);
+    if(result == 0)
+    {
+      ShadowRegValue[Index] = Value;
+      ShadowRegValid |= (1U << Index);
+    }
+    else
+    {
+      ShadowRegValid &= ~(1U << Index);
+    }
+  }
+  else if(Reg == WM8994_SW_RESET_ADDR)
+  {
+    /* registers are back to their default value, or unknown if the reset failed */
+    ShadowRegValid = 0;
+  }
+  
   return result;
 }
 
+/**
+  * @brief  Writes the held values of the shadowed registers.
+  * @param  Addr: I2C address
+  * @retval 0 if correct communication, else wrong communication
+  */
+static uint32_t CODEC_IO_WritePending(uint8_t Addr)
+{
+  uint32_t counter = 0;
+  uint32_t index;
+  
+  for(index = 0; (index < WM8994_SHADOW_REG_COUNT) && (ShadowRegDirty != 0); index++)
+  {
+    if(ShadowRegDirty & (1U << index))
+    {
+      counter += CODEC_IO_Transfer(Addr, index, ShadowRegAddr[index], ShadowRegPending[index]);
+    }
+  }
+  return counter;
+}
+
 /**
   * @}
   */
@@ -154,11 +154,14 @@ uint32_t wm8994_SetOutputMode(uint16_t DeviceAddr, uint8_t Output);
 uint32_t wm8994_SetFrequency(uint16_t DeviceAddr, uint32_t AudioFreq);
 uint32_t wm8994_Reset(uint16_t DeviceAddr);
 uint32_t wm8994_InitExt(uint16_t DeviceAddr, uint16_t OutputInputDevice, uint8_t Volume, uint32_t AudioFreq, uint8_t AudioRes);
+void     wm8994_HoldWrites(void);
+uint32_t wm8994_FlushWrites(uint16_t DeviceAddr);
+uint32_t wm8994_UpdateBits(uint16_t DeviceAddr, uint16_t Reg, uint16_t Mask, uint16_t Value);
 /* AUDIO IO functions */
 void    AUDIO_IO_Init(void);
 void    AUDIO_IO_DeInit(void);
-void    AUDIO_IO_Write(uint8_t Addr, uint16_t Reg, uint16_t Value);
-uint8_t AUDIO_IO_Read(uint8_t Addr, uint16_t Reg);
+uint8_t  AUDIO_IO_Write(uint8_t Addr, uint16_t Reg, uint16_t Value);
+uint16_t AUDIO_IO_Read(uint8_t Addr, uint16_t Reg);
 void    AUDIO_IO_Delay(uint32_t Delay);
 
 /* Audio driver structure */
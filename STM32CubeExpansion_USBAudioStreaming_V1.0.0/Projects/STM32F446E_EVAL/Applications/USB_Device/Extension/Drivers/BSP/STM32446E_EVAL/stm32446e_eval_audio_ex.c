@@ -69,6 +69,8 @@ How To use this driver:
       the device output mode the mute or the stop, use the functions: BSP_AUDIO_OUT_SetVolume(), 
       AUDIO_OUT_SetFrequency(), BSP_AUDIO_OUT_SetAudioFrameSlot(), BSP_AUDIO_OUT_SetOutputMode(),
       BSP_AUDIO_OUT_SetMute() and BSP_AUDIO_OUT_Stop().
+   + To apply several volume and mute changes with one I2C transfer by codec register, call them
+      between BSP_AUDIO_OUT_HoldCodecWrites() and BSP_AUDIO_OUT_FlushCodecWrites().
    + The driver API and the callback functions are at the end of the stm32446e_eval_audio_ex.h file.
  
 
@@ -116,6 +118,11 @@ Known Limitations:
 /** @defgroup STM32446E_EVAL_AUDIO_Private_Defines STM32446E EVAL AUDIO Private Defines
   * @{
   */
+/* frequency families of the audio PLLs, a PLL is reprogrammed only when the family changes,
+   the audio peripheral divider selects the frequency within the family */
+#define AUDIO_CLOCK_FAMILY_NONE        0U
+#define AUDIO_CLOCK_FAMILY_11K         1U /* 11.025, 22.05, 44.1 KHz */
+#define AUDIO_CLOCK_FAMILY_8K          2U /* 8, 16, 32, 48, 96, 192 KHz */
 /**
   * @}
   */ 
@@ -123,6 +130,9 @@ Known Limitations:
 /** @defgroup STM32446E_EVAL_AUDIO_Private_Macros STM32446E EVAL AUDIO Private Macros 
   * @{
   */
+#define AUDIO_CLOCK_FAMILY(__FREQUENCY__) \
+        ((((__FREQUENCY__) == AUDIO_FREQUENCY_11K) || ((__FREQUENCY__) == AUDIO_FREQUENCY_22K) || \
+          ((__FREQUENCY__) == AUDIO_FREQUENCY_44K)) ? AUDIO_CLOCK_FAMILY_11K : AUDIO_CLOCK_FAMILY_8K)
 /**
   * @}
   */ 
@@ -170,6 +180,12 @@ uint32_t __IO AudioOutFreq = 48000;
 uint8_t __IO AudioOutResBit = 16; 
 uint8_t __IO AudioOutResByte = 2;
 uint16_t __IO AudioInVolume = DEFAULT_AUDIO_IN_VOLUME;
+/* Families the PLLSAI (SAI2, play) and PLLI2S (I2S2, record) are locked on */
+static uint8_t AudioOutClockFamily = AUDIO_CLOCK_FAMILY_NONE;
+static uint8_t AudioInClockFamily  = AUDIO_CLOCK_FAMILY_NONE;
+/* Output device and resolution the codec registers are initialized for, 0 when the codec must be initialized */
+static uint16_t AudioOutCodecDevice = 0;
+static uint8_t AudioOutCodecResBit = 0;
     
 /**
   * @}
@@ -232,7 +248,20 @@ uint8_t BSP_AUDIO_OUT_Init_Ext(uint16_t OutputDevice, uint8_t Volume, uint32_t A
     BSP_AUDIO_OUT_MspInit(&haudio_out_sai, (void*)(&AudioResolution));
   }
   SAIx_Init_Ext(AudioFreq,AudioResolution);
-  
+
+  if((AudioOutCodecDevice == OutputDevice) && (AudioOutCodecResBit == AudioResolution))
+  {
+    /* The codec kept its registers since the last init (stopped with CODEC_PDWN_SW), skip
+       its analog start-up which lasts about 300 ms, only its frequency and volume change */
+    if((audio_drv->SetFrequency(AUDIO_I2C_ADDRESS, AudioFreq) != 0) ||
+       (audio_drv->SetVolume(AUDIO_I2C_ADDRESS, Volume) != 0))
+    {
+      AudioOutCodecDevice = 0;
+      return AUDIO_ERROR;
+    }
+    return AUDIO_OK;
+  }
+
   /* wm8994 codec initialization */
   deviceid = wm8994_drv.ReadID(AUDIO_I2C_ADDRESS);
   
@@ -252,7 +281,11 @@ uint8_t BSP_AUDIO_OUT_Init_Ext(uint16_t OutputDevice, uint8_t Volume, uint32_t A
     /* Resets the audio codec. */
     audio_drv->Reset(AUDIO_I2C_ADDRESS);
     /* Initialize the codec internal registers */
-    audio_drv->Init(AUDIO_I2C_ADDRESS, OutputDevice, Volume, AudioFreq,AudioOutResBit);
+    if(audio_drv->Init(AUDIO_I2C_ADDRESS, OutputDevice, Volume, AudioFreq,AudioOutResBit) == 0)
+    {
+      AudioOutCodecDevice = OutputDevice;
+      AudioOutCodecResBit = AudioResolution;
+    }
   }
  
   return ret;
@@ -289,6 +322,20 @@ void BSP_AUDIO_OUT_ChangeBuffer(uint16_t *pData, uint16_t Size)
    HAL_SAI_Transmit_DMA(&haudio_out_sai, (uint8_t*) pData, DMA_MAX(Size / AudioOutResByte));
 }
 
+/**
+  * @brief  Selects the SAI DMA mode of the next BSP_AUDIO_OUT_Play(). In circular mode the DMA loops over
+  *         the played buffer, the application refills each half on half and full transfer callbacks and
+  *         does not call BSP_AUDIO_OUT_ChangeBuffer(). In normal mode each transfer must be rearmed by
+  *         BSP_AUDIO_OUT_ChangeBuffer() in the transfer complete callback.
+  * @param  Circular: 1 for circular mode, 0 for normal mode
+  * @note   This API should be called after BSP_AUDIO_OUT_Init_Ext(), while the DMA is stopped.
+  */
+void BSP_AUDIO_OUT_SetDMACircular(uint8_t Circular)
+{
+  haudio_out_sai.hdmatx->Init.Mode = (Circular)? DMA_CIRCULAR : DMA_NORMAL;
+  HAL_DMA_Init(haudio_out_sai.hdmatx);
+}
+
 /**
   * @brief  This function Pauses the audio file stream. In case
   *         of using DMA, the DMA Pause feature is used.
@@ -361,6 +408,8 @@ uint8_t BSP_AUDIO_OUT_Stop(uint32_t Option)
   {
     if(Option == CODEC_PDWN_HW)
     { 
+      /* The codec is reset, next BSP_AUDIO_OUT_Init_Ext initializes it again */
+      AudioOutCodecDevice = 0;
       /* Wait at least 100us */
       HAL_Delay(1);
     }
@@ -409,6 +458,34 @@ uint8_t BSP_AUDIO_OUT_SetMute(uint32_t Cmd)
   }
 }
 
+/**
+  * @brief  Holds the writes of the codec volume, mute, output and frequency registers
+  *         until BSP_AUDIO_OUT_FlushCodecWrites, only the last value of each register
+  *         is then written.
+  * @retval None
+  */
+void BSP_AUDIO_OUT_HoldCodecWrites(void)
+{
+  wm8994_HoldWrites();
+}
+
+/**
+  * @brief  Writes the codec registers changed since BSP_AUDIO_OUT_HoldCodecWrites.
+  * @retval AUDIO_OK if correct communication, else wrong communication
+  */
+uint8_t BSP_AUDIO_OUT_FlushCodecWrites(void)
+{
+  if(wm8994_FlushWrites(AUDIO_I2C_ADDRESS) != 0)
+  {
+    return AUDIO_ERROR;
+  }
+  else
+  {
+    /* Return AUDIO_OK when all operations are correctly done */
+    return AUDIO_OK;
+  }
+}
+
 /**
   * @brief  Switch dynamically (while audio file is played) the output target 
   *         (speaker or headphone).
@@ -485,6 +562,8 @@ void BSP_AUDIO_OUT_DeInit(void)
   SAIx_DeInit();
   /* DeInit the SAI MSP : this __weak function can be rewritten by the applic */
   BSP_AUDIO_OUT_MspDeInit(&haudio_out_sai, NULL);
+  /* the PLL may be set by the application meanwhile, it is locked again on next init */
+  AudioOutClockFamily = AUDIO_CLOCK_FAMILY_NONE;
 }
 
 /**
@@ -671,6 +750,12 @@ __weak void BSP_AUDIO_OUT_ClockConfig(SAI_HandleTypeDef *hsai, uint32_t AudioFre
 { 
   RCC_PeriphCLKInitTypeDef rcc_ex_clk_init_struct;
 
+  /* PLL already locked on the family, the SAI divider is computed by HAL_SAI_Init() */
+  if(AUDIO_CLOCK_FAMILY(AudioFreq) == AudioOutClockFamily)
+  {
+    return;
+  }
+  AudioOutClockFamily = AUDIO_CLOCK_FAMILY(AudioFreq);
   HAL_RCCEx_GetPeriphCLKConfig(&rcc_ex_clk_init_struct);
   
   /* Set the PLL configuration according to the audio frequency */
@@ -917,6 +1002,8 @@ void BSP_AUDIO_IN_DeInit(void)
     /* DeInit the I2S MSP : this __weak function can be rewritten by the applic */
   BSP_AUDIO_IN_MspDeInit(&haudio_in_i2s, NULL);
   TIM_VolumeChangeDeInit();
+  /* the PLL may be set by the application meanwhile, it is locked again on next init */
+  AudioInClockFamily = AUDIO_CLOCK_FAMILY_NONE;
 }
 
 /**
@@ -1123,6 +1210,12 @@ __weak void BSP_AUDIO_IN_ClockConfig(uint32_t AudioFreq, void *Params)
   /** @TODO check deviders value */
   RCC_PeriphCLKInitTypeDef rcc_ex_clk_init_struct;
 
+  /* PLL already locked on the family, the I2S divider is computed by HAL_I2S_Init() */
+  if(AUDIO_CLOCK_FAMILY(AudioFreq) == AudioInClockFamily)
+  {
+    return;
+  }
+  AudioInClockFamily = AUDIO_CLOCK_FAMILY(AudioFreq);
   HAL_RCCEx_GetPeriphCLKConfig(&rcc_ex_clk_init_struct);
   
   rcc_ex_clk_init_struct.PeriphClockSelection = RCC_PERIPHCLK_I2S_APB1;
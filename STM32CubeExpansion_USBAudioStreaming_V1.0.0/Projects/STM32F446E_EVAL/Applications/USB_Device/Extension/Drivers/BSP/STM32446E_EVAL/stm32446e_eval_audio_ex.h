@@ -247,6 +247,7 @@ extern __IO uint16_t AudioInVolume;
 uint8_t BSP_AUDIO_OUT_Init_Ext(uint16_t OutputDevice, uint8_t Volume, uint32_t AudioFreq, uint8_t AudioResolution);
 uint8_t BSP_AUDIO_OUT_Play(uint16_t* pBuffer, uint32_t Size);
 void    BSP_AUDIO_OUT_ChangeBuffer(uint16_t *pData, uint16_t Size);
+void    BSP_AUDIO_OUT_SetDMACircular(uint8_t Circular);
 uint8_t BSP_AUDIO_OUT_Pause(void);
 uint8_t BSP_AUDIO_OUT_Resume(void);
 uint8_t BSP_AUDIO_OUT_Stop(uint32_t Option);
@@ -254,6 +255,8 @@ uint8_t BSP_AUDIO_OUT_SetVolume(uint8_t Volume);
 void    BSP_AUDIO_OUT_SetFrequency(uint32_t AudioFreq);
 void    BSP_AUDIO_OUT_SetAudioFrameSlot(uint32_t AudioFrameSlot);
 uint8_t BSP_AUDIO_OUT_SetMute(uint32_t Cmd);
+void    BSP_AUDIO_OUT_HoldCodecWrites(void);
+uint8_t BSP_AUDIO_OUT_FlushCodecWrites(void);
 uint8_t BSP_AUDIO_OUT_SetOutputMode(uint8_t Output);
 void    BSP_AUDIO_OUT_DeInit(void);
 
@@ -34,18 +34,29 @@
 #define AUDIO_MAX_SAMPLE_COUNT_LENGTH(frq) (((frq) + 999)/1000)
 #define AUDIO_SAMPLE_COUNT_LENGTH(frq) ((uint32_t)(((uint32_t)(frq))/1000))
 #define AUDIO_PACKET_SAMPLES_COUNT(frq) ((frq)/1000)
+#if USE_AUDIO_RECORDING_BEAMFORMER
+/* the four microphones are captured, the beamformer node reduces them to the USB channels */
+#define AUDIO_MIC_CAPTURE_CHANNEL_COUNT    4
+#else /* USE_AUDIO_RECORDING_BEAMFORMER */
+#define AUDIO_MIC_CAPTURE_CHANNEL_COUNT    USB_AUDIO_CONFIG_RECORD_CHANNEL_COUNT
+#endif /* USE_AUDIO_RECORDING_BEAMFORMER */
 #endif /* USE_AUDIO_DFSDM_MEMS_MIC */
 /* Exported types ------------------------------------------------------------*/
 #if  USE_USB_AUDIO_RECORDING
 #if USE_AUDIO_DFSDM_MEMS_MIC
 typedef struct
 {
-  int32_t scratch[(AUDIO_SAMPLE_COUNT_LENGTH(USB_AUDIO_CONFIG_RECORD_FREQ_MAX))<<2];
+  int32_t scratch[(AUDIO_BLOCK_SAMPLES_COUNT(USB_AUDIO_CONFIG_RECORD_FREQ_MAX, USB_AUDIO_CONFIG_RECORD_BLOCK_US_MAX) << 1) *
+                  AUDIO_MIC_CAPTURE_CHANNEL_COUNT]; /* 2 blocks of each channel */
+#if USE_AUDIO_RECORDING_BEAMFORMER
+  int32_t capture[AUDIO_BLOCK_SAMPLES_COUNT(USB_AUDIO_CONFIG_RECORD_FREQ_MAX, USB_AUDIO_CONFIG_RECORD_BLOCK_US_MAX) *
+                  AUDIO_MIC_CAPTURE_CHANNEL_COUNT]; /* block of the array, processed before its beams are sent */
+#endif /* USE_AUDIO_RECORDING_BEAMFORMER */
   uint16_t writing_step;
   uint16_t packet_sample_count;
   uint8_t packet_sample_size;
   uint8_t pcm_used; /* begin of play */
-  uint8_t cmd; /* cmd to execute in interruption routine */
+  __IO uint8_t cmd; /* cmd to execute in interruption routine or in the switch task */
 #if USE_AUDIO_RECORDING_USB_IMPLICIT_SYNCHRO
   uint16_t dma_remaining; /* The number of remaining bytes in the current DMA Stream transfer*/
 #endif /* USE_AUDIO_RECORDING_USB_IMPLICIT_SYNCHRO*/
@@ -64,11 +75,17 @@ typedef struct
   uint8_t                double_buff;            /* when the padding is needed the double buffering are required. It means that the alt_buff will contain two packet*/
   uint8_t                offset ;                /* a binary flag. used to indicate if next packet is in the first half of alternate buffer or in the second half*/
   __IO uint8_t           cmd;                    /* this field contains commands to execute within next transfer complete call(or in next Volume change interrupt) */
-  uint16_t               dma_remaining;  /* used for synchronization, it helps to provide the counter of played samples */
+  __IO uint32_t          played_size;    /* size of the completed DMA transfers, in SAI data units */
+  uint32_t               read_position;  /* used for synchronization, played position at the last read count */
 } AUDIO_SpeakerSpecificParms_t;
 #endif /* USE_USB_AUDIO_PLAYBACK */
 /* Exported macros -----------------------------------------------------------*/
 /* Exported functions ------------------------------------------------------- */
+#if USE_USB_AUDIO_PLAYBACK
+#if USE_AUDIO_SPEAKER_EARLY_CODEC_INIT
+int8_t  AUDIO_SpeakerCodecPowerUp(void);
+#endif /* USE_AUDIO_SPEAKER_EARLY_CODEC_INIT */
+#endif /* USE_USB_AUDIO_PLAYBACK */
 #ifdef __cplusplus
 }
 #endif
@@ -56,6 +56,8 @@ void OTG_HS_IRQHandler(void);
 #endif
 void AUDIO_DFSDMx_DMAx_TOP_LEFT_IRQHandler(void);
 void AUDIO_DFSDMx_DMAx_TOP_RIGHT_IRQHandler(void);
+void AUDIO_DFSDMx_DMAx_BUTTOM_LEFT_IRQHandler(void);
+void AUDIO_DFSDMx_DMAx_BUTTOM_RIGHT_IRQHandler(void);
 void AUDIO_OUT_SAIx_DMAx_IRQHandler(void);
 #ifdef __cplusplus
 }
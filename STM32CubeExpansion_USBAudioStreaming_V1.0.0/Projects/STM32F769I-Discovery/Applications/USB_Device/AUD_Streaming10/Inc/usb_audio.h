@@ -34,9 +34,9 @@
 /* definition of the USB IRQ priority and the USB FIFO size in word */
 #define USB_IRQ_PREPRIO 3U
 #ifdef USE_USB_FS
-#define USB_FIFO_WORD_SIZE  320U
+#define USB_FIFO_WORD_SIZE  320U  /* 1.25 Kbytes */
 #else  /*  USE_USB_FS */
-#define USB_FIFO_WORD_SIZE  1024U
+#define USB_FIFO_WORD_SIZE  1024U /* 4 Kbytes */
 #endif  /*  USE_USB_FS */
 
    
@@ -147,6 +147,12 @@
 #define USE_AUDIO_USB_RECORD_MULTI_FREQUENCIES 1
 #endif 
 #endif /* USE_USB_AUDIO_RECORDING*/
+
+#if USE_AUDIO_SIDETONE
+/* sidetone : feature unit of the microphone monitor level and mixer unit feeding the speaker terminal */
+#define USB_AUDIO_CONFIG_SIDETONE_UNIT_FEATURE_ID     0x17
+#define USB_AUDIO_CONFIG_PLAY_UNIT_MIXER_ID           0x18
+#endif /* USE_AUDIO_SIDETONE */
    
 /* defining the max packet length*/
 #if USE_USB_AUDIO_PLAYBACK
@@ -31,6 +31,26 @@
 /* configure project */
 /* define which class is used USE_USB_AUDIO_CLASS_10 : must be defined, future release will supports USE_USB_AUDIO_CLASS_20 */
 #define  USE_USB_AUDIO_CLASS_10 1
+/* USB OTG internal DMA : 1 to use , 0 to not use. only the HS core embeds it, the streaming nodes then hand
+   word aligned buffers to the USB and the D-cache, if enabled, is maintained around each transfer */
+#define USE_USB_AUDIO_DMA 0
+/* deferred processing : 1 to run audio conversion and synchronization computation in PendSV handler,
+   audio DMA and USB interrupts only post the work. 0 to run it inside the interrupt handlers. The codec
+   volume and mute writes always run in PendSV, unless USE_AUDIO_TIMER_VOLUME_CTRL is set */
+#define USE_AUDIO_DEFERRED_PROCESSING 1
+/* profiler : 1 to measure with the DWT cycle counter the duration of USB, audio DMA and session callbacks,
+   0 to remove the measure code */
+#define USE_AUDIO_PROFILER 0
+/* trace : 1 to record nodes and sessions events to the AUDIO_TraceRing binary ring, which can be decoded from a
+   memory dump, 0 to remove the trace code */
+#define USE_AUDIO_TRACE 0
+/* processing graph : 1 to let sessions apply a chain of processing nodes on each block before it is consumed by
+   the speaker or sent to the host, 0 to remove the graph code */
+#define USE_AUDIO_PROCESSING_GRAPH 0
+/* software volume : 1 to apply the feature unit volume and mute with a gain node of the session graph, the gain
+   ramps over a block at each change and the codec stays at its default volume. Requires USE_AUDIO_PROCESSING_GRAPH.
+   0 to apply the volume and mute with the codec or microphone controls */
+#define USE_AUDIO_SOFTWARE_VOLUME 0
 /* for playback project define USE_USB_AUDIO_RECORDING,  for recording project define USE_USB_AUDIO_RECORDING and for si
   * for simultaneous playback and recording define both flags  USE_USB_AUDIO_RECORDING and USE_USB_AUDIO_RECORDING */
 #if USE_USB_AUDIO_PLAYBACK
@@ -54,11 +74,51 @@
 
 #define USE_AUDIO_TIMER_VOLUME_CTRL  0   
 #define  USB_AUDIO_CONFIG_PLAY_BUFFER_SIZE (1024 * 10)   
+/* speaker block period in microseconds, independent of the USB frame. Short blocks (125 to 500) lower the latency,
+   long blocks (2000 to 4000) lower the interrupt rate. It is the period at start-up, AUDIO_PlaybackSessionSetBlockPeriod
+   changes it up to _MAX while the host doesn't stream. _MAX sizes the speaker buffers, USB_AUDIO_CONFIG_PLAY_BUFFER_SIZE
+   must hold 3 blocks of _MAX at the max frequency */
+#define USB_AUDIO_CONFIG_PLAY_BLOCK_US               1000
+#define USB_AUDIO_CONFIG_PLAY_BLOCK_US_MAX           1000
+/* speaker DMA : 1 to loop the SAI DMA over two blocks, the idle block is refilled on half and full transfer
+   events, so the refill deadline is a block period. 0 to rearm the SAI DMA on each transfer complete event,
+   before the SAI FIFO drains */
+#define USE_AUDIO_SPEAKER_CIRCULAR_DMA               0
+/* codec early init : 1 to power up the codec after reset, before the USB device is attached, so the
+   configuration request from the host only sets the codec frequency. 0 to power up the codec when the host
+   selects the configuration, the request then lasts the codec analog start-up (about 300 ms) */
+#define USE_AUDIO_SPEAKER_EARLY_CODEC_INIT           1
+/* equalizer : 1 to run a parametric equalizer (audio_eq_node.h) on the played blocks, after the software volume.
+   Requires USE_AUDIO_PROCESSING_GRAPH. USB_AUDIO_CONFIG_PLAY_EQ_BANDS lists the bands applied to both channels
+   at start-up, up to AUDIO_EQ_MAX_BANDS. Form AUDIO_EQ_DF1 is the one to use when bands change while playing */
+#define USE_AUDIO_PLAYBACK_EQ                        0
+#if USE_AUDIO_PLAYBACK_EQ
+#define USB_AUDIO_CONFIG_PLAY_EQ_FORM                AUDIO_EQ_DF1
+#define USB_AUDIO_CONFIG_PLAY_EQ_BANDS               { {AUDIO_EQ_BAND_HIGH_PASS, 40, 0.707f, 0}, \
+                                                       {AUDIO_EQ_BAND_PEAK, 3000, 1.4f, -3 * 256} }
+#endif /* USE_AUDIO_PLAYBACK_EQ */
+/* limiter : 1 to run a look-ahead peak limiter (audio_limiter_node.h) at the end of the playback graph, so a hot
+   stream or boosted equalizer bands don't clip in the codec. Requires USE_AUDIO_PROCESSING_GRAPH. The look-ahead
+   (0 to 2000 us) delays the stream, it is added to the bDelay of the playback AS interface */
+#define USE_AUDIO_PLAYBACK_LIMITER                   0
+#if USE_AUDIO_PLAYBACK_LIMITER
+#define USB_AUDIO_CONFIG_PLAY_LIMITER_CEILING_DB_256 (-1 * 256) /* -1 db */
+#define USB_AUDIO_CONFIG_PLAY_LIMITER_LOOKAHEAD_US   1000
+#define USB_AUDIO_CONFIG_PLAY_LIMITER_RELEASE_MS     50
+#endif /* USE_AUDIO_PLAYBACK_LIMITER */
+/* mixer : 1 to mix local streams (audio_mixer_node.h) with the USB playback stream, before the software volume.
+   Each stream has its own ring, volume and pan, and is added with AUDIO_PlaybackSessionAddMixerInput. Streams
+   must have the playback rate and sample format. The device has one playback streaming interface, the mixer
+   inputs are sources of the device such as the sidetone, not other USB streams. Requires
+   USE_AUDIO_PROCESSING_GRAPH */
+#define USE_AUDIO_PLAYBACK_MIXER                     0
 #endif /* USE_USB_AUDIO_PLAYBACK*/
  
 #if USE_USB_AUDIO_RECORDING   
 /* definition of channel count and space mapping of channels */
-/* ! Please dont change channel count , other value than 0x02 aren't supported  @TODO add support of multichannel*/
+/* 0x02 captures the top left and right microphones. 0x04 captures the four microphones in the order top left,
+   top right, bottom left, bottom right, with the map 0x33 (left, right, left surround, right surround). Four
+   channels of 24 bit at 96 KHz exceed the full speed isochronous packet */
 #define USB_AUDIO_CONFIG_RECORD_CHANNEL_COUNT          0x02 /* stereo audio  */
 #define USB_AUDIO_CONFIG_RECORD_CHANNEL_MAP            0x03 /* channels Left and right */
 /* next two values define the supported resolution  currently expansion supports only 16 bit and 24 bits resolutions @TODO add other resolution support*/
@@ -73,13 +133,51 @@
 #define USB_AUDIO_CONFIG_RECORD_USE_FREQ_32_K           0 /* to set by user:  1 : to use , 0 to not support*/
 #define USB_AUDIO_CONFIG_RECORD_USE_FREQ_16_K           0 /* to set by user:  1 : to use , 0 to not support*/
 #define USB_AUDIO_CONFIG_RECORD_USE_FREQ_8_K            0 /* to set by user:  1 : to use , 0 to not support*/
+/* a full speed isochronous packet carries up to 1023 bytes, a recording packet up to one frame more than 1 ms */
+#if defined(USE_USB_FS) &&\
+    ((USB_AUDIO_CONFIG_RECORD_USE_FREQ_96_K && (97 * USB_AUDIO_CONFIG_RECORD_CHANNEL_COUNT * USB_AUDIO_CONFIG_RECORD_RES_BYTE > 1023)) ||\
+     (USB_AUDIO_CONFIG_RECORD_USE_FREQ_192_K && (193 * USB_AUDIO_CONFIG_RECORD_CHANNEL_COUNT * USB_AUDIO_CONFIG_RECORD_RES_BYTE > 1023)))
+#error "recording channels and resolution exceed the full speed isochronous packet at this frequency"
+#endif /* USE_USB_FS */
 
 #define USE_AUDIO_RECORDING_USB_IMPLICIT_SYNCHRO 1
 #define USE_AUDIO_RECORDING_USB_NO_REMOVE 1
 
-#define  USB_AUDIO_CONFIG_RECORD_BUFFER_SIZE         (1024 * 2) 
+#define  USB_AUDIO_CONFIG_RECORD_BUFFER_SIZE         (1024 * USB_AUDIO_CONFIG_RECORD_CHANNEL_COUNT) 
+/* microphone block period in microseconds, more than 500 as the implicit synchronization reads the DFSDM DMA
+   position each ms. Long blocks (2000 to 4000) lower the interrupt rate. It is the period at start-up,
+   AUDIO_RecordingSessionSetBlockPeriod changes it up to _MAX while the host doesn't stream. _MAX sizes the microphone
+   buffers, USB_AUDIO_CONFIG_RECORD_BUFFER_SIZE must hold 3 blocks of _MAX at the max frequency */
+#define USB_AUDIO_CONFIG_RECORD_BLOCK_US             1000
+#define USB_AUDIO_CONFIG_RECORD_BLOCK_US_MAX         1000
+/* beamformer : 1 to capture the four microphones and send to the host the beams of a delay and sum node
+   (audio_beamformer_node.h) instead of the microphones. USB_AUDIO_CONFIG_RECORD_CHANNEL_COUNT is then the count of
+   beams, 0x01 (map 0x04, center) or 0x02, each one steered on its own. Angles are in degrees, 0 is the front of the
+   array (+y), positive angles turn to the right (+x). The host steers the beams with the vendor request
+   USB_AUDIO_VENDOR_REQ_SET_BEAM_ANGLE. Requires USE_AUDIO_PROCESSING_GRAPH.
+   USB_AUDIO_CONFIG_RECORD_BEAM_MICS lists the microphone positions in mm, in the capture order, from the center
+   of the array : by default the four microphones of the STM32F769I-Discovery (MB1225), top left, top right,
+   bottom left and bottom right on the corners of a 21 mm square. Define it before this file for another board
+   revision or array */
+#define USE_AUDIO_RECORDING_BEAMFORMER               0
+#if USE_AUDIO_RECORDING_BEAMFORMER
+#ifndef USB_AUDIO_CONFIG_RECORD_BEAM_MICS
+#define USB_AUDIO_CONFIG_RECORD_BEAM_MICS            { {-10.5f, 10.5f}, {10.5f, 10.5f}, \
+                                                       {-10.5f, -10.5f}, {10.5f, -10.5f} }
+#endif /* USB_AUDIO_CONFIG_RECORD_BEAM_MICS */
+#define USB_AUDIO_CONFIG_RECORD_BEAM_DEF_ANGLE       0
+#endif /* USE_AUDIO_RECORDING_BEAMFORMER */
 #endif /* USE_USB_AUDIO_RECORDING */
 
+/* sidetone : 1 to play the microphone on the speaker inside the device (audio_sidetone.h) in simultaneous playback
+   and recording builds, without the host round trip. The monitor level is a feature unit of the speaker path, muted
+   at start-up. The microphone is mixed while both streams run at the same rate. Requires USE_AUDIO_PLAYBACK_MIXER */
+#define USE_AUDIO_SIDETONE 0
+#if USE_AUDIO_SIDETONE
+#define USB_AUDIO_CONFIG_SIDETONE_DEF_DB_256         (-12 * 256)
+#define USB_AUDIO_CONFIG_SIDETONE_DEF_MUTE           1
+#endif /* USE_AUDIO_SIDETONE */
+
 /* Exported types ------------------------------------------------------------*/
 /* Exported macros -----------------------------------------------------------*/
 /* Exported function ---------------------------------------------------------*/
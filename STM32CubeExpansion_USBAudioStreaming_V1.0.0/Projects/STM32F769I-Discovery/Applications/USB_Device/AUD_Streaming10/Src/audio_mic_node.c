@@ -22,6 +22,10 @@
 #include "usbd_audio.h"
 #include "audio_mic_node.h"
 #include "usb_audio.h"
+#include "audio_scheduler.h"
+#include "audio_profiler.h"
+#include "audio_trace.h"
+#include "audio_graph.h"
 
 /* Private defines -----------------------------------------------------------*/
 #define MEMS_VOLUME_MIC_RES_DB_256     256 /* 1 db 1 * 256 = 256*/ 
@@ -30,30 +34,29 @@
 #define MIC_CMD_STOP  1
 #define MIC_CMD_EXIT  2
 #define MIC_CMD_CHANGE_FREQUENCE  4
+#define MIC_CMD_SWITCHING         8 /* capture is stopped, the frequency switch task is pending */
+#define MIC_FILL_DEADLINE_US      USB_AUDIO_CONFIG_RECORD_BLOCK_US /* a DMA half buffer holds one block of samples, follows the block period */
+#define MIC_SWITCH_DEADLINE_US    2000U /* DFSDM reconfiguration, the PLLSAI is relocked only when the frequency family changes */
 
- /* #define DEBUG_MIC_NODE 1 define if debug required*/
-#ifdef DEBUG_MIC_NODE
-#define MIC_DEBUG_BUFFER_SIZE 1000
-#endif /* DEBUG_MIC_NODE */
+#if USB_AUDIO_CONFIG_RECORD_BLOCK_US > USB_AUDIO_CONFIG_RECORD_BLOCK_US_MAX
+#error "USB_AUDIO_CONFIG_RECORD_BLOCK_US must not exceed USB_AUDIO_CONFIG_RECORD_BLOCK_US_MAX"
+#endif /* USB_AUDIO_CONFIG_RECORD_BLOCK_US > USB_AUDIO_CONFIG_RECORD_BLOCK_US_MAX */
+#if USE_AUDIO_RECORDING_BEAMFORMER
+#if USB_AUDIO_CONFIG_RECORD_CHANNEL_COUNT > 2
+#error "the beamformer sends 1 or 2 beams"
+#endif /* USB_AUDIO_CONFIG_RECORD_CHANNEL_COUNT > 2 */
+#elif (USB_AUDIO_CONFIG_RECORD_CHANNEL_COUNT != 2) && (USB_AUDIO_CONFIG_RECORD_CHANNEL_COUNT != 4)
+#error "the DFSDM microphones are captured as 2 channels (top microphones) or 4 channels"
+#endif /* USE_AUDIO_RECORDING_BEAMFORMER */
+#if USE_AUDIO_RECORDING_USB_IMPLICIT_SYNCHRO && (USB_AUDIO_CONFIG_RECORD_BLOCK_US <= 500)
+#error "the DMA position read each ms is ambiguous when the two blocks DMA buffer lasts less than 1 ms"
+#endif /* USE_AUDIO_RECORDING_USB_IMPLICIT_SYNCHRO && (USB_AUDIO_CONFIG_RECORD_BLOCK_US <= 500) */
 
 /* Private macros -------------------------------------------------------------*/
 #define VOLUME_DB_256_TO_PERCENT(volume_db_256) ((uint8_t)((((int)(volume_db_256) - MEMS_VOLUME_MIC_MIN_DB_256)*100)/\
                                                           (MEMS_VOLUME_MIC_MAX_DB_256 - MEMS_VOLUME_MIC_MIN_DB_256)))
 
-/* Private typedef -----------------------------------------------------------*/
-#ifdef DEBUG_MIC_NODE
-typedef struct
-{
-  uint32_t time;
-  uint16_t write;
-  uint16_t read;
-} AUDIO_MicDebugStats;
-#endif /* DEBUG_MIC_NODE*/
-
 /* externals variables ---------------------------------------------------------*/
-#ifdef DEBUG_MIC_NODE
-extern __IO uint32_t uwTick;
-#endif /* DEBUG_MIC_NODE*/
 
 #if USE_AUDIO_RECORDING_USB_IMPLICIT_SYNCHRO 
 extern DMA_HandleTypeDef               hDmaTopLeft;
@@ -74,13 +77,18 @@ static int8_t  AUDIO_MicStartReadCount( uint32_t node_handle);
 static uint16_t AUDIO_MicGetLastReadCount( uint32_t node_handle);
 #endif /* USE_AUDIO_RECORDING_USB_IMPLICIT_SYNCHRO*/
 static void AUDIO_FillDataToBuffer(uint32_t pcm_offset);
+static void AUDIO_MicSwitchFrequency(void);
+#if USE_AUDIO_DEFERRED_PROCESSING
+static void AUDIO_MicFillTaskRun(uint32_t private_data);
+static void AUDIO_MicSwitchTaskRun(uint32_t private_data);
+#endif /* USE_AUDIO_DEFERRED_PROCESSING */
 /* Private variables ---------------------------------------------------------*/ 
 static AUDIO_MicNode_t *AUDIO_MicHandler = 0;
-#ifdef DEBUG_MIC_NODE
-static AUDIO_MicDebugStats_t AUDIO_MicStatsBuffer[MIC_DEBUG_BUFFER_SIZE];
-static  int AUDIO_MicStatsCount = 0;
-static  int AUDIO_MicStatsCounter = 0;
-#endif /* DEBUG_MIC_NODE*/
+#if USE_AUDIO_DEFERRED_PROCESSING
+static AUDIO_SchedulerTask_t AUDIO_MicFillTask;
+static AUDIO_SchedulerTask_t AUDIO_MicSwitchTask;
+static uint32_t AUDIO_MicFillOffset; /* offset of the DMA half buffer to convert */
+#endif /* USE_AUDIO_DEFERRED_PROCESSING */
 
 /* exported functions ---------------------------------------------------------*/
 /**
@@ -114,12 +122,20 @@ static  int AUDIO_MicStatsCounter = 0;
   mic->MicGetReadCount          = AUDIO_MicGetLastReadCount;
 #endif /* USE_AUDIO_RECORDING_USB_IMPLICIT_SYNCHRO*/
   mic->volume = VOLUME_DB_256_TO_PERCENT(audio_description->audio_volume_db_256);
-  mic->packet_length = AUDIO_MS_PACKET_SIZE_FROM_AUD_DESC(audio_description);
-  BSP_AUDIO_IN_Init(audio_description->frequency, audio_description->resolution, audio_description->channels_count);
-  BSP_AUDIO_IN_AllocScratch (mic->specific.scratch, (AUDIO_SAMPLE_COUNT_LENGTH(USB_AUDIO_CONFIG_RECORD_FREQ_MAX))<<2);
-  mic->specific.packet_sample_count = AUDIO_PACKET_SAMPLES_COUNT(audio_description->frequency);
+  mic->packet_length = AUDIO_BLOCK_SIZE_FROM_AUD_DESC(audio_description);
+  mic->specific.packet_sample_count = AUDIO_BLOCK_SAMPLES_COUNT(audio_description->frequency, audio_description->block_us);
+  BSP_AUDIO_IN_Init(audio_description->frequency, audio_description->resolution, AUDIO_MIC_CAPTURE_CHANNEL_COUNT);
+  /* DMA buffer holds two blocks of each channel */
+  BSP_AUDIO_IN_AllocScratch (mic->specific.scratch, (mic->specific.packet_sample_count<<1) * AUDIO_MIC_CAPTURE_CHANNEL_COUNT);
   mic->specific.packet_sample_size = AUDIO_SAMPLE_LENGTH(audio_description);
   AUDIO_MicHandler = mic;
+#if USE_AUDIO_DEFERRED_PROCESSING
+  if((AUDIO_SchedulerRegisterTask(&AUDIO_MicFillTask, AUDIO_MicFillTaskRun, 0, MIC_FILL_DEADLINE_US) != 0)||
+     (AUDIO_SchedulerRegisterTask(&AUDIO_MicSwitchTask, AUDIO_MicSwitchTaskRun, 0, MIC_SWITCH_DEADLINE_US) != 0))
+  {
+    Error_Handler();
+  }
+#endif /* USE_AUDIO_DEFERRED_PROCESSING */
   BSP_AUDIO_IN_Record(0,0);
   return 0;
 }
@@ -131,10 +147,17 @@ static  int AUDIO_MicStatsCounter = 0;
   */
 void BSP_AUDIO_IN_HalfTransfer_CallBack(void)
 {
+  AUDIO_PROFILER_ENTER(AUDIO_PROFILER_AUDIO_IN_HALF_TRANSFER);
   if((AUDIO_MicHandler)&&(AUDIO_MicHandler->node.state==AUDIO_NODE_STARTED))
   {
+#if USE_AUDIO_DEFERRED_PROCESSING
+      AUDIO_MicFillOffset = 0;
+      AUDIO_SchedulerPost(&AUDIO_MicFillTask);
+#else /* USE_AUDIO_DEFERRED_PROCESSING */
       AUDIO_FillDataToBuffer(0);
+#endif /* USE_AUDIO_DEFERRED_PROCESSING */
   }
+  AUDIO_PROFILER_EXIT(AUDIO_PROFILER_AUDIO_IN_HALF_TRANSFER);
 }
 
 /**
@@ -145,10 +168,27 @@ void BSP_AUDIO_IN_HalfTransfer_CallBack(void)
   */
 void BSP_AUDIO_IN_TransferComplete_CallBack(void)
 {
+  AUDIO_PROFILER_ENTER(AUDIO_PROFILER_AUDIO_IN_TRANSFER_COMPLETE);
   if(AUDIO_MicHandler)
   {
+#if USE_AUDIO_DEFERRED_PROCESSING
+    if(AUDIO_MicHandler->specific.cmd & MIC_CMD_CHANGE_FREQUENCE)
+    {
+      /* only stop the capture here, the DFSDM is reconfigured by the switch task out of the DMA interrupt */
+      BSP_AUDIO_IN_Stop();
+      AUDIO_MicHandler->specific.cmd = (AUDIO_MicHandler->specific.cmd & ~MIC_CMD_CHANGE_FREQUENCE) | MIC_CMD_SWITCHING;
+      AUDIO_SchedulerPost(&AUDIO_MicSwitchTask);
+    }
+    else
+    {
+      AUDIO_MicFillOffset = AUDIO_MicHandler->specific.packet_sample_count;
+      AUDIO_SchedulerPost(&AUDIO_MicFillTask);
+    }
+#else /* USE_AUDIO_DEFERRED_PROCESSING */
       AUDIO_FillDataToBuffer(AUDIO_MicHandler->specific.packet_sample_count);
+#endif /* USE_AUDIO_DEFERRED_PROCESSING */
   }
+  AUDIO_PROFILER_EXIT(AUDIO_PROFILER_AUDIO_IN_TRANSFER_COMPLETE);
 }
 
 /* private functions ---------------------------------------------------------*/
@@ -170,6 +210,8 @@ static int8_t  AUDIO_MicDeInit(uint32_t node_handle)
     {
       AUDIO_MicStop(node_handle);
     }
+    /* a pending frequency switch is cancelled */
+    mic->specific.cmd = 0;
     BSP_AUDIO_IN_Stop();
     BSP_AUDIO_IN_DeInit();  
     mic->node.state = AUDIO_NODE_OFF;
@@ -219,9 +261,10 @@ static int8_t  AUDIO_MicStop( uint32_t node_handle)
 
 /**
   * @brief  AUDIO_MicChangeFrequency
-  *         change mic frequency 
+  *         change mic frequency. The frequency and block period are taken from the audio description,
+  *         the session also calls it when the block period changes
   * @param  node_handle: mic node handle must be initialized
-  * @retval  : 0 if no error
+  * @retval  : 0 if no error, -1 if the block period is not supported
   */
 static int8_t  AUDIO_MicChangeFrequency( uint32_t node_handle)
 {
@@ -229,6 +272,13 @@ static int8_t  AUDIO_MicChangeFrequency( uint32_t node_handle)
   AUDIO_MicNode_t* mic;
 
   mic = (AUDIO_MicNode_t*)node_handle;
+#if USE_AUDIO_RECORDING_USB_IMPLICIT_SYNCHRO
+  if(mic->node.audio_description->block_us <= 500)
+  {
+    /* the DMA position read each ms is ambiguous when the two blocks DMA buffer lasts less than 1 ms */
+    return -1;
+  }
+#endif /* USE_AUDIO_RECORDING_USB_IMPLICIT_SYNCHRO */
   mic->specific.cmd|= MIC_CMD_CHANGE_FREQUENCE;
   
     return 0;
@@ -290,22 +340,16 @@ static int8_t  AUDIO_MicGetVolumeDefaultsValues( int* vol_max, int* vol_min, int
 static void AUDIO_FillDataToBuffer(uint32_t pcm_offset)
 {
   uint16_t wr_distance ;
-#ifdef DEBUG_MIC_NODE
-  uint32_t counter;
-  AUDIO_MicStatsBuffer[AUDIO_MicStatsCount].time = uwTick;
-  counter = ++AUDIO_MicStatsCounter;
-#endif /*DEBUG_MIC_NODE*/
-  if(AUDIO_MicHandler->specific.cmd & MIC_CMD_CHANGE_FREQUENCE)
+  if(AUDIO_MicHandler->specific.cmd & (MIC_CMD_CHANGE_FREQUENCE|MIC_CMD_SWITCHING))
   {
+#if USE_AUDIO_DEFERRED_PROCESSING
+    /* the block of the previous frequency is dropped, the DMA transfer complete callback stops the capture */
+#else /* USE_AUDIO_DEFERRED_PROCESSING */
      BSP_AUDIO_IN_Stop();
-     BSP_AUDIO_IN_DeInit();
-     AUDIO_MicHandler->packet_length = AUDIO_MS_PACKET_SIZE_FROM_AUD_DESC(AUDIO_MicHandler->node.audio_description);
-     BSP_AUDIO_IN_Init(AUDIO_MicHandler->node.audio_description->frequency, AUDIO_MicHandler->node.audio_description->resolution, AUDIO_MicHandler->node.audio_description->channels_count);
-     BSP_AUDIO_IN_AllocScratch (AUDIO_MicHandler->specific.scratch, (AUDIO_SAMPLE_COUNT_LENGTH(AUDIO_MicHandler->node.audio_description->frequency))<<2);
-     AUDIO_MicHandler->specific.packet_sample_count = AUDIO_PACKET_SAMPLES_COUNT(AUDIO_MicHandler->node.audio_description->frequency);
-     AUDIO_MicHandler->specific.packet_sample_size = AUDIO_SAMPLE_LENGTH(AUDIO_MicHandler->node.audio_description);
+     AUDIO_MicSwitchFrequency();
      BSP_AUDIO_IN_Record(0,0); /* x2 for double buffering */
      AUDIO_MicHandler->specific.cmd &= ~MIC_CMD_CHANGE_FREQUENCE;
+#endif /* USE_AUDIO_DEFERRED_PROCESSING */
   }
   else
   {
@@ -315,41 +359,129 @@ static void AUDIO_FillDataToBuffer(uint32_t pcm_offset)
     wr_distance = AUDIO_BUFFER_FREE_SIZE(AUDIO_MicHandler->buf);
     if(wr_distance<=AUDIO_MicHandler->packet_length)
     {
-      AUDIO_MicHandler->node.session_handle->SessionCallback(AUDIO_OVERRUN, (AUDIO_Node_t*)AUDIO_MicHandler,
-                                                        AUDIO_MicHandler->node.session_handle);
+      AUDIO_SESSION_NOTIFY(AUDIO_MicHandler->node.session_handle, AUDIO_OVERRUN, AUDIO_MicHandler);
+    }
+#if USE_AUDIO_RECORDING_BEAMFORMER
+    {
+      /* the array doesn't fit the USB packet, it is captured aside and the session graph writes the beams at
+         the beginning of the capture block */
+      AUDIO_GraphPort_t port;
+      uint8_t* capture = (uint8_t*)AUDIO_MicHandler->specific.capture;
+      BSP_AUDIO_IN_Get_PcmBuffer(capture, AUDIO_MicHandler->specific.packet_sample_count,
+                                 pcm_offset, AUDIO_MicHandler->node.audio_description->resolution);
+      port.frequency      = AUDIO_MicHandler->node.audio_description->frequency;
+      port.channels_count = AUDIO_MIC_CAPTURE_CHANNEL_COUNT;
+      port.format         = AUDIO_MicHandler->node.audio_description->resolution;
+      if(AUDIO_GraphProcess(AUDIO_MicHandler->node.session_handle->graph, &port, capture,
+                            AUDIO_MicHandler->specific.packet_sample_count * AUDIO_MIC_CAPTURE_CHANNEL_COUNT * port.format) == 0)
+      {
+        memcpy(AUDIO_MicHandler->buf->data+AUDIO_MicHandler->buf->wr_ptr, capture, AUDIO_MicHandler->packet_length);
+      }
+      else
+      {
+        /* the microphones can't be sent in place of the beams */
+        memset(AUDIO_MicHandler->buf->data+AUDIO_MicHandler->buf->wr_ptr, 0, AUDIO_MicHandler->packet_length);
+      }
     }
+#else /* USE_AUDIO_RECORDING_BEAMFORMER */
   /* to change to support other frequencies */
     BSP_AUDIO_IN_Get_PcmBuffer((AUDIO_MicHandler->buf->data+AUDIO_MicHandler->buf->wr_ptr),AUDIO_MicHandler->specific.packet_sample_count,
                                pcm_offset, AUDIO_MicHandler->node.audio_description->resolution);
+#if USE_AUDIO_PROCESSING_GRAPH
+    {
+      /* apply session processing on the captured block before sending it to the host */
+      AUDIO_GraphPort_t port;
+      port.frequency      = AUDIO_MicHandler->node.audio_description->frequency;
+      port.channels_count = AUDIO_MicHandler->node.audio_description->channels_count;
+      port.format         = AUDIO_MicHandler->node.audio_description->resolution;
+      AUDIO_SESSION_PROCESS(AUDIO_MicHandler->node.session_handle, &port,
+                            AUDIO_MicHandler->buf->data+AUDIO_MicHandler->buf->wr_ptr, AUDIO_MicHandler->packet_length);
+    }
+#endif /* USE_AUDIO_PROCESSING_GRAPH */
+#endif /* USE_AUDIO_RECORDING_BEAMFORMER */
     /* check for overflow */
     AUDIO_MicHandler->buf->wr_ptr += AUDIO_MicHandler->packet_length;
    #if USE_AUDIO_RECORDING_USB_IMPLICIT_SYNCHRO 
-  AUDIO_MicHandler->node.session_handle->SessionCallback(AUDIO_PACKET_RECEIVED, (AUDIO_Node_t*)AUDIO_MicHandler,
-                                                        AUDIO_MicHandler->node.session_handle);
+  AUDIO_SESSION_NOTIFY(AUDIO_MicHandler->node.session_handle, AUDIO_PACKET_RECEIVED, AUDIO_MicHandler);
 #endif /* USE_AUDIO_RECORDING_USB_IMPLICIT_SYNCHRO*/
     if(AUDIO_MicHandler->buf->wr_ptr == AUDIO_MicHandler->buf->size)
     {
       AUDIO_MicHandler->buf->wr_ptr = 0;
     }
-#ifdef DEBUG_MIC_NODE
-    if( counter !=AUDIO_MicStatsCounter)
-    {
-      Error_Handler();
-    }
-
-    AUDIO_MicStatsBuffer[AUDIO_MicStatsCount].read = AUDIO_MicHandler->buf->rd_ptr;
-    AUDIO_MicStatsBuffer[AUDIO_MicStatsCount].write = AUDIO_MicHandler->buf->wr_ptr;
-    
-    if(++AUDIO_MicStatsCount == MIC_DEBUG_BUFFER_SIZE)
-    {
-        AUDIO_MicStatsCount = 0;
-    }
-#endif /*DEBUG_MIC_NODE*/
+    AUDIO_TRACE(AUDIO_TRACE_MIC_FILL, AUDIO_TRACE_NODE_MIC, AUDIO_MicHandler->buf, AUDIO_MicHandler->packet_length, 0);
     }
   }
   
 }
 
+/**
+  * @brief  AUDIO_MicSwitchFrequency
+  *         Sets the block and the DFSDM for the frequency and block period of the audio description, the
+  *         capture must be stopped. The DFSDM GPIO and DMA are kept, BSP_AUDIO_IN_Record restarts the capture.
+  * @param  None
+  * @retval None
+  */
+static void AUDIO_MicSwitchFrequency(void)
+{
+  AUDIO_MicHandler->packet_length = AUDIO_BLOCK_SIZE_FROM_AUD_DESC(AUDIO_MicHandler->node.audio_description);
+  AUDIO_MicHandler->specific.packet_sample_count = AUDIO_BLOCK_SAMPLES_COUNT(AUDIO_MicHandler->node.audio_description->frequency,
+                                                                             AUDIO_MicHandler->node.audio_description->block_us);
+  AUDIO_MicHandler->specific.packet_sample_size = AUDIO_SAMPLE_LENGTH(AUDIO_MicHandler->node.audio_description);
+  if(BSP_AUDIO_IN_SetFrequency(AUDIO_MicHandler->node.audio_description->frequency) != AUDIO_OK)
+  {
+    Error_Handler();
+  }
+  BSP_AUDIO_IN_AllocScratch (AUDIO_MicHandler->specific.scratch, (AUDIO_MicHandler->specific.packet_sample_count<<1) *
+                             AUDIO_MIC_CAPTURE_CHANNEL_COUNT);
+#if USE_AUDIO_DEFERRED_PROCESSING
+  AUDIO_SchedulerSetDeadline(&AUDIO_MicFillTask, AUDIO_MicHandler->node.audio_description->block_us);
+#endif /* USE_AUDIO_DEFERRED_PROCESSING */
+}
+
+#if USE_AUDIO_DEFERRED_PROCESSING
+/**
+  * @brief  AUDIO_MicFillTaskRun
+  *         scheduler task, converts the DMA half buffer posted by the DMA callbacks
+  * @param  private_data: not used
+  * @retval None
+  */
+static void AUDIO_MicFillTaskRun(uint32_t private_data)
+{
+  if(AUDIO_MicHandler)
+  {
+    AUDIO_FillDataToBuffer(AUDIO_MicFillOffset);
+  }
+}
+
+/**
+  * @brief  AUDIO_MicSwitchTaskRun
+  *         scheduler task, switches the frequency after the DMA transfer complete callback stopped the capture.
+  *         The capture restarts at the new frequency, blocks are sent to the session again once its DMA buffer
+  *         is half filled.
+  * @param  private_data: not used
+  * @retval None
+  */
+static void AUDIO_MicSwitchTaskRun(uint32_t private_data)
+{
+  uint32_t primask;
+
+  if((AUDIO_MicHandler == 0)||((AUDIO_MicHandler->specific.cmd & MIC_CMD_SWITCHING) == 0))
+  {
+    return;
+  }
+  AUDIO_MicSwitchFrequency();
+  /* the node may be deinitialized by a higher priority context meanwhile */
+  primask = __get_PRIMASK();
+  __disable_irq();
+  if(AUDIO_MicHandler->specific.cmd & MIC_CMD_SWITCHING)
+  {
+    BSP_AUDIO_IN_Record(0,0);
+    AUDIO_MicHandler->specific.cmd &= ~MIC_CMD_SWITCHING;
+  }
+  __set_PRIMASK(primask);
+}
+#endif /* USE_AUDIO_DEFERRED_PROCESSING */
+
 #if USE_AUDIO_RECORDING_USB_IMPLICIT_SYNCHRO
 /**
   * @brief  AUDIO_MicStartReadCount
@@ -22,39 +22,50 @@
 #include "usbd_audio.h"
 #include "audio_speaker_node.h"
 #include "usb_audio.h"
+#include "audio_scheduler.h"
+#include "audio_profiler.h"
+#include "audio_trace.h"
+#include "audio_graph.h"
 
 /* Private defines -----------------------------------------------------------*/
 #define SPEAKER_CMD_STOP                1
 #define SPEAKER_CMD_EXIT                2
 #define SPEAKER_CMD_CHANGE_FREQUENCE    4
+#define SPEAKER_CMD_SWITCHING           8 /* injection is stopped, the frequency switch task is pending */
+#define SPEAKER_PREPARE_DEADLINE_US     USB_AUDIO_CONFIG_PLAY_BLOCK_US /* next data are injected one block later, follows the block period */
+#define SPEAKER_SWITCH_DEADLINE_US      2000U /* codec and SAI reconfiguration, the PLL is relocked only when the frequency family changes */
+#define SPEAKER_CODEC_DEADLINE_US       5000U /* volume and mute control requests, no real time constraint */
+/* codec commands queued by the control requests, a command pending again is coalesced */
+#define SPEAKER_CODEC_CMD_VOLUME        1
+#define SPEAKER_CODEC_CMD_MUTE          2
 #define VOLUME_DB_256_TO_PERCENT(volume_db_256) ((uint8_t)((((int)(volume_db_256) - VOLUME_SPEAKER_MIN_DB_256)*100)/\
                                                           (VOLUME_SPEAKER_MAX_DB_256 - VOLUME_SPEAKER_MIN_DB_256)))
-
+#if USE_AUDIO_SOFTWARE_VOLUME
+/* volume and mute are applied by the session gain node, the codec stays unmuted at the default volume set on init */
+#define SPEAKER_CODEC_MUTE(speaker)           0
+#else /* USE_AUDIO_SOFTWARE_VOLUME */
+#define SPEAKER_CODEC_MUTE(speaker)           ((speaker)->node.audio_description->audio_mute)
+#endif /* USE_AUDIO_SOFTWARE_VOLUME */
+
+#if USB_AUDIO_CONFIG_PLAY_BLOCK_US > USB_AUDIO_CONFIG_PLAY_BLOCK_US_MAX
+#error "USB_AUDIO_CONFIG_PLAY_BLOCK_US must not exceed USB_AUDIO_CONFIG_PLAY_BLOCK_US_MAX"
+#endif /* USB_AUDIO_CONFIG_PLAY_BLOCK_US > USB_AUDIO_CONFIG_PLAY_BLOCK_US_MAX */
+
+/* size of an injected sample, 24 bits samples are padded to 32 bits */
 #if USB_AUDIO_CONFIG_PLAY_RES_BIT == 24
-#if USB_AUDIO_CONFIG_PLAY_USE_FREQ_44_1_K
-#define AUDIO_SPEAKER_MAX_INJECTION_LENGTH(audio_desc)\
-         (((audio_desc)->frequency == USB_AUDIO_CONFIG_FREQ_44_1_K)? AUDIO_SPEAKER_INJECTION_LENGTH(audio_desc) + \
-           (4*(audio_desc)->channels_count) : AUDIO_SPEAKER_INJECTION_LENGTH(audio_desc))
-#endif /* USB_AUDIO_CONFIG_PLAY_USE_FREQ_44_1_K */
-#define AUDIO_SPEAKER_INJECTION_LENGTH(audio_desc) AUDIO_MS_PACKET_SIZE((audio_desc)->frequency, (audio_desc)->channels_count, 4)
+#define SPEAKER_INJECTION_RES_BYTE      4
 #else /* USB_AUDIO_CONFIG_PLAY_RES_BIT == 24  */
-#define AUDIO_SPEAKER_MAX_INJECTION_LENGTH(audio_desc) \
-         (((audio_desc)->frequency == USB_AUDIO_CONFIG_FREQ_44_1_K)?AUDIO_SPEAKER_INJECTION_LENGTH(audio_desc) + \
-           ((audio_desc)->resolution*(audio_desc)->channels_count) : AUDIO_SPEAKER_INJECTION_LENGTH(audio_desc))
-#define AUDIO_SPEAKER_INJECTION_LENGTH(audio_desc) AUDIO_MS_PACKET_SIZE((audio_desc)->frequency, (audio_desc)->channels_count, (audio_desc)->resolution)
+#define SPEAKER_INJECTION_RES_BYTE      USB_AUDIO_CONFIG_PLAY_RES_BYTE
 #endif /* USB_AUDIO_CONFIG_PLAY_RES_BIT == 24  */
-           
-/* alt buffer max size */
-#if USB_AUDIO_CONFIG_PLAY_RES_BIT == 24
-#define SPEAKER_ALT_BUFFER_SIZE ((USB_AUDIO_CONFIG_PLAY_FREQ_MAX+999)/1000)*2*4*2
-#else  /* USB_AUDIO_CONFIG_PLAY_RES_BIT == 24 */
-#define SPEAKER_ALT_BUFFER_SIZE ((USB_AUDIO_CONFIG_PLAY_FREQ_MAX+999)/1000)*2*3*2        
-#endif /*  USB_AUDIO_CONFIG_PLAY_RES_BIT == 24*/
-
-//#define DEBUG_SPEAKER_NODE 1 /* define when debug is required*/
-#ifdef DEBUG_SPEAKER_NODE
-#define SPEAKER_DEBUG_BUFFER_SIZE 1000
-#endif /*DEBUG_SPEAKER_NODE*/
+#define AUDIO_SPEAKER_INJECTION_LENGTH(audio_desc) AUDIO_BLOCK_SIZE((audio_desc)->frequency, (audio_desc)->channels_count,\
+                                                                    SPEAKER_INJECTION_RES_BYTE, (audio_desc)->block_us)
+#define AUDIO_SPEAKER_MAX_INJECTION_LENGTH(audio_desc) AUDIO_BLOCK_MAX_SIZE((audio_desc)->frequency, (audio_desc)->channels_count,\
+                                                                    SPEAKER_INJECTION_RES_BYTE, (audio_desc)->block_us)
+
+/* alt buffer max size, two blocks */
+#define SPEAKER_ALT_BUFFER_SIZE (AUDIO_BLOCK_MAX_SIZE(USB_AUDIO_CONFIG_PLAY_FREQ_MAX, USB_AUDIO_CONFIG_PLAY_CHANNEL_COUNT,\
+                                                      SPEAKER_INJECTION_RES_BYTE, USB_AUDIO_CONFIG_PLAY_BLOCK_US_MAX)*2)
+
  
 /* Private function prototypes -----------------------------------------------*/
 static int8_t  AUDIO_SpeakerDeInit(uint32_t node_handle);
@@ -64,37 +75,48 @@ static int8_t  AUDIO_SpeakerChangeFrequency( uint32_t node_handle);
 static int8_t  AUDIO_SpeakerMute( uint16_t channel_number,  uint8_t mute , uint32_t node_handle);
 static int8_t  AUDIO_SpeakerSetVolume( uint16_t channel_number,  int volume ,  uint32_t node_handle);
 static void    AUDIO_SpeakerInitInjectionsParams( AUDIO_SpeakerNode_t* speaker);
+static void    AUDIO_SpeakerPrepareNextData(void);
+#if USE_AUDIO_SPEAKER_CIRCULAR_DMA
+static void    AUDIO_SpeakerRefillHalf(void);
+static void    AUDIO_SpeakerPlayedHalf(uint8_t half);
+#endif /* USE_AUDIO_SPEAKER_CIRCULAR_DMA */
+#if USE_AUDIO_DEFERRED_PROCESSING
+static void    AUDIO_SpeakerPrepareTaskRun(uint32_t private_data);
+static void    AUDIO_SpeakerSwitchTaskRun(uint32_t private_data);
+#endif /* USE_AUDIO_DEFERRED_PROCESSING */
+#if !USE_AUDIO_TIMER_VOLUME_CTRL
+static void    AUDIO_SpeakerCodecTaskRun(uint32_t private_data);
+#endif /* USE_AUDIO_TIMER_VOLUME_CTRL */
 #if USB_AUDIO_CONFIG_PLAY_RES_BIT == 24 
 static void AUDIO_DoPadding_24_32(AUDIO_CircularBuffer_t *buff_src,  uint8_t *data_dest ,  int size);
 #endif /* USB_AUDIO_CONFIG_PLAY_RES_BIT == 24   */
 static int8_t  AUDIO_SpeakerStartReadCount( uint32_t node_handle);
 static uint16_t AUDIO_SpeakerGetLastReadCount( uint32_t node_handle);
-
-/* Private typedef -----------------------------------------------------------*/
-#ifdef DEBUG_SPEAKER_NODE
-typedef struct
-{
-  uint32_t time;
-  uint16_t injection_size;
-  uint16_t read;
-  uint16_t dump;
-  uint8_t* data;
-} AUDIO_SpeakerNodeBufferStats_t;
-#endif /* DEBUG_SPEAKER_NODE*/
+static uint32_t AUDIO_SpeakerGetPlayedPosition(AUDIO_SpeakerNode_t* speaker);
 
 /* Private macros ------------------------------------------------------------*/
+#if USE_AUDIO_TRACE
+#define SPEAKER_TRACE_SILENCE(size)   (AUDIO_SpeakerSilenceSize += (size))
+#else /* USE_AUDIO_TRACE */
+#define SPEAKER_TRACE_SILENCE(size)
+#endif /* USE_AUDIO_TRACE */
 /* External variables --------------------------------------------------------*/
 extern SAI_HandleTypeDef         haudio_out_sai;
-#ifdef DEBUG_SPEAKER_NODE
-extern __IO uint32_t uwTick;
-#endif /* DEBUG_SPEAKER_NODE*/
 
 /* Private variables -----------------------------------------------------------*/
 static AUDIO_SpeakerNode_t *AUDIO_SpeakerHandler = 0;
-#ifdef DEBUG_SPEAKER_NODE
-static AUDIO_SpeakerNodeBufferStats_t AUDIO_SpeakerDebugStats[SPEAKER_DEBUG_BUFFER_SIZE];
-static  int AUDIO_SpeakerDebugStats_count =0;
-#endif /* DEBUG_SPEAKER_NODE*/
+#if USE_AUDIO_TRACE
+static uint32_t AUDIO_SpeakerSilenceSize = 0; /* size of silence injected since last data, traced to measure start latency */
+#endif /* USE_AUDIO_TRACE */
+#if USE_AUDIO_DEFERRED_PROCESSING
+static AUDIO_SchedulerTask_t AUDIO_SpeakerPrepareTask;
+static AUDIO_SchedulerTask_t AUDIO_SpeakerSwitchTask;
+#endif /* USE_AUDIO_DEFERRED_PROCESSING */
+#if !USE_AUDIO_TIMER_VOLUME_CTRL
+/* the codec task is scheduled whatever USE_AUDIO_DEFERRED_PROCESSING, see USE_AUDIO_SCHEDULER */
+static AUDIO_SchedulerTask_t AUDIO_SpeakerCodecTask;
+static __IO uint8_t AUDIO_SpeakerCodecCmd = 0; /* SPEAKER_CODEC_CMD_xxx pending for the codec task */
+#endif /* USE_AUDIO_TIMER_VOLUME_CTRL */
 
 /* Exported functions ---------------------------------------------------------*/
 
@@ -138,11 +160,55 @@ static  int AUDIO_SpeakerDebugStats_count =0;
   BSP_AUDIO_OUT_Init_Ext(OUTPUT_DEVICE_AUTO,
                      VOLUME_DB_256_TO_PERCENT(VOLUME_SPEAKER_DEFAULT_DB_256),
                      speaker->node.audio_description->frequency, audio_description->resolution<<3 );
+#if USE_AUDIO_DEFERRED_PROCESSING
+  if((AUDIO_SchedulerRegisterTask(&AUDIO_SpeakerPrepareTask, AUDIO_SpeakerPrepareTaskRun, 0, SPEAKER_PREPARE_DEADLINE_US) != 0)||
+     (AUDIO_SchedulerRegisterTask(&AUDIO_SpeakerSwitchTask, AUDIO_SpeakerSwitchTaskRun, 0, SPEAKER_SWITCH_DEADLINE_US) != 0))
+  {
+    Error_Handler();
+  }
+#endif /* USE_AUDIO_DEFERRED_PROCESSING */
+#if !USE_AUDIO_TIMER_VOLUME_CTRL
+  AUDIO_SpeakerCodecCmd = 0;
+  if(AUDIO_SchedulerRegisterTask(&AUDIO_SpeakerCodecTask, AUDIO_SpeakerCodecTaskRun, 0, SPEAKER_CODEC_DEADLINE_US) != 0)
+  {
+    Error_Handler();
+  }
+#endif /* USE_AUDIO_TIMER_VOLUME_CTRL */
+#if USE_AUDIO_SPEAKER_CIRCULAR_DMA
+  /* the DMA loops over the two halves of the alternate buffer */
+  BSP_AUDIO_OUT_SetDMACircular(1);
+  BSP_AUDIO_OUT_Play((uint16_t *)speaker->specific.alt_buffer, speaker->specific.injection_size<<1);
+#else /* USE_AUDIO_SPEAKER_CIRCULAR_DMA */
   BSP_AUDIO_OUT_Play((uint16_t *)speaker->specific.data ,speaker->specific.data_size );
+#endif /* USE_AUDIO_SPEAKER_CIRCULAR_DMA */
   AUDIO_SpeakerHandler = speaker;
   return 0;
 }
 
+#if USE_AUDIO_SPEAKER_EARLY_CODEC_INIT
+/**
+  * @brief  AUDIO_SpeakerCodecPowerUp
+  *         Powers up the codec at the default frequency, then mutes it and releases the SAI as
+  *         AUDIO_SpeakerDeInit does. To be called after reset, before the USB device is started, the codec
+  *         analog start-up is then over when the host selects the configuration and AUDIO_SpeakerInit only
+  *         sets the codec frequency.
+  * @param  None
+  * @retval 0 if no error
+  */
+int8_t  AUDIO_SpeakerCodecPowerUp(void)
+{
+  if(BSP_AUDIO_OUT_Init_Ext(OUTPUT_DEVICE_AUTO,
+                            VOLUME_DB_256_TO_PERCENT(VOLUME_SPEAKER_DEFAULT_DB_256),
+                            USB_AUDIO_CONFIG_PLAY_DEF_FREQ, USB_AUDIO_CONFIG_PLAY_RES_BYTE<<3) != AUDIO_OK)
+  {
+    return -1;
+  }
+  BSP_AUDIO_OUT_SetMute(1);
+  BSP_AUDIO_OUT_DeInit();
+  return 0;
+}
+#endif /* USE_AUDIO_SPEAKER_EARLY_CODEC_INIT */
+
 
 /**
   * @brief  BSP_AUDIO_OUT_Error_CallBack
@@ -163,135 +229,366 @@ void BSP_AUDIO_OUT_Error_CallBack(void)
   */
 void BSP_AUDIO_OUT_TransferComplete_CallBack(void)
 {
-  uint16_t wr_distance, read_length;
-    
+  AUDIO_PROFILER_ENTER(AUDIO_PROFILER_AUDIO_OUT_TRANSFER_COMPLETE);
   if((AUDIO_SpeakerHandler)&&(AUDIO_SpeakerHandler->node.state != AUDIO_NODE_OFF))
   {
+    /* account the completed transfer, whatever its size, for the synchronization */
+    AUDIO_SpeakerHandler->specific.played_size += haudio_out_sai.XferSize;
     /* execute if any stop cmd was received */
    if(AUDIO_SpeakerHandler->specific.cmd&SPEAKER_CMD_EXIT)
    {
+#if USE_AUDIO_SPEAKER_CIRCULAR_DMA
+     /* the DMA keeps looping until the node is deinitialized, inject silence */
+     AUDIO_SpeakerHandler->node.state = AUDIO_NODE_STOPPED;
+#endif /* USE_AUDIO_SPEAKER_CIRCULAR_DMA */
      AUDIO_SpeakerHandler->specific.cmd = 0;
+     AUDIO_PROFILER_EXIT(AUDIO_PROFILER_AUDIO_OUT_TRANSFER_COMPLETE);
+     return ;
+   }
+   if(AUDIO_SpeakerHandler->specific.cmd&SPEAKER_CMD_SWITCHING)
+   {
+     /* DMA was stopped for the frequency switch, transfers of the new frequency aren't started yet */
+     AUDIO_PROFILER_EXIT(AUDIO_PROFILER_AUDIO_OUT_TRANSFER_COMPLETE);
      return ;
    }
    if(AUDIO_SpeakerHandler->specific.cmd&SPEAKER_CMD_CHANGE_FREQUENCE)
    {
      AUDIO_SpeakerHandler->node.state = AUDIO_NODE_STOPPED;
+#if USE_AUDIO_DEFERRED_PROCESSING
+     /* only stop the injection here, codec and SAI are reconfigured by the switch task out of the DMA interrupt */
+#if USE_AUDIO_SPEAKER_CIRCULAR_DMA
+     HAL_SAI_DMAStop(&haudio_out_sai);
+#endif /* USE_AUDIO_SPEAKER_CIRCULAR_DMA, else the DMA stops as it is not rearmed */
+     AUDIO_SpeakerHandler->specific.cmd = SPEAKER_CMD_SWITCHING;
+     AUDIO_SchedulerPost(&AUDIO_SpeakerSwitchTask);
+     AUDIO_PROFILER_EXIT(AUDIO_PROFILER_AUDIO_OUT_TRANSFER_COMPLETE);
+     return ;
+#else /* USE_AUDIO_DEFERRED_PROCESSING */
 #if !USE_AUDIO_TIMER_VOLUME_CTRL
      BSP_AUDIO_OUT_SetMute(1);
 #endif /*USE_AUDIO_TIMER_VOLUME_CTRL*/
+#if USE_AUDIO_SPEAKER_CIRCULAR_DMA
+     /* the DMA length changes with the frequency, restart it */
+     HAL_SAI_DMAStop(&haudio_out_sai);
+#endif /* USE_AUDIO_SPEAKER_CIRCULAR_DMA */
      AUDIO_SpeakerInitInjectionsParams(AUDIO_SpeakerHandler);
      BSP_AUDIO_OUT_SetFrequency(AUDIO_SpeakerHandler->node.audio_description->frequency);
+#if USE_AUDIO_SPEAKER_CIRCULAR_DMA
+     BSP_AUDIO_OUT_ChangeBuffer((uint16_t*)AUDIO_SpeakerHandler->specific.alt_buffer,
+                                (uint16_t)(AUDIO_SpeakerHandler->specific.injection_size<<1));
+#endif /* USE_AUDIO_SPEAKER_CIRCULAR_DMA */
 #if !USE_AUDIO_TIMER_VOLUME_CTRL
-     BSP_AUDIO_OUT_SetMute(AUDIO_SpeakerHandler->node.audio_description->audio_mute);
+     BSP_AUDIO_OUT_SetMute(SPEAKER_CODEC_MUTE(AUDIO_SpeakerHandler));
 #endif /*USE_AUDIO_TIMER_VOLUME_CTRL*/
      AUDIO_SpeakerHandler->specific.cmd = 0;
+#endif /* USE_AUDIO_DEFERRED_PROCESSING */
    }
   if(AUDIO_SpeakerHandler->specific.cmd&SPEAKER_CMD_STOP)
   {
+#if !USE_AUDIO_SPEAKER_CIRCULAR_DMA
     AUDIO_SpeakerHandler->specific.data      = AUDIO_SpeakerHandler->specific.alt_buffer;
     AUDIO_SpeakerHandler->specific.data_size = AUDIO_SpeakerHandler->specific.injection_size;
     AUDIO_SpeakerHandler->specific.offset    = 0;
     memset(AUDIO_SpeakerHandler->specific.data,0,AUDIO_SpeakerHandler->specific.data_size);
+#endif /* !USE_AUDIO_SPEAKER_CIRCULAR_DMA, else next refills inject silence */
     AUDIO_SpeakerHandler->node.state = AUDIO_NODE_STOPPED;
     AUDIO_SpeakerHandler->specific.cmd       ^= SPEAKER_CMD_STOP;
   }
+#if USE_AUDIO_SPEAKER_CIRCULAR_DMA
+    /* second half was played, the DMA already reads the first one */
+    AUDIO_SpeakerPlayedHalf(1);
+#else /* USE_AUDIO_SPEAKER_CIRCULAR_DMA */
     /* inject current data */
     BSP_AUDIO_OUT_ChangeBuffer((uint16_t*)AUDIO_SpeakerHandler->specific.data, (uint16_t)AUDIO_SpeakerHandler->specific.data_size); 
     /* if speaker was started prepare next data */
     if(AUDIO_SpeakerHandler->node.state == AUDIO_NODE_STARTED)
     {
-#ifdef DEBUG_SPEAKER_NODE
-      AUDIO_SpeakerDebugStats[AUDIO_SpeakerDebugStats_count].time = uwTick;
-#endif /* DEBUG_SPEAKER_NODE */
-     
-      /* inform session that a packet is played */
-      AUDIO_SpeakerHandler->node.session_handle->SessionCallback(AUDIO_PACKET_PLAYED, (AUDIO_Node_t*)AUDIO_SpeakerHandler, 
-                                                            AUDIO_SpeakerHandler->node.session_handle);
-      /* prepare next size to inject */
-#if (USB_AUDIO_CONFIG_PLAY_RES_BIT == 24)
-      AUDIO_SpeakerHandler->specific.data = (AUDIO_SpeakerHandler->specific.offset)?AUDIO_SpeakerHandler->specific.alt_buffer: AUDIO_SpeakerHandler->specific.alt_buffer+AUDIO_SpeakerHandler->specific.data_size;
-      AUDIO_SpeakerHandler->specific.offset ^= 1;
+#if USE_AUDIO_DEFERRED_PROCESSING
+      AUDIO_SchedulerPost(&AUDIO_SpeakerPrepareTask);
+#else /* USE_AUDIO_DEFERRED_PROCESSING */
+      AUDIO_SpeakerPrepareNextData();
+#endif /* USE_AUDIO_DEFERRED_PROCESSING */
+    } /* AUDIO_SpeakerHandler->node.state == AUDIO_NODE_STARTED */
+    else
+    {
+      SPEAKER_TRACE_SILENCE(AUDIO_SpeakerHandler->specific.data_size);
+    }
+#endif /* USE_AUDIO_SPEAKER_CIRCULAR_DMA */
+  }
+  AUDIO_PROFILER_EXIT(AUDIO_PROFILER_AUDIO_OUT_TRANSFER_COMPLETE);
+}
+
+/**
+  * @brief  BSP_AUDIO_OUT_HalfTransfer_CallBack
+  *         This function is called when half of the requested buffer has been transferred.
+  * @param  None
+  * @retval None
+  */
+void BSP_AUDIO_OUT_HalfTransfer_CallBack(void)
+{
+  AUDIO_PROFILER_ENTER(AUDIO_PROFILER_AUDIO_OUT_HALF_TRANSFER);
+#if USE_AUDIO_SPEAKER_CIRCULAR_DMA
+  if((AUDIO_SpeakerHandler)&&(AUDIO_SpeakerHandler->node.state != AUDIO_NODE_OFF))
+  {
+    /* first half was played, the DMA now reads the second one */
+    AUDIO_SpeakerPlayedHalf(0);
+  }
+#endif /* USE_AUDIO_SPEAKER_CIRCULAR_DMA */
+  AUDIO_PROFILER_EXIT(AUDIO_PROFILER_AUDIO_OUT_HALF_TRANSFER);
+}
+/* Private functions ---------------------------------------------------------*/
+/**
+  * @brief  AUDIO_SpeakerPrepareNextData
+  *         Reads next data to inject from the circular buffer, they are injected
+  *         on next DMA transfer complete event, or written to the played half of
+  *         the alternate buffer when the DMA is circular.
+  * @param  None
+  * @retval None
+  */
+static void AUDIO_SpeakerPrepareNextData(void)
+{
+  uint16_t wr_distance, read_length;
+  
+  /* inform session that a packet is played */
+  AUDIO_SESSION_NOTIFY(AUDIO_SpeakerHandler->node.session_handle, AUDIO_PACKET_PLAYED, AUDIO_SpeakerHandler);
+  /* prepare next size to inject */
+#if USE_AUDIO_SPEAKER_CIRCULAR_DMA
+  /* offset is the half of the alternate buffer to refill */
+  AUDIO_SpeakerHandler->specific.data = AUDIO_SpeakerHandler->specific.alt_buffer +
+                                        AUDIO_SpeakerHandler->specific.offset * AUDIO_SpeakerHandler->specific.injection_size;
+#elif (USB_AUDIO_CONFIG_PLAY_RES_BIT == 24)
+  AUDIO_SpeakerHandler->specific.data = (AUDIO_SpeakerHandler->specific.offset)?AUDIO_SpeakerHandler->specific.alt_buffer: AUDIO_SpeakerHandler->specific.alt_buffer+AUDIO_SpeakerHandler->specific.data_size;
+  AUDIO_SpeakerHandler->specific.offset ^= 1;
 #endif /* (USB_AUDIO_CONFIG_PLAY_RES_BIT == 24) */
-      AUDIO_SpeakerHandler->specific.data_size = AUDIO_SpeakerHandler->specific.injection_size;
-      read_length = AUDIO_SpeakerHandler->packet_length;
-#if USB_AUDIO_CONFIG_PLAY_USE_FREQ_44_1_K
-      if(AUDIO_SpeakerHandler->node.audio_description->frequency == USB_AUDIO_CONFIG_FREQ_44_1_K)
-      {
-        if(AUDIO_SpeakerHandler->injection_44_count < 9)
-        {
-          AUDIO_SpeakerHandler->injection_44_count++;  
-        }
-        else
-        {
-           AUDIO_SpeakerHandler->injection_44_count = 0;
-           AUDIO_SpeakerHandler->specific.data_size = AUDIO_SpeakerHandler->specific.alt_buf_half_size;
-           read_length = AUDIO_SpeakerHandler->packet_length_max_44_1;
-        }
-      }
-#endif /* USB_AUDIO_CONFIG_PLAY_USE_FREQ_44_1_K*/
-      wr_distance = AUDIO_BUFFER_FILLED_SIZE(AUDIO_SpeakerHandler->buf);
-      if(wr_distance < AUDIO_SpeakerHandler->specific.injection_size)
+  AUDIO_SpeakerHandler->specific.data_size = AUDIO_SpeakerHandler->specific.injection_size;
+  read_length = AUDIO_SpeakerHandler->packet_length;
+  if(AUDIO_SpeakerHandler->block_frac)
+  {
+    /* the block carries one more sample each time the fractional samples sum up to one */
+    AUDIO_SpeakerHandler->block_frac_sum += AUDIO_SpeakerHandler->block_frac;
+    if(AUDIO_SpeakerHandler->block_frac_sum >= 1000000U)
+    {
+      AUDIO_SpeakerHandler->block_frac_sum -= 1000000U;
+      AUDIO_SpeakerHandler->specific.data_size = AUDIO_SpeakerHandler->specific.alt_buf_half_size;
+      read_length = AUDIO_SpeakerHandler->packet_length_max;
+    }
+  }
+  wr_distance = AUDIO_BUFFER_FILLED_SIZE(AUDIO_SpeakerHandler->buf);
+  if(wr_distance < AUDIO_SpeakerHandler->specific.injection_size)
+  {
+    /** inform session that an underrun is happened */
+    AUDIO_SESSION_NOTIFY(AUDIO_SpeakerHandler->node.session_handle, AUDIO_UNDERRUN, AUDIO_SpeakerHandler);
+#if USE_AUDIO_SPEAKER_CIRCULAR_DMA
+    /* the DMA would replay the previous content of the half */
+    memset(AUDIO_SpeakerHandler->specific.data, 0, AUDIO_SpeakerHandler->specific.data_size);
+#endif /* USE_AUDIO_SPEAKER_CIRCULAR_DMA */
+    SPEAKER_TRACE_SILENCE(AUDIO_SpeakerHandler->specific.data_size);
+  }
+  else
+  {
+
+    
+#if (USB_AUDIO_CONFIG_PLAY_RES_BIT == 24)
+    /* buffer already prepared in half transfer */
+    AUDIO_DoPadding_24_32(AUDIO_SpeakerHandler->buf, AUDIO_SpeakerHandler->specific.data,read_length);
+#elif USE_AUDIO_SPEAKER_CIRCULAR_DMA
+    {
+      /* copy the block to the half, it may wrap in the buffer */
+      uint16_t d = AUDIO_SpeakerHandler->buf->size - AUDIO_SpeakerHandler->buf->rd_ptr;
+      if(d >= read_length)
       {
-        /** inform session that an underrun is happened */
-        AUDIO_SpeakerHandler->node.session_handle->SessionCallback(AUDIO_UNDERRUN, (AUDIO_Node_t*)AUDIO_SpeakerHandler, 
-                                                  AUDIO_SpeakerHandler->node.session_handle);
+        memcpy(AUDIO_SpeakerHandler->specific.data, AUDIO_SpeakerHandler->buf->data + AUDIO_SpeakerHandler->buf->rd_ptr, read_length);
       }
       else
       {
-
-        
-#if (USB_AUDIO_CONFIG_PLAY_RES_BIT == 24)
-        /* buffer already prepared in half transfer */
-        AUDIO_DoPadding_24_32(AUDIO_SpeakerHandler->buf, AUDIO_SpeakerHandler->specific.data,read_length);
-#else /*  (USB_AUDIO_CONFIG_PLAY_RES_BIT == 24)  */
-        AUDIO_SpeakerHandler->specific.data = AUDIO_SpeakerHandler->buf->data + AUDIO_SpeakerHandler->buf->rd_ptr;
-#if USB_AUDIO_CONFIG_PLAY_USE_FREQ_44_1_K        
-        if(AUDIO_SpeakerHandler->node.audio_description->frequency == USB_AUDIO_CONFIG_FREQ_44_1_K)
-        {
-          uint16_t d = AUDIO_SpeakerHandler->buf->size - AUDIO_SpeakerHandler->buf->rd_ptr;
-          if(d < AUDIO_SpeakerHandler->specific.data_size)
-          {
-            memcpy(AUDIO_SpeakerHandler->specific.alt_buffer,  AUDIO_SpeakerHandler->buf->data + AUDIO_SpeakerHandler->buf->rd_ptr,  d);
-            memcpy(AUDIO_SpeakerHandler->specific.alt_buffer + d, AUDIO_SpeakerHandler->buf->data , AUDIO_SpeakerHandler->specific.data_size - d);
-            AUDIO_SpeakerHandler->specific.data = AUDIO_SpeakerHandler->specific.alt_buffer;
-          }
-        }  
-#endif /* USB_AUDIO_CONFIG_PLAY_USE_FREQ_44_1_K*/      
-#endif /*  USB_AUDIO_CONFIG_PLAY_RES_BIT */ 
-#ifdef DEBUG_SPEAKER_NODE
-        AUDIO_SpeakerDebugStats[AUDIO_SpeakerDebugStats_count].data = AUDIO_SpeakerHandler->specific.data;
-        AUDIO_SpeakerDebugStats[AUDIO_SpeakerDebugStats_count].injection_size = AUDIO_SpeakerHandler->specific.data_size;
-#endif /* DEBUG_SPEAKER_NODE*/
-        /* update read pointer */
-        AUDIO_SpeakerHandler->buf->rd_ptr += read_length;
-        if(AUDIO_SpeakerHandler->buf->rd_ptr >= AUDIO_SpeakerHandler->buf->size)
-        {
-          AUDIO_SpeakerHandler->buf->rd_ptr = AUDIO_SpeakerHandler->buf->rd_ptr - AUDIO_SpeakerHandler->buf->size;
-        }
-#ifdef DEBUG_SPEAKER_NODE
-        AUDIO_SpeakerDebugStats[AUDIO_SpeakerDebugStats_count].read = AUDIO_SpeakerHandler->buf->rd_ptr;
-#endif /* DEBUG_SPEAKER_NODE*/
+        memcpy(AUDIO_SpeakerHandler->specific.data, AUDIO_SpeakerHandler->buf->data + AUDIO_SpeakerHandler->buf->rd_ptr, d);
+        memcpy(AUDIO_SpeakerHandler->specific.data + d, AUDIO_SpeakerHandler->buf->data, read_length - d);
       }
-#ifdef DEBUG_SPEAKER_NODE
-      if(++AUDIO_SpeakerDebugStats_count == SPEAKER_DEBUG_BUFFER_SIZE)
+    }
+#else /*  (USB_AUDIO_CONFIG_PLAY_RES_BIT == 24)  */
+    AUDIO_SpeakerHandler->specific.data = AUDIO_SpeakerHandler->buf->data + AUDIO_SpeakerHandler->buf->rd_ptr;
+    if(AUDIO_SpeakerHandler->block_frac)
+    {
+      /* blocks of variable length may wrap in the buffer */
+      uint16_t d = AUDIO_SpeakerHandler->buf->size - AUDIO_SpeakerHandler->buf->rd_ptr;
+      if(d < AUDIO_SpeakerHandler->specific.data_size)
       {
-        AUDIO_SpeakerDebugStats_count = 0;
+        memcpy(AUDIO_SpeakerHandler->specific.alt_buffer,  AUDIO_SpeakerHandler->buf->data + AUDIO_SpeakerHandler->buf->rd_ptr,  d);
+        memcpy(AUDIO_SpeakerHandler->specific.alt_buffer + d, AUDIO_SpeakerHandler->buf->data , AUDIO_SpeakerHandler->specific.data_size - d);
+        AUDIO_SpeakerHandler->specific.data = AUDIO_SpeakerHandler->specific.alt_buffer;
       }
-#endif /* DEBUG_SPEAKER_NODE*/
-    } /* AUDIO_SpeakerHandler->node.state == AUDIO_NODE_STARTED */
+    }  
+#endif /*  USB_AUDIO_CONFIG_PLAY_RES_BIT */ 
+#if USE_AUDIO_PROCESSING_GRAPH
+    {
+      /* apply session processing on the block to inject */
+      AUDIO_GraphPort_t port;
+      port.frequency      = AUDIO_SpeakerHandler->node.audio_description->frequency;
+      port.channels_count = AUDIO_SpeakerHandler->node.audio_description->channels_count;
+      port.format         = (USB_AUDIO_CONFIG_PLAY_RES_BIT == 24)? AUDIO_GRAPH_FORMAT_S32 : AUDIO_GRAPH_FORMAT_S16;
+      AUDIO_SESSION_PROCESS(AUDIO_SpeakerHandler->node.session_handle, &port,
+                            AUDIO_SpeakerHandler->specific.data, AUDIO_SpeakerHandler->specific.data_size);
+    }
+#endif /* USE_AUDIO_PROCESSING_GRAPH */
+    /* update read pointer */
+    AUDIO_SpeakerHandler->buf->rd_ptr += read_length;
+    if(AUDIO_SpeakerHandler->buf->rd_ptr >= AUDIO_SpeakerHandler->buf->size)
+    {
+      AUDIO_SpeakerHandler->buf->rd_ptr = AUDIO_SpeakerHandler->buf->rd_ptr - AUDIO_SpeakerHandler->buf->size;
+    }
+    AUDIO_TRACE(AUDIO_TRACE_SPEAKER_INJECTION, AUDIO_TRACE_NODE_SPEAKER, AUDIO_SpeakerHandler->buf,
+                read_length, AUDIO_SpeakerHandler->specific.data_size);
+#if USE_AUDIO_TRACE
+    if(AUDIO_SpeakerSilenceSize)
+    {
+      AUDIO_TRACE_VALUE(AUDIO_TRACE_SPEAKER_FIRST_DATA, AUDIO_TRACE_NODE_SPEAKER, AUDIO_SpeakerHandler->buf, AUDIO_SpeakerSilenceSize);
+      AUDIO_SpeakerSilenceSize = 0;
+    }
+#endif /* USE_AUDIO_TRACE */
   }
 }
 
+#if USE_AUDIO_DEFERRED_PROCESSING
 /**
-  * @brief  BSP_AUDIO_OUT_HalfTransfer_CallBack
-  *         This function is called when half of the requested buffer has been transferred.
+  * @brief  AUDIO_SpeakerPrepareTaskRun
+  *         scheduler task, prepares next data posted by the DMA transfer complete callback
+  * @param  private_data: not used
+  * @retval None
+  */
+static void AUDIO_SpeakerPrepareTaskRun(uint32_t private_data)
+{
+#if USE_AUDIO_SPEAKER_CIRCULAR_DMA
+  if(AUDIO_SpeakerHandler)
+  {
+    AUDIO_SpeakerRefillHalf();
+  }
+#else /* USE_AUDIO_SPEAKER_CIRCULAR_DMA */
+  if((AUDIO_SpeakerHandler)&&(AUDIO_SpeakerHandler->node.state == AUDIO_NODE_STARTED))
+  {
+    AUDIO_SpeakerPrepareNextData();
+  }
+#endif /* USE_AUDIO_SPEAKER_CIRCULAR_DMA */
+}
+
+/**
+  * @brief  AUDIO_SpeakerSwitchTaskRun
+  *         scheduler task, switches the frequency after the DMA transfer complete callback stopped the injection.
+  *         Codec is muted, the SAI clock and the codec rate are updated then the injection restarts on silence
+  *         until the session starts the node again.
+  * @param  private_data: not used
+  * @retval None
+  */
+static void AUDIO_SpeakerSwitchTaskRun(uint32_t private_data)
+{
+  uint32_t primask;
+
+  if((AUDIO_SpeakerHandler == 0)||((AUDIO_SpeakerHandler->specific.cmd&SPEAKER_CMD_SWITCHING) == 0))
+  {
+    return;
+  }
+#if !USE_AUDIO_TIMER_VOLUME_CTRL
+  BSP_AUDIO_OUT_SetMute(1);
+#endif /*USE_AUDIO_TIMER_VOLUME_CTRL*/
+  AUDIO_SpeakerInitInjectionsParams(AUDIO_SpeakerHandler);
+  AUDIO_SchedulerSetDeadline(&AUDIO_SpeakerPrepareTask, AUDIO_SpeakerHandler->node.audio_description->block_us);
+  BSP_AUDIO_OUT_SetFrequency(AUDIO_SpeakerHandler->node.audio_description->frequency);
+  /* the node may be deinitialized by a higher priority context meanwhile */
+  primask = __get_PRIMASK();
+  __disable_irq();
+  if(AUDIO_SpeakerHandler->specific.cmd&SPEAKER_CMD_SWITCHING)
+  {
+#if USE_AUDIO_SPEAKER_CIRCULAR_DMA
+    BSP_AUDIO_OUT_ChangeBuffer((uint16_t*)AUDIO_SpeakerHandler->specific.alt_buffer,
+                               (uint16_t)(AUDIO_SpeakerHandler->specific.injection_size<<1));
+#else /* USE_AUDIO_SPEAKER_CIRCULAR_DMA */
+    BSP_AUDIO_OUT_ChangeBuffer((uint16_t*)AUDIO_SpeakerHandler->specific.data, (uint16_t)AUDIO_SpeakerHandler->specific.data_size);
+#endif /* USE_AUDIO_SPEAKER_CIRCULAR_DMA */
+    AUDIO_SpeakerHandler->specific.cmd &= ~SPEAKER_CMD_SWITCHING;
+  }
+  __set_PRIMASK(primask);
+#if !USE_AUDIO_TIMER_VOLUME_CTRL
+  BSP_AUDIO_OUT_SetMute(SPEAKER_CODEC_MUTE(AUDIO_SpeakerHandler));
+#endif /*USE_AUDIO_TIMER_VOLUME_CTRL*/
+}
+#endif /* USE_AUDIO_DEFERRED_PROCESSING */
+
+#if !USE_AUDIO_TIMER_VOLUME_CTRL
+/**
+  * @brief  AUDIO_SpeakerCodecTaskRun
+  *         scheduler task, applies the volume and mute control requests to the codec. The I2C transfers
+  *         run here instead of the USB control request handler, and only the latest volume of a burst
+  *         of requests is written. The volume and mute writes are held then flushed together, a codec
+  *         register changed by both is written once. The codec volume and frequency switch tasks run in
+  *         the same context, their I2C transfers never overlap.
+  * @param  private_data: not used
+  * @retval None
+  */
+static void AUDIO_SpeakerCodecTaskRun(uint32_t private_data)
+{
+  uint32_t primask;
+  uint8_t cmd, volume;
+
+  primask = __get_PRIMASK();
+  __disable_irq();
+  cmd = AUDIO_SpeakerCodecCmd;
+  AUDIO_SpeakerCodecCmd = 0;
+  __set_PRIMASK(primask);
+  if((cmd == 0)||(AUDIO_SpeakerHandler == 0))
+  {
+    return;
+  }
+  volume = VOLUME_DB_256_TO_PERCENT(AUDIO_SpeakerHandler->node.audio_description->audio_volume_db_256);
+  BSP_AUDIO_OUT_HoldCodecWrites();
+  if(cmd&SPEAKER_CODEC_CMD_VOLUME)
+  {
+    BSP_AUDIO_OUT_SetVolume(volume);
+  }
+  /* setting the volume unmutes the codec, or mutes it for the minimum volume, the mute state is applied last */
+  BSP_AUDIO_OUT_SetMute((AUDIO_SpeakerHandler->node.audio_description->audio_mute)||(volume == 0));
+  BSP_AUDIO_OUT_FlushCodecWrites();
+}
+#endif /* USE_AUDIO_TIMER_VOLUME_CTRL */
+
+#if USE_AUDIO_SPEAKER_CIRCULAR_DMA
+/**
+  * @brief  AUDIO_SpeakerPlayedHalf
+  *         Called on DMA half and full transfer events, the played half is refilled while the DMA reads
+  *         the other one, so the refill deadline is a block period.
+  * @param  half(IN): index of the played half of the alternate buffer
+  * @retval None
+  */
+static void AUDIO_SpeakerPlayedHalf(uint8_t half)
+{
+  AUDIO_SpeakerHandler->specific.offset = half;
+#if USE_AUDIO_DEFERRED_PROCESSING
+  AUDIO_SchedulerPost(&AUDIO_SpeakerPrepareTask);
+#else /* USE_AUDIO_DEFERRED_PROCESSING */
+  AUDIO_SpeakerRefillHalf();
+#endif /* USE_AUDIO_DEFERRED_PROCESSING */
+}
+
+/**
+  * @brief  AUDIO_SpeakerRefillHalf
+  *         Refills the played half of the alternate buffer with next data, or with silence when the
+  *         speaker is not started.
   * @param  None
   * @retval None
   */
-void BSP_AUDIO_OUT_HalfTransfer_CallBack(void)
+static void AUDIO_SpeakerRefillHalf(void)
 {
+  if(AUDIO_SpeakerHandler->node.state == AUDIO_NODE_STARTED)
+  {
+    AUDIO_SpeakerPrepareNextData();
+  }
+  else
+  {
+    memset(AUDIO_SpeakerHandler->specific.alt_buffer + AUDIO_SpeakerHandler->specific.offset * AUDIO_SpeakerHandler->specific.injection_size,
+           0, AUDIO_SpeakerHandler->specific.injection_size);
+    SPEAKER_TRACE_SILENCE(AUDIO_SpeakerHandler->specific.injection_size);
+  }
 }
-/* Private functions ---------------------------------------------------------*/
+#endif /* USE_AUDIO_SPEAKER_CIRCULAR_DMA */
+
 /**
   * @brief  AUDIO_SpeakerDeInit
   *         De-Initializes the audio speaker node 
@@ -308,16 +605,25 @@ static int8_t  AUDIO_SpeakerDeInit(uint32_t node_handle)
   {
     if(speaker->node.state != AUDIO_NODE_ERROR)
     {
-      /* stop the dma injection */
-      speaker->specific.cmd = SPEAKER_CMD_EXIT;
+      if(speaker->specific.cmd&SPEAKER_CMD_SWITCHING)
+      {
+        /* dma is already stopped, cancel the pending frequency switch */
+        speaker->specific.cmd = SPEAKER_CMD_EXIT;
+      }
+      else
+      {
+        /* stop the dma injection */
+        speaker->specific.cmd = SPEAKER_CMD_EXIT;
         while(speaker->specific.cmd&SPEAKER_CMD_EXIT);
+      }
     }
 #if !USE_AUDIO_TIMER_VOLUME_CTRL
     BSP_AUDIO_OUT_SetMute(1);
 #endif /*USE_AUDIO_TIMER_VOLUME_CTRL*/
-    free(speaker->specific.alt_buffer);
+    /* stop the DMA before releasing the buffer it reads */
     BSP_AUDIO_OUT_Stop(CODEC_PDWN_SW);
     BSP_AUDIO_OUT_DeInit();
+    free(speaker->specific.alt_buffer);
     speaker->node.state = AUDIO_NODE_OFF;
   }
   AUDIO_SpeakerHandler = 0;
@@ -337,9 +643,12 @@ static int8_t  AUDIO_SpeakerStart(AUDIO_CircularBuffer_t* buffer,  uint32_t node
 
   speaker = (AUDIO_SpeakerNode_t*)node_handle;
   speaker->buf = buffer;
-  speaker->specific.cmd = 0;
+  /* a pending frequency switch restarts the injection */
+  speaker->specific.cmd &= SPEAKER_CMD_SWITCHING;
+#if !USE_AUDIO_SOFTWARE_VOLUME
   AUDIO_SpeakerMute( 0,  speaker->node.audio_description->audio_mute , node_handle);
   AUDIO_SpeakerSetVolume( 0,  speaker->node.audio_description->audio_volume_db_256 , node_handle);
+#endif /* USE_AUDIO_SOFTWARE_VOLUME */
   speaker->node.state = AUDIO_NODE_STARTED;
   return 0;
 }
@@ -362,7 +671,8 @@ static int8_t  AUDIO_SpeakerStop( uint32_t node_handle)
 
  /**
   * @brief  AUDIO_SpeakerChangeFrequency
-  *         change frequency then stop speaker node
+  *         change frequency then stop speaker node. The frequency and block period are taken from the
+  *         audio description, the session also calls it when the block period changes
   * @param  node_handle: speaker node handle must be Started
   * @retval 0 if no error
   */  
@@ -383,22 +693,31 @@ static int8_t  AUDIO_SpeakerChangeFrequency( uint32_t node_handle)
   */
 static void  AUDIO_SpeakerInitInjectionsParams( AUDIO_SpeakerNode_t* speaker)
 {
-  speaker->packet_length = AUDIO_MS_PACKET_SIZE_FROM_AUD_DESC(speaker->node.audio_description);
+  speaker->packet_length = AUDIO_BLOCK_SIZE_FROM_AUD_DESC(speaker->node.audio_description);
+  speaker->packet_length_max = speaker->packet_length + AUDIO_SAMPLE_LENGTH(speaker->node.audio_description);
+  speaker->block_frac = AUDIO_BLOCK_SAMPLES_FRAC(speaker->node.audio_description->frequency,
+                                                 speaker->node.audio_description->block_us);
+  speaker->block_frac_sum = 0;
   speaker->specific.injection_size = AUDIO_SPEAKER_INJECTION_LENGTH(speaker->node.audio_description);
   speaker->specific.double_buff = 0;
   speaker->specific.offset = 0;
+#if USE_AUDIO_SPEAKER_CIRCULAR_DMA
+  /* the DMA period is a fixed count of samples, the block rate follows the SAI clock and has no fractional part */
+  speaker->block_frac = 0;
+  speaker->specific.double_buff = 1;
+  speaker->specific.alt_buf_half_size = speaker->specific.injection_size;
+  memset(speaker->specific.alt_buffer, 0, speaker->specific.injection_size<<1);
+#endif /* USE_AUDIO_SPEAKER_CIRCULAR_DMA */
 #if USB_AUDIO_CONFIG_PLAY_RES_BIT == 24
   speaker->specific.double_buff = 1;
     speaker->specific.alt_buf_half_size = speaker->specific.injection_size;
 #endif /* USB_AUDIO_CONFIG_PLAY_RES_BIT == 24*/ 
-#if USB_AUDIO_CONFIG_PLAY_USE_FREQ_44_1_K
-  if(speaker->node.audio_description->frequency == USB_AUDIO_CONFIG_FREQ_44_1_K)
+  if(speaker->block_frac)
   {
+    /* block length is not an integer count of samples (e.g. 44.1 KHZ) */
     speaker->specific.double_buff = 1;
-    speaker->packet_length_max_44_1 = speaker->packet_length + AUDIO_SAMPLE_LENGTH(speaker->node.audio_description);
     speaker->specific.alt_buf_half_size = AUDIO_SPEAKER_MAX_INJECTION_LENGTH(speaker->node.audio_description);
   }
-#endif /* USB_AUDIO_CONFIG_PLAY_USE_FREQ_44_1_K*/
   /* update alternative buffer */
   memset(speaker->specific.alt_buffer, 0, speaker->specific.injection_size);
   speaker->specific.data = speaker->specific.alt_buffer;/* start injection of dumped data */
@@ -421,8 +740,14 @@ static int8_t  AUDIO_SpeakerMute( uint16_t channel_number,  uint8_t mute , uint3
   speaker->node.audio_description->audio_mute = mute;
   speaker->specific.cmd = (speaker->specific.cmd&(~SPEAKER_CMD_MUTE_FIRST))|SPEAKER_CMD_MUTE_UNMUTE;
 
-#else
-  BSP_AUDIO_OUT_SetMute(mute);
+#else /* USE_AUDIO_TIMER_VOLUME_CTRL */
+  AUDIO_SpeakerNode_t* speaker;
+
+  /* the control request completes here, the codec task writes the mute */
+  speaker = (AUDIO_SpeakerNode_t*)node_handle;
+  speaker->node.audio_description->audio_mute = mute;
+  AUDIO_SpeakerCodecCmd |= SPEAKER_CODEC_CMD_MUTE;
+  AUDIO_SchedulerPost(&AUDIO_SpeakerCodecTask);
 #endif /* USE_AUDIO_TIMER_VOLUME_CTRL */
 
   return 0;
@@ -444,8 +769,14 @@ static int8_t  AUDIO_SpeakerSetVolume( uint16_t channel_number,  int volume_db_2
   speaker = (AUDIO_SpeakerNode_t*)node_handle;
   speaker->node.audio_description->audio_volume_db_256 = volume_db_256;
   speaker->specific.cmd  |= (SPEAKER_CMD_MUTE_FIRST|SPEAKER_CMD_CHANGE_VOLUME);
-#else
-  BSP_AUDIO_OUT_SetVolume(VOLUME_DB_256_TO_PERCENT(volume_db_256));
+#else /* USE_AUDIO_TIMER_VOLUME_CTRL */
+  AUDIO_SpeakerNode_t* speaker;
+  
+  /* the control request completes here, the codec task writes the latest volume */
+  speaker = (AUDIO_SpeakerNode_t*)node_handle;
+  speaker->node.audio_description->audio_volume_db_256 = volume_db_256;
+  AUDIO_SpeakerCodecCmd |= SPEAKER_CODEC_CMD_VOLUME;
+  AUDIO_SchedulerPost(&AUDIO_SpeakerCodecTask);
 #endif /* USE_AUDIO_TIMER_VOLUME_CTRL */
   return 0;
 }      
@@ -518,7 +849,7 @@ static int8_t  AUDIO_SpeakerStartReadCount( uint32_t node_handle)
      AUDIO_SpeakerNode_t* speaker;
   
     speaker = (AUDIO_SpeakerNode_t*)node_handle;
-    speaker->specific.dma_remaining = __HAL_DMA_GET_COUNTER(haudio_out_sai.hdmatx);
+    speaker->specific.read_position = AUDIO_SpeakerGetPlayedPosition(speaker);
     return 0;    
 }
 
@@ -533,20 +864,53 @@ static int8_t  AUDIO_SpeakerStartReadCount( uint32_t node_handle)
 static uint16_t  AUDIO_SpeakerGetLastReadCount( uint32_t node_handle)
 {
   AUDIO_SpeakerNode_t* speaker;
-  int cur_waiting_bytes, read_bytes, last_packet_size;
+  uint32_t position, read_bytes;
   
    speaker = (AUDIO_SpeakerNode_t*)node_handle;
-   /* read remind value in dma buffer */
-    cur_waiting_bytes =  __HAL_DMA_GET_COUNTER(haudio_out_sai.hdmatx);
-    last_packet_size = haudio_out_sai.XferSize;
-    read_bytes = (speaker->specific.dma_remaining>=cur_waiting_bytes )?speaker->specific.dma_remaining - cur_waiting_bytes:
-                 (last_packet_size - cur_waiting_bytes)+speaker->specific.dma_remaining;   
-    if(read_bytes<(last_packet_size>>1))
-    {
-      read_bytes+=last_packet_size;
-    }
-   speaker->specific.dma_remaining = cur_waiting_bytes;
+   /* several transfers may complete between two calls when the block is shorter than the read period */
+   position = AUDIO_SpeakerGetPlayedPosition(speaker);
+   read_bytes = position - speaker->specific.read_position;
+   speaker->specific.read_position = position;
     
     return read_bytes;
 }
+
+ /**
+  * @brief  AUDIO_SpeakerGetPlayedPosition
+  *         returns the count of data played since the start, completed transfers plus the current one
+  * @param  speaker(IN): speaker node
+  * @retval played position in SAI data units
+  */    
+static uint32_t  AUDIO_SpeakerGetPlayedPosition(AUDIO_SpeakerNode_t* speaker)
+{
+  uint32_t played_size, position;
+#if USE_AUDIO_SPEAKER_CIRCULAR_DMA
+  uint32_t tc_flag;
+
+  /* the transfer complete interrupt preempts the caller, read again if it occurs while reading.
+     In circular mode the counter is reloaded when the flag is set, before the interrupt accounts the transfer */
+  do
+  {
+    played_size = speaker->specific.played_size;
+    tc_flag = __HAL_DMA_GET_FLAG(haudio_out_sai.hdmatx, __HAL_DMA_GET_TC_FLAG_INDEX(haudio_out_sai.hdmatx));
+    position = played_size + haudio_out_sai.XferSize - __HAL_DMA_GET_COUNTER(haudio_out_sai.hdmatx);
+  }
+  while((played_size != speaker->specific.played_size)||
+        (tc_flag != __HAL_DMA_GET_FLAG(haudio_out_sai.hdmatx, __HAL_DMA_GET_TC_FLAG_INDEX(haudio_out_sai.hdmatx))));
+  if(tc_flag)
+  {
+    position += haudio_out_sai.XferSize;
+  }
+#else /* USE_AUDIO_SPEAKER_CIRCULAR_DMA */
+
+  /* the transfer complete interrupt preempts the caller, read again if it occurs while reading */
+  do
+  {
+    played_size = speaker->specific.played_size;
+    position = played_size + haudio_out_sai.XferSize - __HAL_DMA_GET_COUNTER(haudio_out_sai.hdmatx);
+  }
+  while(played_size != speaker->specific.played_size);
+#endif /* USE_AUDIO_SPEAKER_CIRCULAR_DMA */
+  return position;
+}
 /************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
@@ -21,6 +21,7 @@
 
 /* Includes ------------------------------------------------------------------*/
 #include "stm32f7xx_it.h"
+#include "audio_scheduler.h"
 
 /* Private typedef -----------------------------------------------------------*/
 /* Private define ------------------------------------------------------------*/
@@ -36,6 +37,8 @@ extern TIM_HandleTypeDef    TimHandle;
 
 extern DFSDM_Filter_HandleTypeDef       hAudioInTopLeftFilter;
 extern DFSDM_Filter_HandleTypeDef       hAudioInTopRightFilter;
+extern DFSDM_Filter_HandleTypeDef       hAudioInButtomLeftFilter;
+extern DFSDM_Filter_HandleTypeDef       hAudioInButtomRightFilter;
 /* Private function prototypes -----------------------------------------------*/
 /* Private functions ---------------------------------------------------------*/
 
@@ -129,6 +132,9 @@ void DebugMon_Handler(void)
   */
 void PendSV_Handler(void)
 {
+#if USE_AUDIO_SCHEDULER
+  AUDIO_SchedulerRun();
+#endif /* USE_AUDIO_SCHEDULER */
 }
 
 /**
@@ -208,6 +214,26 @@ void AUDIO_DFSDMx_DMAx_TOP_RIGHT_IRQHandler(void)
   HAL_DMA_IRQHandler(hAudioInTopRightFilter.hdmaReg);
 }
 
+/**
+  * @brief This function handles DMA2 Stream 6 interrupt request, bottom microphones are captured with 4 channels.
+  * @param None
+  * @retval None
+  */
+void AUDIO_DFSDMx_DMAx_BUTTOM_LEFT_IRQHandler(void)
+{
+  HAL_DMA_IRQHandler(hAudioInButtomLeftFilter.hdmaReg);
+}
+
+/**
+  * @brief This function handles DMA2 Stream 7 interrupt request, bottom microphones are captured with 4 channels.
+  * @param None
+  * @retval None
+  */
+void AUDIO_DFSDMx_DMAx_BUTTOM_RIGHT_IRQHandler(void)
+{
+  HAL_DMA_IRQHandler(hAudioInButtomRightFilter.hdmaReg);
+}
+
 /**
   * @brief  This function handles PPP interrupt request.
   * @param  None
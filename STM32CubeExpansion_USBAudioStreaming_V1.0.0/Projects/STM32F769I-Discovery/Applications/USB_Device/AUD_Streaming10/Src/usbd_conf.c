@@ -20,15 +20,54 @@
 /* Includes ------------------------------------------------------------------*/
 #include "main.h"
 #include "usb_audio.h"
+#include "usbd_core_ex.h"
 
 /* Private typedef -----------------------------------------------------------*/
 /* Private define ------------------------------------------------------------*/
+/* FIFO planner: count of OUT endpoints reserved in RX FIFO, largest OUT packet, recording IN endpoint and its
+   FIFO size, highest used IN endpoint. the other IN endpoints, EP0 and feedback included, get the minimal TX FIFO depth */
+#define USBD_FIFO_OUT_EP_COUNT          8U
+#if USE_USB_AUDIO_PLAYBACK
+#define USBD_FIFO_RX_PACKET_SIZE        ((USBD_AUDIO_CONFIG_PLAY_MAX_PACKET_SIZE > 64U)? USBD_AUDIO_CONFIG_PLAY_MAX_PACKET_SIZE : 64U)
+#else /* USE_USB_AUDIO_PLAYBACK */
+#define USBD_FIFO_RX_PACKET_SIZE        64U
+#endif /* USE_USB_AUDIO_PLAYBACK */
+#if USE_USB_AUDIO_RECORDING
+#define USBD_FIFO_RECORD_IN_EP          (USB_AUDIO_CONFIG_RECORD_EP_IN&0x7FU)
+#define USBD_FIFO_RECORD_IN_WORD_SIZE   ((USBD_FIFO_PACKET_WORD_SIZE(USBD_AUDIO_CONFIG_RECORD_MAX_PACKET_SIZE) > USBD_FIFO_TX_EP_MIN_WORD_SIZE)?\
+                                         USBD_FIFO_PACKET_WORD_SIZE(USBD_AUDIO_CONFIG_RECORD_MAX_PACKET_SIZE) : USBD_FIFO_TX_EP_MIN_WORD_SIZE)
+#else /* USE_USB_AUDIO_RECORDING */
+#define USBD_FIFO_RECORD_IN_EP          0U
+#define USBD_FIFO_RECORD_IN_WORD_SIZE   USBD_FIFO_TX_EP_MIN_WORD_SIZE
+#endif /* USE_USB_AUDIO_RECORDING */
+#if (USE_USB_AUDIO_PLAYBACK && USE_AUDIO_PLAYBACK_USB_FEEDBACK)
+#define USBD_FIFO_SYNC_IN_EP            (USB_AUDIO_CONFIG_PLAY_EP_SYNC&0x7FU)
+#else /* USE_USB_AUDIO_PLAYBACK && USE_AUDIO_PLAYBACK_USB_FEEDBACK */
+#define USBD_FIFO_SYNC_IN_EP            0U
+#endif /* USE_USB_AUDIO_PLAYBACK && USE_AUDIO_PLAYBACK_USB_FEEDBACK */
+#define USBD_FIFO_MAX_IN_EP             ((USBD_FIFO_RECORD_IN_EP > USBD_FIFO_SYNC_IN_EP)? USBD_FIFO_RECORD_IN_EP : USBD_FIFO_SYNC_IN_EP)
+/* minimal layout : one packet per endpoint */
+#define USBD_FIFO_RX_MIN_WORD_SIZE      (USBD_FIFO_RX_FIXED_WORD_SIZE + USBD_FIFO_PACKET_WORD_SIZE(USBD_FIFO_RX_PACKET_SIZE) + 1U +\
+                                         2U*USBD_FIFO_OUT_EP_COUNT)
+#define USBD_FIFO_TX_MIN_WORD_SIZE      (USBD_FIFO_TX_EP_MIN_WORD_SIZE*USBD_FIFO_MAX_IN_EP + USBD_FIFO_RECORD_IN_WORD_SIZE)
+/* build time check of the FIFO layout, the array size is negative when the minimal layout doesn't fit */
+typedef char USBD_FifoLayoutCheck_t[((USBD_FIFO_RX_MIN_WORD_SIZE + USBD_FIFO_TX_MIN_WORD_SIZE) <= USB_FIFO_WORD_SIZE)? 1 : -1];
+#if USE_USB_AUDIO_DMA
+#if !defined(USE_USB_HS) && !defined(USE_USB_FS_INTO_HS)
+#error "USB OTG DMA is available only on the HS core"
+#endif /* !USE_USB_HS && !USE_USB_FS_INTO_HS */
+#define USBD_DCACHE_LINE_SIZE           32U
+#endif /* USE_USB_AUDIO_DMA */
 /* Private macro -------------------------------------------------------------*/
 /* Private variables ---------------------------------------------------------*/
 PCD_HandleTypeDef hpcd;
 
 /* Private function prototypes -----------------------------------------------*/
 static USBD_StatusTypeDef USBD_LL_Setup_Fifo(void);
+#if USE_USB_AUDIO_DMA
+static void USBD_LL_CleanDCache(uint8_t *pbuf, uint32_t size);
+static void USBD_LL_InvalidateDCache(uint8_t *pbuf, uint32_t size);
+#endif /* USE_USB_AUDIO_DMA */
 /* Private functions ---------------------------------------------------------*/
   
 /*******************************************************************************
@@ -177,6 +216,10 @@ void HAL_PCD_MspDeInit(PCD_HandleTypeDef *hpcd)
   */
 void HAL_PCD_SetupStageCallback(PCD_HandleTypeDef *hpcd)
 {
+#if USE_USB_AUDIO_DMA
+  /* drop the cached copy of the setup packet written by the DMA, Setup owns its cache lines */
+  USBD_LL_InvalidateDCache((uint8_t *)hpcd->Setup, sizeof(hpcd->Setup));
+#endif /* USE_USB_AUDIO_DMA */
   USBD_LL_SetupStage(hpcd->pData, (uint8_t *)hpcd->Setup);
 }
 
@@ -188,6 +231,10 @@ void HAL_PCD_SetupStageCallback(PCD_HandleTypeDef *hpcd)
   */
 void HAL_PCD_DataOutStageCallback(PCD_HandleTypeDef *hpcd, uint8_t epnum)
 {
+#if USE_USB_AUDIO_DMA
+  /* drop the cached copy of the received data, xfer_buff was moved past the packet by the HAL */
+  USBD_LL_InvalidateDCache((uint8_t*)hpcd->OUT_ep[epnum].dma_addr, hpcd->OUT_ep[epnum].xfer_count);
+#endif /* USE_USB_AUDIO_DMA */
   USBD_LL_DataOutStage(hpcd->pData, epnum, hpcd->OUT_ep[epnum].xfer_buff);
 }
 
@@ -327,8 +374,9 @@ USBD_StatusTypeDef USBD_LL_Init(USBD_HandleTypeDef *pdev)
   multiple of 4 packet sizes. This is due to the fact that USB DMA does
   not allow sending data from non word-aligned addresses.
   For this specific application, it is advised to not enable this option
-  unless required. */
-  hpcd.Init.dma_enable = 0;
+  unless required: the streaming nodes take care of the alignment when
+  USE_USB_AUDIO_DMA is set. */
+  hpcd.Init.dma_enable = USE_USB_AUDIO_DMA;
   hpcd.Init.low_power_enable = 0;
   hpcd.Init.lpm_enable = 0;
   hpcd.Init.phy_itface = PCD_PHY_ULPI;
@@ -378,8 +426,9 @@ USBD_StatusTypeDef USBD_LL_Init(USBD_HandleTypeDef *pdev)
   multiple of 4 packet sizes. This is due to the fact that USB DMA does
   not allow sending data from non word-aligned addresses.
   For this specific application, it is advised to not enable this option
-  unless required. */
-  hpcd.Init.dma_enable = 0;
+  unless required: the streaming nodes take care of the alignment when
+  USE_USB_AUDIO_DMA is set. */
+  hpcd.Init.dma_enable = USE_USB_AUDIO_DMA;
   hpcd.Init.low_power_enable = 0;
   hpcd.Init.lpm_enable = 0;
   hpcd.Init.phy_itface = PCD_PHY_ULPI;
@@ -548,6 +597,9 @@ USBD_StatusTypeDef USBD_LL_Transmit(USBD_HandleTypeDef *pdev,
                                     uint8_t *pbuf,
                                     uint16_t size)
 {
+#if USE_USB_AUDIO_DMA
+  USBD_LL_CleanDCache(pbuf, size);
+#endif /* USE_USB_AUDIO_DMA */
   HAL_PCD_EP_Transmit(pdev->pData, ep_addr, pbuf, size);
   return USBD_OK;
 }
@@ -565,6 +617,10 @@ USBD_StatusTypeDef USBD_LL_PrepareReceive(USBD_HandleTypeDef *pdev,
                                           uint8_t *pbuf,
                                           uint16_t size)
 {
+#if USE_USB_AUDIO_DMA
+  /* dirty lines evicted during the transfer would overwrite the received data */
+  USBD_LL_CleanDCache(pbuf, size);
+#endif /* USE_USB_AUDIO_DMA */
   HAL_PCD_EP_Receive(pdev->pData, ep_addr, pbuf, size);
   return USBD_OK;
 }
@@ -591,71 +647,84 @@ void USBD_LL_Delay(uint32_t Delay)
 }
 /**
   * @brief  Setup dynamically the fifo.
+  *         The layout is planned by USBD_LL_PlanFifo from the max packet sizes of the endpoints of the
+  *         configuration. The remaining words are given to the recording endpoint, or to RX FIFO.
   * @retval Status OK
   */
 static USBD_StatusTypeDef USBD_LL_Setup_Fifo(void)
 {
+  USBD_FifoRequestTypeDef request;
+  USBD_FifoPlanTypeDef plan;
   
-  uint16_t tx_fifo_size[5]={0};/* TX_FIFO allocation*/
-  uint8_t max_tx_ep_num = 0;/* The Max TX_EP_NUMBER*/
-  uint16_t tx_fifo_used_size = 0; /* total usage of TX_FIFO*/
-  uint16_t rx_fifo_size =0; /* total usage of RX_FIFO*/
-  
-  /* rx_fifo_size = (5 * number of control endpoints + 8) + ((largest USB packet used / 4) + 1 for status information) +
-                    (2 * number of OUT endpoints) + 1 for Global NAK*/
+  memset(&request, 0, sizeof(request));
+  request.fifo_word_size = USB_FIFO_WORD_SIZE;
+  request.out_ep_count = USBD_FIFO_OUT_EP_COUNT;
+  request.out_mps[0] = USB_MAX_EP0_SIZE;
+  request.in_mps[0] = USB_MAX_EP0_SIZE;
+  request.ep0_burst_size = USB_AUDIO_GetConfigDescriptor(0);
 #if USE_USB_AUDIO_PLAYBACK
-  rx_fifo_size = (USBD_AUDIO_CONFIG_PLAY_MAX_PACKET_SIZE>64)?(USBD_AUDIO_CONFIG_PLAY_MAX_PACKET_SIZE + 3U)/4:16;
+  request.out_mps[USBD_AUDIO_CONFIG_PLAY_EP_OUT] = USBD_AUDIO_CONFIG_PLAY_MAX_PACKET_SIZE;
+  request.out_iso |= 1U << USBD_AUDIO_CONFIG_PLAY_EP_OUT;
 #if USE_AUDIO_PLAYBACK_USB_FEEDBACK
- max_tx_ep_num = USB_AUDIO_CONFIG_PLAY_EP_SYNC&0x7F;
+  request.in_mps[USB_AUDIO_CONFIG_PLAY_EP_SYNC&0x7F] = AUDIO_FEEDBACK_EP_PACKET_SIZE;
+  request.in_iso |= 1U << (USB_AUDIO_CONFIG_PLAY_EP_SYNC&0x7F);
 #endif /* USE_AUDIO_PLAYBACK_USB_FEEDBACK */
-#else /* USE_USB_AUDIO_PLAYBACK */
- rx_fifo_size = 16;/*64(mps)/4*/
-#endif /* USE_USB_AUDIO_PLAYBACK*/
- 
-#if  USE_USB_AUDIO_RECORDING   
- if((USB_AUDIO_CONFIG_RECORD_EP_IN&0x7F)>max_tx_ep_num)
- {
-  max_tx_ep_num = USB_AUDIO_CONFIG_RECORD_EP_IN&0x7F;  
- }
- tx_fifo_size[USB_AUDIO_CONFIG_RECORD_EP_IN&0x7F] = (USBD_AUDIO_CONFIG_RECORD_MAX_PACKET_SIZE + 3U)/4;
-#endif /* USE_USB_AUDIO_RECORDING */
- 
-  tx_fifo_used_size = (USB_AUDIO_GetConfigDescriptor(0)+3)/4 ;
-  tx_fifo_size[0] = tx_fifo_used_size;
- 
-  for(int i = 1; i<= max_tx_ep_num; i++)
- {
-   if(tx_fifo_size[i]<16)
-   {
-     tx_fifo_size[i] = 16;
-   }
-   tx_fifo_used_size += tx_fifo_size[i];
- }
- 
- rx_fifo_size += (5*1/*number of control endpoints*/+8
-                    +1/* for status information*/+2*8/*number of OUT endpoints*/+1/*for Global NAK*/);
- 
-  if(tx_fifo_used_size + rx_fifo_size<=USB_FIFO_WORD_SIZE)
-  {
-#if  USE_USB_AUDIO_RECORDING   
- tx_fifo_size[USB_AUDIO_CONFIG_RECORD_EP_IN&0x7F] += USB_FIFO_WORD_SIZE - (tx_fifo_used_size + rx_fifo_size);
-#else /* USE_USB_AUDIO_RECORDING */
-#if USE_USB_AUDIO_PLAYBACK
-  rx_fifo_size = USB_FIFO_WORD_SIZE - tx_fifo_used_size;
 #endif /* USE_USB_AUDIO_PLAYBACK */
+#if  USE_USB_AUDIO_RECORDING
+  request.in_mps[USB_AUDIO_CONFIG_RECORD_EP_IN&0x7F] = USBD_AUDIO_CONFIG_RECORD_MAX_PACKET_SIZE;
+  request.in_iso |= 1U << (USB_AUDIO_CONFIG_RECORD_EP_IN&0x7F);
+  request.stream_in_ep = USB_AUDIO_CONFIG_RECORD_EP_IN&0x7F;
 #endif /* USE_USB_AUDIO_RECORDING */
+  
+  if(USBD_LL_PlanFifo(&request, &plan) != USBD_OK)
+  {
+    Error_Handler();
   }
-  else
+  HAL_PCDEx_SetRxFiFo(&hpcd, plan.rx_word_size);
+  for(uint8_t i = 0; i < plan.tx_fifo_count; i++)
   {
-     Error_Handler();
+    HAL_PCD_SetTxFiFo(&hpcd, i, plan.tx_word_size[i]);
   }
+  return USBD_OK;
+}
+
+#if USE_USB_AUDIO_DMA
+/**
+  * @brief  Cleans the D-cache lines covering a buffer before the OTG DMA accesses it.
+  * @param  pbuf: Pointer to the buffer
+  * @param  size: Buffer size in bytes
+  * @retval None
+  */
+static void USBD_LL_CleanDCache(uint8_t *pbuf, uint32_t size)
+{
+  uint32_t start = (uint32_t)pbuf & ~(USBD_DCACHE_LINE_SIZE - 1U);
   
+  if(((SCB->CCR & SCB_CCR_DC_Msk) != 0U) && (size != 0U))
+  {
+    SCB_CleanDCache_by_Addr((uint32_t*)start, (int32_t)(((uint32_t)pbuf + size) - start));
+  }
+}
+
+/**
+  * @brief  Invalidates the D-cache lines covering a buffer written by the OTG DMA.
+  *         Lines are cleaned before reception, so the partial lines at buffer
+  *         edges don't hold CPU data newer than memory. The CPU must not write
+  *         those edge lines during the transfer : the bounce buffers of the
+  *         streaming nodes and the class control buffer are 32 bytes aligned
+  *         and padded, packets are received in place only on whole lines of
+  *         the circular buffer, and Setup owns its lines in the PCD handle.
+  * @param  pbuf: Pointer to the buffer
+  * @param  size: Buffer size in bytes
+  * @retval None
+  */
+static void USBD_LL_InvalidateDCache(uint8_t *pbuf, uint32_t size)
+{
+  uint32_t start = (uint32_t)pbuf & ~(USBD_DCACHE_LINE_SIZE - 1U);
   
- HAL_PCDEx_SetRxFiFo(&hpcd, rx_fifo_size);
- for(int i = 0; i<= max_tx_ep_num; i++)
- {
-   HAL_PCD_SetTxFiFo(&hpcd, i, tx_fifo_size[i]);
- }
- return USBD_OK;
+  if(((SCB->CCR & SCB_CCR_DC_Msk) != 0U) && (size != 0U))
+  {
+    SCB_InvalidateDCache_by_Addr((uint32_t*)start, (int32_t)(((uint32_t)pbuf + size) - start));
+  }
 }
+#endif /* USE_USB_AUDIO_DMA */
 /************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
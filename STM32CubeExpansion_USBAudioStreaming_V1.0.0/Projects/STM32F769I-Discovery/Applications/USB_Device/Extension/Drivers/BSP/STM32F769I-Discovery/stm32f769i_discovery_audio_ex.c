@@ -42,6 +42,8 @@
       the device output mode the mute or the stop, use the functions: BSP_AUDIO_OUT_SetVolume(), 
       AUDIO_OUT_SetFrequency(), BSP_AUDIO_OUT_SetAudioFrameSlot(), BSP_AUDIO_OUT_SetOutputMode(),
       BSP_AUDIO_OUT_SetMute() and BSP_AUDIO_OUT_Stop().
+   + To apply several volume and mute changes with one I2C transfer by codec register, call them
+      between BSP_AUDIO_OUT_HoldCodecWrites() and BSP_AUDIO_OUT_FlushCodecWrites().
 
    + Call the function BSP_AUDIO_IN_Init(
                                     AudioFreq: Audio frequency in Hz (8000, 16000, 22500, 32000...)
@@ -128,7 +130,15 @@
 /** @defgroup STM32F769I_DISCOVERY_AUDIO_Private_Types STM32F769I_DISCOVERY_AUDIO Private Types
   * @{
   */ 
-
+/* DFSDM settings of a record frequency */
+typedef struct
+{
+  uint32_t Frequency;
+  uint32_t ClockDivider;   /* DFSDM clock / microphone clock */
+  uint32_t FilterOrder;
+  uint32_t OverSampling;   /* microphone clock / frequency */
+  uint32_t RightBitShift;
+} DFSDMx_RateConfigTypeDef;
 /**
   * @}
   */ 
@@ -136,6 +146,11 @@
 /** @defgroup STM32F769I_DISCOVERY_AUDIO_Private_Defines STM32F769I_DISCOVERY_AUDIO Private Defines
   * @{
   */
+/* frequency families of the audio PLLs, a PLL is reprogrammed only when the family changes,
+   the audio peripheral divider selects the frequency within the family */
+#define AUDIO_CLOCK_FAMILY_NONE        0U
+#define AUDIO_CLOCK_FAMILY_11K         1U /* 11.025, 22.05, 44.1 KHz */
+#define AUDIO_CLOCK_FAMILY_8K          2U /* 8, 16, 32, 48, 96, 192 KHz */
 /**
   * @}
   */ 
@@ -143,45 +158,17 @@
 /** @defgroup STM32F769I_DISCOVERY_AUDIO_Private_Macros STM32F769I_DISCOVERY_AUDIO Private Macros
   * @{
   */
-/*### RECORD ###*/
-#define DFSDM_OVER_SAMPLING(__FREQUENCY__) \
-        (__FREQUENCY__ == AUDIO_FREQUENCY_8K)  ? 256 \
-      : (__FREQUENCY__ == AUDIO_FREQUENCY_11K) ? 256 \
-      : (__FREQUENCY__ == AUDIO_FREQUENCY_16K) ? 128 \
-      : (__FREQUENCY__ == AUDIO_FREQUENCY_22K) ? 128 \
-      : (__FREQUENCY__ == AUDIO_FREQUENCY_32K) ? 64 \
-      : (__FREQUENCY__ == AUDIO_FREQUENCY_44K) ? 64  \
-      : (__FREQUENCY__ == AUDIO_FREQUENCY_48K) ? 64 : 20  \
-
-#define DFSDM_CLOCK_DIVIDER(__FREQUENCY__) \
-        (__FREQUENCY__ == AUDIO_FREQUENCY_8K)  ? 24 \
-      : (__FREQUENCY__ == AUDIO_FREQUENCY_11K) ? 4 \
-      : (__FREQUENCY__ == AUDIO_FREQUENCY_16K) ? 24 \
-      : (__FREQUENCY__ == AUDIO_FREQUENCY_22K) ? 4 \
-      : (__FREQUENCY__ == AUDIO_FREQUENCY_32K) ? 24 \
-      : (__FREQUENCY__ == AUDIO_FREQUENCY_44K) ? 4  \
-      : (__FREQUENCY__ == AUDIO_FREQUENCY_48K) ? 16 : 25  \
-
-#define DFSDM_FILTER_ORDER(__FREQUENCY__) \
-        (__FREQUENCY__ == AUDIO_FREQUENCY_8K)  ? DFSDM_FILTER_SINC3_ORDER \
-      : (__FREQUENCY__ == AUDIO_FREQUENCY_11K) ? DFSDM_FILTER_SINC3_ORDER \
-      : (__FREQUENCY__ == AUDIO_FREQUENCY_16K) ? DFSDM_FILTER_SINC3_ORDER \
-      : (__FREQUENCY__ == AUDIO_FREQUENCY_22K) ? DFSDM_FILTER_SINC3_ORDER \
-      : (__FREQUENCY__ == AUDIO_FREQUENCY_32K) ? DFSDM_FILTER_SINC4_ORDER \
-      : (__FREQUENCY__ == AUDIO_FREQUENCY_44K) ? DFSDM_FILTER_SINC3_ORDER  \
-      : (__FREQUENCY__ == AUDIO_FREQUENCY_48K) ? DFSDM_FILTER_SINC3_ORDER : DFSDM_FILTER_SINC5_ORDER  \
-
-#define DFSDM_RIGHT_BIT_SHIFT(__FREQUENCY__) \
-        (__FREQUENCY__ == AUDIO_FREQUENCY_8K)  ? 8 \
-      : (__FREQUENCY__ == AUDIO_FREQUENCY_11K) ? 8 \
-      : (__FREQUENCY__ == AUDIO_FREQUENCY_16K) ? 3 \
-      : (__FREQUENCY__ == AUDIO_FREQUENCY_22K) ? 4 \
-      : (__FREQUENCY__ == AUDIO_FREQUENCY_32K) ? 7 \
-      : (__FREQUENCY__ == AUDIO_FREQUENCY_44K) ? 0  \
-      : (__FREQUENCY__ == AUDIO_FREQUENCY_48K) ? 0 : 4  \
+#define AUDIO_CLOCK_FAMILY(__FREQUENCY__) \
+        ((((__FREQUENCY__) == AUDIO_FREQUENCY_11K) || ((__FREQUENCY__) == AUDIO_FREQUENCY_22K) || \
+          ((__FREQUENCY__) == AUDIO_FREQUENCY_44K)) ? AUDIO_CLOCK_FAMILY_11K : AUDIO_CLOCK_FAMILY_8K)
 
 /* Saturate the record PCM sample */
 #define SaturaLH(N, L, H) (((N)<(L))?(L):(((N)>(H))?(H):(N)))
+/* Saturate a DFSDM sample to 16 or 24 bit, the 16 bit sample keeps the 16 MSB of the 24 bit sample */
+#define DFSDMx_SAT16(N)   ((uint32_t)__SSAT((N) >> 8, 16))
+#define DFSDMx_SAT24(N)   ((uint32_t)__SSAT((N), 24))
+/* Two saturated 16 bit samples packed in a word, first sample at the lower address */
+#define DFSDMx_PACK16(N1, N2)  ((DFSDMx_SAT16(N1) & 0xFFFFU) | (DFSDMx_SAT16(N2) << 16))
 /**
   * @}
   */ 
@@ -227,6 +214,27 @@ static uint32_t                DmaButtomLeftRecCplt      = 0;
 static uint32_t                DmaButtomRightRecHalfCplt = 0;
 static uint32_t                DmaButtomRightRecCplt     = 0;
 
+/* Families the PLLI2S (SAI1, play) and PLLSAI (SAI2 and DFSDM, record) are locked on */
+static uint8_t                 AudioOutClockFamily = AUDIO_CLOCK_FAMILY_NONE;
+static uint8_t                 AudioInClockFamily  = AUDIO_CLOCK_FAMILY_NONE;
+/* DFSDM settings of each record frequency, computed offline so a frequency switch only looks its entry up.
+   The last entry is taken for a frequency missing in the table */
+static const DFSDMx_RateConfigTypeDef DFSDMx_RateConfigs[] =
+{
+  /* Frequency          Divider  FilterOrder               OverSampling  RightBitShift */
+  {AUDIO_FREQUENCY_8K,  24,      DFSDM_FILTER_SINC3_ORDER, 256,          8},
+  {AUDIO_FREQUENCY_11K, 4,       DFSDM_FILTER_SINC3_ORDER, 256,          8},
+  {AUDIO_FREQUENCY_16K, 24,      DFSDM_FILTER_SINC3_ORDER, 128,          3},
+  {AUDIO_FREQUENCY_22K, 4,       DFSDM_FILTER_SINC3_ORDER, 128,          4},
+  {AUDIO_FREQUENCY_32K, 24,      DFSDM_FILTER_SINC4_ORDER, 64,           7},
+  {AUDIO_FREQUENCY_44K, 4,       DFSDM_FILTER_SINC3_ORDER, 64,           0},
+  {AUDIO_FREQUENCY_48K, 16,      DFSDM_FILTER_SINC3_ORDER, 64,           0},
+  {AUDIO_FREQUENCY_96K, 25,      DFSDM_FILTER_SINC5_ORDER, 20,           4}
+};
+/* Output device and resolution the codec registers are initialized for, 0 when the codec must be initialized */
+static uint16_t                AudioOutCodecDevice = 0;
+static uint8_t                 AudioOutCodecResBit = 0;
+
 /* Application Buffer Trigger */
 uint8_t __IO AudioOutResBit = 16; 
 uint8_t __IO AudioOutResByte = 2;
@@ -249,6 +257,7 @@ static void    DFSDMx_ChannelMspDeInit(void);
 static void    DFSDMx_FilterMspDeInit(void);
 static uint8_t DFSDMx_Init(uint32_t AudioFreq);
 static uint8_t DFSDMx_DeInit(void);
+static const DFSDMx_RateConfigTypeDef* DFSDMx_GetRateConfig(uint32_t AudioFreq);
 
 /**
   * @}
@@ -295,6 +304,19 @@ uint8_t BSP_AUDIO_OUT_Init_Ext(uint16_t OutputDevice, uint8_t Volume, uint32_t A
   }
   SAIx_Out_Init_Ext(AudioFreq, AudioResolution);
 
+  if((AudioOutCodecDevice == OutputDevice) && (AudioOutCodecResBit == AudioResolution))
+  {
+    /* The codec kept its registers since the last init (stopped with CODEC_PDWN_SW), skip
+       its analog start-up which lasts about 300 ms, only its frequency and volume change */
+    if((audio_drv->SetFrequency(AUDIO_I2C_ADDRESS, AudioFreq) != 0) ||
+       (audio_drv->SetVolume(AUDIO_I2C_ADDRESS, Volume) != 0))
+    {
+      AudioOutCodecDevice = 0;
+      return AUDIO_ERROR;
+    }
+    return AUDIO_OK;
+  }
+
   /* wm8994 codec initialization */
   deviceid = wm8994_drv.ReadID(AUDIO_I2C_ADDRESS);
   
@@ -314,7 +336,11 @@ uint8_t BSP_AUDIO_OUT_Init_Ext(uint16_t OutputDevice, uint8_t Volume, uint32_t A
   if(ret == AUDIO_OK)
   {
     /* Initialize the codec internal registers */
-    audio_drv->Init(AUDIO_I2C_ADDRESS, OutputDevice, Volume, AudioFreq,AudioOutResBit);
+    if(audio_drv->Init(AUDIO_I2C_ADDRESS, OutputDevice, Volume, AudioFreq,AudioOutResBit) == 0)
+    {
+      AudioOutCodecDevice = OutputDevice;
+      AudioOutCodecResBit = AudioResolution;
+    }
   }
  
   return ret;
@@ -353,6 +379,21 @@ void BSP_AUDIO_OUT_ChangeBuffer(uint16_t *pData, uint16_t Size)
    HAL_SAI_Transmit_DMA(&haudio_out_sai, (uint8_t*) pData, DMA_MAX(Size / AudioOutResByte));
 }
 
+/**
+  * @brief  Selects the SAI DMA mode of the next BSP_AUDIO_OUT_Play(). In circular mode the DMA loops over
+  *         the played buffer, the application refills each half on half and full transfer callbacks and
+  *         does not call BSP_AUDIO_OUT_ChangeBuffer(). In normal mode each transfer must be rearmed by
+  *         BSP_AUDIO_OUT_ChangeBuffer() in the transfer complete callback.
+  * @param  Circular: 1 for circular mode, 0 for normal mode
+  * @note   This API should be called after BSP_AUDIO_OUT_Init_Ext(), while the DMA is stopped.
+  * @retval None
+  */
+void BSP_AUDIO_OUT_SetDMACircular(uint8_t Circular)
+{
+  haudio_out_sai.hdmatx->Init.Mode = (Circular)? DMA_CIRCULAR : DMA_NORMAL;
+  HAL_DMA_Init(haudio_out_sai.hdmatx);
+}
+
 /**
   * @brief  This function Pauses the audio file stream. In case
   *         of using DMA, the DMA Pause feature is used.
@@ -425,6 +466,8 @@ uint8_t BSP_AUDIO_OUT_Stop(uint32_t Option)
   {
     if(Option == CODEC_PDWN_HW)
     { 
+      /* The codec is reset, next BSP_AUDIO_OUT_Init_Ext initializes it again */
+      AudioOutCodecDevice = 0;
       /* Wait at least 100us */
       HAL_Delay(1);
     }
@@ -473,6 +516,34 @@ uint8_t BSP_AUDIO_OUT_SetMute(uint32_t Cmd)
   }
 }
 
+/**
+  * @brief  Holds the writes of the codec volume, mute, output and frequency registers
+  *         until BSP_AUDIO_OUT_FlushCodecWrites, only the last value of each register
+  *         is then written.
+  * @retval None
+  */
+void BSP_AUDIO_OUT_HoldCodecWrites(void)
+{
+  wm8994_HoldWrites();
+}
+
+/**
+  * @brief  Writes the codec registers changed since BSP_AUDIO_OUT_HoldCodecWrites.
+  * @retval AUDIO_OK if correct communication, else wrong communication
+  */
+uint8_t BSP_AUDIO_OUT_FlushCodecWrites(void)
+{
+  if(wm8994_FlushWrites(AUDIO_I2C_ADDRESS) != 0)
+  {
+    return AUDIO_ERROR;
+  }
+  else
+  {
+    /* Return AUDIO_OK when all operations are correctly done */
+    return AUDIO_OK;
+  }
+}
+
 /**
   * @brief  Switch dynamically (while audio file is played) the output target 
   *         (speaker or headphone).
@@ -551,6 +622,8 @@ void BSP_AUDIO_OUT_DeInit(void)
   SAIx_Out_DeInit();
   /* DeInit the SAI MSP : this __weak function can be rewritten by the application */
   BSP_AUDIO_OUT_MspDeInit(&haudio_out_sai, NULL);
+  /* the PLLI2S may be set by the application meanwhile, it is locked again on next init */
+  AudioOutClockFamily = AUDIO_CLOCK_FAMILY_NONE;
 }
 
 /**
@@ -849,6 +922,12 @@ __weak void BSP_AUDIO_OUT_ClockConfig(SAI_HandleTypeDef *hsai, uint32_t AudioFre
 { 
   RCC_PeriphCLKInitTypeDef rcc_ex_clk_init_struct;
 
+  /* PLL already locked on the family, the SAI divider is computed by HAL_SAI_Init() */
+  if(AUDIO_CLOCK_FAMILY(AudioFreq) == AudioOutClockFamily)
+  {
+    return;
+  }
+  AudioOutClockFamily = AUDIO_CLOCK_FAMILY(AudioFreq);
   HAL_RCCEx_GetPeriphCLKConfig(&rcc_ex_clk_init_struct);
   
   /* Set the PLL configuration according to the audio frequency */
@@ -1171,8 +1250,9 @@ uint8_t BSP_AUDIO_IN_InitEx(uint16_t InputDevice, uint32_t AudioFreq, uint32_t B
     
     if((wm8994_drv.ReadID(AUDIO_I2C_ADDRESS)) == WM8994_ID)
     {
-      /* Reset the Codec Registers */
+      /* Reset the Codec Registers, the output path must be initialized again */
       wm8994_drv.Reset(AUDIO_I2C_ADDRESS);
+      AudioOutCodecDevice = 0;
       /* Initialize the audio driver structure */
       audio_drv = &wm8994_drv;
       ret = AUDIO_OK;
@@ -1411,14 +1491,42 @@ void BSP_AUDIO_IN_DeInit(void)
 {
   BSP_AUDIO_IN_MspDeInit();
   
+  /* the PLL may be set by the application meanwhile, it is locked again on next init */
   if(AudioIn_Device == INPUT_DEVICE_DIGITAL_MIC)
   {
     DFSDMx_DeInit();
+    AudioInClockFamily = AUDIO_CLOCK_FAMILY_NONE;
   }
   else
   {
     SAIx_In_DeInit();
+    AudioOutClockFamily = AUDIO_CLOCK_FAMILY_NONE;
+  }
+}
+
+/**
+  * @brief  Updates the audio in frequency, the recording must be stopped.
+  * @param  AudioFreq: Audio frequency to be configured.
+  * @note   This API should be called after BSP_AUDIO_IN_Stop(), BSP_AUDIO_IN_Record() then restarts the
+  *         recording. With the digital microphones GPIO, DMA and interrupts are kept, only the DFSDM channels
+  *         and filters are set from the settings of the frequency and the PLLSAI is locked again when the
+  *         frequency family changes.
+  * @retval AUDIO_OK if correct communication, else wrong communication
+  */
+uint8_t BSP_AUDIO_IN_SetFrequency(uint32_t AudioFreq)
+{
+  if(AudioIn_Device == INPUT_DEVICE_DIGITAL_MIC)
+  {
+    if(DFSDMx_DeInit() != AUDIO_OK)
+    {
+      return AUDIO_ERROR;
+    }
+    BSP_AUDIO_IN_ClockConfig(&hAudioInTopLeftFilter, AudioFreq, NULL);
+    return DFSDMx_Init(AudioFreq);
   }
+  /* analog microphone : SAI and codec are initialized again */
+  BSP_AUDIO_IN_DeInit();
+  return BSP_AUDIO_IN_InitEx(AudioIn_Device, AudioFreq, DEFAULT_AUDIO_IN_BIT_RESOLUTION, AudioIn_ChannelNumber);
 }
 
 /**
@@ -1472,9 +1580,10 @@ void HAL_DFSDM_FilterRegConvCpltCallback(DFSDM_Filter_HandleTypeDef *hdfsdm_filt
 
 /**
   * @brief  BSP_AUDIO_IN_Get_PcmBuffer. 
-  * @note   Return last received PCM buffer from scratch buffer
-            
-  * @param  pbuf : Buffer where to copy samples.
+  * @note   Return last received PCM buffer from scratch buffer, interleaved in the channel order top left, top right
+            and, with 4 channels, bottom left, bottom right. Each frame is written with word stores, except the 6
+            bytes frames of 2 channels of 24 bit which are written byte per byte.
+  * @param  pbuf : Buffer where to copy samples, word aligned.
   * @param  sample_count : Number of samples to copy.
   * @param  ScratchOffset : Offset from where to begin copy.
   * @param  res :audio Resolution should be 2 or 3.
@@ -1482,30 +1591,66 @@ void HAL_DFSDM_FilterRegConvCpltCallback(DFSDM_Filter_HandleTypeDef *hdfsdm_filt
   */
 uint8_t BSP_AUDIO_IN_Get_PcmBuffer(uint8_t* pbuf, uint16_t sample_count, uint16_t ScratchOffset, uint8_t res)
 {
-  if( res == 2)
+  int32_t *top_left, *top_right, *buttom_left, *buttom_right;
+  uint32_t *pbuf32 = (uint32_t*)pbuf;
+  uint32_t s0, s1, s2, s3;
+  uint32_t i;
+  
+  top_left     = pScratchBuff[1] + ScratchOffset;
+  top_right    = pScratchBuff[0] + ScratchOffset;
+  buttom_left  = pScratchBuff[3] + ScratchOffset;
+  buttom_right = pScratchBuff[2] + ScratchOffset;
+  
+  if(res == 2)
   {
-    uint16_t*  pbuf16 =(uint16_t*)pbuf;
-    
-    for(int i = 0, j = ScratchOffset; j < (ScratchOffset + sample_count); j++)
+    if(AudioIn_ChannelNumber > 2)
     {
-      pbuf16[i++] = (uint16_t)(SaturaLH((pScratchBuff[1][j] >> 8), -32760, 32760));
-      pbuf16[i++] = (uint16_t)(SaturaLH((pScratchBuff[0][j] >> 8), -32760, 32760));
+      for(i = 0; i < sample_count; i++)
+      {
+        pbuf32[0] = DFSDMx_PACK16(top_left[i], top_right[i]);
+        pbuf32[1] = DFSDMx_PACK16(buttom_left[i], buttom_right[i]);
+        pbuf32 += 2;
+      }
+    }
+    else
+    {
+      for(i = 0; i < sample_count; i++)
+      {
+        *pbuf32++ = DFSDMx_PACK16(top_left[i], top_right[i]);
+      }
     }
   }
   else
   {
-    uint32_t sample ;
-    
-    for(int i = 0, j = ScratchOffset; j < (ScratchOffset + sample_count); j++)
+    if(AudioIn_ChannelNumber > 2)
     {
-      sample = (uint32_t)(SaturaLH((pScratchBuff[1][j] ), -8388600, 8388600));
-      pbuf[i++] =(sample)&0xFF;
-      pbuf[i++] =(sample>>8)&0xFF;
-      pbuf[i++] =(sample>>16)&0xFF;
-      sample = (uint32_t)(SaturaLH((pScratchBuff[0][j] ), -8388600, 8388600));
-      pbuf[i++] =(sample)&0xFF;
-      pbuf[i++] =(sample>>8)&0xFF;
-      pbuf[i++] =(sample>>16)&0xFF;   
+      /* 4 packed samples of 24 bit are 3 words */
+      for(i = 0; i < sample_count; i++)
+      {
+        s0 = DFSDMx_SAT24(top_left[i]);
+        s1 = DFSDMx_SAT24(top_right[i]);
+        s2 = DFSDMx_SAT24(buttom_left[i]);
+        s3 = DFSDMx_SAT24(buttom_right[i]);
+        pbuf32[0] = (s0 & 0xFFFFFFU) | (s1 << 24);
+        pbuf32[1] = ((s1 >> 8) & 0xFFFFU) | (s2 << 16);
+        pbuf32[2] = ((s2 >> 16) & 0xFFU) | (s3 << 8);
+        pbuf32 += 3;
+      }
+    }
+    else
+    {
+      for(i = 0; i < sample_count; i++)
+      {
+        s0 = DFSDMx_SAT24(top_left[i]);
+        s1 = DFSDMx_SAT24(top_right[i]);
+        pbuf[0] = s0 & 0xFF;
+        pbuf[1] = (s0 >> 8) & 0xFF;
+        pbuf[2] = (s0 >> 16) & 0xFF;
+        pbuf[3] = s1 & 0xFF;
+        pbuf[4] = (s1 >> 8) & 0xFF;
+        pbuf[5] = (s1 >> 16) & 0xFF;
+        pbuf += 6;
+      }
     }
   }
   return 0;
@@ -1667,7 +1812,11 @@ __weak void BSP_AUDIO_IN_ClockConfig(DFSDM_Filter_HandleTypeDef *hdfsdm_filter,
   HAL_RCCEx_GetPeriphCLKConfig(&rcc_ex_clk_init_struct);
   
   /* Set the PLL configuration according to the audio frequency */
-  if((AudioFreq == AUDIO_FREQUENCY_11K) || (AudioFreq == AUDIO_FREQUENCY_22K) || (AudioFreq == AUDIO_FREQUENCY_44K))
+  if(AUDIO_CLOCK_FAMILY(AudioFreq) == AudioInClockFamily)
+  {
+    /* PLLSAI already locked on the family, the DFSDM divider is set by DFSDMx_Init() */
+  }
+  else if(AUDIO_CLOCK_FAMILY(AudioFreq) == AUDIO_CLOCK_FAMILY_11K)
   {
     /* Configure PLLSAI prescalers */
     /* PLLSAI_VCO: VCO_429M 
@@ -1696,6 +1845,7 @@ __weak void BSP_AUDIO_IN_ClockConfig(DFSDM_Filter_HandleTypeDef *hdfsdm_filter,
     
     HAL_RCCEx_PeriphCLKConfig(&rcc_ex_clk_init_struct);
   }
+  AudioInClockFamily = AUDIO_CLOCK_FAMILY(AudioFreq);
     rcc_ex_clk_init_struct.PeriphClockSelection = RCC_PERIPHCLK_DFSDM1_AUDIO;
   rcc_ex_clk_init_struct.Dfsdm1AudioClockSelection = RCC_DFSDM1AUDIOCLKSOURCE_SAI2;
   HAL_RCCEx_PeriphCLKConfig(&rcc_ex_clk_init_struct); 
@@ -1714,6 +1864,8 @@ __weak void BSP_AUDIO_IN_ClockConfig(DFSDM_Filter_HandleTypeDef *hdfsdm_filter,
   */
 static uint8_t DFSDMx_Init(uint32_t AudioFreq)
 {
+  const DFSDMx_RateConfigTypeDef* rate = DFSDMx_GetRateConfig(AudioFreq);
+
   /****************************************************************************/ 
   /********************** Channels configuration  *****************************/
   /****************************************************************************/ 
@@ -1723,19 +1875,19 @@ static uint8_t DFSDMx_Init(uint32_t AudioFreq)
   hAudioInTopLeftChannel.Init.OutputClock.Activation   = ENABLE;
   hAudioInTopLeftChannel.Init.OutputClock.Selection    = DFSDM_CHANNEL_OUTPUT_CLOCK_AUDIO;
   /* Set the DFSDM clock OUT audio frequency configuration */
-  hAudioInTopLeftChannel.Init.OutputClock.Divider      = DFSDM_CLOCK_DIVIDER(AudioFreq);
+  hAudioInTopLeftChannel.Init.OutputClock.Divider      = rate->ClockDivider;
   hAudioInTopLeftChannel.Init.Input.Multiplexer        = DFSDM_CHANNEL_EXTERNAL_INPUTS;
   hAudioInTopLeftChannel.Init.Input.DataPacking        = DFSDM_CHANNEL_STANDARD_MODE;
   hAudioInTopLeftChannel.Init.Input.Pins               = DFSDM_CHANNEL_SAME_CHANNEL_PINS;
   /* Request to sample stable data for LEFT micro on Rising edge */
   hAudioInTopLeftChannel.Init.SerialInterface.Type     = DFSDM_CHANNEL_SPI_RISING;
   hAudioInTopLeftChannel.Init.SerialInterface.SpiClock = DFSDM_CHANNEL_SPI_CLOCK_INTERNAL;
-  hAudioInTopLeftChannel.Init.Awd.FilterOrder          = DFSDM_FILTER_ORDER(AudioFreq);
-  hAudioInTopLeftChannel.Init.Awd.Oversampling         = DFSDM_OVER_SAMPLING(AudioFreq);
+  hAudioInTopLeftChannel.Init.Awd.FilterOrder          = rate->FilterOrder;
+  hAudioInTopLeftChannel.Init.Awd.Oversampling         = rate->OverSampling;
 //  hAudioInTopLeftChannel.Init.Awd.FilterOrder          = DFSDM_CHANNEL_FASTSINC_ORDER;
 //  hAudioInTopLeftChannel.Init.Awd.Oversampling         = 10;
   hAudioInTopLeftChannel.Init.Offset                   = 0;
-  hAudioInTopLeftChannel.Init.RightBitShift            = DFSDM_RIGHT_BIT_SHIFT(AudioFreq);
+  hAudioInTopLeftChannel.Init.RightBitShift            = rate->RightBitShift;
   if(HAL_OK != HAL_DFSDM_ChannelInit(&hAudioInTopLeftChannel))
   {
     return AUDIO_ERROR;
@@ -1747,7 +1899,7 @@ static uint8_t DFSDMx_Init(uint32_t AudioFreq)
   hAudioInTopRightChannel.Init.OutputClock.Activation   = ENABLE;
   hAudioInTopRightChannel.Init.OutputClock.Selection    = DFSDM_CHANNEL_OUTPUT_CLOCK_AUDIO;
   /* Set the DFSDM clock OUT audio frequency configuration */
-  hAudioInTopRightChannel.Init.OutputClock.Divider      = DFSDM_CLOCK_DIVIDER(AudioFreq);
+  hAudioInTopRightChannel.Init.OutputClock.Divider      = rate->ClockDivider;
   hAudioInTopRightChannel.Init.Input.Multiplexer        = DFSDM_CHANNEL_EXTERNAL_INPUTS;
   hAudioInTopRightChannel.Init.Input.DataPacking        = DFSDM_CHANNEL_STANDARD_MODE;
   hAudioInTopRightChannel.Init.Input.Pins               = DFSDM_CHANNEL_FOLLOWING_CHANNEL_PINS;
@@ -1757,7 +1909,7 @@ static uint8_t DFSDMx_Init(uint32_t AudioFreq)
   hAudioInTopRightChannel.Init.Awd.FilterOrder          = DFSDM_CHANNEL_FASTSINC_ORDER;
   hAudioInTopRightChannel.Init.Awd.Oversampling         = 10;
   hAudioInTopRightChannel.Init.Offset                   = 0;
-  hAudioInTopRightChannel.Init.RightBitShift            = DFSDM_RIGHT_BIT_SHIFT(AudioFreq);
+  hAudioInTopRightChannel.Init.RightBitShift            = rate->RightBitShift;
   if(HAL_OK != HAL_DFSDM_ChannelInit(&hAudioInTopRightChannel))
   {
     return AUDIO_ERROR;
@@ -1771,7 +1923,7 @@ static uint8_t DFSDMx_Init(uint32_t AudioFreq)
     hAudioInButtomLeftChannel.Init.OutputClock.Activation   = ENABLE;
     hAudioInButtomLeftChannel.Init.OutputClock.Selection    = DFSDM_CHANNEL_OUTPUT_CLOCK_AUDIO;
     /* Set the DFSDM clock OUT audio frequency configuration */
-    hAudioInButtomLeftChannel.Init.OutputClock.Divider      = DFSDM_CLOCK_DIVIDER(AudioFreq);
+    hAudioInButtomLeftChannel.Init.OutputClock.Divider      = rate->ClockDivider;
     hAudioInButtomLeftChannel.Init.Input.Multiplexer        = DFSDM_CHANNEL_EXTERNAL_INPUTS;
     hAudioInButtomLeftChannel.Init.Input.DataPacking        = DFSDM_CHANNEL_STANDARD_MODE;
     hAudioInButtomLeftChannel.Init.Input.Pins               = DFSDM_CHANNEL_SAME_CHANNEL_PINS;
@@ -1781,7 +1933,7 @@ static uint8_t DFSDMx_Init(uint32_t AudioFreq)
     hAudioInButtomLeftChannel.Init.Awd.FilterOrder          = DFSDM_CHANNEL_FASTSINC_ORDER;
     hAudioInButtomLeftChannel.Init.Awd.Oversampling         = 10;
     hAudioInButtomLeftChannel.Init.Offset                   = 0;
-    hAudioInButtomLeftChannel.Init.RightBitShift            = DFSDM_RIGHT_BIT_SHIFT(AudioFreq);
+    hAudioInButtomLeftChannel.Init.RightBitShift            = rate->RightBitShift;
     if(HAL_OK != HAL_DFSDM_ChannelInit(&hAudioInButtomLeftChannel))
     {
       return AUDIO_ERROR;
@@ -1793,7 +1945,7 @@ static uint8_t DFSDMx_Init(uint32_t AudioFreq)
     hAudioInButtomRightChannel.Init.OutputClock.Activation   = ENABLE;
     hAudioInButtomRightChannel.Init.OutputClock.Selection    = DFSDM_CHANNEL_OUTPUT_CLOCK_AUDIO;
     /* Set the DFSDM clock OUT audio frequency configuration */
-    hAudioInButtomRightChannel.Init.OutputClock.Divider      = DFSDM_CLOCK_DIVIDER(AudioFreq);
+    hAudioInButtomRightChannel.Init.OutputClock.Divider      = rate->ClockDivider;
     hAudioInButtomRightChannel.Init.Input.Multiplexer        = DFSDM_CHANNEL_EXTERNAL_INPUTS;
     hAudioInButtomRightChannel.Init.Input.DataPacking        = DFSDM_CHANNEL_STANDARD_MODE;
     hAudioInButtomRightChannel.Init.Input.Pins               = DFSDM_CHANNEL_FOLLOWING_CHANNEL_PINS;
@@ -1803,7 +1955,7 @@ static uint8_t DFSDMx_Init(uint32_t AudioFreq)
     hAudioInButtomRightChannel.Init.Awd.FilterOrder          = DFSDM_CHANNEL_FASTSINC_ORDER;
     hAudioInButtomRightChannel.Init.Awd.Oversampling         = 10;
     hAudioInButtomRightChannel.Init.Offset                   = 0;
-    hAudioInButtomRightChannel.Init.RightBitShift            = DFSDM_RIGHT_BIT_SHIFT(AudioFreq);
+    hAudioInButtomRightChannel.Init.RightBitShift            = rate->RightBitShift;
     if(HAL_OK != HAL_DFSDM_ChannelInit(&hAudioInButtomRightChannel))
     {
       return AUDIO_ERROR;
@@ -1824,9 +1976,9 @@ static uint8_t DFSDMx_Init(uint32_t AudioFreq)
   hAudioInTopLeftFilter.Init.InjectedParam.DmaMode        = DISABLE;
   hAudioInTopLeftFilter.Init.InjectedParam.ExtTrigger     = DFSDM_FILTER_EXT_TRIG_TIM1_TRGO;
   hAudioInTopLeftFilter.Init.InjectedParam.ExtTriggerEdge = DFSDM_FILTER_EXT_TRIG_RISING_EDGE;
-  hAudioInTopLeftFilter.Init.FilterParam.SincOrder        = DFSDM_FILTER_ORDER(AudioFreq);
+  hAudioInTopLeftFilter.Init.FilterParam.SincOrder        = rate->FilterOrder;
   /* Set the DFSDM Filters Oversampling to have correct sample rate */
-  hAudioInTopLeftFilter.Init.FilterParam.Oversampling     = DFSDM_OVER_SAMPLING(AudioFreq);
+  hAudioInTopLeftFilter.Init.FilterParam.Oversampling     = rate->OverSampling;
   hAudioInTopLeftFilter.Init.FilterParam.IntOversampling  = 1;
   if(HAL_OK != HAL_DFSDM_FilterInit(&hAudioInTopLeftFilter))
   {
@@ -1850,9 +2002,9 @@ static uint8_t DFSDMx_Init(uint32_t AudioFreq)
   hAudioInTopRightFilter.Init.InjectedParam.DmaMode        = DISABLE;
   hAudioInTopRightFilter.Init.InjectedParam.ExtTrigger     = DFSDM_FILTER_EXT_TRIG_TIM1_TRGO;
   hAudioInTopRightFilter.Init.InjectedParam.ExtTriggerEdge = DFSDM_FILTER_EXT_TRIG_RISING_EDGE;
-  hAudioInTopRightFilter.Init.FilterParam.SincOrder        = DFSDM_FILTER_ORDER(AudioFreq);
+  hAudioInTopRightFilter.Init.FilterParam.SincOrder        = rate->FilterOrder;
   /* Set the DFSDM Filters Oversampling to have correct sample rate */
-  hAudioInTopRightFilter.Init.FilterParam.Oversampling     = DFSDM_OVER_SAMPLING(AudioFreq);
+  hAudioInTopRightFilter.Init.FilterParam.Oversampling     = rate->OverSampling;
   hAudioInTopRightFilter.Init.FilterParam.IntOversampling  = 1;
   if(HAL_OK != HAL_DFSDM_FilterInit(&hAudioInTopRightFilter))
   {
@@ -1877,9 +2029,9 @@ static uint8_t DFSDMx_Init(uint32_t AudioFreq)
     hAudioInButtomLeftFilter.Init.InjectedParam.DmaMode        = DISABLE;
     hAudioInButtomLeftFilter.Init.InjectedParam.ExtTrigger     = DFSDM_FILTER_EXT_TRIG_TIM1_TRGO;
     hAudioInButtomLeftFilter.Init.InjectedParam.ExtTriggerEdge = DFSDM_FILTER_EXT_TRIG_RISING_EDGE;
-    hAudioInButtomLeftFilter.Init.FilterParam.SincOrder        = DFSDM_FILTER_ORDER(AudioFreq);
+    hAudioInButtomLeftFilter.Init.FilterParam.SincOrder        = rate->FilterOrder;
     /* Set the DFSDM Filters Oversampling to have correct sample rate */
-    hAudioInButtomLeftFilter.Init.FilterParam.Oversampling     = DFSDM_OVER_SAMPLING(AudioFreq);
+    hAudioInButtomLeftFilter.Init.FilterParam.Oversampling     = rate->OverSampling;
     hAudioInButtomLeftFilter.Init.FilterParam.IntOversampling  = 1;
     if(HAL_OK != HAL_DFSDM_FilterInit(&hAudioInButtomLeftFilter))
     {
@@ -1903,9 +2055,9 @@ static uint8_t DFSDMx_Init(uint32_t AudioFreq)
     hAudioInButtomRightFilter.Init.InjectedParam.DmaMode        = DISABLE;
     hAudioInButtomRightFilter.Init.InjectedParam.ExtTrigger     = DFSDM_FILTER_EXT_TRIG_TIM1_TRGO;
     hAudioInButtomRightFilter.Init.InjectedParam.ExtTriggerEdge = DFSDM_FILTER_EXT_TRIG_RISING_EDGE;
-    hAudioInButtomRightFilter.Init.FilterParam.SincOrder        = DFSDM_FILTER_ORDER(AudioFreq);
+    hAudioInButtomRightFilter.Init.FilterParam.SincOrder        = rate->FilterOrder;
     /* Set the DFSDM Filters Oversampling to have correct sample rate */
-    hAudioInButtomRightFilter.Init.FilterParam.Oversampling     = DFSDM_OVER_SAMPLING(AudioFreq);
+    hAudioInButtomRightFilter.Init.FilterParam.Oversampling     = rate->OverSampling;
     hAudioInButtomRightFilter.Init.FilterParam.IntOversampling  = 1;
     if(HAL_OK != HAL_DFSDM_FilterInit(&hAudioInButtomRightFilter))
     {
@@ -1920,6 +2072,25 @@ static uint8_t DFSDMx_Init(uint32_t AudioFreq)
   return AUDIO_OK;
 }
 
+/**
+  * @brief  Looks up the DFSDM settings of a frequency.
+  * @param  AudioFreq: Audio frequency.
+  * @retval settings of the frequency, the last entry of the table if it is missing
+  */
+static const DFSDMx_RateConfigTypeDef* DFSDMx_GetRateConfig(uint32_t AudioFreq)
+{
+  uint32_t i;
+
+  for(i = 0; i < (sizeof(DFSDMx_RateConfigs)/sizeof(DFSDMx_RateConfigs[0])) - 1U; i++)
+  {
+    if(DFSDMx_RateConfigs[i].Frequency == AudioFreq)
+    {
+      break;
+    }
+  }
+  return &DFSDMx_RateConfigs[i];
+}
+
 /**
   * @brief  De-initialize the Digital Filter for Sigma-Delta Modulators interface (DFSDM).
   * @retval AUDIO_OK if correct communication, else wrong communication
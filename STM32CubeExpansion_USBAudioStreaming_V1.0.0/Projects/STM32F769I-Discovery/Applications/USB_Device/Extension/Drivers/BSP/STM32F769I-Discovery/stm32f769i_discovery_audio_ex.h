@@ -9,7 +9,8 @@
   *                                - AUDIO_OUT_SAIx_DMAx_PERIPH_DATA_SIZE
   *                                  & AUDIO_OUT_SAIx_DMAx_MEM_DATA_SIZE:  modified to support 24bit (32bit with padding)
   *                                - AUDIO_OUT_IRQ_PREPRIO &AUDIO_IN_IRQ_PREPRIO :prioritize audio interrupts.
-  *                                - BSP_AUDIO_IN_Get_PcmBuffer : added  to  get PCM sample 24/16 bit.
+  *                                - BSP_AUDIO_IN_Get_PcmBuffer : added  to  get PCM sample 24/16 bit
+  *                                  of the 2 top or of the 4 microphones.
   *                                
   ******************************************************************************
   * @attention
@@ -258,6 +259,7 @@ uint8_t BSP_AUDIO_OUT_Init_Ext(uint16_t OutputDevice, uint8_t Volume, uint32_t A
 void    BSP_AUDIO_OUT_DeInit(void);
 uint8_t BSP_AUDIO_OUT_Play(uint16_t* pBuffer, uint32_t Size);
 void    BSP_AUDIO_OUT_ChangeBuffer(uint16_t *pData, uint16_t Size);
+void    BSP_AUDIO_OUT_SetDMACircular(uint8_t Circular);
 uint8_t BSP_AUDIO_OUT_Pause(void);
 uint8_t BSP_AUDIO_OUT_Resume(void);
 uint8_t BSP_AUDIO_OUT_Stop(uint32_t Option);
@@ -265,6 +267,8 @@ uint8_t BSP_AUDIO_OUT_SetVolume(uint8_t Volume);
 void    BSP_AUDIO_OUT_SetFrequency(uint32_t AudioFreq);
 void    BSP_AUDIO_OUT_SetAudioFrameSlot(uint32_t AudioFrameSlot);
 uint8_t BSP_AUDIO_OUT_SetMute(uint32_t Cmd);
+void    BSP_AUDIO_OUT_HoldCodecWrites(void);
+uint8_t BSP_AUDIO_OUT_FlushCodecWrites(void);
 uint8_t BSP_AUDIO_OUT_SetOutputMode(uint8_t Output);
 
 /* User Callbacks: user has to implement these functions in his code if they are needed. */
@@ -296,6 +300,7 @@ uint8_t BSP_AUDIO_IN_InitEx(uint16_t InputDevice, uint32_t AudioFreq, uint32_t B
 uint8_t BSP_AUDIO_IN_AllocScratch (int32_t *pScratch, uint32_t size);
 uint8_t BSP_AUDIO_IN_GetChannelNumber(void);
 void    BSP_AUDIO_IN_DeInit(void);
+uint8_t BSP_AUDIO_IN_SetFrequency(uint32_t AudioFreq);
 uint8_t BSP_AUDIO_IN_Record(uint16_t *pData, uint32_t Size);
 uint8_t BSP_AUDIO_IN_Stop(void);
 uint8_t BSP_AUDIO_IN_Pause(void);
@@ -0,0 +1,304 @@
+/**
+  ******************************************************************************
+  * @file    audio_beamformer_test.c
+  * @author  MCD Application Team
+  * @brief   host test of the beamformer node (Projects/Common/Streaming/Src/audio_beamformer_node.c) :
+  *          directivity on synthetic plane waves against the ideal delay and
+  *          sum response, steering changes, array size limits and parameters
+  *          checks, then benchmarks. See readme.txt.
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2019  STMicroelectronics.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by ST under Ultimate Liberty license
+  * SLA0044, the "License"; You may not use this file except in compliance with
+  * the License. You may obtain a copy of the License at:
+  *                             www.st.com/SLA0044
+  *
+  ******************************************************************************
+  */
+/* Includes ------------------------------------------------------------------*/
+#include <math.h>
+#include "audio_nodes_test.h"
+#include "audio_beamformer_node.h"
+
+/* Private defines -----------------------------------------------------------*/
+#define TEST_FREQUENCY                  48000U
+#define TEST_FRAMES                     48U
+#define TEST_MICS                       4U
+#define TEST_BEAMS                      2U
+#define TEST_SAMPLES                    (TEST_FRAMES * TEST_MICS)
+#define TEST_PI                         3.14159265358979323846
+/* plane wave amplitude, measures skip the blocks filling the history */
+#define TEST_LEVEL                      0.5
+#define TEST_MEASURE_BLOCKS             40U
+#define TEST_SETTLE_BLOCKS              2U
+/* measured beams against the ideal delay and sum */
+#define TEST_TOLERANCE_DB               0.1
+/* directions of the directivity fixtures in degrees */
+#define TEST_ANGLE_STEP                 15
+
+/* Private variables ---------------------------------------------------------*/
+static AUDIO_BeamformerNode_t BeamformerNode;
+static AUDIO_Graph_t Graph;
+static uint32_t Scratch[TEST_SAMPLES];
+static uint32_t Block[TEST_SAMPLES];
+static AUDIO_GraphPort_t Port;
+static uint32_t Time;
+/* microphones of the F769 Discovery, default USB_AUDIO_CONFIG_RECORD_BEAM_MICS of the application */
+static const AUDIO_BeamformerMic_t Mics[TEST_MICS] = {{-10.5f, 10.5f}, {10.5f, 10.5f}, {-10.5f, -10.5f}, {10.5f, -10.5f}};
+
+/* Private functions ---------------------------------------------------------*/
+/**
+  * @brief  TEST_BeamformerPlan
+  *         Builds and plans a graph of the beamformer node alone, beam 1 steered to 0 and beam 2 to 90 degrees.
+  * @param  format(IN):      AUDIO_GRAPH_FORMAT_xxx
+  * @param  mics_count(IN):  microphones count, the first ones of Mics
+  * @param  beams_count(IN): beams count
+  * @retval None
+  */
+static void  TEST_BeamformerPlan(uint8_t format, uint8_t mics_count, uint8_t beams_count)
+{
+  TEST_CHECK(AUDIO_BeamformerInit(&BeamformerNode, Mics, mics_count, beams_count) == 0, "init");
+  if(beams_count > 1)
+  {
+    TEST_CHECK(AUDIO_BeamformerSetAngle(&BeamformerNode, 2, 90) == 0, "steer beam 2");
+  }
+  AUDIO_GraphInit(&Graph, (uint8_t*)Scratch, sizeof(Scratch));
+  AUDIO_GraphAddNode(&Graph, &BeamformerNode.processing);
+  Port.frequency = TEST_FREQUENCY;
+  Port.channels_count = mics_count;
+  Port.format = format;
+  TEST_CHECK(AUDIO_GraphPlan(&Graph, &Port) == 0, "plan");
+  Time = 0;
+}
+
+/**
+  * @brief  TEST_BeamformerIdeal
+  *         Response of an ideal delay and sum of Mics to a plane wave.
+  * @param  steering_deg(IN): beam direction
+  * @param  source_deg(IN):   plane wave direction
+  * @param  frequency(IN):    plane wave frequency
+  * @retval gain in db
+  */
+static double  TEST_BeamformerIdeal(int steering_deg, int source_deg, double frequency)
+{
+  double steering = steering_deg * TEST_PI / 180.0, source = source_deg * TEST_PI / 180.0;
+  double re = 0, im = 0, advance;
+
+  for(uint32_t m = 0; m < TEST_MICS; m++)
+  {
+    advance = (Mics[m].x_mm * (sin(source) - sin(steering)) + Mics[m].y_mm * (cos(source) - cos(steering))) /
+              AUDIO_BEAMFORMER_SOUND_SPEED_MM_S;
+    re += cos(2.0 * TEST_PI * frequency * advance);
+    im += sin(2.0 * TEST_PI * frequency * advance);
+  }
+  return 10.0 * log10((re * re + im * im) / (TEST_MICS * TEST_MICS));
+}
+
+/**
+  * @brief  TEST_BeamformerCapture
+  *         Feeds the microphones with a plane wave for blocks blocks and measures the beams level over the blocks
+  *         after the first skip ones. The wave goes on from the previous capture.
+  * @param  source_deg(IN):  plane wave direction
+  * @param  frequency(IN):   plane wave frequency, whole periods per block
+  * @param  blocks(IN):      processed blocks count
+  * @param  skip(IN):        blocks not measured
+  * @param  gain_db(OUT):    level of each beam relative to the wave
+  * @retval None
+  */
+static void  TEST_BeamformerCapture(int source_deg, double frequency, uint32_t blocks, uint32_t skip,
+                                    double* gain_db)
+{
+  double source = source_deg * TEST_PI / 180.0, advance, energy[AUDIO_BEAMFORMER_MAX_BEAMS] = {0}, sample;
+  uint8_t mics_count = BeamformerNode.mics_count, beams_count = BeamformerNode.beams_count;
+
+  for(uint32_t b = 0; b < blocks; b++)
+  {
+    for(uint32_t f = 0; f < TEST_FRAMES; f++)
+    {
+      for(uint32_t m = 0; m < mics_count; m++)
+      {
+        /* the wave reaches first the microphones nearest to the source */
+        advance = (Mics[m].x_mm * sin(source) + Mics[m].y_mm * cos(source)) / AUDIO_BEAMFORMER_SOUND_SPEED_MM_S;
+        TEST_WriteSample((uint8_t*)Block, Port.format, f * mics_count + m,
+                         TEST_LEVEL * sin(2.0 * TEST_PI * frequency * ((double)(Time + f) / TEST_FREQUENCY + advance)));
+      }
+    }
+    Time += TEST_FRAMES;
+    TEST_CHECK(AUDIO_GraphProcess(&Graph, &Port, (uint8_t*)Block, (uint16_t)(TEST_FRAMES * AUDIO_GRAPH_FRAME_SIZE(&Port))) == 0,
+               "process");
+    for(uint32_t f = 0; (b >= skip) && (f < TEST_FRAMES); f++)
+    {
+      for(uint32_t n = 0; n < beams_count; n++)
+      {
+        sample = TEST_ReadSample((const uint8_t*)Block, Port.format, f * beams_count + n);
+        energy[n] += sample * sample;
+      }
+    }
+  }
+  for(uint32_t n = 0; n < beams_count; n++)
+  {
+    gain_db[n] = 10.0 * log10(energy[n] / (TEST_LEVEL * TEST_LEVEL / 2.0 * (blocks - skip) * TEST_FRAMES) + 1e-20);
+  }
+}
+
+/**
+  * @brief  TEST_BeamformerDirectivity
+  *         Measures both beams for plane waves from all around in all formats and compares them with the ideal
+  *         delay and sum, the interpolated delays follow it down to its nulls.
+  * @param  None
+  * @retval None
+  */
+static void  TEST_BeamformerDirectivity(void)
+{
+  static const uint8_t formats[] = {AUDIO_GRAPH_FORMAT_S16, AUDIO_GRAPH_FORMAT_S24, AUDIO_GRAPH_FORMAT_S32};
+  static const double frequencies[] = {1000.0, 3000.0, 6000.0};
+  static const int steering[TEST_BEAMS] = {0, 90};
+  double gain_db[TEST_BEAMS], ideal, error, max_error = 0;
+
+  for(uint32_t i = 0; i < sizeof(formats); i++)
+  {
+    TEST_BeamformerPlan(formats[i], TEST_MICS, TEST_BEAMS);
+    TEST_CHECK(Graph.ports[1].channels_count == TEST_BEAMS, "%u output channels", Graph.ports[1].channels_count);
+    TEST_CHECK(Graph.latency_frames == 1, "latency %u frames", Graph.latency_frames);
+    for(uint32_t k = 0; k < sizeof(frequencies) / sizeof(frequencies[0]); k++)
+    {
+      if((i == 0) && (k == sizeof(frequencies) / sizeof(frequencies[0]) - 1))
+      {
+        printf("directivity at %.0f Hz, db  angle : beam 0 deg (ideal), beam 90 deg (ideal)\n", frequencies[k]);
+      }
+      for(int source = -AUDIO_BEAMFORMER_MAX_ANGLE; source <= AUDIO_BEAMFORMER_MAX_ANGLE; source += TEST_ANGLE_STEP)
+      {
+        TEST_BeamformerCapture(source, frequencies[k], TEST_MEASURE_BLOCKS, TEST_SETTLE_BLOCKS, gain_db);
+        for(uint32_t n = 0; n < TEST_BEAMS; n++)
+        {
+          ideal = TEST_BeamformerIdeal(steering[n], source, frequencies[k]);
+          error = fabs(gain_db[n] - ideal);
+          TEST_CHECK(error < TEST_TOLERANCE_DB, "format %u %.0f Hz beam %d deg source %d deg : %.2f db instead of %.2f",
+                     formats[i], frequencies[k], steering[n], source, gain_db[n], ideal);
+          max_error = (error > max_error)? error : max_error;
+        }
+        if((i == 0) && (k == sizeof(frequencies) / sizeof(frequencies[0]) - 1) && (source % 30 == 0))
+        {
+          printf("  %4d : %6.1f (%6.1f)  %6.1f (%6.1f)\n", source, gain_db[0],
+                 TEST_BeamformerIdeal(steering[0], source, frequencies[k]), gain_db[1],
+                 TEST_BeamformerIdeal(steering[1], source, frequencies[k]));
+        }
+      }
+    }
+  }
+  printf("directivity max error %.3f db\n", max_error);
+}
+
+/**
+  * @brief  TEST_BeamformerSteer
+  *         An angle set between two blocks steers the next block, for one beam or for all.
+  * @param  None
+  * @retval None
+  */
+static void  TEST_BeamformerSteer(void)
+{
+  double gain_db[TEST_BEAMS];
+
+  TEST_BeamformerPlan(AUDIO_GRAPH_FORMAT_S16, TEST_MICS, TEST_BEAMS);
+  TEST_BeamformerCapture(-90, 6000.0, TEST_MEASURE_BLOCKS, TEST_SETTLE_BLOCKS, gain_db);
+  TEST_CHECK(fabs(gain_db[0] - TEST_BeamformerIdeal(0, -90, 6000.0)) < TEST_TOLERANCE_DB,
+             "source at -90 deg in the 0 deg beam : %.2f db", gain_db[0]);
+  TEST_CHECK(AUDIO_BeamformerSetAngle(&BeamformerNode, 1, -90) == 0, "steer beam 1");
+  TEST_BeamformerCapture(-90, 6000.0, 1, 0, gain_db);
+  TEST_CHECK(fabs(gain_db[0]) < TEST_TOLERANCE_DB, "first block steered to -90 deg : %.2f db", gain_db[0]);
+  TEST_CHECK(fabs(gain_db[1] - TEST_BeamformerIdeal(90, -90, 6000.0)) < TEST_TOLERANCE_DB, "beam 2 moved : %.2f db",
+             gain_db[1]);
+  /* the source moves first, the history holds its wave when the beams follow */
+  TEST_BeamformerCapture(180, 6000.0, 1, 0, gain_db);
+  TEST_CHECK(AUDIO_BeamformerSetAngle(&BeamformerNode, 0, 180) == 0, "steer all beams");
+  TEST_BeamformerCapture(180, 6000.0, 1, 0, gain_db);
+  TEST_CHECK((fabs(gain_db[0]) < TEST_TOLERANCE_DB) && (fabs(gain_db[1]) < TEST_TOLERANCE_DB), "first block steered to 180 deg : %.2f %.2f db",
+             gain_db[0], gain_db[1]);
+}
+
+/**
+  * @brief  TEST_BeamformerParams
+  *         Invalid counts, angles and channels are refused, arrays too large for the history at the stream rate
+  *         are refused on plan and keep their previous steering on an angle change.
+  * @param  None
+  * @retval None
+  */
+static void  TEST_BeamformerParams(void)
+{
+  static const AUDIO_BeamformerMic_t pair[2] = {{-100.0f, 0.0f}, {100.0f, 0.0f}};
+  uint8_t active;
+
+  TEST_CHECK(AUDIO_BeamformerInit(&BeamformerNode, Mics, 0, 1) != 0, "no microphone");
+  TEST_CHECK(AUDIO_BeamformerInit(&BeamformerNode, Mics, AUDIO_BEAMFORMER_MAX_MICS + 1, 1) != 0, "microphones above max");
+  TEST_CHECK(AUDIO_BeamformerInit(&BeamformerNode, Mics, TEST_MICS, 0) != 0, "no beam");
+  TEST_CHECK(AUDIO_BeamformerInit(&BeamformerNode, Mics, TEST_MICS, AUDIO_BEAMFORMER_MAX_BEAMS + 1) != 0,
+             "beams above max");
+  TEST_BeamformerPlan(AUDIO_GRAPH_FORMAT_S16, TEST_MICS, TEST_BEAMS);
+  TEST_CHECK(AUDIO_BeamformerSetAngle(&BeamformerNode, 1, AUDIO_BEAMFORMER_MAX_ANGLE + 1) != 0, "angle above max");
+  TEST_CHECK(AUDIO_BeamformerSetAngle(&BeamformerNode, 1, -AUDIO_BEAMFORMER_MAX_ANGLE - 1) != 0, "angle below min");
+  TEST_CHECK(AUDIO_BeamformerSetAngle(&BeamformerNode, TEST_BEAMS + 1, 0) != 0, "beam above count");
+  Port.channels_count = TEST_MICS - 1;
+  TEST_CHECK(AUDIO_GraphPlan(&Graph, &Port) != 0, "a channel per microphone");
+
+  /* 200 mm pair : its broadside fits at 192 KHz, its end fire needs 112 samples of history */
+  TEST_CHECK(AUDIO_BeamformerInit(&BeamformerNode, pair, 2, 1) == 0, "pair init");
+  Port.frequency = 48000;
+  Port.channels_count = 2;
+  TEST_CHECK(AUDIO_BeamformerSetAngle(&BeamformerNode, 1, 90) == 0, "pair end fire");
+  TEST_CHECK(AUDIO_GraphPlan(&Graph, &Port) == 0, "pair end fire at 48 KHz");
+  Port.frequency = 192000;
+  TEST_CHECK(AUDIO_GraphPlan(&Graph, &Port) != 0, "pair end fire at 192 KHz");
+  TEST_CHECK(AUDIO_BeamformerSetAngle(&BeamformerNode, 1, 0) == 0, "pair broadside");
+  TEST_CHECK(AUDIO_GraphPlan(&Graph, &Port) == 0, "pair broadside at 192 KHz");
+  active = BeamformerNode.active;
+  TEST_CHECK(AUDIO_BeamformerSetAngle(&BeamformerNode, 1, 90) == 0, "pair end fire");
+  TEST_CHECK(AUDIO_GraphProcess(&Graph, &Port, (uint8_t*)Block, (uint16_t)(TEST_FRAMES * AUDIO_GRAPH_FRAME_SIZE(&Port))) == 0,
+             "process");
+  TEST_CHECK(BeamformerNode.active == active, "steering swapped to a design which doesn't fit");
+}
+
+/**
+  * @brief  TEST_BeamformerBench
+  *         Beams of the 4 microphones in 1 ms blocks.
+  * @param  None
+  * @retval None
+  */
+static void  TEST_BeamformerBench(void)
+{
+  double gain_db[TEST_BEAMS];
+
+  TEST_BeamformerPlan(AUDIO_GRAPH_FORMAT_S16, TEST_MICS, TEST_BEAMS);
+  TEST_BeamformerCapture(30, 1000.0, 1, 0, gain_db);
+  TEST_Bench("beamformer S16 4 mics 2 beams", &Graph, &Port, (uint8_t*)Block,
+             TEST_FRAMES * AUDIO_GRAPH_FRAME_SIZE(&Port));
+  TEST_BeamformerPlan(AUDIO_GRAPH_FORMAT_S16, TEST_MICS, 1);
+  TEST_BeamformerCapture(30, 1000.0, 1, 0, gain_db);
+  TEST_Bench("beamformer S16 4 mics 1 beam", &Graph, &Port, (uint8_t*)Block,
+             TEST_FRAMES * AUDIO_GRAPH_FRAME_SIZE(&Port));
+  TEST_BeamformerPlan(AUDIO_GRAPH_FORMAT_S32, TEST_MICS, TEST_BEAMS);
+  TEST_BeamformerCapture(30, 1000.0, 1, 0, gain_db);
+  TEST_Bench("beamformer S32 4 mics 2 beams", &Graph, &Port, (uint8_t*)Block,
+             TEST_FRAMES * AUDIO_GRAPH_FRAME_SIZE(&Port));
+}
+
+/* Exported functions --------------------------------------------------------*/
+/**
+  * @brief  main
+  *         Runs the checks then the benchmarks.
+  * @param  None
+  * @retval 0 if all checks passed
+  */
+int  main(void)
+{
+  TEST_BeamformerDirectivity();
+  TEST_BeamformerSteer();
+  TEST_BeamformerParams();
+  TEST_BeamformerBench();
+  return TEST_Report("audio_beamformer_test");
+}
+
+/************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
@@ -0,0 +1,395 @@
+/**
+  ******************************************************************************
+  * @file    audio_eq_test.c
+  * @author  MCD Application Team
+  * @brief   host test of the equalizer node (Projects/Common/Streaming/Src/audio_eq_node.c) :
+  *          band responses in both filter forms and all formats, per channel
+  *          bands, band slots, band changes while streaming without steps,
+  *          then benchmarks. See readme.txt.
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2019  STMicroelectronics.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by ST under Ultimate Liberty license
+  * SLA0044, the "License"; You may not use this file except in compliance with
+  * the License. You may obtain a copy of the License at:
+  *                             www.st.com/SLA0044
+  *
+  ******************************************************************************
+  */
+/* Includes ------------------------------------------------------------------*/
+#include <string.h>
+#include <math.h>
+#include "audio_nodes_test.h"
+#include "audio_eq_node.h"
+
+/* Private defines -----------------------------------------------------------*/
+#define TEST_FREQUENCY                  48000U
+#define TEST_FRAMES                     48U
+#define TEST_CHANNELS                   2U
+#define TEST_SAMPLES                    (TEST_FRAMES * TEST_CHANNELS)
+#define TEST_PI                         3.14159265358979323846
+#define TEST_AMPLITUDE                  0.25
+/* blocks filtered before and while measuring a response */
+#define TEST_SETTLE_BLOCKS              200U
+#define TEST_MEASURE_BLOCKS             100U
+
+/* Private variables ---------------------------------------------------------*/
+static AUDIO_EqNode_t EqNode;
+static AUDIO_Graph_t Graph;
+static uint32_t Scratch[TEST_SAMPLES];
+static uint32_t Block[TEST_SAMPLES];
+static AUDIO_GraphPort_t Port;
+static uint32_t Time;
+static const AUDIO_EqBand_t BandOff = {AUDIO_EQ_BAND_OFF, 0, 0.0f, 0};
+static const AUDIO_EqBand_t BandPeak = {AUDIO_EQ_BAND_PEAK, 1000, 1.4f, 6 * 256};
+static const AUDIO_EqBand_t BandHighPass = {AUDIO_EQ_BAND_HIGH_PASS, 40, 0.707f, 0};
+static const AUDIO_EqBand_t BandLowShelf = {AUDIO_EQ_BAND_LOW_SHELF, 100, 0.707f, 6 * 256};
+
+/* Private functions ---------------------------------------------------------*/
+/**
+  * @brief  TEST_EqInit
+  *         Builds a graph of the equalizer node alone, bands are set by the caller then the graph is planned.
+  * @param  form(IN):   AUDIO_EQ_DF1 or AUDIO_EQ_DF2T
+  * @param  format(IN): AUDIO_GRAPH_FORMAT_xxx
+  * @retval None
+  */
+static void  TEST_EqInit(uint8_t form, uint8_t format)
+{
+  AUDIO_EqInit(&EqNode, form);
+  AUDIO_GraphInit(&Graph, (uint8_t*)Scratch, sizeof(Scratch));
+  AUDIO_GraphAddNode(&Graph, &EqNode.processing);
+  Port.frequency = TEST_FREQUENCY;
+  Port.channels_count = TEST_CHANNELS;
+  Port.format = format;
+  Time = 0;
+}
+
+/**
+  * @brief  TEST_EqProcess
+  *         Filters the next block of a sine on both channels.
+  * @param  frequency(IN): sine frequency in Hz
+  * @param  output(OUT):   filtered samples of the block, left and right interleaved
+  * @retval None
+  */
+static void  TEST_EqProcess(double frequency, double* output)
+{
+  for(uint32_t f = 0; f < TEST_FRAMES; f++, Time++)
+  {
+    double value = TEST_AMPLITUDE * sin(2.0 * TEST_PI * frequency * Time / TEST_FREQUENCY);
+    TEST_WriteSample((uint8_t*)Block, Port.format, 2 * f, value);
+    TEST_WriteSample((uint8_t*)Block, Port.format, 2 * f + 1, value);
+  }
+  TEST_CHECK(AUDIO_GraphProcess(&Graph, &Port, (uint8_t*)Block, TEST_FRAMES * AUDIO_GRAPH_FRAME_SIZE(&Port)) == 0,
+             "process");
+  for(uint32_t s = 0; s < TEST_SAMPLES; s++)
+  {
+    output[s] = TEST_ReadSample((uint8_t*)Block, Port.format, s);
+  }
+}
+
+/**
+  * @brief  TEST_EqMeasure
+  *         Plans the graph, which clears the filters, and measures the gain of the bands for a sine.
+  * @param  frequency(IN): sine frequency in Hz
+  * @param  gain_db(OUT):  left and right gains in db
+  * @retval None
+  */
+static void  TEST_EqMeasure(double frequency, double* gain_db)
+{
+  double output[TEST_SAMPLES], energy[TEST_CHANNELS] = {0, 0};
+
+  TEST_CHECK(AUDIO_GraphPlan(&Graph, &Port) == 0, "plan");
+  Time = 0;
+  for(uint32_t b = 0; b < TEST_SETTLE_BLOCKS + TEST_MEASURE_BLOCKS; b++)
+  {
+    TEST_EqProcess(frequency, output);
+    for(uint32_t s = 0; (b >= TEST_SETTLE_BLOCKS) && (s < TEST_SAMPLES); s++)
+    {
+      energy[s & 1] += output[s] * output[s];
+    }
+  }
+  for(int c = 0; c < (int)TEST_CHANNELS; c++)
+  {
+    /* a whole number of periods is not needed, the window holds many of them */
+    gain_db[c] = 10.0 * log10(energy[c] / (TEST_MEASURE_BLOCKS * TEST_FRAMES * TEST_AMPLITUDE * TEST_AMPLITUDE / 2.0));
+  }
+}
+
+/**
+  * @brief  TEST_EqCheckGain
+  *         Measures the gain of the bands for a sine and compares both channels with the expected one.
+  * @param  name(IN):      checked band
+  * @param  frequency(IN): sine frequency in Hz
+  * @param  expected(IN):  expected gain in db
+  * @param  tolerance(IN): tolerance in db
+  * @retval None
+  */
+static void  TEST_EqCheckGain(const char* name, double frequency, double expected, double tolerance)
+{
+  double gain_db[TEST_CHANNELS];
+
+  TEST_EqMeasure(frequency, gain_db);
+  for(int c = 0; c < (int)TEST_CHANNELS; c++)
+  {
+    TEST_CHECK(fabs(gain_db[c] - expected) <= tolerance, "%s form %u format %u, %.0f Hz channel %d : %.2f db "
+               "instead of %.2f", name, EqNode.form, Port.format, frequency, c, gain_db[c], expected);
+  }
+}
+
+/**
+  * @brief  TEST_EqResponses
+  *         Peak, high pass and low shelf responses against their design, in both forms and all formats.
+  * @param  None
+  * @retval None
+  */
+static void  TEST_EqResponses(void)
+{
+  static const uint8_t formats[] = {AUDIO_GRAPH_FORMAT_S16, AUDIO_GRAPH_FORMAT_S24, AUDIO_GRAPH_FORMAT_S32};
+
+  for(uint8_t form = AUDIO_EQ_DF1; form <= AUDIO_EQ_DF2T; form++)
+  {
+    for(uint32_t i = 0; i < sizeof(formats); i++)
+    {
+      TEST_EqInit(form, formats[i]);
+      TEST_EqCheckGain("no band", 1000, 0.0, 0.01);
+      AUDIO_EqSetBand(&EqNode, 0, 0, &BandPeak);
+      TEST_EqCheckGain("peak", 1000, 6.0, 0.05);
+      TEST_EqCheckGain("peak", 100, 0.0, 0.2);
+      TEST_EqCheckGain("peak", 10000, 0.0, 0.2);
+
+      /* second order Butterworth, -12.3 db one octave below the cut-off */
+      AUDIO_EqSetBand(&EqNode, 0, 0, &BandHighPass);
+      TEST_EqCheckGain("high pass", 20, -12.3, 0.3);
+      TEST_EqCheckGain("high pass", 1000, 0.0, 0.05);
+
+      AUDIO_EqSetBand(&EqNode, 0, 0, &BandLowShelf);
+      TEST_EqCheckGain("low shelf", 20, 5.7, 0.3);
+      TEST_EqCheckGain("low shelf", 5000, 0.0, 0.05);
+    }
+  }
+}
+
+/**
+  * @brief  TEST_EqChannels
+  *         A band of the right channel leaves the left channel bit exact.
+  * @param  None
+  * @retval None
+  */
+static void  TEST_EqChannels(void)
+{
+  double gain_db[TEST_CHANNELS], output[TEST_SAMPLES];
+  int32_t expected;
+
+  TEST_EqInit(AUDIO_EQ_DF1, AUDIO_GRAPH_FORMAT_S32);
+  TEST_CHECK(AUDIO_EqSetBand(&EqNode, 2, 4, &BandPeak) == 0, "right channel band");
+  TEST_EqMeasure(1000, gain_db);
+  TEST_CHECK(fabs(gain_db[1] - 6.0) < 0.05, "right channel : %f db", gain_db[1]);
+  TEST_EqProcess(1000, output);
+  for(uint32_t f = 0; f < TEST_FRAMES; f++)
+  {
+    TEST_WriteSample((uint8_t*)&expected, AUDIO_GRAPH_FORMAT_S32, 0,
+                     TEST_AMPLITUDE * sin(2.0 * TEST_PI * 1000.0 * (Time - TEST_FRAMES + f) / TEST_FREQUENCY));
+    TEST_CHECK(output[2 * f] == expected / 2147483648.0, "left channel frame %u changed", f);
+  }
+}
+
+/**
+  * @brief  TEST_EqSlots
+  *         Each band keeps its biquad stage, the unused stages below the last band are identities.
+  * @param  None
+  * @retval None
+  */
+static void  TEST_EqSlots(void)
+{
+  AUDIO_EqCoefficients_t* coefficients;
+  AUDIO_EqBiquad_t peak;
+  double output[TEST_SAMPLES];
+  int32_t unity = (int32_t)(1UL << AUDIO_EQ_COEF_FRACTION_BITS);
+
+  TEST_EqInit(AUDIO_EQ_DF1, AUDIO_GRAPH_FORMAT_S32);
+  AUDIO_EqSetBand(&EqNode, 0, 0, &BandHighPass);
+  AUDIO_EqSetBand(&EqNode, 0, 3, &BandPeak);
+  AUDIO_GraphPlan(&Graph, &Port);
+  AUDIO_EqDesignBiquad(&BandPeak, TEST_FREQUENCY, &peak);
+  for(int pass = 0; pass < 2; pass++)
+  {
+    coefficients = &EqNode.coefficients[EqNode.active];
+    TEST_CHECK(coefficients->stages_count[0] == 4, "pass %d, %u stages", pass, coefficients->stages_count[0]);
+    for(int b = 1; b < 3; b++)
+    {
+      TEST_CHECK((coefficients->biquads[0][b].b0 == unity) && (coefficients->biquads[0][b].a1 == 0),
+                 "pass %d, stage %d is not identity", pass, b);
+    }
+    TEST_CHECK(memcmp(&coefficients->biquads[0][3], &peak, sizeof(peak)) == 0, "pass %d, peak left stage 3", pass);
+    /* the first band off, the peak stays on its stage */
+    AUDIO_EqSetBand(&EqNode, 0, 0, &BandOff);
+    TEST_EqProcess(1000, output);
+  }
+  TEST_CHECK(EqNode.coefficients[EqNode.active].biquads[0][0].b0 == unity, "band off is not identity");
+}
+
+/**
+  * @brief  TEST_EqParams
+  *         Invalid bands are refused.
+  * @param  None
+  * @retval None
+  */
+static void  TEST_EqParams(void)
+{
+  AUDIO_EqBand_t band;
+
+  /* planned, the band frequencies are checked against the stream rate */
+  TEST_EqInit(AUDIO_EQ_DF1, AUDIO_GRAPH_FORMAT_S32);
+  AUDIO_GraphPlan(&Graph, &Port);
+  TEST_CHECK(AUDIO_EqSetBand(&EqNode, 0, AUDIO_EQ_MAX_BANDS, &BandPeak) != 0, "band index");
+  TEST_CHECK(AUDIO_EqSetBand(&EqNode, AUDIO_EQ_MAX_CHANNELS + 1, 0, &BandPeak) != 0, "channel number");
+  band = BandPeak;
+  band.gain_db_256 = AUDIO_EQ_MAX_GAIN_DB_256 + 1;
+  TEST_CHECK(AUDIO_EqSetBand(&EqNode, 0, 1, &band) != 0, "gain out of range");
+  band = BandPeak;
+  band.frequency = TEST_FREQUENCY / 2;
+  TEST_CHECK(AUDIO_EqSetBand(&EqNode, 0, 1, &band) != 0, "frequency at Nyquist");
+}
+
+/**
+  * @brief  TEST_EqDeviation
+  *         Computes |H - 1| of a biquad at a frequency, the step made by removing the band from a sine.
+  * @param  biquad(IN):    coefficients
+  * @param  frequency(IN): sine frequency in Hz
+  * @retval deviation of the band from a flat response
+  */
+static double  TEST_EqDeviation(const AUDIO_EqBiquad_t* biquad, double frequency)
+{
+  double w = 2.0 * TEST_PI * frequency / TEST_FREQUENCY, scale = (double)(1UL << AUDIO_EQ_COEF_FRACTION_BITS);
+  double b0 = biquad->b0 / scale, b1 = biquad->b1 / scale, b2 = biquad->b2 / scale;
+  double a1 = biquad->a1 / scale, a2 = biquad->a2 / scale;
+  double num_re, num_im, den_re, den_im, den;
+
+  /* H = (b0 + b1.z^-1 + b2.z^-2) / (1 - a1.z^-1 - a2.z^-2), z = e^jw, minus 1 */
+  num_re = b0 + b1 * cos(w) + b2 * cos(2.0 * w);
+  num_im = -b1 * sin(w) - b2 * sin(2.0 * w);
+  den_re = 1.0 - a1 * cos(w) - a2 * cos(2.0 * w);
+  den_im = a1 * sin(w) + a2 * sin(2.0 * w);
+  num_re -= den_re;
+  num_im -= den_im;
+  den = den_re * den_re + den_im * den_im;
+  return sqrt((num_re * num_re + num_im * num_im) / den);
+}
+
+/**
+  * @brief  TEST_EqChanges
+  *         Adds, changes and removes peak bands while a sine streams through the direct form 1. Added and
+  *         changed bands move the output by steps no larger than the slope of the boosted sine, a removed band
+  *         adds at most its deviation from a flat response.
+  * @param  None
+  * @retval None
+  */
+static void  TEST_EqChanges(void)
+{
+  AUDIO_EqBand_t band = BandPeak;
+  AUDIO_EqBiquad_t peak;
+  double output[TEST_SAMPLES], previous = 0, step, limit;
+  /* 200 Hz sine, bands at 1 KHz add less than 1 db there */
+  double bound = 1.5 * TEST_AMPLITUDE * 2.0 * TEST_PI * 200.0 / TEST_FREQUENCY;
+  double removal;
+
+  AUDIO_EqDesignBiquad(&BandPeak, TEST_FREQUENCY, &peak);
+  removal = bound + TEST_AMPLITUDE * TEST_EqDeviation(&peak, 200);
+
+  TEST_EqInit(AUDIO_EQ_DF1, AUDIO_GRAPH_FORMAT_S32);
+  AUDIO_EqSetBand(&EqNode, 0, 3, &BandPeak);
+  AUDIO_GraphPlan(&Graph, &Port);
+  for(uint32_t b = 0; b < 400; b++)
+  {
+    switch(b)
+    {
+    case 50:
+      /* appended band, the cascade grows */
+      AUDIO_EqSetBand(&EqNode, 0, 7, &BandPeak);
+      break;
+    case 100:
+      band.gain_db_256 = -3 * 256;
+      AUDIO_EqSetBand(&EqNode, 0, 3, &band);
+      break;
+    case 150:
+      /* last band removed, the cascade shrinks */
+      AUDIO_EqSetBand(&EqNode, 0, 7, &BandOff);
+      break;
+    case 200:
+      AUDIO_EqSetBand(&EqNode, 0, 1, &BandPeak);
+      break;
+    case 250:
+      AUDIO_EqSetBand(&EqNode, 0, 1, &BandOff);
+      break;
+    default:
+      break;
+    }
+    TEST_EqProcess(200, output);
+    for(uint32_t f = 0; f < TEST_FRAMES; f++)
+    {
+      step = fabs(output[2 * f] - previous);
+      previous = output[2 * f];
+      limit = (((b == 150) || (b == 250)) && (f == 0))? removal : bound;
+      TEST_CHECK((b == 0) || (step <= limit), "block %u frame %u step %f > %f", b, f, step, limit);
+    }
+  }
+}
+
+/**
+  * @brief  TEST_EqBench
+  *         5 and 10 peak bands on 1 ms stereo blocks, in both forms.
+  * @param  None
+  * @retval None
+  */
+static void  TEST_EqBench(void)
+{
+  static const char* names[2][2] =
+  {
+    {"eq S16 stereo 5 bands DF1", "eq S32 stereo 5 bands DF1"},
+    {"eq S16 stereo 5 bands DF2T", "eq S32 stereo 5 bands DF2T"}
+  };
+
+  for(uint8_t form = AUDIO_EQ_DF1; form <= AUDIO_EQ_DF2T; form++)
+  {
+    for(int i = 0; i < 2; i++)
+    {
+      TEST_EqInit(form, (i == 0)? AUDIO_GRAPH_FORMAT_S16 : AUDIO_GRAPH_FORMAT_S32);
+      for(uint8_t b = 0; b < 5; b++)
+      {
+        AUDIO_EqSetBand(&EqNode, 0, b, &BandPeak);
+      }
+      AUDIO_GraphPlan(&Graph, &Port);
+      TEST_Bench(names[form][i], &Graph, &Port, (uint8_t*)Block, TEST_FRAMES * AUDIO_GRAPH_FRAME_SIZE(&Port));
+    }
+  }
+  TEST_EqInit(AUDIO_EQ_DF1, AUDIO_GRAPH_FORMAT_S32);
+  for(uint8_t b = 0; b < AUDIO_EQ_MAX_BANDS; b++)
+  {
+    AUDIO_EqSetBand(&EqNode, 0, b, &BandPeak);
+  }
+  AUDIO_GraphPlan(&Graph, &Port);
+  TEST_Bench("eq S32 stereo 10 bands DF1", &Graph, &Port, (uint8_t*)Block, TEST_FRAMES * AUDIO_GRAPH_FRAME_SIZE(&Port));
+}
+
+/* Exported functions --------------------------------------------------------*/
+/**
+  * @brief  main
+  *         Runs the checks then the benchmarks.
+  * @param  None
+  * @retval 0 if all checks passed
+  */
+int  main(void)
+{
+  TEST_EqResponses();
+  TEST_EqChannels();
+  TEST_EqSlots();
+  TEST_EqParams();
+  TEST_EqChanges();
+  TEST_EqBench();
+  return TEST_Report("audio_eq_test");
+}
+
+/************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
@@ -0,0 +1,271 @@
+/**
+  ******************************************************************************
+  * @file    audio_gain_test.c
+  * @author  MCD Application Team
+  * @brief   host test of the gain node (Projects/Common/Streaming/Src/audio_gain_node.c) :
+  *          dB table accuracy, linear ramps without zipper steps, per channel
+  *          volume, mute and saturation, then benchmarks. See readme.txt.
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2019  STMicroelectronics.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by ST under Ultimate Liberty license
+  * SLA0044, the "License"; You may not use this file except in compliance with
+  * the License. You may obtain a copy of the License at:
+  *                             www.st.com/SLA0044
+  *
+  ******************************************************************************
+  */
+/* Includes ------------------------------------------------------------------*/
+#include <stdlib.h>
+#include <math.h>
+#include "audio_nodes_test.h"
+#include "audio_gain_node.h"
+
+/* Private defines -----------------------------------------------------------*/
+#define TEST_FREQUENCY                  48000U
+#define TEST_FRAMES                     48U
+#define TEST_CHANNELS                   2U
+#define TEST_SAMPLES                    (TEST_FRAMES * TEST_CHANNELS)
+
+/* Private variables ---------------------------------------------------------*/
+static AUDIO_GainNode_t GainNode;
+static AUDIO_Graph_t Graph;
+static uint32_t Scratch[TEST_SAMPLES];
+static int16_t Block16[TEST_SAMPLES];
+static int32_t Block32[TEST_SAMPLES];
+static uint8_t Block24[TEST_SAMPLES * 3];
+static AUDIO_GraphPort_t Port;
+
+/* Private functions ---------------------------------------------------------*/
+/**
+  * @brief  TEST_GainPlan
+  *         Builds a graph of the gain node alone, the node starts from silence as after a stream start.
+  * @param  format(IN): AUDIO_GRAPH_FORMAT_xxx
+  * @retval None
+  */
+static void  TEST_GainPlan(uint8_t format)
+{
+  AUDIO_GainInit(&GainNode);
+  AUDIO_GraphInit(&Graph, (uint8_t*)Scratch, sizeof(Scratch));
+  AUDIO_GraphAddNode(&Graph, &GainNode.processing);
+  Port.frequency = TEST_FREQUENCY;
+  Port.channels_count = TEST_CHANNELS;
+  Port.format = format;
+  TEST_CHECK(AUDIO_GraphPlan(&Graph, &Port) == 0, "plan format %u", format);
+}
+
+/**
+  * @brief  TEST_GainProcess16
+  *         Fills the S16 block with a constant per channel and processes it.
+  * @param  left(IN):  left sample
+  * @param  right(IN): right sample
+  * @retval None
+  */
+static void  TEST_GainProcess16(int16_t left, int16_t right)
+{
+  for(uint32_t f = 0; f < TEST_FRAMES; f++)
+  {
+    Block16[2 * f] = left;
+    Block16[2 * f + 1] = right;
+  }
+  TEST_CHECK(AUDIO_GraphProcess(&Graph, &Port, (uint8_t*)Block16, sizeof(Block16)) == 0, "process");
+}
+
+/**
+  * @brief  TEST_GainCheckRamp
+  *         Checks that a channel of the S16 block moves monotonically from its previous value to last, by steps
+  *         not larger than an even split of the change.
+  * @param  channel(IN):  0 left, 1 right
+  * @param  previous(IN): channel value before the block
+  * @param  last(IN):     expected value of the last frame
+  * @retval None
+  */
+static void  TEST_GainCheckRamp(int channel, int previous, int last)
+{
+  int max_step = abs(last - previous) / (int)TEST_FRAMES + 2;
+  int value = previous;
+
+  for(uint32_t f = 0; f < TEST_FRAMES; f++)
+  {
+    int sample = Block16[2 * f + channel];
+    TEST_CHECK(abs(sample - value) <= max_step, "channel %d frame %u step %d > %d", channel, f, sample - value,
+               max_step);
+    TEST_CHECK((last >= previous)? (sample >= value) : (sample <= value), "channel %d frame %u not monotonic",
+               channel, f);
+    value = sample;
+  }
+  TEST_CHECK(abs(value - last) <= 1, "channel %d ends at %d instead of %d", channel, value, last);
+}
+
+/**
+  * @brief  TEST_GainTable
+  *         Compares AUDIO_GainFromDb256 with 10^(db/20) over the whole volume range.
+  * @param  None
+  * @retval None
+  */
+static void  TEST_GainTable(void)
+{
+  double expected, error, max_error = 0;
+
+  for(int db_256 = AUDIO_GAIN_MIN_DB_256; db_256 <= AUDIO_GAIN_MAX_DB_256; db_256++)
+  {
+    expected = pow(10.0, db_256 / (20.0 * 256.0)) * AUDIO_GAIN_UNITY;
+    error = fabs(AUDIO_GainFromDb256(db_256) - expected) / expected;
+    if(error > max_error)
+    {
+      max_error = error;
+    }
+    /* whole db gains are rounded to an integer (266 at -96 db) then scaled by the fraction tables */
+    TEST_CHECK(fabs(AUDIO_GainFromDb256(db_256) - expected) <= expected * 1e-6 + 3.0,
+               "%d/256 db : %d instead of %.1f", db_256, AUDIO_GainFromDb256(db_256), expected);
+  }
+  TEST_CHECK(AUDIO_GainFromDb256(AUDIO_GAIN_MIN_DB_256 - 1) == 0, "below min is not silence");
+  TEST_CHECK(AUDIO_GainFromDb256(0) == AUDIO_GAIN_UNITY, "0 db is not unity");
+  TEST_CHECK(AUDIO_GainFromDb256(AUDIO_GAIN_MAX_DB_256 + 256) == AUDIO_GainFromDb256(AUDIO_GAIN_MAX_DB_256),
+             "above max is not saturated");
+  printf("db table max relative error %.2e\n", max_error);
+}
+
+/**
+  * @brief  TEST_GainRamps
+  *         Fade in after the plan, volume change of the master and of one channel, mute, all on S16 stereo.
+  * @param  None
+  * @retval None
+  */
+static void  TEST_GainRamps(void)
+{
+  int half, tenth;
+
+  TEST_GainPlan(AUDIO_GRAPH_FORMAT_S16);
+  TEST_GainProcess16(16384, -16384);
+  TEST_GainCheckRamp(0, 0, 16384);
+  TEST_GainCheckRamp(1, 0, -16384);
+  TEST_GainProcess16(16384, -16384);
+  TEST_GainCheckRamp(0, 16384, 16384);
+
+  /* master -6 db */
+  half = (int)(((int64_t)16384 * AUDIO_GainFromDb256(-6 * 256)) >> AUDIO_GAIN_FRACTION_BITS);
+  AUDIO_GainSetVolume(0, -6 * 256, TEST_HANDLE(&GainNode));
+  TEST_GainProcess16(16384, -16384);
+  TEST_GainCheckRamp(0, 16384, half);
+  TEST_GainCheckRamp(1, -16384, -half);
+  TEST_GainProcess16(16384, -16384);
+  TEST_GainCheckRamp(0, half, half);
+
+  /* right channel -14 db more, left unchanged */
+  tenth = (int)(((int64_t)16384 * AUDIO_GainFromDb256(-20 * 256)) >> AUDIO_GAIN_FRACTION_BITS);
+  AUDIO_GainSetVolume(2, -14 * 256, TEST_HANDLE(&GainNode));
+  TEST_GainProcess16(16384, 16384);
+  TEST_GainCheckRamp(0, half, half);
+  TEST_GainCheckRamp(1, half, tenth);
+
+  /* master mute ramps both channels down to silence, unmute ramps them back */
+  AUDIO_GainSetMute(0, 1, TEST_HANDLE(&GainNode));
+  TEST_GainProcess16(16384, 16384);
+  TEST_GainCheckRamp(0, half, 0);
+  TEST_GainCheckRamp(1, tenth, 0);
+  AUDIO_GainSetMute(0, 0, TEST_HANDLE(&GainNode));
+  TEST_GainProcess16(16384, 16384);
+  TEST_GainCheckRamp(0, 0, half);
+  TEST_GainCheckRamp(1, 0, tenth);
+}
+
+/**
+  * @brief  TEST_GainSaturation
+  *         +12 db on full scale samples clips at the format limits in S16, S24 and S32, without wrapping.
+  * @param  None
+  * @retval None
+  */
+static void  TEST_GainSaturation(void)
+{
+  int32_t value;
+
+  TEST_GainPlan(AUDIO_GRAPH_FORMAT_S16);
+  AUDIO_GainSetVolume(0, 12 * 256, TEST_HANDLE(&GainNode));
+  for(int i = 0; i < 2; i++)
+  {
+    TEST_GainProcess16(INT16_MAX, INT16_MIN);
+  }
+  for(uint32_t f = 0; f < TEST_FRAMES; f++)
+  {
+    TEST_CHECK((Block16[2 * f] == INT16_MAX) && (Block16[2 * f + 1] == INT16_MIN), "S16 frame %u : %d %d", f,
+               Block16[2 * f], Block16[2 * f + 1]);
+  }
+
+  TEST_GainPlan(AUDIO_GRAPH_FORMAT_S24);
+  AUDIO_GainSetVolume(0, 12 * 256, TEST_HANDLE(&GainNode));
+  for(int i = 0; i < 2; i++)
+  {
+    for(uint32_t s = 0; s < TEST_SAMPLES; s++)
+    {
+      /* 0x7FFFFF and 0x800000 packed little endian */
+      Block24[3 * s] = (s & 1)? 0x00 : 0xFF;
+      Block24[3 * s + 1] = (s & 1)? 0x00 : 0xFF;
+      Block24[3 * s + 2] = (s & 1)? 0x80 : 0x7F;
+    }
+    AUDIO_GraphProcess(&Graph, &Port, Block24, sizeof(Block24));
+  }
+  for(uint32_t s = 0; s < TEST_SAMPLES; s++)
+  {
+    value = (int32_t)(((uint32_t)Block24[3 * s] << 8) | ((uint32_t)Block24[3 * s + 1] << 16) |
+                      ((uint32_t)Block24[3 * s + 2] << 24)) >> 8;
+    TEST_CHECK(value == ((s & 1)? -0x800000 : 0x7FFFFF), "S24 sample %u : %d", s, value);
+  }
+
+  TEST_GainPlan(AUDIO_GRAPH_FORMAT_S32);
+  AUDIO_GainSetVolume(0, 12 * 256, TEST_HANDLE(&GainNode));
+  for(int i = 0; i < 2; i++)
+  {
+    for(uint32_t s = 0; s < TEST_SAMPLES; s++)
+    {
+      Block32[s] = (s & 1)? INT32_MIN : INT32_MAX;
+    }
+    AUDIO_GraphProcess(&Graph, &Port, (uint8_t*)Block32, sizeof(Block32));
+  }
+  for(uint32_t s = 0; s < TEST_SAMPLES; s++)
+  {
+    TEST_CHECK(Block32[s] == ((s & 1)? INT32_MIN : INT32_MAX), "S32 sample %u : %d", s, Block32[s]);
+  }
+}
+
+/**
+  * @brief  TEST_GainBench
+  *         Constant gain, ramping gain and 0 db bypass of 1 ms stereo blocks.
+  * @param  None
+  * @retval None
+  */
+static void  TEST_GainBench(void)
+{
+  TEST_GainPlan(AUDIO_GRAPH_FORMAT_S16);
+  AUDIO_GainSetVolume(0, -6 * 256, TEST_HANDLE(&GainNode));
+  TEST_Bench("gain S16 stereo -6 db", &Graph, &Port, (uint8_t*)Block16, sizeof(Block16));
+  AUDIO_GainSetVolume(0, 0, TEST_HANDLE(&GainNode));
+  TEST_Bench("gain S16 stereo 0 db bypass", &Graph, &Port, (uint8_t*)Block16, sizeof(Block16));
+  TEST_GainPlan(AUDIO_GRAPH_FORMAT_S24);
+  AUDIO_GainSetVolume(0, -6 * 256, TEST_HANDLE(&GainNode));
+  TEST_Bench("gain S24 stereo -6 db", &Graph, &Port, Block24, sizeof(Block24));
+  TEST_GainPlan(AUDIO_GRAPH_FORMAT_S32);
+  AUDIO_GainSetVolume(0, -6 * 256, TEST_HANDLE(&GainNode));
+  TEST_Bench("gain S32 stereo -6 db", &Graph, &Port, (uint8_t*)Block32, sizeof(Block32));
+}
+
+/* Exported functions --------------------------------------------------------*/
+/**
+  * @brief  main
+  *         Runs the checks then the benchmarks.
+  * @param  None
+  * @retval 0 if all checks passed
+  */
+int  main(void)
+{
+  TEST_GainTable();
+  TEST_GainRamps();
+  TEST_GainSaturation();
+  TEST_GainBench();
+  return TEST_Report("audio_gain_test");
+}
+
+/************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
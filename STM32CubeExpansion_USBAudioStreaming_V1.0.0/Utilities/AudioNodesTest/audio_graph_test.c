@@ -0,0 +1,269 @@
+/**
+  ******************************************************************************
+  * @file    audio_graph_test.c
+  * @author  MCD Application Team
+  * @brief   host test of a playback processing graph (gain, equalizer, limiter)
+  *          against WAV fixtures : each input file of Fixtures is processed by
+  *          1 ms blocks and compared with its reference output, the limiter
+  *          ceiling is checked on the output. The graph is then run with the
+  *          block periods of the sessions to print the latency against the
+  *          processing time. See readme.txt.
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2019  STMicroelectronics.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by ST under Ultimate Liberty license
+  * SLA0044, the "License"; You may not use this file except in compliance with
+  * the License. You may obtain a copy of the License at:
+  *                             www.st.com/SLA0044
+  *
+  ******************************************************************************
+  */
+/* Includes ------------------------------------------------------------------*/
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "audio_nodes_test.h"
+#include "audio_gain_node.h"
+#include "audio_eq_node.h"
+#include "audio_limiter_node.h"
+
+/* Private defines -----------------------------------------------------------*/
+#define TEST_FIXTURES_DIR               "Fixtures/"
+#define TEST_MAX_BLOCK_FRAMES           192U     /* 1 ms at 192 KHz */
+#define TEST_MAX_CHANNELS               2U
+#define TEST_VOLUME_DB_256              (-3 * 256)
+#define TEST_CEILING_DB_256             (-6 * 256)
+#define TEST_LOOKAHEAD_US               1000U
+#define TEST_RELEASE_MS                 50U
+#define TEST_TOLERANCE_LSB              1        /* rounding differences between hosts */
+#define TEST_SWEEP_FIXTURE              0U       /* 48 KHz fixture, 4 ms blocks fit the scratch */
+#define TEST_SWEEP_PASSES               50U      /* passes over the fixture per block period */
+#define TEST_SWEEP_RUNS                 5U       /* the fastest run is kept */
+
+/* Private typedef -----------------------------------------------------------*/
+typedef struct
+{
+  const char* input;
+  const char* reference;
+} TEST_Fixture_t;
+
+/* Private variables ---------------------------------------------------------*/
+static const TEST_Fixture_t Fixtures[] =
+{
+  {TEST_FIXTURES_DIR "graph_in_48k_s16.wav", TEST_FIXTURES_DIR "graph_out_48k_s16.wav"},
+  {TEST_FIXTURES_DIR "graph_in_96k_s24.wav", TEST_FIXTURES_DIR "graph_out_96k_s24.wav"},
+};
+static AUDIO_GainNode_t GainNode;
+static AUDIO_EqNode_t EqNode;
+static AUDIO_LimiterNode_t LimiterNode;
+static AUDIO_Graph_t Graph;
+static uint32_t Scratch[TEST_MAX_BLOCK_FRAMES * TEST_MAX_CHANNELS];
+static const AUDIO_EqBand_t BandHighPass = {AUDIO_EQ_BAND_HIGH_PASS, 40, 0.707f, 0};
+static const AUDIO_EqBand_t BandPeak = {AUDIO_EQ_BAND_PEAK, 1000, 1.4f, 6 * 256};
+/* block periods accepted by AUDIO_PlaybackSessionSetBlockPeriod */
+static const uint16_t SweepBlockUs[] = {125, 250, 500, 1000, 2000, 4000};
+
+/* Private functions ---------------------------------------------------------*/
+/**
+  * @brief  TEST_GraphPlan
+  *         Builds and plans the graph of the playback session : gain, equalizer then limiter.
+  * @param  port(IN): format of the stream
+  * @retval 0 if no error
+  */
+static int8_t  TEST_GraphPlan(const AUDIO_GraphPort_t* port)
+{
+  AUDIO_LimiterParams_t params;
+
+  params.ceiling_db_256 = TEST_CEILING_DB_256;
+  params.lookahead_us = TEST_LOOKAHEAD_US;
+  params.release_ms = TEST_RELEASE_MS;
+  AUDIO_GainInit(&GainNode);
+  AUDIO_EqInit(&EqNode, AUDIO_EQ_DF1);
+  AUDIO_LimiterInit(&LimiterNode, &params);
+  AUDIO_GraphInit(&Graph, (uint8_t*)Scratch, sizeof(Scratch));
+  AUDIO_GraphAddNode(&Graph, &GainNode.processing);
+  AUDIO_GraphAddNode(&Graph, &EqNode.processing);
+  AUDIO_GraphAddNode(&Graph, &LimiterNode.processing);
+  AUDIO_EqSetBand(&EqNode, 0, 0, &BandHighPass);
+  AUDIO_EqSetBand(&EqNode, 0, 1, &BandPeak);
+  if(AUDIO_GraphPlan(&Graph, port) != 0)
+  {
+    return -1;
+  }
+  AUDIO_GainSetVolume(0, TEST_VOLUME_DB_256, TEST_HANDLE(&GainNode));
+  return 0;
+}
+
+/**
+  * @brief  TEST_GraphFixture
+  *         Processes an input fixture by 1 ms blocks, then compares the output with the reference fixture, or
+  *         writes it as the reference when TEST_UPDATE_FIXTURES is set in the environment.
+  * @param  fixture(IN): input and reference files
+  * @retval None
+  */
+static void  TEST_GraphFixture(const TEST_Fixture_t* fixture)
+{
+  AUDIO_GraphPort_t port, ref_port;
+  uint8_t *data, *reference;
+  uint32_t frames, ref_frames, block_frames, frame_size, offset, length, i, samples;
+  uint32_t latency, mismatches = 0, above = 0;
+  double lsb, ceiling, peak = 0.0, error, max_error = 0.0;
+
+  if(TEST_WavRead(fixture->input, &port, &data, &frames) != 0)
+  {
+    TEST_CHECK(0, "%s not read", fixture->input);
+    return;
+  }
+  TEST_CHECK((port.channels_count <= TEST_MAX_CHANNELS) && (port.frequency / 1000U <= TEST_MAX_BLOCK_FRAMES),
+             "%s : %u channels at %u Hz not supported", fixture->input, port.channels_count, port.frequency);
+  TEST_CHECK(TEST_GraphPlan(&port) == 0, "%s : graph not planned", fixture->input);
+  block_frames = port.frequency / 1000U;
+  frame_size = AUDIO_GRAPH_FRAME_SIZE(&port);
+  for(offset = 0; offset < frames * frame_size; offset += length)
+  {
+    length = frames * frame_size - offset;
+    length = (length < block_frames * frame_size)? length : block_frames * frame_size;
+    AUDIO_GraphProcess(&Graph, &port, data + offset, (uint16_t)length);
+  }
+
+  /* the limiter holds the peaks under the ceiling once its look-ahead is filled */
+  lsb = 1.0 / (double)(1UL << (8U * port.format - 1U));
+  ceiling = pow(10.0, TEST_CEILING_DB_256 / (20.0 * 256.0));
+  latency = Graph.latency_frames;
+  samples = frames * port.channels_count;
+  for(i = latency * port.channels_count; i < samples; i++)
+  {
+    peak = fmax(peak, fabs(TEST_ReadSample(data, port.format, i)));
+    above += (fabs(TEST_ReadSample(data, port.format, i)) > ceiling + lsb);
+  }
+  TEST_CHECK(above == 0, "%s : %u samples above the ceiling, peak %.4f", fixture->input, above, peak);
+
+  if(getenv("TEST_UPDATE_FIXTURES") != NULL)
+  {
+    TEST_CHECK(TEST_WavWrite(fixture->reference, &port, data, frames) == 0, "%s not written", fixture->reference);
+    printf("%s written\n", fixture->reference);
+    free(data);
+    return;
+  }
+  if(TEST_WavRead(fixture->reference, &ref_port, &reference, &ref_frames) != 0)
+  {
+    TEST_CHECK(0, "%s not read", fixture->reference);
+    free(data);
+    return;
+  }
+  TEST_CHECK((ref_frames == frames) && (ref_port.channels_count == port.channels_count) &&
+             (ref_port.format == port.format) && (ref_port.frequency == port.frequency),
+             "%s : %u frames, %u channels, %u bytes at %u Hz for %u, %u, %u, %u", fixture->reference, ref_frames,
+             ref_port.channels_count, ref_port.format, ref_port.frequency, frames, port.channels_count, port.format,
+             port.frequency);
+  if((ref_frames == frames) && (ref_port.format == port.format) && (ref_port.channels_count == port.channels_count))
+  {
+    for(i = 0; i < samples; i++)
+    {
+      error = fabs(TEST_ReadSample(data, port.format, i) - TEST_ReadSample(reference, port.format, i)) / lsb;
+      max_error = fmax(max_error, error);
+      mismatches += (error > TEST_TOLERANCE_LSB);
+    }
+    TEST_CHECK(mismatches == 0, "%s : %u samples differ from the reference, up to %.0f LSB", fixture->input,
+               mismatches, max_error);
+  }
+  printf("%s : %u frames at %u Hz, %u bytes samples, latency %u frames, peak %.4f, max difference %.0f LSB\n",
+         fixture->input, frames, port.frequency, port.format, latency, peak, max_error);
+  free(reference);
+  free(data);
+}
+
+/**
+  * @brief  TEST_GraphSweep
+  *         Runs the graph over the 48 KHz fixture with each block period of SweepBlockUs and prints the latency
+  *         of the playback path (two blocks of the speaker DMA and the graph latency) against the processing time
+  *         per second of stream, which grows with the per block overhead of the short blocks. The ceiling is
+  *         checked for each period.
+  * @param  None
+  * @retval None
+  */
+static void  TEST_GraphSweep(void)
+{
+  const TEST_Fixture_t* fixture = &Fixtures[TEST_SWEEP_FIXTURE];
+  AUDIO_GraphPort_t port;
+  uint8_t *input, *data;
+  uint32_t frames, frame_size, block_frames, offset, length, i, k, pass, run, above, calls;
+  double ceiling, lsb, start, elapsed, best, latency_us, cpu_us;
+
+  if(TEST_WavRead(fixture->input, &port, &input, &frames) != 0)
+  {
+    TEST_CHECK(0, "%s not read", fixture->input);
+    return;
+  }
+  frame_size = AUDIO_GRAPH_FRAME_SIZE(&port);
+  data = malloc(frames * frame_size);
+  lsb = 1.0 / (double)(1UL << (8U * port.format - 1U));
+  ceiling = pow(10.0, TEST_CEILING_DB_256 / (20.0 * 256.0));
+  printf("sweep %s : block us, latency us, processing us per second of stream, blocks per second\n", fixture->input);
+  for(k = 0; k < sizeof(SweepBlockUs) / sizeof(SweepBlockUs[0]); k++)
+  {
+    block_frames = AUDIO_BLOCK_SAMPLES_COUNT(port.frequency, SweepBlockUs[k]);
+    TEST_CHECK((block_frames > 0) && (block_frames <= TEST_MAX_BLOCK_FRAMES), "%u us : %u frames per block",
+               SweepBlockUs[k], block_frames);
+    if((block_frames == 0) || (block_frames > TEST_MAX_BLOCK_FRAMES))
+    {
+      continue;
+    }
+    best = 1e30;
+    calls = 0;
+    for(run = 0; run < TEST_SWEEP_RUNS; run++)
+    {
+      TEST_CHECK(TEST_GraphPlan(&port) == 0, "%u us : graph not planned", SweepBlockUs[k]);
+      elapsed = 0.0;
+      calls = 0;
+      for(pass = 0; pass < TEST_SWEEP_PASSES; pass++)
+      {
+        memcpy(data, input, frames * frame_size);
+        start = TEST_TimeUs();
+        for(offset = 0; offset < frames * frame_size; offset += length)
+        {
+          length = frames * frame_size - offset;
+          length = (length < block_frames * frame_size)? length : block_frames * frame_size;
+          AUDIO_GraphProcess(&Graph, &port, data + offset, (uint16_t)length);
+          calls++;
+        }
+        elapsed += TEST_TimeUs() - start;
+      }
+      best = (elapsed < best)? elapsed : best;
+    }
+    /* last pass output, the limiter is settled from the first pass */
+    for(i = 0, above = 0; i < frames * port.channels_count; i++)
+    {
+      above += (fabs(TEST_ReadSample(data, port.format, i)) > ceiling + lsb);
+    }
+    TEST_CHECK(above == 0, "%u us : %u samples above the ceiling", SweepBlockUs[k], above);
+    latency_us = 2.0 * SweepBlockUs[k] + (1e6 * Graph.latency_frames) / port.frequency;
+    cpu_us = best * 1e6 / ((double)TEST_SWEEP_PASSES * frames * 1e6 / port.frequency);
+    printf("sweep %5u us : latency %6.0f us, %8.1f us/s (%.3f %%), %u blocks/s\n", SweepBlockUs[k], latency_us, cpu_us,
+           cpu_us / 1e4, (uint32_t)((uint64_t)calls * port.frequency / ((uint64_t)TEST_SWEEP_PASSES * frames)));
+  }
+  free(data);
+  free(input);
+}
+
+/* Exported functions --------------------------------------------------------*/
+/**
+  * @brief  main
+  *         Runs the fixtures then the block period sweep.
+  * @param  None
+  * @retval exit status
+  */
+int  main(void)
+{
+  for(uint32_t i = 0; i < sizeof(Fixtures) / sizeof(Fixtures[0]); i++)
+  {
+    TEST_GraphFixture(&Fixtures[i]);
+  }
+  TEST_GraphSweep();
+  return TEST_Report("audio_graph_test");
+}
+
+/************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
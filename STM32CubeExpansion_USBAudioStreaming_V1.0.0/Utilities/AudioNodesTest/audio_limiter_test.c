@@ -0,0 +1,282 @@
+/**
+  ******************************************************************************
+  * @file    audio_limiter_test.c
+  * @author  MCD Application Team
+  * @brief   host test of the limiter node (Projects/Common/Streaming/Src/audio_limiter_node.c) :
+  *          latency, ceiling in all formats, gain ramp over the look-ahead,
+  *          release, parameters checks, then benchmarks. See readme.txt.
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2019  STMicroelectronics.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by ST under Ultimate Liberty license
+  * SLA0044, the "License"; You may not use this file except in compliance with
+  * the License. You may obtain a copy of the License at:
+  *                             www.st.com/SLA0044
+  *
+  ******************************************************************************
+  */
+/* Includes ------------------------------------------------------------------*/
+#include <math.h>
+#include "audio_nodes_test.h"
+#include "audio_limiter_node.h"
+
+/* Private defines -----------------------------------------------------------*/
+#define TEST_FREQUENCY                  48000U
+#define TEST_FRAMES                     48U
+#define TEST_CHANNELS                   2U
+#define TEST_SAMPLES                    (TEST_FRAMES * TEST_CHANNELS)
+#define TEST_PI                         3.14159265358979323846
+/* processed signal, whole blocks */
+#define TEST_SIGNAL_BLOCKS              400U
+#define TEST_SIGNAL_FRAMES              (TEST_SIGNAL_BLOCKS * TEST_FRAMES)
+/* -6 db ceiling, 1 ms look-ahead, 50 ms release */
+#define TEST_CEILING_DB_256             (-6 * 256)
+#define TEST_LOOKAHEAD_US               1000U
+#define TEST_RELEASE_MS                 50U
+
+/* Private variables ---------------------------------------------------------*/
+static AUDIO_LimiterNode_t LimiterNode;
+static AUDIO_Graph_t Graph;
+static uint32_t Scratch[TEST_SAMPLES];
+static uint32_t Block[TEST_SAMPLES];
+static AUDIO_GraphPort_t Port;
+static double Input[TEST_SIGNAL_FRAMES];
+static double Output[TEST_SIGNAL_FRAMES][TEST_CHANNELS];
+
+/* Private functions ---------------------------------------------------------*/
+/**
+  * @brief  TEST_LimiterPlan
+  *         Builds and plans a graph of the limiter node alone.
+  * @param  lookahead_us(IN): look-ahead time
+  * @param  format(IN):       AUDIO_GRAPH_FORMAT_xxx
+  * @retval None
+  */
+static void  TEST_LimiterPlan(uint16_t lookahead_us, uint8_t format)
+{
+  AUDIO_LimiterParams_t params;
+
+  params.ceiling_db_256 = TEST_CEILING_DB_256;
+  params.lookahead_us = lookahead_us;
+  params.release_ms = TEST_RELEASE_MS;
+  TEST_CHECK(AUDIO_LimiterInit(&LimiterNode, &params) == 0, "init");
+  AUDIO_GraphInit(&Graph, (uint8_t*)Scratch, sizeof(Scratch));
+  AUDIO_GraphAddNode(&Graph, &LimiterNode.processing);
+  Port.frequency = TEST_FREQUENCY;
+  Port.channels_count = TEST_CHANNELS;
+  Port.format = format;
+  TEST_CHECK(AUDIO_GraphPlan(&Graph, &Port) == 0, "plan");
+}
+
+/**
+  * @brief  TEST_LimiterProcess
+  *         Limits Input, the same signal on both channels with the right one inverted, to Output.
+  * @param  None
+  * @retval None
+  */
+static void  TEST_LimiterProcess(void)
+{
+  for(uint32_t b = 0; b < TEST_SIGNAL_BLOCKS; b++)
+  {
+    for(uint32_t f = 0; f < TEST_FRAMES; f++)
+    {
+      TEST_WriteSample((uint8_t*)Block, Port.format, 2 * f, Input[b * TEST_FRAMES + f]);
+      TEST_WriteSample((uint8_t*)Block, Port.format, 2 * f + 1, -Input[b * TEST_FRAMES + f]);
+    }
+    AUDIO_GraphProcess(&Graph, &Port, (uint8_t*)Block, TEST_FRAMES * AUDIO_GRAPH_FRAME_SIZE(&Port));
+    for(uint32_t f = 0; f < TEST_FRAMES; f++)
+    {
+      Output[b * TEST_FRAMES + f][0] = TEST_ReadSample((uint8_t*)Block, Port.format, 2 * f);
+      Output[b * TEST_FRAMES + f][1] = TEST_ReadSample((uint8_t*)Block, Port.format, 2 * f + 1);
+    }
+  }
+}
+
+/**
+  * @brief  TEST_LimiterLatency
+  *         Below the ceiling the signal goes through unchanged, delayed by the reported latency.
+  * @param  None
+  * @retval None
+  */
+static void  TEST_LimiterLatency(void)
+{
+  uint32_t latency;
+
+  TEST_LimiterPlan(TEST_LOOKAHEAD_US, AUDIO_GRAPH_FORMAT_S32);
+  latency = LimiterNode.processing.latency_frames;
+  TEST_CHECK(latency == TEST_LOOKAHEAD_US * TEST_FREQUENCY / 1000000U, "latency %u frames", latency);
+  TEST_CHECK(Graph.latency_frames == latency, "graph latency %u frames", Graph.latency_frames);
+  for(uint32_t f = 0; f < TEST_SIGNAL_FRAMES; f++)
+  {
+    Input[f] = 0.4 * sin(2.0 * TEST_PI * 440.0 * f / TEST_FREQUENCY);
+  }
+  TEST_LimiterProcess();
+  for(uint32_t f = 0; f < TEST_SIGNAL_FRAMES; f++)
+  {
+    double expected = (f < latency)? 0.0 : Input[f - latency];
+    TEST_CHECK(fabs(Output[f][0] - expected) < 1e-9, "frame %u : %f instead of %f", f, Output[f][0], expected);
+  }
+}
+
+/**
+  * @brief  TEST_LimiterCeiling
+  *         A full scale sine 6 db above the ceiling never exceeds it, in all formats and look-ahead times.
+  * @param  None
+  * @retval None
+  */
+static void  TEST_LimiterCeiling(void)
+{
+  static const uint8_t formats[] = {AUDIO_GRAPH_FORMAT_S16, AUDIO_GRAPH_FORMAT_S24, AUDIO_GRAPH_FORMAT_S32};
+  static const uint16_t lookaheads[] = {0, 500, TEST_LOOKAHEAD_US, AUDIO_LIMITER_MAX_LOOKAHEAD_US};
+  double ceiling = pow(10.0, TEST_CEILING_DB_256 / (20.0 * 256.0)), peak;
+
+  for(uint32_t f = 0; f < TEST_SIGNAL_FRAMES; f++)
+  {
+    /* bursts of a 1 KHz sine, the attack is taken at each burst */
+    Input[f] = ((f / 1000) & 1)? 0.9999 * sin(2.0 * TEST_PI * 1000.0 * f / TEST_FREQUENCY) : 0.1;
+  }
+  for(uint32_t i = 0; i < sizeof(formats); i++)
+  {
+    for(uint32_t l = 0; l < sizeof(lookaheads) / sizeof(lookaheads[0]); l++)
+    {
+      TEST_LimiterPlan(lookaheads[l], formats[i]);
+      TEST_LimiterProcess();
+      peak = 0;
+      for(uint32_t f = 0; f < TEST_SIGNAL_FRAMES; f++)
+      {
+        peak = fmax(peak, fmax(fabs(Output[f][0]), fabs(Output[f][1])));
+      }
+      TEST_CHECK(peak <= ceiling, "format %u look-ahead %u us : peak %f above %f", formats[i], lookaheads[l], peak,
+                 ceiling);
+      /* the gain doesn't pump below the ceiling : the bursts reach it */
+      TEST_CHECK(peak > ceiling * 0.99, "format %u look-ahead %u us : peak %f", formats[i], lookaheads[l], peak);
+    }
+  }
+}
+
+/**
+  * @brief  TEST_LimiterEnvelope
+  *         Steps of a constant from 0.1 to 0.9 and back : the gain ramps down over the look-ahead, reaches the
+  *         required gain when the step is played, then rises back with the release time constant. The output
+  *         over the delayed input is the applied gain.
+  * @param  None
+  * @retval None
+  */
+static void  TEST_LimiterEnvelope(void)
+{
+  uint32_t latency, start = 10 * TEST_FRAMES, stop = 40 * TEST_FRAMES, f;
+  double ceiling = pow(10.0, TEST_CEILING_DB_256 / (20.0 * 256.0)), required = ceiling / 0.9;
+  double gain, previous = 1.0, max_step;
+
+  TEST_LimiterPlan(TEST_LOOKAHEAD_US, AUDIO_GRAPH_FORMAT_S32);
+  latency = LimiterNode.processing.latency_frames;
+  for(f = 0; f < TEST_SIGNAL_FRAMES; f++)
+  {
+    Input[f] = ((f >= start) && (f < stop))? 0.9 : 0.1;
+  }
+  TEST_LimiterProcess();
+
+  /* attack, linear ramp from the frame entering the look-ahead to the frame played */
+  max_step = (1.0 - required) / latency * 1.05;
+  for(f = latency; f < stop + latency; f++)
+  {
+    gain = Output[f][0] / Input[f - latency];
+    if(f < start)
+    {
+      TEST_CHECK(fabs(gain - 1.0) < 1e-6, "frame %u gain %f before the look-ahead", f, gain);
+    }
+    TEST_CHECK(gain <= ((f < start + latency)? 1.0 : required) + 1e-6, "frame %u gain %f too high", f, gain);
+    TEST_CHECK(fabs(gain - previous) <= max_step, "frame %u gain step %f > %f", f, gain - previous, max_step);
+    previous = gain;
+  }
+  TEST_CHECK(Output[start][0] / Input[start - latency] < 1.0, "the ramp doesn't start with the look-ahead");
+  TEST_CHECK(fabs(Output[start + latency][0] - ceiling) < 1e-4, "step played at %f instead of the ceiling",
+             Output[start + latency][0]);
+  TEST_CHECK(fabs(Output[stop + latency - 1][0] - ceiling) < 1e-4, "held level %f instead of the ceiling",
+             Output[stop + latency - 1][0]);
+
+  /* release, first order toward unity once the step left the look-ahead : 63 % of the way after the release
+     time, back after 5 of them */
+  f = stop + latency + TEST_RELEASE_MS * TEST_FREQUENCY / 1000;
+  gain = Output[f][0] / Input[f - latency];
+  TEST_CHECK(fabs(gain - (1.0 - (1.0 - required) * exp(-1.0))) < 0.03, "gain %f one release time later", gain);
+  f = stop + latency + 5 * TEST_RELEASE_MS * TEST_FREQUENCY / 1000;
+  gain = Output[f][0] / Input[f - latency];
+  TEST_CHECK(gain > 0.99, "gain %f five release times later", gain);
+  /* both channels share the gain */
+  for(f = 0; f < TEST_SIGNAL_FRAMES; f++)
+  {
+    TEST_CHECK(Output[f][0] == -Output[f][1], "frame %u channels differ", f);
+  }
+}
+
+/**
+  * @brief  TEST_LimiterParams
+  *         Positive ceilings, look-ahead times above the maximum and delays above the delay line are refused.
+  * @param  None
+  * @retval None
+  */
+static void  TEST_LimiterParams(void)
+{
+  AUDIO_LimiterParams_t params = {0, AUDIO_LIMITER_MAX_LOOKAHEAD_US, TEST_RELEASE_MS};
+
+  TEST_CHECK(AUDIO_LimiterInit(&LimiterNode, &params) == 0, "0 db ceiling and max look-ahead");
+  AUDIO_GraphInit(&Graph, (uint8_t*)Scratch, sizeof(Scratch));
+  AUDIO_GraphAddNode(&Graph, &LimiterNode.processing);
+  Port.frequency = 192000;
+  Port.channels_count = TEST_CHANNELS;
+  Port.format = AUDIO_GRAPH_FORMAT_S32;
+  TEST_CHECK(AUDIO_GraphPlan(&Graph, &Port) == 0, "max look-ahead at 192 KHz");
+  TEST_CHECK(LimiterNode.processing.latency_frames == AUDIO_LIMITER_MAX_DELAY_FRAMES, "latency %u frames",
+             LimiterNode.processing.latency_frames);
+  Port.frequency = 384000;
+  TEST_CHECK(AUDIO_GraphPlan(&Graph, &Port) != 0, "max look-ahead at 384 KHz");
+  params.ceiling_db_256 = 1;
+  TEST_CHECK(AUDIO_LimiterInit(&LimiterNode, &params) != 0, "positive ceiling");
+  params.ceiling_db_256 = 0;
+  params.lookahead_us = AUDIO_LIMITER_MAX_LOOKAHEAD_US + 1;
+  TEST_CHECK(AUDIO_LimiterInit(&LimiterNode, &params) != 0, "look-ahead above max");
+}
+
+/**
+  * @brief  TEST_LimiterBench
+  *         Limiting of a loud sine in 1 ms stereo blocks.
+  * @param  None
+  * @retval None
+  */
+static void  TEST_LimiterBench(void)
+{
+  TEST_LimiterPlan(TEST_LOOKAHEAD_US, AUDIO_GRAPH_FORMAT_S16);
+  TEST_LimiterProcess();
+  TEST_Bench("limiter S16 stereo 1 ms look-ahead", &Graph, &Port, (uint8_t*)Block,
+             TEST_FRAMES * AUDIO_GRAPH_FRAME_SIZE(&Port));
+  TEST_LimiterPlan(TEST_LOOKAHEAD_US, AUDIO_GRAPH_FORMAT_S32);
+  TEST_LimiterProcess();
+  TEST_Bench("limiter S32 stereo 1 ms look-ahead", &Graph, &Port, (uint8_t*)Block,
+             TEST_FRAMES * AUDIO_GRAPH_FRAME_SIZE(&Port));
+  TEST_LimiterPlan(0, AUDIO_GRAPH_FORMAT_S32);
+  TEST_LimiterProcess();
+  TEST_Bench("limiter S32 stereo no look-ahead", &Graph, &Port, (uint8_t*)Block,
+             TEST_FRAMES * AUDIO_GRAPH_FRAME_SIZE(&Port));
+}
+
+/* Exported functions --------------------------------------------------------*/
+/**
+  * @brief  main
+  *         Runs the checks then the benchmarks.
+  * @param  None
+  * @retval 0 if all checks passed
+  */
+int  main(void)
+{
+  TEST_LimiterLatency();
+  TEST_LimiterCeiling();
+  TEST_LimiterEnvelope();
+  TEST_LimiterParams();
+  TEST_LimiterBench();
+  return TEST_Report("audio_limiter_test");
+}
+
+/************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
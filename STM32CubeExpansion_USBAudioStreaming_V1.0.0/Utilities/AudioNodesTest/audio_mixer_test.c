@@ -0,0 +1,556 @@
+/**
+  ******************************************************************************
+  * @file    audio_mixer_test.c
+  * @author  MCD Application Team
+  * @brief   host test of the mixer node (Projects/Common/Streaming/Src/audio_mixer_node.c) :
+  *          start on threshold, fades in and out, underrun, producer clock
+  *          drift, volume, pan, saturation and parameters checks, then
+  *          benchmarks. See readme.txt.
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2019  STMicroelectronics.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by ST under Ultimate Liberty license
+  * SLA0044, the "License"; You may not use this file except in compliance with
+  * the License. You may obtain a copy of the License at:
+  *                             www.st.com/SLA0044
+  *
+  ******************************************************************************
+  */
+/* Includes ------------------------------------------------------------------*/
+#include <math.h>
+#include "audio_nodes_test.h"
+#include "audio_mixer_node.h"
+
+/* Private defines -----------------------------------------------------------*/
+#define TEST_FREQUENCY                  48000U
+#define TEST_FRAMES                     48U
+#define TEST_CHANNELS                   2U
+#define TEST_SAMPLES                    (TEST_FRAMES * TEST_CHANNELS)
+#define TEST_MAX_FRAME_SIZE             8U      /* stereo S32 */
+#define TEST_PI                         3.14159265358979323846
+/* input rings hold 8 blocks, the inputs start with 3 blocks */
+#define TEST_RING_BLOCKS                8U
+#define TEST_THRESHOLD_BLOCKS           3U
+/* drifting producer, 20 s of a 100 Hz sine */
+#define TEST_DRIFT_BLOCKS               20000U
+#define TEST_DRIFT_TONE                 100.0
+#define TEST_DRIFT_LEVEL                0.3
+
+/* Private variables ---------------------------------------------------------*/
+static AUDIO_MixerNode_t MixerNode;
+static AUDIO_MixerInput_t Inputs[AUDIO_MIXER_MAX_INPUTS];
+static AUDIO_CircularBuffer_t Rings[AUDIO_MIXER_MAX_INPUTS];
+static uint8_t RingsData[AUDIO_MIXER_MAX_INPUTS][TEST_RING_BLOCKS * TEST_FRAMES * TEST_MAX_FRAME_SIZE];
+static double Phases[AUDIO_MIXER_MAX_INPUTS];
+static AUDIO_Graph_t Graph;
+static uint32_t Scratch[TEST_SAMPLES];
+static uint32_t Block[TEST_SAMPLES];
+static AUDIO_GraphPort_t Port;
+
+/* Private functions ---------------------------------------------------------*/
+/**
+  * @brief  TEST_MixerPlan
+  *         Builds and plans a graph of the mixer node alone with inputs_count inputs in the graph format. The
+  *         inputs are stopped, centered at 0 db, their rings are empty.
+  * @param  format(IN):         AUDIO_GRAPH_FORMAT_xxx
+  * @param  channels(IN):       graph channels count
+  * @param  inputs_count(IN):   inputs count
+  * @param  input_channels(IN): inputs channels count
+  * @retval None
+  */
+static void  TEST_MixerPlan(uint8_t format, uint8_t channels, uint8_t inputs_count, uint8_t input_channels)
+{
+  AUDIO_GraphPort_t input_port;
+
+  Port.frequency = TEST_FREQUENCY;
+  Port.channels_count = channels;
+  Port.format = format;
+  input_port = Port;
+  input_port.channels_count = input_channels;
+  AUDIO_MixerInit(&MixerNode);
+  for(uint8_t i = 0; i < inputs_count; i++)
+  {
+    Rings[i].data = RingsData[i];
+    Rings[i].rd_ptr = Rings[i].wr_ptr = 0;
+    Rings[i].size = (uint16_t)(TEST_RING_BLOCKS * TEST_FRAMES * AUDIO_GRAPH_FRAME_SIZE(&input_port));
+    Phases[i] = 0;
+    TEST_CHECK(AUDIO_MixerInputInit(&Inputs[i], &Rings[i], &input_port,
+                                    (uint16_t)(TEST_THRESHOLD_BLOCKS * TEST_FRAMES *
+                                               AUDIO_GRAPH_FRAME_SIZE(&input_port))) == 0, "input init");
+    TEST_CHECK(AUDIO_MixerAddInput(&MixerNode, &Inputs[i]) == 0, "add input");
+  }
+  AUDIO_GraphInit(&Graph, (uint8_t*)Scratch, sizeof(Scratch));
+  AUDIO_GraphAddNode(&Graph, &MixerNode.processing);
+  TEST_CHECK(AUDIO_GraphPlan(&Graph, &Port) == 0, "plan");
+}
+
+/**
+  * @brief  TEST_MixerProduce
+  *         Writes frames to an input ring as its producer, the same value on all channels.
+  * @param  input(IN):     input
+  * @param  frames(IN):    frames count
+  * @param  level(IN):     amplitude, full scale is 1
+  * @param  frequency(IN): tone frequency, 0 writes level
+  * @retval None
+  */
+static void  TEST_MixerProduce(AUDIO_MixerInput_t* input, uint32_t frames, double level, double frequency)
+{
+  AUDIO_CircularBuffer_t* ring = input->buffer;
+  double* phase = &Phases[input - Inputs];
+
+  for(uint32_t f = 0; f < frames; f++)
+  {
+    TEST_CHECK(AUDIO_BUFFER_FREE_SIZE(ring) > AUDIO_GRAPH_FRAME_SIZE(&input->port), "ring overflow");
+    for(uint8_t c = 0; c < input->port.channels_count; c++)
+    {
+      TEST_WriteSample(ring->data + ring->wr_ptr, input->port.format, 0, level * cos(*phase));
+      ring->wr_ptr += input->port.format;
+      if(ring->wr_ptr >= ring->size)
+      {
+        ring->wr_ptr = 0;
+      }
+    }
+    *phase += 2.0 * TEST_PI * frequency / TEST_FREQUENCY;
+  }
+}
+
+/**
+  * @brief  TEST_MixerProcess
+  *         Fills the block with level and mixes the inputs into it.
+  * @param  level(IN): block samples value
+  * @retval None
+  */
+static void  TEST_MixerProcess(double level)
+{
+  for(uint32_t i = 0; i < TEST_FRAMES * Port.channels_count; i++)
+  {
+    TEST_WriteSample((uint8_t*)Block, Port.format, i, level);
+  }
+  TEST_CHECK(AUDIO_GraphProcess(&Graph, &Port, (uint8_t*)Block, (uint16_t)(TEST_FRAMES * AUDIO_GRAPH_FRAME_SIZE(&Port))) == 0,
+             "process");
+}
+
+/**
+  * @brief  TEST_MixerSample
+  *         Reads a sample of the block.
+  * @param  frame(IN):   frame index
+  * @param  channel(IN): channel index
+  * @retval sample value, full scale is 1
+  */
+static double  TEST_MixerSample(uint32_t frame, uint32_t channel)
+{
+  return TEST_ReadSample((const uint8_t*)Block, Port.format, frame * Port.channels_count + channel);
+}
+
+/**
+  * @brief  TEST_MixerCheckRamp
+  *         Checks that a channel of the block moves monotonically from previous to last, by steps not larger
+  *         than an even split of the change.
+  * @param  frames(IN):   ramp frames count from the block start
+  * @param  channel(IN):  channel index
+  * @param  previous(IN): channel value before the block
+  * @param  last(IN):     expected value of the last ramp frame
+  * @retval None
+  */
+static void  TEST_MixerCheckRamp(uint32_t frames, uint32_t channel, double previous, double last)
+{
+  double tolerance = 4.0 / 32768.0;
+  double max_step = fabs(last - previous) / frames + tolerance;
+  double value = previous, sample;
+
+  for(uint32_t f = 0; f < frames; f++)
+  {
+    sample = TEST_MixerSample(f, channel);
+    TEST_CHECK(fabs(sample - value) <= max_step, "channel %u frame %u step %f > %f", channel, f, sample - value,
+               max_step);
+    TEST_CHECK((last >= previous)? (sample >= value - tolerance) : (sample <= value + tolerance),
+               "channel %u frame %u not monotonic", channel, f);
+    value = sample;
+  }
+  TEST_CHECK(fabs(value - last) <= tolerance, "channel %u ends at %f instead of %f", channel, value, last);
+}
+
+/**
+  * @brief  TEST_MixerCheckLevel
+  *         Checks that all frames of a channel of the block are at level.
+  * @param  channel(IN): channel index
+  * @param  level(IN):   expected value
+  * @retval None
+  */
+static void  TEST_MixerCheckLevel(uint32_t channel, double level)
+{
+  /* one LSB of rounding for the gain and one for the add */
+  double tolerance = ldexp(2.0, 1 - 8 * Port.format) + fabs(level) * 1e-6;
+
+  for(uint32_t f = 0; f < TEST_FRAMES; f++)
+  {
+    TEST_CHECK(fabs(TEST_MixerSample(f, channel) - level) <= tolerance, "format %u channel %u frame %u : %f instead of %f",
+               Port.format, channel, f, TEST_MixerSample(f, channel), level);
+  }
+}
+
+/**
+  * @brief  TEST_MixerStartStop
+  *         A mono input waits for its threshold, skips its older frames, fades in, plays, then fades out once
+  *         stopped by its producer.
+  * @param  None
+  * @retval None
+  */
+static void  TEST_MixerStartStop(void)
+{
+  AUDIO_MixerInput_t* input = &Inputs[0];
+  double level = 0.5 * cos(TEST_PI / 4.0);
+
+  TEST_MixerPlan(AUDIO_GRAPH_FORMAT_S16, TEST_CHANNELS, 1, 1);
+  AUDIO_MixerStartInput(input);
+  TEST_MixerProduce(input, (TEST_THRESHOLD_BLOCKS - 1) * TEST_FRAMES, 0.5, 0);
+  TEST_MixerProcess(0);
+  TEST_CHECK(input->state == AUDIO_MIXER_INPUT_STOPPED, "started below the threshold");
+  TEST_MixerCheckLevel(0, 0);
+  TEST_MixerCheckLevel(1, 0);
+
+  /* 5 blocks in the ring, starts with the threshold : 2 blocks left after the first one */
+  TEST_MixerProduce(input, 3 * TEST_FRAMES, 0.5, 0);
+  TEST_MixerProcess(0);
+  TEST_CHECK(input->state == AUDIO_MIXER_INPUT_RUNNING, "not started on the threshold");
+  TEST_CHECK(AUDIO_BUFFER_FILLED_SIZE(input->buffer) == (TEST_THRESHOLD_BLOCKS - 1) * TEST_FRAMES * 2U,
+             "%u bytes left after the start", AUDIO_BUFFER_FILLED_SIZE(input->buffer));
+  TEST_MixerCheckRamp(TEST_FRAMES, 0, 0, level);
+  TEST_MixerCheckRamp(TEST_FRAMES, 1, 0, level);
+  TEST_MixerProduce(input, TEST_FRAMES, 0.5, 0);
+  TEST_MixerProcess(0);
+  TEST_MixerCheckLevel(0, level);
+  TEST_MixerCheckLevel(1, level);
+
+  /* stop, the ring still holds frames */
+  AUDIO_MixerStopInput(input);
+  TEST_MixerProduce(input, TEST_FRAMES, 0.5, 0);
+  TEST_MixerProcess(0);
+  TEST_CHECK(input->state == AUDIO_MIXER_INPUT_STOPPED, "not stopped");
+  TEST_MixerCheckRamp(TEST_FRAMES, 0, level, 0);
+  TEST_MixerCheckRamp(TEST_FRAMES, 1, level, 0);
+  TEST_MixerProcess(0);
+  TEST_MixerCheckLevel(0, 0);
+  TEST_MixerCheckLevel(1, 0);
+}
+
+/**
+  * @brief  TEST_MixerUnderrun
+  *         A running input whose producer runs late fades out on its last frames, the rest of the block is left
+  *         as is, then it restarts with a fade in once the threshold is reached again.
+  * @param  None
+  * @retval None
+  */
+static void  TEST_MixerUnderrun(void)
+{
+  AUDIO_MixerInput_t* input = &Inputs[0];
+  double block_level = 0.125, level = 0.25;
+  uint32_t half = TEST_FRAMES / 2;
+
+  TEST_MixerPlan(AUDIO_GRAPH_FORMAT_S16, TEST_CHANNELS, 1, 2);
+  AUDIO_MixerStartInput(input);
+  TEST_MixerProduce(input, TEST_THRESHOLD_BLOCKS * TEST_FRAMES, level, 0);
+  for(uint32_t b = 0; b < TEST_THRESHOLD_BLOCKS; b++)
+  {
+    TEST_MixerProcess(block_level);
+  }
+  TEST_CHECK(input->state == AUDIO_MIXER_INPUT_RUNNING, "stopped before the underrun");
+  TEST_MixerCheckLevel(0, block_level + level);
+
+  /* half a block left */
+  TEST_MixerProduce(input, half, level, 0);
+  TEST_MixerProcess(block_level);
+  TEST_CHECK(input->state == AUDIO_MIXER_INPUT_STOPPED, "not stopped on underrun");
+  TEST_MixerCheckRamp(half, 0, block_level + level, block_level);
+  TEST_MixerCheckRamp(half, 1, block_level + level, block_level);
+  for(uint32_t f = half; f < TEST_FRAMES; f++)
+  {
+    TEST_CHECK(TEST_MixerSample(f, 0) == block_level, "frame %u after the underrun : %f", f, TEST_MixerSample(f, 0));
+  }
+  TEST_CHECK(AUDIO_BUFFER_FILLED_SIZE(input->buffer) == 0, "frames left after the underrun");
+
+  /* restarts on the threshold */
+  TEST_MixerProduce(input, TEST_FRAMES, level, 0);
+  TEST_MixerProcess(block_level);
+  TEST_CHECK(input->state == AUDIO_MIXER_INPUT_STOPPED, "restarted below the threshold");
+  TEST_MixerCheckLevel(0, block_level);
+  TEST_MixerProduce(input, (TEST_THRESHOLD_BLOCKS - 1) * TEST_FRAMES, level, 0);
+  TEST_MixerProcess(block_level);
+  TEST_CHECK(input->state == AUDIO_MIXER_INPUT_RUNNING, "not restarted");
+  TEST_MixerCheckRamp(TEST_FRAMES, 0, block_level, block_level + level);
+}
+
+/**
+  * @brief  TEST_MixerDrift
+  *         A producer clocked ppm apart from the playback feeds a tone for TEST_DRIFT_BLOCKS blocks : the input
+  *         never stops, the ring filling stays around the threshold and the interpolated frame skips and inserts
+  *         don't add steps to the tone.
+  * @param  ppm(IN): producer clock offset in parts per million
+  * @retval None
+  */
+static void  TEST_MixerDrift(double ppm)
+{
+  AUDIO_MixerInput_t* input = &Inputs[0];
+  double produced = 0, step, max_step = 0, previous = 0, sample;
+  /* steepest step of the centered tone, stretched by the drift and an interpolated frame */
+  double step_limit = TEST_DRIFT_LEVEL * cos(TEST_PI / 4.0) * 2.0 * TEST_PI * TEST_DRIFT_TONE / TEST_FREQUENCY *
+                      (1.0 + fabs(ppm) * 1e-6) * (1.0 + 1.0 / TEST_FRAMES) + 2.0 / 32768.0;
+  int32_t threshold = TEST_THRESHOLD_BLOCKS * TEST_FRAMES, margin = threshold / 2, filled;
+  int32_t min_filled = INT32_MAX, max_filled = 0;
+  uint32_t stops = 0, frames;
+
+  TEST_MixerPlan(AUDIO_GRAPH_FORMAT_S16, TEST_CHANNELS, 1, 1);
+  AUDIO_MixerStartInput(input);
+  TEST_MixerProduce(input, (uint32_t)threshold, TEST_DRIFT_LEVEL, TEST_DRIFT_TONE);
+  for(uint32_t b = 0; b < TEST_DRIFT_BLOCKS; b++)
+  {
+    produced += TEST_FRAMES * (1.0 + ppm * 1e-6);
+    frames = (uint32_t)produced;
+    produced -= frames;
+    TEST_MixerProduce(input, frames, TEST_DRIFT_LEVEL, TEST_DRIFT_TONE);
+    /* settled after the averaging */
+    filled = AUDIO_BUFFER_FILLED_SIZE(input->buffer) / 2;
+    if(b > TEST_DRIFT_BLOCKS / 2)
+    {
+      min_filled = (filled < min_filled)? filled : min_filled;
+      max_filled = (filled > max_filled)? filled : max_filled;
+    }
+    TEST_MixerProcess(0);
+    if(input->state != AUDIO_MIXER_INPUT_RUNNING)
+    {
+      stops++;
+    }
+    for(uint32_t f = 0; f < TEST_FRAMES; f++)
+    {
+      sample = TEST_MixerSample(f, 0);
+      step = fabs(sample - previous);
+      /* the first block fades in */
+      if((b > 0) && (step > max_step))
+      {
+        max_step = step;
+      }
+      previous = sample;
+    }
+  }
+  TEST_CHECK(stops == 0, "%+.0f ppm : %u blocks stopped", ppm, stops);
+  TEST_CHECK(max_step <= step_limit, "%+.0f ppm : step %f > %f", ppm, max_step, step_limit);
+  /* the correction is taken once the average leaves the margin, it lags by a fraction of a block */
+  TEST_CHECK((min_filled >= threshold - margin - (int32_t)TEST_FRAMES / 4) &&
+             (max_filled <= threshold + margin + (int32_t)TEST_FRAMES / 4), "%+.0f ppm : ring filling %d to %d frames", ppm, min_filled, max_filled);
+  printf("drift %+6.0f ppm : ring %3d to %3d frames, max step %.5f\n", ppm, min_filled, max_filled, max_step);
+}
+
+/**
+  * @brief  TEST_MixerLevels
+  *         Pan of a mono input, balance of a stereo input, volume, several inputs and saturation, in all formats.
+  * @param  None
+  * @retval None
+  */
+static void  TEST_MixerLevels(void)
+{
+  static const uint8_t formats[] = {AUDIO_GRAPH_FORMAT_S16, AUDIO_GRAPH_FORMAT_S24, AUDIO_GRAPH_FORMAT_S32};
+  AUDIO_MixerInput_t* input = &Inputs[0];
+  double level = 0.5, gain;
+
+  for(uint32_t i = 0; i < sizeof(formats); i++)
+  {
+    /* mono input, constant power pan */
+    TEST_MixerPlan(formats[i], TEST_CHANNELS, 1, 1);
+    AUDIO_MixerStartInput(input);
+    TEST_MixerProduce(input, TEST_THRESHOLD_BLOCKS * TEST_FRAMES, level, 0);
+    AUDIO_MixerSetInputPan(input, -AUDIO_MIXER_PAN_MAX);
+    TEST_MixerProcess(0);
+    TEST_MixerProduce(input, TEST_FRAMES, level, 0);
+    TEST_MixerProcess(0);
+    TEST_MixerCheckLevel(0, level);
+    TEST_MixerCheckLevel(1, 0);
+    AUDIO_MixerSetInputPan(input, AUDIO_MIXER_PAN_MAX);
+    TEST_MixerProduce(input, TEST_FRAMES, level, 0);
+    TEST_MixerProcess(0);
+    TEST_MixerProduce(input, TEST_FRAMES, level, 0);
+    TEST_MixerProcess(0);
+    TEST_MixerCheckLevel(0, 0);
+    TEST_MixerCheckLevel(1, level);
+
+    /* volume, -6 db centered then below the volume range */
+    AUDIO_MixerSetInputPan(input, 0);
+    TEST_CHECK(AUDIO_MixerSetInputVolume(input, -6 * 256) == 0, "-6 db");
+    TEST_MixerProduce(input, TEST_FRAMES, level, 0);
+    TEST_MixerProcess(0);
+    TEST_MixerProduce(input, TEST_FRAMES, level, 0);
+    TEST_MixerProcess(0);
+    gain = pow(10.0, -6.0 / 20.0) * cos(TEST_PI / 4.0);
+    TEST_MixerCheckLevel(0, level * gain);
+    TEST_MixerCheckLevel(1, level * gain);
+    AUDIO_MixerSetInputVolume(input, AUDIO_MIXER_MIN_DB_256 - 1);
+    TEST_MixerProduce(input, TEST_FRAMES, level, 0);
+    TEST_MixerProcess(0);
+    TEST_MixerProduce(input, TEST_FRAMES, level, 0);
+    TEST_MixerProcess(0);
+    TEST_MixerCheckLevel(0, 0);
+    TEST_MixerCheckLevel(1, 0);
+
+    /* stereo input balance */
+    TEST_MixerPlan(formats[i], TEST_CHANNELS, 1, 2);
+    AUDIO_MixerStartInput(input);
+    AUDIO_MixerSetInputPan(input, AUDIO_MIXER_PAN_MAX / 2);
+    TEST_MixerProduce(input, TEST_THRESHOLD_BLOCKS * TEST_FRAMES, level, 0);
+    TEST_MixerProcess(0);
+    TEST_MixerProduce(input, TEST_FRAMES, level, 0);
+    TEST_MixerProcess(0);
+    TEST_MixerCheckLevel(0, level / 2);
+    TEST_MixerCheckLevel(1, level);
+
+    /* all inputs added to the block, then saturated at both ends */
+    TEST_MixerPlan(formats[i], TEST_CHANNELS, AUDIO_MIXER_MAX_INPUTS, 2);
+    for(uint8_t n = 0; n < AUDIO_MIXER_MAX_INPUTS; n++)
+    {
+      AUDIO_MixerStartInput(&Inputs[n]);
+      TEST_MixerProduce(&Inputs[n], TEST_THRESHOLD_BLOCKS * TEST_FRAMES, 0.0625 * (n + 1), 0);
+    }
+    TEST_MixerProcess(0.125);
+    for(uint8_t n = 0; n < AUDIO_MIXER_MAX_INPUTS; n++)
+    {
+      TEST_MixerProduce(&Inputs[n], TEST_FRAMES, 0.0625 * (n + 1), 0);
+    }
+    TEST_MixerProcess(0.125);
+    TEST_MixerCheckLevel(0, 0.75);
+    TEST_MixerCheckLevel(1, 0.75);
+    TEST_MixerProcess(0.5);
+    TEST_MixerCheckLevel(0, 1.0 - ldexp(1.0, 1 - 8 * formats[i]));
+    TEST_MixerPlan(formats[i], TEST_CHANNELS, 1, 2);
+    AUDIO_MixerStartInput(input);
+    TEST_MixerProduce(input, (TEST_THRESHOLD_BLOCKS + 1) * TEST_FRAMES, -level, 0);
+    TEST_MixerProcess(-0.75);
+    TEST_MixerProcess(-0.75);
+    TEST_MixerCheckLevel(0, -1.0);
+    TEST_MixerCheckLevel(1, -1.0);
+  }
+
+  /* mono graph, the left and right gains are averaged */
+  TEST_MixerPlan(AUDIO_GRAPH_FORMAT_S16, 1, 1, 2);
+  AUDIO_MixerStartInput(input);
+  TEST_MixerProduce(input, (TEST_THRESHOLD_BLOCKS + 1) * TEST_FRAMES, level, 0);
+  TEST_MixerProcess(0);
+  TEST_MixerProcess(0);
+  TEST_MixerCheckLevel(0, level);
+}
+
+/**
+  * @brief  TEST_MixerParams
+  *         Invalid inputs and controls are refused, inputs of another rate are not mixed.
+  * @param  None
+  * @retval None
+  */
+static void  TEST_MixerParams(void)
+{
+  AUDIO_MixerInput_t* input = &Inputs[0];
+  AUDIO_MixerInput_t extra;
+  AUDIO_GraphPort_t port = {TEST_FREQUENCY, 3, AUDIO_GRAPH_FORMAT_S16};
+
+  Rings[0].data = RingsData[0];
+  Rings[0].rd_ptr = Rings[0].wr_ptr = 0;
+  Rings[0].size = 6 * TEST_FRAMES + 2;
+  TEST_CHECK(AUDIO_MixerInputInit(&extra, &Rings[0], &port, 0) != 0, "3 channels input");
+  port.channels_count = 2;
+  port.format = 1;
+  TEST_CHECK(AUDIO_MixerInputInit(&extra, &Rings[0], &port, 0) != 0, "8 bits input");
+  port.format = AUDIO_GRAPH_FORMAT_S32;
+  TEST_CHECK(AUDIO_MixerInputInit(&extra, &Rings[0], &port, 0) != 0, "ring size not a multiple of the frame");
+  Rings[0].size = 6 * TEST_FRAMES;
+  port.format = AUDIO_GRAPH_FORMAT_S24;
+  TEST_CHECK(AUDIO_MixerInputInit(&extra, &Rings[0], &port, Rings[0].size + 1) != 0, "threshold above the ring");
+  TEST_CHECK(AUDIO_MixerInputInit(&extra, &Rings[0], &port, Rings[0].size) == 0, "S24 stereo input");
+
+  TEST_MixerPlan(AUDIO_GRAPH_FORMAT_S16, TEST_CHANNELS, AUDIO_MIXER_MAX_INPUTS, 1);
+  TEST_CHECK(AUDIO_MixerAddInput(&MixerNode, &extra) != 0, "input above max");
+  TEST_CHECK(AUDIO_MixerSetInputVolume(input, AUDIO_MIXER_MAX_DB_256 + 1) != 0, "volume above max");
+  TEST_CHECK(AUDIO_MixerSetInputPan(input, AUDIO_MIXER_PAN_MAX + 1) != 0, "pan above max");
+  TEST_CHECK(AUDIO_MixerSetInputPan(input, -AUDIO_MIXER_PAN_MAX - 1) != 0, "pan below min");
+  input->port.frequency = 44100;
+  AUDIO_MixerStartInput(input);
+  TEST_MixerProduce(input, TEST_THRESHOLD_BLOCKS * TEST_FRAMES, 0.5, 0);
+  TEST_MixerProcess(0);
+  TEST_CHECK(input->state == AUDIO_MIXER_INPUT_STOPPED, "44.1 KHz input mixed in a 48 KHz graph");
+  TEST_MixerCheckLevel(0, 0);
+}
+
+/**
+  * @brief  TEST_MixerRun
+  *         Mixes the inputs TEST_BENCH_BLOCKS times, the rings are refilled by moving their write pointer, and
+  *         prints the time like TEST_Bench.
+  * @param  name(IN):    benchmark name
+  * @param  filling(IN): rings filling in blocks, above the threshold and its margin the input is interpolated
+  * @retval None
+  */
+static void  TEST_MixerRun(const char* name, uint32_t filling)
+{
+  uint16_t length = (uint16_t)(TEST_FRAMES * AUDIO_GRAPH_FRAME_SIZE(&Port));
+  double start, elapsed, frames = (double)TEST_BENCH_BLOCKS * TEST_FRAMES;
+  uint32_t wr_ptr;
+
+  for(uint8_t n = 0; n < MixerNode.inputs_count; n++)
+  {
+    AUDIO_MixerStartInput(&Inputs[n]);
+    TEST_MixerProduce(&Inputs[n], TEST_RING_BLOCKS * TEST_FRAMES - 1, 0.25, 1000.0);
+  }
+  start = TEST_TimeUs();
+  for(uint32_t b = 0; b < TEST_BENCH_BLOCKS; b++)
+  {
+    for(uint8_t n = 0; n < MixerNode.inputs_count; n++)
+    {
+      wr_ptr = Rings[n].rd_ptr + filling * TEST_FRAMES * AUDIO_GRAPH_FRAME_SIZE(&Inputs[n].port);
+      Rings[n].wr_ptr = (uint16_t)((wr_ptr >= Rings[n].size)? wr_ptr - Rings[n].size : wr_ptr);
+    }
+    AUDIO_GraphProcess(&Graph, &Port, (uint8_t*)Block, length);
+  }
+  elapsed = TEST_TimeUs() - start;
+  printf("bench %-36s %8.2f ns/frame %8.3f %% of real time\n", name, elapsed * 1000.0 / frames,
+         elapsed * Port.frequency / (frames * 10000.0));
+}
+
+/**
+  * @brief  TEST_MixerBench
+  *         Mixing of one and four inputs in 1 ms blocks, with and without drift compensation.
+  * @param  None
+  * @retval None
+  */
+static void  TEST_MixerBench(void)
+{
+  TEST_MixerPlan(AUDIO_GRAPH_FORMAT_S16, TEST_CHANNELS, 1, 2);
+  TEST_MixerRun("mixer S16 stereo 1 stereo input", TEST_THRESHOLD_BLOCKS);
+  TEST_MixerPlan(AUDIO_GRAPH_FORMAT_S16, TEST_CHANNELS, 1, 2);
+  TEST_MixerRun("mixer S16 stereo 1 input interpolated", 2 * TEST_THRESHOLD_BLOCKS);
+  TEST_MixerPlan(AUDIO_GRAPH_FORMAT_S16, TEST_CHANNELS, AUDIO_MIXER_MAX_INPUTS, 1);
+  TEST_MixerRun("mixer S16 stereo 4 mono inputs", TEST_THRESHOLD_BLOCKS);
+  TEST_MixerPlan(AUDIO_GRAPH_FORMAT_S32, TEST_CHANNELS, 1, 2);
+  TEST_MixerRun("mixer S32 stereo 1 stereo input", TEST_THRESHOLD_BLOCKS);
+}
+
+/* Exported functions --------------------------------------------------------*/
+/**
+  * @brief  main
+  *         Runs the checks then the benchmarks.
+  * @param  None
+  * @retval 0 if all checks passed
+  */
+int  main(void)
+{
+  static const double drifts[] = {-20000.0, -1000.0, 0.0, 1000.0, 20000.0};
+
+  TEST_MixerStartStop();
+  TEST_MixerUnderrun();
+  for(uint32_t i = 0; i < sizeof(drifts) / sizeof(drifts[0]); i++)
+  {
+    TEST_MixerDrift(drifts[i]);
+  }
+  TEST_MixerLevels();
+  TEST_MixerParams();
+  TEST_MixerBench();
+  return TEST_Report("audio_mixer_test");
+}
+
+/************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
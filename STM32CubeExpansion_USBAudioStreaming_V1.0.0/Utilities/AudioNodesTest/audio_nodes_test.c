@@ -0,0 +1,306 @@
+/**
+  ******************************************************************************
+  * @file    audio_nodes_test.c
+  * @author  MCD Application Team
+  * @brief   checks and benchmark helpers shared by the processing nodes tests.
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2019  STMicroelectronics.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by ST under Ultimate Liberty license
+  * SLA0044, the "License"; You may not use this file except in compliance with
+  * the License. You may obtain a copy of the License at:
+  *                             www.st.com/SLA0044
+  *
+  ******************************************************************************
+  */
+/* Includes ------------------------------------------------------------------*/
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#include "audio_nodes_test.h"
+
+/* Private defines -----------------------------------------------------------*/
+#define TEST_WAV_HEADER_SIZE            44U
+#define TEST_WAV_PCM                    1U
+#define TEST_WAV_EXTENSIBLE             0xFFFEU
+
+/* Exported variables --------------------------------------------------------*/
+int TEST_Checks;
+int TEST_Failures;
+
+/* Exported functions --------------------------------------------------------*/
+/**
+  * @brief  TEST_WriteSample
+  *         Writes a sample of a block, rounded and saturated to the format.
+  * @param  data(IN):   block
+  * @param  format(IN): AUDIO_GRAPH_FORMAT_xxx
+  * @param  index(IN):  sample index in the block
+  * @param  value(IN):  sample value, full scale is [-1, 1[
+  * @retval None
+  */
+void  TEST_WriteSample(uint8_t* data, uint8_t format, uint32_t index, double value)
+{
+  double scaled;
+  int32_t sample;
+
+  /* MSB aligned in 32 bits, then shifted to the format */
+  scaled = floor(value * 2147483648.0 + 0.5);
+  sample = (scaled >= 2147483647.0)? INT32_MAX : ((scaled <= -2147483648.0)? INT32_MIN : (int32_t)scaled);
+  data += index * format;
+  switch(format)
+  {
+  case AUDIO_GRAPH_FORMAT_S16:
+    *(int16_t*)data = (int16_t)(sample >> 16);
+    break;
+  case AUDIO_GRAPH_FORMAT_S24:
+    data[0] = (uint8_t)(sample >> 8);
+    data[1] = (uint8_t)(sample >> 16);
+    data[2] = (uint8_t)(sample >> 24);
+    break;
+  default:
+    *(int32_t*)data = sample;
+    break;
+  }
+}
+
+/**
+  * @brief  TEST_ReadSample
+  *         Reads a sample of a block.
+  * @param  data(IN):   block
+  * @param  format(IN): AUDIO_GRAPH_FORMAT_xxx
+  * @param  index(IN):  sample index in the block
+  * @retval sample value, full scale is [-1, 1[
+  */
+double  TEST_ReadSample(const uint8_t* data, uint8_t format, uint32_t index)
+{
+  int32_t sample;
+
+  data += index * format;
+  switch(format)
+  {
+  case AUDIO_GRAPH_FORMAT_S16:
+    sample = (int32_t)((uint32_t)*(const int16_t*)data << 16);
+    break;
+  case AUDIO_GRAPH_FORMAT_S24:
+    sample = (int32_t)(((uint32_t)data[0] << 8) | ((uint32_t)data[1] << 16) | ((uint32_t)data[2] << 24));
+    break;
+  default:
+    sample = *(const int32_t*)data;
+    break;
+  }
+  return sample / 2147483648.0;
+}
+
+/**
+  * @brief  TEST_TimeUs
+  *         Reads the monotonic clock.
+  * @param  None
+  * @retval time in us
+  */
+double  TEST_TimeUs(void)
+{
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec * 1000000.0 + now.tv_nsec / 1000.0;
+}
+
+/**
+  * @brief  TEST_Cycles
+  *         Reads the host time stamp counter, or the monotonic clock in ns on hosts without one.
+  * @param  None
+  * @retval cycles
+  */
+uint64_t  TEST_Cycles(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000000000U + (uint64_t)now.tv_nsec;
+#endif
+}
+
+/**
+  * @brief  TEST_Bench
+  *         Processes TEST_BENCH_BLOCKS times the same block with a planned graph and prints the processing time
+  *         per frame and its share of the stream real time. Host times only compare implementations, target
+  *         cycles are measured with the audio profiler (USE_AUDIO_PROFILER).
+  * @param  name(IN):   benchmark name
+  * @param  graph(IN):  planned graph
+  * @param  port(IN):   format of the block
+  * @param  data(IN):   block, processed in place
+  * @param  length(IN): block size in bytes
+  * @retval time per frame in ns
+  */
+#if USE_AUDIO_PROCESSING_GRAPH
+double  TEST_Bench(const char* name, AUDIO_Graph_t* graph, const AUDIO_GraphPort_t* port, uint8_t* data,
+                   uint16_t length)
+{
+  double start, elapsed, frames;
+
+  frames = (double)TEST_BENCH_BLOCKS * (length / AUDIO_GRAPH_FRAME_SIZE(port));
+  start = TEST_TimeUs();
+  for(uint32_t i = 0; i < TEST_BENCH_BLOCKS; i++)
+  {
+    AUDIO_GraphProcess(graph, port, data, length);
+  }
+  elapsed = TEST_TimeUs() - start;
+  printf("bench %-36s %8.2f ns/frame %8.3f %% of real time\n", name, elapsed * 1000.0 / frames,
+         elapsed * port->frequency / (frames * 10000.0));
+  return elapsed * 1000.0 / frames;
+}
+#endif /* USE_AUDIO_PROCESSING_GRAPH */
+
+/**
+  * @brief  TEST_WavRead
+  *         Loads a PCM WAV file (16, 24 or 32 bits, any channels count).
+  * @param  path(IN):    file
+  * @param  port(OUT):   frequency, channels count and AUDIO_GRAPH_FORMAT_xxx of the samples
+  * @param  data(OUT):   interleaved samples, allocated, freed by the caller
+  * @param  frames(OUT): samples count per channel
+  * @retval 0 if no error, -1 if the file can't be read or is not a supported WAV
+  */
+int8_t  TEST_WavRead(const char* path, AUDIO_GraphPort_t* port, uint8_t** data, uint32_t* frames)
+{
+  uint8_t chunk[8], fmt[16];
+  uint32_t size;
+  uint16_t tag, bits;
+  int8_t error = -1;
+  FILE* file = fopen(path, "rb");
+
+  *data = NULL;
+  if(file == NULL)
+  {
+    return -1;
+  }
+  if((fread(chunk, 1, 8, file) != 8) || (memcmp(chunk, "RIFF", 4) != 0) ||
+     (fread(chunk, 1, 4, file) != 4) || (memcmp(chunk, "WAVE", 4) != 0))
+  {
+    fclose(file);
+    return -1;
+  }
+  memset(fmt, 0, sizeof(fmt));
+  while(fread(chunk, 1, 8, file) == 8)
+  {
+    size = chunk[4] | ((uint32_t)chunk[5] << 8) | ((uint32_t)chunk[6] << 16) | ((uint32_t)chunk[7] << 24);
+    if(memcmp(chunk, "fmt ", 4) == 0)
+    {
+      if((size < sizeof(fmt)) || (fread(fmt, 1, sizeof(fmt), file) != sizeof(fmt)) ||
+         (fseek(file, (long)((size - sizeof(fmt) + 1U) & ~1U), SEEK_CUR) != 0))
+      {
+        break;
+      }
+    }
+    else if(memcmp(chunk, "data", 4) == 0)
+    {
+      tag = (uint16_t)(fmt[0] | (fmt[1] << 8));
+      bits = (uint16_t)(fmt[14] | (fmt[15] << 8));
+      port->channels_count = (uint8_t)(fmt[2] | (fmt[3] << 8));
+      port->frequency = fmt[4] | ((uint32_t)fmt[5] << 8) | ((uint32_t)fmt[6] << 16) | ((uint32_t)fmt[7] << 24);
+      port->format = (uint8_t)(bits / 8U);
+      if(((tag != TEST_WAV_PCM) && (tag != TEST_WAV_EXTENSIBLE)) || (port->channels_count == 0) ||
+         ((bits != 16U) && (bits != 24U) && (bits != 32U)))
+      {
+        break;
+      }
+      *frames = size / AUDIO_GRAPH_FRAME_SIZE(port);
+      *data = malloc(size);
+      if((*data != NULL) && (fread(*data, 1, size, file) == size))
+      {
+        error = 0;
+      }
+      break;
+    }
+    else if(fseek(file, (long)((size + 1U) & ~1U), SEEK_CUR) != 0)
+    {
+      break;
+    }
+  }
+  fclose(file);
+  if(error != 0)
+  {
+    free(*data);
+    *data = NULL;
+  }
+  return error;
+}
+
+/**
+  * @brief  TEST_WavWrite
+  *         Saves samples as a PCM WAV file.
+  * @param  path(IN):   file
+  * @param  port(IN):   frequency, channels count and AUDIO_GRAPH_FORMAT_xxx of the samples
+  * @param  data(IN):   interleaved samples
+  * @param  frames(IN): samples count per channel
+  * @retval 0 if no error, -1 if the file can't be written
+  */
+int8_t  TEST_WavWrite(const char* path, const AUDIO_GraphPort_t* port, const uint8_t* data, uint32_t frames)
+{
+  uint8_t header[TEST_WAV_HEADER_SIZE];
+  uint32_t size = frames * AUDIO_GRAPH_FRAME_SIZE(port);
+  uint32_t fields[5];
+  int8_t error = 0;
+  FILE* file = fopen(path, "wb");
+
+  if(file == NULL)
+  {
+    return -1;
+  }
+  /* RIFF size, fmt size, frequency, bytes per second, data size : little endian 32 bits fields */
+  fields[0] = TEST_WAV_HEADER_SIZE - 8U + size;
+  fields[1] = 16U;
+  fields[2] = port->frequency;
+  fields[3] = port->frequency * AUDIO_GRAPH_FRAME_SIZE(port);
+  fields[4] = size;
+  memcpy(header, "RIFF....WAVEfmt ....", 20);
+  memcpy(header + 36, "data", 4);
+  for(uint32_t i = 0; i < 4U; i++)
+  {
+    header[4 + i] = (uint8_t)(fields[0] >> (8U * i));
+    header[16 + i] = (uint8_t)(fields[1] >> (8U * i));
+    header[24 + i] = (uint8_t)(fields[2] >> (8U * i));
+    header[28 + i] = (uint8_t)(fields[3] >> (8U * i));
+    header[40 + i] = (uint8_t)(fields[4] >> (8U * i));
+  }
+  header[20] = TEST_WAV_PCM;
+  header[21] = 0;
+  header[22] = port->channels_count;
+  header[23] = 0;
+  header[32] = (uint8_t)AUDIO_GRAPH_FRAME_SIZE(port);
+  header[33] = 0;
+  header[34] = (uint8_t)(8U * port->format);
+  header[35] = 0;
+  if((fwrite(header, 1, sizeof(header), file) != sizeof(header)) || (fwrite(data, 1, size, file) != size))
+  {
+    error = -1;
+  }
+  if(fclose(file) != 0)
+  {
+    error = -1;
+  }
+  return error;
+}
+
+/**
+  * @brief  TEST_Report
+  *         Prints the checks summary.
+  * @param  name(IN): test name
+  * @retval 0 if all checks passed, the program exit status
+  */
+int  TEST_Report(const char* name)
+{
+  printf("%s : %d checks, %d failed\n", name, TEST_Checks, TEST_Failures);
+  return (TEST_Failures == 0)? 0 : 1;
+}
+
+/************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
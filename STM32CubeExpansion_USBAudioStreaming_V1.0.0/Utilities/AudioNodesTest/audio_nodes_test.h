@@ -0,0 +1,75 @@
+/**
+  ******************************************************************************
+  * @file    audio_nodes_test.h
+  * @author  MCD Application Team
+  * @brief   header of audio_nodes_test.c
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2019  STMicroelectronics.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by ST under Ultimate Liberty license
+  * SLA0044, the "License"; You may not use this file except in compliance with
+  * the License. You may obtain a copy of the License at:
+  *                             www.st.com/SLA0044
+  *
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __AUDIO_NODES_TEST_H
+#define __AUDIO_NODES_TEST_H
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdint.h>
+#include <stdio.h>
+#include "audio_graph.h"
+
+/* Exported constants --------------------------------------------------------*/
+#define TEST_BENCH_BLOCKS               20000U  /* blocks processed by a benchmark */
+
+/* Exported macros -----------------------------------------------------------*/
+/* node handles are 32 bits as on the target : the nodes are static variables and the tests are linked with -no-pie */
+#define TEST_HANDLE(node)               ((uint32_t)(uintptr_t)(node))
+/* counts a check, prints it when it fails */
+#define TEST_CHECK(condition, ...) \
+        do{ \
+          TEST_Checks++; \
+          if(!(condition)) \
+          { \
+            TEST_Failures++; \
+            printf("FAILED %s:%d : ", __FILE__, __LINE__); \
+            printf(__VA_ARGS__); \
+            printf("\n"); \
+          } \
+        }while(0)
+
+/* Exported variables --------------------------------------------------------*/
+extern int TEST_Checks;
+extern int TEST_Failures;
+
+/* Exported functions ------------------------------------------------------- */
+void    TEST_WriteSample(uint8_t* data, uint8_t format, uint32_t index, double value);
+double  TEST_ReadSample(const uint8_t* data, uint8_t format, uint32_t index);
+double  TEST_TimeUs(void);
+uint64_t  TEST_Cycles(void);
+#if USE_AUDIO_PROCESSING_GRAPH
+double  TEST_Bench(const char* name, AUDIO_Graph_t* graph, const AUDIO_GraphPort_t* port, uint8_t* data,
+                   uint16_t length);
+#endif /* USE_AUDIO_PROCESSING_GRAPH */
+int8_t  TEST_WavRead(const char* path, AUDIO_GraphPort_t* port, uint8_t** data, uint32_t* frames);
+int8_t  TEST_WavWrite(const char* path, const AUDIO_GraphPort_t* port, const uint8_t* data, uint32_t frames);
+int     TEST_Report(const char* name);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* __AUDIO_NODES_TEST_H */
+
+/************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
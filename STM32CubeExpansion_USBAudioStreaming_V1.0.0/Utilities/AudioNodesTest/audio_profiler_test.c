@@ -0,0 +1,246 @@
+/**
+  ******************************************************************************
+  * @file    audio_profiler_test.c
+  * @author  MCD Application Team
+  * @brief   host test of the audio profiler over the monotonic clock backend :
+  *          durations, statistics and histogram of timed probes, time of the
+  *          nested probes removed from the preempted one, probes beyond the
+  *          max depth, unbalanced exits and reset, then the report of the
+  *          probes as read on the target. See readme.txt.
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2019  STMicroelectronics.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by ST under Ultimate Liberty license
+  * SLA0044, the "License"; You may not use this file except in compliance with
+  * the License. You may obtain a copy of the License at:
+  *                             www.st.com/SLA0044
+  *
+  ******************************************************************************
+  */
+/* Includes ------------------------------------------------------------------*/
+#include "audio_nodes_test.h"
+#include "usbd_audio.h"
+#include "usb_audio.h"
+#include "audio_profiler.h"
+#include "audio_cycle_counter.h"
+
+/* Private defines -----------------------------------------------------------*/
+#define TEST_PROBE_NS                   20000U   /* duration of a timed probe */
+#define TEST_OUTER_NS                   30000U   /* duration of the outer probe before and after the nested one */
+#define TEST_NESTED_NS                  50000U   /* duration of the nested probe */
+#define TEST_RUNS                       100U
+#define TEST_TYPICAL_RUNS               90U      /* runs in the bin of their duration, the host may preempt the test */
+
+/* Private variables ---------------------------------------------------------*/
+static const char* const ProbeNames[AUDIO_PROFILER_PROBE_COUNT] =
+{
+  "USB data out", "USB data in", "USB SOF", "audio out half", "audio out complete", "audio in half",
+  "audio in complete", "playback session", "recording session", "deferred task"
+};
+
+/* Private functions ---------------------------------------------------------*/
+/**
+  * @brief  TEST_Busy
+  *         Spins for a duration of the profiler clock.
+  * @param  ns(IN): duration in nanoseconds
+  * @retval None
+  */
+static void  TEST_Busy(uint32_t ns)
+{
+  uint32_t start = AUDIO_CycleCounterGet();
+
+  while((uint32_t)(AUDIO_CycleCounterGet() - start) < ns)
+  {
+  }
+}
+
+/**
+  * @brief  TEST_HistogramCount
+  *         Sums the histogram of a probe.
+  * @param  stats(IN): probe statistics
+  * @retval count of measures in the histogram
+  */
+static uint32_t  TEST_HistogramCount(const AUDIO_ProfilerStats_t* stats)
+{
+  uint32_t i, count = 0;
+
+  for(i = 0; i < AUDIO_PROFILER_HISTOGRAM_BINS; i++)
+  {
+    count += stats->histogram[i];
+  }
+  return count;
+}
+
+/**
+  * @brief  TEST_Bin
+  *         Histogram bin of a duration.
+  * @param  ns(IN): duration
+  * @retval bin index
+  */
+static uint32_t  TEST_Bin(uint32_t ns)
+{
+  return 31U - (uint32_t)__builtin_clz(ns) - AUDIO_PROFILER_HISTOGRAM_FIRST_BIT;
+}
+
+/**
+  * @brief  TEST_Timed
+  *         Timed probes : count, min, mean and max of a fixed duration, histogram bin of the duration.
+  * @param  None
+  * @retval None
+  */
+static void  TEST_Timed(void)
+{
+  const AUDIO_ProfilerStats_t* stats = AUDIO_ProfilerGetStats(AUDIO_PROFILER_USB_SOF);
+  uint32_t i, mean;
+
+  for(i = 0; i < TEST_RUNS; i++)
+  {
+    AUDIO_PROFILER_ENTER(AUDIO_PROFILER_USB_SOF);
+    TEST_Busy(TEST_PROBE_NS);
+    AUDIO_PROFILER_EXIT(AUDIO_PROFILER_USB_SOF);
+  }
+  mean = AUDIO_ProfilerGetMeanCycles(AUDIO_PROFILER_USB_SOF);
+  TEST_CHECK(stats->count == TEST_RUNS, "%u measures for %u probes", stats->count, TEST_RUNS);
+  TEST_CHECK(stats->min_cycles >= TEST_PROBE_NS, "min %u ns shorter than the probe", stats->min_cycles);
+  TEST_CHECK((mean >= stats->min_cycles) && (mean <= stats->max_cycles), "mean %u ns out of [%u, %u]", mean,
+             stats->min_cycles, stats->max_cycles);
+  TEST_CHECK(TEST_HistogramCount(stats) == TEST_RUNS, "%u measures in the histogram", TEST_HistogramCount(stats));
+  TEST_CHECK(stats->histogram[TEST_Bin(TEST_PROBE_NS)] >= TEST_TYPICAL_RUNS, "%u measures in bin %u of the probe",
+             stats->histogram[TEST_Bin(TEST_PROBE_NS)], TEST_Bin(TEST_PROBE_NS));
+  TEST_CHECK((stats->max_depth == 1) && (stats->nested_count == 0), "depth %u, %u nested for a probe never nested",
+             stats->max_depth, stats->nested_count);
+}
+
+/**
+  * @brief  TEST_Nested
+  *         A probe preempting another one : its time is removed from the preempted probe.
+  * @param  None
+  * @retval None
+  */
+static void  TEST_Nested(void)
+{
+  const AUDIO_ProfilerStats_t* outer = AUDIO_ProfilerGetStats(AUDIO_PROFILER_DEFERRED_TASK);
+  const AUDIO_ProfilerStats_t* nested = AUDIO_ProfilerGetStats(AUDIO_PROFILER_USB_DATA_OUT);
+  uint32_t i;
+
+  for(i = 0; i < TEST_RUNS; i++)
+  {
+    AUDIO_PROFILER_ENTER(AUDIO_PROFILER_DEFERRED_TASK);
+    TEST_Busy(TEST_OUTER_NS);
+    AUDIO_PROFILER_ENTER(AUDIO_PROFILER_USB_DATA_OUT);
+    TEST_Busy(TEST_NESTED_NS);
+    AUDIO_PROFILER_EXIT(AUDIO_PROFILER_USB_DATA_OUT);
+    TEST_Busy(TEST_OUTER_NS);
+    AUDIO_PROFILER_EXIT(AUDIO_PROFILER_DEFERRED_TASK);
+  }
+  TEST_CHECK((outer->count == TEST_RUNS) && (nested->count == TEST_RUNS), "%u outer and %u nested measures",
+             outer->count, nested->count);
+  /* 60 us without the nested probe, 110 us with it : one bin apart */
+  TEST_CHECK((outer->min_cycles >= 2U * TEST_OUTER_NS) &&
+             (outer->histogram[TEST_Bin(2U * TEST_OUTER_NS)] >= TEST_TYPICAL_RUNS),
+             "outer probe min %u ns, %u measures in bin %u : nested time not removed", outer->min_cycles,
+             outer->histogram[TEST_Bin(2U * TEST_OUTER_NS)], TEST_Bin(2U * TEST_OUTER_NS));
+  TEST_CHECK((nested->min_cycles >= TEST_NESTED_NS) &&
+             (nested->histogram[TEST_Bin(TEST_NESTED_NS)] >= TEST_TYPICAL_RUNS),
+             "nested probe min %u ns, %u measures in bin %u", nested->min_cycles,
+             nested->histogram[TEST_Bin(TEST_NESTED_NS)], TEST_Bin(TEST_NESTED_NS));
+  TEST_CHECK((nested->nested_count == TEST_RUNS) && (nested->max_depth == 2), "nested probe : %u nested, depth %u",
+             nested->nested_count, nested->max_depth);
+  TEST_CHECK((outer->nested_count == 0) && (outer->max_depth == 1), "outer probe : %u nested, depth %u",
+             outer->nested_count, outer->max_depth);
+}
+
+/**
+  * @brief  TEST_Limits
+  *         Probes beyond the max depth are not measured and don't break the others, unbalanced exits are
+  *         ignored, reset clears the statistics.
+  * @param  None
+  * @retval None
+  */
+static void  TEST_Limits(void)
+{
+  const AUDIO_ProfilerStats_t* stats = AUDIO_ProfilerGetStats(AUDIO_PROFILER_USB_DATA_IN);
+  uint32_t i;
+
+  for(i = 0; i < AUDIO_PROFILER_MAX_DEPTH + 2U; i++)
+  {
+    AUDIO_PROFILER_ENTER(AUDIO_PROFILER_USB_DATA_IN);
+  }
+  for(i = 0; i < AUDIO_PROFILER_MAX_DEPTH + 2U; i++)
+  {
+    AUDIO_PROFILER_EXIT(AUDIO_PROFILER_USB_DATA_IN);
+  }
+  TEST_CHECK((stats->count == AUDIO_PROFILER_MAX_DEPTH) && (stats->max_depth == AUDIO_PROFILER_MAX_DEPTH),
+             "%u measures, depth %u beyond the max depth %u", stats->count, stats->max_depth,
+             AUDIO_PROFILER_MAX_DEPTH);
+
+  AUDIO_PROFILER_EXIT(AUDIO_PROFILER_USB_DATA_IN);
+  TEST_CHECK(stats->count == AUDIO_PROFILER_MAX_DEPTH, "unbalanced exit measured");
+  AUDIO_PROFILER_ENTER(AUDIO_PROFILER_USB_DATA_IN);
+  AUDIO_PROFILER_EXIT(AUDIO_PROFILER_USB_DATA_IN);
+  TEST_CHECK((stats->count == AUDIO_PROFILER_MAX_DEPTH + 1U) && (stats->nested_count == AUDIO_PROFILER_MAX_DEPTH - 1U),
+             "probe after an unbalanced exit : %u measures, %u nested", stats->count, stats->nested_count);
+}
+
+/**
+  * @brief  TEST_PrintReport
+  *         Prints the statistics of the probes which ran, as read from AUDIO_ProfilerGetStats on the target.
+  * @param  None
+  * @retval None
+  */
+static void  TEST_PrintReport(void)
+{
+  const AUDIO_ProfilerStats_t* stats;
+  uint32_t probe, i;
+
+  printf("profiler report, times in ns\n");
+  for(probe = 0; probe < AUDIO_PROFILER_PROBE_COUNT; probe++)
+  {
+    stats = AUDIO_ProfilerGetStats((AUDIO_ProfilerProbe_t)probe);
+    if(stats->count == 0)
+    {
+      continue;
+    }
+    printf("  %-18s count %5u min %7u mean %7u max %7u nested %5u depth %u histogram", ProbeNames[probe],
+           stats->count, stats->min_cycles, AUDIO_ProfilerGetMeanCycles((AUDIO_ProfilerProbe_t)probe),
+           stats->max_cycles, stats->nested_count, stats->max_depth);
+    for(i = 0; i < AUDIO_PROFILER_HISTOGRAM_BINS; i++)
+    {
+      printf(" %u", stats->histogram[i]);
+    }
+    printf("\n");
+  }
+}
+
+/* Exported functions --------------------------------------------------------*/
+/**
+  * @brief  main
+  *         Runs the checks then prints the report.
+  * @param  None
+  * @retval exit status
+  */
+int  main(void)
+{
+  const AUDIO_ProfilerStats_t* stats;
+  uint32_t probe;
+
+  TEST_CHECK(AUDIO_ProfilerInit() == 0, "profiler clock not started");
+  TEST_Timed();
+  TEST_Nested();
+  TEST_Limits();
+  TEST_PrintReport();
+
+  AUDIO_ProfilerReset();
+  for(probe = 0; probe < AUDIO_PROFILER_PROBE_COUNT; probe++)
+  {
+    stats = AUDIO_ProfilerGetStats((AUDIO_ProfilerProbe_t)probe);
+    TEST_CHECK((stats->count == 0) && (stats->min_cycles == 0xFFFFFFFFU) && (TEST_HistogramCount(stats) == 0),
+               "probe %u not cleared by reset", probe);
+  }
+  return TEST_Report("audio_profiler_test");
+}
+
+/************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
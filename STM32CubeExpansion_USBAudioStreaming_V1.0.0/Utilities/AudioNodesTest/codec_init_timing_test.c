@@ -0,0 +1,144 @@
+/**
+  ******************************************************************************
+  * @file    codec_init_timing_test.c
+  * @author  MCD Application Team
+  * @brief   host timing model of the WM8994 bring-up of the F769 speaker : the
+  *          driver (wm8994_ex.c) runs over the mocked audio I2C link
+  *          (codec_test_i2c.c) which adds the time of each transfer on the bus
+  *          of the board and the delays of the analog start-up. The codec
+  *          calls of BSP_AUDIO_OUT_Init_Ext are replayed with the codec
+  *          initialized on SET_CONFIGURATION (USE_AUDIO_SPEAKER_EARLY_CODEC_INIT
+  *          set to 0) and with the codec powered up before the USB attach by
+  *          AUDIO_SpeakerCodecPowerUp, the enumeration to ready times are
+  *          printed and checked. See readme.txt.
+  *          @build codec_test_i2c.c
+  *          @build ../../Projects/STM32F769I-Discovery/Applications/USB_Device/Extension/Drivers/BSP/Components/wm8994/wm8994_ex.c
+  *          @build -I../../Projects/STM32F769I-Discovery/Applications/USB_Device/Extension/Drivers/BSP/Components/wm8994
+  *          @build -I../../Drivers/BSP/Components/common
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2019  STMicroelectronics.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by ST under Ultimate Liberty license
+  * SLA0044, the "License"; You may not use this file except in compliance with
+  * the License. You may obtain a copy of the License at:
+  *                             www.st.com/SLA0044
+  *
+  ******************************************************************************
+  */
+/* Includes ------------------------------------------------------------------*/
+#include <string.h>
+#include "audio_nodes_test.h"
+#include "wm8994_ex.h"
+#include "codec_test_i2c.h"
+
+/* Private defines -----------------------------------------------------------*/
+#define TEST_CODEC_ADDRESS              0x34U   /* AUDIO_I2C_ADDRESS of stm32f769i_discovery.h */
+#define TEST_FREQUENCY                  48000U  /* default playback frequency of the shipped configuration */
+#define TEST_RES_BIT                    16U
+#define TEST_VOLUME                     80U     /* VOLUME_SPEAKER_DEFAULT_DB_256 in percent, see audio_speaker_node.c */
+#define TEST_SET_CONFIGURATION_MAX_MS   50.0    /* USB 2.0 9.2.6.4 : standard request without data stage */
+#define TEST_ANALOG_START_UP_MIN_MS     300.0   /* VMID, charge pump and DC servo delays of wm8994_Init */
+
+/* Private variables ---------------------------------------------------------*/
+static uint16_t LateRegisters[CODEC_TEST_REG_COUNT];
+
+/* Private functions ---------------------------------------------------------*/
+/**
+  * @brief  TEST_CodecStartUp
+  *         Codec calls of BSP_AUDIO_OUT_Init_Ext when the codec registers were not initialized : identifier
+  *         read, software reset, registers initialization with the analog start-up.
+  * @param  None
+  * @retval None
+  */
+static void  TEST_CodecStartUp(void)
+{
+  wm8994_drv.ReadID(TEST_CODEC_ADDRESS);
+  wm8994_drv.Reset(TEST_CODEC_ADDRESS);
+  TEST_CHECK(wm8994_drv.Init(TEST_CODEC_ADDRESS, OUTPUT_DEVICE_AUTO, TEST_VOLUME, TEST_FREQUENCY,
+                             TEST_RES_BIT) == 0, "codec initialization failed");
+}
+
+/**
+  * @brief  TEST_Print
+  *         Prints the time spent in the codec driver since the last reset of the mocked link.
+  * @param  name(IN): step
+  * @retval time in ms
+  */
+static double  TEST_Print(const char* name)
+{
+  double time_ms = CODEC_TestI2CTimeUs() / 1000.0;
+
+  printf("bench codec %s : %.1f ms, %u I2C writes and %u reads taking %.1f ms, %u ms of delays\n", name, time_ms,
+         CODEC_TestI2C.writes, CODEC_TestI2C.reads, CODEC_TestI2C.bus_us / 1000.0, CODEC_TestI2C.delay_ms);
+  return time_ms;
+}
+
+/**
+  * @brief  TEST_LateInit
+  *         Codec initialized by the speaker init, inside SET_CONFIGURATION.
+  * @param  None
+  * @retval None
+  */
+static void  TEST_LateInit(void)
+{
+  double enumeration_ms;
+
+  CODEC_TestI2CReset();
+  memset(CODEC_TestI2C.reg, 0, sizeof(CODEC_TestI2C.reg));
+  TEST_CodecStartUp();
+  enumeration_ms = TEST_Print("initialized on SET_CONFIGURATION, enumeration to ready");
+  memcpy(LateRegisters, CODEC_TestI2C.reg, sizeof(LateRegisters));
+  TEST_CHECK(enumeration_ms >= TEST_ANALOG_START_UP_MIN_MS, "analog start-up of %.1f ms not modelled",
+             enumeration_ms);
+}
+
+/**
+  * @brief  TEST_EarlyInit
+  *         Codec powered up and muted before the USB attach, then only its frequency and volume set inside
+  *         SET_CONFIGURATION, as BSP_AUDIO_OUT_Init_Ext does when the output device and resolution match. Once
+  *         unmuted by the speaker start, the codec registers are those of the late initialization.
+  * @param  None
+  * @retval None
+  */
+static void  TEST_EarlyInit(void)
+{
+  double enumeration_ms;
+
+  CODEC_TestI2CReset();
+  memset(CODEC_TestI2C.reg, 0, sizeof(CODEC_TestI2C.reg));
+  TEST_CodecStartUp();
+  TEST_CHECK(wm8994_drv.SetMute(TEST_CODEC_ADDRESS, AUDIO_MUTE_ON) == 0, "codec not muted");
+  TEST_Print("powered up before the USB attach");
+
+  CODEC_TestI2CReset();
+  TEST_CHECK((wm8994_drv.SetFrequency(TEST_CODEC_ADDRESS, TEST_FREQUENCY) == 0) &&
+             (wm8994_drv.SetVolume(TEST_CODEC_ADDRESS, TEST_VOLUME) == 0), "codec not set");
+  enumeration_ms = TEST_Print("powered up before the USB attach, enumeration to ready");
+  TEST_CHECK(enumeration_ms <= TEST_SET_CONFIGURATION_MAX_MS, "%.1f ms in SET_CONFIGURATION", enumeration_ms);
+  TEST_CHECK(CODEC_TestI2C.delay_ms == 0, "%u ms of delays in SET_CONFIGURATION", CODEC_TestI2C.delay_ms);
+
+  wm8994_drv.SetMute(TEST_CODEC_ADDRESS, AUDIO_MUTE_OFF);
+  TEST_CHECK(memcmp(CODEC_TestI2C.reg, LateRegisters, sizeof(LateRegisters)) == 0,
+             "codec registers differ from the initialization on SET_CONFIGURATION");
+}
+
+/* Exported functions --------------------------------------------------------*/
+/**
+  * @brief  main
+  *         Prints the bit time of the bus then runs both bring-ups.
+  * @param  None
+  * @retval exit status
+  */
+int  main(void)
+{
+  printf("bench codec I2C : %.2f us by bit, %.0f us by register write\n", CODEC_TestI2CBitUs(),
+         CODEC_TEST_WRITE_BITS * CODEC_TestI2CBitUs());
+  TEST_LateInit();
+  TEST_EarlyInit();
+  return TEST_Report("codec_init_timing_test");
+}
+
+/************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
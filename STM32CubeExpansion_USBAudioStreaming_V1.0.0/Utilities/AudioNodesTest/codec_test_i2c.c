@@ -0,0 +1,117 @@
+/**
+  ******************************************************************************
+  * @file    codec_test_i2c.c
+  * @author  MCD Application Team
+  * @brief   mocked audio I2C link of the board for the host tests of the WM8994
+  *          driver (wm8994_ex.c) : AUDIO_IO_Write and AUDIO_IO_Read update a
+  *          register file of the codec, count the transfers and add their time
+  *          on the bus, computed from the I2C timing of the board, AUDIO_IO_Delay
+  *          adds the time waited by HAL_Delay. The test can make the next write
+  *          transfers fail as a NACK of the codec does.
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2019  STMicroelectronics.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by ST under Ultimate Liberty license
+  * SLA0044, the "License"; You may not use this file except in compliance with
+  * the License. You may obtain a copy of the License at:
+  *                             www.st.com/SLA0044
+  *
+  ******************************************************************************
+  */
+/* Includes ------------------------------------------------------------------*/
+#include <string.h>
+#include "wm8994_ex.h"
+#include "codec_test_i2c.h"
+
+/* Exported variables --------------------------------------------------------*/
+CODEC_TestI2C_t CODEC_TestI2C;
+
+/* Exported functions --------------------------------------------------------*/
+/**
+  * @brief  CODEC_TestI2CReset
+  *         Clears the counts and the times, the codec registers are kept.
+  * @param  None
+  * @retval None
+  */
+void  CODEC_TestI2CReset(void)
+{
+  memset(CODEC_TestI2C.reg_writes, 0, sizeof(CODEC_TestI2C.reg_writes));
+  CODEC_TestI2C.writes = 0;
+  CODEC_TestI2C.reads = 0;
+  CODEC_TestI2C.failed = 0;
+  CODEC_TestI2C.fail_writes = 0;
+  CODEC_TestI2C.delay_ms = 0;
+  CODEC_TestI2C.bus_us = 0;
+}
+
+/**
+  * @brief  CODEC_TestI2CBitUs
+  *         Time of a bit on the bus : SCL high and low periods of the timing register (stm32f7xx_hal_i2c.h),
+  *         counted in periods of the prescaled I2C clock.
+  * @param  None
+  * @retval bit time in us
+  */
+double  CODEC_TestI2CBitUs(void)
+{
+  uint32_t presc = (CODEC_TEST_I2C_TIMING >> 28) & 0x0FU;
+  uint32_t sclh = (CODEC_TEST_I2C_TIMING >> 8) & 0xFFU;
+  uint32_t scll = CODEC_TEST_I2C_TIMING & 0xFFU;
+
+  return (sclh + 1U + scll + 1U) * (presc + 1U) * 1e6 / CODEC_TEST_I2C_CLOCK_HZ;
+}
+
+/**
+  * @brief  CODEC_TestI2CTimeUs
+  *         Time spent in the codec driver since the last reset : transfers and delays.
+  * @param  None
+  * @retval time in us
+  */
+double  CODEC_TestI2CTimeUs(void)
+{
+  return CODEC_TestI2C.bus_us + CODEC_TestI2C.delay_ms * 1000.0;
+}
+
+/* audio link of the board, see stm32f769i_discovery.c */
+void  AUDIO_IO_Init(void)
+{
+}
+
+void  AUDIO_IO_DeInit(void)
+{
+}
+
+uint8_t  AUDIO_IO_Write(uint8_t Addr, uint16_t Reg, uint16_t Value)
+{
+  (void)Addr;
+  CODEC_TestI2C.writes++;
+  CODEC_TestI2C.bus_us += CODEC_TEST_WRITE_BITS * CODEC_TestI2CBitUs();
+  if(CODEC_TestI2C.fail_writes != 0)
+  {
+    /* not acknowledged, the register keeps its value */
+    CODEC_TestI2C.fail_writes--;
+    CODEC_TestI2C.failed++;
+    return 1;
+  }
+  CODEC_TestI2C.reg_writes[Reg % CODEC_TEST_REG_COUNT]++;
+  CODEC_TestI2C.reg[Reg % CODEC_TEST_REG_COUNT] = Value;
+  return 0;
+}
+
+uint16_t  AUDIO_IO_Read(uint8_t Addr, uint16_t Reg)
+{
+  (void)Addr;
+  CODEC_TestI2C.reads++;
+  CODEC_TestI2C.bus_us += CODEC_TEST_READ_BITS * CODEC_TestI2CBitUs();
+  return CODEC_TestI2C.reg[Reg % CODEC_TEST_REG_COUNT];
+}
+
+void  AUDIO_IO_Delay(uint32_t Delay)
+{
+  /* HAL_Delay waits one more tick to guarantee the minimum wait */
+  CODEC_TestI2C.delay_ms += Delay + 1U;
+}
+
+/************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
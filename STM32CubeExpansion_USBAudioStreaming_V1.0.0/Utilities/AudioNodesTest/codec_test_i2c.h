@@ -0,0 +1,69 @@
+/**
+  ******************************************************************************
+  * @file    codec_test_i2c.h
+  * @author  MCD Application Team
+  * @brief   header of codec_test_i2c.c
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2019  STMicroelectronics.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by ST under Ultimate Liberty license
+  * SLA0044, the "License"; You may not use this file except in compliance with
+  * the License. You may obtain a copy of the License at:
+  *                             www.st.com/SLA0044
+  *
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __CODEC_TEST_I2C_H
+#define __CODEC_TEST_I2C_H
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdint.h>
+
+/* Exported constants --------------------------------------------------------*/
+#define CODEC_TEST_REG_COUNT            0x1000U /* 12 bits register addresses of the WM8994 */
+/* I2C of the audio codec, see stm32f769i_discovery.h : DISCOVERY_I2Cx_TIMING from a 50 MHz APB1 clock */
+#define CODEC_TEST_I2C_TIMING           ((uint32_t)0x40912732)
+#define CODEC_TEST_I2C_CLOCK_HZ         50000000U
+/* bits on the bus of HAL_I2C_Mem_Write and HAL_I2C_Mem_Read with 16 bits register addresses and values :
+   start, device address, 2 bytes of register address, 2 data bytes (each byte acknowledged), stop */
+#define CODEC_TEST_WRITE_BITS           (1U + 5U * 9U + 1U)
+#define CODEC_TEST_READ_BITS            (1U + 3U * 9U + 1U + 3U * 9U + 1U)
+
+/* Exported types ------------------------------------------------------------*/
+/* state of the mocked audio I2C link */
+typedef struct
+{
+  uint16_t reg[CODEC_TEST_REG_COUNT];    /* register values of the codec */
+  uint32_t reg_writes[CODEC_TEST_REG_COUNT]; /* transfers of each register */
+  uint32_t writes;                       /* write transfers */
+  uint32_t reads;                        /* read transfers */
+  uint32_t failed;                       /* failed write transfers */
+  uint32_t fail_writes;                  /* count of next write transfers to fail, set by the test */
+  uint32_t delay_ms;                     /* time waited by AUDIO_IO_Delay */
+  double   bus_us;                       /* time of the transfers on the bus */
+} CODEC_TestI2C_t;
+
+/* Exported variables --------------------------------------------------------*/
+extern CODEC_TestI2C_t CODEC_TestI2C;
+
+/* Exported functions ------------------------------------------------------- */
+void    CODEC_TestI2CReset(void);
+double  CODEC_TestI2CBitUs(void);
+double  CODEC_TestI2CTimeUs(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* __CODEC_TEST_I2C_H */
+
+/************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
@@ -0,0 +1,243 @@
+/**
+  ******************************************************************************
+  * @file    codec_volume_ramp_test.c
+  * @author  MCD Application Team
+  * @brief   host count of the I2C transfers of the WM8994 volume and mute
+  *          controls : the driver (wm8994_ex.c) runs over the mocked audio I2C
+  *          link (codec_test_i2c.c). Volume ramps of a dragged slider are
+  *          replayed as the speaker codec task applies them (volume then mute),
+  *          request by request and with the writes of a burst held and flushed
+  *          together. The transfers are counted against a model of the changed
+  *          registers and a driver without cache, then failed transfers are
+  *          injected to check the cache never skips a register the bus did
+  *          not write. See readme.txt.
+  *          @build codec_test_i2c.c
+  *          @build ../../Projects/STM32F769I-Discovery/Applications/USB_Device/Extension/Drivers/BSP/Components/wm8994/wm8994_ex.c
+  *          @build -I../../Projects/STM32F769I-Discovery/Applications/USB_Device/Extension/Drivers/BSP/Components/wm8994
+  *          @build -I../../Drivers/BSP/Components/common
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2019  STMicroelectronics.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by ST under Ultimate Liberty license
+  * SLA0044, the "License"; You may not use this file except in compliance with
+  * the License. You may obtain a copy of the License at:
+  *                             www.st.com/SLA0044
+  *
+  ******************************************************************************
+  */
+/* Includes ------------------------------------------------------------------*/
+#include <string.h>
+#include "audio_nodes_test.h"
+#include "wm8994_ex.h"
+#include "codec_test_i2c.h"
+
+/* Private defines -----------------------------------------------------------*/
+#define TEST_CODEC_ADDRESS              0x34U   /* AUDIO_I2C_ADDRESS of stm32f769i_discovery.h */
+#define TEST_FREQUENCY                  48000U
+#define TEST_RES_BIT                    16U
+#define TEST_VOLUME                     80U     /* VOLUME_SPEAKER_DEFAULT_DB_256 in percent */
+#define TEST_UNCACHED_WRITES            8U      /* writes of SetVolume then SetMute without cache */
+#define TEST_BURST                      4U      /* requests merged by a codec task run */
+#define TEST_LEFT_HP_VOLUME             0x1CU
+#define TEST_DAC1_MUTE                  0x420U
+
+/* Private types -------------------------------------------------------------*/
+/* codec state of the transfer count model */
+typedef struct
+{
+  uint8_t volume;   /* converted volume of the volume registers */
+  uint8_t muted;    /* soft mute of the DAC paths */
+  uint32_t writes;  /* writes of the changed registers */
+} TEST_Model_t;
+
+/* Private variables ---------------------------------------------------------*/
+static TEST_Model_t TEST_model;
+
+/* Private functions ---------------------------------------------------------*/
+/**
+  * @brief  TEST_ModelApply
+  *         Counts the writes of the registers changed by a volume request : 4 volume registers, 2 mute
+  *         registers, the volume registers being left unchanged by a zero volume.
+  * @param  volume(IN): volume in percent
+  * @param  mute(IN): mute of the feature unit
+  * @retval None
+  */
+static void  TEST_ModelApply(uint8_t volume, uint8_t mute)
+{
+  uint8_t converted = VOLUME_CONVERT(volume);
+  uint8_t muted = (mute != 0) || (volume == 0);
+
+  if(converted > 0x3E)
+  {
+    converted = 0x3F;
+  }
+  if((volume != 0) && (converted != TEST_model.volume))
+  {
+    TEST_model.volume = converted;
+    TEST_model.writes += 4U;
+  }
+  if(muted != TEST_model.muted)
+  {
+    TEST_model.muted = muted;
+    TEST_model.writes += 2U;
+  }
+}
+
+/**
+  * @brief  TEST_TaskRun
+  *         Codec calls of AUDIO_SpeakerCodecTaskRun for a volume request.
+  * @param  volume(IN): volume in percent
+  * @param  mute(IN): mute of the feature unit
+  * @retval 0 if correct communication
+  */
+static uint32_t  TEST_TaskRun(uint8_t volume, uint8_t mute)
+{
+  uint32_t counter = 0;
+
+  counter += wm8994_drv.SetVolume(TEST_CODEC_ADDRESS, volume);
+  counter += wm8994_drv.SetMute(TEST_CODEC_ADDRESS, ((mute != 0) || (volume == 0)) ? AUDIO_MUTE_ON : AUDIO_MUTE_OFF);
+  return counter;
+}
+
+/**
+  * @brief  TEST_Start
+  *         Powers the codec up at the default volume and clears the counts.
+  * @param  None
+  * @retval None
+  */
+static void  TEST_Start(void)
+{
+  memset(CODEC_TestI2C.reg, 0, sizeof(CODEC_TestI2C.reg));
+  wm8994_drv.Reset(TEST_CODEC_ADDRESS);
+  TEST_CHECK(wm8994_drv.Init(TEST_CODEC_ADDRESS, OUTPUT_DEVICE_AUTO, TEST_VOLUME, TEST_FREQUENCY,
+                             TEST_RES_BIT) == 0, "codec initialization failed");
+  TEST_model.volume = VOLUME_CONVERT(TEST_VOLUME);
+  TEST_model.muted = 0;
+  TEST_model.writes = 0;
+  CODEC_TestI2CReset();
+}
+
+/**
+  * @brief  TEST_Ramp
+  *         Replays a ramp of volume requests from a volume to another, one task run by request or one task
+  *         run by burst of TEST_BURST requests with the writes held, and counts the transfers.
+  * @param  name(IN): trace
+  * @param  from(IN): first volume in percent
+  * @param  to(IN): last volume in percent
+  * @param  burst(IN): requests by task run
+  * @retval None
+  */
+static void  TEST_Ramp(const char* name, int32_t from, int32_t to, uint32_t burst)
+{
+  int32_t step = (to >= from) ? 1 : -1;
+  int32_t volume;
+  uint32_t requests = 0, runs = 0;
+
+  TEST_Start();
+  for(volume = from; ; volume += step)
+  {
+    requests++;
+    if(((requests % burst) == 0) || (volume == to))
+    {
+      /* the task applies the latest volume of the burst */
+      runs++;
+      if(burst > 1)
+      {
+        wm8994_HoldWrites();
+      }
+      TEST_CHECK(TEST_TaskRun((uint8_t)volume, 0) == 0, "%s : volume %d not set", name, volume);
+      if(burst > 1)
+      {
+        TEST_CHECK(wm8994_FlushWrites(TEST_CODEC_ADDRESS) == 0, "%s : volume %d not flushed", name, volume);
+      }
+      TEST_ModelApply((uint8_t)volume, 0);
+    }
+    if(volume == to)
+    {
+      break;
+    }
+  }
+  printf("bench codec ramp %s : %u requests, %u task runs, %u I2C writes (%u without cache) taking %.1f ms, "
+         "%u reads\n", name, requests, runs, CODEC_TestI2C.writes, requests * TEST_UNCACHED_WRITES,
+         CODEC_TestI2C.bus_us / 1000.0, CODEC_TestI2C.reads);
+  TEST_CHECK(CODEC_TestI2C.writes == TEST_model.writes, "%s : %u I2C writes, %u registers changed", name,
+             CODEC_TestI2C.writes, TEST_model.writes);
+  TEST_CHECK(CODEC_TestI2C.reads == 0, "%s : %u I2C reads", name, CODEC_TestI2C.reads);
+  TEST_CHECK(CODEC_TestI2C.reg[TEST_LEFT_HP_VOLUME] == (TEST_model.volume | 0x140U), "%s : volume register %x",
+             name, CODEC_TestI2C.reg[TEST_LEFT_HP_VOLUME]);
+}
+
+/**
+  * @brief  TEST_MutedVolume
+  *         Volume requests of a muted feature unit : the volume set unmutes the codec and the task mutes it
+  *         again, with the writes held the mute registers are not written and no unmuted sample is played.
+  * @param  None
+  * @retval None
+  */
+static void  TEST_MutedVolume(void)
+{
+  TEST_Start();
+  TEST_CHECK(TEST_TaskRun(TEST_VOLUME, 1) == 0, "codec not muted");
+  CODEC_TestI2CReset();
+  wm8994_HoldWrites();
+  TEST_CHECK(TEST_TaskRun(TEST_VOLUME - 20U, 1) == 0, "volume not set");
+  TEST_CHECK(wm8994_FlushWrites(TEST_CODEC_ADDRESS) == 0, "volume not flushed");
+  printf("bench codec volume of a muted speaker : %u I2C writes\n", CODEC_TestI2C.writes);
+  TEST_CHECK(CODEC_TestI2C.reg_writes[TEST_DAC1_MUTE] == 0, "mute register written %u times",
+             CODEC_TestI2C.reg_writes[TEST_DAC1_MUTE]);
+  TEST_CHECK(CODEC_TestI2C.reg[TEST_DAC1_MUTE] == 0x0200U, "codec unmuted");
+  TEST_CHECK(CODEC_TestI2C.writes == 4U, "%u I2C writes for the volume registers", CODEC_TestI2C.writes);
+}
+
+/**
+  * @brief  TEST_BusError
+  *         Failed transfers, immediate and held : the error is reported and the same request written again
+  *         reaches the codec.
+  * @param  None
+  * @retval None
+  */
+static void  TEST_BusError(void)
+{
+  uint16_t volume = VOLUME_CONVERT(TEST_VOLUME - 30U) | 0x140U;
+
+  TEST_Start();
+  CODEC_TestI2C.fail_writes = 1;
+  TEST_CHECK(TEST_TaskRun(TEST_VOLUME - 30U, 0) != 0, "bus error not reported");
+  TEST_CHECK(CODEC_TestI2C.reg[TEST_LEFT_HP_VOLUME] != volume, "failed write stored");
+  TEST_CHECK(TEST_TaskRun(TEST_VOLUME - 30U, 0) == 0, "volume not set again");
+  TEST_CHECK(CODEC_TestI2C.reg[TEST_LEFT_HP_VOLUME] == volume, "volume register %x after a bus error",
+             CODEC_TestI2C.reg[TEST_LEFT_HP_VOLUME]);
+
+  volume = VOLUME_CONVERT(TEST_VOLUME - 50U) | 0x140U;
+  wm8994_HoldWrites();
+  TEST_CHECK(TEST_TaskRun(TEST_VOLUME - 50U, 0) == 0, "held volume not set");
+  CODEC_TestI2C.fail_writes = 1;
+  TEST_CHECK(wm8994_FlushWrites(TEST_CODEC_ADDRESS) != 0, "bus error of the flush not reported");
+  TEST_CHECK(CODEC_TestI2C.reg[TEST_LEFT_HP_VOLUME] != volume, "failed held write stored");
+  TEST_CHECK(TEST_TaskRun(TEST_VOLUME - 50U, 0) == 0, "held volume not set again");
+  TEST_CHECK(CODEC_TestI2C.reg[TEST_LEFT_HP_VOLUME] == volume, "volume register %x after a flush error",
+             CODEC_TestI2C.reg[TEST_LEFT_HP_VOLUME]);
+}
+
+/* Exported functions --------------------------------------------------------*/
+/**
+  * @brief  main
+  *         Runs the ramps, the muted volume and the bus error traces.
+  * @param  None
+  * @retval exit status
+  */
+int  main(void)
+{
+  TEST_Ramp("80 to 20 % by request", 80, 20, 1);
+  TEST_Ramp("80 to 20 % by burst", 80, 20, TEST_BURST);
+  TEST_Ramp("20 to 0 % by request", 20, 0, 1);
+  TEST_Ramp("0 to 100 % by burst", 0, 100, TEST_BURST);
+  TEST_MutedVolume();
+  TEST_BusError();
+  return TEST_Report("codec_volume_ramp_test");
+}
+
+/************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
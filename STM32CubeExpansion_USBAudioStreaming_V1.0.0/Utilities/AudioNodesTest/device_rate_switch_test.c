@@ -0,0 +1,396 @@
+/**
+  ******************************************************************************
+  * @file    device_rate_switch_test.c
+  * @author  MCD Application Team
+  * @brief   host test of the staged frequency switch of the F769 speaker and
+  *          microphone nodes, built with the shipped configuration of the
+  *          board over the mocked BSP (device_test_bsp.c) : the DMA callbacks
+  *          only stop the streams, the switch tasks reconfigure the codec and
+  *          the DFSDM with the codec muted, the microphones are switched
+  *          without being deinitialized, pending switches are cancelled by the
+  *          deinitialization. The time spent in the DMA interrupts and in the
+  *          switch tasks is printed. See readme.txt.
+  *          @build ../../Projects/Common/Streaming/Src/audio_scheduler.c
+  *          @build device_test_bsp.c
+  *          @build ../../Projects/STM32F769I-Discovery/Applications/USB_Device/AUD_Streaming10/Src/audio_speaker_node.c
+  *          @build ../../Projects/STM32F769I-Discovery/Applications/USB_Device/AUD_Streaming10/Src/audio_mic_node.c
+  *          @build -DUSE_USB_FS -DUSE_USB_FS_INTO_HS -DUSE_USB_AUDIO_PLAYBACK=1 -DUSE_USB_AUDIO_RECORDING=1
+  *          @build -DUSE_AUDIO_DFSDM_MEMS_MIC=1
+  *          @build -include ../../Projects/STM32F769I-Discovery/Applications/USB_Device/AUD_Streaming10/Inc/usb_audio_user_cfg.h
+  *          @build -I../../Projects/STM32F769I-Discovery/Applications/USB_Device/AUD_Streaming10/Inc
+  *          @build -I../../Projects/Common/Middlewares/ST/STM32_USB_Device_Library/Core/Inc
+  *          @build -I../../Middlewares/ST/STM32_USB_Device_Library/Core/Inc
+  *          @build -I../../Projects/Common/Middlewares/ST/STM32_USB_Device_Library/Class/AUDIO_10/Inc
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2019  STMicroelectronics.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by ST under Ultimate Liberty license
+  * SLA0044, the "License"; You may not use this file except in compliance with
+  * the License. You may obtain a copy of the License at:
+  *                             www.st.com/SLA0044
+  *
+  ******************************************************************************
+  */
+/* Includes ------------------------------------------------------------------*/
+#include "audio_nodes_test.h"
+#include "usbd_audio.h"
+#include "usb_audio.h"
+#include "audio_scheduler.h"
+#include "audio_speaker_node.h"
+#include "audio_mic_node.h"
+#include "audio_cycle_counter.h"
+
+#if !USE_AUDIO_DEFERRED_PROCESSING || USE_AUDIO_SPEAKER_CIRCULAR_DMA || USE_AUDIO_TIMER_VOLUME_CTRL
+#error "the test follows the shipped configuration : deferred processing, DMA rearmed by block, volume task"
+#endif /* !USE_AUDIO_DEFERRED_PROCESSING || USE_AUDIO_SPEAKER_CIRCULAR_DMA || USE_AUDIO_TIMER_VOLUME_CTRL */
+
+/* Private defines -----------------------------------------------------------*/
+#define TEST_BLOCKS                     8U      /* blocks streamed around a switch */
+#define TEST_SWITCH_RUNS                100U    /* switches timed, the fastest is kept */
+#define TEST_PLAY_RING_SIZE             (1024U * 4U)
+#define TEST_RECORD_RING_SIZE           (2U * 2112U) /* whole blocks of 44.1 and 48 KHz */
+
+/* Private variables ---------------------------------------------------------*/
+static AUDIO_Session_t Session;
+static AUDIO_Description_t SpeakerDesc;
+static AUDIO_Description_t MicDesc;
+static AUDIO_SpeakerNode_t Speaker;
+static AUDIO_MicNode_t Mic;
+static AUDIO_CircularBuffer_t PlayRing;
+static AUDIO_CircularBuffer_t RecordRing;
+static uint8_t PlayRingData[TEST_PLAY_RING_SIZE];
+static uint8_t RecordRingData[TEST_RECORD_RING_SIZE];
+static uint32_t Errors;
+
+/* Private functions ---------------------------------------------------------*/
+/**
+  * @brief  Error_Handler
+  *         Counts the errors reported by the nodes.
+  * @param  None
+  * @retval None
+  */
+void  Error_Handler(void)
+{
+  Errors++;
+}
+
+/**
+  * @brief  TEST_Describe
+  *         Sets the stream of an audio description, stereo 16 bits with the shipped block period.
+  * @param  desc(OUT):     audio description
+  * @param  frequency(IN): sampling frequency
+  * @param  block_us(IN):  block period
+  * @retval None
+  */
+static void  TEST_Describe(AUDIO_Description_t* desc, uint32_t frequency, uint16_t block_us)
+{
+  desc->frequency = frequency;
+  desc->channels_count = 2;
+  desc->resolution = 2;
+  desc->block_us = block_us;
+  desc->audio_mute = 0;
+  desc->audio_volume_db_256 = VOLUME_SPEAKER_DEFAULT_DB_256;
+}
+
+/**
+  * @brief  TEST_PlayBlocks
+  *         Plays blocks as the SAI DMA, the ring of the session is kept half full.
+  * @param  count(IN): count of blocks
+  * @retval None
+  */
+static void  TEST_PlayBlocks(uint32_t count)
+{
+  uint32_t i;
+
+  for(i = 0; i < count; i++)
+  {
+    PlayRing.wr_ptr = (PlayRing.rd_ptr + (TEST_PLAY_RING_SIZE >> 1)) % TEST_PLAY_RING_SIZE;
+    DEVICE_TestOutTransferComplete();
+    DEVICE_TestPendSV();
+  }
+}
+
+/**
+  * @brief  TEST_RecordBlocks
+  *         Captures blocks as the DFSDM DMA, the session sends them to the host.
+  * @param  count(IN): count of blocks
+  * @retval None
+  */
+static void  TEST_RecordBlocks(uint32_t count)
+{
+  uint32_t i;
+
+  for(i = 0; i < count; i++)
+  {
+    if(i & 1U)
+    {
+      DEVICE_TestInTransferComplete();
+    }
+    else
+    {
+      DEVICE_TestInHalfTransfer();
+    }
+    DEVICE_TestPendSV();
+    RecordRing.rd_ptr = RecordRing.wr_ptr;
+  }
+}
+
+/**
+  * @brief  TEST_SpeakerSwitch
+  *         Switches the speaker frequency as the playback session : the node is told, the ring is reset, and
+  *         the node is started again once the ring is filled.
+  * @param  frequency(IN): new frequency
+  * @param  isr_ns(OUT):   time of the DMA interrupt which stops the injection
+  * @param  task_ns(OUT):  time of the switch task
+  * @retval None
+  */
+static void  TEST_SpeakerSwitch(uint32_t frequency, uint32_t* isr_ns, uint32_t* task_ns)
+{
+  uint32_t start;
+
+  SpeakerDesc.frequency = frequency;
+  Speaker.SpeakerChangeFrequency((uint32_t)&Speaker);
+  PlayRing.rd_ptr = PlayRing.wr_ptr = 0;
+  start = AUDIO_CycleCounterGet();
+  DEVICE_TestOutTransferComplete();
+  *isr_ns = AUDIO_CycleCounterGet() - start;
+  start = AUDIO_CycleCounterGet();
+  DEVICE_TestPendSV();
+  *task_ns = AUDIO_CycleCounterGet() - start;
+  Speaker.SpeakerStart(&PlayRing, (uint32_t)&Speaker);
+  DEVICE_TestPendSV();
+}
+
+/**
+  * @brief  TEST_MicSwitch
+  *         Switches the microphones frequency as the recording session.
+  * @param  frequency(IN): new frequency
+  * @param  isr_ns(OUT):   time of the DMA interrupt which stops the capture
+  * @param  task_ns(OUT):  time of the switch task
+  * @retval None
+  */
+static void  TEST_MicSwitch(uint32_t frequency, uint32_t* isr_ns, uint32_t* task_ns)
+{
+  uint32_t start;
+
+  MicDesc.frequency = frequency;
+  TEST_CHECK(Mic.MicChangeFrequency((uint32_t)&Mic) == 0, "%u Hz refused by the microphones", frequency);
+  RecordRing.rd_ptr = RecordRing.wr_ptr = 0;
+  /* the half captured at the previous frequency is dropped */
+  DEVICE_TestInHalfTransfer();
+  DEVICE_TestPendSV();
+  start = AUDIO_CycleCounterGet();
+  DEVICE_TestInTransferComplete();
+  *isr_ns = AUDIO_CycleCounterGet() - start;
+  start = AUDIO_CycleCounterGet();
+  DEVICE_TestPendSV();
+  *task_ns = AUDIO_CycleCounterGet() - start;
+}
+
+/**
+  * @brief  TEST_SpeakerRateSwitch
+  *         48 KHz to 44.1 KHz and back : no codec nor SAI access in the DMA interrupt, the DMA isn't rearmed
+  *         at the old frequency, the codec is muted while its rate changes, the injection restarts at the new
+  *         frequency.
+  * @param  None
+  * @retval None
+  */
+static void  TEST_SpeakerRateSwitch(void)
+{
+  static const uint32_t frequencies[] = {USB_AUDIO_CONFIG_FREQ_44_1_K, USB_AUDIO_CONFIG_FREQ_48_K};
+  uint32_t i, isr_ns, task_ns, block_size;
+  int32_t mute, rate, restart, unmute;
+
+  for(i = 0; i < sizeof(frequencies) / sizeof(frequencies[0]); i++)
+  {
+    DEVICE_TestBSPReset();
+    SpeakerDesc.frequency = frequencies[i];
+    Speaker.SpeakerChangeFrequency((uint32_t)&Speaker);
+    PlayRing.rd_ptr = PlayRing.wr_ptr = 0;
+    DEVICE_TestOutTransferComplete();
+    TEST_CHECK(DEVICE_TestBSP.log_count == 0, "%u Hz : %u BSP calls in the DMA interrupt", frequencies[i],
+               DEVICE_TestBSP.log_count);
+    TEST_CHECK(!DEVICE_TestBSP.out_running, "%u Hz : DMA rearmed at the previous frequency", frequencies[i]);
+
+    DEVICE_TestPendSV();
+    mute = DEVICE_TestFindCall(DEVICE_TEST_OUT_SET_MUTE, 0);
+    rate = DEVICE_TestFindCall(DEVICE_TEST_OUT_SET_FREQUENCY, 0);
+    restart = DEVICE_TestFindCall(DEVICE_TEST_OUT_CHANGE_BUFFER, 0);
+    unmute = DEVICE_TestFindCall(DEVICE_TEST_OUT_SET_MUTE, (uint32_t)(mute + 1));
+    TEST_CHECK((DEVICE_TestBSP.count[DEVICE_TEST_OUT_SET_FREQUENCY] == 1) &&
+               (DEVICE_TestBSP.out_frequency == frequencies[i]), "%u Hz : %u frequency settings, codec at %u Hz",
+               frequencies[i], DEVICE_TestBSP.count[DEVICE_TEST_OUT_SET_FREQUENCY], DEVICE_TestBSP.out_frequency);
+    TEST_CHECK((mute >= 0) && (mute < rate) && (rate < restart) && (restart < unmute) &&
+               DEVICE_TestBSP.log[rate].muted && !DEVICE_TestBSP.out_muted,
+               "%u Hz : mute %d, frequency %d, DMA restart %d, unmute %d", frequencies[i], mute, rate, restart, unmute);
+    block_size = AUDIO_BLOCK_SIZE(frequencies[i], 2, 2, SpeakerDesc.block_us);
+    TEST_CHECK(DEVICE_TestBSP.out_running && (DEVICE_TestBSP.out_size == block_size),
+               "%u Hz : DMA restarted with %u bytes for %u", frequencies[i], DEVICE_TestBSP.out_size, block_size);
+    TEST_CHECK((DEVICE_TestBSP.count[DEVICE_TEST_OUT_INIT] == 0) && (DEVICE_TestBSP.count[DEVICE_TEST_OUT_STOP] == 0),
+               "%u Hz : codec stopped or initialized again", frequencies[i]);
+
+    Speaker.SpeakerStart(&PlayRing, (uint32_t)&Speaker);
+    TEST_PlayBlocks(TEST_BLOCKS);
+    TEST_CHECK(DEVICE_TestBSP.out_size >= block_size, "%u Hz : %u bytes injected by block after the switch",
+               frequencies[i], DEVICE_TestBSP.out_size);
+    TEST_CHECK(PlayRing.rd_ptr != 0, "%u Hz : no data read after the switch", frequencies[i]);
+  }
+
+  /* the transfer complete interrupt preempts the switch task : nothing is injected until the task ends */
+  DEVICE_TestBSPReset();
+  SpeakerDesc.frequency = USB_AUDIO_CONFIG_FREQ_44_1_K;
+  Speaker.SpeakerChangeFrequency((uint32_t)&Speaker);
+  DEVICE_TestOutTransferComplete();
+  DEVICE_TestBSP.out_running = 1;
+  DEVICE_TestOutTransferComplete();
+  TEST_CHECK(DEVICE_TestBSP.count[DEVICE_TEST_OUT_CHANGE_BUFFER] == 0, "injection rearmed while the switch is pending");
+  DEVICE_TestPendSV();
+  TEST_CHECK(DEVICE_TestBSP.count[DEVICE_TEST_OUT_CHANGE_BUFFER] == 1, "%u DMA restarts by the switch task",
+             DEVICE_TestBSP.count[DEVICE_TEST_OUT_CHANGE_BUFFER]);
+  Speaker.SpeakerStart(&PlayRing, (uint32_t)&Speaker);
+  TEST_PlayBlocks(TEST_BLOCKS);
+
+  TEST_SpeakerSwitch(USB_AUDIO_CONFIG_FREQ_48_K, &isr_ns, &task_ns);
+  TEST_CHECK(Errors == 0, "%u speaker errors", Errors);
+}
+
+/**
+  * @brief  TEST_MicRateSwitch
+  *         48 KHz to 44.1 KHz and back : the capture is stopped in the DMA interrupt, the DFSDM is set to the
+  *         new frequency by the switch task without deinitializing the microphones, blocks of the new size are
+  *         captured.
+  * @param  None
+  * @retval None
+  */
+static void  TEST_MicRateSwitch(void)
+{
+  static const uint32_t frequencies[] = {USB_AUDIO_CONFIG_FREQ_44_1_K, USB_AUDIO_CONFIG_FREQ_48_K};
+  uint32_t i, isr_ns, task_ns, block_size;
+
+  for(i = 0; i < sizeof(frequencies) / sizeof(frequencies[0]); i++)
+  {
+    DEVICE_TestBSPReset();
+    TEST_MicSwitch(frequencies[i], &isr_ns, &task_ns);
+    TEST_CHECK(DEVICE_TestBSP.count[DEVICE_TEST_IN_GET_PCM] == 0, "%u Hz : block of the previous frequency sent",
+               frequencies[i]);
+    TEST_CHECK((DEVICE_TestBSP.isr_count[DEVICE_TEST_IN_STOP] == 1) &&
+               (DEVICE_TestBSP.isr_count[DEVICE_TEST_IN_SET_FREQUENCY] == 0) &&
+               (DEVICE_TestBSP.isr_count[DEVICE_TEST_IN_RECORD] == 0),
+               "%u Hz : %u stops, %u frequency settings, %u records in the DMA interrupt", frequencies[i],
+               DEVICE_TestBSP.isr_count[DEVICE_TEST_IN_STOP], DEVICE_TestBSP.isr_count[DEVICE_TEST_IN_SET_FREQUENCY],
+               DEVICE_TestBSP.isr_count[DEVICE_TEST_IN_RECORD]);
+    TEST_CHECK((DEVICE_TestBSP.count[DEVICE_TEST_IN_SET_FREQUENCY] == 1) &&
+               (DEVICE_TestBSP.in_frequency == frequencies[i]) && (DEVICE_TestBSP.count[DEVICE_TEST_IN_RECORD] == 1) &&
+               DEVICE_TestBSP.in_recording, "%u Hz : %u frequency settings, DFSDM at %u Hz, %u records", frequencies[i],
+               DEVICE_TestBSP.count[DEVICE_TEST_IN_SET_FREQUENCY], DEVICE_TestBSP.in_frequency,
+               DEVICE_TestBSP.count[DEVICE_TEST_IN_RECORD]);
+    TEST_CHECK((DEVICE_TestBSP.count[DEVICE_TEST_IN_INIT] == 0) && (DEVICE_TestBSP.count[DEVICE_TEST_IN_DEINIT] == 0),
+               "%u Hz : microphones deinitialized and initialized again", frequencies[i]);
+    TEST_CHECK(DEVICE_TestBSP.in_scratch_size == AUDIO_BLOCK_SAMPLES_COUNT(frequencies[i], MicDesc.block_us) * 2U *
+               AUDIO_MIC_CAPTURE_CHANNEL_COUNT, "%u Hz : DMA buffer of %u samples", frequencies[i],
+               DEVICE_TestBSP.in_scratch_size);
+
+    block_size = AUDIO_BLOCK_SIZE(frequencies[i], 2, 2, MicDesc.block_us);
+    DEVICE_TestInHalfTransfer();
+    DEVICE_TestPendSV();
+    TEST_CHECK(RecordRing.wr_ptr == block_size, "%u Hz : block of %u bytes captured for %u", frequencies[i],
+               RecordRing.wr_ptr, block_size);
+    RecordRing.rd_ptr = RecordRing.wr_ptr;
+    TEST_RecordBlocks(TEST_BLOCKS);
+  }
+  TEST_CHECK(Errors == 0, "%u microphone errors", Errors);
+}
+
+/**
+  * @brief  TEST_SwitchBench
+  *         Prints the fastest time of the DMA interrupts stopping the streams and of the switch tasks. The
+  *         mocked BSP returns at once : the figures are the node overhead, the codec I2C writes and the DFSDM
+  *         settings of the target run in the tasks.
+  * @param  None
+  * @retval None
+  */
+static void  TEST_SwitchBench(void)
+{
+  uint32_t run, isr_ns, task_ns;
+  uint32_t best_isr[2] = {UINT32_MAX, UINT32_MAX}, best_task[2] = {UINT32_MAX, UINT32_MAX};
+
+  for(run = 0; run < TEST_SWITCH_RUNS; run++)
+  {
+    TEST_SpeakerSwitch((run & 1U)? USB_AUDIO_CONFIG_FREQ_48_K : USB_AUDIO_CONFIG_FREQ_44_1_K, &isr_ns, &task_ns);
+    best_isr[0] = (isr_ns < best_isr[0])? isr_ns : best_isr[0];
+    best_task[0] = (task_ns < best_task[0])? task_ns : best_task[0];
+    TEST_PlayBlocks(2);
+    TEST_MicSwitch((run & 1U)? USB_AUDIO_CONFIG_FREQ_48_K : USB_AUDIO_CONFIG_FREQ_44_1_K, &isr_ns, &task_ns);
+    best_isr[1] = (isr_ns < best_isr[1])? isr_ns : best_isr[1];
+    best_task[1] = (task_ns < best_task[1])? task_ns : best_task[1];
+    TEST_RecordBlocks(2);
+  }
+  printf("bench rate switch speaker : %u ns in the DMA interrupt, %u ns in the switch task\n", best_isr[0],
+         best_task[0]);
+  printf("bench rate switch microphones : %u ns in the DMA interrupt, %u ns in the switch task\n", best_isr[1],
+         best_task[1]);
+  TEST_CHECK(Errors == 0, "%u errors while switching", Errors);
+}
+
+/**
+  * @brief  TEST_CancelledSwitch
+  *         Nodes deinitialized while their switch task is pending : the task does nothing.
+  * @param  None
+  * @retval None
+  */
+static void  TEST_CancelledSwitch(void)
+{
+  SpeakerDesc.frequency = USB_AUDIO_CONFIG_FREQ_44_1_K;
+  Speaker.SpeakerChangeFrequency((uint32_t)&Speaker);
+  DEVICE_TestOutTransferComplete();
+  MicDesc.frequency = USB_AUDIO_CONFIG_FREQ_44_1_K;
+  Mic.MicChangeFrequency((uint32_t)&Mic);
+  DEVICE_TestInTransferComplete();
+  Speaker.SpeakerDeInit((uint32_t)&Speaker);
+  Mic.MicDeInit((uint32_t)&Mic);
+  DEVICE_TestBSPReset();
+  DEVICE_TestPendSV();
+  TEST_CHECK(DEVICE_TestBSP.log_count == 0, "%u BSP calls by the switch tasks of deinitialized nodes",
+             DEVICE_TestBSP.log_count);
+  TEST_CHECK(!DEVICE_TestBSP.out_running && !DEVICE_TestBSP.in_recording, "streams restarted after deinit");
+}
+
+/* Exported functions --------------------------------------------------------*/
+/**
+  * @brief  main
+  *         Starts both devices at 48 KHz as the sessions do, runs the checks then the benchmark.
+  * @param  None
+  * @retval exit status
+  */
+int  main(void)
+{
+  PlayRing.data = PlayRingData;
+  PlayRing.size = TEST_PLAY_RING_SIZE;
+  RecordRing.data = RecordRingData;
+  RecordRing.size = TEST_RECORD_RING_SIZE;
+  TEST_Describe(&SpeakerDesc, USB_AUDIO_CONFIG_FREQ_48_K, USB_AUDIO_CONFIG_PLAY_BLOCK_US);
+  TEST_Describe(&MicDesc, USB_AUDIO_CONFIG_FREQ_48_K, USB_AUDIO_CONFIG_RECORD_BLOCK_US);
+
+  TEST_CHECK(AUDIO_SchedulerInit() == 0, "scheduler not started");
+  DEVICE_TestBSPReset();
+  AUDIO_SpeakerInit(&SpeakerDesc, &Session, (uint32_t)&Speaker);
+  AUDIO_MicInit(&MicDesc, &Session, (uint32_t)&Mic);
+  Speaker.SpeakerStart(&PlayRing, (uint32_t)&Speaker);
+  Mic.MicStart(&RecordRing, (uint32_t)&Mic);
+  DEVICE_TestPendSV();
+  TEST_PlayBlocks(TEST_BLOCKS);
+  TEST_RecordBlocks(TEST_BLOCKS);
+  TEST_CHECK((DEVICE_TestBSP.out_frequency == USB_AUDIO_CONFIG_FREQ_48_K) && DEVICE_TestBSP.out_running &&
+             DEVICE_TestBSP.in_recording, "devices not streaming at 48 KHz");
+
+  TEST_SpeakerRateSwitch();
+  TEST_MicRateSwitch();
+  TEST_SwitchBench();
+  TEST_CancelledSwitch();
+  return TEST_Report("device_rate_switch_test");
+}
+
+/************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
@@ -0,0 +1,276 @@
+/**
+  ******************************************************************************
+  * @file    device_round_trip_test.c
+  * @author  MCD Application Team
+  * @brief   host measure of the microphone to speaker latency of the F769
+  *          project with the sidetone : the audio class, the sessions, their
+  *          graphs and the board nodes run over the mocked PCD (usbd_test_ll.c)
+  *          and the mocked BSP (device_test_bsp.c) on a simulated time line,
+  *          as device_stream_start_test. The microphones capture silence then
+  *          a constant level from a given time, the time the level is played
+  *          by the SAI is measured through the sidetone, the host playing
+  *          silence, then through the host, which loops the recorded packets
+  *          back to the playback stream with the sidetone muted.
+  *          See readme.txt.
+  *          @build ../../Projects/Common/Streaming/Src/audio_scheduler.c
+  *          @build ../../Projects/Common/Streaming/Src/audio_usb_nodes.c
+  *          @build ../../Projects/Common/Streaming/Src/audio_usb_playback_session.c
+  *          @build ../../Projects/Common/Streaming/Src/audio_usb_recording_session.c
+  *          @build ../../Projects/Common/Streaming/Src/audio_mixer_node.c
+  *          @build ../../Projects/Common/Streaming/Src/audio_sidetone.c
+  *          @build ../../Projects/Common/Streaming/Src/usbd_audio_if.c
+  *          @build ../../Projects/Common/Streaming/Src/usbd_audio_10_config_descriptors.c
+  *          @build ../../Projects/STM32F769I-Discovery/Applications/USB_Device/AUD_Streaming10/Src/audio_speaker_node.c
+  *          @build ../../Projects/STM32F769I-Discovery/Applications/USB_Device/AUD_Streaming10/Src/audio_mic_node.c
+  *          @build device_test_bsp.c usbd_test_ll.c
+  *          @build ../../Projects/Common/Middlewares/ST/STM32_USB_Device_Library/Core/Src/usbd_core_ex.c
+  *          @build ../../Middlewares/ST/STM32_USB_Device_Library/Core/Src/usbd_ctlreq.c
+  *          @build ../../Middlewares/ST/STM32_USB_Device_Library/Core/Src/usbd_ioreq.c
+  *          @build ../../Projects/Common/Middlewares/ST/STM32_USB_Device_Library/Class/AUDIO_10/Src/usbd_audio.c
+  *          @build -include device_sidetone_user_cfg.h
+  *          @build -I../../Projects/STM32F769I-Discovery/Applications/USB_Device/AUD_Streaming10/Inc
+  *          @build -I../../Projects/Common/Middlewares/ST/STM32_USB_Device_Library/Core/Inc
+  *          @build -I../../Middlewares/ST/STM32_USB_Device_Library/Core/Inc
+  *          @build -I../../Projects/Common/Middlewares/ST/STM32_USB_Device_Library/Class/AUDIO_10/Inc
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2019  STMicroelectronics.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by ST under Ultimate Liberty license
+  * SLA0044, the "License"; You may not use this file except in compliance with
+  * the License. You may obtain a copy of the License at:
+  *                             www.st.com/SLA0044
+  *
+  ******************************************************************************
+  */
+/* Includes ------------------------------------------------------------------*/
+#include <string.h>
+#include <math.h>
+#include "audio_nodes_test.h"
+#include "usbd_audio.h"
+#include "usbd_audio_if.h"
+#include "usbd_test_ll.h"
+#include "usb_audio.h"
+#include "audio_user_devices.h"
+
+#if !USE_AUDIO_SIDETONE || (USB_AUDIO_CONFIG_PLAY_RES_BYTE != USB_AUDIO_CONFIG_RECORD_RES_BYTE) || \
+    (USB_AUDIO_CONFIG_PLAY_CHANNEL_COUNT != USB_AUDIO_CONFIG_RECORD_CHANNEL_COUNT)
+#error "the host loops the recorded packets back to the playback stream as they are, next to the sidetone"
+#endif /* !USE_AUDIO_SIDETONE || ... */
+
+/* Private defines -----------------------------------------------------------*/
+#define TEST_FRAME_US                   1000U   /* full speed frame */
+#define TEST_FREQUENCY                  USB_AUDIO_CONFIG_FREQ_48_K
+#define TEST_SETTLE_FRAMES              500U    /* frames streamed before a measure and after it */
+#define TEST_MAX_FRAMES                 200U    /* frames waited for the level on the speaker */
+#define TEST_STEP_OFFSET_US             300.0   /* step of the microphones level inside the frame */
+#define TEST_SIDETONE_MAX_MS            5.0     /* microphone block, sidetone ring threshold and SAI block */
+#define TEST_AC_INTERFACE               0U      /* audio control interface of the configuration descriptor */
+#define TEST_PLAY_EP                    USBD_AUDIO_CONFIG_PLAY_EP_OUT
+#define TEST_SYNC_EP                    USB_AUDIO_CONFIG_PLAY_EP_SYNC
+#define TEST_RECORD_EP                  USB_AUDIO_CONFIG_RECORD_EP_IN
+#define TEST_PLAY_FRAME_SIZE            (USB_AUDIO_CONFIG_PLAY_CHANNEL_COUNT * USB_AUDIO_CONFIG_PLAY_RES_BYTE)
+#define TEST_HOST_FIFO_SIZE             4096U
+
+/* Private variables ---------------------------------------------------------*/
+static USBD_HandleTypeDef Device;
+static uint32_t Errors;
+/* host side */
+static uint32_t HostFeedback;           /* last feedback read, 10.14 samples by frame */
+static uint32_t HostAccumulator;        /* fraction of sample of the playback packets */
+static uint8_t  HostLoopback;           /* recorded packets played back, else silence played */
+static uint8_t  HostFifo[TEST_HOST_FIFO_SIZE]; /* recorded bytes not yet played back */
+static uint32_t HostFifoCount;
+
+/* Private functions ---------------------------------------------------------*/
+/**
+  * @brief  Error_Handler
+  *         Counts the errors reported by the nodes.
+  * @param  None
+  * @retval None
+  */
+void  Error_Handler(void)
+{
+  Errors++;
+}
+
+/**
+  * @brief  TEST_FeedbackHz
+  *         Decodes the feedback of a full speed sync endpoint, 10.14 samples by frame.
+  * @param  data(IN): feedback packet
+  * @retval rate in Hz
+  */
+static double  TEST_FeedbackHz(const uint8_t* data)
+{
+  uint32_t value = data[0] | ((uint32_t)data[1] << 8) | ((uint32_t)data[2] << 16);
+
+  return value * 1000.0 / 16384.0;
+}
+
+/**
+  * @brief  TEST_Frame
+  *         One ms : the devices run, the SOF is received, the host sends the playback packet sized from the
+  *         last feedback, silent or taken from the recorded bytes received before, reads the recording packet
+  *         then the feedback. PendSV runs after each interrupt.
+  * @param  None
+  * @retval None
+  */
+static void  TEST_Frame(void)
+{
+  static uint8_t packet[USBD_AUDIO_CONFIG_PLAY_MAX_PACKET_SIZE];
+  USBD_TestEp_t* ep;
+  uint32_t size;
+
+  DEVICE_TestRunDevices(TEST_FRAME_US);
+  USBD_TestSOF(&Device);
+  DEVICE_TestPendSV();
+
+  ep = &USBD_TestLL.out[TEST_PLAY_EP];
+  if(ep->open && (ep->buf != NULL))
+  {
+    HostAccumulator += HostFeedback;
+    size = (HostAccumulator >> 14) * TEST_PLAY_FRAME_SIZE;
+    HostAccumulator &= 0x3FFFU;
+    size = (size > sizeof(packet))? sizeof(packet) : size;
+    memset(packet, 0, size);
+    if(HostLoopback)
+    {
+      memcpy(packet, HostFifo, (HostFifoCount < size)? HostFifoCount : size);
+      HostFifoCount -= (HostFifoCount < size)? HostFifoCount : size;
+      memmove(HostFifo, HostFifo + size, HostFifoCount);
+    }
+    USBD_TestDataOutPacket(&Device, TEST_PLAY_EP, packet, (uint16_t)size);
+    DEVICE_TestPendSV();
+  }
+
+  ep = &USBD_TestLL.in[TEST_RECORD_EP & 0x0FU];
+  if(ep->open && (ep->buf != NULL))
+  {
+    if(HostFifoCount + ep->size <= sizeof(HostFifo))
+    {
+      memcpy(HostFifo + HostFifoCount, ep->buf, ep->size);
+      HostFifoCount += ep->size;
+    }
+    USBD_TestDataIn(&Device, TEST_RECORD_EP);
+    DEVICE_TestPendSV();
+  }
+
+  ep = &USBD_TestLL.in[TEST_SYNC_EP & 0x0FU];
+  if(ep->open && (ep->buf != NULL))
+  {
+    HostFeedback = (uint32_t)lround(TEST_FeedbackHz(ep->buf) * 16384.0 / 1000.0);
+    USBD_TestDataIn(&Device, TEST_SYNC_EP);
+  }
+}
+
+/**
+  * @brief  TEST_SetInterface
+  *         SET_INTERFACE request of the host.
+  * @param  interface(IN): audio streaming interface
+  * @param  alternate(IN): alternate setting
+  * @retval None
+  */
+static void  TEST_SetInterface(uint16_t interface, uint16_t alternate)
+{
+  USBD_TestSetup(&Device, 0x01, USB_REQ_SET_INTERFACE, alternate, interface, 0);
+  DEVICE_TestPendSV();
+}
+
+/**
+  * @brief  TEST_SetSidetoneMute
+  *         SET_CUR mute request of the host to the sidetone feature unit : setup, data and status stages.
+  * @param  mute(IN): mute of the monitor
+  * @retval None
+  */
+static void  TEST_SetSidetoneMute(uint8_t mute)
+{
+  USBD_TestSetup(&Device, 0x21, USBD_AUDIO_REQ_SET_CUR, USBD_AUDIO_FU_MUTE_CONTROL << 8,
+                 (USB_AUDIO_CONFIG_SIDETONE_UNIT_FEATURE_ID << 8) | TEST_AC_INTERFACE, 1);
+  USBD_TestDataOutPacket(&Device, 0x00, &mute, 1);
+  USBD_TestDataIn(&Device, 0x80);
+  DEVICE_TestPendSV();
+}
+
+/**
+  * @brief  TEST_Measure
+  *         Streams with silent microphones, then steps their level inside a frame and runs the frames until
+  *         the level is played by the SAI. The microphones are silent again at the end.
+  * @param  name(IN):     path of the measure
+  * @param  loopback(IN): host loops the recording back to the playback, else it plays silence
+  * @retval latency in ms, -1 if the level is not played
+  */
+static double  TEST_Measure(const char* name, uint8_t loopback)
+{
+  double latency_ms = -1;
+  uint32_t frame;
+
+  HostLoopback = loopback;
+  HostFifoCount = 0;
+  DEVICE_TestBSP.in_step_us = 1e12;
+  for(frame = 0; frame < TEST_SETTLE_FRAMES; frame++)
+  {
+    TEST_Frame();
+  }
+  TEST_CHECK(DEVICE_TestBSP.out_running, "%s : speaker not playing", name);
+  DEVICE_TestBSP.out_waiting = 1;
+  DEVICE_TestBSP.out_silence = 0;
+  DEVICE_TestBSP.in_step_us = DEVICE_TestBSP.now_us + TEST_STEP_OFFSET_US;
+  for(frame = 0; (frame < TEST_MAX_FRAMES) && DEVICE_TestBSP.out_waiting; frame++)
+  {
+    TEST_Frame();
+  }
+  if(!DEVICE_TestBSP.out_waiting)
+  {
+    latency_ms = (DEVICE_TestBSP.out_first_us - DEVICE_TestBSP.in_step_us) / 1000.0;
+  }
+  printf("bench round trip %s at %u Hz : microphone to speaker %.2f ms\n", name, TEST_FREQUENCY, latency_ms);
+  TEST_CHECK(latency_ms > 0, "%s : microphones level not played after %u ms", name, TEST_MAX_FRAMES);
+  DEVICE_TestBSP.out_waiting = 0;
+  return latency_ms;
+}
+
+/* Exported functions --------------------------------------------------------*/
+/**
+  * @brief  main
+  *         Configures the audio function as the enumeration does, starts both streams then measures the
+  *         sidetone and the host round trip latencies.
+  * @param  None
+  * @retval exit status
+  */
+int  main(void)
+{
+  double sidetone_ms, usb_ms;
+
+  DEVICE_TestBSPReset();
+  DEVICE_TestBSP.in_step = 1;
+  DEVICE_TestBSP.in_step_us = 1e12;
+  DEVICE_TestBSP.usb_isr = &USBD_TestLL.usb_isr;
+  USBD_LL_Init(&Device);
+  memset(&Device, 0, sizeof(Device));
+  Device.pClass = &USBD_AUDIO;
+  Device.pUserData = &audio_class_interface;
+  Device.dev_state = USBD_STATE_CONFIGURED;
+  Device.ep_in[0].maxpacket = Device.ep_out[0].maxpacket = USB_MAX_EP0_SIZE;
+  Device.pClass->Init(&Device, 0);
+  DEVICE_TestPendSV();
+  HostFeedback = (uint32_t)(((uint64_t)TEST_FREQUENCY << 14) / 1000U);
+  TEST_SetInterface(USBD_AUDIO_CONFIG_PLAY_SA_INTERFACE, 1);
+  TEST_SetInterface(USBD_AUDIO_CONFIG_RECORD_SA_INTERFACE, 1);
+
+  TEST_SetSidetoneMute(0);
+  sidetone_ms = TEST_Measure("through the sidetone", 0);
+  TEST_SetSidetoneMute(1);
+  usb_ms = TEST_Measure("through the host", 1);
+
+  TEST_CHECK(sidetone_ms <= TEST_SIDETONE_MAX_MS, "sidetone latency %.2f ms above %.1f ms", sidetone_ms,
+             TEST_SIDETONE_MAX_MS);
+  TEST_CHECK(sidetone_ms < usb_ms, "sidetone latency %.2f ms not below the round trip %.2f ms", sidetone_ms,
+             usb_ms);
+  TEST_CHECK((Errors == 0) && (USBD_TestLL.errors == 0) && (USBD_TestLL.stalls == 0),
+             "%u node errors, %u class errors, %u stalls", Errors, USBD_TestLL.errors, USBD_TestLL.stalls);
+  return TEST_Report("device_round_trip_test");
+}
+
+/************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
@@ -0,0 +1,436 @@
+/**
+  ******************************************************************************
+  * @file    device_stream_start_test.c
+  * @author  MCD Application Team
+  * @brief   host benchmark of the stream starts and rate switches of the F769
+  *          project : the audio class (usbd_audio.c), the sessions and the
+  *          board nodes run over the mocked PCD (usbd_test_ll.c) and the
+  *          mocked BSP (device_test_bsp.c) on a simulated time line. Each ms
+  *          the devices run at the rate of their clock, an SOF is received,
+  *          the host sends a playback packet sized from the feedback, reads
+  *          the recording packet and the feedback. The alternate settings and
+  *          the SET_CUR sampling frequency requests of the host are scripted,
+  *          the time to the first sample, the bytes of silence before it and
+  *          the time to the sync lock are printed for each sequence. A volume
+  *          slider dragged then a mute toggled while the playback streams check
+  *          the codec is only driven from PendSV, never from a USB interrupt,
+  *          and that the requests of a burst merge in one codec write.
+  *          See readme.txt.
+  *          @build ../../Projects/Common/Streaming/Src/audio_scheduler.c
+  *          @build ../../Projects/Common/Streaming/Src/audio_usb_nodes.c
+  *          @build ../../Projects/Common/Streaming/Src/audio_usb_playback_session.c
+  *          @build ../../Projects/Common/Streaming/Src/audio_usb_recording_session.c
+  *          @build ../../Projects/Common/Streaming/Src/usbd_audio_if.c
+  *          @build ../../Projects/Common/Streaming/Src/usbd_audio_10_config_descriptors.c
+  *          @build ../../Projects/STM32F769I-Discovery/Applications/USB_Device/AUD_Streaming10/Src/audio_speaker_node.c
+  *          @build ../../Projects/STM32F769I-Discovery/Applications/USB_Device/AUD_Streaming10/Src/audio_mic_node.c
+  *          @build device_test_bsp.c usbd_test_ll.c
+  *          @build ../../Projects/Common/Middlewares/ST/STM32_USB_Device_Library/Core/Src/usbd_core_ex.c
+  *          @build ../../Middlewares/ST/STM32_USB_Device_Library/Core/Src/usbd_ctlreq.c
+  *          @build ../../Middlewares/ST/STM32_USB_Device_Library/Core/Src/usbd_ioreq.c
+  *          @build ../../Projects/Common/Middlewares/ST/STM32_USB_Device_Library/Class/AUDIO_10/Src/usbd_audio.c
+  *          @build -include device_stream_user_cfg.h
+  *          @build -I../../Projects/STM32F769I-Discovery/Applications/USB_Device/AUD_Streaming10/Inc
+  *          @build -I../../Projects/Common/Middlewares/ST/STM32_USB_Device_Library/Core/Inc
+  *          @build -I../../Middlewares/ST/STM32_USB_Device_Library/Core/Inc
+  *          @build -I../../Projects/Common/Middlewares/ST/STM32_USB_Device_Library/Class/AUDIO_10/Inc
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2019  STMicroelectronics.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by ST under Ultimate Liberty license
+  * SLA0044, the "License"; You may not use this file except in compliance with
+  * the License. You may obtain a copy of the License at:
+  *                             www.st.com/SLA0044
+  *
+  ******************************************************************************
+  */
+/* Includes ------------------------------------------------------------------*/
+#include <string.h>
+#include <math.h>
+#include "audio_nodes_test.h"
+#include "usbd_audio.h"
+#include "usbd_audio_if.h"
+#include "usbd_test_ll.h"
+#include "usb_audio.h"
+#include "audio_user_devices.h"
+#include "audio_speaker_node.h"
+
+#if !USBD_SUPPORT_AUDIO_OUT_FEEDBACK || !USE_AUDIO_RECORDING_USB_IMPLICIT_SYNCHRO
+#error "the benchmark measures the lock of the playback feedback and of the recording implicit synchronization"
+#endif /* !USBD_SUPPORT_AUDIO_OUT_FEEDBACK || !USE_AUDIO_RECORDING_USB_IMPLICIT_SYNCHRO */
+
+/* Private defines -----------------------------------------------------------*/
+#define TEST_FRAME_US                   1000U   /* full speed frame */
+#define TEST_CLOCK_PPM                  100     /* codec and microphones clocks faster than the host */
+#define TEST_IDLE_FRAMES                20U     /* frames at alternate 0 before restarting */
+#define TEST_MAX_FRAMES                 5000U   /* frames run by a sequence before it fails */
+#define TEST_WINDOW_FRAMES              1000U   /* frames of the host measure of the recording rate */
+#define TEST_LOCK_HZ                    1.0     /* rate error of a locked stream */
+#define TEST_FIRST_SAMPLE_MAX_MS        100.0
+#define TEST_LOCK_MAX_MS                4000.0
+#define TEST_PLAY_EP                    USBD_AUDIO_CONFIG_PLAY_EP_OUT
+#define TEST_SYNC_EP                    USB_AUDIO_CONFIG_PLAY_EP_SYNC
+#define TEST_RECORD_EP                  USB_AUDIO_CONFIG_RECORD_EP_IN
+#define TEST_PLAY_FRAME_SIZE            (USB_AUDIO_CONFIG_PLAY_CHANNEL_COUNT * USB_AUDIO_CONFIG_PLAY_RES_BYTE)
+#define TEST_RECORD_FRAME_SIZE          (USB_AUDIO_CONFIG_RECORD_CHANNEL_COUNT * USB_AUDIO_CONFIG_RECORD_RES_BYTE)
+#define TEST_AC_INTERFACE               0U      /* audio control interface of the configuration descriptor */
+#define TEST_DRAG_FRAMES                8U      /* frames of the volume slider drag */
+#define TEST_DRAG_BURST                 4U      /* volume requests received by frame before PendSV runs */
+#define TEST_VOLUME_PERCENT(volume_db_256) ((uint8_t)((((int)(volume_db_256) - VOLUME_SPEAKER_MIN_DB_256) * 100) / \
+                                           (VOLUME_SPEAKER_MAX_DB_256 - VOLUME_SPEAKER_MIN_DB_256)))
+
+/* Private typedef -----------------------------------------------------------*/
+/* request sequence of the host */
+typedef enum
+{
+  TEST_START,           /* alternate 1 set */
+  TEST_TOGGLE,          /* alternate 0 then 1 at the same frequency */
+  TEST_RATE_IDLE,       /* alternate 0, SET_CUR sampling frequency, alternate 1 */
+  TEST_RATE_STREAMING   /* SET_CUR sampling frequency while streaming */
+} TEST_Sequence_t;
+
+typedef struct
+{
+  const char*     name;
+  uint8_t         record;    /* recording stream, else playback */
+  TEST_Sequence_t sequence;
+  uint32_t        frequency; /* frequency after the sequence */
+} TEST_Scenario_t;
+
+/* Private variables ---------------------------------------------------------*/
+static const TEST_Scenario_t Scenarios[] =
+{
+  {"playback start",                   0, TEST_START,          USB_AUDIO_CONFIG_PLAY_DEF_FREQ},
+  {"playback alternate toggle",        0, TEST_TOGGLE,         USB_AUDIO_CONFIG_PLAY_DEF_FREQ},
+  {"playback rate at alternate 0",     0, TEST_RATE_IDLE,      USB_AUDIO_CONFIG_FREQ_48_K},
+  {"playback rate while streaming",    0, TEST_RATE_STREAMING, USB_AUDIO_CONFIG_FREQ_44_1_K},
+  {"recording start",                  1, TEST_START,          USB_AUDIO_CONFIG_RECORD_DEF_FREQ},
+  {"recording alternate toggle",       1, TEST_TOGGLE,         USB_AUDIO_CONFIG_RECORD_DEF_FREQ},
+  {"recording rate at alternate 0",    1, TEST_RATE_IDLE,      USB_AUDIO_CONFIG_FREQ_48_K},
+  {"recording rate while streaming",   1, TEST_RATE_STREAMING, USB_AUDIO_CONFIG_FREQ_44_1_K}
+};
+static USBD_HandleTypeDef Device;
+static uint32_t Errors;
+/* host side */
+static uint32_t HostFeedback;           /* last feedback read, 10.14 samples by frame */
+static uint32_t HostAccumulator;        /* fraction of sample of the playback packets */
+static uint8_t  RecordWaiting;          /* no non zero recorded sample received yet */
+static uint32_t RecordSilence;          /* bytes of silence received while RecordWaiting is set */
+static double   RecordFirstUs;
+static uint16_t Window[TEST_WINDOW_FRAMES]; /* samples received in the last frames */
+static uint32_t WindowSum;
+static uint32_t WindowFrames;           /* frames received since the first sample */
+
+/* Private functions ---------------------------------------------------------*/
+/**
+  * @brief  Error_Handler
+  *         Counts the errors reported by the nodes.
+  * @param  None
+  * @retval None
+  */
+void  Error_Handler(void)
+{
+  Errors++;
+}
+
+/**
+  * @brief  TEST_FeedbackHz
+  *         Decodes the feedback of a full speed sync endpoint, 10.14 samples by frame.
+  * @param  data(IN): feedback packet
+  * @retval rate in Hz
+  */
+static double  TEST_FeedbackHz(const uint8_t* data)
+{
+  uint32_t value = data[0] | ((uint32_t)data[1] << 8) | ((uint32_t)data[2] << 16);
+
+  return value * 1000.0 / 16384.0;
+}
+
+/**
+  * @brief  TEST_Frame
+  *         One ms : the devices run, the SOF is received, the host sends the playback packet sized from the
+  *         last feedback, reads the recording packet then the feedback. PendSV runs after each interrupt.
+  * @param  None
+  * @retval None
+  */
+static void  TEST_Frame(void)
+{
+  static uint8_t packet[USBD_AUDIO_CONFIG_PLAY_MAX_PACKET_SIZE];
+  USBD_TestEp_t* ep;
+  uint32_t size, i;
+
+  DEVICE_TestRunDevices(TEST_FRAME_US);
+  USBD_TestSOF(&Device);
+  DEVICE_TestPendSV();
+
+  ep = &USBD_TestLL.out[TEST_PLAY_EP];
+  if(ep->open && (ep->buf != NULL))
+  {
+    HostAccumulator += HostFeedback;
+    size = (HostAccumulator >> 14) * TEST_PLAY_FRAME_SIZE;
+    HostAccumulator &= 0x3FFFU;
+    size = (size > sizeof(packet))? sizeof(packet) : size;
+    memset(packet, 0x22, size);
+    USBD_TestDataOutPacket(&Device, TEST_PLAY_EP, packet, (uint16_t)size);
+    DEVICE_TestPendSV();
+  }
+
+  ep = &USBD_TestLL.in[TEST_RECORD_EP & 0x0FU];
+  if(ep->open && (ep->buf != NULL))
+  {
+    for(i = 0; RecordWaiting && (i < ep->size); i++)
+    {
+      if(ep->buf[i] != 0)
+      {
+        RecordWaiting = 0;
+        RecordFirstUs = DEVICE_TestBSP.now_us;
+      }
+      else
+      {
+        RecordSilence++;
+      }
+    }
+    if(!RecordWaiting)
+    {
+      WindowSum -= Window[WindowFrames % TEST_WINDOW_FRAMES];
+      Window[WindowFrames % TEST_WINDOW_FRAMES] = (uint16_t)(ep->size / TEST_RECORD_FRAME_SIZE);
+      WindowSum += Window[WindowFrames % TEST_WINDOW_FRAMES];
+      WindowFrames++;
+    }
+    USBD_TestDataIn(&Device, TEST_RECORD_EP);
+    DEVICE_TestPendSV();
+  }
+
+  ep = &USBD_TestLL.in[TEST_SYNC_EP & 0x0FU];
+  if(ep->open && (ep->buf != NULL))
+  {
+    HostFeedback = (uint32_t)lround(TEST_FeedbackHz(ep->buf) * 16384.0 / 1000.0);
+    USBD_TestDataIn(&Device, TEST_SYNC_EP);
+  }
+}
+
+/**
+  * @brief  TEST_SetInterface
+  *         SET_INTERFACE request of the host.
+  * @param  interface(IN): audio streaming interface
+  * @param  alternate(IN): alternate setting
+  * @retval None
+  */
+static void  TEST_SetInterface(uint16_t interface, uint16_t alternate)
+{
+  USBD_TestSetup(&Device, 0x01, USB_REQ_SET_INTERFACE, alternate, interface, 0);
+  DEVICE_TestPendSV();
+}
+
+/**
+  * @brief  TEST_SetFrequency
+  *         SET_CUR sampling frequency request of the host to an endpoint : setup, data and status stages.
+  * @param  ep_addr(IN):   data endpoint
+  * @param  frequency(IN): new frequency
+  * @retval None
+  */
+static void  TEST_SetFrequency(uint8_t ep_addr, uint32_t frequency)
+{
+  uint8_t data[3];
+
+  data[0] = (uint8_t)frequency;
+  data[1] = (uint8_t)(frequency >> 8);
+  data[2] = (uint8_t)(frequency >> 16);
+  USBD_TestSetup(&Device, 0x22, USBD_AUDIO_REQ_SET_CUR, USBD_AUDIO_CONTROL_EP_SAMPL_FREQ << 8, ep_addr, 3);
+  USBD_TestDataOutPacket(&Device, 0x00, data, 3);
+  USBD_TestDataIn(&Device, 0x80);
+  DEVICE_TestPendSV();
+}
+
+/**
+  * @brief  TEST_SetFeature
+  *         SET_CUR request of the host to the playback feature unit : setup, data and status stages. PendSV
+  *         is not run, the requests of a burst are received before the codec task runs.
+  * @param  control(IN): USBD_AUDIO_FU_MUTE_CONTROL or USBD_AUDIO_FU_VOLUME_CONTROL
+  * @param  value(IN):   mute or volume in db 256
+  * @retval None
+  */
+static void  TEST_SetFeature(uint8_t control, int16_t value)
+{
+  uint8_t data[2];
+  uint16_t length = (control == USBD_AUDIO_FU_MUTE_CONTROL)? 1 : 2;
+
+  data[0] = (uint8_t)value;
+  data[1] = (uint8_t)((uint16_t)value >> 8);
+  USBD_TestSetup(&Device, 0x21, USBD_AUDIO_REQ_SET_CUR, control << 8,
+                 (USB_AUDIO_CONFIG_PLAY_UNIT_FEATURE_ID << 8) | TEST_AC_INTERFACE, length);
+  USBD_TestDataOutPacket(&Device, 0x00, data, length);
+  USBD_TestDataIn(&Device, 0x80);
+}
+
+/**
+  * @brief  TEST_VolumeDrag
+  *         Playback streaming, the host drags the volume slider from the minimum, TEST_DRAG_BURST requests
+  *         by frame, then mutes and unmutes the speaker. The codec calls made from a USB interrupt are
+  *         counted from the start of the test, the volume calls must merge the requests of a frame.
+  * @param  None
+  * @retval None
+  */
+static void  TEST_VolumeDrag(void)
+{
+  uint32_t frame, i, volume_calls, requests = 0, usb_calls = 0;
+  int16_t volume = VOLUME_SPEAKER_MIN_DB_256;
+
+  TEST_SetInterface(USBD_AUDIO_CONFIG_RECORD_SA_INTERFACE, 0);
+  TEST_SetInterface(USBD_AUDIO_CONFIG_PLAY_SA_INTERFACE, 1);
+  for(frame = 0; frame < TEST_IDLE_FRAMES; frame++)
+  {
+    TEST_Frame();
+  }
+  volume_calls = DEVICE_TestBSP.count[DEVICE_TEST_OUT_SET_VOLUME];
+  for(frame = 0; frame < TEST_DRAG_FRAMES; frame++)
+  {
+    for(i = 0; i < TEST_DRAG_BURST; i++, requests++)
+    {
+      volume += VOLUME_SPEAKER_RES_DB_256;
+      TEST_SetFeature(USBD_AUDIO_FU_VOLUME_CONTROL, volume);
+    }
+    TEST_Frame();
+  }
+  volume_calls = DEVICE_TestBSP.count[DEVICE_TEST_OUT_SET_VOLUME] - volume_calls;
+  TEST_CHECK(DEVICE_TestBSP.out_volume == TEST_VOLUME_PERCENT(volume), "volume %u %%, %u %% requested",
+             DEVICE_TestBSP.out_volume, TEST_VOLUME_PERCENT(volume));
+
+  TEST_SetFeature(USBD_AUDIO_FU_MUTE_CONTROL, 1);
+  TEST_Frame();
+  TEST_CHECK(DEVICE_TestBSP.out_muted, "speaker not muted");
+  TEST_SetFeature(USBD_AUDIO_FU_MUTE_CONTROL, 0);
+  TEST_Frame();
+  TEST_CHECK(!DEVICE_TestBSP.out_muted, "speaker not unmuted");
+
+  for(i = DEVICE_TEST_OUT_SET_FREQUENCY; i <= DEVICE_TEST_OUT_SET_VOLUME; i++)
+  {
+    usb_calls += DEVICE_TestBSP.usb_isr_count[i];
+  }
+  usb_calls += DEVICE_TestBSP.usb_isr_count[DEVICE_TEST_IN_SET_FREQUENCY];
+  printf("bench stream volume drag : %u requests in %u frames, %u codec volume calls, %u codec control calls "
+         "from a USB interrupt\n", requests, TEST_DRAG_FRAMES, volume_calls, usb_calls);
+  TEST_CHECK(usb_calls == 0, "%u frequency, mute or volume calls from a USB interrupt", usb_calls);
+  TEST_CHECK(volume_calls <= TEST_DRAG_FRAMES, "%u codec volume calls for %u frames", volume_calls,
+             TEST_DRAG_FRAMES);
+  TEST_CHECK((Errors == 0) && (USBD_TestLL.errors == 0) && (USBD_TestLL.stalls == 0),
+             "volume drag : %u node errors, %u class errors, %u stalls", Errors, USBD_TestLL.errors,
+             USBD_TestLL.stalls);
+}
+
+/**
+  * @brief  TEST_Run
+  *         Runs the request sequence of a scenario then the frames until the first sample is played or
+  *         received and the stream is locked on the clock of the device. Prints the results.
+  * @param  scenario(IN): scenario
+  * @retval None
+  */
+static void  TEST_Run(const TEST_Scenario_t* scenario)
+{
+  uint16_t interface = scenario->record? USBD_AUDIO_CONFIG_RECORD_SA_INTERFACE : USBD_AUDIO_CONFIG_PLAY_SA_INTERFACE;
+  uint8_t ep_addr = scenario->record? TEST_RECORD_EP : TEST_PLAY_EP;
+  double device_hz = scenario->frequency * (1.0 + TEST_CLOCK_PPM * 1e-6);
+  double start_us, first_us = -1, lock_us = -1, feedback_hz;
+  uint32_t frame, silence;
+
+  if((scenario->sequence == TEST_TOGGLE) || (scenario->sequence == TEST_RATE_IDLE))
+  {
+    TEST_SetInterface(interface, 0);
+    for(frame = 0; frame < TEST_IDLE_FRAMES; frame++)
+    {
+      TEST_Frame();
+    }
+  }
+  start_us = DEVICE_TestBSP.now_us;
+  DEVICE_TestBSP.out_waiting = !scenario->record;
+  DEVICE_TestBSP.out_silence = 0;
+  RecordWaiting = scenario->record;
+  RecordSilence = 0;
+  WindowSum = WindowFrames = 0;
+  memset(Window, 0, sizeof(Window));
+  HostFeedback = (uint32_t)(((uint64_t)scenario->frequency << 14) / 1000U);
+  if(scenario->sequence != TEST_START && scenario->sequence != TEST_TOGGLE)
+  {
+    TEST_SetFrequency(ep_addr, scenario->frequency);
+  }
+  if(scenario->sequence != TEST_RATE_STREAMING)
+  {
+    TEST_SetInterface(interface, 1);
+  }
+
+  for(frame = 0; (frame < TEST_MAX_FRAMES) && (lock_us < 0); frame++)
+  {
+    TEST_Frame();
+    if(scenario->record)
+    {
+      first_us = RecordWaiting? -1 : RecordFirstUs;
+      if((WindowFrames >= TEST_WINDOW_FRAMES) && (fabs(WindowSum - device_hz) <= TEST_LOCK_HZ))
+      {
+        lock_us = DEVICE_TestBSP.now_us;
+      }
+    }
+    else
+    {
+      first_us = DEVICE_TestBSP.out_waiting? -1 : DEVICE_TestBSP.out_first_us;
+      feedback_hz = HostFeedback * 1000.0 / 16384.0;
+      if((first_us >= 0) && (fabs(feedback_hz - device_hz) <= TEST_LOCK_HZ))
+      {
+        lock_us = DEVICE_TestBSP.now_us;
+      }
+    }
+  }
+  silence = scenario->record? RecordSilence : DEVICE_TestBSP.out_silence;
+  printf("bench stream %s at %u Hz : first sample after %.2f ms, %u bytes of silence, locked after %.0f ms\n",
+         scenario->name, scenario->frequency, (first_us - start_us) / 1000.0, silence, (lock_us - start_us) / 1000.0);
+  TEST_CHECK((scenario->record? DEVICE_TestBSP.in_frequency : DEVICE_TestBSP.out_frequency) == scenario->frequency,
+             "%s : device at %u Hz", scenario->name,
+             scenario->record? DEVICE_TestBSP.in_frequency : DEVICE_TestBSP.out_frequency);
+  TEST_CHECK((first_us >= 0) && (first_us - start_us <= TEST_FIRST_SAMPLE_MAX_MS * 1000.0),
+             "%s : no sample after %.0f ms", scenario->name, TEST_FIRST_SAMPLE_MAX_MS);
+  TEST_CHECK((lock_us >= 0) && (lock_us - start_us <= TEST_LOCK_MAX_MS * 1000.0),
+             "%s : not locked on the device clock after %.0f ms", scenario->name, TEST_LOCK_MAX_MS);
+  TEST_CHECK((Errors == 0) && (USBD_TestLL.errors == 0) && (USBD_TestLL.stalls == 0),
+             "%s : %u node errors, %u class errors, %u stalls", scenario->name, Errors, USBD_TestLL.errors,
+             USBD_TestLL.stalls);
+}
+
+/* Exported functions --------------------------------------------------------*/
+/**
+  * @brief  main
+  *         Configures the audio function as the enumeration does then runs the scenarios in order, each one
+  *         starts from the state left by the previous one, and the volume drag.
+  * @param  None
+  * @retval exit status
+  */
+int  main(void)
+{
+  uint32_t i;
+
+  DEVICE_TestBSPReset();
+  DEVICE_TestBSP.clock_ppm = TEST_CLOCK_PPM;
+  DEVICE_TestBSP.usb_isr = &USBD_TestLL.usb_isr;
+  USBD_LL_Init(&Device);
+  memset(&Device, 0, sizeof(Device));
+  Device.pClass = &USBD_AUDIO;
+  Device.pUserData = &audio_class_interface;
+  Device.dev_state = USBD_STATE_CONFIGURED;
+  Device.ep_in[0].maxpacket = Device.ep_out[0].maxpacket = USB_MAX_EP0_SIZE;
+  Device.pClass->Init(&Device, 0);
+  DEVICE_TestPendSV();
+
+  for(i = 0; i < sizeof(Scenarios) / sizeof(Scenarios[0]); i++)
+  {
+    if((i > 0) && (Scenarios[i].record != Scenarios[i - 1].record))
+    {
+      TEST_SetInterface(USBD_AUDIO_CONFIG_PLAY_SA_INTERFACE, 0);
+    }
+    TEST_Run(&Scenarios[i]);
+  }
+  TEST_VolumeDrag();
+  return TEST_Report("device_stream_start_test");
+}
+
+/************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
@@ -0,0 +1,105 @@
+/**
+  ******************************************************************************
+  * @file    device_stream_user_cfg.h
+  * @author  MCD Application Team
+  * @brief   configuration of the stream start and rate switch host tests : the
+  *          F769 Discovery simultaneous playback and recording project as
+  *          shipped (full speed on the high speed core, stereo 16 bits, 1 ms
+  *          blocks, deferred processing), with the 44.1, 48 and 96 KHz
+  *          frequencies on both streams so the host can switch the rate.
+  *          It replaces usb_audio_user_cfg.h : the tests are built with
+  *          -include device_stream_user_cfg.h, which defines its include guard.
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2019  STMicroelectronics.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by ST under Ultimate Liberty license
+  * SLA0044, the "License"; You may not use this file except in compliance with
+  * the License. You may obtain a copy of the License at:
+  *                             www.st.com/SLA0044
+  *
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __USB_AUDIO_USER_CFG_H
+#define __USB_AUDIO_USER_CFG_H
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+/* includes ------------------------------------------------------------------*/
+#include <stdint.h>
+#include "usb_audio_constants.h"
+/* Exported constants --------------------------------------------------------*/
+/* project defines of the ADV project */
+#define USE_USB_FS                                   1
+#define USE_USB_FS_INTO_HS                           1
+#define USE_USB_AUDIO_PLAYBACK                       1
+#define USE_USB_AUDIO_RECORDING                      1
+#define USE_AUDIO_DFSDM_MEMS_MIC                     1
+/* configure project, see the application usb_audio_user_cfg.h */
+#define  USE_USB_AUDIO_CLASS_10 1
+#define USE_USB_AUDIO_DMA 0
+#define USE_AUDIO_DEFERRED_PROCESSING 1
+#define USE_AUDIO_PROFILER 0
+#define USE_AUDIO_TRACE 0
+#define USE_AUDIO_PROCESSING_GRAPH 0
+#define USE_AUDIO_SOFTWARE_VOLUME 0
+
+#define USE_AUDIO_PLAYBACK_USB_FEEDBACK 1
+#define USB_AUDIO_CONFIG_PLAY_CHANNEL_COUNT          0x02 /* stereo audio  */
+#define USB_AUDIO_CONFIG_PLAY_CHANNEL_MAP            0x03 /* channels Left and right */
+#define USB_AUDIO_CONFIG_PLAY_RES_BIT                16
+#define USB_AUDIO_CONFIG_PLAY_RES_BYTE               2
+#define USB_AUDIO_CONFIG_PLAY_USE_FREQ_192_K          0
+#define USB_AUDIO_CONFIG_PLAY_USE_FREQ_96_K           1
+#define USB_AUDIO_CONFIG_PLAY_USE_FREQ_48_K           1
+#define USB_AUDIO_CONFIG_PLAY_USE_FREQ_44_1_K         1
+#define USB_AUDIO_CONFIG_PLAY_USE_FREQ_32_K           0
+#define USB_AUDIO_CONFIG_PLAY_USE_FREQ_16_K           0
+#define USB_AUDIO_CONFIG_PLAY_USE_FREQ_8_K            0
+#define USE_AUDIO_TIMER_VOLUME_CTRL  0
+#define  USB_AUDIO_CONFIG_PLAY_BUFFER_SIZE (1024 * 10)
+#define USB_AUDIO_CONFIG_PLAY_BLOCK_US               1000
+#define USB_AUDIO_CONFIG_PLAY_BLOCK_US_MAX           1000
+#define USE_AUDIO_SPEAKER_CIRCULAR_DMA               0
+#define USE_AUDIO_SPEAKER_EARLY_CODEC_INIT           1
+#define USE_AUDIO_PLAYBACK_EQ                        0
+#define USE_AUDIO_PLAYBACK_LIMITER                   0
+#define USE_AUDIO_PLAYBACK_MIXER                     0
+
+#define USB_AUDIO_CONFIG_RECORD_CHANNEL_COUNT          0x02 /* stereo audio  */
+#define USB_AUDIO_CONFIG_RECORD_CHANNEL_MAP            0x03 /* channels Left and right */
+#define USB_AUDIO_CONFIG_RECORD_RES_BIT                16
+#define USB_AUDIO_CONFIG_RECORD_RES_BYTE               2
+#define USB_AUDIO_CONFIG_RECORD_USE_FREQ_192_K          0
+#define USB_AUDIO_CONFIG_RECORD_USE_FREQ_96_K           1
+#define USB_AUDIO_CONFIG_RECORD_USE_FREQ_48_K           1
+#define USB_AUDIO_CONFIG_RECORD_USE_FREQ_44_1_K         1
+#define USB_AUDIO_CONFIG_RECORD_USE_FREQ_32_K           0
+#define USB_AUDIO_CONFIG_RECORD_USE_FREQ_16_K           0
+#define USB_AUDIO_CONFIG_RECORD_USE_FREQ_8_K            0
+#define USE_AUDIO_RECORDING_USB_IMPLICIT_SYNCHRO 1
+#define USE_AUDIO_RECORDING_USB_NO_REMOVE 1
+#define  USB_AUDIO_CONFIG_RECORD_BUFFER_SIZE         (1024 * USB_AUDIO_CONFIG_RECORD_CHANNEL_COUNT)
+#define USB_AUDIO_CONFIG_RECORD_BLOCK_US             1000
+#define USB_AUDIO_CONFIG_RECORD_BLOCK_US_MAX         1000
+#define USE_AUDIO_RECORDING_BEAMFORMER               0
+
+#define USE_AUDIO_SIDETONE 0
+
+/* set by the usbd_conf.h of the board from the configuration above */
+#define USBD_SUPPORT_AUDIO_OUT_FEEDBACK              1
+#define USBD_SUPPORT_AUDIO_MULTI_FREQUENCIES         1
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __USB_AUDIO_USER_CFG_H */
+
+
+/************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
@@ -0,0 +1,441 @@
+/**
+  ******************************************************************************
+  * @file    device_test_bsp.c
+  * @author  MCD Application Team
+  * @brief   mocked audio BSP of the STM32F769I-Discovery for the host tests of
+  *          the board audio devices : the calls of the nodes are counted and
+  *          logged with the context they are made from, the SAI and DFSDM DMA
+  *          interrupts are raised by the test, or by DEVICE_TestRunDevices which
+  *          moves the DMA counters at the rate of the codec and microphones
+  *          clocks, PendSV runs the scheduler.
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2019  STMicroelectronics.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by ST under Ultimate Liberty license
+  * SLA0044, the "License"; You may not use this file except in compliance with
+  * the License. You may obtain a copy of the License at:
+  *                             www.st.com/SLA0044
+  *
+  ******************************************************************************
+  */
+/* Includes ------------------------------------------------------------------*/
+#include <string.h>
+#include "audio_user_devices.h"
+#include "audio_scheduler.h"
+#include "stm32f769i_discovery_audio_ex.h"
+
+/* Exported variables --------------------------------------------------------*/
+DEVICE_TestBSP_t  DEVICE_TestBSP;
+SCB_Type          TEST_SCB;
+SAI_HandleTypeDef haudio_out_sai;
+DMA_HandleTypeDef hDmaTopLeft;
+DMA_HandleTypeDef hDmaTopRight;
+
+/* Private variables ---------------------------------------------------------*/
+static DMA_HandleTypeDef hdma_sai_tx;
+
+/* Private functions ---------------------------------------------------------*/
+/**
+  * @brief  DEVICE_TestRecord
+  *         Counts a BSP call and logs it with its context.
+  * @param  call(IN): called function
+  * @param  arg(IN):  main argument of the call
+  * @retval None
+  */
+static void  DEVICE_TestRecord(DEVICE_TestCall_t call, uint32_t arg)
+{
+  DEVICE_TestBSP.count[call]++;
+  if(DEVICE_TestBSP.isr)
+  {
+    DEVICE_TestBSP.isr_count[call]++;
+  }
+  if((DEVICE_TestBSP.usb_isr != NULL) && *DEVICE_TestBSP.usb_isr)
+  {
+    DEVICE_TestBSP.usb_isr_count[call]++;
+  }
+  if(DEVICE_TestBSP.log_count < DEVICE_TEST_CALLS)
+  {
+    DEVICE_TestBSP.log[DEVICE_TestBSP.log_count].call  = call;
+    DEVICE_TestBSP.log[DEVICE_TestBSP.log_count].arg   = arg;
+    DEVICE_TestBSP.log[DEVICE_TestBSP.log_count].isr   = DEVICE_TestBSP.isr;
+    DEVICE_TestBSP.log[DEVICE_TestBSP.log_count].muted = DEVICE_TestBSP.out_muted;
+  }
+  DEVICE_TestBSP.log_count++;
+}
+
+/**
+  * @brief  DEVICE_TestOutArm
+  *         Arms a SAI DMA transfer, the size of the transfer is given in data units as by HAL_SAI_Transmit_DMA.
+  *         While out_waiting is set the leading silence of the buffer is counted and the time its first non zero
+  *         sample will be played is kept.
+  * @param  pData(IN): buffer
+  * @param  Size(IN):  bytes of the buffer
+  * @retval None
+  */
+static void  DEVICE_TestOutArm(uint16_t* pData, uint32_t Size)
+{
+  const uint8_t* data = (const uint8_t*)pData;
+  uint32_t i;
+
+  DEVICE_TestBSP.out_data = pData;
+  DEVICE_TestBSP.out_size = Size;
+  DEVICE_TestBSP.out_running = 1;
+  haudio_out_sai.XferSize = (uint16_t)(Size / DEVICE_TestBSP.out_res_byte);
+  hdma_sai_tx.counter = haudio_out_sai.XferSize;
+  DEVICE_TestBSP.out_phase = 0;
+  for(i = 0; DEVICE_TestBSP.out_waiting && (i < Size); i++)
+  {
+    if(data[i] != 0)
+    {
+      DEVICE_TestBSP.out_waiting = 0;
+      DEVICE_TestBSP.out_first_us = DEVICE_TestBSP.now_us + (double)(i / DEVICE_TestBSP.out_res_byte) * 1e6 /
+                                    ((double)DEVICE_TestBSP.out_frequency * DEVICE_TEST_OUT_SLOTS *
+                                     (1.0 + DEVICE_TestBSP.clock_ppm * 1e-6));
+    }
+    else
+    {
+      DEVICE_TestBSP.out_silence++;
+    }
+  }
+}
+
+/* Exported functions --------------------------------------------------------*/
+/**
+  * @brief  DEVICE_TestBSPReset
+  *         Clears the counts and the log, the state of the devices is kept.
+  * @param  None
+  * @retval None
+  */
+void  DEVICE_TestBSPReset(void)
+{
+  memset(DEVICE_TestBSP.count, 0, sizeof(DEVICE_TestBSP.count));
+  memset(DEVICE_TestBSP.isr_count, 0, sizeof(DEVICE_TestBSP.isr_count));
+  memset(DEVICE_TestBSP.usb_isr_count, 0, sizeof(DEVICE_TestBSP.usb_isr_count));
+  DEVICE_TestBSP.log_count = 0;
+  haudio_out_sai.hdmatx = &hdma_sai_tx;
+}
+
+/**
+  * @brief  DEVICE_TestFindCall
+  *         Looks for a call in the log.
+  * @param  call(IN): function to look for
+  * @param  from(IN): first log index to look at
+  * @retval log index of the call, -1 if not found
+  */
+int32_t  DEVICE_TestFindCall(DEVICE_TestCall_t call, uint32_t from)
+{
+  uint32_t i;
+
+  for(i = from; (i < DEVICE_TestBSP.log_count) && (i < DEVICE_TEST_CALLS); i++)
+  {
+    if(DEVICE_TestBSP.log[i].call == call)
+    {
+      return (int32_t)i;
+    }
+  }
+  return -1;
+}
+
+/**
+  * @brief  DEVICE_TestOutTransferComplete
+  *         Raises the SAI DMA transfer complete interrupt, the DMA stops at the end of the armed transfer
+  *         unless the callback arms the next one.
+  * @param  None
+  * @retval None
+  */
+void  DEVICE_TestOutTransferComplete(void)
+{
+  if(!DEVICE_TestBSP.out_running)
+  {
+    return;
+  }
+  DEVICE_TestBSP.out_running = 0;
+  hdma_sai_tx.counter = 0;
+  DEVICE_TestBSP.isr = 1;
+  BSP_AUDIO_OUT_TransferComplete_CallBack();
+  DEVICE_TestBSP.isr = 0;
+}
+
+/**
+  * @brief  DEVICE_TestInHalfTransfer
+  *         Raises the DFSDM DMA half transfer interrupt.
+  * @param  None
+  * @retval None
+  */
+void  DEVICE_TestInHalfTransfer(void)
+{
+  if(!DEVICE_TestBSP.in_recording)
+  {
+    return;
+  }
+  hDmaTopRight.counter = DEVICE_TestBSP.in_scratch_size / (AUDIO_MIC_CAPTURE_CHANNEL_COUNT * 2U);
+  DEVICE_TestBSP.isr = 1;
+  BSP_AUDIO_IN_HalfTransfer_CallBack();
+  DEVICE_TestBSP.isr = 0;
+}
+
+/**
+  * @brief  DEVICE_TestInTransferComplete
+  *         Raises the DFSDM DMA transfer complete interrupt, the circular DMA goes on with the first half.
+  * @param  None
+  * @retval None
+  */
+void  DEVICE_TestInTransferComplete(void)
+{
+  if(!DEVICE_TestBSP.in_recording)
+  {
+    return;
+  }
+  hDmaTopRight.counter = DEVICE_TestBSP.in_scratch_size / AUDIO_MIC_CAPTURE_CHANNEL_COUNT;
+  DEVICE_TestBSP.isr = 1;
+  BSP_AUDIO_IN_TransferComplete_CallBack();
+  DEVICE_TestBSP.isr = 0;
+}
+
+/**
+  * @brief  DEVICE_TestPendSV
+  *         Runs the PendSV handler if it was triggered.
+  * @param  None
+  * @retval 1 if the scheduler ran
+  */
+uint8_t  DEVICE_TestPendSV(void)
+{
+  if((TEST_SCB.ICSR & SCB_ICSR_PENDSVSET_Msk) == 0)
+  {
+    return 0;
+  }
+  TEST_SCB.ICSR = 0;
+#if USE_AUDIO_SCHEDULER
+  AUDIO_SchedulerRun();
+#endif /* USE_AUDIO_SCHEDULER */
+  return 1;
+}
+
+/**
+  * @brief  DEVICE_TestRunDevices
+  *         Runs the SAI and DFSDM DMA for a time, at the rate of the codec and microphones clocks : the counters
+  *         move, the interrupts are raised at the end of the SAI transfers and at each half of the DFSDM buffer,
+  *         PendSV runs after each interrupt. An idle SAI plays nothing until a transfer is armed.
+  * @param  us(IN): time to run in us
+  * @retval None
+  */
+void  DEVICE_TestRunDevices(uint32_t us)
+{
+  double end_us = DEVICE_TestBSP.now_us + us;
+  double clock = 1.0 + DEVICE_TestBSP.clock_ppm * 1e-6;
+  double out_rate, in_rate, out_us, in_us, step_us;
+  uint32_t in_length, in_next, units;
+
+  while(DEVICE_TestBSP.now_us < end_us)
+  {
+    /* data units by us, time of the next interrupt of each DMA */
+    out_rate = (double)DEVICE_TestBSP.out_frequency * DEVICE_TEST_OUT_SLOTS * clock * 1e-6;
+    in_rate  = (double)DEVICE_TestBSP.in_frequency * clock * 1e-6;
+    in_length = DEVICE_TestBSP.in_scratch_size / AUDIO_MIC_CAPTURE_CHANNEL_COUNT;
+    in_next = (hDmaTopRight.counter > (in_length >> 1))? in_length >> 1 : 0U;
+    step_us = end_us - DEVICE_TestBSP.now_us;
+    out_us = (DEVICE_TestBSP.out_running && (out_rate > 0))?
+             (hdma_sai_tx.counter - DEVICE_TestBSP.out_phase) / out_rate : step_us;
+    in_us  = (DEVICE_TestBSP.in_recording && (in_rate > 0) && (in_length != 0))?
+             (hDmaTopRight.counter - in_next - DEVICE_TestBSP.in_phase) / in_rate : step_us;
+    step_us = (out_us < step_us)? out_us : step_us;
+    step_us = (in_us < step_us)? in_us : step_us;
+    DEVICE_TestBSP.now_us += step_us;
+
+    if(DEVICE_TestBSP.out_running)
+    {
+      if(step_us == out_us)
+      {
+        DEVICE_TestOutTransferComplete();
+        DEVICE_TestPendSV();
+      }
+      else
+      {
+        DEVICE_TestBSP.out_phase += step_us * out_rate;
+        units = (uint32_t)DEVICE_TestBSP.out_phase;
+        DEVICE_TestBSP.out_phase -= units;
+        hdma_sai_tx.counter -= units;
+      }
+    }
+    if(DEVICE_TestBSP.in_recording && (in_length != 0))
+    {
+      if(step_us == in_us)
+      {
+        DEVICE_TestBSP.in_phase = 0;
+        if(in_next != 0U)
+        {
+          DEVICE_TestInHalfTransfer();
+        }
+        else
+        {
+          DEVICE_TestInTransferComplete();
+        }
+        DEVICE_TestPendSV();
+      }
+      else
+      {
+        DEVICE_TestBSP.in_phase += step_us * in_rate;
+        units = (uint32_t)DEVICE_TestBSP.in_phase;
+        DEVICE_TestBSP.in_phase -= units;
+        hDmaTopRight.counter -= units;
+      }
+    }
+  }
+}
+
+/* audio BSP of the board, see stm32f769i_discovery_audio_ex.c */
+uint8_t  BSP_AUDIO_OUT_Init_Ext(uint16_t OutputDevice, uint8_t Volume, uint32_t AudioFreq, uint8_t AudioResolution)
+{
+  (void)OutputDevice;
+  DEVICE_TestRecord(DEVICE_TEST_OUT_INIT, AudioFreq);
+  DEVICE_TestBSP.out_res_byte = (AudioResolution == 16)? 2 : 4;
+  DEVICE_TestBSP.out_frequency = AudioFreq;
+  DEVICE_TestBSP.out_volume = Volume;
+  DEVICE_TestBSP.out_muted = 0;
+  haudio_out_sai.hdmatx = &hdma_sai_tx;
+  return AUDIO_OK;
+}
+
+void  BSP_AUDIO_OUT_DeInit(void)
+{
+  DEVICE_TestRecord(DEVICE_TEST_OUT_DEINIT, 0);
+}
+
+uint8_t  BSP_AUDIO_OUT_Play(uint16_t* pBuffer, uint32_t Size)
+{
+  DEVICE_TestRecord(DEVICE_TEST_OUT_PLAY, Size);
+  DEVICE_TestOutArm(pBuffer, Size);
+  return AUDIO_OK;
+}
+
+void  BSP_AUDIO_OUT_ChangeBuffer(uint16_t *pData, uint16_t Size)
+{
+  DEVICE_TestRecord(DEVICE_TEST_OUT_CHANGE_BUFFER, Size);
+  DEVICE_TestOutArm(pData, Size);
+}
+
+void  BSP_AUDIO_OUT_SetDMACircular(uint8_t Circular)
+{
+  (void)Circular;
+}
+
+uint8_t  BSP_AUDIO_OUT_Stop(uint32_t Option)
+{
+  (void)Option;
+  DEVICE_TestRecord(DEVICE_TEST_OUT_STOP, 0);
+  DEVICE_TestBSP.out_running = 0;
+  return AUDIO_OK;
+}
+
+uint8_t  BSP_AUDIO_OUT_SetVolume(uint8_t Volume)
+{
+  DEVICE_TestRecord(DEVICE_TEST_OUT_SET_VOLUME, Volume);
+  DEVICE_TestBSP.out_volume = Volume;
+  return AUDIO_OK;
+}
+
+void  BSP_AUDIO_OUT_SetFrequency(uint32_t AudioFreq)
+{
+  DEVICE_TestRecord(DEVICE_TEST_OUT_SET_FREQUENCY, AudioFreq);
+  DEVICE_TestBSP.out_frequency = AudioFreq;
+}
+
+uint8_t  BSP_AUDIO_OUT_SetMute(uint32_t Cmd)
+{
+  DEVICE_TestRecord(DEVICE_TEST_OUT_SET_MUTE, Cmd);
+  DEVICE_TestBSP.out_muted = (uint8_t)Cmd;
+  return AUDIO_OK;
+}
+
+void  BSP_AUDIO_OUT_HoldCodecWrites(void)
+{
+}
+
+uint8_t  BSP_AUDIO_OUT_FlushCodecWrites(void)
+{
+  return AUDIO_OK;
+}
+
+int  HAL_SAI_DMAStop(SAI_HandleTypeDef *hsai)
+{
+  (void)hsai;
+  DEVICE_TestBSP.out_running = 0;
+  return 0;
+}
+
+uint8_t  BSP_AUDIO_IN_Init(uint32_t AudioFreq, uint32_t BitRes, uint32_t ChnlNbr)
+{
+  (void)BitRes;
+  (void)ChnlNbr;
+  DEVICE_TestRecord(DEVICE_TEST_IN_INIT, AudioFreq);
+  DEVICE_TestBSP.in_frequency = AudioFreq;
+  return AUDIO_OK;
+}
+
+uint8_t  BSP_AUDIO_IN_AllocScratch (int32_t *pScratch, uint32_t size)
+{
+  (void)pScratch;
+  DEVICE_TestBSP.in_scratch_size = size;
+  return AUDIO_OK;
+}
+
+void  BSP_AUDIO_IN_DeInit(void)
+{
+  DEVICE_TestRecord(DEVICE_TEST_IN_DEINIT, 0);
+  DEVICE_TestBSP.in_recording = 0;
+}
+
+uint8_t  BSP_AUDIO_IN_SetFrequency(uint32_t AudioFreq)
+{
+  DEVICE_TestRecord(DEVICE_TEST_IN_SET_FREQUENCY, AudioFreq);
+  DEVICE_TestBSP.in_frequency = AudioFreq;
+  return AUDIO_OK;
+}
+
+uint8_t  BSP_AUDIO_IN_Record(uint16_t *pData, uint32_t Size)
+{
+  (void)pData;
+  (void)Size;
+  DEVICE_TestRecord(DEVICE_TEST_IN_RECORD, DEVICE_TestBSP.in_frequency);
+  DEVICE_TestBSP.in_recording = 1;
+  DEVICE_TestBSP.in_phase = 0;
+  hDmaTopRight.counter = DEVICE_TestBSP.in_scratch_size / AUDIO_MIC_CAPTURE_CHANNEL_COUNT;
+  return AUDIO_OK;
+}
+
+uint8_t  BSP_AUDIO_IN_Stop(void)
+{
+  DEVICE_TestRecord(DEVICE_TEST_IN_STOP, 0);
+  DEVICE_TestBSP.in_recording = 0;
+  return AUDIO_OK;
+}
+
+uint8_t  BSP_AUDIO_IN_Get_PcmBuffer(uint8_t* pbuf, uint16_t sample_count, uint16_t ScratchOffset, uint8_t res)
+{
+  uint32_t frame_size = AUDIO_MIC_CAPTURE_CHANNEL_COUNT * res;
+  double sample_us;
+  uint16_t i;
+
+  (void)ScratchOffset;
+  DEVICE_TestRecord(DEVICE_TEST_IN_GET_PCM, sample_count);
+  /* constant level, the first captured samples can be told from the silence */
+  memset(pbuf, 0x11, (uint32_t)sample_count * frame_size);
+  if(DEVICE_TestBSP.in_step)
+  {
+    /* the block ends now, samples captured before the step are silent */
+    sample_us = 1e6 / ((double)DEVICE_TestBSP.in_frequency * (1.0 + DEVICE_TestBSP.clock_ppm * 1e-6));
+    for(i = 0; i < sample_count; i++)
+    {
+      if(DEVICE_TestBSP.now_us - (sample_count - i) * sample_us < DEVICE_TestBSP.in_step_us)
+      {
+        memset(pbuf + i * frame_size, 0, frame_size);
+      }
+    }
+  }
+  return AUDIO_OK;
+}
+
+/************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
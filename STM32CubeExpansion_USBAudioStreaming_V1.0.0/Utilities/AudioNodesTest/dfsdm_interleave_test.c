@@ -0,0 +1,255 @@
+/**
+  ******************************************************************************
+  * @file    dfsdm_interleave_test.c
+  * @author  MCD Application Team
+  * @brief   host test and microbenchmark of the interleave of the DFSDM
+  *          microphones of the F769 Discovery (BSP_AUDIO_IN_Get_PcmBuffer of
+  *          stm32f769i_discovery_audio_ex.c) : the 4 scratch buffers are
+  *          saturated and interleaved in the channel order of the array,
+  *          16 and 24 bits, 2 and 4 channels, same bytes as a one sample at a
+  *          time reference, no byte written after the frames. The 1 ms blocks
+  *          of 48 KHz and 96 KHz are then timed against the reference. See
+  *          readme.txt.
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2019  STMicroelectronics.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by ST under Ultimate Liberty license
+  * SLA0044, the "License"; You may not use this file except in compliance with
+  * the License. You may obtain a copy of the License at:
+  *                             www.st.com/SLA0044
+  *
+  ******************************************************************************
+  */
+/* Includes ------------------------------------------------------------------*/
+#include <string.h>
+#include "audio_nodes_test.h"
+
+/* Private defines -----------------------------------------------------------*/
+#define TEST_MICS                       4U
+#define TEST_MAX_FRAMES                 96U     /* 1 ms at 96 KHz */
+#define TEST_SCRATCH_SAMPLES            (2U * TEST_MAX_FRAMES)  /* both halves of the DMA buffer */
+#define TEST_MAX_BYTES                  (TEST_MAX_FRAMES * TEST_MICS * 3U)
+#define TEST_GUARD                      0xA5U
+#define TEST_BENCH_RUNS                 200000U
+
+/* Private variables ---------------------------------------------------------*/
+/* scratch buffers of the DFSDM filters : top right, top left, bottom right, bottom left */
+static int32_t  TestScratch[TEST_MICS][TEST_SCRATCH_SAMPLES];
+static int32_t* pScratchBuff[TEST_MICS] = {TestScratch[0], TestScratch[1], TestScratch[2], TestScratch[3]};
+static uint8_t  AudioIn_ChannelNumber;
+
+/* Private functions ---------------------------------------------------------*/
+/**
+  * @brief  TEST_Ssat
+  *         Signed saturation of the Cortex-M SSAT instruction.
+  * @param  value(IN): sample
+  * @param  bits(IN):  bits of the result
+  * @retval saturated sample
+  */
+static inline int32_t  TEST_Ssat(int32_t value, uint32_t bits)
+{
+  int32_t max = (int32_t)((1U << (bits - 1U)) - 1U);
+
+  return (value > max)? max : ((value < -max - 1)? -max - 1 : value);
+}
+#define __SSAT(value, bits)             TEST_Ssat((int32_t)(value), (bits))
+
+/* interleave of the BSP, extracted by the build (see readme.txt) */
+#include "dfsdm_interleave_f769.h"
+
+/**
+  * @brief  TEST_InterleaveSamples
+  *         Reference interleave : one sample saturated and written byte per byte at a time.
+  * @param  pbuf(OUT):          interleaved frames
+  * @param  sample_count(IN):   frames
+  * @param  ScratchOffset(IN):  first sample of the scratch buffers
+  * @param  res(IN):            bytes per sample, 2 or 3
+  * @retval 0
+  */
+static uint8_t  TEST_InterleaveSamples(uint8_t* pbuf, uint16_t sample_count, uint16_t ScratchOffset, uint8_t res)
+{
+  static const uint8_t order[TEST_MICS] = {1, 0, 3, 2};
+  uint32_t i, mic, byte;
+  int32_t sample;
+
+  for(i = ScratchOffset; i < (uint32_t)(ScratchOffset + sample_count); i++)
+  {
+    for(mic = 0; mic < AudioIn_ChannelNumber; mic++)
+    {
+      sample = pScratchBuff[order[mic]][i];
+      sample = (res == 2)? TEST_Ssat(sample >> 8, 16) : TEST_Ssat(sample, 24);
+      for(byte = 0; byte < res; byte++)
+      {
+        *pbuf++ = (uint8_t)((uint32_t)sample >> (8U * byte));
+      }
+    }
+  }
+  return 0;
+}
+
+/* interleaves under test */
+typedef uint8_t (*TEST_Interleave_t)(uint8_t* pbuf, uint16_t sample_count, uint16_t ScratchOffset, uint8_t res);
+static const struct
+{
+  const char*        name;
+  TEST_Interleave_t  interleave;
+} Interleaves[] =
+{
+  {"samples", TEST_InterleaveSamples},
+  {"BSP",     BSP_AUDIO_IN_Get_PcmBuffer},
+};
+
+/**
+  * @brief  TEST_Fill
+  *         Fills the scratch buffers with DFSDM samples of 24 bits and beyond, both signs, the full scale
+  *         values of 16 and 24 bits at the first samples.
+  * @param  None
+  * @retval None
+  */
+static void  TEST_Fill(void)
+{
+  static const int32_t edges[] = {0x7FFFFF, -0x800000, 0x800000, -0x800001, 0x7FFF00, -0x800000 - 0x100,
+                                  0x7FFFFFFF, (int32_t)0x80000000};
+  uint32_t seed = 1U, mic, i;
+
+  for(mic = 0; mic < TEST_MICS; mic++)
+  {
+    for(i = 0; i < TEST_SCRATCH_SAMPLES; i++)
+    {
+      seed = seed * 1103515245U + 12345U;
+      TestScratch[mic][i] = ((int32_t)seed) >> 6;
+    }
+    for(i = 0; i < sizeof(edges)/sizeof(edges[0]); i++)
+    {
+      TestScratch[mic][TEST_MAX_FRAMES + ((i + mic) % TEST_MAX_FRAMES)] = edges[i];
+    }
+  }
+}
+
+/**
+  * @brief  TEST_Interleave
+  *         Checks the interleave of the BSP against the reference for a format, for every frame count up
+  *         to TEST_MAX_FRAMES from both halves of the scratch buffers.
+  * @param  channels(IN): 2 or 4
+  * @param  res(IN):      bytes per sample, 2 or 3
+  * @retval None
+  */
+static void  TEST_Interleave(uint8_t channels, uint8_t res)
+{
+  static uint32_t expected[TEST_MAX_BYTES / 4U + 1U];
+  static uint32_t actual[TEST_MAX_BYTES / 4U + 1U];
+  uint32_t frames, half, bytes, i;
+  uint32_t errors = 0, guard_errors = 0;
+
+  AudioIn_ChannelNumber = channels;
+  for(half = 0; half < 2U; half++)
+  {
+    for(frames = 1; frames <= TEST_MAX_FRAMES; frames++)
+    {
+      bytes = frames * channels * res;
+      memset(actual, TEST_GUARD, sizeof(actual));
+      TEST_InterleaveSamples((uint8_t*)expected, (uint16_t)frames, (uint16_t)(half * TEST_MAX_FRAMES), res);
+      BSP_AUDIO_IN_Get_PcmBuffer((uint8_t*)actual, (uint16_t)frames, (uint16_t)(half * TEST_MAX_FRAMES), res);
+      errors += (memcmp(actual, expected, bytes) != 0);
+      for(i = bytes; i < sizeof(actual); i++)
+      {
+        guard_errors += (((uint8_t*)actual)[i] != TEST_GUARD);
+      }
+    }
+  }
+  TEST_CHECK(errors == 0, "%u channels of %u bits : %u blocks differ from the reference", channels, 8U * res,
+             errors);
+  TEST_CHECK(guard_errors == 0, "%u channels of %u bits : %u bytes written after the frames", channels, 8U * res,
+             guard_errors);
+}
+
+/**
+  * @brief  TEST_ChannelOrder
+  *         Checks the channel order of the frames : top left, top right, bottom left, bottom right.
+  * @param  None
+  * @retval None
+  */
+static void  TEST_ChannelOrder(void)
+{
+  uint32_t frame[3];
+  uint8_t* bytes = (uint8_t*)frame;
+  uint32_t mic;
+
+  /* scratch buffers of the top right, top left, bottom right and bottom left microphones */
+  for(mic = 0; mic < TEST_MICS; mic++)
+  {
+    TestScratch[mic][0] = (int32_t)((mic + 1U) << 8);
+  }
+  AudioIn_ChannelNumber = TEST_MICS;
+  BSP_AUDIO_IN_Get_PcmBuffer(bytes, 1, 0, 2);
+  TEST_CHECK((bytes[0] == 2) && (bytes[2] == 1) && (bytes[4] == 4) && (bytes[6] == 3),
+             "16 bits frame %u %u %u %u", bytes[0], bytes[2], bytes[4], bytes[6]);
+  BSP_AUDIO_IN_Get_PcmBuffer(bytes, 1, 0, 3);
+  TEST_CHECK((bytes[1] == 2) && (bytes[4] == 1) && (bytes[7] == 4) && (bytes[10] == 3),
+             "24 bits frame %u %u %u %u", bytes[1], bytes[4], bytes[7], bytes[10]);
+}
+
+/**
+  * @brief  TEST_InterleaveBench
+  *         Measures the host time of the interleave of a 1 ms block by the BSP and by the reference, for
+  *         the 4 microphones at 48 KHz and 96 KHz, 16 and 24 bits.
+  * @param  None
+  * @retval None
+  */
+static void  TEST_InterleaveBench(void)
+{
+  static uint32_t buffer[TEST_MAX_BYTES / 4U];
+  static const uint16_t frequencies[] = {48U, 96U};
+  static const uint8_t resolutions[] = {2U, 3U};
+  uint32_t f, r, n, k;
+  uint64_t cycles;
+  double start, ns;
+
+  AudioIn_ChannelNumber = TEST_MICS;
+  for(f = 0; f < sizeof(frequencies)/sizeof(frequencies[0]); f++)
+  {
+    for(r = 0; r < sizeof(resolutions)/sizeof(resolutions[0]); r++)
+    {
+      for(k = 0; k < sizeof(Interleaves)/sizeof(Interleaves[0]); k++)
+      {
+        start = TEST_TimeUs();
+        cycles = TEST_Cycles();
+        for(n = 0; n < TEST_BENCH_RUNS; n++)
+        {
+          Interleaves[k].interleave((uint8_t*)buffer, frequencies[f], (uint16_t)((n & 1U) * TEST_MAX_FRAMES),
+                                    resolutions[r]);
+          __asm__ volatile("" : : "r"(buffer) : "memory");
+        }
+        cycles = TEST_Cycles() - cycles;
+        ns = (TEST_TimeUs() - start) * 1000.0 / TEST_BENCH_RUNS;
+        printf("bench interleave %-7s 4 mics %2u KHz %u bits : %7.1f ns per 1 ms block, %5.2f cycles per frame\n",
+               Interleaves[k].name, frequencies[f], 8U * resolutions[r], ns,
+               (double)cycles / ((double)TEST_BENCH_RUNS * frequencies[f]));
+      }
+    }
+  }
+}
+
+/* Exported functions --------------------------------------------------------*/
+/**
+  * @brief  main
+  *         Runs the checks then the benchmark.
+  * @param  None
+  * @retval exit status
+  */
+int  main(void)
+{
+  TEST_Fill();
+  TEST_Interleave(4, 2);
+  TEST_Interleave(2, 2);
+  TEST_Interleave(4, 3);
+  TEST_Interleave(2, 3);
+  TEST_InterleaveBench();
+  TEST_ChannelOrder();
+  return TEST_Report("dfsdm_interleave_test");
+}
+
+/************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
@@ -0,0 +1,179 @@
+/**
+  ******************************************************************************
+  * @file    stm32f769i_discovery_audio_ex.h
+  * @author  MCD Application Team
+  * @brief   mocked audio BSP of the STM32F769I-Discovery for the host tests of
+  *          the board audio devices (audio_speaker_node.c, audio_mic_node.c),
+  *          it replaces the BSP header included by audio_user_devices.h. The
+  *          mocked functions of device_test_bsp.c record the calls of the nodes
+  *          in DEVICE_TestBSP. The HAL definitions read by the nodes are given
+  *          here, the CMSIS ones by usbd_conf.h.
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2019  STMicroelectronics.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by ST under Ultimate Liberty license
+  * SLA0044, the "License"; You may not use this file except in compliance with
+  * the License. You may obtain a copy of the License at:
+  *                             www.st.com/SLA0044
+  *
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __STM32F769I_DISCOVERY_AUDIO_EX_H
+#define __STM32F769I_DISCOVERY_AUDIO_EX_H
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdint.h>
+#include <stdlib.h>
+#include "usbd_conf.h"
+
+/* Exported constants --------------------------------------------------------*/
+/* Audio status definition */
+#define AUDIO_OK                            ((uint8_t)0)
+#define AUDIO_ERROR                         ((uint8_t)1)
+#define AUDIO_TIMEOUT                       ((uint8_t)2)
+/* wm8994.h */
+#define OUTPUT_DEVICE_AUTO                  ((uint16_t)0x0004)
+#define CODEC_PDWN_SW                       2
+#define DEVICE_TEST_CALLS                   64U /* calls kept in the log */
+#define DEVICE_TEST_OUT_SLOTS               2U  /* SAI slots of the codec, data units by frame */
+
+/* Exported types ------------------------------------------------------------*/
+/* stm32f7xx_hal_dma.h, the counter of the stream is the count of data still to transfer */
+typedef struct
+{
+  volatile uint32_t counter;
+  volatile uint32_t tc_flag;
+} DMA_HandleTypeDef;
+
+/* stm32f7xx_hal_sai.h, the size of the transfer is in data units, half-words in 16 bits */
+typedef struct
+{
+  uint16_t           XferSize;
+  DMA_HandleTypeDef* hdmatx;
+} SAI_HandleTypeDef;
+
+/* BSP functions recorded in the call log */
+typedef enum
+{
+  DEVICE_TEST_OUT_INIT,
+  DEVICE_TEST_OUT_DEINIT,
+  DEVICE_TEST_OUT_PLAY,
+  DEVICE_TEST_OUT_CHANGE_BUFFER,
+  DEVICE_TEST_OUT_STOP,
+  DEVICE_TEST_OUT_SET_FREQUENCY,
+  DEVICE_TEST_OUT_SET_MUTE,
+  DEVICE_TEST_OUT_SET_VOLUME,
+  DEVICE_TEST_IN_INIT,
+  DEVICE_TEST_IN_DEINIT,
+  DEVICE_TEST_IN_SET_FREQUENCY,
+  DEVICE_TEST_IN_RECORD,
+  DEVICE_TEST_IN_STOP,
+  DEVICE_TEST_IN_GET_PCM,
+  DEVICE_TEST_CALL_COUNT
+} DEVICE_TestCall_t;
+
+/* a BSP call of the log */
+typedef struct
+{
+  DEVICE_TestCall_t call;
+  uint32_t          arg;   /* frequency, size, mute or volume */
+  uint8_t           isr;   /* called from a DMA interrupt callback */
+  uint8_t           muted; /* codec mute state when the call was made */
+} DEVICE_TestCallLog_t;
+
+/* state of the mocked BSP */
+typedef struct
+{
+  uint32_t             count[DEVICE_TEST_CALL_COUNT];     /* calls of each function */
+  uint32_t             isr_count[DEVICE_TEST_CALL_COUNT]; /* calls of each function from a DMA callback */
+  uint32_t             usb_isr_count[DEVICE_TEST_CALL_COUNT]; /* calls of each function from a USB interrupt */
+  const volatile uint8_t* usb_isr;      /* set by the test to the USB interrupt flag of the mocked PCD */
+  DEVICE_TestCallLog_t log[DEVICE_TEST_CALLS];            /* first calls since the last reset */
+  uint32_t             log_count;
+  uint8_t              isr;             /* set while a DMA callback runs */
+  uint8_t              out_muted;       /* codec output mute */
+  uint8_t              out_volume;      /* codec output volume in percent */
+  uint8_t              out_running;     /* SAI DMA transfer armed */
+  uint8_t              out_res_byte;    /* size of a SAI data unit */
+  uint32_t             out_frequency;
+  uint16_t*            out_data;        /* buffer of the armed transfer */
+  uint32_t             out_size;        /* bytes of the armed transfer */
+  uint8_t              in_recording;    /* DFSDM capture running */
+  uint32_t             in_frequency;
+  uint32_t             in_scratch_size; /* samples of the DMA buffer given by BSP_AUDIO_IN_AllocScratch */
+  uint8_t              in_step;         /* set by the test, microphones silent before in_step_us, else constant */
+  double               in_step_us;      /* time of the step of the captured level */
+  /* time run by DEVICE_TestRunDevices */
+  double               now_us;
+  int32_t              clock_ppm;       /* offset of the codec and microphones clocks */
+  double               out_phase;       /* part of the SAI data unit being played */
+  double               in_phase;        /* part of the DFSDM sample being captured */
+  uint8_t              out_waiting;     /* set by the test, cleared when the first non zero sample is armed */
+  uint32_t             out_silence;     /* bytes of silence armed while out_waiting is set */
+  double               out_first_us;    /* time the first non zero sample is played */
+} DEVICE_TestBSP_t;
+
+/* Exported macro ------------------------------------------------------------*/
+#define __HAL_DMA_GET_COUNTER(hdma)         ((hdma)->counter)
+#define __HAL_DMA_GET_TC_FLAG_INDEX(hdma)   0U
+#define __HAL_DMA_GET_FLAG(hdma, flag)      ((hdma)->tc_flag)
+
+/* Exported variables --------------------------------------------------------*/
+extern DEVICE_TestBSP_t  DEVICE_TestBSP;
+extern SAI_HandleTypeDef haudio_out_sai;
+extern DMA_HandleTypeDef hDmaTopLeft;
+extern DMA_HandleTypeDef hDmaTopRight;
+
+/* Exported functions ------------------------------------------------------- */
+/* audio out */
+uint8_t BSP_AUDIO_OUT_Init_Ext(uint16_t OutputDevice, uint8_t Volume, uint32_t AudioFreq, uint8_t AudioResolution);
+void    BSP_AUDIO_OUT_DeInit(void);
+uint8_t BSP_AUDIO_OUT_Play(uint16_t* pBuffer, uint32_t Size);
+void    BSP_AUDIO_OUT_ChangeBuffer(uint16_t *pData, uint16_t Size);
+void    BSP_AUDIO_OUT_SetDMACircular(uint8_t Circular);
+uint8_t BSP_AUDIO_OUT_Stop(uint32_t Option);
+uint8_t BSP_AUDIO_OUT_SetVolume(uint8_t Volume);
+void    BSP_AUDIO_OUT_SetFrequency(uint32_t AudioFreq);
+uint8_t BSP_AUDIO_OUT_SetMute(uint32_t Cmd);
+void    BSP_AUDIO_OUT_HoldCodecWrites(void);
+uint8_t BSP_AUDIO_OUT_FlushCodecWrites(void);
+void    BSP_AUDIO_OUT_TransferComplete_CallBack(void);
+void    BSP_AUDIO_OUT_HalfTransfer_CallBack(void);
+void    BSP_AUDIO_OUT_Error_CallBack(void);
+int     HAL_SAI_DMAStop(SAI_HandleTypeDef *hsai);
+/* audio in */
+uint8_t BSP_AUDIO_IN_Init(uint32_t AudioFreq, uint32_t BitRes, uint32_t ChnlNbr);
+uint8_t BSP_AUDIO_IN_AllocScratch (int32_t *pScratch, uint32_t size);
+void    BSP_AUDIO_IN_DeInit(void);
+uint8_t BSP_AUDIO_IN_SetFrequency(uint32_t AudioFreq);
+uint8_t BSP_AUDIO_IN_Record(uint16_t *pData, uint32_t Size);
+uint8_t BSP_AUDIO_IN_Stop(void);
+uint8_t BSP_AUDIO_IN_Get_PcmBuffer(uint8_t* pbuf, uint16_t sample_count,
+                                   uint16_t ScratchOffset, uint8_t res);
+void    BSP_AUDIO_IN_TransferComplete_CallBack(void);
+void    BSP_AUDIO_IN_HalfTransfer_CallBack(void);
+/* test helpers */
+void    DEVICE_TestBSPReset(void);
+void    DEVICE_TestOutTransferComplete(void);
+void    DEVICE_TestInHalfTransfer(void);
+void    DEVICE_TestInTransferComplete(void);
+uint8_t DEVICE_TestPendSV(void);
+void    DEVICE_TestRunDevices(uint32_t us);
+int32_t DEVICE_TestFindCall(DEVICE_TestCall_t call, uint32_t from);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* __STM32F769I_DISCOVERY_AUDIO_EX_H */
+
+/************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
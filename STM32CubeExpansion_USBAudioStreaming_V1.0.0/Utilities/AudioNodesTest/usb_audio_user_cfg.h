@@ -0,0 +1,43 @@
+/**
+  ******************************************************************************
+  * @file    usb_audio_user_cfg.h
+  * @author  MCD Application Team
+  * @brief   host configuration of the processing nodes tests, replaces the
+  *          application one : only the nodes and the graph are built.
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2019  STMicroelectronics.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by ST under Ultimate Liberty license
+  * SLA0044, the "License"; You may not use this file except in compliance with
+  * the License. You may obtain a copy of the License at:
+  *                             www.st.com/SLA0044
+  *
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __USB_AUDIO_USER_CFG_H
+#define __USB_AUDIO_USER_CFG_H
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+/* Exported constants --------------------------------------------------------*/
+#define USE_AUDIO_PROCESSING_GRAPH      1
+#define USE_AUDIO_SOFTWARE_VOLUME       1
+#define USE_AUDIO_PLAYBACK_EQ           1
+#define USE_AUDIO_PLAYBACK_LIMITER      1
+#define USE_AUDIO_PLAYBACK_MIXER        1
+#define USE_AUDIO_RECORDING_BEAMFORMER  1
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* __USB_AUDIO_USER_CFG_H */
+
+/************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
@@ -0,0 +1,262 @@
+/**
+  ******************************************************************************
+  * @file    usb_fifo_copy_test.c
+  * @author  MCD Application Team
+  * @brief   host test of the FIFO copy loops of USB_WritePacket and
+  *          USB_ReadPacket (stm32f7xx_ll_usb.c and stm32f4xx_ll_usb.c) over a
+  *          mocked data FIFO : same FIFO words and buffer bytes as the former
+  *          one word at a time loops for every buffer alignment and packet
+  *          length, no byte written outside the packet words, then bytes per
+  *          cycle of the three. See readme.txt.
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2019  STMicroelectronics.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by ST under Ultimate Liberty license
+  * SLA0044, the "License"; You may not use this file except in compliance with
+  * the License. You may obtain a copy of the License at:
+  *                             www.st.com/SLA0044
+  *
+  ******************************************************************************
+  */
+/* Includes ------------------------------------------------------------------*/
+#include <string.h>
+#include "audio_nodes_test.h"
+
+/* Private defines -----------------------------------------------------------*/
+#define TEST_MAX_LENGTH                 1024U   /* largest packet checked, bytes */
+#define TEST_FIFO_WORDS                 ((TEST_MAX_LENGTH + 3U)/4U)
+#define TEST_GUARD                      0xA5U
+#define TEST_BENCH_PACKETS              200000U
+
+/* Private typedef -----------------------------------------------------------*/
+/* the types of the HAL used by the copy loops */
+#define __IO volatile
+typedef enum
+{
+  HAL_OK = 0x00U
+} HAL_StatusTypeDef;
+typedef struct
+{
+  uint32_t GOTGCTL;
+} USB_OTG_GlobalTypeDef;
+
+/* Private variables ---------------------------------------------------------*/
+/* mocked data FIFO : each access to USBx_DFIFO pushes or pops the next word */
+static volatile uint32_t TestFifo[TEST_FIFO_WORDS + 1U];
+static uint32_t TestFifoCursor;
+static USB_OTG_GlobalTypeDef TestUsb;
+
+/* Private macro -------------------------------------------------------------*/
+#define TEST_FIFO(base, i)              TestFifo[((void)(base), (void)(i), TestFifoCursor++)]
+
+/* Private functions ---------------------------------------------------------*/
+/* copy loops of the drivers, extracted by the build (see readme.txt) */
+#define USB_WritePacket                 TEST_WritePacketF7
+#define USB_ReadPacket                  TEST_ReadPacketF7
+#define USBx_DFIFO(i)                   TEST_FIFO(USBx_BASE, i)
+#include "usb_fifo_copy_f7.h"
+#undef USB_WritePacket
+#undef USB_ReadPacket
+#undef USBx_DFIFO
+#define USB_WritePacket                 TEST_WritePacketF4
+#define USB_ReadPacket                  TEST_ReadPacketF4
+#define USBx_DFIFO(i)                   TEST_FIFO(USBx, i)
+#include "usb_fifo_copy_f4.h"
+#undef USB_WritePacket
+#undef USB_ReadPacket
+#undef USBx_DFIFO
+
+/**
+  * @brief  TEST_WritePacketWords
+  *         Former USB_WritePacket loop : one unaligned word load per FIFO word.
+  * @param  USBx(IN):      not used
+  * @param  src(IN):       packet
+  * @param  ch_ep_num(IN): not used
+  * @param  len(IN):       packet size in bytes
+  * @param  dma(IN):       0, the FIFO is written by the CPU
+  * @retval HAL_OK
+  */
+static HAL_StatusTypeDef  TEST_WritePacketWords(USB_OTG_GlobalTypeDef *USBx, uint8_t *src, uint8_t ch_ep_num,
+                                                uint16_t len, uint8_t dma)
+{
+  uint32_t count32b = ((uint32_t)len + 3U) / 4U;
+  uint32_t i, word;
+
+  if (dma == 0U)
+  {
+    for (i = 0U; i < count32b; i++, src += 4U)
+    {
+      memcpy(&word, src, 4U);
+      TEST_FIFO(USBx, ch_ep_num) = word;
+    }
+  }
+  return HAL_OK;
+}
+
+/**
+  * @brief  TEST_ReadPacketWords
+  *         Former USB_ReadPacket loop : one unaligned word store per FIFO word.
+  * @param  USBx(IN): not used
+  * @param  dest(IN): packet
+  * @param  len(IN):  packet size in bytes
+  * @retval end of the words written
+  */
+static void*  TEST_ReadPacketWords(USB_OTG_GlobalTypeDef *USBx, uint8_t *dest, uint16_t len)
+{
+  uint32_t count32b = ((uint32_t)len + 3U) / 4U;
+  uint32_t i, word;
+
+  for (i = 0U; i < count32b; i++, dest += 4U)
+  {
+    word = TEST_FIFO(USBx, 0U);
+    memcpy(dest, &word, 4U);
+  }
+  return ((void *)dest);
+}
+
+/* copy loops under test */
+typedef HAL_StatusTypeDef (*TEST_WritePacket_t)(USB_OTG_GlobalTypeDef *USBx, uint8_t *src, uint8_t ch_ep_num,
+                                                uint16_t len, uint8_t dma);
+typedef void* (*TEST_ReadPacket_t)(USB_OTG_GlobalTypeDef *USBx, uint8_t *dest, uint16_t len);
+static const struct
+{
+  const char*         name;
+  TEST_WritePacket_t  write;
+  TEST_ReadPacket_t   read;
+} Drivers[] =
+{
+  {"words", TEST_WritePacketWords, TEST_ReadPacketWords},
+  {"F7",    TEST_WritePacketF7,    TEST_ReadPacketF7},
+  {"F4",    TEST_WritePacketF4,    TEST_ReadPacketF4},
+};
+
+/**
+  * @brief  TEST_FifoCopy
+  *         Checks the copy loops of a driver against the former loops, for every alignment of the
+  *         buffer and every packet length up to TEST_MAX_LENGTH.
+  * @param  driver(IN): index in Drivers
+  * @retval None
+  */
+static void  TEST_FifoCopy(uint32_t driver)
+{
+  static uint32_t source[TEST_FIFO_WORDS + 2U];
+  static uint32_t dest[TEST_FIFO_WORDS + 4U];
+  uint32_t expected[TEST_FIFO_WORDS];
+  uint8_t* src_bytes = (uint8_t*)source;
+  uint8_t* dest_bytes = (uint8_t*)dest;
+  uint32_t offset, len, words, i;
+  uint32_t write_errors = 0, read_errors = 0, guard_errors = 0, end_errors = 0;
+  void* end;
+
+  for (i = 0U; i < sizeof(source); i++)
+  {
+    src_bytes[i] = (uint8_t)(i * 7U + 1U);
+  }
+  for (offset = 0U; offset < 4U; offset++)
+  {
+    for (len = 0U; len <= TEST_MAX_LENGTH; len++)
+    {
+      words = (len + 3U) / 4U;
+      memcpy(expected, src_bytes + offset, 4U * words);
+
+      /* write : the FIFO gets the words of the packet, the bytes after the last one included */
+      TestFifoCursor = 0U;
+      Drivers[driver].write(&TestUsb, src_bytes + offset, 1U, (uint16_t)len, 0U);
+      write_errors += (TestFifoCursor != words);
+      for (i = 0U; i < words; i++)
+      {
+        write_errors += (TestFifo[i] != expected[i]);
+      }
+
+      /* read : the buffer gets the packet words, the bytes around them are kept */
+      memset(dest, TEST_GUARD, sizeof(dest));
+      TestFifoCursor = 0U;
+      end = Drivers[driver].read(&TestUsb, dest_bytes + 4U + offset, (uint16_t)len);
+      read_errors += (TestFifoCursor != words) || (memcmp(dest_bytes + 4U + offset, expected, 4U * words) != 0);
+      end_errors += (end != (void*)(dest_bytes + 4U + offset + 4U * words));
+      for (i = 0U; i < 4U + offset; i++)
+      {
+        guard_errors += (dest_bytes[i] != TEST_GUARD);
+      }
+      for (i = 4U + offset + 4U * words; i < sizeof(dest); i++)
+      {
+        guard_errors += (dest_bytes[i] != TEST_GUARD);
+      }
+    }
+    TEST_CHECK(write_errors == 0, "%s write, offset %u : %u wrong FIFO words", Drivers[driver].name,
+               (unsigned)offset, (unsigned)write_errors);
+    TEST_CHECK(read_errors == 0, "%s read, offset %u : %u wrong packets", Drivers[driver].name,
+               (unsigned)offset, (unsigned)read_errors);
+    TEST_CHECK(guard_errors == 0, "%s read, offset %u : %u bytes written outside the packet", Drivers[driver].name,
+               (unsigned)offset, (unsigned)guard_errors);
+    TEST_CHECK(end_errors == 0, "%s read, offset %u : %u wrong returned pointers", Drivers[driver].name,
+               (unsigned)offset, (unsigned)end_errors);
+  }
+}
+
+/**
+  * @brief  TEST_FifoCopyBench
+  *         Measures the bytes copied per host cycle by the copy loops of each driver, aligned and
+  *         unaligned, for the packets of 48 KHz stereo 16 bits and 96 KHz 4 channels 16 bits.
+  * @param  None
+  * @retval None
+  */
+static void  TEST_FifoCopyBench(void)
+{
+  static uint32_t buffer[TEST_FIFO_WORDS + 1U];
+  static const uint16_t lengths[] = {196U, 776U};
+  uint64_t start, write_cycles, read_cycles;
+  uint32_t driver, l, offset, n;
+
+  for (l = 0U; l < sizeof(lengths)/sizeof(lengths[0]); l++)
+  {
+    for (offset = 0U; offset < 2U; offset++)
+    {
+      for (driver = 0U; driver < sizeof(Drivers)/sizeof(Drivers[0]); driver++)
+      {
+        start = TEST_Cycles();
+        for (n = 0U; n < TEST_BENCH_PACKETS; n++)
+        {
+          TestFifoCursor = 0U;
+          Drivers[driver].write(&TestUsb, (uint8_t*)buffer + offset, 1U, lengths[l], 0U);
+        }
+        write_cycles = TEST_Cycles() - start;
+        start = TEST_Cycles();
+        for (n = 0U; n < TEST_BENCH_PACKETS; n++)
+        {
+          TestFifoCursor = 0U;
+          Drivers[driver].read(&TestUsb, (uint8_t*)buffer + offset, lengths[l]);
+        }
+        read_cycles = TEST_Cycles() - start;
+        printf("bench fifo copy %-5s %3u bytes %s : write %.2f, read %.2f bytes per cycle\n",
+               Drivers[driver].name, lengths[l], (offset == 0U)? "aligned  " : "unaligned",
+               (double)lengths[l] * TEST_BENCH_PACKETS / (double)write_cycles,
+               (double)lengths[l] * TEST_BENCH_PACKETS / (double)read_cycles);
+      }
+    }
+  }
+}
+
+/* Exported functions --------------------------------------------------------*/
+/**
+  * @brief  main
+  *         Runs the checks then the benchmarks.
+  * @param  None
+  * @retval exit status
+  */
+int  main(void)
+{
+  uint32_t driver;
+
+  for (driver = 0U; driver < sizeof(Drivers)/sizeof(Drivers[0]); driver++)
+  {
+    TEST_FifoCopy(driver);
+  }
+  TEST_FifoCopyBench();
+  return TEST_Report("usb_fifo_copy_test");
+}
+
+/************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
@@ -0,0 +1,115 @@
+/**
+  ******************************************************************************
+  * @file    usbd_conf.h
+  * @author  MCD Application Team
+  * @brief   USB device library configuration of the host tests, the low level
+  *          driver is the mocked PCD of usbd_test_ll.c
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2019  STMicroelectronics.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by ST under Ultimate Liberty license
+  * SLA0044, the "License"; You may not use this file except in compliance with
+  * the License. You may obtain a copy of the License at:
+  *                             www.st.com/SLA0044
+  *
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __USBD_CONF_H
+#define __USBD_CONF_H
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "usb_audio_user_cfg.h"
+
+/* Exported constants --------------------------------------------------------*/
+/* Common Config, as the boards */
+#define USBD_MAX_NUM_INTERFACES               2
+#define USBD_MAX_NUM_CONFIGURATION            1
+#define USBD_MAX_STR_DESC_SIZ                 0x100
+#define USBD_SUPPORT_USER_STRING              0
+#define USBD_SELF_POWERED                     1
+#define USBD_DEBUG_LEVEL                      0
+/* audio data endpoints bypass the core data stage dispatching */
+#define USBD_SUPPORT_ISO_FAST_PATH 1
+/* the profiler, the scheduler and the trace count the nanoseconds of the monotonic clock */
+#define USE_AUDIO_HOST_CLOCK 1
+
+/* Exported macro ------------------------------------------------------------*/
+/* cmsis_gcc.h on the boards */
+#ifndef __ALIGNED
+#define __ALIGNED(x)              __attribute__((aligned(x)))
+#endif /* __ALIGNED */
+#define __STATIC_INLINE           static inline
+#define __CLZ(x)                  ((uint32_t)__builtin_clz(x))
+/* single threaded host : masking the interrupts has no effect */
+#define __get_PRIMASK()           0U
+#define __set_PRIMASK(primask)    ((void)(primask))
+#define __disable_irq()
+/* core_cm7.h on the boards : the PendSV triggered by the scheduler is run by the device tests (device_test_bsp.c) */
+#define __IO                      volatile
+#define __NVIC_PRIO_BITS          4U
+#define PendSV_IRQn               (-2)
+#define SCB_ICSR_PENDSVSET_Msk    (1UL << 28U)
+#define SCB                       (&TEST_SCB)
+#define NVIC_SetPriority(irq, priority) ((void)(irq), (void)(priority))
+
+/* Memory management macros */
+#define USBD_malloc               malloc
+#define USBD_free                 free
+#define USBD_memset               memset
+#define USBD_memcpy               memcpy
+
+/* DEBUG macros */
+#define USBD_UsrLog(...)
+#define USBD_ErrLog(...)
+#define USBD_DbgLog(...)
+
+/* OTG registers read by the audio class (hal_usb_ex.h on the boards), given by the mocked PCD */
+#define USB_SOF_NUMBER()                                             (USBD_TestLL.sof_number)
+#define IS_ISO_IN_INCOMPLETE_EP(ep_addr, current_sof, transmit_soffn) 0
+#define USB_CLEAR_INCOMPLETE_IN_EP(ep_addr)
+
+/* Exported types ------------------------------------------------------------*/
+typedef struct
+{
+  volatile uint32_t ICSR;
+} SCB_Type;
+
+/* Exported variables --------------------------------------------------------*/
+extern SCB_Type TEST_SCB;
+
+/* Exported functions ------------------------------------------------------- */
+void USBD_error_handler(void);
+
+/**
+  * @brief  __RBIT
+  *         cmsis_gcc.h on the boards : reverses the bit order of a word.
+  * @param  value(IN): word
+  * @retval reversed word
+  */
+static inline uint32_t __RBIT(uint32_t value)
+{
+  uint32_t result = 0;
+  uint32_t i;
+
+  for(i = 0; i < 32U; i++)
+  {
+    result = (result << 1) | ((value >> i) & 1U);
+  }
+  return result;
+}
+
+/* the mocked PCD state */
+#include "usbd_test_ll.h"
+
+#endif /* __USBD_CONF_H */
+
+/************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
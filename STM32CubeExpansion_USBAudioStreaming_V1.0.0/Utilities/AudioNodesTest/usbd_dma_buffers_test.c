@@ -0,0 +1,312 @@
+/**
+  ******************************************************************************
+  * @file    usbd_dma_buffers_test.c
+  * @author  MCD Application Team
+  * @brief   host test of the buffers handed to the OTG DMA by the audio class
+  *          and the USB streaming nodes (audio_usb_nodes.c) over the mocked
+  *          PCD : buffers aligned, OUT buffers on their own cache lines, memory
+  *          owned by a transfer not written by the CPU until it completes,
+  *          while graph nodes process the received samples in place and the
+  *          class handles SOF and control requests. See readme.txt.
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2019  STMicroelectronics.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by ST under Ultimate Liberty license
+  * SLA0044, the "License"; You may not use this file except in compliance with
+  * the License. You may obtain a copy of the License at:
+  *                             www.st.com/SLA0044
+  *
+  ******************************************************************************
+  */
+/* Includes ------------------------------------------------------------------*/
+#include "audio_nodes_test.h"
+#include "usbd_core.h"
+#include "usbd_audio.h"
+#include "usb_audio.h"
+#include "audio_usb_nodes.h"
+#include "audio_profiler.h"
+
+/* Private defines -----------------------------------------------------------*/
+#define TEST_PLAY_EP                    USBD_AUDIO_CONFIG_PLAY_EP_OUT
+#define TEST_RECORD_EP                  USB_AUDIO_CONFIG_RECORD_EP_IN
+#define TEST_PACKET_SIZE                192U     /* 1 ms at 48 KHz, stereo, 16 bits */
+#define TEST_PLAY_MARGIN                (4U * TEST_PACKET_SIZE)
+#define TEST_PACKETS                    200U
+#define TEST_VOLUME_USB                 0xF600U  /* -10 dB */
+
+/* Private variables ---------------------------------------------------------*/
+static USBD_HandleTypeDef Device;
+static AUDIO_Session_t PlaySession, RecordSession;
+static AUDIO_Description_t PlayDescription, RecordDescription;
+static AUDIO_USBInputOutputNode_t PlayNode, RecordNode;
+static AUDIO_USB_CF_NodeTypeDef PlayFeatureNode;
+static AUDIO_CircularBuffer_t PlayRing, RecordRing;
+static uint8_t PlayRingData[USB_AUDIO_CONFIG_PLAY_BUFFER_SIZE] __ALIGNED(32);
+static uint8_t RecordRingData[USB_AUDIO_CONFIG_RECORD_BUFFER_SIZE] __ALIGNED(32);
+static uint32_t Errors;
+
+/* Private functions ---------------------------------------------------------*/
+/**
+  * @brief  Error_Handler
+  *         Counts the errors reported by the streaming nodes.
+  * @param  None
+  * @retval None
+  */
+void  Error_Handler(void)
+{
+  Errors++;
+}
+
+/* implicit synchronization of the recording session, no sample added nor removed */
+int8_t  USB_AudioRecordingSynchronizationGetSamplesCountToAddInNextPckt(struct AUDIO_Session* session_handle)
+{
+  (void)session_handle;
+  return 0;
+}
+
+int8_t  USB_AudioRecordingSynchronizationNotificationSamplesRead(struct AUDIO_Session* session_handle, uint16_t bytes)
+{
+  (void)session_handle;
+  (void)bytes;
+  return 0;
+}
+
+/**
+  * @brief  TEST_SetAlternate
+  *         Starts the streaming nodes on the alternate setting 1, as the USB sessions.
+  * @param  alternate(IN):    alternate setting
+  * @param  private_data(IN): streaming node
+  * @retval 0
+  */
+static int8_t  TEST_SetAlternate(uint8_t alternate, uint32_t private_data)
+{
+  AUDIO_USBInputOutputNode_t* node = (AUDIO_USBInputOutputNode_t*)private_data;
+
+  if(alternate == 0)
+  {
+    return node->IOStop(private_data);
+  }
+  return node->IOStart((node == &PlayNode)? &PlayRing : &RecordRing, TEST_PACKET_SIZE, private_data);
+}
+
+/**
+  * @brief  TEST_GetState
+  *         Reports a running interface.
+  * @param  private_data(IN): not used
+  * @retval 0
+  */
+static int8_t  TEST_GetState(uint32_t private_data)
+{
+  (void)private_data;
+  return 0;
+}
+
+/**
+  * @brief  TEST_Init
+  *         Describes the playback and recording streaming interfaces and the playback feature unit with the
+  *         streaming nodes, as usbd_audio_if.c.
+  * @param  function(OUT):    audio function
+  * @param  private_data(IN): not used
+  * @retval 0
+  */
+static int8_t  TEST_Init(USBD_AUDIO_FunctionDescriptionfTypeDef* function, uint32_t private_data)
+{
+  AUDIO_USBFeatureUnitDefaults_t defaults;
+  USBD_AUDIO_AS_InterfaceTypeDef* as_interface;
+
+  (void)private_data;
+  memset(function, 0, sizeof(*function));
+  PlayDescription.frequency = RecordDescription.frequency = USB_AUDIO_CONFIG_FREQ_48_K;
+  PlayDescription.channels_count = RecordDescription.channels_count = 2;
+  PlayDescription.resolution = RecordDescription.resolution = 2;
+  USB_AudioStreamingInitializeDataBuffer(&PlayRing, sizeof(PlayRingData), TEST_PACKET_SIZE, TEST_PLAY_MARGIN);
+  PlayRing.data = PlayRingData;
+  USB_AudioStreamingInitializeDataBuffer(&RecordRing, sizeof(RecordRingData) / 2U, TEST_PACKET_SIZE, 0);
+  RecordRing.data = RecordRingData;
+
+  function->as_interfaces_count = 2;
+  as_interface = &function->as_interfaces[0];
+  as_interface->interface_num = USBD_AUDIO_CONFIG_PLAY_SA_INTERFACE;
+  as_interface->max_alternate = 1;
+  as_interface->SetAS_Alternate = TEST_SetAlternate;
+  as_interface->GetState = TEST_GetState;
+  as_interface->private_data = (uint32_t)&PlayNode;
+  USB_AudioStreamingInputInit(&as_interface->data_ep, &PlayDescription, &PlaySession, (uint32_t)&PlayNode);
+  as_interface = &function->as_interfaces[1];
+  as_interface->interface_num = USBD_AUDIO_CONFIG_RECORD_SA_INTERFACE;
+  as_interface->max_alternate = 1;
+  as_interface->SetAS_Alternate = TEST_SetAlternate;
+  as_interface->GetState = TEST_GetState;
+  as_interface->private_data = (uint32_t)&RecordNode;
+  USB_AudioStreamingOutputInit(&as_interface->data_ep, &RecordDescription, &RecordSession, (uint32_t)&RecordNode);
+
+  function->control_count = 1;
+  defaults.max_volume = 0;
+  defaults.min_volume = -96 * 256;
+  defaults.res_volume = 256;
+  defaults.audio_description = &PlayDescription;
+  USB_AudioStreamingFeatureUnitInit(&function->controls[0], &defaults, USB_AUDIO_CONFIG_PLAY_UNIT_FEATURE_ID,
+                                    (uint32_t)&PlayFeatureNode);
+  return 0;
+}
+
+/**
+  * @brief  TEST_DeInit
+  *         Releases the audio function, nothing to do.
+  * @param  function(IN):     audio function
+  * @param  private_data(IN): not used
+  * @retval 0
+  */
+static int8_t  TEST_DeInit(USBD_AUDIO_FunctionDescriptionfTypeDef* function, uint32_t private_data)
+{
+  (void)function;
+  (void)private_data;
+  return 0;
+}
+
+static USBD_AUDIO_InterfaceCallbacksfTypeDef TestInterface =
+{
+  TEST_Init,
+  TEST_DeInit,
+  NULL,
+  TEST_GetState,
+  0
+};
+
+/**
+  * @brief  TEST_Stream
+  *         One millisecond of streaming : an SOF, the recording packet sent, a playback packet received. While
+  *         the transfers are pending the graph processes the received samples in place and the microphone
+  *         writes the next block, as the sessions do.
+  * @param  packet(IN): packet index
+  * @retval None
+  */
+static void  TEST_Stream(uint32_t packet)
+{
+  static uint8_t data[TEST_PACKET_SIZE + 4U];
+  uint16_t size = (uint16_t)(TEST_PACKET_SIZE + (((packet % 3U) == 1U)? 4U : 0U) - (((packet % 3U) == 2U)? 4U : 0U));
+  uint16_t wr_ptr = PlayRing.wr_ptr;
+  uint16_t i;
+
+  /* in place processing of the samples received and not yet consumed, then consumed */
+  for(i = PlayRing.rd_ptr; i != PlayRing.wr_ptr; i = (uint16_t)((i + 1U) % PlayRing.size))
+  {
+    PlayRingData[i] ^= 0x5AU;
+  }
+  PlayRing.rd_ptr = PlayRing.wr_ptr;
+  /* microphone block written after the samples sent to the host */
+  for(i = 0; i < TEST_PACKET_SIZE; i++)
+  {
+    RecordRingData[(RecordRing.wr_ptr + i) % RecordRing.size] = (uint8_t)(packet + i);
+  }
+  RecordRing.wr_ptr = (uint16_t)((RecordRing.wr_ptr + TEST_PACKET_SIZE) % RecordRing.size);
+
+  USBD_TestLL.sof_number++;
+  Device.pClass->SOF(&Device);
+  USBD_TestDataIn(&Device, TEST_RECORD_EP);
+  for(i = 0; i < size; i++)
+  {
+    data[i] = (uint8_t)(packet * 7U + i);
+  }
+  USBD_TestDataOutPacket(&Device, TEST_PLAY_EP, data, size);
+  TEST_CHECK(memcmp(PlayRingData + wr_ptr, data, size) == 0, "packet %u not written at %u in the ring", packet,
+             wr_ptr);
+}
+
+/**
+  * @brief  TEST_DmaBuffers
+  *         Streams both directions then sends volume requests to the feature unit while streaming, and
+  *         checks the OTG DMA rules of the mocked PCD.
+  * @param  None
+  * @retval None
+  */
+static void  TEST_DmaBuffers(void)
+{
+  static const uint8_t volume[2] = {LOBYTE(TEST_VOLUME_USB), HIBYTE(TEST_VOLUME_USB)};
+  uint16_t feature_index = (uint16_t)(USB_AUDIO_CONFIG_PLAY_UNIT_FEATURE_ID << 8);
+  uint16_t volume_value = (uint16_t)(USBD_AUDIO_CONTROL_FEATURE_UNIT_VOLUME << 8);
+  uint8_t* control_buffer;
+  uint32_t packet = 0;
+
+  TEST_CHECK(AUDIO_ProfilerInit() == 0, "profiler clock not started");
+  USBD_LL_Init(&Device);
+  memset(&Device, 0, sizeof(Device));
+  Device.pClass = &USBD_AUDIO;
+  Device.pUserData = &TestInterface;
+  Device.dev_state = USBD_STATE_CONFIGURED;
+  Device.ep_in[0].maxpacket = Device.ep_out[0].maxpacket = USB_MAX_EP0_SIZE;
+  Device.pClass->Init(&Device, 0);
+  USBD_TestSetup(&Device, 0x01, USB_REQ_SET_INTERFACE, 1, USBD_AUDIO_CONFIG_PLAY_SA_INTERFACE, 0);
+  USBD_TestSetup(&Device, 0x01, USB_REQ_SET_INTERFACE, 1, USBD_AUDIO_CONFIG_RECORD_SA_INTERFACE, 0);
+  TEST_CHECK(USBD_TestLL.out[TEST_PLAY_EP].buf && USBD_TestLL.in[TEST_RECORD_EP & 0x0FU].buf,
+             "streaming endpoints not armed");
+
+  for(; packet < TEST_PACKETS; packet++)
+  {
+    TEST_Stream(packet);
+  }
+
+  /* SET_CUR volume : the data stage is received while the class handles SOF and data packets */
+  USBD_TestSetup(&Device, 0x21, USBD_AUDIO_REQ_SET_CUR, volume_value, feature_index, 2);
+  control_buffer = USBD_TestLL.out[0].buf;
+  TEST_CHECK((control_buffer != NULL) && (USBD_TestLL.out[0].size == 2), "SET_CUR data stage not armed");
+  TEST_Stream(packet++);
+  TEST_Stream(packet++);
+  USBD_TestDataOutPacket(&Device, 0x00, volume, 2);
+  USBD_TestDataIn(&Device, 0x80);
+  TEST_CHECK(PlayDescription.audio_volume_db_256 == -10 * 256, "SET_CUR volume %d dB/256 instead of %d",
+             PlayDescription.audio_volume_db_256, -10 * 256);
+
+  /* GET_CUR volume : the buffer sent keeps its value until the transfer completes */
+  USBD_TestSetup(&Device, 0xA1, USBD_AUDIO_REQ_GET_CUR, volume_value, feature_index, 2);
+  TEST_CHECK((USBD_TestLL.in[0].buf == control_buffer) && (USBD_TestLL.in[0].size == 2) &&
+             (memcmp(control_buffer, volume, 2) == 0), "GET_CUR volume not sent from the control buffer");
+  TEST_Stream(packet++);
+  USBD_TestDataIn(&Device, 0x80);
+  USBD_TestDataOut(&Device, 0x00, 0);
+
+  /* GET_INTERFACE */
+  USBD_TestSetup(&Device, 0x81, USB_REQ_GET_INTERFACE, 0, USBD_AUDIO_CONFIG_PLAY_SA_INTERFACE, 1);
+  TEST_CHECK((USBD_TestLL.in[0].buf == control_buffer) && (control_buffer[0] == 1),
+             "GET_INTERFACE not sent from the control buffer");
+  TEST_Stream(packet++);
+  USBD_TestDataIn(&Device, 0x80);
+  USBD_TestDataOut(&Device, 0x00, 0);
+
+  TEST_CHECK(((uintptr_t)control_buffer % USBD_TEST_CACHE_LINE_SIZE) == 0, "control buffer not on a cache line");
+  TEST_CHECK(USBD_TestLL.out[TEST_PLAY_EP].transfers == packet + 1U, "%u playback transfers for %u packets",
+             USBD_TestLL.out[TEST_PLAY_EP].transfers, packet);
+  TEST_CHECK(USBD_TestLL.dma_unaligned == 0, "%u buffers not aligned for the OTG DMA", USBD_TestLL.dma_unaligned);
+  TEST_CHECK(USBD_TestLL.dma_overwritten == 0, "%u transfers had their memory written by the CPU",
+             USBD_TestLL.dma_overwritten);
+  TEST_CHECK(USBD_TestLL.dma_rearmed == 0, "%u transfers armed on a busy endpoint", USBD_TestLL.dma_rearmed);
+  TEST_CHECK((USBD_TestLL.errors == 0) && (USBD_TestLL.stalls == 0) && (Errors == 0),
+             "%u class errors, %u stalls, %u node errors", USBD_TestLL.errors, USBD_TestLL.stalls, Errors);
+
+  /* the class probes, timed by the host clock backend of the profiler */
+  TEST_CHECK(AUDIO_ProfilerGetStats(AUDIO_PROFILER_USB_SOF)->count == packet, "%u SOF measured for %u packets",
+             AUDIO_ProfilerGetStats(AUDIO_PROFILER_USB_SOF)->count, packet);
+  TEST_CHECK(AUDIO_ProfilerGetStats(AUDIO_PROFILER_USB_DATA_OUT)->count >= packet, "%u data out measured for %u packets",
+             AUDIO_ProfilerGetStats(AUDIO_PROFILER_USB_DATA_OUT)->count, packet);
+  TEST_CHECK(AUDIO_ProfilerGetStats(AUDIO_PROFILER_USB_DATA_IN)->count >= packet, "%u data in measured for %u packets",
+             AUDIO_ProfilerGetStats(AUDIO_PROFILER_USB_DATA_IN)->count, packet);
+  printf("profiler mean ns : SOF %u, data out %u, data in %u\n", AUDIO_ProfilerGetMeanCycles(AUDIO_PROFILER_USB_SOF),
+         AUDIO_ProfilerGetMeanCycles(AUDIO_PROFILER_USB_DATA_OUT), AUDIO_ProfilerGetMeanCycles(AUDIO_PROFILER_USB_DATA_IN));
+}
+
+/**
+  * @brief  main
+  *         Runs the checks.
+  * @param  None
+  * @retval exit status
+  */
+int  main(void)
+{
+  TEST_DmaBuffers();
+  return TEST_Report("usbd_dma_buffers_test");
+}
+
+/************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
@@ -0,0 +1,328 @@
+/**
+  ******************************************************************************
+  * @file    usbd_fast_path_test.c
+  * @author  MCD Application Team
+  * @brief   host test of the isochronous fast path of the device core
+  *          (usbd_core_ex.c) with the audio class over the mocked PCD :
+  *          endpoints bound on the alternate setting and unbound on close and
+  *          bus reset, same packets through the fast path and the class
+  *          dispatching, then cycles per packet of both. See readme.txt.
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2019  STMicroelectronics.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by ST under Ultimate Liberty license
+  * SLA0044, the "License"; You may not use this file except in compliance with
+  * the License. You may obtain a copy of the License at:
+  *                             www.st.com/SLA0044
+  *
+  ******************************************************************************
+  */
+/* Includes ------------------------------------------------------------------*/
+#include "audio_nodes_test.h"
+#include "usbd_core.h"
+#include "usbd_core_ex.h"
+#include "usbd_audio.h"
+
+/* Private defines -----------------------------------------------------------*/
+#define TEST_PLAY_INTERFACE             1U
+#define TEST_RECORD_INTERFACE           2U
+#define TEST_PLAY_EP                    0x01U
+#define TEST_RECORD_EP                  0x81U
+#define TEST_PACKET_SIZE                192U     /* 1 ms at 48 KHz, stereo, 16 bits */
+#define TEST_MAX_PACKET                 196U     /* one more frame */
+#define TEST_CHECK_PACKETS              16U
+#define TEST_BENCH_PACKETS              1000000U
+
+/* Private variables ---------------------------------------------------------*/
+static USBD_HandleTypeDef Device;
+static uint8_t PlayBuffers[2][TEST_MAX_PACKET];
+static uint8_t RecordBuffers[2][TEST_MAX_PACKET];
+static uint8_t PlayIndex, RecordIndex;
+static uint32_t Received, ReceivedBytes, Sent;
+
+/* Private functions ---------------------------------------------------------*/
+/**
+  * @brief  TEST_DataReceived
+  *         Counts a packet received by the playback interface.
+  * @param  data_len(IN):     packet size
+  * @param  private_data(IN): not used
+  * @retval 0
+  */
+static int8_t  TEST_DataReceived(uint16_t data_len, uint32_t private_data)
+{
+  (void)private_data;
+  Received++;
+  ReceivedBytes += data_len;
+  PlayIndex ^= 1U;
+  return 0;
+}
+
+/**
+  * @brief  TEST_PlayGetBuffer
+  *         Gives the next playback packet buffer, two buffers are used in turn.
+  * @param  private_data(IN):   not used
+  * @param  packet_length(OUT): buffer size
+  * @retval buffer
+  */
+static uint8_t*  TEST_PlayGetBuffer(uint32_t private_data, uint16_t* packet_length)
+{
+  (void)private_data;
+  *packet_length = TEST_MAX_PACKET;
+  return PlayBuffers[PlayIndex];
+}
+
+/**
+  * @brief  TEST_RecordGetBuffer
+  *         Gives the next recording packet, two buffers are used in turn.
+  * @param  private_data(IN):   not used
+  * @param  packet_length(OUT): packet size
+  * @retval packet
+  */
+static uint8_t*  TEST_RecordGetBuffer(uint32_t private_data, uint16_t* packet_length)
+{
+  (void)private_data;
+  Sent++;
+  RecordIndex ^= 1U;
+  *packet_length = TEST_PACKET_SIZE;
+  return RecordBuffers[RecordIndex];
+}
+
+/**
+  * @brief  TEST_GetMaxPacketLength
+  *         Gives the max packet size of both endpoints.
+  * @param  private_data(IN): not used
+  * @retval max packet size
+  */
+static uint16_t  TEST_GetMaxPacketLength(uint32_t private_data)
+{
+  (void)private_data;
+  return TEST_MAX_PACKET;
+}
+
+/**
+  * @brief  TEST_SetAlternate
+  *         Accepts any alternate setting.
+  * @param  alternate(IN):    alternate setting
+  * @param  private_data(IN): not used
+  * @retval 0
+  */
+static int8_t  TEST_SetAlternate(uint8_t alternate, uint32_t private_data)
+{
+  (void)alternate;
+  (void)private_data;
+  return 0;
+}
+
+/**
+  * @brief  TEST_GetState
+  *         Reports a running interface.
+  * @param  private_data(IN): not used
+  * @retval 0
+  */
+static int8_t  TEST_GetState(uint32_t private_data)
+{
+  (void)private_data;
+  return 0;
+}
+
+/**
+  * @brief  TEST_Init
+  *         Describes a playback and a recording streaming interface, as usbd_audio_if.c.
+  * @param  function(OUT):    audio function
+  * @param  private_data(IN): not used
+  * @retval 0
+  */
+static int8_t  TEST_Init(USBD_AUDIO_FunctionDescriptionfTypeDef* function, uint32_t private_data)
+{
+  USBD_AUDIO_AS_InterfaceTypeDef* as_interface;
+
+  (void)private_data;
+  function->control_count = 0;
+  function->as_interfaces_count = 2;
+  for(uint32_t i = 0; i < 2U; i++)
+  {
+    as_interface = &function->as_interfaces[i];
+    as_interface->interface_num = (i == 0)? TEST_PLAY_INTERFACE : TEST_RECORD_INTERFACE;
+    as_interface->max_alternate = 1;
+    as_interface->data_ep.ep_num = (i == 0)? TEST_PLAY_EP : TEST_RECORD_EP;
+    as_interface->data_ep.DataReceived = TEST_DataReceived;
+    as_interface->data_ep.GetBuffer = (i == 0)? TEST_PlayGetBuffer : TEST_RecordGetBuffer;
+    as_interface->data_ep.GetMaxPacketLength = TEST_GetMaxPacketLength;
+    as_interface->data_ep.GetState = TEST_GetState;
+    as_interface->SetAS_Alternate = TEST_SetAlternate;
+    as_interface->GetState = TEST_GetState;
+  }
+  return 0;
+}
+
+/**
+  * @brief  TEST_DeInit
+  *         Releases the audio function, nothing to do.
+  * @param  function(IN):     audio function
+  * @param  private_data(IN): not used
+  * @retval 0
+  */
+static int8_t  TEST_DeInit(USBD_AUDIO_FunctionDescriptionfTypeDef* function, uint32_t private_data)
+{
+  (void)function;
+  (void)private_data;
+  return 0;
+}
+
+static USBD_AUDIO_InterfaceCallbacksfTypeDef TestInterface =
+{
+  TEST_Init,
+  TEST_DeInit,
+  NULL,
+  TEST_GetState,
+  0
+};
+
+/**
+  * @brief  TEST_FastPathConfigure
+  *         Configures the device and selects the streaming alternate settings.
+  * @param  None
+  * @retval None
+  */
+static void  TEST_FastPathConfigure(void)
+{
+  USBD_LL_Init(&Device);
+  memset(&Device, 0, sizeof(Device));
+  PlayIndex = RecordIndex = 0;
+  Device.pClass = &USBD_AUDIO;
+  Device.pUserData = &TestInterface;
+  Device.dev_state = USBD_STATE_CONFIGURED;
+  Device.pClass->Init(&Device, 0);
+  USBD_TestSetup(&Device, 0x01, USB_REQ_SET_INTERFACE, 1, TEST_PLAY_INTERFACE, 0);
+  USBD_TestSetup(&Device, 0x01, USB_REQ_SET_INTERFACE, 1, TEST_RECORD_INTERFACE, 0);
+}
+
+/**
+  * @brief  TEST_FastPathStream
+  *         Completes packets on both endpoints and checks that each reaches the interface and re-arms the
+  *         endpoint with the next buffer.
+  * @param  name(IN): dispatching name
+  * @retval None
+  */
+static void  TEST_FastPathStream(const char* name)
+{
+  for(uint32_t i = 0; i < TEST_CHECK_PACKETS; i++)
+  {
+    Received = ReceivedBytes = Sent = 0;
+    USBD_TestDataOut(&Device, TEST_PLAY_EP, TEST_PACKET_SIZE - (i & 1U) * 4U);
+    TEST_CHECK((Received == 1) && (ReceivedBytes == TEST_PACKET_SIZE - (i & 1U) * 4U),
+               "%s packet %u received %u times, %u bytes", name, i, Received, ReceivedBytes);
+    TEST_CHECK((USBD_TestLL.out[TEST_PLAY_EP].buf == PlayBuffers[PlayIndex]) &&
+               (USBD_TestLL.out[TEST_PLAY_EP].size == TEST_MAX_PACKET), "%s OUT endpoint not re-armed", name);
+    USBD_TestDataIn(&Device, TEST_RECORD_EP);
+    TEST_CHECK((Sent == 1) && (USBD_TestLL.in[TEST_RECORD_EP & 0x0FU].buf == RecordBuffers[RecordIndex]) &&
+               (USBD_TestLL.in[TEST_RECORD_EP & 0x0FU].size == TEST_PACKET_SIZE),
+               "%s IN endpoint not re-armed with the next packet", name);
+  }
+  TEST_CHECK(USBD_TestLL.errors == 0, "%s : %u class errors", name, USBD_TestLL.errors);
+}
+
+/**
+  * @brief  TEST_FastPathBinding
+  *         Packets go the same way through the fast path and the class dispatching, the endpoints are unbound
+  *         by the alternate setting 0 and by a bus reset.
+  * @param  None
+  * @retval None
+  */
+static void  TEST_FastPathBinding(void)
+{
+  TEST_FastPathConfigure();
+  TEST_CHECK(USBD_TestLL.out[TEST_PLAY_EP].open && (USBD_TestLL.out[TEST_PLAY_EP].mps == TEST_MAX_PACKET) &&
+             (USBD_TestLL.out[TEST_PLAY_EP].buf == PlayBuffers[0]), "OUT endpoint not opened and armed");
+  TEST_CHECK(USBD_TestLL.in[TEST_RECORD_EP & 0x0FU].open && (USBD_TestLL.in[TEST_RECORD_EP & 0x0FU].buf != NULL),
+             "IN endpoint not opened and armed");
+  TEST_FastPathStream("fast path");
+
+  /* the same endpoints through the class DataOut and DataIn */
+  USBD_LL_UnRegisterIsoFastPath(&Device, TEST_PLAY_EP);
+  USBD_LL_UnRegisterIsoFastPath(&Device, TEST_RECORD_EP);
+  TEST_FastPathStream("class");
+
+  /* closing the interfaces unbinds the endpoints, reopening binds them again */
+  TEST_FastPathConfigure();
+  USBD_TestSetup(&Device, 0x01, USB_REQ_SET_INTERFACE, 0, TEST_PLAY_INTERFACE, 0);
+  TEST_CHECK(!USBD_TestLL.out[TEST_PLAY_EP].open, "OUT endpoint not closed");
+  USBD_TestSetup(&Device, 0x01, USB_REQ_SET_INTERFACE, 1, TEST_PLAY_INTERFACE, 0);
+  TEST_FastPathStream("reopened");
+
+  /* after a bus reset the class is gone, a late transfer complete must not reach the interface */
+  USBD_LL_Reset(&Device);
+  Received = Sent = 0;
+  USBD_TestDataOut(&Device, TEST_PLAY_EP, TEST_PACKET_SIZE);
+  USBD_TestDataIn(&Device, TEST_RECORD_EP);
+  TEST_CHECK((Received == 0) && (Sent == 0), "packets dispatched after a bus reset");
+}
+
+/**
+  * @brief  TEST_FastPathBenchOne
+  *         Completes TEST_BENCH_PACKETS packets on an endpoint and prints the host cycles per packet, from the
+  *         PCD data stage callback to the re-armed endpoint.
+  * @param  name(IN):    benchmark name
+  * @param  ep_addr(IN): endpoint
+  * @retval cycles per packet
+  */
+static double  TEST_FastPathBenchOne(const char* name, uint8_t ep_addr)
+{
+  uint64_t start, elapsed;
+
+  start = TEST_Cycles();
+  for(uint32_t i = 0; i < TEST_BENCH_PACKETS; i++)
+  {
+    if(ep_addr & 0x80U)
+    {
+      USBD_TestDataIn(&Device, ep_addr);
+    }
+    else
+    {
+      USBD_TestDataOut(&Device, ep_addr, TEST_PACKET_SIZE);
+    }
+  }
+  elapsed = TEST_Cycles() - start;
+  printf("bench %-36s %8.1f cycles/packet\n", name, (double)elapsed / TEST_BENCH_PACKETS);
+  return (double)elapsed / TEST_BENCH_PACKETS;
+}
+
+/**
+  * @brief  TEST_FastPathBench
+  *         Cycles per packet through the fast path and the class dispatching, the interface callbacks being
+  *         trivial the difference is the dispatching.
+  * @param  None
+  * @retval None
+  */
+static void  TEST_FastPathBench(void)
+{
+  double fast_out, fast_in, class_out, class_in;
+
+  TEST_FastPathConfigure();
+  fast_out = TEST_FastPathBenchOne("OUT packet fast path", TEST_PLAY_EP);
+  fast_in = TEST_FastPathBenchOne("IN packet fast path", TEST_RECORD_EP);
+  USBD_LL_UnRegisterIsoFastPath(&Device, TEST_PLAY_EP);
+  USBD_LL_UnRegisterIsoFastPath(&Device, TEST_RECORD_EP);
+  class_out = TEST_FastPathBenchOne("OUT packet class dispatching", TEST_PLAY_EP);
+  class_in = TEST_FastPathBenchOne("IN packet class dispatching", TEST_RECORD_EP);
+  printf("fast path : %.0f %% of the OUT and %.0f %% of the IN class dispatching cycles\n",
+         100.0 * fast_out / class_out, 100.0 * fast_in / class_in);
+}
+
+/**
+  * @brief  main
+  *         Runs the checks then the benchmarks.
+  * @param  None
+  * @retval exit status
+  */
+int  main(void)
+{
+  TEST_FastPathBinding();
+  TEST_FastPathBench();
+  return TEST_Report("usbd_fast_path_test");
+}
+
+/************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
@@ -0,0 +1,250 @@
+/**
+  ******************************************************************************
+  * @file    usbd_feature_unit_test.c
+  * @author  MCD Application Team
+  * @brief   host test of the channel controls of the feature unit nodes
+  *          (audio_usb_nodes.c) through the audio class over the mocked PCD :
+  *          a stereo unit, as the playback one, and a 4 channels unit, as the
+  *          recording one of the microphone array. Each unit accepts the
+  *          mute and volume requests of the master channel and of the
+  *          channels of its cluster, the class stalls the requests to the
+  *          channels beyond it and the unit keeps its state. See readme.txt.
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2019  STMicroelectronics.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by ST under Ultimate Liberty license
+  * SLA0044, the "License"; You may not use this file except in compliance with
+  * the License. You may obtain a copy of the License at:
+  *                             www.st.com/SLA0044
+  *
+  ******************************************************************************
+  */
+/* Includes ------------------------------------------------------------------*/
+#include "audio_nodes_test.h"
+#include "usbd_core.h"
+#include "usbd_audio.h"
+#include "usb_audio.h"
+#include "audio_usb_nodes.h"
+
+#if AUDIO_USB_CF_CHANNEL_COUNT < 4
+#error "the test needs the channel controls of the software volume"
+#endif /* AUDIO_USB_CF_CHANNEL_COUNT < 4 */
+
+/* Private defines -----------------------------------------------------------*/
+#define TEST_STEREO_ID                  USB_AUDIO_CONFIG_PLAY_UNIT_FEATURE_ID
+#define TEST_ARRAY_ID                   USB_AUDIO_CONFIG_RECORD_UNIT_FEATURE_ID
+#define TEST_VOLUME_USB                 0xFB00U  /* -5 dB */
+
+/* Private variables ---------------------------------------------------------*/
+static USBD_HandleTypeDef Device;
+static AUDIO_Description_t StereoDescription, ArrayDescription;
+static AUDIO_USB_CF_NodeTypeDef StereoNode, ArrayNode;
+static uint32_t Errors;
+
+/* Private functions ---------------------------------------------------------*/
+/**
+  * @brief  Error_Handler
+  *         Counts the errors reported by the nodes.
+  * @param  None
+  * @retval None
+  */
+void  Error_Handler(void)
+{
+  Errors++;
+}
+
+/* implicit synchronization of the recording session, not streamed by the test */
+int8_t  USB_AudioRecordingSynchronizationGetSamplesCountToAddInNextPckt(struct AUDIO_Session* session_handle)
+{
+  (void)session_handle;
+  return 0;
+}
+
+int8_t  USB_AudioRecordingSynchronizationNotificationSamplesRead(struct AUDIO_Session* session_handle, uint16_t bytes)
+{
+  (void)session_handle;
+  (void)bytes;
+  return 0;
+}
+
+/**
+  * @brief  TEST_Init
+  *         Describes the stereo and the 4 channels feature units, without streaming interface.
+  * @param  function(OUT):    audio function
+  * @param  private_data(IN): not used
+  * @retval 0
+  */
+static int8_t  TEST_Init(USBD_AUDIO_FunctionDescriptionfTypeDef* function, uint32_t private_data)
+{
+  AUDIO_USBFeatureUnitDefaults_t defaults;
+
+  (void)private_data;
+  memset(function, 0, sizeof(*function));
+  StereoDescription.channels_count = 2;
+  ArrayDescription.channels_count = 4;
+  defaults.max_volume = 0;
+  defaults.min_volume = -96 * 256;
+  defaults.res_volume = 256;
+  function->control_count = 2;
+  defaults.audio_description = &StereoDescription;
+  USB_AudioStreamingFeatureUnitInit(&function->controls[0], &defaults, TEST_STEREO_ID, (uint32_t)&StereoNode);
+  defaults.audio_description = &ArrayDescription;
+  USB_AudioStreamingFeatureUnitInit(&function->controls[1], &defaults, TEST_ARRAY_ID, (uint32_t)&ArrayNode);
+  return 0;
+}
+
+/**
+  * @brief  TEST_DeInit
+  *         Releases the audio function, nothing to do.
+  * @param  function(IN):     audio function
+  * @param  private_data(IN): not used
+  * @retval 0
+  */
+static int8_t  TEST_DeInit(USBD_AUDIO_FunctionDescriptionfTypeDef* function, uint32_t private_data)
+{
+  (void)function;
+  (void)private_data;
+  return 0;
+}
+
+/**
+  * @brief  TEST_GetState
+  *         Reports a running interface.
+  * @param  private_data(IN): not used
+  * @retval 0
+  */
+static int8_t  TEST_GetState(uint32_t private_data)
+{
+  (void)private_data;
+  return 0;
+}
+
+static USBD_AUDIO_InterfaceCallbacksfTypeDef TestInterface =
+{
+  TEST_Init,
+  TEST_DeInit,
+  NULL,
+  TEST_GetState,
+  0
+};
+
+/**
+  * @brief  TEST_Get
+  *         GET_CUR request of the host to a channel of a unit, with its data and status stages when accepted.
+  * @param  unit_id(IN):  feature unit
+  * @param  control(IN):  USBD_AUDIO_FU_MUTE_CONTROL or USBD_AUDIO_FU_VOLUME_CONTROL
+  * @param  channel(IN):  logical channel, 0 for the master channel
+  * @retval 1 if the request is stalled
+  */
+static uint8_t  TEST_Get(uint8_t unit_id, uint8_t control, uint8_t channel)
+{
+  uint32_t stalls = USBD_TestLL.stalls;
+  uint16_t length = (control == USBD_AUDIO_FU_MUTE_CONTROL)? 1 : 2;
+
+  USBD_TestSetup(&Device, 0xA1, USBD_AUDIO_REQ_GET_CUR, (uint16_t)((control << 8) | channel),
+                 (uint16_t)(unit_id << 8), length);
+  if(USBD_TestLL.stalls != stalls)
+  {
+    return 1;
+  }
+  USBD_TestDataIn(&Device, 0x80);
+  USBD_TestDataOut(&Device, 0x00, 0);
+  return 0;
+}
+
+/**
+  * @brief  TEST_Set
+  *         SET_CUR request of the host to a channel of a unit : setup, data and status stages.
+  * @param  unit_id(IN):  feature unit
+  * @param  control(IN):  USBD_AUDIO_FU_MUTE_CONTROL or USBD_AUDIO_FU_VOLUME_CONTROL
+  * @param  channel(IN):  logical channel, 0 for the master channel
+  * @param  value(IN):    mute or volume on USB format
+  * @retval None
+  */
+static void  TEST_Set(uint8_t unit_id, uint8_t control, uint8_t channel, uint16_t value)
+{
+  uint8_t data[2] = {LOBYTE(value), HIBYTE(value)};
+  uint16_t length = (control == USBD_AUDIO_FU_MUTE_CONTROL)? 1 : 2;
+
+  USBD_TestSetup(&Device, 0x21, USBD_AUDIO_REQ_SET_CUR, (uint16_t)((control << 8) | channel),
+                 (uint16_t)(unit_id << 8), length);
+  USBD_TestDataOutPacket(&Device, 0x00, data, length);
+  USBD_TestDataIn(&Device, 0x80);
+}
+
+/**
+  * @brief  TEST_Unit
+  *         Requests of the channels of a unit then of the 2 channels beyond its cluster.
+  * @param  name(IN):     trace
+  * @param  unit_id(IN):  feature unit
+  * @param  node(IN):     feature unit node
+  * @param  channels(IN): channels of the cluster
+  * @retval None
+  */
+static void  TEST_Unit(const char* name, uint8_t unit_id, AUDIO_USB_CF_NodeTypeDef* node, uint8_t channels)
+{
+  AUDIO_USB_CF_NodeTypeDef state;
+  uint8_t channel;
+
+  TEST_CHECK(node->channel_count == channels, "%s : %u channels with controls, %u in the cluster", name,
+             node->channel_count, channels);
+  for(channel = 0; channel <= channels; channel++)
+  {
+    TEST_CHECK(!TEST_Get(unit_id, USBD_AUDIO_FU_MUTE_CONTROL, channel), "%s : GET_CUR mute of channel %u stalled",
+               name, channel);
+    TEST_CHECK(!TEST_Get(unit_id, USBD_AUDIO_FU_VOLUME_CONTROL, channel),
+               "%s : GET_CUR volume of channel %u stalled", name, channel);
+    TEST_Set(unit_id, USBD_AUDIO_FU_MUTE_CONTROL, channel, 1);
+    TEST_Set(unit_id, USBD_AUDIO_FU_VOLUME_CONTROL, channel, TEST_VOLUME_USB);
+    if(channel > 0)
+    {
+      TEST_CHECK(node->channel_mute[channel - 1] && (node->channel_volume_db_256[channel - 1] == -5 * 256),
+                 "%s : SET_CUR of channel %u not stored", name, channel);
+    }
+  }
+  TEST_CHECK(node->node.audio_description->audio_mute &&
+             (node->node.audio_description->audio_volume_db_256 == -5 * 256),
+             "%s : SET_CUR of the master channel not stored", name);
+
+  state = *node;
+  for(channel = channels + 1; channel <= channels + 2; channel++)
+  {
+    TEST_CHECK(TEST_Get(unit_id, USBD_AUDIO_FU_MUTE_CONTROL, channel), "%s : GET_CUR mute of channel %u accepted",
+               name, channel);
+    TEST_CHECK(TEST_Get(unit_id, USBD_AUDIO_FU_VOLUME_CONTROL, channel),
+               "%s : GET_CUR volume of channel %u accepted", name, channel);
+    TEST_Set(unit_id, USBD_AUDIO_FU_MUTE_CONTROL, channel, 1);
+    TEST_Set(unit_id, USBD_AUDIO_FU_VOLUME_CONTROL, channel, TEST_VOLUME_USB);
+  }
+  TEST_CHECK(memcmp(&state, node, sizeof(state)) == 0, "%s : SET_CUR beyond channel %u changed the unit", name,
+             channels);
+}
+
+/* Exported functions --------------------------------------------------------*/
+/**
+  * @brief  main
+  *         Configures the audio function then checks both units.
+  * @param  None
+  * @retval exit status
+  */
+int  main(void)
+{
+  USBD_LL_Init(&Device);
+  memset(&Device, 0, sizeof(Device));
+  Device.pClass = &USBD_AUDIO;
+  Device.pUserData = &TestInterface;
+  Device.dev_state = USBD_STATE_CONFIGURED;
+  Device.ep_in[0].maxpacket = Device.ep_out[0].maxpacket = USB_MAX_EP0_SIZE;
+  Device.pClass->Init(&Device, 0);
+
+  TEST_Unit("stereo unit", TEST_STEREO_ID, &StereoNode, 2);
+  TEST_Unit("4 channels unit", TEST_ARRAY_ID, &ArrayNode, 4);
+  TEST_CHECK((USBD_TestLL.errors == 0) && (Errors == 0), "%u class errors, %u node errors", USBD_TestLL.errors,
+             Errors);
+  return TEST_Report("usbd_feature_unit_test");
+}
+
+/************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
@@ -0,0 +1,271 @@
+/**
+  ******************************************************************************
+  * @file    usbd_fifo_plan_test.c
+  * @author  MCD Application Team
+  * @brief   host test of the OTG FIFO planner of the device core
+  *          (USBD_LL_PlanFifo of usbd_core_ex.c) : the endpoint sets of the
+  *          shipped configurations of both boards and of multichannel
+  *          recordings fit the FIFO RAM, isochronous packets are double
+  *          buffered when the words are available. See readme.txt.
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2019  STMicroelectronics.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by ST under Ultimate Liberty license
+  * SLA0044, the "License"; You may not use this file except in compliance with
+  * the License. You may obtain a copy of the License at:
+  *                             www.st.com/SLA0044
+  *
+  ******************************************************************************
+  */
+/* Includes ------------------------------------------------------------------*/
+#include <string.h>
+#include "audio_nodes_test.h"
+#include "usbd_core.h"
+#include "usbd_core_ex.h"
+#include "usbd_audio.h"
+
+/* Private defines -----------------------------------------------------------*/
+#define TEST_FS_FIFO_WORD_SIZE          320U  /* USB_FIFO_WORD_SIZE of usb_audio.h with USE_USB_FS */
+#define TEST_F769_OUT_EP_COUNT          8U    /* USBD_FIFO_OUT_EP_COUNT of the board usbd_conf.c */
+#define TEST_F446_OUT_EP_COUNT          6U
+
+/* Private typedef -----------------------------------------------------------*/
+/* a configuration, as set by the SW4STM32 project defines and the board usb_audio_user_cfg.h */
+typedef struct
+{
+  const char* name;
+  uint8_t     out_ep_count;
+  uint8_t     play;           /* USE_USB_AUDIO_PLAYBACK, with USE_AUDIO_PLAYBACK_USB_FEEDBACK */
+  uint32_t    play_freq;
+  uint8_t     play_channels;
+  uint8_t     play_res_byte;
+  uint8_t     record;         /* USE_USB_AUDIO_RECORDING, with USE_AUDIO_RECORDING_USB_NO_REMOVE */
+  uint32_t    record_freq;
+  uint8_t     record_channels;
+  uint8_t     record_res_byte;
+  uint8_t     fits;           /* 0 when one packet per endpoint doesn't fit */
+} TEST_FifoConfig_t;
+
+/* Private variables ---------------------------------------------------------*/
+/* ADV, PLAY, REC and DUM projects of both boards : 48 KHz stereo 16 bits. The DUM project defines
+   USE_AUDIO_RECORDING_24_BIT, which the shipped usb_audio_user_cfg.h doesn't read */
+static const TEST_FifoConfig_t Configs[] =
+{
+  {"F769 ADV",                 TEST_F769_OUT_EP_COUNT, 1, 48000, 2, 2, 1, 48000, 2, 2, 1},
+  {"F769 PLAY",                TEST_F769_OUT_EP_COUNT, 1, 48000, 2, 2, 0,     0, 0, 0, 1},
+  {"F769 REC",                 TEST_F769_OUT_EP_COUNT, 0,     0, 0, 0, 1, 48000, 2, 2, 1},
+  {"F769 DUM",                 TEST_F769_OUT_EP_COUNT, 0,     0, 0, 0, 1, 48000, 2, 2, 1},
+  {"F446 ADV",                 TEST_F446_OUT_EP_COUNT, 1, 48000, 2, 2, 1, 48000, 2, 2, 1},
+  {"F446 PLAY",                TEST_F446_OUT_EP_COUNT, 1, 48000, 2, 2, 0,     0, 0, 0, 1},
+  {"F446 REC",                 TEST_F446_OUT_EP_COUNT, 0,     0, 0, 0, 1, 48000, 2, 2, 1},
+  {"F446 DUM",                 TEST_F446_OUT_EP_COUNT, 0,     0, 0, 0, 1, 48000, 2, 2, 1},
+  /* the four microphones of the F769 Discovery */
+  {"F769 REC 4x16 bits 96 KHz", TEST_F769_OUT_EP_COUNT, 0,     0, 0, 0, 1, 96000, 4, 2, 1},
+  {"F769 ADV 4x16 bits 96 KHz", TEST_F769_OUT_EP_COUNT, 1, 48000, 2, 2, 1, 96000, 4, 2, 1},
+  {"F769 ADV 4x24 bits 48 KHz", TEST_F769_OUT_EP_COUNT, 1, 48000, 2, 2, 1, 48000, 4, 3, 1},
+  /* larger than the full speed FIFO RAM */
+  {"F769 ADV 2x24 bits 96 KHz", TEST_F769_OUT_EP_COUNT, 1, 96000, 2, 3, 1, 96000, 2, 3, 0},
+  {"F769 ADV 4x24 bits 96 KHz", TEST_F769_OUT_EP_COUNT, 1, 48000, 2, 2, 1, 96000, 4, 3, 0},
+};
+
+/* Private functions ---------------------------------------------------------*/
+/**
+  * @brief  TEST_MaxPacket
+  *         Computes the full speed max packet size of a stream, one frame more than 1 ms.
+  * @param  freq(IN):     frequency
+  * @param  channels(IN): channel count
+  * @param  res_byte(IN): bytes per sample
+  * @retval max packet size
+  */
+static uint16_t  TEST_MaxPacket(uint32_t freq, uint8_t channels, uint8_t res_byte)
+{
+  return (uint16_t)(((freq + 1U + 999U)/1000U)*channels*res_byte);
+}
+
+/**
+  * @brief  TEST_ConfigDescriptorSize
+  *         Computes the configuration descriptor size as usbd_audio_10_config_descriptors.c, one
+  *         frequency per stream and no sidetone.
+  * @param  config(IN): configuration
+  * @retval size in bytes
+  */
+static uint16_t  TEST_ConfigDescriptorSize(const TEST_FifoConfig_t* config)
+{
+  uint16_t size = 0x09 + USBD_AUDIO_STANDARD_INTERFACE_DESC_SIZE +
+                  USBD_AUDIO_AC_CS_INTERFACE_DESC_SIZE(config->play + config->record);
+  uint16_t as_size = 2*USBD_AUDIO_STANDARD_INTERFACE_DESC_SIZE + USBD_AUDIO_AS_CS_INTERFACE_DESC_SIZE +
+                     USBD_USBD_AUDIO_FORMAT_TYPE_I_DESC_SIZE(1) + USBD_AUDIO_STANDARD_ENDPOINT_DESC_SIZE +
+                     USBD_AUDIO_SPECIFIC_DATA_ENDPOINT_DESC_SIZE;
+
+  if(config->play)
+  {
+    size += USBD_AUDIO_INPUT_TERMINAL_DESC_SIZE + USBD_AUDIO_FEATURE_UNIT_DESC_SIZE(2, 1) +
+            USBD_AUDIO_OUTPUT_TERMINAL_DESC_SIZE + as_size + 0x09 /* feedback endpoint */;
+  }
+  if(config->record)
+  {
+    size += USBD_AUDIO_INPUT_TERMINAL_DESC_SIZE + USBD_AUDIO_FEATURE_UNIT_DESC_SIZE(config->record_channels, 1) +
+            USBD_AUDIO_OUTPUT_TERMINAL_DESC_SIZE + as_size;
+  }
+  return size;
+}
+
+/**
+  * @brief  TEST_FifoRequest
+  *         Fills the request of a configuration as USBD_LL_Setup_Fifo of the board usbd_conf.c.
+  * @param  config(IN):   configuration
+  * @param  request(OUT): request
+  * @retval recording IN endpoint number, 0 without recording
+  */
+static uint8_t  TEST_FifoRequest(const TEST_FifoConfig_t* config, USBD_FifoRequestTypeDef* request)
+{
+  /* usb_audio.h : the recording endpoint follows the feedback endpoint */
+  uint8_t record_ep = (config->play)? 2U : 1U;
+
+  memset(request, 0, sizeof(*request));
+  request->fifo_word_size = TEST_FS_FIFO_WORD_SIZE;
+  request->out_ep_count = config->out_ep_count;
+  request->out_mps[0] = USB_MAX_EP0_SIZE;
+  request->in_mps[0] = USB_MAX_EP0_SIZE;
+  request->ep0_burst_size = TEST_ConfigDescriptorSize(config);
+  if(config->play)
+  {
+    request->out_mps[1] = TEST_MaxPacket(config->play_freq, config->play_channels, config->play_res_byte);
+    request->out_iso |= 1U << 1;
+    request->in_mps[1] = AUDIO_FEEDBACK_EP_PACKET_SIZE;
+    request->in_iso |= 1U << 1;
+  }
+  if(config->record)
+  {
+    request->in_mps[record_ep] = TEST_MaxPacket(config->record_freq, config->record_channels,
+                                                config->record_res_byte);
+    request->in_iso |= 1U << record_ep;
+    request->stream_in_ep = record_ep;
+    return record_ep;
+  }
+  return 0;
+}
+
+/**
+  * @brief  TEST_FifoConfig
+  *         Plans the FIFO of a configuration and checks the layout : sum of the FIFO sizes, one packet
+  *         per endpoint, double buffering of the isochronous packets and EP0 burst when they fit.
+  * @param  config(IN): configuration
+  * @retval None
+  */
+static void  TEST_FifoConfig(const TEST_FifoConfig_t* config)
+{
+  USBD_FifoRequestTypeDef request;
+  USBD_FifoPlanTypeDef plan;
+  uint8_t record_ep = TEST_FifoRequest(config, &request);
+  uint16_t play_words = USBD_FIFO_PACKET_WORD_SIZE(request.out_mps[1]);
+  uint16_t record_words = USBD_FIFO_PACKET_WORD_SIZE(request.in_mps[record_ep]);
+  uint16_t ep0_words = USBD_FIFO_PACKET_WORD_SIZE(request.ep0_burst_size);
+  uint32_t rx_min, min_size, total;
+  uint32_t i;
+
+  if(USBD_LL_PlanFifo(&request, &plan) != USBD_OK)
+  {
+    TEST_CHECK(!config->fits, "%s : minimal layout doesn't fit", config->name);
+    return;
+  }
+  TEST_CHECK(config->fits, "%s : planned though it doesn't fit", config->name);
+
+  /* one packet per endpoint, the RX FIFO holds the largest OUT packet */
+  rx_min = USBD_FIFO_RX_FIXED_WORD_SIZE + (((play_words > 16U)? play_words : 16U) + 1U) + 2U*config->out_ep_count;
+  TEST_CHECK(plan.rx_word_size >= rx_min, "%s : RX FIFO %u < %u", config->name, plan.rx_word_size, (unsigned)rx_min);
+  TEST_CHECK(plan.tx_fifo_count == ((record_ep != 0)? record_ep + 1U : (config->play)? 2U : 1U),
+             "%s : %u TX FIFOs", config->name, plan.tx_fifo_count);
+  min_size = rx_min;
+  total = plan.rx_word_size;
+  for(i = 0; i < plan.tx_fifo_count; i++)
+  {
+    TEST_CHECK(plan.tx_word_size[i] >= USBD_FIFO_TX_EP_MIN_WORD_SIZE, "%s : TX FIFO %u of %u words", config->name,
+               (unsigned)i, plan.tx_word_size[i]);
+    TEST_CHECK(plan.tx_word_size[i] >= USBD_FIFO_PACKET_WORD_SIZE(request.in_mps[i]),
+               "%s : TX FIFO %u smaller than a packet", config->name, (unsigned)i);
+    min_size += (i == record_ep)? ((record_words > 16U)? record_words : 16U) : 16U;
+    total += plan.tx_word_size[i];
+  }
+  TEST_CHECK(total == TEST_FS_FIFO_WORD_SIZE, "%s : %u words planned", config->name, (unsigned)total);
+
+  /* double buffering when the words are available, in the planner order */
+  if((record_ep != 0) && (min_size + record_words <= TEST_FS_FIFO_WORD_SIZE))
+  {
+    min_size += record_words;
+    TEST_CHECK(plan.tx_word_size[record_ep] >= 2U*record_words, "%s : recording packets not double buffered",
+               config->name);
+  }
+  if(config->play && (min_size + play_words + 1U <= TEST_FS_FIFO_WORD_SIZE))
+  {
+    min_size += play_words + 1U;
+    TEST_CHECK(plan.rx_word_size >= rx_min + play_words + 1U, "%s : playback packets not double buffered",
+               config->name);
+  }
+  if(min_size + ep0_words - 16U <= TEST_FS_FIFO_WORD_SIZE)
+  {
+    TEST_CHECK(plan.tx_word_size[0] >= ep0_words, "%s : configuration descriptor of %u bytes not in EP0 FIFO",
+               config->name, request.ep0_burst_size);
+  }
+
+  printf("plan %-26s : RX %3u, TX", config->name, plan.rx_word_size);
+  for(i = 0; i < plan.tx_fifo_count; i++)
+  {
+    printf(" %3u", plan.tx_word_size[i]);
+  }
+  printf(" words, packets OUT %u IN %u bytes\n", request.out_mps[1],
+         (record_ep != 0)? request.in_mps[record_ep] : 0U);
+}
+
+/**
+  * @brief  TEST_FifoErrors
+  *         Checks the requests the planner rejects.
+  * @param  None
+  * @retval None
+  */
+static void  TEST_FifoErrors(void)
+{
+  USBD_FifoRequestTypeDef request;
+  USBD_FifoPlanTypeDef plan;
+
+  /* streaming endpoint not in the endpoint set */
+  TEST_FifoRequest(&Configs[0], &request);
+  request.stream_in_ep = 5;
+  TEST_CHECK(USBD_LL_PlanFifo(&request, &plan) == USBD_FAIL, "stream endpoint without packet accepted");
+
+  /* the RX FIFO alone exceeds the FIFO RAM */
+  TEST_FifoRequest(&Configs[1], &request);
+  request.out_mps[1] = 1023;
+  request.fifo_word_size = 256;
+  TEST_CHECK(USBD_LL_PlanFifo(&request, &plan) == USBD_FAIL, "RX FIFO larger than the FIFO RAM accepted");
+
+  /* a playback only plan gives the remaining words to the RX FIFO */
+  TEST_FifoRequest(&Configs[1], &request);
+  TEST_CHECK(USBD_LL_PlanFifo(&request, &plan) == USBD_OK, "playback plan");
+  TEST_CHECK(plan.rx_word_size + plan.tx_word_size[0] + plan.tx_word_size[1] == TEST_FS_FIFO_WORD_SIZE &&
+             plan.tx_word_size[1] == USBD_FIFO_TX_EP_MIN_WORD_SIZE, "playback remaining words not in RX FIFO");
+}
+
+/* Exported functions --------------------------------------------------------*/
+/**
+  * @brief  main
+  *         Runs the checks.
+  * @param  None
+  * @retval exit status
+  */
+int  main(void)
+{
+  uint32_t i;
+
+  for(i = 0; i < sizeof(Configs)/sizeof(Configs[0]); i++)
+  {
+    TEST_FifoConfig(&Configs[i]);
+  }
+  TEST_FifoErrors();
+  return TEST_Report("usbd_fifo_plan_test");
+}
+
+/************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
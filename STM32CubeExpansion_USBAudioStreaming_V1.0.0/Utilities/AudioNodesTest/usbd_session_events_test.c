@@ -0,0 +1,228 @@
+/**
+  ******************************************************************************
+  * @file    usbd_session_events_test.c
+  * @author  MCD Application Team
+  * @brief   host test of the session events mask on the packet path of the USB
+  *          input node (audio_usb_nodes.c) : events sent only when the session
+  *          subscribed to them, then host cycles per packet of the node with
+  *          the playback session mask and with a session handling every event
+  *          as before the mask. See readme.txt.
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2019  STMicroelectronics.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by ST under Ultimate Liberty license
+  * SLA0044, the "License"; You may not use this file except in compliance with
+  * the License. You may obtain a copy of the License at:
+  *                             www.st.com/SLA0044
+  *
+  ******************************************************************************
+  */
+/* Includes ------------------------------------------------------------------*/
+#include "audio_nodes_test.h"
+#include "usbd_core.h"
+#include "usbd_audio.h"
+#include "usb_audio.h"
+#include "audio_usb_nodes.h"
+
+/* Private defines -----------------------------------------------------------*/
+#define TEST_PACKET_SIZE                192U     /* 1 ms at 48 KHz, stereo, 16 bits */
+#define TEST_PACKETS                    100U
+#define TEST_BENCH_PACKETS              1000000U
+#define TEST_BENCH_RUNS                 5U       /* the fastest run is kept */
+#define TEST_HS_STREAMS                 4U       /* streams of the HS projection */
+#define TEST_HS_PACKETS_PER_S           8000U    /* one packet per microframe */
+/* events of the playback session, see audio_usb_playback_session.c */
+#define TEST_PLAYBACK_EVENTS            (AUDIO_SESSION_EVENT_MASK(AUDIO_THRESHOLD_REACHED)|\
+                                         AUDIO_SESSION_EVENT_MASK(AUDIO_FREQUENCY_CHANGED)|\
+                                         AUDIO_SESSION_EVENT_MASK(AUDIO_OVERRUN)|AUDIO_SESSION_EVENT_MASK(AUDIO_UNDERRUN))
+#define TEST_ALL_EVENTS                 0xFFFFFFFFU
+
+/* Private variables ---------------------------------------------------------*/
+static AUDIO_Session_t Session;
+static AUDIO_Description_t Description;
+static AUDIO_USBInputOutputNode_t InputNode;
+static USBD_AUDIO_EP_DataTypeDef DataEp;
+static AUDIO_CircularBuffer_t Ring;
+static uint8_t RingData[USB_AUDIO_CONFIG_PLAY_BUFFER_SIZE] __ALIGNED(32);
+static volatile uint32_t EventCount[AUDIO_FREQUENCY_CHANGED + 1];
+static uint32_t Errors;
+
+/* Private functions ---------------------------------------------------------*/
+/**
+  * @brief  Error_Handler
+  *         Counts the errors reported by the streaming nodes.
+  * @param  None
+  * @retval None
+  */
+void  Error_Handler(void)
+{
+  Errors++;
+}
+
+/* implicit synchronization of the recording session, not used by the input node */
+int8_t  USB_AudioRecordingSynchronizationGetSamplesCountToAddInNextPckt(struct AUDIO_Session* session_handle)
+{
+  (void)session_handle;
+  return 0;
+}
+
+int8_t  USB_AudioRecordingSynchronizationNotificationSamplesRead(struct AUDIO_Session* session_handle, uint16_t bytes)
+{
+  (void)session_handle;
+  (void)bytes;
+  return 0;
+}
+
+/**
+  * @brief  TEST_SessionCallback
+  *         Counts the events received, as cheap as the playback session callback which does nothing
+  *         for the packets.
+  * @param  event(IN):          event
+  * @param  node_handle(IN):    node sending the event
+  * @param  session_handle(IN): session
+  * @retval 0
+  */
+static int8_t  TEST_SessionCallback(AUDIO_SessionEvent_t event, AUDIO_Node_t* node_handle,
+                                    struct AUDIO_Session* session_handle)
+{
+  (void)node_handle;
+  (void)session_handle;
+  EventCount[event]++;
+  return 0;
+}
+
+/**
+  * @brief  TEST_Start
+  *         Starts the input node on an empty ring, for a session handling the events of a mask.
+  * @param  events_mask(IN): events handled by the session
+  * @retval None
+  */
+static void  TEST_Start(uint32_t events_mask)
+{
+  Session.SessionCallback = TEST_SessionCallback;
+  Session.events_mask = events_mask;
+  memset((void*)EventCount, 0, sizeof(EventCount));
+  InputNode.IOStop((uint32_t)&InputNode);
+  InputNode.IOStart(&Ring, TEST_PACKET_SIZE, (uint32_t)&InputNode);
+}
+
+/**
+  * @brief  TEST_Packet
+  *         Receives a packet as the class : the node gives the buffer, then is told the packet is received.
+  *         The samples are then consumed, as the speaker does.
+  * @param  None
+  * @retval None
+  */
+static void  TEST_Packet(void)
+{
+  uint16_t max_length;
+
+  DataEp.GetBuffer(DataEp.private_data, &max_length);
+  DataEp.DataReceived(TEST_PACKET_SIZE, DataEp.private_data);
+  Ring.rd_ptr = Ring.wr_ptr;
+}
+
+/**
+  * @brief  TEST_Events
+  *         Events sent to a session with the playback mask and to a session handling every event.
+  * @param  None
+  * @retval None
+  */
+static void  TEST_Events(void)
+{
+  uint32_t i;
+
+  TEST_Start(TEST_PLAYBACK_EVENTS);
+  for(i = 0; i < TEST_PACKETS; i++)
+  {
+    TEST_Packet();
+  }
+  TEST_CHECK(EventCount[AUDIO_THRESHOLD_REACHED] == 1, "playback mask : threshold reached %u times",
+             EventCount[AUDIO_THRESHOLD_REACHED]);
+  TEST_CHECK((EventCount[AUDIO_PACKET_RECEIVED] == 0) && (EventCount[AUDIO_BEGIN_OF_STREAM] == 0),
+             "playback mask : %u packets received, %u begin of stream sent", EventCount[AUDIO_PACKET_RECEIVED],
+             EventCount[AUDIO_BEGIN_OF_STREAM]);
+
+  TEST_Start(TEST_ALL_EVENTS);
+  for(i = 0; i < TEST_PACKETS; i++)
+  {
+    TEST_Packet();
+  }
+  /* first packet : begin of stream, second : threshold, then a packet received event per packet */
+  TEST_CHECK((EventCount[AUDIO_BEGIN_OF_STREAM] == 1) && (EventCount[AUDIO_THRESHOLD_REACHED] == 1),
+             "all events : %u begin of stream, %u threshold reached", EventCount[AUDIO_BEGIN_OF_STREAM],
+             EventCount[AUDIO_THRESHOLD_REACHED]);
+  TEST_CHECK(EventCount[AUDIO_PACKET_RECEIVED] == TEST_PACKETS - 2U, "all events : %u packets received for %u",
+             EventCount[AUDIO_PACKET_RECEIVED], TEST_PACKETS - 2U);
+  TEST_CHECK(EventCount[AUDIO_OVERRUN] == 0, "%u overruns", EventCount[AUDIO_OVERRUN]);
+}
+
+/**
+  * @brief  TEST_CyclesPerPacket
+  *         Measures the host cycles per packet of the input node for a session events mask.
+  * @param  events_mask(IN): events handled by the session
+  * @retval cycles per packet of the fastest run
+  */
+static double  TEST_CyclesPerPacket(uint32_t events_mask)
+{
+  uint64_t start, cycles, best = UINT64_MAX;
+  uint32_t run, n;
+
+  for(run = 0; run < TEST_BENCH_RUNS; run++)
+  {
+    TEST_Start(events_mask);
+    start = TEST_Cycles();
+    for(n = 0; n < TEST_BENCH_PACKETS; n++)
+    {
+      TEST_Packet();
+    }
+    cycles = TEST_Cycles() - start;
+    best = (cycles < best)? cycles : best;
+  }
+  return (double)best / TEST_BENCH_PACKETS;
+}
+
+/**
+  * @brief  TEST_EventsBench
+  *         Prints the cycles per packet of the node with the playback mask and when every event is
+  *         dispatched, and the saving for streams at the HS microframe rate.
+  * @param  None
+  * @retval None
+  */
+static void  TEST_EventsBench(void)
+{
+  double masked = TEST_CyclesPerPacket(TEST_PLAYBACK_EVENTS);
+  double all = TEST_CyclesPerPacket(TEST_ALL_EVENTS);
+
+  printf("bench session events : %.1f cycles per packet with the playback mask, %.1f when every event is "
+         "dispatched, %.1f saved (%.0f %%)\n", masked, all, all - masked, 100.0 * (all - masked) / all);
+  printf("bench session events : %u streams at %u packets/s save %.0f cycles/s\n", TEST_HS_STREAMS,
+         TEST_HS_PACKETS_PER_S, (all - masked) * TEST_HS_STREAMS * TEST_HS_PACKETS_PER_S);
+}
+
+/* Exported functions --------------------------------------------------------*/
+/**
+  * @brief  main
+  *         Runs the checks then the benchmark.
+  * @param  None
+  * @retval exit status
+  */
+int  main(void)
+{
+  Description.frequency = USB_AUDIO_CONFIG_FREQ_48_K;
+  Description.channels_count = 2;
+  Description.resolution = 2;
+  USB_AudioStreamingInitializeDataBuffer(&Ring, sizeof(RingData), TEST_PACKET_SIZE, 0);
+  Ring.data = RingData;
+  USB_AudioStreamingInputInit(&DataEp, &Description, &Session, (uint32_t)&InputNode);
+
+  TEST_Events();
+  TEST_EventsBench();
+  TEST_CHECK(Errors == 0, "%u node errors", Errors);
+  return TEST_Report("usbd_session_events_test");
+}
+
+/************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
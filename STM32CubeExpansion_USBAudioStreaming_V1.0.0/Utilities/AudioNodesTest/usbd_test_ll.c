@@ -0,0 +1,346 @@
+/**
+  ******************************************************************************
+  * @file    usbd_test_ll.c
+  * @author  MCD Application Team
+  * @brief   mocked PCD of the USB tests : the low level driver of the device
+  *          library records the endpoints and their armed transfers, the
+  *          tests complete the transfers and feed setup packets to the core.
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2019  STMicroelectronics.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by ST under Ultimate Liberty license
+  * SLA0044, the "License"; You may not use this file except in compliance with
+  * the License. You may obtain a copy of the License at:
+  *                             www.st.com/SLA0044
+  *
+  ******************************************************************************
+  */
+/* Includes ------------------------------------------------------------------*/
+#include "usbd_core.h"
+
+/* Exported variables --------------------------------------------------------*/
+USBD_TestLL_t USBD_TestLL;
+
+/* Private functions ---------------------------------------------------------*/
+/**
+  * @brief  USBD_TestEp
+  *         Gets the mocked endpoint of an address.
+  * @param  ep_addr(IN): endpoint address, bit 7 set for IN endpoints
+  * @retval endpoint
+  */
+static USBD_TestEp_t*  USBD_TestEp(uint8_t ep_addr)
+{
+  return (ep_addr & 0x80U)? &USBD_TestLL.in[ep_addr & 0x0FU] : &USBD_TestLL.out[ep_addr & 0x0FU];
+}
+
+/**
+  * @brief  USBD_TestOwnedSum
+  *         Checksum of the memory owned by the armed transfer of an endpoint : the packet bytes of an IN
+  *         transfer, the cache lines covering the buffer of an OUT transfer, which are invalidated when
+  *         it completes.
+  * @param  ep(IN):    endpoint
+  * @param  is_in(IN): 1 for an IN endpoint
+  * @retval checksum (FNV-1a)
+  */
+static uint32_t  USBD_TestOwnedSum(const USBD_TestEp_t* ep, uint8_t is_in)
+{
+  uintptr_t start = (uintptr_t)ep->buf;
+  uintptr_t end = start + ep->size;
+  uint32_t sum = 2166136261U;
+
+  if(!is_in)
+  {
+    start &= ~(uintptr_t)(USBD_TEST_CACHE_LINE_SIZE - 1U);
+    end = (end + USBD_TEST_CACHE_LINE_SIZE - 1U) & ~(uintptr_t)(USBD_TEST_CACHE_LINE_SIZE - 1U);
+  }
+  for(; start < end; start++)
+  {
+    sum = (sum ^ *(const uint8_t*)start) * 16777619U;
+  }
+  return sum;
+}
+
+/**
+  * @brief  USBD_TestArm
+  *         Arms a transfer and checks the OTG DMA rules on its buffer.
+  * @param  ep(IN):    endpoint
+  * @param  is_in(IN): 1 for an IN endpoint
+  * @param  pbuf(IN):  buffer, owned by the PCD until the transfer completes
+  * @param  size(IN):  transfer size
+  * @retval None
+  */
+static void  USBD_TestArm(USBD_TestEp_t* ep, uint8_t is_in, uint8_t* pbuf, uint16_t size)
+{
+  if((ep->buf != NULL) && (ep->size != 0U))
+  {
+    USBD_TestLL.dma_rearmed++;
+  }
+  ep->buf = pbuf;
+  ep->size = size;
+  ep->transfers++;
+  if(size != 0U)
+  {
+    if(((uintptr_t)pbuf & (is_in? 3U : (USBD_TEST_CACHE_LINE_SIZE - 1U))) != 0U)
+    {
+      USBD_TestLL.dma_unaligned++;
+    }
+    ep->owned_sum = USBD_TestOwnedSum(ep, is_in);
+  }
+}
+
+/**
+  * @brief  USBD_TestComplete
+  *         Completes the armed transfer of an endpoint : checks that the memory it owned was not written
+  *         and gives the buffer back to the device library.
+  * @param  ep(IN):    endpoint
+  * @param  is_in(IN): 1 for an IN endpoint
+  * @retval buffer of the transfer
+  */
+static uint8_t*  USBD_TestComplete(USBD_TestEp_t* ep, uint8_t is_in)
+{
+  uint8_t* buf = ep->buf;
+
+  if((buf != NULL) && (ep->size != 0U) && (USBD_TestOwnedSum(ep, is_in) != ep->owned_sum))
+  {
+    USBD_TestLL.dma_overwritten++;
+  }
+  ep->buf = NULL;
+  return buf;
+}
+
+/* Exported functions --------------------------------------------------------*/
+/**
+  * @brief  USBD_TestLLReset
+  *         Closes all the endpoints and clears the counters.
+  * @param  None
+  * @retval None
+  */
+void  USBD_TestLLReset(void)
+{
+  memset(&USBD_TestLL, 0, sizeof(USBD_TestLL));
+}
+
+/**
+  * @brief  USBD_TestSetup
+  *         Receives a setup packet on EP0, as HAL_PCD_SetupStageCallback.
+  * @param  pdev(IN):      device
+  * @param  bmRequest(IN): request type
+  * @param  bRequest(IN):  request
+  * @param  wValue(IN):    value
+  * @param  wIndex(IN):    index
+  * @param  wLength(IN):   data stage length
+  * @retval None
+  */
+void  USBD_TestSetup(struct _USBD_HandleTypeDef* pdev, uint8_t bmRequest, uint8_t bRequest, uint16_t wValue,
+                     uint16_t wIndex, uint16_t wLength)
+{
+  uint8_t setup[8];
+
+  setup[0] = bmRequest;
+  setup[1] = bRequest;
+  setup[2] = LOBYTE(wValue);
+  setup[3] = HIBYTE(wValue);
+  setup[4] = LOBYTE(wIndex);
+  setup[5] = HIBYTE(wIndex);
+  setup[6] = LOBYTE(wLength);
+  setup[7] = HIBYTE(wLength);
+  USBD_TestLL.usb_isr = 1;
+  USBD_LL_SetupStage(pdev, setup);
+  USBD_TestLL.usb_isr = 0;
+}
+
+/**
+  * @brief  USBD_TestDataOut
+  *         Completes the armed transfer of an OUT endpoint with size bytes, then calls the core as
+  *         HAL_PCD_DataOutStageCallback. The buffer goes back to the device library.
+  * @param  pdev(IN):    device
+  * @param  ep_addr(IN): OUT endpoint address
+  * @param  size(IN):    received bytes
+  * @retval None
+  */
+void  USBD_TestDataOut(struct _USBD_HandleTypeDef* pdev, uint8_t ep_addr, uint16_t size)
+{
+  USBD_TestDataOutPacket(pdev, ep_addr, NULL, size);
+}
+
+/**
+  * @brief  USBD_TestDataOutPacket
+  *         Completes the armed transfer of an OUT endpoint as the OTG DMA : the packet is written in the
+  *         armed buffer, then the core is called as HAL_PCD_DataOutStageCallback.
+  * @param  pdev(IN):    device
+  * @param  ep_addr(IN): OUT endpoint address
+  * @param  data(IN):    packet, NULL to keep the buffer content
+  * @param  size(IN):    received bytes
+  * @retval None
+  */
+void  USBD_TestDataOutPacket(struct _USBD_HandleTypeDef* pdev, uint8_t ep_addr, const uint8_t* data, uint16_t size)
+{
+  USBD_TestEp_t* ep = USBD_TestEp(ep_addr);
+  uint8_t* buf = USBD_TestComplete(ep, 0U);
+
+  if((data != NULL) && (buf != NULL))
+  {
+    memcpy(buf, data, size);
+  }
+  USBD_TestLL.rx_size[ep_addr & 0x0FU] = size;
+  USBD_TestLL.usb_isr = 1;
+  USBD_LL_DataOutStage(pdev, ep_addr & 0x0FU, buf);
+  USBD_TestLL.usb_isr = 0;
+}
+
+/**
+  * @brief  USBD_TestDataIn
+  *         Completes the armed transfer of an IN endpoint, then calls the core as
+  *         HAL_PCD_DataInStageCallback. The buffer goes back to the device library.
+  * @param  pdev(IN):    device
+  * @param  ep_addr(IN): IN endpoint address
+  * @retval None
+  */
+void  USBD_TestDataIn(struct _USBD_HandleTypeDef* pdev, uint8_t ep_addr)
+{
+  uint8_t* buf = USBD_TestComplete(USBD_TestEp(ep_addr), 1U);
+
+  USBD_TestLL.usb_isr = 1;
+  USBD_LL_DataInStage(pdev, ep_addr & 0x0FU, buf);
+  USBD_TestLL.usb_isr = 0;
+}
+
+/**
+  * @brief  USBD_TestSOF
+  *         Starts a frame : the frame number read by USB_SOF_NUMBER() is incremented, then the core is called
+  *         as HAL_PCD_SOFCallback.
+  * @param  pdev(IN):    device
+  * @retval None
+  */
+void  USBD_TestSOF(struct _USBD_HandleTypeDef* pdev)
+{
+  USBD_TestLL.sof_number++;
+  USBD_TestLL.usb_isr = 1;
+  USBD_LL_SOF(pdev);
+  USBD_TestLL.usb_isr = 0;
+}
+
+/**
+  * @brief  USBD_error_handler
+  *         Counts the errors reported by the audio class.
+  * @param  None
+  * @retval None
+  */
+void  USBD_error_handler(void)
+{
+  USBD_TestLL.errors++;
+}
+
+/* low level driver of the device library, see usbd_conf.c of the boards */
+USBD_StatusTypeDef  USBD_LL_Init(USBD_HandleTypeDef *pdev)
+{
+  (void)pdev;
+  USBD_TestLLReset();
+  return USBD_OK;
+}
+
+USBD_StatusTypeDef  USBD_LL_DeInit(USBD_HandleTypeDef *pdev)
+{
+  (void)pdev;
+  return USBD_OK;
+}
+
+USBD_StatusTypeDef  USBD_LL_Start(USBD_HandleTypeDef *pdev)
+{
+  (void)pdev;
+  return USBD_OK;
+}
+
+USBD_StatusTypeDef  USBD_LL_Stop(USBD_HandleTypeDef *pdev)
+{
+  (void)pdev;
+  return USBD_OK;
+}
+
+USBD_StatusTypeDef  USBD_LL_OpenEP(USBD_HandleTypeDef *pdev, uint8_t ep_addr, uint8_t ep_type, uint16_t ep_mps)
+{
+  USBD_TestEp_t* ep = USBD_TestEp(ep_addr);
+
+  (void)pdev;
+  ep->open = 1;
+  ep->type = ep_type;
+  ep->mps = ep_mps;
+  ep->buf = NULL;
+  return USBD_OK;
+}
+
+USBD_StatusTypeDef  USBD_LL_CloseEP(USBD_HandleTypeDef *pdev, uint8_t ep_addr)
+{
+  USBD_TestEp_t* ep = USBD_TestEp(ep_addr);
+
+  (void)pdev;
+  ep->open = 0;
+  ep->buf = NULL;
+  return USBD_OK;
+}
+
+USBD_StatusTypeDef  USBD_LL_FlushEP(USBD_HandleTypeDef *pdev, uint8_t ep_addr)
+{
+  (void)pdev;
+  (void)ep_addr;
+  return USBD_OK;
+}
+
+USBD_StatusTypeDef  USBD_LL_StallEP(USBD_HandleTypeDef *pdev, uint8_t ep_addr)
+{
+  (void)pdev;
+  (void)ep_addr;
+  USBD_TestLL.stalls++;
+  return USBD_OK;
+}
+
+USBD_StatusTypeDef  USBD_LL_ClearStallEP(USBD_HandleTypeDef *pdev, uint8_t ep_addr)
+{
+  (void)pdev;
+  (void)ep_addr;
+  return USBD_OK;
+}
+
+uint8_t  USBD_LL_IsStallEP(USBD_HandleTypeDef *pdev, uint8_t ep_addr)
+{
+  (void)pdev;
+  (void)ep_addr;
+  return 0;
+}
+
+USBD_StatusTypeDef  USBD_LL_SetUSBAddress(USBD_HandleTypeDef *pdev, uint8_t dev_addr)
+{
+  (void)pdev;
+  (void)dev_addr;
+  return USBD_OK;
+}
+
+USBD_StatusTypeDef  USBD_LL_Transmit(USBD_HandleTypeDef *pdev, uint8_t ep_addr, uint8_t *pbuf, uint16_t size)
+{
+  (void)pdev;
+  USBD_TestArm(USBD_TestEp(ep_addr | 0x80U), 1U, pbuf, size);
+  return USBD_OK;
+}
+
+USBD_StatusTypeDef  USBD_LL_PrepareReceive(USBD_HandleTypeDef *pdev, uint8_t ep_addr, uint8_t *pbuf, uint16_t size)
+{
+  (void)pdev;
+  USBD_TestArm(USBD_TestEp(ep_addr & 0x7FU), 0U, pbuf, size);
+  return USBD_OK;
+}
+
+uint32_t  USBD_LL_GetRxDataSize(USBD_HandleTypeDef *pdev, uint8_t ep_addr)
+{
+  (void)pdev;
+  return USBD_TestLL.rx_size[ep_addr & 0x0FU];
+}
+
+void  USBD_LL_Delay(uint32_t Delay)
+{
+  (void)Delay;
+}
+
+/************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
@@ -0,0 +1,85 @@
+/**
+  ******************************************************************************
+  * @file    usbd_test_ll.h
+  * @author  MCD Application Team
+  * @brief   header of usbd_test_ll.c
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2019  STMicroelectronics.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by ST under Ultimate Liberty license
+  * SLA0044, the "License"; You may not use this file except in compliance with
+  * the License. You may obtain a copy of the License at:
+  *                             www.st.com/SLA0044
+  *
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __USBD_TEST_LL_H
+#define __USBD_TEST_LL_H
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdint.h>
+
+/* Exported constants --------------------------------------------------------*/
+#define USBD_TEST_EP_COUNT              16U
+#define USBD_TEST_CACHE_LINE_SIZE       32U     /* D-cache line of the Cortex-M7 */
+
+/* Exported types ------------------------------------------------------------*/
+/* an endpoint of the mocked PCD */
+typedef struct
+{
+  uint8_t   open;
+  uint8_t   type;
+  uint16_t  mps;
+  uint8_t*  buf;        /* buffer of the armed transfer, owned by the PCD until the transfer completes */
+  uint16_t  size;
+  uint32_t  transfers;  /* transfers armed since the last USBD_TestLLReset */
+  uint32_t  owned_sum;  /* checksum of the memory owned by the armed transfer */
+} USBD_TestEp_t;
+
+/* state of the mocked PCD */
+typedef struct
+{
+  USBD_TestEp_t in[USBD_TEST_EP_COUNT];
+  USBD_TestEp_t out[USBD_TEST_EP_COUNT];
+  uint16_t      rx_size[USBD_TEST_EP_COUNT];  /* size returned by USBD_LL_GetRxDataSize */
+  uint32_t      sof_number;                   /* read by USB_SOF_NUMBER() */
+  uint32_t      stalls;
+  uint32_t      errors;                       /* USBD_error_handler calls */
+  volatile uint8_t usb_isr;                   /* set while the core runs from a mocked USB interrupt */
+  /* OTG DMA rules : buffers word aligned, OUT buffers starting on a cache line, the bytes of IN
+     buffers and the cache lines of OUT buffers not written by the CPU until the transfer completes,
+     no transfer armed on an endpoint which still owns a buffer */
+  uint32_t      dma_unaligned;
+  uint32_t      dma_overwritten;
+  uint32_t      dma_rearmed;
+} USBD_TestLL_t;
+
+/* Exported variables --------------------------------------------------------*/
+extern USBD_TestLL_t USBD_TestLL;
+
+/* Exported functions ------------------------------------------------------- */
+struct _USBD_HandleTypeDef;
+void  USBD_TestLLReset(void);
+void  USBD_TestSetup(struct _USBD_HandleTypeDef* pdev, uint8_t bmRequest, uint8_t bRequest, uint16_t wValue,
+                     uint16_t wIndex, uint16_t wLength);
+void  USBD_TestDataOut(struct _USBD_HandleTypeDef* pdev, uint8_t ep_addr, uint16_t size);
+void  USBD_TestDataOutPacket(struct _USBD_HandleTypeDef* pdev, uint8_t ep_addr, const uint8_t* data, uint16_t size);
+void  USBD_TestDataIn(struct _USBD_HandleTypeDef* pdev, uint8_t ep_addr);
+void  USBD_TestSOF(struct _USBD_HandleTypeDef* pdev);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* __USBD_TEST_LL_H */
+
+/************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
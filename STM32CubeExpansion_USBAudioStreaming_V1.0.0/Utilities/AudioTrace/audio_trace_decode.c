@@ -0,0 +1,312 @@
+/**
+  ******************************************************************************
+  * @file    audio_trace_decode.c
+  * @author  MCD Application Team
+  * @brief   host tool, decodes the AUDIO_TraceRing (see Projects/Common/Streaming/Inc/audio_trace.h)
+  *          found in a target memory dump.
+  *          Build : cc -O2 -o audio_trace_decode audio_trace_decode.c
+  *          Usage : audio_trace_decode [-csv|-latency] dump.bin
+  *          Default output is a timeline, -csv prints one line per record with the buffer
+  *          fill level, to be plotted (see readme.txt), -latency measures the stream start
+  *          and sampling rate switch latencies.
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2019  STMicroelectronics.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by ST under Ultimate Liberty license
+  * SLA0044, the "License"; You may not use this file except in compliance with
+  * the License. You may obtain a copy of the License at:
+  *                             www.st.com/SLA0044
+  *
+  ******************************************************************************
+  */
+/* Includes ------------------------------------------------------------------*/
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Private defines -----------------------------------------------------------*/
+/* must match audio_trace.h */
+#define AUDIO_TRACE_MAGIC               0x43525441U
+#define AUDIO_TRACE_VERSION             1U
+#define AUDIO_TRACE_HEADER_SIZE         20U  /* magic, version, record_size, record_count, time_frequency, head */
+#define AUDIO_TRACE_RECORD_SIZE         16U
+#define AUDIO_TRACE_USB_PACKET_SENT     2U
+#define AUDIO_TRACE_SESSION_EVENT       5U
+#define AUDIO_TRACE_ALTERNATE_SETTING   6U
+#define AUDIO_TRACE_SPEAKER_FIRST_DATA  7U
+#define AUDIO_TRACE_FEEDBACK_LOCKED     8U
+#define AUDIO_TRACE_NODE_PLAYBACK       4U
+#define AUDIO_TRACE_NODE_RECORDING      5U
+#define AUDIO_FREQUENCY_CHANGED         8U
+
+/* output modes */
+#define MODE_TIMELINE                   0
+#define MODE_CSV                        1
+#define MODE_LATENCY                    2
+
+/* Private variables ---------------------------------------------------------*/
+static const char* event_names[] =
+{
+  "USB_RX_BUFFER", "USB_PACKET_RECEIVED", "USB_PACKET_SENT", "SPEAKER_INJECTION", "MIC_FILL", "SESSION_EVENT",
+  "ALTERNATE_SETTING", "SPEAKER_FIRST_DATA", "FEEDBACK_LOCKED"
+};
+static const char* node_names[] =
+{
+  "USB_INPUT", "USB_OUTPUT", "SPEAKER", "MIC", "PLAYBACK_SESSION", "RECORDING_SESSION"
+};
+/* AUDIO_SessionEvent_t of audio_node.h */
+static const char* session_event_names[] =
+{
+  "THRESHOLD_REACHED", "BEGIN_OF_STREAM", "PACKET_RECEIVED", "PACKET_PLAYED", "OVERRUN", "UNDERRUN",
+  "OVERRUN_TH_REACHED", "UNDERRUN_TH_REACHED", "FREQUENCY_CHANGED"
+};
+
+/* latency measurement of a stream, from its last start or sampling rate switch */
+typedef struct
+{
+  const char* name;
+  int         feedback;       /* stream has an explicit feedback */
+  double      reference;      /* time of the start or switch, us */
+  int         waiting_data;   /* first played or sent data not seen yet */
+  int         waiting_lock;   /* playback feedback not measured yet */
+} latency_t;
+
+/* Private functions ---------------------------------------------------------*/
+/* dump is little endian, as the target */
+static uint32_t rd16(const uint8_t* p)
+{
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8);
+}
+
+static uint32_t rd32(const uint8_t* p)
+{
+  return rd16(p) | (rd16(p + 2) << 16);
+}
+
+#define NAME(table, i) (((i) < sizeof(table)/sizeof(table[0]))? table[i] : "?")
+
+/**
+  * @brief  latency_record
+  *         Updates the latency measurement of a stream with a record, prints the measured latencies.
+  * @param  stream(IN): stream of the record node
+  * @param  time(IN):   record time, us
+  * @param  event(IN):  record event
+  * @param  value(IN):  record length and arg as a 32 bits value
+  * @param  arg(IN):    record arg
+  * @retval None
+  */
+static void latency_record(latency_t* stream, double time, uint32_t event, uint32_t value, uint32_t arg)
+{
+  switch(event)
+  {
+  case AUDIO_TRACE_ALTERNATE_SETTING:
+    if(arg == 0)
+    {
+      stream->waiting_data = stream->waiting_lock = 0;
+      printf("%10.3f us  %s stopped\n", time, stream->name);
+      return;
+    }
+    printf("%10.3f us  %s started, alternate %u\n", time, stream->name, arg);
+    break;
+  case AUDIO_TRACE_SESSION_EVENT:
+    if(arg != AUDIO_FREQUENCY_CHANGED)
+    {
+      return;
+    }
+    printf("%10.3f us  %s sampling rate switch\n", time, stream->name);
+    break;
+  case AUDIO_TRACE_SPEAKER_FIRST_DATA:
+    if(stream->waiting_data)
+    {
+      stream->waiting_data = 0;
+      printf("%10.3f us  %s first sample after %.3f us, %u bytes of silence\n",
+             time, stream->name, time - stream->reference, value);
+    }
+    return;
+  case AUDIO_TRACE_USB_PACKET_SENT:
+    if(stream->waiting_data)
+    {
+      stream->waiting_data = 0;
+      printf("%10.3f us  %s first packet after %.3f us\n", time, stream->name, time - stream->reference);
+    }
+    return;
+  case AUDIO_TRACE_FEEDBACK_LOCKED:
+    if(stream->waiting_lock)
+    {
+      stream->waiting_lock = 0;
+      printf("%10.3f us  %s feedback locked after %.3f us, %u Hz\n",
+             time, stream->name, time - stream->reference, value);
+    }
+    return;
+  default:
+    return;
+  }
+  /* start or switch, new reference */
+  stream->reference = time;
+  stream->waiting_data = 1;
+  stream->waiting_lock = stream->feedback;
+}
+
+/**
+  * @brief  find_ring
+  *         Searches a valid ring header in the dump.
+  * @param  dump(IN): dump content
+  * @param  size(IN): dump size
+  * @retval offset of the ring, -1 if not found
+  */
+static long find_ring(const uint8_t* dump, size_t size)
+{
+  size_t offset;
+  uint32_t count;
+
+  for(offset = 0; offset + AUDIO_TRACE_HEADER_SIZE <= size; offset += 4)
+  {
+    if(rd32(dump + offset) != AUDIO_TRACE_MAGIC)
+    {
+      continue;
+    }
+    count = rd32(dump + offset + 8);
+    if((rd16(dump + offset + 4) == AUDIO_TRACE_VERSION) &&
+       (rd16(dump + offset + 6) == AUDIO_TRACE_RECORD_SIZE) &&
+       (count != 0) && ((count & (count - 1)) == 0) &&
+       (offset + AUDIO_TRACE_HEADER_SIZE + (size_t)count * AUDIO_TRACE_RECORD_SIZE <= size))
+    {
+      return (long)offset;
+    }
+  }
+  return -1;
+}
+
+int main(int argc, char* argv[])
+{
+  FILE* f;
+  uint8_t* dump;
+  long size, ring;
+  uint32_t count, frequency, head, first, i;
+  uint32_t prev_time = 0;
+  uint64_t time = 0;
+  int mode = MODE_TIMELINE;
+  latency_t playback = {"playback", 1, 0, 0, 0}, recording = {"recording", 0, 0, 0, 0};
+  const char* path;
+
+  if((argc == 3) && (strcmp(argv[1], "-csv") == 0))
+  {
+    mode = MODE_CSV;
+    path = argv[2];
+  }
+  else if((argc == 3) && (strcmp(argv[1], "-latency") == 0))
+  {
+    mode = MODE_LATENCY;
+    path = argv[2];
+  }
+  else if(argc == 2)
+  {
+    path = argv[1];
+  }
+  else
+  {
+    fprintf(stderr, "usage: %s [-csv|-latency] dump.bin\n", argv[0]);
+    return 2;
+  }
+
+  f = fopen(path, "rb");
+  if(!f)
+  {
+    perror(path);
+    return 1;
+  }
+  fseek(f, 0, SEEK_END);
+  size = ftell(f);
+  fseek(f, 0, SEEK_SET);
+  dump = malloc((size_t)size);
+  if(!dump || (fread(dump, 1, (size_t)size, f) != (size_t)size))
+  {
+    fprintf(stderr, "can't read %s\n", path);
+    fclose(f);
+    return 1;
+  }
+  fclose(f);
+
+  ring = find_ring(dump, (size_t)size);
+  if(ring < 0)
+  {
+    fprintf(stderr, "no trace ring found in %s\n", path);
+    free(dump);
+    return 1;
+  }
+  count     = rd32(dump + ring + 8);
+  frequency = rd32(dump + ring + 12);
+  head      = rd32(dump + ring + 16);
+  first     = (head > count)? head - count : 0;
+  if(frequency == 0)
+  {
+    frequency = 1;
+  }
+
+  if(mode == MODE_CSV)
+  {
+    printf("index,time_us,event,node,length,rd_ptr,wr_ptr,size,fill,arg\n");
+  }
+  else
+  {
+    printf("ring at offset 0x%lx, %u records emitted, %u kept, time base %u Hz\n",
+           (unsigned long)ring, head, head - first, frequency);
+  }
+
+  for(i = first; i != head; i++)
+  {
+    const uint8_t* r = dump + ring + AUDIO_TRACE_HEADER_SIZE + (size_t)(i & (count - 1)) * AUDIO_TRACE_RECORD_SIZE;
+    uint32_t t = rd32(r), event = r[4], node = r[5], length = rd16(r + 6);
+    uint32_t rd_ptr = rd16(r + 8), wr_ptr = rd16(r + 10), buf_size = rd16(r + 12), arg = rd16(r + 14);
+    uint32_t fill = (buf_size == 0)? 0 : ((wr_ptr + buf_size - rd_ptr) % buf_size);
+
+    /* 32 bits cycle counter wraps, accumulate the deltas */
+    if(i == first)
+    {
+      prev_time = t;
+    }
+    time += (uint32_t)(t - prev_time);
+    prev_time = t;
+
+    if(mode == MODE_LATENCY)
+    {
+      /* speaker and USB output records belong to the playback and recording streams */
+      if((node == AUDIO_TRACE_NODE_PLAYBACK) || (event == AUDIO_TRACE_SPEAKER_FIRST_DATA))
+      {
+        latency_record(&playback, (double)time * 1e6 / frequency, event, length | (arg << 16), arg);
+      }
+      else if((node == AUDIO_TRACE_NODE_RECORDING) || (event == AUDIO_TRACE_USB_PACKET_SENT))
+      {
+        latency_record(&recording, (double)time * 1e6 / frequency, event, length | (arg << 16), arg);
+      }
+    }
+    else if(mode == MODE_CSV)
+    {
+      printf("%u,%.3f,%s,%s,%u,%u,%u,%u,%u,%u\n", i, (double)time * 1e6 / frequency,
+             NAME(event_names, event), NAME(node_names, node), length, rd_ptr, wr_ptr, buf_size, fill, arg);
+    }
+    else
+    {
+      printf("%10.3f us  %-18s %-20s len %5u  rd %5u wr %5u size %5u fill %5u",
+             (double)time * 1e6 / frequency, NAME(node_names, node), NAME(event_names, event),
+             length, rd_ptr, wr_ptr, buf_size, fill);
+      if(event == AUDIO_TRACE_SESSION_EVENT)
+      {
+        printf("  %s", NAME(session_event_names, arg));
+      }
+      else if(arg)
+      {
+        printf("  arg %u", arg);
+      }
+      printf("\n");
+    }
+  }
+  free(dump);
+  return 0;
+}
+
+/************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/